@@ -0,0 +1,353 @@
+/**
+ * @file llbucketqueue.h
+ * @brief Bucketed priority queue with lock free enqueue and
+ * reprioritization.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLBUCKETQUEUE_H
+#define LL_LLBUCKETQUEUE_H
+
+#include <vector>
+
+#include "llapr.h"
+#include "llthread.h"
+
+//============================================================================
+// Hooks an entry needs to be on an LLBucketQueue.  Derive from this and
+// provide U32 getPriority() const.
+
+class LLBucketQueueEntry
+{
+	template <class ENTRY_TYPE> friend class LLBucketQueue;
+
+public:
+	LLBucketQueueEntry() :
+		mBucketNext(NULL),
+		mBucketPrev(NULL),
+		mBucket(-1),
+		mIncomingNext(NULL),
+		mOnIncoming(0),
+		mInQueue(0)
+	{
+	}
+
+private:
+	// Consumer side, guarded by the queue's mutex
+	LLBucketQueueEntry* mBucketNext;
+	LLBucketQueueEntry* mBucketPrev;
+	S32 mBucket; // -1 when not in a bucket
+
+	// Producer side, lock free
+	LLBucketQueueEntry* volatile mIncomingNext;
+	volatile apr_uint32_t mOnIncoming; // on the incoming stack waiting to be sorted
+	LLAtomicU32 mInQueue; // pushed and not yet popped
+};
+
+//============================================================================
+// Priority queue for LLQueuedThread, ordered on the top bits of a U32
+// priority.  Each bucket is a first in first out list; within a bucket
+// order is by arrival rather than exact priority.
+//
+// Producers never block: push() and reprioritize() put the entry on an
+// incoming stack with a compare and swap, and the first consumer to come
+// along sorts the stack into the buckets.  Consumers (pop(), top(),
+// getEntries()) serialize on a mutex that producers never touch.
+//
+// A raised priority moves the entry to its new bucket as soon as it is
+// sorted, a lowered one is left where it is until it reaches the front
+// and is moved then, which is usually never for entries that are
+// reprioritized every frame.
+//
+// Entries may be reprioritized from any thread but, like
+// LLQueuedThread::QueuedRequest, must not be deleted while they might
+// still be on the incoming stack.  Call forget() first.
+
+template <class ENTRY_TYPE>
+class LLBucketQueue
+{
+public:
+	enum
+	{
+		BUCKET_SHIFT = 21, // 31 bits of priority -> 1024 buckets
+		NUM_BUCKETS = 0x80000000U >> BUCKET_SHIFT,
+		NUM_WORDS = NUM_BUCKETS / 32
+	};
+
+	LLBucketQueue() :
+		mIncoming(NULL),
+		mCount(0),
+		mSummary(0),
+		mMutex(NULL)
+	{
+		for (S32 i = 0; i < NUM_BUCKETS; i++)
+		{
+			mHeads[i] = NULL;
+			mTails[i] = NULL;
+		}
+		for (S32 i = 0; i < NUM_WORDS; i++)
+		{
+			mOccupied[i] = 0;
+		}
+	}
+
+	static S32 getBucket(U32 priority)
+	{
+		return (S32)((priority & 0x7FFFFFFF) >> BUCKET_SHIFT);
+	}
+
+	// Any thread, lock free.  The entry must not already be queued.
+	void push(ENTRY_TYPE* entry)
+	{
+		llassert(!entry->mInQueue);
+		entry->mInQueue = 1;
+		mCount++;
+		pushIncoming(entry);
+	}
+
+	// Any thread, lock free.  Call after changing a queued entry's
+	// priority; does nothing if it has been popped in the mean time.
+	void reprioritize(ENTRY_TYPE* entry)
+	{
+		if (entry->mInQueue)
+		{
+			pushIncoming(entry);
+		}
+	}
+
+	// Highest priority entry, or NULL.
+	ENTRY_TYPE* pop()
+	{
+		LLMutexLock lock(&mMutex);
+		LLBucketQueueEntry* entry = front();
+		if (entry)
+		{
+			unlink(entry);
+			entry->mInQueue = 0;
+			mCount--;
+		}
+		return static_cast<ENTRY_TYPE*>(entry);
+	}
+
+	// Peek at the highest priority entry, or NULL.
+	ENTRY_TYPE* top()
+	{
+		LLMutexLock lock(&mMutex);
+		return static_cast<ENTRY_TYPE*>(front());
+	}
+
+	// Makes sure the queue holds no pointer to a popped entry, so that it
+	// may be deleted.
+	void forget(ENTRY_TYPE* entry)
+	{
+		llassert(!entry->mInQueue);
+		if (apr_atomic_read32(&entry->mOnIncoming))
+		{
+			LLMutexLock lock(&mMutex);
+			sortIncoming();
+		}
+	}
+
+	S32 size()
+	{
+		return (S32)mCount;
+	}
+
+	bool empty()
+	{
+		return size() == 0;
+	}
+
+	// Snapshot of the queue in priority order, for debugging.
+	void getEntries(std::vector<ENTRY_TYPE*>& entries)
+	{
+		LLMutexLock lock(&mMutex);
+		sortIncoming();
+		for (S32 bucket = NUM_BUCKETS - 1; bucket >= 0; bucket--)
+		{
+			for (LLBucketQueueEntry* entry = mHeads[bucket]; entry; entry = entry->mBucketNext)
+			{
+				entries.push_back(static_cast<ENTRY_TYPE*>(entry));
+			}
+		}
+	}
+
+private:
+	static U32 priorityOf(LLBucketQueueEntry* entry)
+	{
+		return static_cast<ENTRY_TYPE*>(entry)->getPriority();
+	}
+
+	void pushIncoming(LLBucketQueueEntry* entry)
+	{
+		if (apr_atomic_cas32(&entry->mOnIncoming, 1, 0) != 0)
+		{
+			return; // already waiting to be sorted, it will see the new priority
+		}
+		LLBucketQueueEntry* head;
+		do
+		{
+			head = mIncoming;
+			entry->mIncomingNext = head;
+		}
+		while (apr_atomic_casptr((volatile void**)&mIncoming, entry, head) != head);
+	}
+
+	// Consumer side, mMutex held
+	void sortIncoming()
+	{
+		LLBucketQueueEntry* entry;
+		do
+		{
+			entry = mIncoming;
+		}
+		while (entry && apr_atomic_casptr((volatile void**)&mIncoming, NULL, entry) != entry);
+
+		// The stack is newest first, turn it around to keep the buckets in
+		// arrival order.
+		LLBucketQueueEntry* oldest = NULL;
+		while (entry)
+		{
+			LLBucketQueueEntry* next = entry->mIncomingNext;
+			entry->mIncomingNext = oldest;
+			oldest = entry;
+			entry = next;
+		}
+
+		entry = oldest;
+		while (entry)
+		{
+			LLBucketQueueEntry* next = entry->mIncomingNext;
+			entry->mIncomingNext = NULL;
+			apr_atomic_set32(&entry->mOnIncoming, 0);
+			if (entry->mInQueue)
+			{
+				S32 bucket = getBucket(priorityOf(entry));
+				if (entry->mBucket < 0)
+				{
+					link(entry, bucket);
+				}
+				else if (bucket > entry->mBucket)
+				{
+					unlink(entry);
+					link(entry, bucket);
+				}
+				// Lowered priorities are dealt with lazily in front()
+			}
+			entry = next;
+		}
+	}
+
+	LLBucketQueueEntry* front()
+	{
+		sortIncoming();
+		while (mSummary)
+		{
+			S32 word = highestBit(mSummary);
+			S32 bucket = word * 32 + highestBit(mOccupied[word]);
+			LLBucketQueueEntry* entry = mHeads[bucket];
+			S32 actual = getBucket(priorityOf(entry));
+			if (actual >= bucket)
+			{
+				return entry;
+			}
+			// Its priority dropped since it was sorted, move it down now.
+			unlink(entry);
+			link(entry, actual);
+		}
+		return NULL;
+	}
+
+	void link(LLBucketQueueEntry* entry, S32 bucket)
+	{
+		entry->mBucket = bucket;
+		entry->mBucketNext = NULL;
+		entry->mBucketPrev = mTails[bucket];
+		if (mTails[bucket])
+		{
+			mTails[bucket]->mBucketNext = entry;
+		}
+		else
+		{
+			mHeads[bucket] = entry;
+			mOccupied[bucket >> 5] |= 1U << (bucket & 31);
+			mSummary |= 1U << (bucket >> 5);
+		}
+		mTails[bucket] = entry;
+	}
+
+	void unlink(LLBucketQueueEntry* entry)
+	{
+		S32 bucket = entry->mBucket;
+		if (entry->mBucketPrev)
+		{
+			entry->mBucketPrev->mBucketNext = entry->mBucketNext;
+		}
+		else
+		{
+			mHeads[bucket] = entry->mBucketNext;
+		}
+		if (entry->mBucketNext)
+		{
+			entry->mBucketNext->mBucketPrev = entry->mBucketPrev;
+		}
+		else
+		{
+			mTails[bucket] = entry->mBucketPrev;
+		}
+		if (!mHeads[bucket])
+		{
+			mOccupied[bucket >> 5] &= ~(1U << (bucket & 31));
+			if (!mOccupied[bucket >> 5])
+			{
+				mSummary &= ~(1U << (bucket >> 5));
+			}
+		}
+		entry->mBucketNext = NULL;
+		entry->mBucketPrev = NULL;
+		entry->mBucket = -1;
+	}
+
+	static S32 highestBit(U32 bits)
+	{
+		S32 res = 0;
+		if (bits & 0xFFFF0000) { bits >>= 16; res += 16; }
+		if (bits & 0xFF00) { bits >>= 8; res += 8; }
+		if (bits & 0xF0) { bits >>= 4; res += 4; }
+		if (bits & 0xC) { bits >>= 2; res += 2; }
+		if (bits & 0x2) { res += 1; }
+		return res;
+	}
+
+	LLBucketQueueEntry* volatile mIncoming;
+	LLAtomicS32 mCount;
+
+	// Consumer side, guarded by mMutex
+	LLBucketQueueEntry* mHeads[NUM_BUCKETS];
+	LLBucketQueueEntry* mTails[NUM_BUCKETS];
+	U32 mOccupied[NUM_WORDS]; // one bit per non empty bucket
+	U32 mSummary; // one bit per non zero word of mOccupied
+	LLMutex mMutex;
+};
+
+#endif // LL_LLBUCKETQUEUE_H
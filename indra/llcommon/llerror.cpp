@@ -48,6 +48,7 @@
 #include "llsd.h"
 #include "llsdserialize.h"
 #include "llstl.h"
+#include "llthread.h"
 #include "lltimer.h"
 
 namespace {
@@ -340,9 +341,6 @@ namespace
 	class Globals
 	{
 	public:
-		std::ostringstream messageStream;
-		bool messageStreamInUse;
-
 		void addCallSite(LLError::CallSite&);
 		void invalidateCallSites();
 		
@@ -353,11 +351,22 @@ namespace
 		CallSiteVector callSites;
 
 		Globals()
-			:	messageStreamInUse(false)
 			{ }
 		
 	};
 
+	// Recorders are called on the log writer thread while logging
+	// asynchronously, this keeps them from being added, removed or deleted
+	// under its feet.  Does nothing otherwise.
+	class RecorderLock
+	{
+	public:
+		RecorderLock();
+		~RecorderLock();
+	private:
+		LLMutex* mMutex;
+	};
+
 	void Globals::addCallSite(LLError::CallSite& site)
 	{
 		callSites.push_back(&site);
@@ -454,6 +463,7 @@ namespace LLError
 	{
 		Globals::get().invalidateCallSites();
 		
+		RecorderLock recorders;
 		Settings*& p = getPtr();
 		delete p;
 		p = new Settings();
@@ -463,6 +473,7 @@ namespace LLError
 	{
 		Globals::get().invalidateCallSites();
 		
+		RecorderLock recorders;
 		Settings*& p = getPtr();
 		Settings* originalSettings = p;
 		p = new Settings();
@@ -473,6 +484,7 @@ namespace LLError
 	{
 		Globals::get().invalidateCallSites();
 		
+		RecorderLock recorders;
 		Settings*& p = getPtr();
 		delete p;
 		p = originalSettings;
@@ -737,6 +749,7 @@ namespace LLError
 		{
 			return;
 		}
+		RecorderLock recorders;
 		Settings& s = Settings::get();
 		s.recorders.push_back(recorder);
 	}
@@ -747,6 +760,7 @@ namespace LLError
 		{
 			return;
 		}
+		RecorderLock recorders;
 		Settings& s = Settings::get();
 		s.recorders.erase(
 			std::remove(s.recorders.begin(), s.recorders.end(), recorder),
@@ -758,6 +772,7 @@ namespace LLError
 {
 	void logToFile(const std::string& file_name)
 	{
+		RecorderLock recorders;
 		LLError::Settings& s = LLError::Settings::get();
 
 		removeRecorder(s.fileRecorder);
@@ -784,6 +799,7 @@ namespace LLError
 	
 	void logToFixedBuffer(LLLineBuffer* fixedBuffer)
 	{
+		RecorderLock recorders;
 		LLError::Settings& s = LLError::Settings::get();
 
 		removeRecorder(s.fixedBufferRecorder);
@@ -808,7 +824,10 @@ namespace LLError
 
 namespace
 {
-	void writeToRecorders(LLError::ELevel level, const std::string& message)
+	// time is what the time function returned when the message was
+	// logged, if it has been called already.
+	void writeToRecorders(LLError::ELevel level, const std::string& message,
+						  const std::string& time = std::string())
 	{
 		LLError::Settings& s = LLError::Settings::get();
 	
@@ -824,7 +843,7 @@ namespace
 			{
 				if (messageWithTime.empty())
 				{
-					messageWithTime = s.timeFunction() + " " + message;
+					messageWithTime = (time.empty() ? s.timeFunction() : time) + " " + message;
 				}
 				
 				r->recordMessage(level, messageWithTime);
@@ -838,6 +857,328 @@ namespace
 }
 
 
+namespace
+{
+	// Each thread formats its messages in buffers of its own that it keeps
+	// for its lifetime, so nothing is allocated per message once they have
+	// grown to size.  They are never freed, there are only ever a handful
+	// of threads.
+	struct ThreadBuffers
+	{
+		ThreadBuffers() : mStreamInUse(false) { }
+
+		std::ostringstream mStream;
+		bool mStreamInUse;
+		std::string mLine;
+		std::string mTime;
+	};
+
+	ThreadBuffers& getThreadBuffers()
+	{
+		static ll_thread_local ThreadBuffers* sBuffers = NULL;
+		if (!sBuffers)
+		{
+			sBuffers = new ThreadBuffers;
+		}
+		return *sBuffers;
+	}
+
+	void releaseStream(std::ostringstream* out)
+	{
+		ThreadBuffers& buffers = getThreadBuffers();
+		if (out == &buffers.mStream)
+		{
+			buffers.mStream.clear();
+			buffers.mStream.str("");
+			buffers.mStreamInUse = false;
+		}
+		else
+		{
+			delete out;
+		}
+	}
+
+	// Passes messages to the recorders on a thread of its own, so that
+	// logging never waits on the recorders' I/O.
+	//
+	// Messages are queued in a bounded ring.  Any thread may push: it claims
+	// a slot with a compare and swap on mTail and publishes it by bumping
+	// the slot's sequence number.  The writer takes slots strictly in the
+	// order they were claimed, so each thread's messages are written in the
+	// order it logged them.  When the ring is full the message is dropped
+	// and counted, the writer notes how many were lost once it catches up.
+	class LogWriter : public LLThread
+	{
+	public:
+		LogWriter(U32 capacity);
+		~LogWriter();
+
+		// Any thread.  Swaps the strings into the queue, handing back
+		// buffers that the caller can reuse.
+		bool push(LLError::ELevel level, std::string& message, std::string& time);
+
+		// Any thread.  Waits, for a while, until everything pushed so far
+		// has been written.
+		void drain();
+
+		U32 getDropped() { return apr_atomic_read32(&mDropped); }
+		bool isWriterThread() const { return LLThread::currentID() == mWriterThreadID; }
+
+	private:
+		struct Record
+		{
+			volatile apr_uint32_t	mSequence;	// == position + 1 once published
+			LLError::ELevel			mLevel;
+			std::string				mMessage;
+			std::string				mTime;
+		};
+
+		/*virtual*/ void run();
+		/*virtual*/ bool runCondition();
+		void writeQueued();
+
+		Record*					mRecords;
+		U32						mMask;
+		volatile apr_uint32_t	mTail;		// next position to claim
+		volatile apr_uint32_t	mHead;		// next position to write
+		volatile apr_uint32_t	mSleeping;
+		volatile apr_uint32_t	mDropped;
+		U32						mReportedDropped;
+		volatile U32			mWriterThreadID;
+	};
+
+	LogWriter* volatile sLogWriter = NULL;	// only swapped atomically
+	LLMutex* sRecorderMutex = NULL;
+	LLAtomicS32 sPushing(0);	// threads that may be looking at sLogWriter
+
+	// Only dereference the result while counted in sPushing.
+	LogWriter* getLogWriter()
+	{
+		return (LogWriter*)apr_atomic_casptr((volatile void**)&sLogWriter, NULL, NULL);
+	}
+
+	LogWriter* swapLogWriter(LogWriter* writer)
+	{
+		return (LogWriter*)apr_atomic_xchgptr((volatile void**)&sLogWriter, writer);
+	}
+
+	LogWriter::LogWriter(U32 capacity)
+		:	LLThread("Log Writer"),
+			mTail(0),
+			mHead(0),
+			mSleeping(0),
+			mDropped(0),
+			mReportedDropped(0),
+			mWriterThreadID(0)
+	{
+		U32 size = 16;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		mRecords = new Record[size];
+		mMask = size - 1;
+		for (U32 i = 0; i < size; ++i)
+		{
+			mRecords[i].mSequence = i;
+			mRecords[i].mLevel = LLError::LEVEL_INFO;
+		}
+	}
+
+	LogWriter::~LogWriter()
+	{
+		delete[] mRecords;
+	}
+
+	bool LogWriter::push(LLError::ELevel level, std::string& message, std::string& time)
+	{
+		U32 pos = apr_atomic_read32(&mTail);
+		Record* record = NULL;
+		while (true)
+		{
+			record = &mRecords[pos & mMask];
+			S32 diff = (S32)(apr_atomic_read32(&record->mSequence) - pos);
+			if (diff == 0)
+			{
+				U32 prev = apr_atomic_cas32(&mTail, pos + 1, pos);
+				if (prev == pos)
+				{
+					break;
+				}
+				pos = prev;
+			}
+			else if (diff < 0)
+			{
+				// The writer hasn't got to the message a lap ago yet.
+				apr_atomic_inc32(&mDropped);
+				return false;
+			}
+			else
+			{
+				// Someone else claimed it first
+				pos = apr_atomic_read32(&mTail);
+			}
+		}
+
+		record->mLevel = level;
+		record->mMessage.swap(message);
+		record->mTime.swap(time);
+		// Full barrier, the writer sees the strings once it sees this.
+		apr_atomic_xchg32(&record->mSequence, pos + 1);
+
+		if (apr_atomic_read32(&mSleeping))
+		{
+			wake();
+		}
+		return true;
+	}
+
+	void LogWriter::drain()
+	{
+		if (isWriterThread())
+		{
+			return;
+		}
+		U32 target = apr_atomic_read32(&mTail);
+		for (S32 i = 0; i < 5000 && (S32)(apr_atomic_read32(&mHead) - target) < 0; ++i)
+		{
+			wake();
+			ms_sleep(1);
+		}
+	}
+
+	//virtual
+	bool LogWriter::runCondition()
+	{
+		Record& record = mRecords[mHead & mMask];
+		return apr_atomic_read32(&record.mSequence) == mHead + 1;
+	}
+
+	//virtual
+	void LogWriter::run()
+	{
+		mWriterThreadID = LLThread::currentID();
+		while (!isQuitting())
+		{
+			mRunCondition->lock();
+			// Set before checking, so that a push either sees it and wakes
+			// us or is seen by shouldSleep().
+			apr_atomic_xchg32(&mSleeping, 1);
+			if (shouldSleep())
+			{
+				mRunCondition->wait();
+			}
+			apr_atomic_set32(&mSleeping, 0);
+			mRunCondition->unlock();
+
+			writeQueued();
+		}
+		// Whatever came in while we were asked to stop
+		writeQueued();
+	}
+
+	void LogWriter::writeQueued()
+	{
+		if (!runCondition() && getDropped() == mReportedDropped)
+		{
+			return;
+		}
+
+		RecorderLock recorders;
+		while (runCondition())
+		{
+			U32 pos = mHead;
+			Record& record = mRecords[pos & mMask];
+			writeToRecorders(record.mLevel, record.mMessage, record.mTime);
+			apr_atomic_xchg32(&record.mSequence, pos + mMask + 1);
+			apr_atomic_inc32(&mHead);
+		}
+
+		U32 dropped = getDropped();
+		if (dropped != mReportedDropped)
+		{
+			std::ostringstream message;
+			message << "WARNING: " << (dropped - mReportedDropped)
+					<< " log messages dropped, the log queue was full";
+			writeToRecorders(LLError::LEVEL_WARN, message.str());
+			mReportedDropped = dropped;
+		}
+	}
+
+	RecorderLock::RecorderLock()
+		: mMutex(sRecorderMutex)
+	{
+		if (mMutex)
+		{
+			mMutex->lock();
+		}
+	}
+
+	RecorderLock::~RecorderLock()
+	{
+		if (mMutex)
+		{
+			mMutex->unlock();
+		}
+	}
+}
+
+namespace LLError
+{
+	void startAsyncLogging(U32 capacity)
+	{
+		if (getLogWriter())
+		{
+			return;
+		}
+		sRecorderMutex = new LLMutex(NULL);
+		LogWriter* writer = new LogWriter(capacity);
+		writer->start();
+		swapLogWriter(writer);
+	}
+
+	void stopAsyncLogging()
+	{
+		// New messages are written on the logging thread from here on,
+		// wait for anyone who got the writer before then to finish with it.
+		LogWriter* writer = swapLogWriter(NULL);
+		if (!writer)
+		{
+			return;
+		}
+		while (sPushing > 0)
+		{
+			ms_sleep(1);
+		}
+
+		if (writer->isWriterThread())
+		{
+			// Crashing on the writer thread, don't wait on ourselves.
+			return;
+		}
+		writer->shutdown();
+		delete writer;
+		LLMutex* mutex = sRecorderMutex;
+		sRecorderMutex = NULL;
+		delete mutex;
+	}
+
+	bool isAsyncLogging()
+	{
+		return getLogWriter() != NULL;
+	}
+
+	U32 droppedLogMessages()
+	{
+		sPushing++;
+		LogWriter* writer = getLogWriter();
+		U32 dropped = writer ? writer->getDropped() : 0;
+		sPushing--;
+		return dropped;
+	}
+}
+
+
 /*
 Recorder formats:
 
@@ -978,16 +1319,11 @@ namespace LLError
 
 	std::ostringstream* Log::out()
 	{
-		LogLock lock;
-		if (lock.ok())
+		ThreadBuffers& buffers = getThreadBuffers();
+		if (!buffers.mStreamInUse)
 		{
-			Globals& g = Globals::get();
-
-			if (!g.messageStreamInUse)
-			{
-				g.messageStreamInUse = true;
-				return &g.messageStream;
-			}
+			buffers.mStreamInUse = true;
+			return &buffers.mStream;
 		}
 		
 		return new std::ostringstream;
@@ -995,132 +1331,155 @@ namespace LLError
 	
 	void Log::flush(std::ostringstream* out, char* message)
     {
-       LogLock lock;
-       if (!lock.ok())
-       {
-           return;
-       }
-       
-	   if(strlen(out->str().c_str()) < 128)
+	   std::string str = out->str();
+	   releaseStream(out);
+
+	   if(str.size() < 128)
 	   {
-		   strcpy(message, out->str().c_str());
+		   strcpy(message, str.c_str());
 	   }
 	   else
 	   {
-		   strncpy(message, out->str().c_str(), 127);
+		   strncpy(message, str.c_str(), 127);
 		   message[127] = '\0' ;
 	   }
-	   
-	   Globals& g = Globals::get();
-       if (out == &g.messageStream)
-       {
-           g.messageStream.clear();
-           g.messageStream.str("");
-           g.messageStreamInUse = false;
-       }
-       else
-       {
-           delete out;
-       }
 	   return ;
     }
 
 	void Log::flush(std::ostringstream* out, const CallSite& site)
 	{
-		LogLock lock;
-		if (!lock.ok())
-		{
-			return;
-		}
-		
-		Globals& g = Globals::get();
-		Settings& s = Settings::get();
-
 		std::string message = out->str();
-		if (out == &g.messageStream)
-		{
-			g.messageStream.clear();
-			g.messageStream.str("");
-			g.messageStreamInUse = false;
-		}
-		else
-		{
-			delete out;
-		}
+		releaseStream(out);
 
-		if (site.mLevel == LEVEL_ERROR)
+		ThreadBuffers& buffers = getThreadBuffers();
+		std::string& line = buffers.mLine;
 		{
-			std::ostringstream fatalMessage;
-			fatalMessage << abbreviateFile(site.mFile)
-						<< "(" << site.mLine << ") : error";
+			LogLock lock;
+			if (!lock.ok())
+			{
+				return;
+			}
 			
-			writeToRecorders(site.mLevel, fatalMessage.str());
-		}
-		
-		
-		std::ostringstream prefix;
+			Settings& s = Settings::get();
 
-		switch (site.mLevel)
-		{
-			case LEVEL_DEBUG:		prefix << "DEBUG: ";	break;
-			case LEVEL_INFO:		prefix << "INFO: ";		break;
-			case LEVEL_WARN:		prefix << "WARNING: ";	break;
-			case LEVEL_ERROR:		prefix << "ERROR: ";	break;
-			default:				prefix << "XXX: ";		break;
-		};
-		
-		if (s.printLocation)
-		{
-			prefix << abbreviateFile(site.mFile)
-					<< "(" << site.mLine << ") : ";
-		}
-		
-	#if LL_WINDOWS
-		// DevStudio: __FUNCTION__ already includes the full class name
-	#else
-                #if LL_LINUX
-		// gross, but typeid comparison seems to always fail here with gcc4.1
-		if (0 != strcmp(site.mClassInfo.name(), typeid(NoClassInfo).name()))
-                #else
-		if (site.mClassInfo != typeid(NoClassInfo))
-                #endif // LL_LINUX
-		{
-			prefix << className(site.mClassInfo) << "::";
-		}
-	#endif
-		prefix << site.mFunction << ": ";
+			if (site.mLevel == LEVEL_ERROR)
+			{
+				// Fatal, everything before it has to be out first and this
+				// can't wait for the writer.
+				sPushing++;
+				LogWriter* writer = getLogWriter();
+				if (writer)
+				{
+					writer->drain();
+				}
+				sPushing--;
 
-		if (site.mPrintOnce)
-		{
-			std::map<std::string, unsigned int>::iterator messageIter = s.uniqueLogMessages.find(message);
-			if (messageIter != s.uniqueLogMessages.end())
+				std::ostringstream fatalMessage;
+				fatalMessage << abbreviateFile(site.mFile)
+							<< "(" << site.mLine << ") : error";
+				
+				RecorderLock recorders;
+				writeToRecorders(site.mLevel, fatalMessage.str());
+			}
+			
+			
+			line.clear();
+			switch (site.mLevel)
+			{
+				case LEVEL_DEBUG:		line += "DEBUG: ";		break;
+				case LEVEL_INFO:		line += "INFO: ";		break;
+				case LEVEL_WARN:		line += "WARNING: ";	break;
+				case LEVEL_ERROR:		line += "ERROR: ";		break;
+				default:				line += "XXX: ";		break;
+			};
+			
+			if (s.printLocation)
+			{
+				std::ostringstream location;
+				location << abbreviateFile(site.mFile)
+						<< "(" << site.mLine << ") : ";
+				line += location.str();
+			}
+			
+		#if LL_WINDOWS
+			// DevStudio: __FUNCTION__ already includes the full class name
+		#else
+	                #if LL_LINUX
+			// gross, but typeid comparison seems to always fail here with gcc4.1
+			if (0 != strcmp(site.mClassInfo.name(), typeid(NoClassInfo).name()))
+	                #else
+			if (site.mClassInfo != typeid(NoClassInfo))
+	                #endif // LL_LINUX
+			{
+				line += className(site.mClassInfo);
+				line += "::";
+			}
+		#endif
+			line += site.mFunction;
+			line += ": ";
+
+			if (site.mPrintOnce)
+			{
+				std::map<std::string, unsigned int>::iterator messageIter = s.uniqueLogMessages.find(message);
+				if (messageIter != s.uniqueLogMessages.end())
+				{
+					messageIter->second++;
+					unsigned int num_messages = messageIter->second;
+					if (num_messages == 10 || num_messages == 50 || (num_messages % 100) == 0)
+					{
+						std::ostringstream once;
+						once << "ONCE (" << num_messages << "th time seen): ";
+						line += once.str();
+					} 
+					else
+					{
+						return;
+					}
+				}
+				else 
+				{
+					line += "ONCE: ";
+					s.uniqueLogMessages[message] = 1;
+				}
+			}
+			
+			line += message;
+			
+			if (site.mLevel == LEVEL_ERROR || !getLogWriter())
 			{
-				messageIter->second++;
-				unsigned int num_messages = messageIter->second;
-				if (num_messages == 10 || num_messages == 50 || (num_messages % 100) == 0)
 				{
-					prefix << "ONCE (" << num_messages << "th time seen): ";
-				} 
-				else
+					RecorderLock recorders;
+					writeToRecorders(site.mLevel, line);
+				}
+				
+				if (site.mLevel == LEVEL_ERROR  &&  s.crashFunction)
 				{
-					return;
+					s.crashFunction(line);
 				}
+				return;
 			}
-			else 
+
+			// Stamp it now rather than when it is written
+			buffers.mTime.clear();
+			if (s.timeFunction)
 			{
-				prefix << "ONCE: ";
-				s.uniqueLogMessages[message] = 1;
+				buffers.mTime = s.timeFunction();
 			}
 		}
-		
-		prefix << message;
-		message = prefix.str();
-		
-		writeToRecorders(site.mLevel, message);
-		
-		if (site.mLevel == LEVEL_ERROR  &&  s.crashFunction)
+
+		// Queue it outside the lock, the writer may have been stopped since.
+		sPushing++;
+		LogWriter* writer = getLogWriter();
+		if (writer)
+		{
+			writer->push(site.mLevel, line, buffers.mTime);
+		}
+		sPushing--;
+		if (!writer)
 		{
-			s.crashFunction(message);
+			LogLock lock;
+			RecorderLock recorders;
+			writeToRecorders(site.mLevel, line, buffers.mTime);
 		}
 	}
 }
@@ -157,6 +157,19 @@ namespace LLError
 	LL_COMMON_API std::string logFileName();
 		// returns name of current logging file, empty string if none
 
+	LL_COMMON_API void startAsyncLogging(U32 capacity = 8192);
+		// Hands formatted messages to a background thread that passes them
+		// to the recorders, so that logging doesn't wait on their I/O.
+		// Recorders are then called on that thread.  Messages logged while
+		// capacity messages are already waiting are dropped and counted.
+		// Fatal messages are still written before returning.  Needs APR.
+	LL_COMMON_API void stopAsyncLogging();
+		// Writes out whatever is queued and goes back to calling the
+		// recorders on the thread that logs.
+	LL_COMMON_API bool isAsyncLogging();
+	LL_COMMON_API U32 droppedLogMessages();
+		// messages dropped since startAsyncLogging()
+
 
 	/*
 		Utilities for use by the unit tests of LLError itself.
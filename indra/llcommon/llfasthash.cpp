@@ -0,0 +1,341 @@
+/**
+ * @file llfasthash.cpp
+ * @brief CRC32C and 64 bit non cryptographic hashing for cache
+ * validation and hash containers.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llfasthash.h"
+
+#include <string.h>
+
+#if LL_MSVC
+# include <intrin.h>
+# include <nmmintrin.h>
+# define LL_CRC32C_HARDWARE 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <cpuid.h>
+# define LL_CRC32C_HARDWARE 1
+#endif
+
+namespace
+{
+	//------------------------------------------------------------------------
+	// Portable CRC32C, eight bytes at a time with eight tables
+
+	const U32 CRC32C_POLY = 0x82F63B78; // reflected 0x1EDC6F41
+
+	U32 sCRCTable[8][256];
+	volatile bool sCRCTableReady = false;
+
+	void init_crc_table()
+	{
+		for (U32 i = 0; i < 256; i++)
+		{
+			U32 crc = i;
+			for (S32 bit = 0; bit < 8; bit++)
+			{
+				crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+			}
+			sCRCTable[0][i] = crc;
+		}
+		for (U32 i = 0; i < 256; i++)
+		{
+			for (S32 slice = 1; slice < 8; slice++)
+			{
+				U32 prev = sCRCTable[slice - 1][i];
+				sCRCTable[slice][i] = (prev >> 8) ^ sCRCTable[0][prev & 0xFF];
+			}
+		}
+		sCRCTableReady = true;
+	}
+
+	// Built during static initialization, before there are other threads.
+	// ll_crc32c_portable() still checks in case another static initializer
+	// gets to it first.
+	struct CRCTableInit
+	{
+		CRCTableInit() { if (!sCRCTableReady) init_crc_table(); }
+	} sCRCTableInit;
+
+	inline U32 read32(const U8* p)
+	{
+		U32 value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline U64 read64(const U8* p)
+	{
+		U64 value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	//------------------------------------------------------------------------
+	// SSE4.2 CRC32C
+
+#if LL_CRC32C_HARDWARE
+	bool cpu_has_sse42()
+	{
+#if LL_MSVC
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		{
+			return false;
+		}
+		return (ecx & (1 << 20)) != 0;
+#endif
+	}
+
+	inline U32 crc32c_u8(U32 crc, U8 value)
+	{
+#if LL_MSVC
+		return _mm_crc32_u8(crc, value);
+#else
+		// Spelled out rather than the intrinsic so that this file doesn't
+		// need building with -msse4.2, which would let the compiler use
+		// SSE4 anywhere in it.
+		__asm__("crc32b %1, %0" : "+r" (crc) : "rm" (value));
+		return crc;
+#endif
+	}
+
+#if defined(_M_X64) || defined(__x86_64__)
+	typedef U64 crc_word_t;
+	inline U32 crc32c_word(U32 crc, U64 value)
+	{
+#if LL_MSVC
+		return (U32)_mm_crc32_u64(crc, value);
+#else
+		U64 crc64 = crc;
+		__asm__("crc32q %1, %0" : "+r" (crc64) : "rm" (value));
+		return (U32)crc64;
+#endif
+	}
+#else
+	typedef U32 crc_word_t;
+	inline U32 crc32c_word(U32 crc, U32 value)
+	{
+#if LL_MSVC
+		return _mm_crc32_u32(crc, value);
+#else
+		__asm__("crc32l %1, %0" : "+r" (crc) : "rm" (value));
+		return crc;
+#endif
+	}
+#endif
+
+	U32 crc32c_hardware(const void* data, size_t size, U32 crc)
+	{
+		const U8* p = (const U8*)data;
+		crc = ~crc;
+		while (size && ((size_t)p & (sizeof(crc_word_t) - 1)))
+		{
+			crc = crc32c_u8(crc, *p++);
+			size--;
+		}
+		while (size >= sizeof(crc_word_t))
+		{
+			crc_word_t word;
+			memcpy(&word, p, sizeof(word));
+			crc = crc32c_word(crc, word);
+			p += sizeof(crc_word_t);
+			size -= sizeof(crc_word_t);
+		}
+		while (size--)
+		{
+			crc = crc32c_u8(crc, *p++);
+		}
+		return ~crc;
+	}
+#endif // LL_CRC32C_HARDWARE
+
+	typedef U32 (*crc32c_func_t)(const void* data, size_t size, U32 crc);
+
+	crc32c_func_t pick_crc32c()
+	{
+#if LL_CRC32C_HARDWARE
+		if (cpu_has_sse42())
+		{
+			return crc32c_hardware;
+		}
+#endif
+		return ll_crc32c_portable;
+	}
+
+	crc32c_func_t sCRC32C = pick_crc32c();
+
+	//------------------------------------------------------------------------
+	// XXH64
+
+	const U64 PRIME64_1 = U64L(0x9E3779B185EBCA87);
+	const U64 PRIME64_2 = U64L(0xC2B2AE3D27D4EB4F);
+	const U64 PRIME64_3 = U64L(0x165667B19E3779F9);
+	const U64 PRIME64_4 = U64L(0x85EBCA77C2B2AE63);
+	const U64 PRIME64_5 = U64L(0x27D4EB2F165667C5);
+
+	inline U64 rotl64(U64 value, S32 bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline U64 xxh64_round(U64 acc, U64 input)
+	{
+		acc += input * PRIME64_2;
+		acc = rotl64(acc, 31);
+		return acc * PRIME64_1;
+	}
+
+	inline U64 xxh64_merge(U64 acc, U64 value)
+	{
+		acc ^= xxh64_round(0, value);
+		return acc * PRIME64_1 + PRIME64_4;
+	}
+}
+
+U32 ll_crc32c_portable(const void* data, size_t size, U32 crc)
+{
+	if (!sCRCTableReady)
+	{
+		init_crc_table();
+	}
+
+	const U8* p = (const U8*)data;
+	crc = ~crc;
+	while (size && ((size_t)p & 7))
+	{
+		crc = (crc >> 8) ^ sCRCTable[0][(crc ^ *p++) & 0xFF];
+		size--;
+	}
+	while (size >= 8)
+	{
+		// Little endian, as every platform the viewer runs on is
+		U32 low = read32(p) ^ crc;
+		U32 high = read32(p + 4);
+		crc = sCRCTable[7][low & 0xFF] ^
+			  sCRCTable[6][(low >> 8) & 0xFF] ^
+			  sCRCTable[5][(low >> 16) & 0xFF] ^
+			  sCRCTable[4][low >> 24] ^
+			  sCRCTable[3][high & 0xFF] ^
+			  sCRCTable[2][(high >> 8) & 0xFF] ^
+			  sCRCTable[1][(high >> 16) & 0xFF] ^
+			  sCRCTable[0][high >> 24];
+		p += 8;
+		size -= 8;
+	}
+	while (size--)
+	{
+		crc = (crc >> 8) ^ sCRCTable[0][(crc ^ *p++) & 0xFF];
+	}
+	return ~crc;
+}
+
+bool ll_crc32c_hardware()
+{
+#if LL_CRC32C_HARDWARE
+	static bool has_sse42 = cpu_has_sse42();
+	return has_sse42;
+#else
+	return false;
+#endif
+}
+
+U32 ll_crc32c(const void* data, size_t size, U32 crc)
+{
+	if (!sCRC32C)
+	{
+		// Called during static initialization, before sCRC32C was set.
+		// Every caller picks the same one.
+		sCRC32C = pick_crc32c();
+	}
+	return sCRC32C(data, size, crc);
+}
+
+U64 ll_hash64(const void* data, size_t size, U64 seed)
+{
+	const U8* p = (const U8*)data;
+	const U8* end = p + size;
+	U64 hash;
+
+	if (size >= 32)
+	{
+		U64 v1 = seed + PRIME64_1 + PRIME64_2;
+		U64 v2 = seed + PRIME64_2;
+		U64 v3 = seed;
+		U64 v4 = seed - PRIME64_1;
+		const U8* limit = end - 32;
+		do
+		{
+			v1 = xxh64_round(v1, read64(p));
+			v2 = xxh64_round(v2, read64(p + 8));
+			v3 = xxh64_round(v3, read64(p + 16));
+			v4 = xxh64_round(v4, read64(p + 24));
+			p += 32;
+		}
+		while (p <= limit);
+
+		hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		hash = xxh64_merge(hash, v1);
+		hash = xxh64_merge(hash, v2);
+		hash = xxh64_merge(hash, v3);
+		hash = xxh64_merge(hash, v4);
+	}
+	else
+	{
+		hash = seed + PRIME64_5;
+	}
+
+	hash += (U64)size;
+
+	while (p + 8 <= end)
+	{
+		hash ^= xxh64_round(0, read64(p));
+		hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		hash ^= (U64)read32(p) * PRIME64_1;
+		hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		hash ^= (U64)(*p) * PRIME64_5;
+		hash = rotl64(hash, 11) * PRIME64_1;
+		p++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file llfasthash.h
+ * @brief CRC32C and 64 bit non cryptographic hashing for cache
+ * validation and hash containers.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFASTHASH_H
+#define LL_LLFASTHASH_H
+
+#include <cstddef>
+#include <string.h>
+
+#include "stdtypes.h"
+#include "llpreprocessor.h"
+
+//============================================================================
+// CRC32C (Castagnoli), the checksum SSE4.2 computes in hardware.  Use this
+// rather than LLCRC to check that data read back from disk is what was
+// written; it is several times faster in software and many times faster
+// with the instruction, which is picked at run time when the CPU has it.
+//
+// Pass the previous result as crc to checksum data in pieces:
+//
+//	U32 crc = ll_crc32c(header, header_size);
+//	crc = ll_crc32c(body, body_size, crc);
+
+LL_COMMON_API U32 ll_crc32c(const void* data, size_t size, U32 crc = 0);
+
+// The table driven version ll_crc32c() falls back on, and whether it has to.
+LL_COMMON_API U32 ll_crc32c_portable(const void* data, size_t size, U32 crc = 0);
+LL_COMMON_API bool ll_crc32c_hardware();
+
+//============================================================================
+// XXH64, a 64 bit hash with good distribution for hash tables and content
+// identities that don't have to stand up to an attacker.  The results are
+// the same on every platform, so they may be stored.
+
+LL_COMMON_API U64 ll_hash64(const void* data, size_t size, U64 seed = 0);
+
+// ll_hash64() of exactly 16 bytes, inline for hash containers keyed on
+// LLUUID.  Same result.
+inline U64 ll_hash64_16(const void* data)
+{
+	const U64 PRIME64_1 = U64L(0x9E3779B185EBCA87);
+	const U64 PRIME64_2 = U64L(0xC2B2AE3D27D4EB4F);
+	const U64 PRIME64_3 = U64L(0x165667B19E3779F9);
+	const U64 PRIME64_4 = U64L(0x85EBCA77C2B2AE63);
+	const U64 PRIME64_5 = U64L(0x27D4EB2F165667C5);
+
+	U64 words[2];
+	memcpy(words, data, sizeof(words));
+	U64 hash = PRIME64_5 + 16;
+	for (S32 i = 0; i < 2; i++)
+	{
+		U64 k = words[i] * PRIME64_2;
+		k = ((k << 31) | (k >> 33)) * PRIME64_1;
+		hash ^= k;
+		hash = ((hash << 27) | (hash >> 37)) * PRIME64_1 + PRIME64_4;
+	}
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+#endif // LL_LLFASTHASH_H
@@ -27,11 +27,13 @@
 
 #include "llfasttimer.h"
 
+#include "llfile.h"
 #include "llmemory.h"
 #include "llprocessor.h"
 #include "llsingleton.h"
 #include "lltreeiterators.h"
 #include "llsdserialize.h"
+#include "llthread.h"
 
 #include <boost/bind.hpp>
 
@@ -76,6 +78,17 @@ std::vector<LLFastTimer::FrameState>* LLFastTimer::sTimerInfos = NULL;
 U64				LLFastTimer::sTimerCycles = 0;
 U32				LLFastTimer::sTimerCalls = 0;
 
+volatile bool	LLFastTimer::sTracing = false;
+U32				LLFastTimer::sTraceCapacity = LLFastTimer::DEFAULT_TRACE_EVENTS;
+U64				LLFastTimer::sTraceStartTime = 0;
+S32				LLFastTimer::sTraceFramesLeft = 0;
+std::string		LLFastTimer::sTraceFilename;
+U32				LLFastTimer::sMainThreadID = LLThread::currentID();
+LLFastTimer::ThreadTrace* volatile LLFastTimer::sThreadTraces = NULL;
+
+static ll_thread_local LLFastTimer::ThreadTrace* sThreadTrace = NULL;
+static volatile apr_uint32_t sNextThreadTraceIndex = 0;
+
 
 // FIXME: move these declarations to the relevant modules
 
@@ -700,6 +713,19 @@ void LLFastTimer::nextFrame()
 		llinfos << "Slow frame, fast timers inaccurate" << llendl;
 	}
 
+	if (sTraceFramesLeft > 0 && --sTraceFramesLeft == 0)
+	{
+		writeTrace(sTraceFilename);
+		stopTrace();
+	}
+	if (sTracing)
+	{
+		// Frames show up as spans on the main thread
+		ThreadTrace* thread_trace = getThreadTrace();
+		thread_trace->record(NULL);
+		thread_trace->record(&NamedTimer::getRootNamedTimer());
+	}
+
 	if (sPauseHistory)
 	{
 		sResetHistory = true;
@@ -781,7 +807,8 @@ const LLFastTimer::NamedTimer* LLFastTimer::getTimerByName(const std::string& na
 }
 
 LLFastTimer::LLFastTimer(LLFastTimer::FrameState* state)
-:	mFrameState(state)
+:	mFrameState(state),
+	mThreadTrace(NULL)
 {
 	U32 start_time = getCPUClockCount32();
 	mStartTime = start_time;
@@ -793,6 +820,226 @@ LLFastTimer::LLFastTimer(LLFastTimer::FrameState* state)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Trace capture
+
+LLFastTimer::ThreadTrace::ThreadTrace(bool main_thread)
+:	mMainThread(main_thread),
+	mIndex((S32)apr_atomic_inc32(&sNextThreadTraceIndex)),
+	mEvents(NULL),
+	mMask(0),
+	mHead(0),
+	mStartIndex(0),
+	mNext(NULL)
+{
+	mName = main_thread ? std::string("Main") : llformat("Thread %d", mIndex);
+}
+
+// OWNING THREAD
+void LLFastTimer::ThreadTrace::record(const NamedTimer* timer)
+{
+	if (!mEvents)
+	{
+		// Sized on first use, later startTrace() calls don't resize it.
+		mMask = sTraceCapacity - 1;
+		mEvents = new Event[sTraceCapacity];
+	}
+	U32 head = mHead;
+	Event& event = mEvents[head & mMask];
+	event.mTime = getCPUClockCount64();
+	event.mTimer = timer;
+	// Full barrier, so a reader that sees the new head sees the event.
+	apr_atomic_cas32((volatile apr_uint32_t*)&mHead, head + 1, head);
+}
+
+void LLFastTimer::ThreadTrace::getEvents(std::vector<Event>& events)
+{
+	U32 head = apr_atomic_read32((volatile apr_uint32_t*)&mHead);
+	Event* buffer = mEvents;
+	if (!buffer)
+	{
+		return;
+	}
+	U32 capacity = mMask + 1;
+	U32 first = llmax((U32)mStartIndex, head > capacity ? head - capacity : 0);
+	size_t offset = events.size();
+	for (U32 i = first; i < head; i++)
+	{
+		events.push_back(buffer[i & mMask]);
+	}
+
+	// Drop whatever the owner may have overwritten while we were copying.
+	U32 new_head = apr_atomic_read32((volatile apr_uint32_t*)&mHead);
+	U32 overwritten = new_head >= capacity ? new_head - capacity + 1 : 0;
+	if (overwritten > first)
+	{
+		size_t count = llmin((size_t)(overwritten - first), events.size() - offset);
+		events.erase(events.begin() + offset, events.begin() + offset + count);
+	}
+}
+
+//static
+LLFastTimer::ThreadTrace* LLFastTimer::getThreadTrace()
+{
+	if (!sThreadTrace)
+	{
+		ThreadTrace* thread_trace = new ThreadTrace(LLThread::currentID() == sMainThreadID);
+		thread_trace->mStartIndex = 0;
+		ThreadTrace* head;
+		do
+		{
+			head = sThreadTraces;
+			thread_trace->mNext = head;
+		}
+		while (apr_atomic_casptr((volatile void**)&sThreadTraces, thread_trace, head) != head);
+		sThreadTrace = thread_trace;
+	}
+	return sThreadTrace;
+}
+
+//static
+void LLFastTimer::setThreadName(const std::string& name)
+{
+	getThreadTrace()->mName = name;
+}
+
+//static
+void LLFastTimer::startTrace(U32 events_per_thread)
+{
+	U32 capacity = 1;
+	while (capacity < events_per_thread)
+	{
+		capacity <<= 1;
+	}
+	sTraceCapacity = capacity;
+	for (ThreadTrace* thread_trace = sThreadTraces; thread_trace; thread_trace = thread_trace->mNext)
+	{
+		thread_trace->mStartIndex = thread_trace->mHead;
+	}
+	sTraceStartTime = getCPUClockCount64();
+	sTracing = true;
+}
+
+//static
+void LLFastTimer::stopTrace()
+{
+	sTracing = false;
+	sTraceFramesLeft = 0;
+}
+
+//static
+void LLFastTimer::captureTraceFrames(S32 frames, const std::string& filename)
+{
+	llinfos << "Capturing a timer trace of " << frames << " frames to " << filename << llendl;
+	sTraceFilename = filename;
+	startTrace();
+	sTraceFramesLeft = llmax(frames, 1);
+}
+
+static void write_trace_string(std::ostream& os, const std::string& str)
+{
+	os << '"';
+	for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+	{
+		if (*it == '"' || *it == '\\')
+		{
+			os << '\\';
+		}
+		if ((U8)*it >= 0x20)
+		{
+			os << *it;
+		}
+	}
+	os << '"';
+}
+
+//static
+void LLFastTimer::writeTrace(std::ostream& os)
+{
+	U64 now = getCPUClockCount64();
+	F64 usec_per_count = 1000000.0 / (F64)(countsPerSecond() << 8);
+	std::ios::fmtflags old_flags = os.flags(std::ios::fixed);
+	std::streamsize old_precision = os.precision(3);
+
+	os << "{\"traceEvents\":[\n";
+	bool first = true;
+	std::vector<ThreadTrace::Event> events;
+	std::vector<ThreadTrace::Event> stack;
+	for (ThreadTrace* thread_trace = sThreadTraces; thread_trace; thread_trace = thread_trace->mNext)
+	{
+		events.clear();
+		thread_trace->getEvents(events);
+		if (events.empty())
+		{
+			continue;
+		}
+
+		if (!first)
+		{
+			os << ",\n";
+		}
+		first = false;
+		os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_trace->mIndex
+		   << ",\"args\":{\"name\":";
+		write_trace_string(os, thread_trace->getName());
+		os << "}}";
+
+		// Pair up begins and ends into complete events.  An end whose
+		// begin has been dropped is ignored, a begin with no end yet runs
+		// until now.
+		stack.clear();
+		for (U32 i = 0; i <= events.size(); i++)
+		{
+			bool at_end = (i == events.size());
+			if (!at_end && events[i].mTimer)
+			{
+				stack.push_back(events[i]);
+				continue;
+			}
+			if (stack.empty())
+			{
+				if (at_end)
+				{
+					break;
+				}
+				continue;
+			}
+			U64 end_time = at_end ? now : events[i].mTime;
+			do
+			{
+				const ThreadTrace::Event& begin = stack.back();
+				U64 start_time = llmax(begin.mTime, sTraceStartTime);
+				os << ",\n{\"name\":";
+				write_trace_string(os, begin.mTimer->getName());
+				os << ",\"cat\":\"timer\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_trace->mIndex
+				   << ",\"ts\":" << (F64)(start_time - sTraceStartTime) * usec_per_count
+				   << ",\"dur\":" << (F64)(end_time > start_time ? end_time - start_time : 0) * usec_per_count
+				   << "}";
+				stack.pop_back();
+			}
+			while (at_end && !stack.empty());
+		}
+	}
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	os.flags(old_flags);
+	os.precision(old_precision);
+}
+
+//static
+bool LLFastTimer::writeTrace(const std::string& filename)
+{
+	llofstream os(filename);
+	if (!os.is_open())
+	{
+		llwarns << "Unable to write timer trace to " << filename << llendl;
+		return false;
+	}
+	writeTrace(os);
+	llinfos << "Wrote timer trace to " << filename << llendl;
+	return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Important note: These implementations must be FAST!
@@ -918,18 +1165,18 @@ std::string LLFastTimer::sClockType = "clock_gettime";
 #if (LL_LINUX || LL_SOLARIS || LL_DARWIN) && (defined(__i386__) || defined(__amd64__))
 //
 // Mac+Linux+Solaris FAST x86 implementation of CPU clock
+// "=A" only means edx:eax on i386, on amd64 it leaves rdx clobbered behind
+// the compiler's back, so take the halves separately.
 U32 LLFastTimer::getCPUClockCount32()
 {
-	U64 x;
-	__asm__ volatile (".byte 0x0f, 0x31": "=A"(x));
-	return (U32)(x >> 8);
+	return (U32)(getCPUClockCount64() >> 8);
 }
 
 U64 LLFastTimer::getCPUClockCount64()
 {
-	U64 x;
-	__asm__ volatile (".byte 0x0f, 0x31": "=A"(x));
-	return x;
+	U32 lo, hi;
+	__asm__ volatile (".byte 0x0f, 0x31": "=a"(lo), "=d"(hi));
+	return ((U64)hi << 32) | lo;
 }
 
 std::string LLFastTimer::sClockType = "rdtsc";
@@ -31,7 +31,6 @@
 
 #define FAST_TIMER_ON 1
 #define TIME_FAST_TIMERS 0
-#define DEBUG_FAST_TIMER_THREADS 1
 
 class LLMutex;
 
@@ -44,6 +43,7 @@ class LL_COMMON_API LLFastTimer
 {
 public:
 	class NamedTimer;
+	class ThreadTrace;
 
 	struct LL_COMMON_API FrameState
 	{
@@ -151,38 +151,84 @@ public:
 		FrameState*		mFrameState;
 	};
 
+	// Every thread that uses a timer gets one of these.  While a trace is
+	// being captured each timer records a begin and an end event in the
+	// ring buffer of the thread it runs on, so the buffer is only ever
+	// written by its own thread and dumps can read it without locking.
+	// Timers on threads other than the main one only record trace events,
+	// the per frame statistics and LLFastTimerView are main thread only.
+	class LL_COMMON_API ThreadTrace
+	{
+		friend class LLFastTimer;
+	public:
+		struct Event
+		{
+			U64					mTime;	// getCPUClockCount64()
+			const NamedTimer*	mTimer;	// NULL ends the innermost timer
+		};
+
+		bool isMainThread() const { return mMainThread; }
+		const std::string& getName() const { return mName; }
+
+		// OWNING THREAD
+		void record(const NamedTimer* timer);
+
+		// Any thread, copies out the events recorded since startTrace()
+		void getEvents(std::vector<Event>& events);
+
+	private:
+		ThreadTrace(bool main_thread);
+
+		bool			mMainThread;
+		S32				mIndex;
+		std::string		mName;
+		Event* volatile	mEvents;		// allocated by the owning thread on first use
+		U32				mMask;
+		volatile U32	mHead;			// events ever recorded
+		volatile U32	mStartIndex;	// first event of the current trace
+		ThreadTrace*	mNext;			// all traces, newest first
+	};
+
 public:
 	LLFastTimer(LLFastTimer::FrameState* state);
 
 	LL_FORCE_INLINE LLFastTimer(LLFastTimer::DeclareTimer& timer)
-	:	mFrameState(timer.mFrameState)
+	:	mFrameState(timer.mFrameState),
+		mThreadTrace(getThreadTrace())
 	{
 #if TIME_FAST_TIMERS
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		mStartTime = getCPUClockCount32();
-
-		frame_state->mActiveCount++;
-		frame_state->mCalls++;
-		// keep current parent as long as it is active when we are
-		frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
-
-		LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
-		mLastTimerData = *cur_timer_data;
-		cur_timer_data->mCurTimer = this;
-		cur_timer_data->mFrameState = frame_state;
-		cur_timer_data->mChildTime = 0;
+		if (sTracing)
+		{
+			mThreadTrace->record(&timer.mTimer);
+		}
+		if (mThreadTrace->isMainThread())
+		{
+			LLFastTimer::FrameState* frame_state = mFrameState;
+			mStartTime = getCPUClockCount32();
+
+			frame_state->mActiveCount++;
+			frame_state->mCalls++;
+			// keep current parent as long as it is active when we are
+			frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
+
+			LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
+			mLastTimerData = *cur_timer_data;
+			cur_timer_data->mCurTimer = this;
+			cur_timer_data->mFrameState = frame_state;
+			cur_timer_data->mChildTime = 0;
+		}
+		else
+		{
+			// trace only
+			mFrameState = NULL;
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
 		sTimerCycles += timer_end - timer_start;
-#endif
-#if DEBUG_FAST_TIMER_THREADS
-#if !LL_RELEASE
-		assert_main_thread();
-#endif
 #endif
 	}
 
@@ -192,20 +238,27 @@ public:
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		U32 total_time = getCPUClockCount32() - mStartTime;
-
-		frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
-		frame_state->mActiveCount--;
-
-		// store last caller to bootstrap tree creation
-		// do this in the destructor in case of recursion to get topmost caller
-		frame_state->mLastCaller = mLastTimerData.mFrameState;
-
-		// we are only tracking self time, so subtract our total time delta from parents
-		mLastTimerData.mChildTime += total_time;
-
-		LLFastTimer::sCurTimerData = mLastTimerData;
+		if (sTracing && mThreadTrace)
+		{
+			mThreadTrace->record(NULL);
+		}
+		if (mFrameState)
+		{
+			LLFastTimer::FrameState* frame_state = mFrameState;
+			U32 total_time = getCPUClockCount32() - mStartTime;
+
+			frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
+			frame_state->mActiveCount--;
+
+			// store last caller to bootstrap tree creation
+			// do this in the destructor in case of recursion to get topmost caller
+			frame_state->mLastCaller = mLastTimerData.mFrameState;
+
+			// we are only tracking self time, so subtract our total time delta from parents
+			mLastTimerData.mChildTime += total_time;
+
+			LLFastTimer::sCurTimerData = mLastTimerData;
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
@@ -246,6 +299,22 @@ public:
 	static void writeLog(std::ostream& os);
 	static const NamedTimer* getTimerByName(const std::string& name);
 
+	// Trace capture, covers timers on every thread.
+	enum { DEFAULT_TRACE_EVENTS = 65536 };
+	static void startTrace(U32 events_per_thread = DEFAULT_TRACE_EVENTS);
+	static void stopTrace();
+	static bool isTracing() { return sTracing; }
+	// Writes what has been recorded since startTrace() in the Chrome trace
+	// event format, for chrome://tracing or Perfetto.  Older events are
+	// dropped once a thread's ring buffer wraps.
+	static void writeTrace(std::ostream& os);
+	static bool writeTrace(const std::string& filename);
+	// Traces the next frames frames and writes them to filename, no UI needed.
+	static void captureTraceFrames(S32 frames, const std::string& filename);
+	// Names the calling thread in traces, LLThread does this for its own.
+	static void setThreadName(const std::string& name);
+	static ThreadTrace* getThreadTrace();
+
 	struct CurTimerData
 	{
 		LLFastTimer*	mCurTimer;
@@ -260,13 +329,22 @@ private:
 	static U64 getCPUClockCount64();
 	static U64 sClockResolution;
 
+	static volatile bool	sTracing;
+	static U32				sTraceCapacity;
+	static U64				sTraceStartTime;
+	static S32				sTraceFramesLeft;
+	static std::string		sTraceFilename;
+	static U32				sMainThreadID;
+	static ThreadTrace* volatile sThreadTraces;
+
 	static S32				sCurFrameIndex;
 	static S32				sLastFrameIndex;
 	static U64				sLastFrameTime;
 	static info_list_t*		sTimerInfos;
 
 	U32							mStartTime;
-	LLFastTimer::FrameState*	mFrameState;
+	LLFastTimer::FrameState*	mFrameState;	// NULL off the main thread
+	ThreadTrace*				mThreadTrace;
 	LLFastTimer::CurTimerData	mLastTimerData;
 
 };
@@ -0,0 +1,237 @@
+/**
+ * @file llindexedpriqueue.h
+ * @brief Binary heap priority queue that can find, reprioritize and
+ * remove any of its elements in O(log n).
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINDEXEDPRIQUEUE_H
+#define LL_LLINDEXEDPRIQUEUE_H
+
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+//
+// Max-heap of (priority, data) pairs plus a map from each datum to its
+// slot in the heap, so that unlike LLPriQueueMap a reprioritize or an
+// erase doesn't have to search for the element first.  Elements of equal
+// priority come out in the order they were pushed.  DATA_TYPE has to be
+// hashable by boost::hash and may only be on the queue once.
+//
+
+template <class DATA_TYPE>
+class LLIndexedPriQueue
+{
+public:
+	LLIndexedPriQueue() : mNextSequence(0)
+	{
+	}
+
+	void push(const F32 priority, DATA_TYPE data)
+	{
+		if (mIndex.find(data) != mIndex.end())
+		{
+			llerrs << "Pushing already existing data onto queue!" << llendl;
+			return;
+		}
+		Entry entry;
+		entry.mPriority = priority;
+		entry.mSequence = mNextSequence++;
+		entry.mData = data;
+		mHeap.push_back(entry);
+		mIndex[data] = (S32)mHeap.size() - 1;
+		siftUp((S32)mHeap.size() - 1);
+	}
+
+	BOOL pop(DATA_TYPE *datap)
+	{
+		if (mHeap.empty())
+		{
+			return FALSE;
+		}
+		*datap = mHeap[0].mData;
+		removeAt(0);
+		return TRUE;
+	}
+
+	// Highest priority element, only valid if the queue isn't empty.
+	DATA_TYPE top() const
+	{
+		return mHeap[0].mData;
+	}
+
+	BOOL reprioritize(const F32 new_priority, DATA_TYPE data)
+	{
+		typename index_map_t::iterator iter = mIndex.find(data);
+		if (iter == mIndex.end())
+		{
+			return FALSE;
+		}
+		S32 slot = iter->second;
+		F32 old_priority = mHeap[slot].mPriority;
+		mHeap[slot].mPriority = new_priority;
+		if (new_priority > old_priority)
+		{
+			siftUp(slot);
+		}
+		else
+		{
+			siftDown(slot);
+		}
+		return TRUE;
+	}
+
+	BOOL erase(DATA_TYPE data)
+	{
+		typename index_map_t::iterator iter = mIndex.find(data);
+		if (iter == mIndex.end())
+		{
+			return FALSE;
+		}
+		removeAt(iter->second);
+		return TRUE;
+	}
+
+	bool contains(DATA_TYPE data) const
+	{
+		return mIndex.find(data) != mIndex.end();
+	}
+
+	S32 getLength() const
+	{
+		return (S32)mHeap.size();
+	}
+
+	bool empty() const
+	{
+		return mHeap.empty();
+	}
+
+	void clear()
+	{
+		mHeap.clear();
+		mIndex.clear();
+	}
+
+	// For walking every element, in no particular order.
+	DATA_TYPE getData(const S32 i) const
+	{
+		return mHeap[i].mData;
+	}
+
+private:
+	struct Entry
+	{
+		F32			mPriority;
+		U32			mSequence;
+		DATA_TYPE	mData;
+	};
+	typedef boost::unordered_map<DATA_TYPE, S32> index_map_t;
+
+	// TRUE if a should come out of the queue before b.
+	static bool before(const Entry &a, const Entry &b)
+	{
+		if (a.mPriority != b.mPriority)
+		{
+			return a.mPriority > b.mPriority;
+		}
+		return (S32)(a.mSequence - b.mSequence) < 0;
+	}
+
+	void place(S32 slot, const Entry &entry)
+	{
+		mHeap[slot] = entry;
+		mIndex[entry.mData] = slot;
+	}
+
+	void siftUp(S32 slot)
+	{
+		Entry entry = mHeap[slot];
+		while (slot > 0)
+		{
+			S32 parent = (slot - 1) / 2;
+			if (!before(entry, mHeap[parent]))
+			{
+				break;
+			}
+			place(slot, mHeap[parent]);
+			slot = parent;
+		}
+		place(slot, entry);
+	}
+
+	void siftDown(S32 slot)
+	{
+		Entry entry = mHeap[slot];
+		S32 count = (S32)mHeap.size();
+		while (true)
+		{
+			S32 child = 2 * slot + 1;
+			if (child >= count)
+			{
+				break;
+			}
+			if ((child + 1 < count) && before(mHeap[child + 1], mHeap[child]))
+			{
+				child++;
+			}
+			if (!before(mHeap[child], entry))
+			{
+				break;
+			}
+			place(slot, mHeap[child]);
+			slot = child;
+		}
+		place(slot, entry);
+	}
+
+	void removeAt(S32 slot)
+	{
+		mIndex.erase(mHeap[slot].mData);
+		S32 last = (S32)mHeap.size() - 1;
+		if (slot != last)
+		{
+			Entry moved = mHeap[last];
+			mHeap.pop_back();
+			place(slot, moved);
+			if ((slot > 0) && before(moved, mHeap[(slot - 1) / 2]))
+			{
+				siftUp(slot);
+			}
+			else
+			{
+				siftDown(slot);
+			}
+		}
+		else
+		{
+			mHeap.pop_back();
+		}
+	}
+
+	std::vector<Entry>	mHeap;
+	index_map_t			mIndex;
+	U32					mNextSequence;
+};
+
+#endif // LL_LLINDEXEDPRIQUEUE_H
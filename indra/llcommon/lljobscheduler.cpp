@@ -0,0 +1,551 @@
+/**
+ * @file lljobscheduler.cpp
+ * @brief Process wide pool of worker threads with work stealing and
+ * priority lanes.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lljobscheduler.h"
+
+#include <algorithm>
+
+#include "llqueuedthread.h"
+#include "lltimer.h"	// ms_sleep(), totalTime()
+
+#if LL_WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// LLParallelFor has as many helpers
+const S32 MAX_JOB_WORKERS = 16;
+
+//============================================================================
+
+LLJobScheduler::Worker::Worker(LLJobScheduler* scheduler, S32 index) :
+	LLThread(llformat("JobWorker%d", index)),
+	mLock(NULL),
+	mOSThreadID(0),
+	mScheduler(scheduler),
+	mIndex(index)
+{
+}
+
+// virtual
+void LLJobScheduler::Worker::run()
+{
+	mOSThreadID = LLThread::currentID();
+	while (!mScheduler->mQuitting)
+	{
+		lane_t lane;
+		bool stolen;
+		LLJob* job = mScheduler->takeJob(mIndex, lane, stolen);
+		if (!job)
+		{
+			mScheduler->waitForWork();
+			continue;
+		}
+
+		U64 start = totalTime();
+		job->run();
+		U64 elapsed = totalTime() - start;
+
+		mLock.lock();
+		mStats[lane].mJobsRun++;
+		mStats[lane].mBusyTime += elapsed;
+		if (stolen)
+		{
+			mStats[lane].mJobsStolen++;
+		}
+		mLock.unlock();
+	}
+}
+
+//============================================================================
+
+LLJobScheduler::LLJobScheduler() :
+	mWorkCondition(new LLCondition(NULL)),
+	mDoneCondition(new LLCondition(NULL)),
+	mDroppedLock(NULL),
+	mNumQueued(0),
+	mNextWorker(0),
+	mQuitting(0),
+	mLeakedWorkers(false),
+	mStatsStartTime(0)
+{
+}
+
+LLJobScheduler::~LLJobScheduler()
+{
+	stop();
+	// A leaked worker may still be in a job that signals or waits on these
+	if (!mLeakedWorkers)
+	{
+		delete mWorkCondition;
+		delete mDoneCondition;
+	}
+}
+
+// MAIN THREAD
+void LLJobScheduler::start(S32 num_workers)
+{
+	if (isRunning())
+	{
+		return;
+	}
+	if (num_workers <= 0)
+	{
+		num_workers = getNumCores() - 1;
+	}
+	num_workers = llclamp(num_workers, 1, MAX_JOB_WORKERS);
+
+	mQuitting = 0;
+	mNumQueued = 0;
+	for (S32 i = 0; i < num_workers; i++)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+	resetStats();
+	// Only start them once mWorkers is complete, they steal from each other.
+	for (S32 i = 0; i < num_workers; i++)
+	{
+		mWorkers[i]->start();
+	}
+	llinfos << "Job scheduler started with " << num_workers << " workers" << llendl;
+}
+
+// MAIN THREAD
+void LLJobScheduler::stop()
+{
+	if (!isRunning())
+	{
+		return;
+	}
+	mQuitting = 1;
+	mWorkCondition->lock();
+	mWorkCondition->broadcast();
+	mWorkCondition->unlock();
+
+	for (S32 i = 0; i < (S32)mWorkers.size(); i++)
+	{
+		S32 timeout = 100;
+		while (!mWorkers[i]->isStopped() && timeout-- > 0)
+		{
+			ms_sleep(10);
+		}
+		if (!mWorkers[i]->isStopped())
+		{
+			// Lanes and all, it still uses them once its job returns
+			llwarns << "Job worker " << i << " did not stop, leaking it" << llendl;
+			mLeakedWorkers = true;
+			continue;
+		}
+		// Kept for cancel(), whoever waits for them can still take them back
+		mDroppedLock.lock();
+		for (S32 l = 0; l < NUM_LANES; l++)
+		{
+			std::deque<LLJob*>& jobs = mWorkers[i]->mLanes[l];
+			mDropped.insert(mDropped.end(), jobs.begin(), jobs.end());
+		}
+		mDroppedLock.unlock();
+		delete mWorkers[i];
+	}
+	mWorkers.clear();
+}
+
+void LLJobScheduler::submit(LLJob* job, lane_t lane)
+{
+	push(job, lane, false);
+}
+
+void LLJobScheduler::requeue(LLJob* job, lane_t lane)
+{
+	// The owner pops from the back, so the front is the end of its line.
+	// Thieves take from the front, which is fine, they have nothing
+	// better to do.
+	push(job, lane, true);
+}
+
+bool LLJobScheduler::cancel(LLJob* job)
+{
+	for (S32 i = 0; i < (S32)mWorkers.size(); i++)
+	{
+		Worker* worker = mWorkers[i];
+		worker->mLock.lock();
+		for (S32 l = 0; l < NUM_LANES; l++)
+		{
+			std::deque<LLJob*>& jobs = worker->mLanes[l];
+			std::deque<LLJob*>::iterator iter = std::find(jobs.begin(), jobs.end(), job);
+			if (iter != jobs.end())
+			{
+				jobs.erase(iter);
+				worker->mLock.unlock();
+				mNumQueued--;
+				return true;
+			}
+		}
+		worker->mLock.unlock();
+	}
+
+	bool dropped = false;
+	mDroppedLock.lock();
+	std::vector<LLJob*>::iterator iter = std::find(mDropped.begin(), mDropped.end(), job);
+	if (iter != mDropped.end())
+	{
+		mDropped.erase(iter);
+		dropped = true;
+	}
+	mDroppedLock.unlock();
+	return dropped;
+}
+
+S32 LLJobScheduler::getSubmitWorker()
+{
+	// Work queued from a worker stays on it, the cache is warm.
+	U32 thread_id = LLThread::currentID();
+	for (S32 i = 0; i < (S32)mWorkers.size(); i++)
+	{
+		if (mWorkers[i]->mOSThreadID == thread_id)
+		{
+			return i;
+		}
+	}
+	return (S32)(mNextWorker++ % (U32)mWorkers.size());
+}
+
+void LLJobScheduler::push(LLJob* job, lane_t lane, bool at_front)
+{
+	llassert_always(isRunning());
+
+	Worker* worker = mWorkers[getSubmitWorker()];
+	worker->mLock.lock();
+	if (at_front)
+	{
+		worker->mLanes[lane].push_front(job);
+	}
+	else
+	{
+		worker->mLanes[lane].push_back(job);
+	}
+	worker->mLock.unlock();
+	mNumQueued++;
+
+	mWorkCondition->lock();
+	mWorkCondition->signal();
+	mWorkCondition->unlock();
+}
+
+LLJob* LLJobScheduler::takeJob(S32 worker_index, lane_t& lane, bool& stolen)
+{
+	if (mNumQueued <= 0)
+	{
+		return NULL;
+	}
+
+	S32 num_workers = (S32)mWorkers.size();
+	for (S32 l = 0; l < NUM_LANES; l++)
+	{
+		for (S32 i = 0; i < num_workers; i++)
+		{
+			S32 victim = (worker_index + i) % num_workers;
+			Worker* worker = mWorkers[victim];
+			LLJob* job = NULL;
+			worker->mLock.lock();
+			std::deque<LLJob*>& jobs = worker->mLanes[l];
+			if (!jobs.empty())
+			{
+				if (i == 0)
+				{
+					// Own work, newest first
+					job = jobs.back();
+					jobs.pop_back();
+				}
+				else
+				{
+					// Someone else's, oldest first
+					job = jobs.front();
+					jobs.pop_front();
+				}
+			}
+			worker->mLock.unlock();
+			if (job)
+			{
+				mNumQueued--;
+				lane = (lane_t)l;
+				stolen = (i != 0);
+				return job;
+			}
+		}
+	}
+	return NULL;
+}
+
+void LLJobScheduler::waitForWork()
+{
+	mWorkCondition->lock();
+	// submit() bumps mNumQueued before it takes the lock to signal, so
+	// checking it here under the lock can't miss a wakeup.
+	while (mNumQueued <= 0 && !mQuitting)
+	{
+		mWorkCondition->wait();
+	}
+	mWorkCondition->unlock();
+}
+
+void LLJobScheduler::finished(LLAtomicS32& pending)
+{
+	// The waiter may delete the job as soon as the lock is let go of
+	mDoneCondition->lock();
+	pending = 0;
+	mDoneCondition->broadcast();
+	mDoneCondition->unlock();
+}
+
+void LLJobScheduler::waitFor(LLAtomicS32& pending)
+{
+	mDoneCondition->lock();
+	while (pending > 0)
+	{
+		mDoneCondition->wait();
+	}
+	mDoneCondition->unlock();
+}
+
+//static
+LLJobScheduler::lane_t LLJobScheduler::getLaneForPriority(U32 priority)
+{
+	if (priority >= LLQueuedThread::PRIORITY_URGENT)
+	{
+		return LANE_URGENT;
+	}
+	if (priority >= LLQueuedThread::PRIORITY_HIGH)
+	{
+		return LANE_HIGH;
+	}
+	if (priority >= LLQueuedThread::PRIORITY_NORMAL)
+	{
+		return LANE_NORMAL;
+	}
+	return LANE_LOW;
+}
+
+//static
+const char* LLJobScheduler::getLaneName(lane_t lane)
+{
+	static const char* names[NUM_LANES] = { "Urgent", "High", "Normal", "Low" };
+	return names[lane];
+}
+
+//static
+S32 LLJobScheduler::getNumCores()
+{
+	S32 cores = 1;
+#if LL_WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	cores = (S32)info.dwNumberOfProcessors;
+#else
+	cores = (S32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return llmax(cores, 1);
+}
+
+LLJobScheduler::LaneStats LLJobScheduler::getLaneStats(lane_t lane) const
+{
+	LaneStats total;
+	for (S32 i = 0; i < (S32)mWorkers.size(); i++)
+	{
+		Worker* worker = mWorkers[i];
+		worker->mLock.lock();
+		const LaneStats& stats = worker->mStats[lane];
+		total.mJobsRun += stats.mJobsRun;
+		total.mJobsStolen += stats.mJobsStolen;
+		total.mBusyTime += stats.mBusyTime;
+		total.mQueued += (S32)worker->mLanes[lane].size();
+		worker->mLock.unlock();
+	}
+	return total;
+}
+
+F32 LLJobScheduler::getLaneUtilization(lane_t lane) const
+{
+	U64 elapsed = totalTime() - mStatsStartTime;
+	if (!elapsed || mWorkers.empty())
+	{
+		return 0.f;
+	}
+	LaneStats stats = getLaneStats(lane);
+	return (F32)((F64)stats.mBusyTime / ((F64)elapsed * (F64)mWorkers.size()));
+}
+
+LLSD LLJobScheduler::getStats() const
+{
+	LLSD stats;
+	stats["workers"] = getNumWorkers();
+	stats["seconds"] = (F64)(totalTime() - mStatsStartTime) / 1000000.0;
+	for (S32 l = 0; l < NUM_LANES; l++)
+	{
+		LaneStats lane_stats = getLaneStats((lane_t)l);
+		LLSD& lane = stats["lanes"][getLaneName((lane_t)l)];
+		lane["run"] = (S32)lane_stats.mJobsRun;
+		lane["stolen"] = (S32)lane_stats.mJobsStolen;
+		lane["busy_seconds"] = (F64)lane_stats.mBusyTime / 1000000.0;
+		lane["queued"] = lane_stats.mQueued;
+		lane["utilization"] = getLaneUtilization((lane_t)l);
+	}
+	return stats;
+}
+
+void LLJobScheduler::resetStats()
+{
+	for (S32 i = 0; i < (S32)mWorkers.size(); i++)
+	{
+		Worker* worker = mWorkers[i];
+		worker->mLock.lock();
+		for (S32 l = 0; l < NUM_LANES; l++)
+		{
+			worker->mStats[l] = LaneStats();
+		}
+		worker->mLock.unlock();
+	}
+	mStatsStartTime = totalTime();
+}
+
+//============================================================================
+
+LLWaitableJob::LLWaitableJob() :
+	mPending(0)
+{
+}
+
+LLWaitableJob::~LLWaitableJob()
+{
+	llassert(isDone());
+}
+
+void LLWaitableJob::submit(LLJobScheduler::lane_t lane)
+{
+	llassert(isDone());
+	if (!LLJobScheduler::instanceExists() || !LLJobScheduler::getInstance()->isRunning())
+	{
+		doWork();
+		return;
+	}
+	mPending = 1;
+	LLJobScheduler::getInstance()->submit(this, lane);
+}
+
+void LLWaitableJob::wait(bool run_here)
+{
+	if (isDone())
+	{
+		return;
+	}
+	LLJobScheduler* scheduler = LLJobScheduler::getInstance();
+	if (scheduler->cancel(this))
+	{
+		mPending = 0;
+		if (run_here)
+		{
+			doWork();
+		}
+		return;
+	}
+	// Running, or it would have been taken back.  If the scheduler has
+	// been stopped since, it finished before its worker was joined.
+	if (scheduler->isRunning())
+	{
+		scheduler->waitFor(mPending);
+	}
+}
+
+// virtual
+void LLWaitableJob::run()
+{
+	doWork();
+	// Last, the waiter may delete us
+	LLJobScheduler::getInstance()->finished(mPending);
+}
+
+//============================================================================
+
+LLParallelFor::LLParallelFor() :
+	mNextPiece(0),
+	mCount(0),
+	mGrain(1)
+{
+}
+
+void LLParallelFor::run(S32 count, S32 grain, LLJobScheduler::lane_t lane)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	mCount = count;
+	mGrain = llmax(grain, 1);
+	mNextPiece = 0;
+
+	S32 pieces = (count + mGrain - 1) / mGrain;
+	S32 helpers = 0;
+	if (pieces > 1 && LLJobScheduler::instanceExists())
+	{
+		helpers = llmin(LLJobScheduler::getInstance()->getNumWorkers(), pieces - 1);
+		helpers = llmin(helpers, (S32)MAX_HELPERS);
+	}
+	if (helpers <= 0)
+	{
+		runRange(0, count);
+		return;
+	}
+
+	for (S32 i = 0; i < helpers; i++)
+	{
+		mHelpers[i].mParallelFor = this;
+		mHelpers[i].submit(lane);
+	}
+
+	work();
+
+	// Every piece is taken.  Helpers no worker got round to would find
+	// nothing to do, the rest are finishing theirs.
+	for (S32 i = 0; i < helpers; i++)
+	{
+		mHelpers[i].wait(false);
+	}
+}
+
+void LLParallelFor::work()
+{
+	while (true)
+	{
+		S32 begin = mNextPiece++ * mGrain;
+		if (begin >= mCount)
+		{
+			return;
+		}
+		runRange(begin, llmin(begin + mGrain, mCount));
+	}
+}
@@ -0,0 +1,232 @@
+/**
+ * @file lljobscheduler.h
+ * @brief Process wide pool of worker threads with work stealing and
+ * priority lanes.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLJOBSCHEDULER_H
+#define LL_LLJOBSCHEDULER_H
+
+#include <deque>
+#include <vector>
+
+#include "llsingleton.h"
+#include "llthread.h"
+#include "llsd.h"
+
+//============================================================================
+// A unit of work for LLJobScheduler.  The scheduler never deletes jobs;
+// whoever submits one keeps it alive until it has run.  The same job may
+// be submitted again, even while an earlier submission is still queued,
+// in which case run() may be called concurrently.
+
+class LL_COMMON_API LLJob
+{
+public:
+	virtual ~LLJob() {}
+	virtual void run() = 0; // WORKER THREAD
+};
+
+//============================================================================
+// One worker thread per core (less one for the main thread), each with
+// its own deque per priority lane.  A worker pushes and pops its own
+// deques at the back and, once they run dry, steals from the front of
+// the other workers' deques.  Lanes are always serviced highest first,
+// so a worker will steal urgent work before it touches its own low
+// priority work.
+//
+// Note: each deque has its own mutex rather than being lock free, they
+// are only ever contended by a thief and their owner.
+
+class LL_COMMON_API LLJobScheduler : public LLSingleton<LLJobScheduler>
+{
+public:
+	enum lane_t {
+		LANE_URGENT = 0,
+		LANE_HIGH,
+		LANE_NORMAL,
+		LANE_LOW,
+		NUM_LANES
+	};
+
+	struct LaneStats
+	{
+		LaneStats() : mJobsRun(0), mJobsStolen(0), mBusyTime(0), mQueued(0) {}
+		U32 mJobsRun;
+		U32 mJobsStolen;	// run by a worker other than the one they were queued on
+		U64 mBusyTime;		// microseconds spent in run()
+		S32 mQueued;		// waiting right now
+	};
+
+	LLJobScheduler();
+	~LLJobScheduler();
+
+	// MAIN THREAD
+	// num_workers <= 0 picks one per core, less one for the main thread.
+	void start(S32 num_workers = 0);
+	// Stops and joins the workers.  Jobs still queued don't run, so shut
+	// down whatever submits them first; cancel() can still take them back.
+	void stop();
+	bool isRunning() const { return !mWorkers.empty(); }
+	S32 getNumWorkers() const { return (S32)mWorkers.size(); }
+
+	// Any thread.  Jobs submitted from a worker go on that worker's own
+	// deques, others are dealt out round robin.
+	void submit(LLJob* job, lane_t lane = LANE_NORMAL);
+	// As submit(), but a worker puts the job behind everything already in
+	// its own lane rather than taking it straight back.  For jobs that
+	// give up their worker to wait for something.
+	void requeue(LLJob* job, lane_t lane = LANE_NORMAL);
+	// Takes back a job no worker has started, including one left queued
+	// by stop().  Returns false if it is running or has run.
+	bool cancel(LLJob* job);
+
+	// Maps an LLQueuedThread priority onto a lane.
+	static lane_t getLaneForPriority(U32 priority);
+	static const char* getLaneName(lane_t lane);
+	static S32 getNumCores();
+
+	// Totals across all workers since start() or resetStats().
+	LaneStats getLaneStats(lane_t lane) const;
+	// Fraction of the pool's time spent running jobs in this lane.
+	F32 getLaneUtilization(lane_t lane) const;
+	LLSD getStats() const;
+	void resetStats();
+
+private:
+	class Worker : public LLThread
+	{
+	public:
+		Worker(LLJobScheduler* scheduler, S32 index);
+
+		// Locks the deques and stats, held only briefly.
+		LLMutex			mLock;
+		std::deque<LLJob*>	mLanes[NUM_LANES];
+		LaneStats		mStats[NUM_LANES];
+		volatile U32	mOSThreadID;	// set once run() starts, for submit()
+
+	private:
+		/*virtual*/ void run();
+
+		LLJobScheduler*	mScheduler;
+		S32				mIndex;
+	};
+	friend class Worker;
+	friend class LLWaitableJob;
+
+	// The calling worker, or the next one round robin for other threads.
+	S32 getSubmitWorker();
+	void push(LLJob* job, lane_t lane, bool at_front);
+
+	// Finds the highest priority job, own deques first at each lane.
+	LLJob* takeJob(S32 worker_index, lane_t& lane, bool& stolen);
+	void waitForWork();
+	// For LLWaitableJob: clear pending and wake its waiter, or wait for that
+	void finished(LLAtomicS32& pending);
+	void waitFor(LLAtomicS32& pending);
+
+	std::vector<Worker*>	mWorkers;
+	LLCondition*			mWorkCondition;	// idle workers sleep on this
+	LLCondition*			mDoneCondition;	// shared by everyone waiting for a job
+	LLMutex					mDroppedLock;
+	std::vector<LLJob*>		mDropped;		// left queued by stop()
+	LLAtomicS32				mNumQueued;
+	LLAtomicU32				mNextWorker;	// round robin for outside submissions
+	LLAtomicS32				mQuitting;
+	bool					mLeakedWorkers;	// stop() gave up on one, keep the conditions
+	U64						mStatsStartTime;
+};
+
+//============================================================================
+// A job whose submitter waits for it, typically before deleting what it
+// works on.  Only one submission may be outstanding at a time.  Without a
+// running scheduler the work is done right away by submit().
+
+class LL_COMMON_API LLWaitableJob : public LLJob
+{
+public:
+	LLWaitableJob();
+	// Subclasses must wait() before they go, the job may still be running
+	virtual ~LLWaitableJob();
+
+	void submit(LLJobScheduler::lane_t lane = LLJobScheduler::LANE_NORMAL);
+	bool isDone() { return mPending == 0; }
+	// Returns once the job has run.  One no worker has started is taken
+	// back instead and, if run_here is set, done on the calling thread.
+	void wait(bool run_here = true);
+
+protected:
+	// WORKER THREAD, or whichever thread submits or waits
+	virtual void doWork() = 0;
+
+private:
+	/*virtual*/ void run();
+
+	LLAtomicS32		mPending;
+};
+
+//============================================================================
+// Splits [0, count) into pieces and runs them on the calling thread and as
+// many workers as are free to help, returning once all are done.  The
+// caller keeps going until every piece is taken, so any help that has yet
+// to start is simply taken back.  Subclasses provide runRange(), which
+// must be safe to run on several threads at once over different ranges.
+
+class LL_COMMON_API LLParallelFor
+{
+public:
+	LLParallelFor();
+	virtual ~LLParallelFor() {}
+
+	// Pieces are grain items long, so a grain of count or more runs it all
+	// on the calling thread.  Not reentrant for the same object.
+	void run(S32 count, S32 grain = 1, LLJobScheduler::lane_t lane = LLJobScheduler::LANE_URGENT);
+
+protected:
+	// Any thread
+	virtual void runRange(S32 begin, S32 end) = 0;
+
+private:
+	enum { MAX_HELPERS = 16 };
+
+	class Helper : public LLWaitableJob
+	{
+	public:
+		Helper() : mParallelFor(NULL) {}
+		LLParallelFor*	mParallelFor;
+	private:
+		/*virtual*/ void doWork() { mParallelFor->work(); }
+	};
+	friend class Helper;
+
+	// Runs pieces until there are none left to take
+	void work();
+
+	Helper		mHelpers[MAX_HELPERS];
+	LLAtomicS32	mNextPiece;
+	S32			mCount;
+	S32			mGrain;
+};
+
+#endif // LL_LLJOBSCHEDULER_H
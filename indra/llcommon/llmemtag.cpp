@@ -0,0 +1,213 @@
+/**
+ * @file llmemtag.cpp
+ * @brief Per subsystem live and peak memory counters, with the tagged
+ * allocators that feed them.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llmemtag.h"
+
+#include <fstream>
+#include <new>
+
+namespace
+{
+	// Function static so that tags in other translation units can
+	// register during static initialization in any order.
+	LLMemTag::tag_list_t& get_tag_list()
+	{
+		static LLMemTag::tag_list_t tags;
+		return tags;
+	}
+}
+
+//============================================================================
+
+LLMemTag::LLMemTag(const char* name) :
+	mName(name)
+{
+	// The counters are deliberately not initialized, see the header.
+	get_tag_list().push_back(this);
+}
+
+void LLMemTag::add(size_t size)
+{
+	U32 live = apr_atomic_add32(&mLiveBytes, (apr_uint32_t)size) + (U32)size;
+	apr_atomic_inc32(&mLiveCount);
+	U32 peak = apr_atomic_read32(&mPeakBytes);
+	while (live > peak)
+	{
+		U32 seen = apr_atomic_cas32(&mPeakBytes, live, peak);
+		if (seen == peak)
+		{
+			break;
+		}
+		peak = seen;
+	}
+}
+
+void LLMemTag::remove(size_t size)
+{
+	apr_atomic_sub32(&mLiveBytes, (apr_uint32_t)size);
+	apr_atomic_dec32(&mLiveCount);
+}
+
+void LLMemTag::resetPeak()
+{
+	apr_atomic_set32(&mPeakBytes, getLiveBytes());
+}
+
+//static
+void* LLMemTag::allocate(LLMemTag& tag, size_t size)
+{
+	void* ptr = malloc(size);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	tag.add(size);
+	return ptr;
+}
+
+//static
+void LLMemTag::deallocate(LLMemTag& tag, void* ptr, size_t size)
+{
+	if (ptr)
+	{
+		tag.remove(size);
+		free(ptr);
+	}
+}
+
+//static
+const LLMemTag::tag_list_t& LLMemTag::getTags()
+{
+	return get_tag_list();
+}
+
+//static
+void LLMemTag::dump(std::ostream& str)
+{
+	str << "tag,live_bytes,peak_bytes,live_allocations\n";
+	const tag_list_t& tags = getTags();
+	for (tag_list_t::const_iterator iter = tags.begin(); iter != tags.end(); ++iter)
+	{
+		const LLMemTag* tag = *iter;
+		str << tag->getName() << ","
+			<< tag->getLiveBytes() << ","
+			<< tag->getPeakBytes() << ","
+			<< tag->getLiveCount() << "\n";
+	}
+}
+
+//static
+bool LLMemTag::dumpToFile(const std::string& filename)
+{
+	std::ofstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		llwarns << "Unable to write memory tags to " << filename << llendl;
+		return false;
+	}
+	dump(file);
+	llinfos << "Memory tags written to " << filename << llendl;
+	return true;
+}
+
+//============================================================================
+
+LLMemTagPool::LLMemTagPool(LLMemTag& tag, size_t element_size, U32 elements_per_chunk) :
+	mTag(tag),
+	mObjectSize(element_size),
+	mElementSize((llmax(element_size, sizeof(void*)) + 15) & ~(size_t)15),
+	mElementsPerChunk(llmax(elements_per_chunk, (U32)1))
+{
+	// mFreeList, mLock and mReservedBytes are zero from static storage
+}
+
+void LLMemTagPool::lock()
+{
+	while (apr_atomic_cas32(&mLock, 1, 0) != 0)
+	{
+		// Held for a few instructions at a time, just spin.
+	}
+}
+
+void LLMemTagPool::unlock()
+{
+	apr_atomic_set32(&mLock, 0);
+}
+
+void* LLMemTagPool::allocate(size_t size)
+{
+	if (size != mObjectSize)
+	{
+		return LLMemTag::allocate(mTag, size);
+	}
+
+	lock();
+	if (!mFreeList)
+	{
+		size_t chunk_size = mElementSize * mElementsPerChunk;
+		U8* chunk = (U8*) ll_aligned_malloc_16(chunk_size);
+		if (!chunk)
+		{
+			unlock();
+			throw std::bad_alloc();
+		}
+		// Thread the new elements onto the free list, first one on top.
+		for (S32 i = (S32)mElementsPerChunk - 1; i >= 0; i--)
+		{
+			void* element = chunk + i * mElementSize;
+			*(void**) element = mFreeList;
+			mFreeList = element;
+		}
+		apr_atomic_add32(&mReservedBytes, (apr_uint32_t)chunk_size);
+	}
+	void* element = mFreeList;
+	mFreeList = *(void**) element;
+	unlock();
+
+	mTag.add(mElementSize);
+	return element;
+}
+
+void LLMemTagPool::deallocate(void* ptr, size_t size)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	if (size != mObjectSize)
+	{
+		LLMemTag::deallocate(mTag, ptr, size);
+		return;
+	}
+
+	mTag.remove(mElementSize);
+	lock();
+	*(void**) ptr = mFreeList;
+	mFreeList = ptr;
+	unlock();
+}
@@ -0,0 +1,193 @@
+/**
+ * @file llmemtag.h
+ * @brief Per subsystem live and peak memory counters, with the tagged
+ * allocators that feed them.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMEMTAG_H
+#define LL_LLMEMTAG_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "apr_atomic.h"
+#include "llmemory.h"
+
+//============================================================================
+// A named counter of the bytes a subsystem has live on the heap.  Unlike
+// LLMemType, which tags whatever is allocated while it is on the stack and
+// needs a heap profiler to make sense of it, a tag is charged by the
+// allocation sites themselves and is always up to date, on any platform.
+//
+// Tags must be static objects: allocations may be charged to a tag during
+// static initialization before its constructor has run, so the counters
+// rely on being zeroed with the rest of static storage and the constructor
+// leaves them alone.  All counting is lock free.
+
+class LL_COMMON_API LLMemTag
+{
+public:
+	LLMemTag(const char* name);
+
+	const char* getName() const		{ return mName; }
+
+	// Bytes wrap past 4GB, which a single subsystem shouldn't get near.
+	U32 getLiveBytes() const		{ return apr_atomic_read32(const_cast<volatile apr_uint32_t*>(&mLiveBytes)); }
+	U32 getPeakBytes() const		{ return apr_atomic_read32(const_cast<volatile apr_uint32_t*>(&mPeakBytes)); }
+	U32 getLiveCount() const		{ return apr_atomic_read32(const_cast<volatile apr_uint32_t*>(&mLiveCount)); }
+
+	// Charge or credit one allocation of size bytes.
+	void add(size_t size);
+	void remove(size_t size);
+	void resetPeak();
+
+	// For class operator new/delete, where delete is told the size.
+	static void* allocate(LLMemTag& tag, size_t size);
+	static void deallocate(LLMemTag& tag, void* ptr, size_t size);
+
+	typedef std::vector<LLMemTag*> tag_list_t;
+	static const tag_list_t& getTags();
+
+	// One line per tag: name, live bytes, peak bytes, live allocations, as
+	// comma separated values with a header line.
+	static void dump(std::ostream& str);
+	static bool dumpToFile(const std::string& filename);
+
+private:
+	const char* mName;
+	volatile apr_uint32_t mLiveBytes;
+	volatile apr_uint32_t mPeakBytes;
+	volatile apr_uint32_t mLiveCount;
+};
+
+//============================================================================
+// 16 byte aligned blocks charged to a tag.  The size is kept in front of
+// the block so that the free doesn't need to be told it.  Blocks from these
+// must only be freed or resized by these.
+
+const size_t LL_MEM_TAG_HEADER_SIZE = 16;
+
+inline void* ll_tagged_malloc_16(LLMemTag& tag, size_t size)
+{
+	U8* block = (U8*) ll_aligned_malloc_16(size + LL_MEM_TAG_HEADER_SIZE);
+	if (!block)
+	{
+		return NULL;
+	}
+	*(size_t*) block = size;
+	tag.add(size);
+	return block + LL_MEM_TAG_HEADER_SIZE;
+}
+
+inline void ll_tagged_free_16(LLMemTag& tag, void* ptr)
+{
+	if (ptr)
+	{
+		U8* block = (U8*) ptr - LL_MEM_TAG_HEADER_SIZE;
+		tag.remove(*(size_t*) block);
+		ll_aligned_free_16(block);
+	}
+}
+
+// Like realloc(), which the callers used on these blocks before.
+inline void* ll_tagged_realloc_16(LLMemTag& tag, void* ptr, size_t size)
+{
+	if (!ptr)
+	{
+		return ll_tagged_malloc_16(tag, size);
+	}
+	U8* block = (U8*) ptr - LL_MEM_TAG_HEADER_SIZE;
+	size_t old_size = *(size_t*) block;
+#if LL_WINDOWS
+	// _mm_malloc() blocks can't be handed to realloc(), move it by hand.
+	U8* new_block = (U8*) ll_aligned_malloc_16(size + LL_MEM_TAG_HEADER_SIZE);
+	if (!new_block)
+	{
+		return NULL;
+	}
+	memcpy(new_block + LL_MEM_TAG_HEADER_SIZE, ptr, llmin(old_size, size));
+	ll_aligned_free_16(block);
+	block = new_block;
+#else
+	// posix_memalign() and OS X malloc() blocks are realloc()able, though
+	// only as aligned as realloc() makes them.
+	block = (U8*) realloc(block, size + LL_MEM_TAG_HEADER_SIZE);
+	if (!block)
+	{
+		return NULL;
+	}
+#endif
+	*(size_t*) block = size;
+	tag.remove(old_size);
+	tag.add(size);
+	return block + LL_MEM_TAG_HEADER_SIZE;
+}
+
+//============================================================================
+// Fixed size pool for a class that is created and destroyed in bulk.
+// Elements are 16 byte aligned and carved from chunks that are kept for
+// reuse rather than given back.  The tag is charged for the elements in
+// use.  Any thread; the free list is guarded by a spin lock, the critical
+// sections being a couple of pointer moves.
+//
+//	class LLFoo
+//	{
+//	public:
+//		void* operator new(size_t size)			{ return sPool.allocate(size); }
+//		void operator delete(void* ptr, size_t size)	{ sPool.deallocate(ptr, size); }
+//	private:
+//		static LLMemTagPool sPool;
+//	};
+
+class LL_COMMON_API LLMemTagPool
+{
+public:
+	// Static objects only, and not to be used until static initialization
+	// is over: an element allocated before the constructor ran would come
+	// back to the pool with the wrong size.
+	LLMemTagPool(LLMemTag& tag, size_t element_size, U32 elements_per_chunk = 256);
+
+	// Sizes other than the element size (a derived class) are passed on
+	// to the tag's heap allocation.
+	void* allocate(size_t size);
+	void deallocate(void* ptr, size_t size);
+
+	size_t getElementSize() const	{ return mElementSize; }
+	U32 getReservedBytes() const	{ return apr_atomic_read32(const_cast<volatile apr_uint32_t*>(&mReservedBytes)); }
+
+private:
+	void lock();
+	void unlock();
+
+	LLMemTag& mTag;
+	size_t mObjectSize;
+	size_t mElementSize;	// mObjectSize rounded up to 16
+	U32 mElementsPerChunk;
+	void* mFreeList;		// through the first word of each free element
+	volatile apr_uint32_t mLock;
+	volatile apr_uint32_t mReservedBytes;
+};
+
+#endif // LL_LLMEMTAG_H
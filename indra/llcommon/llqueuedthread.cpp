@@ -31,17 +31,36 @@
 
 //============================================================================
 
+// Longest a hosted job keeps processing requests before it gives its
+// worker back, so other queues and higher lanes get a look in.
+const F32 HOSTED_JOB_TIME_SLICE = 0.005f; // seconds
+
 // MAIN THREAD
-LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded) :
+LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool hosted) :
 	LLThread(name),
 	mThreaded(threaded),
 	mIdleThread(TRUE),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mHosted(FALSE),
+	mMaxJobs(1),
+	mActiveJobs(0),
+	mServiceJob(this),
+	mRequestTimer(name)
 {
 	if (mThreaded)
 	{
-		start();
+		if (hosted && LLJobScheduler::instanceExists() && LLJobScheduler::getInstance()->isRunning())
+		{
+			// No thread of our own, but as far as pause() and shutdown()
+			// are concerned we are running.
+			mHosted = TRUE;
+			mStatus = RUNNING;
+		}
+		else
+		{
+			start();
+		}
 	}
 }
 
@@ -61,7 +80,45 @@ void LLQueuedThread::shutdown()
 	setQuitting();
 
 	unpause(); // MAIN THREAD
-	if (mThreaded)
+	if (mHosted)
+	{
+		if (mStatus == STOPPED)
+		{
+			// Already shut down, this is the destructor.
+			return;
+		}
+		// Wait for the jobs in flight, they stop at the next request.
+		S32 timeout = 1000;
+		for ( ; timeout>0; timeout--)
+		{
+			// Take back the ones no worker has started, including any a
+			// stopped scheduler left queued, they would never finish.
+			while (LLJobScheduler::instanceExists() && LLJobScheduler::getInstance()->cancel(&mServiceJob))
+			{
+				lockData();
+				mActiveJobs--;
+				unlockData();
+			}
+			lockData();
+			S32 active_jobs = mActiveJobs;
+			unlockData();
+			if (!active_jobs)
+			{
+				break;
+			}
+			ms_sleep(10);
+		}
+		if (timeout == 0)
+		{
+			llwarns << "~LLQueuedThread (" << mName << ") timed out!" << llendl;
+		}
+		if (mStarted)
+		{
+			endThread();
+		}
+		mStatus = STOPPED;
+	}
+	else if (mThreaded)
 	{
 		S32 timeout = 100;
 		for ( ; timeout>0; timeout--)
@@ -85,6 +142,10 @@ void LLQueuedThread::shutdown()
 
 	QueuedRequest* req;
 	S32 active_count = 0;
+	// Empty the queue first so it holds no pointers to deleted requests
+	while (mRequestQueue.pop())
+	{
+	}
 	while ( (req = (QueuedRequest*)mRequestHash.pop_element()) )
 	{
 		if (req->getStatus() == STATUS_QUEUED || req->getStatus() == STATUS_INPROGRESS)
@@ -129,8 +190,12 @@ S32 LLQueuedThread::updateQueue(U32 max_time_ms)
 		pending = getPending();
 		if(pending > 0)
 		{
-		unpause();
-	}
+			unpause();
+			if (mHosted)
+			{
+				scheduleJobs();
+			}
+		}
 	}
 	else
 	{
@@ -149,22 +214,103 @@ void LLQueuedThread::incQueue()
 	// Something has been added to the queue
 	if (!isPaused())
 	{
-		if (mThreaded)
+		if (mHosted)
+		{
+			scheduleJobs();
+		}
+		else if (mThreaded)
 		{
 			wake(); // Wake the thread up if necessary.
 		}
 	}
 }
 
-//virtual
+// MAIN THREAD
+void LLQueuedThread::setMaxJobs(S32 max_jobs)
+{
+	lockData();
+	mMaxJobs = llmax(max_jobs, 1);
+	unlockData();
+	incQueue();
+}
+
 // May be called from any thread
-S32 LLQueuedThread::getPending()
+void LLQueuedThread::scheduleJobs(bool requeue)
 {
-	S32 res;
+	S32 new_jobs = 0;
+	LLJobScheduler::lane_t lane = LLJobScheduler::LANE_NORMAL;
 	lockData();
-	res = mRequestQueue.size();
+	QueuedRequest* top = NULL;
+	if ((mStatus == RUNNING) && !isPaused() && (top = mRequestQueue.top()))
+	{
+		new_jobs = llmin(mRequestQueue.size(), mMaxJobs) - mActiveJobs;
+		lane = LLJobScheduler::getLaneForPriority(top->getPriority());
+	}
+	if (new_jobs > 0)
+	{
+		mActiveJobs += new_jobs;
+		mIdleThread = FALSE;
+	}
 	unlockData();
-	return res;
+
+	for (S32 i = 0; i < new_jobs; i++)
+	{
+		if (requeue)
+		{
+			LLJobScheduler::getInstance()->requeue(&mServiceJob, lane);
+		}
+		else
+		{
+			LLJobScheduler::getInstance()->submit(&mServiceJob, lane);
+		}
+	}
+}
+
+// WORKER THREAD
+// Does what one pass of run() would, for at most one time slice.
+void LLQueuedThread::serviceQueue()
+{
+	lockData();
+	if (!mStarted)
+	{
+		startThread();
+		mStarted = TRUE;
+	}
+	unlockData();
+
+	threadedUpdate();
+
+	LLTimer timer;
+	bool yielded = false;
+	while (!isQuitting() && !isPaused())
+	{
+		if (processNextRequest(&yielded) == 0 || yielded)
+		{
+			break;
+		}
+		if (timer.getElapsedTimeF32() > HOSTED_JOB_TIME_SLICE)
+		{
+			break;
+		}
+	}
+
+	lockData();
+	mActiveJobs--;
+	if (!mActiveJobs && mRequestQueue.empty())
+	{
+		mIdleThread = TRUE;
+	}
+	unlockData();
+
+	// Requeue ourselves behind whatever else is waiting if there is more to do.
+	scheduleJobs(yielded);
+}
+
+//virtual
+// May be called from any thread
+S32 LLQueuedThread::getPending()
+{
+	return mRequestQueue.size();
 }
 
 // MAIN thread
@@ -190,9 +336,9 @@ void LLQueuedThread::waitOnPending()
 void LLQueuedThread::printQueueStats()
 {
 	lockData();
-	if (!mRequestQueue.empty())
+	QueuedRequest *req = mRequestQueue.top();
+	if (req)
 	{
-		QueuedRequest *req = *mRequestQueue.begin();
 		llinfos << llformat("Pending Requests:%d Current status:%d", mRequestQueue.size(), req->getStatus()) << llendl;
 	}
 	else
@@ -225,12 +371,12 @@ bool LLQueuedThread::addRequest(QueuedRequest* req)
 	
 	lockData();
 	req->setStatus(STATUS_QUEUED);
-	mRequestQueue.insert(req);
 	mRequestHash.insert(req);
 #if _DEBUG
 // 	llinfos << llformat("LLQueuedThread::Added req [%08d]",handle) << llendl;
 #endif
 	unlockData();
+	mRequestQueue.push(req);
 
 	incQueue();
 
@@ -259,6 +405,7 @@ bool LLQueuedThread::waitForResult(LLQueuedThread::handle_t handle, bool auto_co
 			if (auto_complete)
 			{
 				mRequestHash.erase(handle);
+				mRequestQueue.forget(req);
 				req->deleteRequest();
 // 				check();
 			}
@@ -340,10 +487,9 @@ void LLQueuedThread::setPriority(handle_t handle, U32 priority)
 		}
 		else if(req->getStatus() == STATUS_QUEUED)
 		{
-			// remove from list then re-insert
-			llverify(mRequestQueue.erase(req) == 1);
+			// moved to its new bucket the next time the queue is looked at
 			req->setPriority(priority);
-			mRequestQueue.insert(req);
+			mRequestQueue.reprioritize(req);
 		}
 	}
 	unlockData();
@@ -362,6 +508,7 @@ bool LLQueuedThread::completeRequest(handle_t handle)
 // 		llinfos << llformat("LLQueuedThread::Completed req [%08d]",handle) << llendl;
 #endif
 		mRequestHash.erase(handle);
+		mRequestQueue.forget(req);
 		req->deleteRequest();
 // 		check();
 		res = true;
@@ -393,20 +540,18 @@ bool LLQueuedThread::check()
 //============================================================================
 // Runs on its OWN thread
 
-S32 LLQueuedThread::processNextRequest()
+S32 LLQueuedThread::processNextRequest(bool* yielded)
 {
 	QueuedRequest *req;
 	// Get next request from pool
-	lockData();
 	while(1)
 	{
-		req = NULL;
-		if (mRequestQueue.empty())
+		req = mRequestQueue.pop();
+		if (!req)
 		{
 			break;
 		}
-		req = *mRequestQueue.begin();
-		mRequestQueue.erase(mRequestQueue.begin());
+		lockData();
 		if ((req->getFlags() & FLAG_ABORT) || (mStatus == QUITTING))
 		{
 			req->setStatus(STATUS_ABORTED);
@@ -414,9 +559,11 @@ S32 LLQueuedThread::processNextRequest()
 			if (req->getFlags() & FLAG_AUTO_COMPLETE)
 			{
 				mRequestHash.erase(req);
+				mRequestQueue.forget(req);
 				req->deleteRequest();
 // 				check();
 			}
+			unlockData();
 			continue;
 		}
 		llassert_always(req->getStatus() == STATUS_QUEUED);
@@ -427,8 +574,8 @@ S32 LLQueuedThread::processNextRequest()
 	{
 		req->setStatus(STATUS_INPROGRESS);
 		start_priority = req->getPriority();
+		unlockData();
 	}
-	unlockData();
 
 	// This is the only place we will call req->setStatus() after
 	// it has initially been seet to STATUS_QUEUED, so it is
@@ -436,7 +583,11 @@ S32 LLQueuedThread::processNextRequest()
 	if (req)
 	{
 		// process request		
-		bool complete = req->processRequest();
+		bool complete;
+		{
+			LLFastTimer t(mRequestTimer);
+			complete = req->processRequest();
+		}
 
 		if (complete)
 		{
@@ -446,6 +597,7 @@ S32 LLQueuedThread::processNextRequest()
 			if (req->getFlags() & FLAG_AUTO_COMPLETE)
 			{
 				mRequestHash.erase(req);
+				mRequestQueue.forget(req);
 				req->deleteRequest();
 // 				check();
 			}
@@ -455,11 +607,23 @@ S32 LLQueuedThread::processNextRequest()
 		{
 			lockData();
 			req->setStatus(STATUS_QUEUED);
-			mRequestQueue.insert(req);
 			unlockData();
+			mRequestQueue.push(req);
 			if (mThreaded && start_priority < PRIORITY_NORMAL)
 			{
-				ms_sleep(1); // sleep the thread a little
+				if (mHosted)
+				{
+					// Don't sleep on a shared worker, end the slice instead
+					// so the request waits behind whatever else is queued.
+					if (yielded)
+					{
+						*yielded = true;
+					}
+				}
+				else
+				{
+					ms_sleep(1); // sleep the thread a little
+				}
 			}
 		}
 	}
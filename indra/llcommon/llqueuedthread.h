@@ -34,12 +34,22 @@
 
 #include "llapr.h"
 
+#include "llfasttimer.h"
 #include "llthread.h"
 #include "llsimplehash.h"
+#include "llbucketqueue.h"
+#include "lljobscheduler.h"
 
 //============================================================================
 // Note: ~LLQueuedThread is O(N) N=# of queued threads, assumed to be small
 //   It is assumed that LLQueuedThreads are rarely created/destroyed.
+//
+// A threaded LLQueuedThread created while the LLJobScheduler is running
+// doesn't get a thread of its own, unless it asks for one with
+// hosted = false.  Its requests are processed by jobs on the shared
+// workers instead, at most getMaxJobs() at a time, so by default they
+// still never run concurrently.  Subclasses that override run() or
+// depend on threadedUpdate() being called regularly need their own thread.
 
 class LL_COMMON_API LLQueuedThread : public LLThread
 {
@@ -74,7 +84,7 @@ public:
 	//------------------------------------------------------------------------
 public:
 
-	class LL_COMMON_API QueuedRequest : public LLSimpleHashEntry<handle_t>
+	class LL_COMMON_API QueuedRequest : public LLSimpleHashEntry<handle_t>, public LLBucketQueueEntry
 	{
 		friend class LLQueuedThread;
 		
@@ -123,7 +133,8 @@ public:
 
 		void setPriority(U32 pri)
 		{
-			// Only do this on a request that is not in a queued list!
+			// Call LLQueuedThread::setPriority() for a queued request, so
+			// that it gets moved to its new bucket.
 			mPriority = pri;
 		};
 		
@@ -133,23 +144,13 @@ public:
 		U32 mFlags;
 	};
 
-protected:
-	struct queued_request_less
-	{
-		bool operator()(const QueuedRequest* lhs, const QueuedRequest* rhs) const
-		{
-			return lhs->higherPriority(*rhs); // higher priority in front of queue (set)
-		}
-	};
-
-
 	//------------------------------------------------------------------------
 	
 public:
 	static handle_t nullHandle() { return handle_t(0); }
 	
 public:
-	LLQueuedThread(const std::string& name, bool threaded = true);
+	LLQueuedThread(const std::string& name, bool threaded = true, bool hosted = true);
 	virtual ~LLQueuedThread();	
 	virtual void shutdown();
 	
@@ -164,10 +165,25 @@ private:
 	virtual void endThread(void);
 	virtual void threadedUpdate(void);
 
+	class ServiceJob : public LLJob
+	{
+	public:
+		ServiceJob(LLQueuedThread* queue) : mQueue(queue) {}
+		/*virtual*/ void run() { mQueue->serviceQueue(); }
+	private:
+		LLQueuedThread* mQueue;
+	};
+	friend class ServiceJob;
+
+	// Hosted mode: submit jobs for pending requests, and the body of a job.
+	void scheduleJobs(bool requeue = false);
+	void serviceQueue();
+
 protected:
 	handle_t generateHandle();
 	bool addRequest(QueuedRequest* req);
-	S32  processNextRequest(void);
+	// yielded is set when a hosted job should hand its worker back.
+	S32  processNextRequest(bool* yielded = NULL);
 	void incQueue();
 
 public:
@@ -181,6 +197,12 @@ public:
 
 	virtual S32 getPending();
 	bool getThreaded() { return mThreaded ? true : false; }
+	bool isHosted() const { return mHosted ? true : false; }
+
+	// Hosted mode only: how many requests may be processed at once.  Only
+	// raise this if processRequest() is safe to run concurrently.
+	void setMaxJobs(S32 max_jobs);
+	S32 getMaxJobs() const { return mMaxJobs; }
 
 	// Request accessors
 	status_t getRequestStatus(handle_t handle);
@@ -199,8 +221,15 @@ protected:
 	BOOL mThreaded;  // if false, run on main thread and do updates during update()
 	BOOL mStarted;  // required when mThreaded is false to call startThread() from update()
 	LLAtomic32<BOOL> mIdleThread; // request queue is empty (or we are quitting) and the thread is idle
+	BOOL mHosted; // requests are processed by LLJobScheduler jobs rather than our own thread
+	S32 mMaxJobs; // hosted jobs allowed at once
+	S32 mActiveJobs; // hosted jobs submitted and not yet finished, guarded by lockData()
+	ServiceJob mServiceJob;
+	LLFastTimer::DeclareTimer mRequestTimer; // named after the thread, times processRequest()
 	
-	typedef std::set<QueuedRequest*, queued_request_less> request_queue_t;
+	// Has its own lock, requests are added and reprioritized without
+	// taking the data lock for it.
+	typedef LLBucketQueue<QueuedRequest> request_queue_t;
 	request_queue_t mRequestQueue;
 
 	enum { REQUEST_HASH_SIZE = 512 }; // must be power of 2
@@ -27,9 +27,14 @@
 #include "linden_common.h"
 #include "llsd.h"
 
+#include <new>
+
+#include "apr_atomic.h"
+
 #include "llerror.h"
 #include "../llmath/llmath.h"
 #include "llformat.h"
+#include "llmemtag.h"
 #include "llsdserialize.h"
 
 #ifndef LL_RELEASE_FOR_DOWNLOAD
@@ -124,7 +129,7 @@ public:
 	virtual const LLSD& ref(Integer) const		{ return undef(); }
 
 	virtual LLSD::map_const_iterator beginMap() const { return endMap(); }
-	virtual LLSD::map_const_iterator endMap() const { static const std::map<String, LLSD> empty; return empty.end(); }
+	virtual LLSD::map_const_iterator endMap() const { return LLSD::map_const_iterator(); }
 	virtual LLSD::array_const_iterator beginArray() const { return endArray(); }
 	virtual LLSD::array_const_iterator endArray() const { static const std::vector<LLSD> empty; return empty.end(); }
 
@@ -132,6 +137,11 @@ public:
 	
 	static U32 sAllocationCount;
 	static U32 sOutstandingCount;
+
+	// Impls and map storage are charged to sMemTag
+	static void* operator new(size_t size)				{ return LLMemTag::allocate(sMemTag, size); }
+	static void operator delete(void* ptr, size_t size)	{ LLMemTag::deallocate(sMemTag, ptr, size); }
+	static LLMemTag sMemTag;
 };
 
 #ifdef NAME_UNNAMED_NAMESPACE
@@ -327,21 +337,39 @@ namespace
 	class ImplMap : public LLSD::Impl
 	{
 	private:
-		typedef std::map<LLSD::String, LLSD>	DataMap;
-		
-		DataMap mData;
+		typedef LLSD::map_value_type	Entry;
+		typedef std::vector<Entry*>		Index;
+
+		// Entries are allocated in blocks that never move, so that a
+		// reference to a value survives later inserts, as it did with
+		// std::map.  Lookup and iteration go through mIndex.  The entries
+		// follow the header in the same allocation; the header is a whole
+		// number of pointers, which is all the alignment an Entry needs.
+		struct Block
+		{
+			Block* mNext;
+			U32 mUsed;
+			U32 mCapacity;
+
+			Entry* entries() { return reinterpret_cast<Entry*>(this + 1); }
+		};
+
+		Index mIndex;			// sorted by key
+		Block* mBlocks;			// newest first
+		Entry* mFree;			// erased entries, linked through their storage
 		
 	protected:
-		ImplMap(const DataMap& data) : mData(data) { }
+		ImplMap(const ImplMap& other);
 		
 	public:
-		ImplMap() { }
+		ImplMap() : mBlocks(NULL), mFree(NULL) { }
+		virtual ~ImplMap();
 		
 		virtual ImplMap& makeMap(LLSD::Impl*&);
 
 		virtual LLSD::Type type() const { return LLSD::TypeMap; }
 
-		virtual LLSD::Boolean asBoolean() const { return !mData.empty(); }
+		virtual LLSD::Boolean asBoolean() const { return !mIndex.empty(); }
 
 		virtual bool has(const LLSD::String&) const; 
 
@@ -354,19 +382,184 @@ namespace
 		              LLSD& ref(const LLSD::String&);
 		virtual const LLSD& ref(const LLSD::String&) const;
 
-		virtual int size() const { return mData.size(); }
+		virtual int size() const { return mIndex.size(); }
+
+		LLSD::map_iterator beginMap() { return LLSD::map_iterator(first()); }
+		LLSD::map_iterator endMap() { return LLSD::map_iterator(first() + mIndex.size()); }
+		virtual LLSD::map_const_iterator beginMap() const { return LLSD::map_const_iterator(first()); }
+		virtual LLSD::map_const_iterator endMap() const { return LLSD::map_const_iterator(first() + mIndex.size()); }
+
+	private:
+		Entry* const* first() const { return mIndex.empty() ? NULL : &mIndex[0]; }
+		Index::const_iterator lowerBound(const LLSD::String& k) const;
+		Index::iterator lowerBound(const LLSD::String& k);
+		bool matches(Index::const_iterator i, const LLSD::String& k) const
+			{ return i != mIndex.end() && (*i)->first == k; }
+		Entry* newEntry(const LLSD::String& k, const LLSD& v);
+		Entry* insertEntry(size_t pos, const LLSD::String& k, const LLSD& v);
+		void deleteEntry(Entry* entry);
+		void reserve(U32 count);
+	};
+
+	// Map keys are shared between all maps through a table of interned
+	// strings.  The entries copy the interned string, which costs a
+	// reference count rather than an allocation where std::string is
+	// copy on write, and nothing where the key fits the small string
+	// buffer.  The table is insert only and lock free; once it is half
+	// full, or for keys that look like ids, keys are just copied.
+	const U32 KEY_TABLE_SIZE = 4096;
+	const U32 KEY_TABLE_LIMIT = KEY_TABLE_SIZE / 2;
+	const U32 MAX_INTERNED_KEY_LENGTH = 32;
+	const LLSD::String* volatile sKeyTable[KEY_TABLE_SIZE];
+	volatile apr_uint32_t sKeyCount = 0;
+
+	U32 hash_key(const LLSD::String& k)
+	{
+		// FNV-1a
+		U32 hash = 2166136261U;
+		for (LLSD::String::const_iterator i = k.begin(); i != k.end(); ++i)
+		{
+			hash = (hash ^ (U8)*i) * 16777619U;
+		}
+		return hash;
+	}
+
+	const LLSD::String& intern_key(const LLSD::String& k)
+	{
+		if (k.size() > MAX_INTERNED_KEY_LENGTH)
+		{
+			return k;
+		}
+		U32 slot = hash_key(k) & (KEY_TABLE_SIZE - 1);
+		while (true)
+		{
+			const LLSD::String* key = sKeyTable[slot];
+			if (!key)
+			{
+				if (apr_atomic_read32(&sKeyCount) >= KEY_TABLE_LIMIT)
+				{
+					return k;
+				}
+				LLSD::String* new_key = new LLSD::String(k);
+				key = (const LLSD::String*)apr_atomic_casptr((volatile void**)&sKeyTable[slot], new_key, NULL);
+				if (!key)
+				{
+					apr_atomic_inc32(&sKeyCount);
+					return *new_key;
+				}
+				// Someone else took the slot first, it may be the same key
+				delete new_key;
+			}
+			if (*key == k)
+			{
+				return *key;
+			}
+			slot = (slot + 1) & (KEY_TABLE_SIZE - 1);
+		}
+	}
+
+	ImplMap::ImplMap(const ImplMap& other) :
+		mBlocks(NULL),
+		mFree(NULL)
+	{
+		// One block, in key order, so that iterating the copy walks
+		// memory in order.
+		reserve(other.mIndex.size());
+		for (Index::const_iterator i = other.mIndex.begin(); i != other.mIndex.end(); ++i)
+		{
+			mIndex.push_back(newEntry((*i)->first, (*i)->second));
+		}
+	}
+
+	ImplMap::~ImplMap()
+	{
+		for (Index::iterator i = mIndex.begin(); i != mIndex.end(); ++i)
+		{
+			(*i)->~Entry();
+		}
+		while (mBlocks)
+		{
+			Block* next = mBlocks->mNext;
+			LLMemTag::deallocate(sMemTag, mBlocks, sizeof(Block) + mBlocks->mCapacity * sizeof(Entry));
+			mBlocks = next;
+		}
+	}
+
+	void ImplMap::reserve(U32 count)
+	{
+		if (count)
+		{
+			Block* block = static_cast<Block*>(LLMemTag::allocate(sMemTag, sizeof(Block) + count * sizeof(Entry)));
+			block->mNext = mBlocks;
+			block->mUsed = 0;
+			block->mCapacity = count;
+			mBlocks = block;
+			// Keep the index the same size as the storage rather than
+			// letting it double on its own.
+			mIndex.reserve(mIndex.size() + count);
+		}
+	}
+
+	ImplMap::Entry* ImplMap::newEntry(const LLSD::String& k, const LLSD& v)
+	{
+		Entry* entry;
+		if (mFree)
+		{
+			entry = mFree;
+			mFree = *reinterpret_cast<Entry**>(entry);
+		}
+		else
+		{
+			if (!mBlocks || mBlocks->mUsed == mBlocks->mCapacity)
+			{
+				// Small steps while the map is small, which most are, and
+				// geometric growth after that.
+				reserve(llmax((U32)4, (U32)mIndex.size() / 4));
+			}
+			entry = mBlocks->entries() + mBlocks->mUsed++;
+		}
+		new (entry) Entry(intern_key(k), v);
+		return entry;
+	}
+
+	ImplMap::Entry* ImplMap::insertEntry(size_t pos, const LLSD::String& k, const LLSD& v)
+	{
+		// By position rather than iterator, newEntry() may grow mIndex.
+		Entry* entry = newEntry(k, v);
+		mIndex.insert(mIndex.begin() + pos, entry);
+		return entry;
+	}
+
+	void ImplMap::deleteEntry(Entry* entry)
+	{
+		entry->~Entry();
+		*reinterpret_cast<Entry**>(entry) = mFree;
+		mFree = entry;
+	}
 
-		LLSD::map_iterator beginMap() { return mData.begin(); }
-		LLSD::map_iterator endMap() { return mData.end(); }
-		virtual LLSD::map_const_iterator beginMap() const { return mData.begin(); }
-		virtual LLSD::map_const_iterator endMap() const { return mData.end(); }
+	struct EntryKeyLess
+	{
+		bool operator()(const LLSD::map_value_type* entry, const LLSD::String& k) const
+		{
+			return entry->first < k;
+		}
 	};
+
+	ImplMap::Index::const_iterator ImplMap::lowerBound(const LLSD::String& k) const
+	{
+		return std::lower_bound(mIndex.begin(), mIndex.end(), k, EntryKeyLess());
+	}
+
+	ImplMap::Index::iterator ImplMap::lowerBound(const LLSD::String& k)
+	{
+		return std::lower_bound(mIndex.begin(), mIndex.end(), k, EntryKeyLess());
+	}
 	
 	ImplMap& ImplMap::makeMap(LLSD::Impl*& var)
 	{
 		if (shared())
 		{
-			ImplMap* i = new ImplMap(mData);
+			ImplMap* i = new ImplMap(*this);
 			Impl::assign(var, i);
 			return *i;
 		}
@@ -378,40 +571,54 @@ namespace
 	
 	bool ImplMap::has(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.find(k);
-		return i != mData.end();
+		return matches(lowerBound(k), k);
 	}
 	
 	LLSD ImplMap::get(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.find(k);
-		return (i != mData.end()) ? i->second : LLSD();
+		Index::const_iterator i = lowerBound(k);
+		return matches(i, k) ? (*i)->second : LLSD();
 	}
 	
 	void ImplMap::insert(const LLSD::String& k, const LLSD& v)
 	{
-		mData.insert(DataMap::value_type(k, v));
+		Index::iterator i = lowerBound(k);
+		if (!matches(i, k))
+		{
+			insertEntry(i - mIndex.begin(), k, v);
+		}
 	}
 	
 	void ImplMap::erase(const LLSD::String& k)
 	{
-		mData.erase(k);
+		Index::iterator i = lowerBound(k);
+		if (matches(i, k))
+		{
+			Entry* entry = *i;
+			mIndex.erase(i);
+			deleteEntry(entry);
+		}
 	}
 	
 	LLSD& ImplMap::ref(const LLSD::String& k)
 	{
-		return mData[k];
+		Index::iterator i = lowerBound(k);
+		if (!matches(i, k))
+		{
+			return insertEntry(i - mIndex.begin(), k, LLSD())->second;
+		}
+		return (*i)->second;
 	}
 	
 	const LLSD& ImplMap::ref(const LLSD::String& k) const
 	{
-		DataMap::const_iterator i = mData.lower_bound(k);
-		if (i == mData.end()  ||  mData.key_comp()(k, i->first))
+		Index::const_iterator i = lowerBound(k);
+		if (!matches(i, k))
 		{
 			return undef();
 		}
 		
-		return i->second;
+		return (*i)->second;
 	}
 
 	class ImplArray : public LLSD::Impl
@@ -658,6 +865,7 @@ const LLSD& LLSD::Impl::undef()
 
 U32 LLSD::Impl::sAllocationCount = 0;
 U32 LLSD::Impl::sOutstandingCount = 0;
+LLMemTag LLSD::Impl::sMemTag("LLSD");
 
 
 
@@ -786,6 +994,7 @@ const LLSD& LLSD::operator[](Integer i) const
 
 U32 LLSD::allocationCount()				{ return Impl::sAllocationCount; }
 U32 LLSD::outstandingCount()			{ return Impl::sOutstandingCount; }
+U32 LLSD::internedKeyCount()			{ return apr_atomic_read32(&sKeyCount); }
 
 static const char *llsd_dump(const LLSD &llsd, bool useXMLFormat)
 {
@@ -27,6 +27,7 @@
 #ifndef LL_LLSD_NEW_H
 #define LL_LLSD_NEW_H
 
+#include <iterator>
 #include <map>
 #include <string>
 #include <vector>
@@ -246,8 +247,40 @@ public:
 	//@{
 		int size() const;
 
-		typedef std::map<String, LLSD>::iterator		map_iterator;
-		typedef std::map<String, LLSD>::const_iterator	map_const_iterator;
+		/// Maps are kept as a vector of entries sorted by key rather than as
+		/// a std::map.  The iterators behave like std::map's, except that
+		/// inserting into or erasing from a map invalidates all of its
+		/// iterators, not just those to the erased entry.  References to
+		/// values stay good until the value is erased, as before.
+		typedef std::pair<const String, LLSD>			map_value_type;
+
+		template <class ENTRY>
+		class MapIterator :
+			public std::iterator<std::bidirectional_iterator_tag, ENTRY>
+		{
+		public:
+			MapIterator() : mPos(NULL) { }
+			explicit MapIterator(map_value_type* const* pos) : mPos(pos) { }
+			// iterator converts to const_iterator, not the other way around.
+			// For map_iterator itself this is just the copy constructor.
+			MapIterator(const MapIterator<map_value_type>& other) : mPos(other.position()) { }
+
+			ENTRY& operator*() const		{ return **mPos; }
+			ENTRY* operator->() const		{ return *mPos; }
+
+			MapIterator& operator++()		{ ++mPos; return *this; }
+			MapIterator operator++(int)		{ MapIterator tmp(*this); ++mPos; return tmp; }
+			MapIterator& operator--()		{ --mPos; return *this; }
+			MapIterator operator--(int)		{ MapIterator tmp(*this); --mPos; return tmp; }
+
+			map_value_type* const* position() const { return mPos; }
+
+		private:
+			map_value_type* const* mPos;
+		};
+
+		typedef MapIterator<map_value_type>				map_iterator;
+		typedef MapIterator<const map_value_type>		map_const_iterator;
 		
 		map_iterator		beginMap();
 		map_iterator		endMap();
@@ -327,6 +360,7 @@ private:
 public:
 		static U32 allocationCount();	///< how many Impls have been made
 		static U32 outstandingCount();	///< how many Impls are still alive
+		static U32 internedKeyCount();	///< how many map keys are in the shared key table
 	//@}
 
 private:
@@ -385,6 +419,18 @@ struct llsd_select_string : public std::unary_function<LLSD, LLSD::String>
 
 LL_COMMON_API std::ostream& operator<<(std::ostream& s, const LLSD& llsd);
 
+template <class A, class B>
+inline bool operator==(const LLSD::MapIterator<A>& a, const LLSD::MapIterator<B>& b)
+{
+	return a.position() == b.position();
+}
+
+template <class A, class B>
+inline bool operator!=(const LLSD::MapIterator<A>& a, const LLSD::MapIterator<B>& b)
+{
+	return a.position() != b.position();
+}
+
 /** QUESTIONS & TO DOS
 	- Would Binary be more convenient as usigned char* buffer semantics?
 	- Should Binary be convertable to/from String, and if so how?
@@ -36,6 +36,12 @@
 #include <winnls.h> // for WideCharToMultiByte
 #endif
 
+// Every platform the viewer builds for has SSE2 (/arch:SSE2, -msse2)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LL_STRING_SSE2 1
+#endif
+
 LLFastTimer::DeclareTimer FT_STRING_FORMAT("String Format");
 
 
@@ -119,8 +125,187 @@ std::ostream& operator<<(std::ostream &s, const LLWString &wstr)
 	return s;
 }
 
+namespace
+{
+	// The conversions below copy runs of ASCII 16 characters at a time and
+	// only decode or encode one character at a time where there is
+	// something to do.  Anything that isn't plain ASCII goes through the
+	// same character code as before, so the results are exactly the same.
+
+	// Number of bytes before the first one that isn't ASCII.
+	S32 ascii_length(const char* in, S32 len)
+	{
+		S32 i = 0;
+#if LL_STRING_SSE2
+		while (i + 16 <= len)
+		{
+			S32 mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(in + i)));
+			if (mask)
+			{
+				// The first byte with its high bit set
+				while (!(mask & 1))
+				{
+					mask >>= 1;
+					i++;
+				}
+				return i;
+			}
+			i += 16;
+		}
+#endif
+		while (i < len && !(in[i] & 0x80))
+		{
+			i++;
+		}
+		return i;
+	}
+
+	// Widens the leading ASCII bytes of in to out and returns how many.
+	S32 widen_ascii(const char* in, S32 len, llwchar* out)
+	{
+		S32 i = 0;
+#if LL_STRING_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		while (i + 16 <= len)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+			if (_mm_movemask_epi8(bytes))
+			{
+				break;
+			}
+			__m128i low = _mm_unpacklo_epi8(bytes, zero);
+			__m128i high = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi16(low, zero));
+			_mm_storeu_si128((__m128i*)(out + i + 4), _mm_unpackhi_epi16(low, zero));
+			_mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpacklo_epi16(high, zero));
+			_mm_storeu_si128((__m128i*)(out + i + 12), _mm_unpackhi_epi16(high, zero));
+			i += 16;
+		}
+#endif
+		while (i < len && !(in[i] & 0x80))
+		{
+			out[i] = (U8)in[i];
+			i++;
+		}
+		return i;
+	}
+
+	// Narrows the leading characters of in that are ASCII, other than NUL
+	// which wstring_to_utf8str() drops, to out and returns how many.
+	S32 narrow_ascii(const llwchar* in, S32 len, char* out)
+	{
+		S32 i = 0;
+#if LL_STRING_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i not_ascii = _mm_set1_epi32(~0x7F);
+		while (i + 16 <= len)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(in + i + 4));
+			__m128i c = _mm_loadu_si128((const __m128i*)(in + i + 8));
+			__m128i d = _mm_loadu_si128((const __m128i*)(in + i + 12));
+			__m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), not_ascii);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, zero)) != 0xFFFF)
+			{
+				break;
+			}
+			// All below 0x80, so neither pack saturates
+			__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)))
+			{
+				break;
+			}
+			_mm_storeu_si128((__m128i*)(out + i), bytes);
+			i += 16;
+		}
+#endif
+		while (i < len && (U32)in[i] < 0x80 && in[i] != 0)
+		{
+			out[i] = (char)in[i];
+			i++;
+		}
+		return i;
+	}
+
+	// Decodes the character starting with the byte at utf8[i], which isn't
+	// ASCII, and returns the index of its last byte.  Looks at utf8[len]
+	// for a sequence cut off by the end, as it always has.
+	S32 utf8_decode_char(const char* utf8str, S32 i, S32 len, llwchar& unichar)
+	{
+		U8 cur_char = utf8str[i];
+		S32 cont_bytes = 0;
+		if ((cur_char >> 5) == 0x6)			// Two byte UTF8 -> 1 UTF32
+		{
+			unichar = (0x1F&cur_char);
+			cont_bytes = 1;
+		}
+		else if ((cur_char >> 4) == 0xe)	// Three byte UTF8 -> 1 UTF32
+		{
+			unichar = (0x0F&cur_char);
+			cont_bytes = 2;
+		}
+		else if ((cur_char >> 3) == 0x1e)	// Four byte UTF8 -> 1 UTF32
+		{
+			unichar = (0x07&cur_char);
+			cont_bytes = 3;
+		}
+		else if ((cur_char >> 2) == 0x3e)	// Five byte UTF8 -> 1 UTF32
+		{
+			unichar = (0x03&cur_char);
+			cont_bytes = 4;
+		}
+		else if ((cur_char >> 1) == 0x7e)	// Six byte UTF8 -> 1 UTF32
+		{
+			unichar = (0x01&cur_char);
+			cont_bytes = 5;
+		}
+		else
+		{
+			unichar = LL_UNKNOWN_CHAR;
+			return i;
+		}
+
+		// Check that this character doesn't go past the end of the string
+		S32 end = (len < (i + cont_bytes)) ? len : (i + cont_bytes);
+		do
+		{
+			++i;
+
+			cur_char = utf8str[i];
+			if ( (cur_char >> 6) == 0x2 )
+			{
+				unichar <<= 6;
+				unichar += (0x3F&cur_char);
+			}
+			else
+			{
+				// Malformed sequence - roll back to look at this as a new char
+				unichar = LL_UNKNOWN_CHAR;
+				--i;
+				break;
+			}
+		} while(i < end);
+
+		// Handle overlong characters and NULL characters
+		if ( ((cont_bytes == 1) && (unichar < 0x80))
+			|| ((cont_bytes == 2) && (unichar < 0x800))
+			|| ((cont_bytes == 3) && (unichar < 0x10000))
+			|| ((cont_bytes == 4) && (unichar < 0x200000))
+			|| ((cont_bytes == 5) && (unichar < 0x4000000)) )
+		{
+			unichar = LL_UNKNOWN_CHAR;
+		}
+		return i;
+	}
+}
+
 std::string rawstr_to_utf8(const std::string& raw)
 {
+	// Valid UTF-8 comes back unchanged, apart from any NULs
+	if (utf8str_is_valid(raw) && raw.find('\0') == std::string::npos)
+	{
+		return raw;
+	}
 	LLWString wstr(utf8str_to_wstring(raw));
 	return wstring_to_utf8str(wstr);
 }
@@ -377,88 +562,30 @@ S32 wstring_utf8_length(const LLWString& wstr)
 LLWString utf8str_to_wstring(const std::string& utf8str, S32 len)
 {
 	LLWString wout;
+	if (len <= 0)
+	{
+		return wout;
+	}
+
+	// Never more characters than bytes
+	wout.resize(len);
+	llwchar* const begin = &wout[0];
+	llwchar* out = begin;
+	const char* in = utf8str.c_str();
 
 	S32 i = 0;
 	while (i < len)
 	{
-		llwchar unichar;
-		U8 cur_char = utf8str[i];
-
-		if (cur_char < 0x80)
-		{
-			// Ascii character, just add it
-			unichar = cur_char;
-		}
-		else
+		S32 ascii = widen_ascii(in + i, len - i, out);
+		i += ascii;
+		out += ascii;
+		if (i < len)
 		{
-			S32 cont_bytes = 0;
-			if ((cur_char >> 5) == 0x6)			// Two byte UTF8 -> 1 UTF32
-			{
-				unichar = (0x1F&cur_char);
-				cont_bytes = 1;
-			}
-			else if ((cur_char >> 4) == 0xe)	// Three byte UTF8 -> 1 UTF32
-			{
-				unichar = (0x0F&cur_char);
-				cont_bytes = 2;
-			}
-			else if ((cur_char >> 3) == 0x1e)	// Four byte UTF8 -> 1 UTF32
-			{
-				unichar = (0x07&cur_char);
-				cont_bytes = 3;
-			}
-			else if ((cur_char >> 2) == 0x3e)	// Five byte UTF8 -> 1 UTF32
-			{
-				unichar = (0x03&cur_char);
-				cont_bytes = 4;
-			}
-			else if ((cur_char >> 1) == 0x7e)	// Six byte UTF8 -> 1 UTF32
-			{
-				unichar = (0x01&cur_char);
-				cont_bytes = 5;
-			}
-			else
-			{
-				wout += LL_UNKNOWN_CHAR;
-				++i;
-				continue;
-			}
-
-			// Check that this character doesn't go past the end of the string
-			S32 end = (len < (i + cont_bytes)) ? len : (i + cont_bytes);
-			do
-			{
-				++i;
-
-				cur_char = utf8str[i];
-				if ( (cur_char >> 6) == 0x2 )
-				{
-					unichar <<= 6;
-					unichar += (0x3F&cur_char);
-				}
-				else
-				{
-					// Malformed sequence - roll back to look at this as a new char
-					unichar = LL_UNKNOWN_CHAR;
-					--i;
-					break;
-				}
-			} while(i < end);
-
-			// Handle overlong characters and NULL characters
-			if ( ((cont_bytes == 1) && (unichar < 0x80))
-				|| ((cont_bytes == 2) && (unichar < 0x800))
-				|| ((cont_bytes == 3) && (unichar < 0x10000))
-				|| ((cont_bytes == 4) && (unichar < 0x200000))
-				|| ((cont_bytes == 5) && (unichar < 0x4000000)) )
-			{
-				unichar = LL_UNKNOWN_CHAR;
-			}
+			i = utf8_decode_char(in, i, len, *out++);
+			++i;
 		}
-
-		wout += unichar;
-		++i;
 	}
+	wout.resize(out - begin);
 	return wout;
 }
 
@@ -471,16 +598,42 @@ LLWString utf8str_to_wstring(const std::string& utf8str)
 std::string wstring_to_utf8str(const LLWString& utf32str, S32 len)
 {
 	std::string out;
+	if (len <= 0)
+	{
+		return out;
+	}
+	out.reserve(len);
+
+	// Encode into a buffer on the stack and append that a piece at a time
+	const S32 BUFFER_SIZE = 1024;
+	const S32 MAX_CHAR_BYTES = 6;
+	char buffer[BUFFER_SIZE];		/* Flawfinder: ignore */
+	S32 used = 0;
+	const llwchar* in = utf32str.data();
 
 	S32 i = 0;
 	while (i < len)
 	{
-		char tchars[8];		/* Flawfinder: ignore */
-		S32 n = wchar_to_utf8chars(utf32str[i], tchars);
-		tchars[n] = 0;
-		out += tchars;
-		i++;
+		S32 room = BUFFER_SIZE - MAX_CHAR_BYTES - used;
+		S32 ascii = narrow_ascii(in + i, llmin(len - i, room), buffer + used);
+		i += ascii;
+		used += ascii;
+		if (i < len)
+		{
+			// Not ASCII, a NUL, or the end of the room in the buffer
+			if (in[i] != 0)
+			{
+				used += wchar_to_utf8chars(in[i], buffer + used);
+			}
+			i++;
+		}
+		if (used + MAX_CHAR_BYTES >= BUFFER_SIZE)
+		{
+			out.append(buffer, used);
+			used = 0;
+		}
 	}
+	out.append(buffer, used);
 	return out;
 }
 
@@ -490,6 +643,69 @@ std::string wstring_to_utf8str(const LLWString& utf32str)
 	return wstring_to_utf8str(utf32str, len);
 }
 
+bool utf8str_is_valid(const std::string& utf8str)
+{
+	const char* in = utf8str.data();
+	const S32 len = (S32)utf8str.length();
+	S32 i = 0;
+	while (true)
+	{
+		i += ascii_length(in + i, len - i);
+		if (i >= len)
+		{
+			return true;
+		}
+
+		U8 lead = in[i];
+		S32 cont_bytes;
+		U32 unichar;
+		U32 min_char;
+		if ((lead & 0xE0) == 0xC0)
+		{
+			cont_bytes = 1;
+			unichar = lead & 0x1F;
+			min_char = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			cont_bytes = 2;
+			unichar = lead & 0x0F;
+			min_char = 0x800;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			cont_bytes = 3;
+			unichar = lead & 0x07;
+			min_char = 0x10000;
+		}
+		else
+		{
+			// A stray continuation byte or an old five or six byte lead
+			return false;
+		}
+		if (i + cont_bytes >= len)
+		{
+			return false;
+		}
+		for (S32 j = 1; j <= cont_bytes; j++)
+		{
+			U8 cont = in[i + j];
+			if ((cont & 0xC0) != 0x80)
+			{
+				return false;
+			}
+			unichar = (unichar << 6) | (cont & 0x3F);
+		}
+		if (unichar < min_char
+			|| unichar > 0x10FFFF
+			|| (unichar >= 0xD800 && unichar <= 0xDFFF))
+		{
+			return false;
+		}
+		i += cont_bytes + 1;
+	}
+}
+
 std::string utf16str_to_utf8str(const llutf16string& utf16str)
 {
 	return wstring_to_utf8str(utf16str_to_wstring(utf16str));
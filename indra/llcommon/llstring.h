@@ -467,6 +467,10 @@ LL_COMMON_API std::string wstring_to_utf8str(const LLWString &utf32str);
 LL_COMMON_API std::string utf16str_to_utf8str(const llutf16string &utf16str, S32 len);
 LL_COMMON_API std::string utf16str_to_utf8str(const llutf16string &utf16str);
 
+// True if utf8str is well formed UTF-8 as RFC 3629 has it: no overlong
+// forms, surrogates, or characters past U+10FFFF.
+LL_COMMON_API bool utf8str_is_valid(const std::string& utf8str);
+
 // Length of this UTF32 string in bytes when transformed to UTF8
 LL_COMMON_API S32 wstring_utf8_length(const LLWString& wstr); 
 
@@ -50,82 +50,109 @@ LLStringTableEntry::~LLStringTableEntry()
 }
 
 LLStringTable::LLStringTable(int tablesize)
-: mUniqueEntries(0)
 {
-	S32 i;
 	if (!tablesize)
 		tablesize = 4096; // some arbitrary default
-	// Make sure tablesize is power of 2
-	for (i = 31; i>0; i--)
+	// Spread the expected strings over the stripes, power of 2 each
+	U32 size = 16;
+	while (size < (U32)tablesize / NUM_STRIPES)
 	{
-		if (tablesize & (1<<i))
-		{
-			if (tablesize >= (3<<(i-1)))
-				tablesize = (1<<(i+1));
-			else
-				tablesize = (1<<i);
-			break;
-		}
+		size <<= 1;
 	}
-	mMaxEntries = tablesize;
-
-#if !STRING_TABLE_HASH_MAP
-	// ALlocate strings
-	mStringList = new string_list_ptr_t[mMaxEntries];
-	// Clear strings
-	for (i = 0; i < mMaxEntries; i++)
+	for (S32 i = 0; i < NUM_STRIPES; i++)
 	{
-		mStringList[i] = NULL;
+		mStripes[i].mTable = newTable(size);
+		mStripes[i].mCount = 0;
+		mStripes[i].mLock = 0;
 	}
-#endif
+	mUniqueEntries = 0;
 }
 
 LLStringTable::~LLStringTable()
 {
-#if !STRING_TABLE_HASH_MAP
-	if (mStringList)
+	for (S32 i = 0; i < NUM_STRIPES; i++)
 	{
-		for (S32 i = 0; i < mMaxEntries; i++)
+		Table* table = mStripes[i].mTable;
+		for (U32 slot = 0; slot <= table->mMask; slot++)
 		{
-			if (mStringList[i])
-			{
-				string_list_t::iterator iter;
-				for (iter = mStringList[i]->begin(); iter != mStringList[i]->end(); iter++)
-					delete *iter; // *iter = (LLStringTableEntry*)
-			}
-			delete mStringList[i];
+			delete table->mSlots[slot].mEntry;
+		}
+		while (table)
+		{
+			Table* retired = table->mRetired;
+			free(table);
+			table = retired;
 		}
-		delete [] mStringList;
-		mStringList = NULL;
+		mStripes[i].mTable = NULL;
 	}
-#else
-	// Need to clean up the string hash
-	for_each(mStringHash.begin(), mStringHash.end(), DeletePairedPointer());
-	mStringHash.clear();
-#endif
 }
 
+// FNV-1a, over the part of the string an entry keeps
+//static
+U32 LLStringTable::hashString(const char* str)
+{
+	U32 hash = 2166136261U;
+	for (U32 i = 0; str[i] && i < MAX_STRINGS_LENGTH - 1; i++)
+	{
+		hash = (hash ^ (U8)str[i]) * 16777619U;
+	}
+	return hash;
+}
+
+//static
+LLStringTable::Table* LLStringTable::newTable(U32 size)
+{
+	size_t bytes = sizeof(Table) + (size - 1) * sizeof(Slot);
+	Table* table = (Table*)malloc(bytes);
+	if (!table)
+	{
+		llerrs << "LLStringTable: out of memory growing to " << size << " slots" << llendl;
+	}
+	memset(table, 0, bytes);
+	table->mMask = size - 1;
+	return table;
+}
 
-static U32 hash_my_string(const char *str, int max_entries)
+//static
+LLStringTableEntry* LLStringTable::find(const Table* table, U32 hash, const char* str)
 {
-	U32 retval = 0;
-#if 0
-	while (*str)
+	U32 slot = hash & table->mMask;
+	while (true)
 	{
-		retval <<= 1;
-		retval += *str++;
+		LLStringTableEntry* entry = table->mSlots[slot].mEntry;
+		if (!entry)
+		{
+			return NULL;
+		}
+		if (table->mSlots[slot].mHash == hash
+			&& !strncmp(entry->mString, str, MAX_STRINGS_LENGTH - 1))
+		{
+			return entry;
+		}
+		slot = (slot + 1) & table->mMask;
 	}
-#else
-	while (*str)
+}
+
+// Stripe locked
+void LLStringTable::grow(Stripe& stripe)
+{
+	Table* old_table = stripe.mTable;
+	Table* table = newTable((old_table->mMask + 1) * 2);
+	for (U32 i = 0; i <= old_table->mMask; i++)
 	{
-		retval = (retval<<4) + *str;
-		U32 x = (retval & 0xf0000000);
-		if (x) retval = retval ^ (x>>24);
-		retval = retval & (~x);
-		str++;
+		const Slot& old_slot = old_table->mSlots[i];
+		if (old_slot.mEntry)
+		{
+			U32 slot = old_slot.mHash & table->mMask;
+			while (table->mSlots[slot].mEntry)
+			{
+				slot = (slot + 1) & table->mMask;
+			}
+			table->mSlots[slot] = old_slot;
+		}
 	}
-#endif
-	return (retval & (max_entries-1)); // max_entries is gauranteed to be power of 2
+	table->mRetired = old_table;
+	apr_atomic_casptr((volatile void**)&stripe.mTable, table, old_table);
 }
 
 char* LLStringTable::checkString(const std::string& str)
@@ -155,43 +182,12 @@ LLStringTableEntry* LLStringTable::checkStringEntry(const char *str)
 {
 	if (str)
 	{
-		char *ret_val;
-		LLStringTableEntry	*entry;
-		U32					hash_value = hash_my_string(str, mMaxEntries);
-#if STRING_TABLE_HASH_MAP
-#if 1 // Microsoft
-		string_hash_t::iterator lower = mStringHash.lower_bound(hash_value);
-		string_hash_t::iterator upper = mStringHash.upper_bound(hash_value);
-#else // stlport
-		std::pair<string_hash_t::iterator, string_hash_t::iterator> P = mStringHash.equal_range(hash_value);
-		string_hash_t::iterator lower = P.first;
-		string_hash_t::iterator upper = P.second;
-#endif
-		for (string_hash_t::iterator iter = lower; iter != upper; iter++)
-		{
-			entry = iter->second;
-			ret_val = entry->mString;
-			if (!strncmp(ret_val, str, MAX_STRINGS_LENGTH))
-			{
-				return entry;
-			}
-		}
-#else
-		string_list_t		*strlist = mStringList[hash_value];
-		if (strlist)
+		U32 hash = hashString(str);
+		LLStringTableEntry* entry = find(mStripes[hash >> STRIPE_SHIFT].mTable, hash, str);
+		if (entry && apr_atomic_read32(&entry->mCount))
 		{
-			string_list_t::iterator iter;
-			for (iter = strlist->begin(); iter != strlist->end(); iter++)
-			{
-				entry = *iter;
-				ret_val = entry->mString;
-				if (!strncmp(ret_val, str, MAX_STRINGS_LENGTH))
-				{
-					return entry;
-				}
-			}
+			return entry;
 		}
-#endif
 	}
 	return NULL;
 }
@@ -223,136 +219,75 @@ LLStringTableEntry* LLStringTable::addStringEntry(const std::string& str)
 
 LLStringTableEntry* LLStringTable::addStringEntry(const char *str)
 {
-	if (str)
+	if (!str)
 	{
-		char *ret_val = NULL;
-		LLStringTableEntry	*entry;
-		U32					hash_value = hash_my_string(str, mMaxEntries);
-#if STRING_TABLE_HASH_MAP
-#if 1 // Microsoft
-		string_hash_t::iterator lower = mStringHash.lower_bound(hash_value);
-		string_hash_t::iterator upper = mStringHash.upper_bound(hash_value);
-#else // stlport
-		std::pair<string_hash_t::iterator, string_hash_t::iterator> P = mStringHash.equal_range(hash_value);
-		string_hash_t::iterator lower = P.first;
-		string_hash_t::iterator upper = P.second;
-#endif
-		for (string_hash_t::iterator iter = lower; iter != upper; iter++)
-		{
-			entry = iter->second;
-			ret_val = entry->mString;
-			if (!strncmp(ret_val, str, MAX_STRINGS_LENGTH))
-			{
-				entry->incCount();
-				return entry;
-			}
-		}
+		return NULL;
+	}
 
-		// not found, so add!
-		LLStringTableEntry* newentry = new LLStringTableEntry(str);
-		ret_val = newentry->mString;
-		mStringHash.insert(string_hash_t::value_type(hash_value, newentry));
-#else
-		string_list_t		*strlist = mStringList[hash_value];
+	U32 hash = hashString(str);
+	Stripe& stripe = mStripes[hash >> STRIPE_SHIFT];
 
-		if (strlist)
+	// Almost always already there
+	LLStringTableEntry* entry = find(stripe.mTable, hash, str);
+	if (!entry)
+	{
+		LLStringTableEntry* newentry = new LLStringTableEntry(str);
+		while (apr_atomic_cas32(&stripe.mLock, 1, 0) != 0)
+		{
+			// Only held while a slot is filled, or rarely to grow
+		}
+		// Another thread may have added it since we looked
+		entry = find(stripe.mTable, hash, str);
+		if (!entry)
 		{
-			string_list_t::iterator iter;
-			for (iter = strlist->begin(); iter != strlist->end(); iter++)
+			if ((stripe.mCount + 1) * 2 > stripe.mTable->mMask + 1)
 			{
-				entry = *iter;
-				ret_val = entry->mString;
-				if (!strncmp(ret_val, str, MAX_STRINGS_LENGTH))
-				{
-					entry->incCount();
-					return entry;
-				}
+				grow(stripe);
 			}
+			Table* table = stripe.mTable;
+			U32 slot = hash & table->mMask;
+			while (table->mSlots[slot].mEntry)
+			{
+				slot = (slot + 1) & table->mMask;
+			}
+			table->mSlots[slot].mHash = hash;
+			// Publish the entry after its hash, for the lock free readers
+			apr_atomic_casptr((volatile void**)&table->mSlots[slot].mEntry, newentry, NULL);
+			stripe.mCount++;
+			entry = newentry;
+			newentry = NULL;
 		}
-		else
+		apr_atomic_set32(&stripe.mLock, 0);
+
+		if (!newentry)
 		{
-			mStringList[hash_value] = new string_list_t;
-			strlist = mStringList[hash_value];
+			apr_atomic_inc32(&mUniqueEntries);
+			return entry;
 		}
-
-		// not found, so add!
-		LLStringTableEntry *newentry = new LLStringTableEntry(str);
-		//ret_val = newentry->mString;
-		strlist->push_front(newentry);
-#endif
-		mUniqueEntries++;
-		return newentry;
+		delete newentry;
 	}
-	else
+
+	if (apr_atomic_inc32(&entry->mCount) == 0)
 	{
-		return NULL;
+		// Removed earlier and now back
+		apr_atomic_inc32(&mUniqueEntries);
 	}
+	return entry;
 }
 
 void LLStringTable::removeString(const char *str)
 {
 	if (str)
 	{
-		char *ret_val;
-		LLStringTableEntry	*entry;
-		U32					hash_value = hash_my_string(str, mMaxEntries);
-#if STRING_TABLE_HASH_MAP
-		{
-#if 1 // Microsoft
-			string_hash_t::iterator lower = mStringHash.lower_bound(hash_value);
-			string_hash_t::iterator upper = mStringHash.upper_bound(hash_value);
-#else // stlport
-			std::pair<string_hash_t::iterator, string_hash_t::iterator> P = mStringHash.equal_range(hash_value);
-			string_hash_t::iterator lower = P.first;
-			string_hash_t::iterator upper = P.second;
-#endif
-			for (string_hash_t::iterator iter = lower; iter != upper; iter++)
-			{
-				entry = iter->second;
-				ret_val = entry->mString;
-				if (!strncmp(ret_val, str, MAX_STRINGS_LENGTH))
-				{
-					if (!entry->decCount())
-					{
-						mUniqueEntries--;
-						if (mUniqueEntries < 0)
-						{
-							llerror("LLStringTable:removeString trying to remove too many strings!", 0);
-						}
-						delete iter->second;
-						mStringHash.erase(iter);
-					}
-					return;
-				}
-			}
-		}
-#else
-		string_list_t		*strlist = mStringList[hash_value];
-
-		if (strlist)
+		U32 hash = hashString(str);
+		LLStringTableEntry* entry = find(mStripes[hash >> STRIPE_SHIFT].mTable, hash, str);
+		if (entry && apr_atomic_read32(&entry->mCount))
 		{
-			string_list_t::iterator iter;
-			for (iter = strlist->begin(); iter != strlist->end(); iter++)
+			if (!entry->decCount())
 			{
-				entry = *iter;
-				ret_val = entry->mString;
-				if (!strncmp(ret_val, str, MAX_STRINGS_LENGTH))
-				{
-					if (!entry->decCount())
-					{
-						mUniqueEntries--;
-						if (mUniqueEntries < 0)
-						{
-							llerror("LLStringTable:removeString trying to remove too many strings!", 0);
-						}
-						strlist->remove(entry);
-						delete entry;
-					}
-					return;
-				}
+				apr_atomic_dec32(&mUniqueEntries);
 			}
 		}
-#endif
 	}
 }
 
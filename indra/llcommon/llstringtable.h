@@ -31,24 +31,9 @@
 #include "lldefs.h"
 #include "llformat.h"
 #include "llstl.h"
-#include <list>
 #include <set>
 
-#if LL_WINDOWS
-# if (_MSC_VER >= 1300 && _MSC_VER < 1400)
-#  define STRING_TABLE_HASH_MAP 1
-# endif
-#else
-//# define STRING_TABLE_HASH_MAP 1
-#endif
-
-#if STRING_TABLE_HASH_MAP
-# if LL_WINDOWS
-#  include <hash_map>
-# else
-#  include <ext/hash_map>
-# endif
-#endif
+#include "apr_atomic.h"
 
 const U32 MAX_STRINGS_LENGTH = 256;
 
@@ -58,13 +43,26 @@ public:
 	LLStringTableEntry(const char *str);
 	~LLStringTableEntry();
 
-	void incCount()		{ mCount++; }
-	BOOL decCount()		{ return --mCount; }
+	void incCount()		{ apr_atomic_inc32(&mCount); }
+	BOOL decCount()		{ return apr_atomic_dec32(&mCount) != 0; }
 
 	char *mString;
-	S32  mCount;
+	volatile apr_uint32_t mCount;
 };
 
+//============================================================================
+// Interns strings, handing back one shared copy per distinct string.
+//
+// Safe to use from any thread.  Lookups are lock free; adding a string the
+// table hasn't seen takes a spin lock on one of NUM_STRIPES independent
+// open addressing tables, picked by the top bits of the hash, so threads
+// only contend when they add new strings to the same stripe.
+//
+// Entries stay where they are for the life of the table, so the pointers
+// handed out are stable and lookups never look at freed memory.  A string
+// removed as many times as it was added is hidden from checkString() and
+// revived by the next addString(), rather than deleted.
+
 class LL_COMMON_API LLStringTable
 {
 public:
@@ -82,21 +80,42 @@ public:
 	LLStringTableEntry *addStringEntry(const std::string& str);
 	void  removeString(const char *str);
 
-	S32 mMaxEntries;
-	S32 mUniqueEntries;
-	
-#if STRING_TABLE_HASH_MAP
-#if LL_WINDOWS
-	typedef std::hash_multimap<U32, LLStringTableEntry *> string_hash_t;
-#else
-	typedef __gnu_cxx::hash_multimap<U32, LLStringTableEntry *> string_hash_t;
-#endif
-	string_hash_t mStringHash;
-#else
-	typedef std::list<LLStringTableEntry *> string_list_t;
-	typedef string_list_t * string_list_ptr_t;
-	string_list_ptr_t	*mStringList;
-#endif	
+	// Strings added and not yet removed
+	S32 getUniqueEntries() const	{ return (S32)apr_atomic_read32(const_cast<volatile apr_uint32_t*>(&mUniqueEntries)); }
+
+private:
+	enum { NUM_STRIPES = 32, STRIPE_SHIFT = 27 };
+
+	struct Slot
+	{
+		LLStringTableEntry* volatile mEntry;
+		U32 mHash;
+	};
+
+	// One open addressing table, replaced by one twice the size when it
+	// gets half full.  Replaced tables are kept until the string table is
+	// destroyed since lock free readers may still be probing them.
+	struct Table
+	{
+		U32 mMask;
+		Table* mRetired;
+		Slot mSlots[1]; // [mMask + 1]
+	};
+
+	struct Stripe
+	{
+		Table* volatile mTable;
+		U32 mCount;
+		volatile apr_uint32_t mLock;
+	};
+
+	static U32 hashString(const char* str);
+	static Table* newTable(U32 size);
+	static LLStringTableEntry* find(const Table* table, U32 hash, const char* str);
+	void grow(Stripe& stripe);
+
+	Stripe mStripes[NUM_STRIPES];
+	volatile apr_uint32_t mUniqueEntries;
 };
 
 extern LL_COMMON_API LLStringTable gStringTable;
@@ -30,6 +30,7 @@
 
 #include "llthread.h"
 
+#include "llfasttimer.h"
 #include "lltimer.h"
 
 #if LL_LINUX || LL_SOLARIS
@@ -81,6 +82,7 @@ void *APR_THREAD_FUNC LLThread::staticRun(apr_thread_t *apr_threadp, void *datap
 #if !LL_DARWIN
 	sThreadID = threadp->mID;
 #endif
+	LLFastTimer::setThreadName(threadp->mName);
 
 	// Run the user supplied function
 	threadp->run();
@@ -30,6 +30,7 @@
 #include <set>
 #include "stdtypes.h"
 #include "llpreprocessor.h"
+#include "llfasthash.h"
 
 const S32 UUID_BYTES = 16;
 const S32 UUID_WORDS = 4;
@@ -300,6 +301,14 @@ inline U32 LLUUID::getCRC32() const
 	return tmp[0] + tmp[1] + tmp[2] + tmp[3];
 }
 
+// Lets boost::hash, and so boost::unordered containers, take LLUUID keys.
+// Not getCRC32(), which is a plain sum that UUIDs made by hand or folded
+// together with LLUUID::combine() cluster badly under.
+inline std::size_t hash_value(const LLUUID& id)
+{
+	return (std::size_t)ll_hash64_16(id.mData);
+}
+
 
 // Helper structure for ordering lluuids in stl containers.
 // eg: 	std::map<LLUUID, LLWidget*, lluuid_less> widget_map;
@@ -237,10 +237,12 @@ inline S32 LLUUIDHashMap<DATA_TYPE, SIZE>::getLength() const
 template <class DATA_TYPE, int SIZE>
 inline DATA_TYPE &LLUUIDHashMap<DATA_TYPE, SIZE>::get(const LLUUID &uuid)
 {
-	LLUUIDHashNode<DATA_TYPE, SIZE>* nodep = &mNodes[uuid.mData[0]];
+	const U32 hash = (U32)hash_value(uuid);
+	const S32 bin = hash & 0xFF;
+	LLUUIDHashNode<DATA_TYPE, SIZE>* nodep = &mNodes[bin];
 
-	// Grab the second byte of the UUID, which is the key for the node data
-	const S32 second_byte = uuid.mData[1];
+	// The second byte of the hash is the key for the node data
+	const S32 second_byte = (hash >> 8) & 0xFF;
 	while (nodep)
 	{
 		S32 i;
@@ -251,7 +253,7 @@ inline DATA_TYPE &LLUUIDHashMap<DATA_TYPE, SIZE>::get(const LLUUID &uuid)
 		{
 			if ((nodep->mKey[i] == second_byte) && mEquals(uuid, nodep->mData[i]))
 			{
-				// The second byte matched, and our equality test passed.
+				// The key matched, and our equality test passed.
 				// We found it.
 				return nodep->mData[i];
 			}
@@ -267,10 +269,12 @@ inline DATA_TYPE &LLUUIDHashMap<DATA_TYPE, SIZE>::get(const LLUUID &uuid)
 template <class DATA_TYPE, int SIZE>
 inline BOOL LLUUIDHashMap<DATA_TYPE, SIZE>::check(const LLUUID &uuid) const
 {
-	const LLUUIDHashNode<DATA_TYPE, SIZE>* nodep = &mNodes[uuid.mData[0]];
+	const U32 hash = (U32)hash_value(uuid);
+	const S32 bin = hash & 0xFF;
+	const LLUUIDHashNode<DATA_TYPE, SIZE>* nodep = &mNodes[bin];
 
-	// Grab the second byte of the UUID, which is the key for the node data
-	const S32 second_byte = uuid.mData[1];
+	// The second byte of the hash is the key for the node data
+	const S32 second_byte = (hash >> 8) & 0xFF;
 	while (nodep)
 	{
 		S32 i;
@@ -281,7 +285,7 @@ inline BOOL LLUUIDHashMap<DATA_TYPE, SIZE>::check(const LLUUID &uuid) const
 		{
 			if ((nodep->mKey[i] == second_byte) && mEquals(uuid, nodep->mData[i]))
 			{
-				// The second byte matched, and our equality test passed.
+				// The key matched, and our equality test passed.
 				// We found it.
 				return TRUE;
 			}
@@ -303,9 +307,11 @@ inline DATA_TYPE &LLUUIDHashMap<DATA_TYPE, SIZE>::set(const LLUUID &uuid, const
 	// we replace it with the input value.
 	// If we don't find a match, we append to the end of the list.
 
-	LLUUIDHashNode<DATA_TYPE, SIZE>* nodep = &mNodes[uuid.mData[0]];
+	const U32 hash = (U32)hash_value(uuid);
+	const S32 bin = hash & 0xFF;
+	LLUUIDHashNode<DATA_TYPE, SIZE>* nodep = &mNodes[bin];
 
-	const S32 second_byte = uuid.mData[1];
+	const S32 second_byte = (hash >> 8) & 0xFF;
 	while (1)
 	{
 		const S32 count = nodep->mCount;
@@ -366,10 +372,12 @@ inline BOOL LLUUIDHashMap<DATA_TYPE, SIZE>::remove(const LLUUID &uuid)
 	// to deal with deleting the node from the tail if it's empty, but
 	// NOT if it's the only node left.
 
-	LLUUIDHashNode<DATA_TYPE, SIZE> *nodep = &mNodes[uuid.mData[0]];
+	const U32 hash = (U32)hash_value(uuid);
+	const S32 bin = hash & 0xFF;
+	LLUUIDHashNode<DATA_TYPE, SIZE> *nodep = &mNodes[bin];
 
 	// Not empty, we need to search through the nodes
-	const S32 second_byte = uuid.mData[1];
+	const S32 second_byte = (hash >> 8) & 0xFF;
 
 	// A modification of the standard search algorithm.
 	while (nodep)
@@ -386,7 +394,7 @@ inline BOOL LLUUIDHashMap<DATA_TYPE, SIZE>::remove(const LLUUID &uuid)
 				// element.  We could conceviably start from the node we're on,
 				// but that makes it more complicated, this is easier.
 
-				LLUUIDHashNode<DATA_TYPE, SIZE> *prevp = &mNodes[uuid.mData[0]];
+				LLUUIDHashNode<DATA_TYPE, SIZE> *prevp = &mNodes[bin];
 				LLUUIDHashNode<DATA_TYPE, SIZE> *lastp = prevp;
 
 				// Find the last and next-to-last
@@ -407,7 +415,7 @@ inline BOOL LLUUIDHashMap<DATA_TYPE, SIZE>::remove(const LLUUID &uuid)
 				if (!lastp->mCount)
 				{
 					// We deleted the last element!
-					if (lastp != &mNodes[uuid.mData[0]])
+					if (lastp != &mNodes[bin])
 					{
 						// Only blitz the node if it's not the head
 						// Set the previous node to point to NULL, then
@@ -34,8 +34,8 @@
 //============================================================================
 // Run on MAIN thread
 
-LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded) :
-	LLQueuedThread(name, threaded)
+LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, bool hosted) :
+	LLQueuedThread(name, threaded, hosted)
 {
 	mDeleteMutex = new LLMutex(NULL);
 
@@ -281,7 +281,12 @@ void LLWorkerClass::setWorking(bool working)
 bool LLWorkerClass::yield()
 {
 	LLThread::yield();
-	mWorkerThread->checkPause();
+	if (!mWorkerThread->isHosted())
+	{
+		// Don't park a shared worker, a paused hosted thread just stops
+		// handing out work after this request.
+		mWorkerThread->checkPause();
+	}
 	bool res;
 	mMutex.lock();
 	res = (getFlags() & WCF_ABORT_REQUESTED) ? true : false;
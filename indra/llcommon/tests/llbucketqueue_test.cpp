@@ -0,0 +1,417 @@
+/**
+ * @file   llbucketqueue_test.cpp
+ * @brief  Test for llbucketqueue.h, and a contention benchmark against the
+ *         mutex guarded std::set LLQueuedThread used to use.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llbucketqueue.h"
+// STL headers
+#include <set>
+#include <vector>
+// other Linden headers
+#include "llqueuedthread.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	struct TestEntry : public LLBucketQueueEntry
+	{
+		TestEntry() : mPriority(0), mID(0), mPopped(0) {}
+		U32 getPriority() const { return mPriority; }
+
+		volatile U32 mPriority;
+		S32 mID;
+		LLAtomicS32 mPopped;
+	};
+	typedef LLBucketQueue<TestEntry> queue_t;
+
+	U32 bucket_priority(S32 bucket)
+	{
+		return (U32)bucket << queue_t::BUCKET_SHIFT;
+	}
+
+	U32 next_random(U32& seed)
+	{
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	}
+
+	//------------------------------------------------------------------------
+	// What LLQueuedThread did before: one mutex around a std::set ordered
+	// by priority, erase and re-insert to reprioritize.
+
+	struct entry_less
+	{
+		bool operator()(const TestEntry* lhs, const TestEntry* rhs) const
+		{
+			if (lhs->mPriority == rhs->mPriority)
+				return lhs->mID < rhs->mID;
+			return lhs->mPriority > rhs->mPriority;
+		}
+	};
+
+	class SetQueue
+	{
+	public:
+		SetQueue() : mMutex(NULL) {}
+		void push(TestEntry* entry)
+		{
+			LLMutexLock lock(&mMutex);
+			mSet.insert(entry);
+		}
+		void reprioritize(TestEntry* entry, U32 priority)
+		{
+			LLMutexLock lock(&mMutex);
+			if (mSet.erase(entry))
+			{
+				entry->mPriority = priority;
+				mSet.insert(entry);
+			}
+			else
+			{
+				entry->mPriority = priority;
+			}
+		}
+		TestEntry* pop()
+		{
+			LLMutexLock lock(&mMutex);
+			if (mSet.empty())
+			{
+				return NULL;
+			}
+			TestEntry* entry = *mSet.begin();
+			mSet.erase(mSet.begin());
+			return entry;
+		}
+	private:
+		LLMutex mMutex;
+		std::set<TestEntry*, entry_less> mSet;
+	};
+
+	class BucketQueue
+	{
+	public:
+		void push(TestEntry* entry)
+		{
+			mQueue.push(entry);
+		}
+		void reprioritize(TestEntry* entry, U32 priority)
+		{
+			entry->mPriority = priority;
+			mQueue.reprioritize(entry);
+		}
+		TestEntry* pop()
+		{
+			return mQueue.pop();
+		}
+	private:
+		queue_t mQueue;
+	};
+
+	//------------------------------------------------------------------------
+	// Like the texture list reprioritizing every fetch each frame while the
+	// fetch thread works through them, putting back the ones not done yet.
+
+	const S32 NUM_ENTRIES = 4000;
+	const S32 NUM_PRODUCERS = 2;
+
+	template <class QUEUE>
+	class Producer : public LLThread
+	{
+	public:
+		Producer(QUEUE* queue, std::vector<TestEntry>* entries, S32 first, S32 rounds) :
+			LLThread("bucketqueue producer"),
+			mQueue(queue), mEntries(entries), mFirst(first), mRounds(rounds)
+		{
+		}
+		/*virtual*/ void run()
+		{
+			U32 seed = mFirst + 1;
+			for (S32 round = 0; round < mRounds; round++)
+			{
+				for (S32 i = mFirst; i < (S32)mEntries->size(); i += NUM_PRODUCERS)
+				{
+					mQueue->reprioritize(&(*mEntries)[i], next_random(seed) & 0x7FFFFFFF);
+				}
+			}
+		}
+	private:
+		QUEUE* mQueue;
+		std::vector<TestEntry>* mEntries;
+		S32 mFirst;
+		S32 mRounds;
+	};
+
+	template <class QUEUE>
+	class Consumer : public LLThread
+	{
+	public:
+		Consumer(QUEUE* queue, LLAtomicS32* done) :
+			LLThread("bucketqueue consumer"),
+			mQueue(queue), mDone(done), mPops(0)
+		{
+		}
+		/*virtual*/ void run()
+		{
+			while (!*mDone)
+			{
+				TestEntry* entry = mQueue->pop();
+				if (entry)
+				{
+					mPops++;
+					entry->mPopped++;
+					mQueue->push(entry);
+				}
+			}
+		}
+		S32 mPops;
+	private:
+		QUEUE* mQueue;
+		LLAtomicS32* mDone;
+	};
+
+	void wait_stopped(LLThread& thread)
+	{
+		while (!thread.isStopped())
+		{
+			ms_sleep(1);
+		}
+	}
+
+	template <class QUEUE>
+	F64 run_contention(S32 rounds, S32& pops)
+	{
+		std::vector<TestEntry> entries(NUM_ENTRIES);
+		QUEUE queue;
+		U32 seed = 1;
+		for (S32 i = 0; i < NUM_ENTRIES; i++)
+		{
+			entries[i].mID = i;
+			entries[i].mPriority = next_random(seed) & 0x7FFFFFFF;
+			queue.push(&entries[i]);
+		}
+
+		LLAtomicS32 done(0);
+		Consumer<QUEUE> consumer(&queue, &done);
+		std::vector<Producer<QUEUE>*> producers;
+		for (S32 i = 0; i < NUM_PRODUCERS; i++)
+		{
+			producers.push_back(new Producer<QUEUE>(&queue, &entries, i, rounds));
+		}
+
+		LLTimer timer;
+		consumer.start();
+		for (S32 i = 0; i < NUM_PRODUCERS; i++)
+		{
+			producers[i]->start();
+		}
+		for (S32 i = 0; i < NUM_PRODUCERS; i++)
+		{
+			wait_stopped(*producers[i]);
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		done = 1;
+		wait_stopped(consumer);
+
+		for (S32 i = 0; i < NUM_PRODUCERS; i++)
+		{
+			delete producers[i];
+		}
+
+		// Everything is still queued exactly once.
+		S32 popped = 0;
+		while (queue.pop())
+		{
+			popped++;
+		}
+		pops = (popped == NUM_ENTRIES) ? consumer.mPops : -1;
+		return elapsed;
+	}
+}
+
+namespace tut
+{
+	struct bucketqueue_data
+	{
+	};
+	typedef test_group<bucketqueue_data> bucketqueue_test;
+	typedef bucketqueue_test::object bucketqueue_object;
+	tut::bucketqueue_test bucketqueue_testcase("LLBucketQueue");
+
+	template<> template<>
+	void bucketqueue_object::test<1>()
+	{
+		set_test_name("pops highest bucket first, first in first out within a bucket");
+		std::vector<TestEntry> entries(6);
+		queue_t queue;
+		U32 priorities[] = {
+			bucket_priority(3) + 10,
+			bucket_priority(700),
+			bucket_priority(3) + 20,
+			LLQueuedThread::PRIORITY_IMMEDIATE,
+			bucket_priority(3) + 5,
+			0 };
+		for (S32 i = 0; i < 6; i++)
+		{
+			entries[i].mID = i;
+			entries[i].mPriority = priorities[i];
+			queue.push(&entries[i]);
+		}
+		ensure_equals("size", queue.size(), 6);
+		ensure_equals("top", queue.top()->mID, 3);
+
+		S32 expected[] = { 3, 1, 0, 2, 4, 5 };
+		for (S32 i = 0; i < 6; i++)
+		{
+			TestEntry* entry = queue.pop();
+			ensure("popped", entry != NULL);
+			ensure_equals("order", entry->mID, expected[i]);
+			queue.forget(entry);
+		}
+		ensure("empty", queue.empty());
+		ensure("nothing left", queue.pop() == NULL);
+	}
+
+	template<> template<>
+	void bucketqueue_object::test<2>()
+	{
+		set_test_name("raised priorities move at once, lowered ones when they reach the front");
+		std::vector<TestEntry> entries(4);
+		queue_t queue;
+		for (S32 i = 0; i < 4; i++)
+		{
+			entries[i].mID = i;
+			entries[i].mPriority = bucket_priority(10 + i);
+			queue.push(&entries[i]);
+		}
+		ensure_equals("top", queue.top()->mID, 3);
+
+		entries[0].mPriority = bucket_priority(50);
+		queue.reprioritize(&entries[0]);
+		entries[3].mPriority = bucket_priority(1);
+		queue.reprioritize(&entries[3]);
+		// Reprioritized twice before the queue looks at it, last one wins.
+		entries[2].mPriority = bucket_priority(40);
+		queue.reprioritize(&entries[2]);
+		entries[2].mPriority = bucket_priority(0);
+		queue.reprioritize(&entries[2]);
+
+		S32 expected[] = { 0, 1, 3, 2 };
+		for (S32 i = 0; i < 4; i++)
+		{
+			TestEntry* entry = queue.pop();
+			ensure_equals("order", entry->mID, expected[i]);
+		}
+
+		// Reprioritizing something that has been popped does nothing.
+		queue.reprioritize(&entries[1]);
+		ensure("still empty", queue.pop() == NULL);
+		queue.forget(&entries[1]);
+
+		// And it can be pushed again.
+		queue.push(&entries[1]);
+		ensure_equals("pushed again", queue.pop()->mID, 1);
+	}
+
+	template<> template<>
+	void bucketqueue_object::test<3>()
+	{
+		set_test_name("random operations agree with a sorted reference");
+		const S32 COUNT = 300;
+		std::vector<TestEntry> entries(COUNT);
+		std::vector<bool> queued(COUNT, false);
+		queue_t queue;
+		U32 seed = 4321;
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			entries[i].mID = i;
+		}
+		for (S32 step = 0; step < 20000; step++)
+		{
+			S32 i = next_random(seed) % COUNT;
+			U32 priority = next_random(seed) & 0x7FFFFFFF;
+			switch (next_random(seed) % 3)
+			{
+			case 0:
+				if (!queued[i])
+				{
+					entries[i].mPriority = priority;
+					queue.push(&entries[i]);
+					queued[i] = true;
+				}
+				break;
+			case 1:
+				entries[i].mPriority = priority;
+				queue.reprioritize(&entries[i]);
+				break;
+			default:
+			{
+				TestEntry* entry = queue.pop();
+				S32 best = -1;
+				for (S32 j = 0; j < COUNT; j++)
+				{
+					if (queued[j] && (best < 0 || queue_t::getBucket(entries[j].mPriority) > best))
+					{
+						best = queue_t::getBucket(entries[j].mPriority);
+					}
+				}
+				if (best < 0)
+				{
+					ensure("empty", entry == NULL);
+				}
+				else
+				{
+					ensure("popped", entry != NULL);
+					ensure_equals("highest bucket", queue_t::getBucket(entry->mPriority), best);
+					queued[entry->mID] = false;
+				}
+				break;
+			}
+			}
+		}
+	}
+
+	template<> template<>
+	void bucketqueue_object::test<4>()
+	{
+		set_test_name("contention against a mutex guarded std::set");
+		const S32 ROUNDS = 200;
+		S32 set_pops = 0;
+		S32 bucket_pops = 0;
+		F64 set_time = run_contention<SetQueue>(ROUNDS, set_pops);
+		F64 bucket_time = run_contention<BucketQueue>(ROUNDS, bucket_pops);
+		ensure("set queue kept every entry", set_pops >= 0);
+		ensure("bucket queue kept every entry", bucket_pops >= 0);
+
+		S32 reprioritized = ROUNDS * NUM_ENTRIES;
+		llinfos << "Reprioritized " << reprioritized << " entries from " << NUM_PRODUCERS
+				<< " threads while one thread popped and re-queued" << llendl;
+		llinfos << "  std::set + mutex: " << set_time * 1000.0 << "ms, " << set_pops << " pops" << llendl;
+		llinfos << "  LLBucketQueue:    " << bucket_time * 1000.0 << "ms, " << bucket_pops << " pops" << llendl;
+	}
+}
@@ -33,6 +33,8 @@
 
 #include "../llerrorcontrol.h"
 #include "../llsd.h"
+#include "../llthread.h"
+#include "../lltimer.h"
 
 #include "../test/lltut.h"
 
@@ -746,6 +748,153 @@ namespace tut
 	}
 }	
 
+namespace
+{
+	class LoggingThread : public LLThread
+	{
+	public:
+		LoggingThread(const std::string& name, int count)
+			: LLThread(name), mCount(count) { }
+
+		void run()
+		{
+			for (int i = 0; i < mCount; ++i)
+			{
+				llinfos << mName << " " << i << llendl;
+			}
+		}
+
+	private:
+		int mCount;
+	};
+
+	class SlowRecorder : public LLError::Recorder
+	{
+	public:
+		void recordMessage(LLError::ELevel, const std::string&)
+		{
+			ms_sleep(1);
+		}
+	};
+
+	bool wait_for_thread(LLThread& thread)
+	{
+		LLTimer timer;
+		while (!thread.isStopped() && timer.getElapsedTimeF32() < 10.f)
+		{
+			ms_sleep(1);
+		}
+		return thread.isStopped();
+	}
+
+	// Index of the last number seen from each thread, to check ordering
+	int number_from(const std::string& message, const std::string& name)
+	{
+		std::string::size_type pos = message.find(name + " ");
+		if (pos == std::string::npos)
+		{
+			return -1;
+		}
+		return atoi(message.c_str() + pos + name.size() + 1);
+	}
+}
+
+namespace tut
+{
+	template<> template<>
+		// asynchronous logging keeps each thread's messages in order
+	void ErrorTestObject::test<17>()
+	{
+		const int COUNT = 500;
+		LLError::startAsyncLogging(4 * COUNT);
+		ensure("async", LLError::isAsyncLogging());
+
+		LoggingThread alpha("alpha", COUNT);
+		LoggingThread beta("beta", COUNT);
+		alpha.start();
+		beta.start();
+		for (int i = 0; i < COUNT; ++i)
+		{
+			llinfos << "main " << i << llendl;
+		}
+		ensure("alpha done", wait_for_thread(alpha));
+		ensure("beta done", wait_for_thread(beta));
+		ensure_equals("nothing dropped", LLError::droppedLogMessages(), 0U);
+		LLError::stopAsyncLogging();
+		ensure("sync again", !LLError::isAsyncLogging());
+
+		ensure_message_count(3 * COUNT);
+		int next_alpha = 0, next_beta = 0, next_main = 0;
+		for (int n = 0; n < mRecorder.countMessages(); ++n)
+		{
+			std::string message = mRecorder.message(n);
+			int number;
+			if ((number = number_from(message, "alpha")) >= 0)
+			{
+				ensure_equals("alpha order", number, next_alpha++);
+			}
+			else if ((number = number_from(message, "beta")) >= 0)
+			{
+				ensure_equals("beta order", number, next_beta++);
+			}
+			else if ((number = number_from(message, "main")) >= 0)
+			{
+				ensure_equals("main order", number, next_main++);
+			}
+		}
+		ensure_equals("all main", next_main, COUNT);
+	}
+
+	template<> template<>
+		// a full queue drops messages and says so, fatal messages still get out
+	void ErrorTestObject::test<18>()
+	{
+		SlowRecorder slow;
+		LLError::addRecorder(&slow);
+		LLError::startAsyncLogging(16);
+
+		const int COUNT = 200;
+		for (int i = 0; i < COUNT; ++i)
+		{
+			llinfos << "flood " << i << llendl;
+		}
+		U32 dropped = LLError::droppedLogMessages();
+		ensure("some dropped", dropped > 0);
+
+		llerrs << "fatal after flood" << llendl;
+		ensure("fatal called", fatalWasCalled);
+
+		LLError::stopAsyncLogging();
+		LLError::removeRecorder(&slow);
+
+		// What got through, in order, the fatal error after all of it, and
+		// the note of what was dropped.
+		ensure_message_count(COUNT - (int)dropped + 3);
+		int last_flood = -1, fatal = -1, note = -1;
+		for (int n = 0; n < mRecorder.countMessages(); ++n)
+		{
+			std::string message = mRecorder.message(n);
+			int number = number_from(message, "flood");
+			if (number >= 0)
+			{
+				ensure("flood order", number > last_flood);
+				ensure("flood before fatal", fatal < 0);
+				last_flood = number;
+			}
+			else if (message.find("fatal after flood") != std::string::npos)
+			{
+				fatal = n;
+			}
+			else if (message.find("log messages dropped") != std::string::npos)
+			{
+				note = n;
+			}
+		}
+		ensure("fatal written", fatal >= 0);
+		ensure("drop noted", note >= 0);
+	}
+}
+
 /* Tests left:
 	handling of classes without LOG_CLASS
 
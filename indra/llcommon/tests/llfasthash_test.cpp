@@ -0,0 +1,247 @@
+/**
+ * @file   llfasthash_test.cpp
+ * @brief  Test for llfasthash.h, with throughput against LLCRC and LLMD5.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llfasthash.h"
+// STL headers
+#include <string>
+#include <vector>
+// external library headers
+#include <boost/unordered_set.hpp>
+// other Linden headers
+#include "llcrc.h"
+#include "llmd5.h"
+#include "lltimer.h"
+#include "lluuid.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	std::vector<U8> make_buffer(size_t size)
+	{
+		std::vector<U8> buffer(size);
+		U32 seed = 1;
+		for (size_t i = 0; i < size; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			buffer[i] = (U8)(seed >> 16);
+		}
+		return buffer;
+	}
+
+	F64 megabytes_per_second(size_t bytes, F64 seconds)
+	{
+		return seconds > 0.0 ? (F64)bytes / (1024.0 * 1024.0) / seconds : 0.0;
+	}
+
+	// What hash_value(LLUUID) was before.
+	struct sum_hash
+	{
+		size_t operator()(const LLUUID& id) const { return id.getCRC32(); }
+	};
+
+	// Ids made by hand the way tests and some services do, one counter
+	// in the last word.
+	std::vector<LLUUID> make_sequential_ids(S32 count)
+	{
+		std::vector<LLUUID> ids(count);
+		for (S32 i = 0; i < count; i++)
+		{
+			ids[i].mData[0] = 0x11;
+			memcpy(&ids[i].mData[12], &i, sizeof(i));
+		}
+		return ids;
+	}
+
+	template <class SET>
+	F64 time_set(const std::vector<LLUUID>& ids)
+	{
+		LLTimer timer;
+		SET set;
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			set.insert(ids[i]);
+		}
+		S32 found = 0;
+		for (S32 round = 0; round < 4; round++)
+		{
+			for (size_t i = 0; i < ids.size(); i++)
+			{
+				found += (S32)set.count(ids[i]);
+			}
+		}
+		return found == 4 * (S32)ids.size() ? timer.getElapsedTimeF64() : -1.0;
+	}
+}
+
+namespace tut
+{
+	struct fasthash_data
+	{
+	};
+	typedef test_group<fasthash_data> fasthash_test;
+	typedef fasthash_test::object fasthash_object;
+	tut::fasthash_test fasthash_testcase("LLFastHash");
+
+	template<> template<>
+	void fasthash_object::test<1>()
+	{
+		set_test_name("CRC32C check values");
+		const char* check = "123456789";
+		ensure_equals("check string", ll_crc32c(check, 9), (U32)0xE3069283);
+		ensure_equals("portable check string", ll_crc32c_portable(check, 9), (U32)0xE3069283);
+		ensure_equals("empty", ll_crc32c(check, 0), (U32)0);
+
+		std::vector<U8> zeros(32, 0);
+		ensure_equals("32 zeros", ll_crc32c(&zeros[0], zeros.size()), (U32)0x8A9136AA);
+		std::vector<U8> ones(32, 0xFF);
+		ensure_equals("32 ones", ll_crc32c(&ones[0], ones.size()), (U32)0x62A8AB43);
+
+		U32 crc = ll_crc32c(check, 4);
+		crc = ll_crc32c(check + 4, 5, crc);
+		ensure_equals("in pieces", crc, (U32)0xE3069283);
+	}
+
+	template<> template<>
+	void fasthash_object::test<2>()
+	{
+		set_test_name("CRC32C dispatch agrees with the portable version");
+		llinfos << "SSE4.2 CRC32C " << (ll_crc32c_hardware() ? "available" : "not available") << llendl;
+		std::vector<U8> buffer = make_buffer(4096);
+		// Every alignment and the short lengths around the word sizes
+		for (size_t start = 0; start < 16; start++)
+		{
+			for (size_t size = 0; size < 80; size++)
+			{
+				ensure_equals("same crc", ll_crc32c(&buffer[start], size),
+							  ll_crc32c_portable(&buffer[start], size));
+			}
+		}
+		ensure_equals("long buffer", ll_crc32c(&buffer[3], 4000), ll_crc32c_portable(&buffer[3], 4000));
+	}
+
+	template<> template<>
+	void fasthash_object::test<3>()
+	{
+		set_test_name("XXH64 reference values");
+		ensure_equals("empty", ll_hash64("", 0), U64L(0xEF46DB3751D8E999));
+		ensure_equals("a", ll_hash64("a", 1), U64L(0xD24EC4F1A98C6E5B));
+		ensure_equals("abc", ll_hash64("abc", 3), U64L(0x44BC2CF5AD770999));
+		std::string sentence("Nobody inspects the spammish repetition");
+		ensure_equals("sentence", ll_hash64(sentence.data(), sentence.size()), U64L(0xFBCEA83C8A378BF1));
+
+		std::vector<U8> counting(100);
+		for (size_t i = 0; i < counting.size(); i++)
+		{
+			counting[i] = (U8)i;
+		}
+		ensure_equals("100 bytes", ll_hash64(&counting[0], counting.size()), U64L(0x6AC1E58032166597));
+		ensure_equals("seeded", ll_hash64(&counting[0], counting.size(), 12345), U64L(0x028BA1AE2DE4DE27));
+		ensure_equals("inline 16 bytes", ll_hash64_16(&counting[5]), ll_hash64(&counting[5], 16));
+	}
+
+	template<> template<>
+	void fasthash_object::test<4>()
+	{
+		set_test_name("LLUUID hashing spreads hand made ids");
+		std::vector<LLUUID> ids = make_sequential_ids(4096);
+		// Sequential ids only differ in the low bits of the old sum, so
+		// they fill a run of buckets.  Count the distinct low 12 bits.
+		std::vector<bool> used(4096, false);
+		S32 distinct = 0;
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			size_t bucket = hash_value(ids[i]) & 4095;
+			if (!used[bucket])
+			{
+				used[bucket] = true;
+				distinct++;
+			}
+		}
+		// A random function fills about 63% of them
+		ensure("spread over the buckets", distinct > 2400);
+		ensure_equals("same id same hash", hash_value(ids[7]), hash_value(LLUUID(ids[7])));
+	}
+
+	template<> template<>
+	void fasthash_object::test<5>()
+	{
+		set_test_name("throughput");
+		const size_t SIZE = 8 * 1024 * 1024;
+		std::vector<U8> buffer = make_buffer(SIZE);
+		LLTimer timer;
+
+		LLCRC crc;
+		crc.update(&buffer[0], SIZE);
+		F64 llcrc_time = timer.getElapsedTimeF64();
+		ensure("LLCRC ran", crc.getCRC() != 0);
+
+		timer.reset();
+		U32 portable = ll_crc32c_portable(&buffer[0], SIZE);
+		F64 portable_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		U32 dispatched = ll_crc32c(&buffer[0], SIZE);
+		F64 dispatched_time = timer.getElapsedTimeF64();
+		ensure_equals("same crc", dispatched, portable);
+
+		timer.reset();
+		U64 hash = ll_hash64(&buffer[0], SIZE);
+		F64 hash_time = timer.getElapsedTimeF64();
+		ensure("hashed", hash != 0);
+
+		timer.reset();
+		LLMD5 md5;
+		md5.update(&buffer[0], SIZE);
+		md5.finalize();
+		F64 md5_time = timer.getElapsedTimeF64();
+
+		llinfos << "LLCRC " << megabytes_per_second(SIZE, llcrc_time) << " MB/s, "
+				<< "CRC32C portable " << megabytes_per_second(SIZE, portable_time) << " MB/s, "
+				<< "CRC32C " << (ll_crc32c_hardware() ? "SSE4.2 " : "portable ")
+				<< megabytes_per_second(SIZE, dispatched_time) << " MB/s, "
+				<< "XXH64 " << megabytes_per_second(SIZE, hash_time) << " MB/s, "
+				<< "LLMD5 " << megabytes_per_second(SIZE, md5_time) << " MB/s" << llendl;
+
+		std::vector<LLUUID> ids = make_sequential_ids(50000);
+		F64 sum_time = time_set<boost::unordered_set<LLUUID, sum_hash> >(ids);
+		F64 xxh_time = time_set<boost::unordered_set<LLUUID> >(ids);
+		ensure("sum hashed set complete", sum_time >= 0.0);
+		ensure("XXH64 hashed set complete", xxh_time >= 0.0);
+		std::vector<LLUUID> random_ids(50000);
+		for (size_t i = 0; i < random_ids.size(); i++)
+		{
+			random_ids[i].generate();
+		}
+		F64 sum_random = time_set<boost::unordered_set<LLUUID, sum_hash> >(random_ids);
+		F64 xxh_random = time_set<boost::unordered_set<LLUUID> >(random_ids);
+		llinfos << "unordered_set<LLUUID>, 50000 sequential ids: sum " << sum_time * 1000.0
+				<< " ms, XXH64 " << xxh_time * 1000.0 << " ms; random ids: sum "
+				<< sum_random * 1000.0 << " ms, XXH64 " << xxh_random * 1000.0 << " ms" << llendl;
+	}
+}
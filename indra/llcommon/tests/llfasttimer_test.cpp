@@ -0,0 +1,142 @@
+/**
+ * @file   llfasttimer_test.cpp
+ * @brief  Test for the cross thread timer trace in llfasttimer_class.cpp.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llfasttimer.h"
+// STL headers
+#include <sstream>
+// other Linden headers
+#include "llthread.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	LLFastTimer::DeclareTimer FTM_TEST_MAIN("Trace Test Main");
+	LLFastTimer::DeclareTimer FTM_TEST_WORKER("Trace Test Worker");
+
+	class TracedThread : public LLThread
+	{
+	public:
+		TracedThread(S32 count) : LLThread("Trace Worker"), mCount(count) {}
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < mCount; i++)
+			{
+				LLFastTimer t(FTM_TEST_WORKER);
+				ms_sleep(1);
+			}
+		}
+	private:
+		S32 mCount;
+	};
+
+	bool wait_for(LLThread& thread)
+	{
+		LLTimer timer;
+		while (!thread.isStopped() && timer.getElapsedTimeF32() < 10.f)
+		{
+			ms_sleep(1);
+		}
+		return thread.isStopped();
+	}
+
+	S32 count_occurrences(const std::string& haystack, const std::string& needle)
+	{
+		S32 count = 0;
+		for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1))
+		{
+			count++;
+		}
+		return count;
+	}
+}
+
+namespace tut
+{
+	struct fasttimer_data
+	{
+		~fasttimer_data()
+		{
+			LLFastTimer::stopTrace();
+		}
+	};
+	typedef test_group<fasttimer_data> fasttimer_test;
+	typedef fasttimer_test::object fasttimer_object;
+	tut::fasttimer_test fasttimer_testcase("LLFastTimer");
+
+	template<> template<>
+	void fasttimer_object::test<1>()
+	{
+		set_test_name("trace covers timers on every thread");
+		LLFastTimer::startTrace(1024);
+		ensure("tracing", LLFastTimer::isTracing());
+
+		TracedThread thread(10);
+		thread.start();
+		for (S32 i = 0; i < 5; i++)
+		{
+			LLFastTimer t(FTM_TEST_MAIN);
+			ms_sleep(1);
+		}
+		ensure("worker finished", wait_for(thread));
+
+		std::ostringstream trace;
+		LLFastTimer::writeTrace(trace);
+		std::string json = trace.str();
+		ensure("has events", json.find("\"traceEvents\"") != std::string::npos);
+		ensure("main thread named", json.find("\"Main\"") != std::string::npos);
+		ensure("worker thread named", json.find("\"Trace Worker\"") != std::string::npos);
+		ensure_equals("main spans", count_occurrences(json, "\"name\":\"Trace Test Main\""), 5);
+		ensure_equals("worker spans", count_occurrences(json, "\"name\":\"Trace Test Worker\""), 10);
+	}
+
+	template<> template<>
+	void fasttimer_object::test<2>()
+	{
+		set_test_name("nothing is recorded when not tracing, and the ring keeps the newest");
+		{
+			LLFastTimer t(FTM_TEST_MAIN);
+		}
+		// A new thread, its ring is sized by this trace
+		LLFastTimer::startTrace(16);
+		TracedThread thread(100);
+		thread.start();
+		ensure("worker finished", wait_for(thread));
+
+		std::ostringstream trace;
+		LLFastTimer::writeTrace(trace);
+		ensure_equals("main not traced", count_occurrences(trace.str(), "\"name\":\"Trace Test Main\""), 0);
+		// 16 events hold the last 8 begin/end pairs, less the oldest one if
+		// its slot might have been in the middle of being overwritten.
+		S32 spans = count_occurrences(trace.str(), "\"name\":\"Trace Test Worker\"");
+		ensure("ring wrapped", spans == 7 || spans == 8);
+		LLFastTimer::stopTrace();
+		ensure("stopped", !LLFastTimer::isTracing());
+	}
+}
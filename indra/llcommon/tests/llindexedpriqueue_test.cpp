@@ -0,0 +1,156 @@
+/**
+ * @file   llindexedpriqueue_test.cpp
+ * @brief  Test for llindexedpriqueue.h.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llindexedpriqueue.h"
+// STL headers
+#include <algorithm>
+#include <map>
+#include <vector>
+// other Linden headers
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct indexedpriqueue_data
+	{
+		typedef LLIndexedPriQueue<S32> queue_t;
+
+		std::vector<S32> drain(queue_t& queue)
+		{
+			std::vector<S32> out;
+			S32 data;
+			while (queue.pop(&data))
+			{
+				out.push_back(data);
+			}
+			return out;
+		}
+	};
+	typedef test_group<indexedpriqueue_data> indexedpriqueue_test;
+	typedef indexedpriqueue_test::object indexedpriqueue_object;
+	tut::indexedpriqueue_test indexedpriqueue_testcase("LLIndexedPriQueue");
+
+	template<> template<>
+	void indexedpriqueue_object::test<1>()
+	{
+		set_test_name("pops in priority order, equal priorities first in first out");
+		queue_t queue;
+		queue.push(1.f, 10);
+		queue.push(5.f, 20);
+		queue.push(1.f, 11);
+		queue.push(3.f, 30);
+		queue.push(1.f, 12);
+		ensure_equals("length", queue.getLength(), 5);
+		ensure_equals("top", queue.top(), 20);
+
+		std::vector<S32> out = drain(queue);
+		ensure_equals("drained", out.size(), 5U);
+		ensure_equals("0", out[0], 20);
+		ensure_equals("1", out[1], 30);
+		ensure_equals("2", out[2], 10);
+		ensure_equals("3", out[3], 11);
+		ensure_equals("4", out[4], 12);
+		ensure("empty", queue.empty());
+	}
+
+	template<> template<>
+	void indexedpriqueue_object::test<2>()
+	{
+		set_test_name("reprioritize and erase");
+		queue_t queue;
+		for (S32 i = 0; i < 8; ++i)
+		{
+			queue.push((F32)i, i);
+		}
+		ensure("raise", queue.reprioritize(100.f, 2));
+		ensure("lower", queue.reprioritize(-1.f, 7));
+		ensure("erase", queue.erase(5));
+		ensure("erase twice", !queue.erase(5));
+		ensure("reprioritize missing", !queue.reprioritize(1.f, 5));
+		ensure("contains", queue.contains(3));
+		ensure("doesn't contain", !queue.contains(5));
+
+		std::vector<S32> out = drain(queue);
+		S32 expected[] = { 2, 6, 4, 3, 1, 0, 7 };
+		ensure_equals("drained", out.size(), 7U);
+		for (U32 i = 0; i < out.size(); ++i)
+		{
+			ensure_equals("order", out[i], expected[i]);
+		}
+	}
+
+	template<> template<>
+	void indexedpriqueue_object::test<3>()
+	{
+		set_test_name("random operations agree with a sorted reference");
+		queue_t queue;
+		std::map<S32, F32> reference;
+		U32 seed = 12345;
+		for (S32 step = 0; step < 5000; ++step)
+		{
+			seed = seed * 1103515245 + 12345;
+			S32 data = (seed >> 8) % 200;
+			F32 priority = (F32)((seed >> 20) % 50);
+			switch ((seed >> 4) % 3)
+			{
+			case 0:
+				if (reference.find(data) == reference.end())
+				{
+					queue.push(priority, data);
+					reference[data] = priority;
+				}
+				break;
+			case 1:
+				ensure_equals("reprioritize", (bool)queue.reprioritize(priority, data),
+							  reference.find(data) != reference.end());
+				if (reference.find(data) != reference.end())
+				{
+					reference[data] = priority;
+				}
+				break;
+			default:
+				ensure_equals("erase", (bool)queue.erase(data),
+							  reference.erase(data) != 0);
+				break;
+			}
+			ensure_equals("length", (size_t)queue.getLength(), reference.size());
+		}
+
+		F32 last_priority = 1000.f;
+		S32 data;
+		while (queue.pop(&data))
+		{
+			ensure("popped known data", reference.find(data) != reference.end());
+			ensure("priority order", reference[data] <= last_priority);
+			last_priority = reference[data];
+			reference.erase(data);
+		}
+		ensure("everything popped", reference.empty());
+	}
+}
@@ -0,0 +1,428 @@
+/**
+ * @file   lljobscheduler_test.cpp
+ * @brief  Test for lljobscheduler.h and LLQueuedThread hosted on it.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "lljobscheduler.h"
+// STL headers
+#include <vector>
+// other Linden headers
+#include "llqueuedthread.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	class CountingJob : public LLJob
+	{
+	public:
+		CountingJob(LLAtomicS32* counter) : mCounter(counter) {}
+		/*virtual*/ void run()
+		{
+			// Enough work that the other workers have something to steal.
+			ms_sleep(1);
+			(*mCounter)++;
+		}
+	private:
+		LLAtomicS32* mCounter;
+	};
+
+	// Request that takes a few passes before it completes.
+	class TestRequest : public LLQueuedThread::QueuedRequest
+	{
+	public:
+		TestRequest(LLQueuedThread::handle_t handle, U32 priority, S32 passes) :
+			LLQueuedThread::QueuedRequest(handle, priority),
+			mPasses(passes)
+		{
+		}
+		/*virtual*/ bool processRequest()
+		{
+			return --mPasses <= 0;
+		}
+	private:
+		S32 mPasses;
+	};
+
+	class TestQueue : public LLQueuedThread
+	{
+	public:
+		TestQueue(bool threaded) : LLQueuedThread("test queue", threaded) {}
+
+		handle_t add(U32 priority, S32 passes)
+		{
+			handle_t handle = generateHandle();
+			addRequest(new TestRequest(handle, priority, passes));
+			return handle;
+		}
+	};
+
+	// Counts how often each index is run, and on how many threads
+	class CountingFor : public LLParallelFor
+	{
+	public:
+		CountingFor(S32 count) : mRuns(count, 0), mMainThreadRanges(0), mRanges(0) {}
+
+		/*virtual*/ void runRange(S32 begin, S32 end)
+		{
+			for (S32 i = begin; i < end; i++)
+			{
+				mRuns[i]++;
+			}
+			if (LLThread::currentID() == sMainThreadID)
+			{
+				mMainThreadRanges++;
+			}
+			mRanges++;
+			// Give the workers a chance to join in
+			ms_sleep(1);
+		}
+
+		bool ranOnce() const
+		{
+			for (U32 i = 0; i < mRuns.size(); i++)
+			{
+				if (mRuns[i] != 1)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static U32 sMainThreadID;
+		// Each index is only touched by one thread
+		std::vector<S32> mRuns;
+		LLAtomicS32 mMainThreadRanges;
+		LLAtomicS32 mRanges;
+	};
+	U32 CountingFor::sMainThreadID = 0;
+
+	class WaitedJob : public LLWaitableJob
+	{
+	public:
+		WaitedJob(S32 sleep_ms) : mSleep(sleep_ms), mRuns(0) {}
+		~WaitedJob() { wait(false); }
+
+		S32 mSleep;
+		LLAtomicS32 mRuns;
+
+	private:
+		/*virtual*/ void doWork()
+		{
+			ms_sleep(mSleep);
+			mRuns++;
+		}
+	};
+
+	bool wait_for(LLQueuedThread& queue, const std::vector<LLQueuedThread::handle_t>& handles)
+	{
+		LLTimer timer;
+		while (timer.getElapsedTimeF32() < 10.f)
+		{
+			queue.update(0);
+			bool done = true;
+			for (U32 i = 0; i < handles.size(); ++i)
+			{
+				if (queue.getRequestStatus(handles[i]) != LLQueuedThread::STATUS_COMPLETE)
+				{
+					done = false;
+				}
+			}
+			if (done)
+			{
+				return true;
+			}
+			ms_sleep(1);
+		}
+		return false;
+	}
+}
+
+namespace tut
+{
+	struct jobscheduler_data
+	{
+		jobscheduler_data()
+		{
+			LLJobScheduler::getInstance()->start(3);
+		}
+		~jobscheduler_data()
+		{
+			LLJobScheduler::getInstance()->stop();
+		}
+	};
+	typedef test_group<jobscheduler_data> jobscheduler_test;
+	typedef jobscheduler_test::object jobscheduler_object;
+	tut::jobscheduler_test jobscheduler_testcase("LLJobScheduler");
+
+	template<> template<>
+	void jobscheduler_object::test<1>()
+	{
+		set_test_name("every job runs once, in every lane");
+		LLJobScheduler* scheduler = LLJobScheduler::getInstance();
+		ensure_equals("workers", scheduler->getNumWorkers(), 3);
+
+		const S32 JOBS_PER_LANE = 50;
+		LLAtomicS32 counter(0);
+		CountingJob job(&counter);
+		for (S32 i = 0; i < JOBS_PER_LANE; i++)
+		{
+			for (S32 lane = 0; lane < LLJobScheduler::NUM_LANES; lane++)
+			{
+				scheduler->submit(&job, (LLJobScheduler::lane_t)lane);
+			}
+		}
+
+		LLTimer timer;
+		while (counter < JOBS_PER_LANE * LLJobScheduler::NUM_LANES && timer.getElapsedTimeF32() < 10.f)
+		{
+			ms_sleep(1);
+		}
+		ensure_equals("all jobs ran", (S32)counter, JOBS_PER_LANE * LLJobScheduler::NUM_LANES);
+
+		for (S32 lane = 0; lane < LLJobScheduler::NUM_LANES; lane++)
+		{
+			LLJobScheduler::LaneStats stats = scheduler->getLaneStats((LLJobScheduler::lane_t)lane);
+			ensure_equals("run per lane", (S32)stats.mJobsRun, JOBS_PER_LANE);
+			ensure_equals("nothing left queued", stats.mQueued, 0);
+			ensure("busy time counted", stats.mBusyTime > 0);
+			ensure("utilization in range", scheduler->getLaneUtilization((LLJobScheduler::lane_t)lane) <= 1.f);
+		}
+		LLSD stats = scheduler->getStats();
+		ensure_equals("stats workers", stats["workers"].asInteger(), 3);
+		ensure_equals("stats lane", stats["lanes"]["Low"]["run"].asInteger(), JOBS_PER_LANE);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<2>()
+	{
+		set_test_name("priority lanes map from queued thread priorities");
+		ensure_equals("immediate", LLJobScheduler::getLaneForPriority(LLQueuedThread::PRIORITY_IMMEDIATE), LLJobScheduler::LANE_URGENT);
+		ensure_equals("urgent", LLJobScheduler::getLaneForPriority(LLQueuedThread::PRIORITY_URGENT + 5), LLJobScheduler::LANE_URGENT);
+		ensure_equals("high", LLJobScheduler::getLaneForPriority(LLQueuedThread::PRIORITY_HIGH), LLJobScheduler::LANE_HIGH);
+		ensure_equals("normal", LLJobScheduler::getLaneForPriority(LLQueuedThread::PRIORITY_NORMAL + 1), LLJobScheduler::LANE_NORMAL);
+		ensure_equals("low", LLJobScheduler::getLaneForPriority(LLQueuedThread::PRIORITY_LOW), LLJobScheduler::LANE_LOW);
+		ensure_equals("zero", LLJobScheduler::getLaneForPriority(0), LLJobScheduler::LANE_LOW);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<3>()
+	{
+		set_test_name("hosted queued thread keeps handle and status semantics");
+		TestQueue queue(true);
+		ensure("hosted", queue.isHosted());
+
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 i = 0; i < 40; i++)
+		{
+			U32 priority = (i % 2) ? LLQueuedThread::PRIORITY_HIGH : LLQueuedThread::PRIORITY_NORMAL;
+			handles.push_back(queue.add(priority + i, 1 + i % 3));
+		}
+		ensure("all complete", wait_for(queue, handles));
+
+		for (U32 i = 0; i < handles.size(); ++i)
+		{
+			ensure("complete removes", queue.completeRequest(handles[i]));
+			ensure_equals("expired after complete", queue.getRequestStatus(handles[i]), LLQueuedThread::STATUS_EXPIRED);
+		}
+		queue.waitOnPending();
+		ensure_equals("nothing pending", queue.getPending(), 0);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<4>()
+	{
+		set_test_name("hosted queued thread with several jobs at once, and shutdown");
+		TestQueue queue(true);
+		queue.setMaxJobs(3);
+
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 i = 0; i < 100; i++)
+		{
+			handles.push_back(queue.add(LLQueuedThread::PRIORITY_NORMAL, 2));
+		}
+		ensure("all complete", wait_for(queue, handles));
+
+		// Leave some queued for shutdown to abort.
+		LLQueuedThread::handle_t paused_handle;
+		queue.pause();
+		paused_handle = queue.add(LLQueuedThread::PRIORITY_NORMAL, 1);
+		ms_sleep(20);
+		ensure_equals("paused queue doesn't run", queue.getRequestStatus(paused_handle), LLQueuedThread::STATUS_QUEUED);
+		queue.shutdown();
+		ensure("stopped", queue.isStopped());
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<5>()
+	{
+		set_test_name("unhosted queued thread when asked for or without a scheduler");
+		LLJobScheduler::getInstance()->stop();
+		{
+			TestQueue queue(true);
+			ensure("own thread", !queue.isHosted());
+			std::vector<LLQueuedThread::handle_t> handles;
+			handles.push_back(queue.add(LLQueuedThread::PRIORITY_NORMAL, 2));
+			ensure("complete", wait_for(queue, handles));
+		}
+		LLJobScheduler::getInstance()->start(3);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<6>()
+	{
+		set_test_name("low priority request left incomplete doesn't sleep on a worker");
+		TestQueue queue(true);
+		ensure("hosted", queue.isHosted());
+
+		// An own thread sleeps a millisecond after each pass of this, a
+		// hosted queue requeues its job instead.
+		const S32 PASSES = 1000;
+		std::vector<LLQueuedThread::handle_t> handles;
+		handles.push_back(queue.add(LLQueuedThread::PRIORITY_LOW, PASSES));
+		LLTimer timer;
+		ensure("complete", wait_for(queue, handles));
+		ensure("no sleeping between passes", timer.getElapsedTimeF32() < PASSES * 0.001f * 0.5f);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<7>()
+	{
+		set_test_name("parallel for runs every index once and shares it out");
+		CountingFor::sMainThreadID = LLThread::currentID();
+		CountingFor body(1001);
+		body.run(1001, 10);
+		ensure("every index once", body.ranOnce());
+		ensure_equals("pieces", (S32)body.mRanges, 101);
+		ensure("workers helped", body.mMainThreadRanges < 101);
+
+		// Again with the same object, helpers and all
+		CountingFor again(64);
+		again.run(64, 1);
+		again.run(0, 1);
+		ensure("run again", again.ranOnce());
+
+		// One piece is just run here
+		CountingFor small(5);
+		small.run(5, 5);
+		ensure("small", small.ranOnce());
+		ensure_equals("small on the caller", (S32)small.mMainThreadRanges, 1);
+
+		LLJobScheduler::getInstance()->stop();
+		CountingFor stopped(100);
+		stopped.run(100, 10);
+		ensure("without workers", stopped.ranOnce());
+		ensure_equals("all at once on the caller", (S32)stopped.mMainThreadRanges, 1);
+		LLJobScheduler::getInstance()->start(3);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<8>()
+	{
+		set_test_name("waitable jobs are waited for, or taken back if they haven't started");
+		LLJobScheduler* scheduler = LLJobScheduler::getInstance();
+		{
+			WaitedJob job(20);
+			job.submit(LLJobScheduler::LANE_LOW);
+			job.wait();
+			ensure("done", job.isDone());
+			ensure_equals("ran once", (S32)job.mRuns, 1);
+			// And again
+			job.submit();
+			job.wait();
+			ensure_equals("ran twice", (S32)job.mRuns, 2);
+		}
+
+		// Keep every worker busy so that the last one can't start
+		std::vector<WaitedJob*> blockers;
+		for (S32 i = 0; i < scheduler->getNumWorkers(); i++)
+		{
+			blockers.push_back(new WaitedJob(200));
+			blockers.back()->submit(LLJobScheduler::LANE_URGENT);
+		}
+		ms_sleep(50);
+		WaitedJob queued(0);
+		queued.submit(LLJobScheduler::LANE_LOW);
+		ensure("not started", !queued.isDone());
+		queued.wait();
+		ensure_equals("run here instead", (S32)queued.mRuns, 1);
+
+		// Left queued by stop(), which used to hang whoever waited
+		queued.submit(LLJobScheduler::LANE_LOW);
+		WaitedJob dropped(0);
+		dropped.submit(LLJobScheduler::LANE_LOW);
+		scheduler->stop();
+		for (U32 i = 0; i < blockers.size(); i++)
+		{
+			ensure("blocker finished", blockers[i]->isDone());
+			delete blockers[i];
+		}
+		ensure("dropped isn't done", !dropped.isDone());
+		queued.wait();
+		ensure_equals("dropped run here", (S32)queued.mRuns, 2);
+		dropped.wait(false);
+		ensure("taken back", dropped.isDone());
+		ensure_equals("not run", (S32)dropped.mRuns, 0);
+
+		// Without workers it is done straight away
+		queued.submit();
+		ensure_equals("run by submit", (S32)queued.mRuns, 3);
+		scheduler->start(3);
+	}
+
+	template<> template<>
+	void jobscheduler_object::test<9>()
+	{
+		set_test_name("hosted queued thread shuts down after the scheduler left its job queued");
+		LLJobScheduler* scheduler = LLJobScheduler::getInstance();
+		TestQueue queue(true);
+		ensure("hosted", queue.isHosted());
+
+		std::vector<WaitedJob*> blockers;
+		for (S32 i = 0; i < scheduler->getNumWorkers(); i++)
+		{
+			blockers.push_back(new WaitedJob(100));
+			blockers.back()->submit(LLJobScheduler::LANE_URGENT);
+		}
+		ms_sleep(20);
+		LLQueuedThread::handle_t handle = queue.add(LLQueuedThread::PRIORITY_LOW, 1);
+		scheduler->stop();
+		for (U32 i = 0; i < blockers.size(); i++)
+		{
+			delete blockers[i];
+		}
+		ensure_equals("never ran", queue.getRequestStatus(handle), LLQueuedThread::STATUS_QUEUED);
+
+		// Used to wait out its whole timeout for a job that would never run
+		LLTimer timer;
+		queue.shutdown();
+		ensure("stopped", queue.isStopped());
+		ensure("didn't wait for it", timer.getElapsedTimeF32() < 1.f);
+		scheduler->start(3);
+	}
+}
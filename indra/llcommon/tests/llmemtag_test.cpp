@@ -0,0 +1,189 @@
+/**
+ * @file   llmemtag_test.cpp
+ * @brief  Test for llmemtag.h: tag counters, tagged blocks and pools.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llmemtag.h"
+// STL headers
+#include <set>
+#include <sstream>
+#include <vector>
+// other Linden headers
+#include "../test/lltut.h"
+
+namespace
+{
+	// Tags and pools are static objects, as they must be.
+	LLMemTag sCounterTag("TestCounter");
+	LLMemTag sBlockTag("TestBlock");
+	LLMemTag sPoolTag("TestPool");
+
+	struct Pooled
+	{
+		void* operator new(size_t size)					{ return sPool.allocate(size); }
+		void operator delete(void* ptr, size_t size)	{ sPool.deallocate(ptr, size); }
+		virtual ~Pooled() {}
+
+		F32 mValues[5];
+		static LLMemTagPool sPool;
+	};
+	LLMemTagPool Pooled::sPool(sPoolTag, sizeof(Pooled), 4);
+
+	struct PooledDerived : public Pooled
+	{
+		F32 mMore[16];
+	};
+}
+
+namespace tut
+{
+	struct memtag_data
+	{
+	};
+	typedef test_group<memtag_data> memtag_test;
+	typedef memtag_test::object memtag_object;
+	tut::memtag_test memtag_testcase("LLMemTag");
+
+	template<> template<>
+	void memtag_object::test<1>()
+	{
+		set_test_name("live, peak and count");
+		ensure_equals("starts empty", sCounterTag.getLiveBytes(), 0U);
+		sCounterTag.add(100);
+		sCounterTag.add(50);
+		ensure_equals("live", sCounterTag.getLiveBytes(), 150U);
+		ensure_equals("count", sCounterTag.getLiveCount(), 2U);
+		sCounterTag.remove(100);
+		ensure_equals("live after remove", sCounterTag.getLiveBytes(), 50U);
+		ensure_equals("peak stays", sCounterTag.getPeakBytes(), 150U);
+		ensure_equals("count after remove", sCounterTag.getLiveCount(), 1U);
+		sCounterTag.resetPeak();
+		ensure_equals("peak reset to live", sCounterTag.getPeakBytes(), 50U);
+		sCounterTag.remove(50);
+		ensure_equals("empty again", sCounterTag.getLiveBytes(), 0U);
+	}
+
+	template<> template<>
+	void memtag_object::test<2>()
+	{
+		set_test_name("tagged blocks");
+		U8* block = (U8*) ll_tagged_malloc_16(sBlockTag, 40);
+		ensure("allocated", block != NULL);
+		ensure_equals("aligned", (size_t) block & 15, (size_t) 0);
+		ensure_equals("charged", sBlockTag.getLiveBytes(), 40U);
+		for (S32 i = 0; i < 40; i++)
+		{
+			block[i] = (U8) i;
+		}
+
+		block = (U8*) ll_tagged_realloc_16(sBlockTag, block, 1000);
+		ensure_equals("charged for the new size", sBlockTag.getLiveBytes(), 1000U);
+		ensure_equals("still one block", sBlockTag.getLiveCount(), 1U);
+		for (S32 i = 0; i < 40; i++)
+		{
+			ensure_equals("contents kept", (S32) block[i], i);
+		}
+
+		void* other = ll_tagged_realloc_16(sBlockTag, NULL, 24);
+		ensure_equals("realloc of NULL allocates", sBlockTag.getLiveBytes(), 1024U);
+		ll_tagged_free_16(sBlockTag, other);
+		ll_tagged_free_16(sBlockTag, block);
+		ll_tagged_free_16(sBlockTag, NULL);
+		ensure_equals("all credited", sBlockTag.getLiveBytes(), 0U);
+		ensure_equals("no blocks", sBlockTag.getLiveCount(), 0U);
+		ensure_equals("peak", sBlockTag.getPeakBytes(), 1024U);
+	}
+
+	template<> template<>
+	void memtag_object::test<3>()
+	{
+		set_test_name("pool reuse");
+		size_t element_size = Pooled::sPool.getElementSize();
+		ensure_equals("element size rounded to 16", element_size & 15, (size_t) 0);
+
+		std::vector<Pooled*> objects;
+		std::set<Pooled*> addresses;
+		for (S32 i = 0; i < 10; i++)
+		{
+			Pooled* object = new Pooled;
+			ensure_equals("aligned", (size_t) object & 15, (size_t) 0);
+			objects.push_back(object);
+			addresses.insert(object);
+		}
+		ensure_equals("distinct", addresses.size(), (size_t) 10);
+		ensure_equals("charged", sPoolTag.getLiveBytes(), (U32) (10 * element_size));
+		// 4 per chunk, so 3 chunks
+		ensure_equals("reserved", Pooled::sPool.getReservedBytes(), (U32) (12 * element_size));
+
+		for (S32 i = 0; i < 10; i++)
+		{
+			delete objects[i];
+		}
+		ensure_equals("credited", sPoolTag.getLiveBytes(), 0U);
+
+		for (S32 i = 0; i < 10; i++)
+		{
+			Pooled* object = new Pooled;
+			ensure("reused", addresses.count(object) == 1);
+			objects[i] = object;
+		}
+		ensure_equals("no new chunks", Pooled::sPool.getReservedBytes(), (U32) (12 * element_size));
+		for (S32 i = 0; i < 10; i++)
+		{
+			delete objects[i];
+		}
+	}
+
+	template<> template<>
+	void memtag_object::test<4>()
+	{
+		set_test_name("derived classes go to the heap");
+		U32 reserved = Pooled::sPool.getReservedBytes();
+		Pooled* object = new PooledDerived;
+		ensure_equals("charged exact size", sPoolTag.getLiveBytes(), (U32) sizeof(PooledDerived));
+		delete object;
+		ensure_equals("credited through the virtual destructor", sPoolTag.getLiveBytes(), 0U);
+		ensure_equals("pool untouched", Pooled::sPool.getReservedBytes(), reserved);
+	}
+
+	template<> template<>
+	void memtag_object::test<5>()
+	{
+		set_test_name("dump");
+		sCounterTag.add(1234);
+		std::ostringstream str;
+		LLMemTag::dump(str);
+		sCounterTag.remove(1234);
+
+		std::string out = str.str();
+		ensure_equals("header", out.substr(0, out.find('\n')),
+					  std::string("tag,live_bytes,peak_bytes,live_allocations"));
+		ensure("counter line", out.find("\nTestCounter,1234,1234,1\n") != std::string::npos);
+		ensure("block line", out.find("\nTestBlock,0,") != std::string::npos);
+		ensure("pool line", out.find("\nTestPool,") != std::string::npos);
+	}
+}
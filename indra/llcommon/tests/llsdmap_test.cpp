@@ -0,0 +1,479 @@
+/**
+ * @file   llsdmap_test.cpp
+ * @brief  Test and benchmark for the flat LLSD map representation.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llsd.h"
+// STL headers
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+// external library headers
+#include <boost/foreach.hpp>
+#include <boost/type_traits/is_convertible.hpp>
+// other Linden headers
+#include "llsdserialize.h"
+#include "llsdutil.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+// Counts heap use so the benchmark can compare the footprint of the two
+// map representations.  Where the library has its own heap (Windows DLLs)
+// the LLSD side isn't seen and memory isn't reported.
+namespace
+{
+	size_t sHeapBytes = 0;
+	size_t sHeapBlocks = 0;
+	const size_t HEADER_SIZE = 16; // keeps the alignment malloc gave us
+
+	void* counted_alloc(size_t size)
+	{
+		char* block = static_cast<char*>(malloc(size + HEADER_SIZE));
+		if (!block)
+		{
+			throw std::bad_alloc();
+		}
+		*reinterpret_cast<size_t*>(block) = size;
+		sHeapBytes += size;
+		sHeapBlocks++;
+		return block + HEADER_SIZE;
+	}
+
+	void counted_free(void* ptr)
+	{
+		if (ptr)
+		{
+			char* block = static_cast<char*>(ptr) - HEADER_SIZE;
+			sHeapBytes -= *reinterpret_cast<size_t*>(block);
+			sHeapBlocks--;
+			free(block);
+		}
+	}
+}
+
+void* operator new(size_t size) throw(std::bad_alloc)	{ return counted_alloc(size); }
+void* operator new[](size_t size) throw(std::bad_alloc)	{ return counted_alloc(size); }
+void operator delete(void* ptr) throw()					{ counted_free(ptr); }
+void operator delete[](void* ptr) throw()				{ counted_free(ptr); }
+
+namespace
+{
+	std::string make_id(S32 kind, S32 n)
+	{
+		LLUUID id;
+		id.generate(llformat("%d:%d", kind, n));
+		return id.asString();
+	}
+
+	// Shaped like a FetchInventoryDescendents2 reply.
+	LLSD make_inventory_response(S32 folders, S32 items_per_folder)
+	{
+		LLSD response;
+		for (S32 f = 0; f < folders; f++)
+		{
+			LLSD folder;
+			folder["agent_id"] = LLUUID(make_id(0, 0));
+			folder["owner_id"] = LLUUID(make_id(0, 0));
+			folder["folder_id"] = LLUUID(make_id(1, f));
+			folder["descendents"] = items_per_folder;
+			folder["version"] = 12 + f;
+			for (S32 c = 0; c < 3; c++)
+			{
+				LLSD category;
+				category["category_id"] = LLUUID(make_id(2, f * 3 + c));
+				category["parent_id"] = folder["folder_id"];
+				category["name"] = llformat("Folder %d.%d", f, c);
+				category["type_default"] = -1;
+				category["version"] = 1;
+				folder["categories"].append(category);
+			}
+			for (S32 i = 0; i < items_per_folder; i++)
+			{
+				LLSD item;
+				item["item_id"] = LLUUID(make_id(3, f * items_per_folder + i));
+				item["parent_id"] = folder["folder_id"];
+				item["asset_id"] = LLUUID(make_id(4, i));
+				item["name"] = llformat("Object %d", i);
+				item["desc"] = "(No Description)";
+				item["type"] = 6;
+				item["inv_type"] = 6;
+				item["flags"] = 0;
+				item["created_at"] = 1300000000 + i;
+				LLSD& perm = item["permissions"];
+				perm["creator_id"] = LLUUID(make_id(5, i % 7));
+				perm["owner_id"] = LLUUID(make_id(0, 0));
+				perm["last_owner_id"] = LLUUID(make_id(5, i % 7));
+				perm["group_id"] = LLUUID::null;
+				perm["base_mask"] = (S32)0x7fffffff;
+				perm["owner_mask"] = (S32)0x7fffffff;
+				perm["group_mask"] = 0;
+				perm["everyone_mask"] = 0;
+				perm["next_owner_mask"] = (S32)0x82000;
+				perm["is_owner_group"] = false;
+				LLSD& sale = item["sale_info"];
+				sale["sale_price"] = 10;
+				sale["sale_type"] = 0;
+				folder["items"].append(item);
+			}
+			response["folders"].append(folder);
+		}
+		return response;
+	}
+
+	// Shaped like a GetObjectCost reply, keyed on object id.
+	LLSD make_object_cost_response(S32 objects)
+	{
+		LLSD response;
+		for (S32 i = 0; i < objects; i++)
+		{
+			LLSD& cost = response[make_id(6, i)];
+			cost["linked_set_resource_cost"] = 1.5 + i % 10;
+			cost["resource_cost"] = 1.0;
+			cost["physics_cost"] = 0.5;
+			cost["linked_set_physics_cost"] = 2.5;
+			cost["resource_limiting_type"] = "legacy";
+		}
+		return response;
+	}
+
+	std::string to_xml(const LLSD& sd)
+	{
+		std::ostringstream str;
+		LLSDSerialize::toXML(sd, str);
+		return str.str();
+	}
+
+	LLSD from_xml(const std::string& xml)
+	{
+		LLSD sd;
+		std::istringstream str(xml);
+		LLSDSerialize::fromXML(sd, str);
+		return sd;
+	}
+
+	typedef std::map<std::string, LLSD> MirrorMap;
+
+	// Rebuilds every map in sd both ways, sharing the values, so that the
+	// heap difference is just the map structure.
+	void rebuild_maps(const LLSD& sd, std::vector<LLSD>& flat, std::vector<MirrorMap>& mirror, bool build_flat)
+	{
+		if (sd.isMap())
+		{
+			if (build_flat)
+			{
+				flat.push_back(LLSD::emptyMap());
+				LLSD& copy = flat.back();
+				for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+				{
+					copy[it->first] = it->second;
+				}
+			}
+			else
+			{
+				mirror.push_back(MirrorMap());
+				MirrorMap& copy = mirror.back();
+				for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+				{
+					copy[it->first] = it->second;
+				}
+			}
+			for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+			{
+				rebuild_maps(it->second, flat, mirror, build_flat);
+			}
+		}
+		else if (sd.isArray())
+		{
+			for (LLSD::array_const_iterator it = sd.beginArray(); it != sd.endArray(); ++it)
+			{
+				rebuild_maps(*it, flat, mirror, build_flat);
+			}
+		}
+	}
+
+	S32 count_maps(const LLSD& sd)
+	{
+		S32 count = 0;
+		if (sd.isMap())
+		{
+			count++;
+			for (LLSD::map_const_iterator it = sd.beginMap(); it != sd.endMap(); ++it)
+			{
+				count += count_maps(it->second);
+			}
+		}
+		else if (sd.isArray())
+		{
+			for (LLSD::array_const_iterator it = sd.beginArray(); it != sd.endArray(); ++it)
+			{
+				count += count_maps(*it);
+			}
+		}
+		return count;
+	}
+
+	const char* LOOKUP_KEYS[] = { "item_id", "name", "type", "inv_type", "flags",
+								  "permissions", "owner_id", "sale_info", "sale_price",
+								  "resource_cost", "physics_cost", "missing" };
+	const S32 NUM_LOOKUP_KEYS = sizeof(LOOKUP_KEYS) / sizeof(LOOKUP_KEYS[0]);
+
+	S32 lookup_flat(const std::vector<LLSD>& maps)
+	{
+		S32 found = 0;
+		for (std::vector<LLSD>::const_iterator it = maps.begin(); it != maps.end(); ++it)
+		{
+			for (S32 k = 0; k < NUM_LOOKUP_KEYS; k++)
+			{
+				found += it->has(LOOKUP_KEYS[k]) ? 1 : 0;
+			}
+			for (LLSD::map_const_iterator e = it->beginMap(); e != it->endMap(); ++e)
+			{
+				found += e->second.isDefined() ? 0 : 1;
+			}
+		}
+		return found;
+	}
+
+	S32 lookup_mirror(const std::vector<MirrorMap>& maps)
+	{
+		S32 found = 0;
+		for (std::vector<MirrorMap>::const_iterator it = maps.begin(); it != maps.end(); ++it)
+		{
+			for (S32 k = 0; k < NUM_LOOKUP_KEYS; k++)
+			{
+				found += it->find(LOOKUP_KEYS[k]) != it->end() ? 1 : 0;
+			}
+			for (MirrorMap::const_iterator e = it->begin(); e != it->end(); ++e)
+			{
+				found += e->second.isDefined() ? 0 : 1;
+			}
+		}
+		return found;
+	}
+
+	void benchmark(const std::string& name, const LLSD& response, S32 replays)
+	{
+		std::string xml = to_xml(response);
+
+		LLTimer timer;
+		LLSD parsed;
+		for (S32 i = 0; i < replays; i++)
+		{
+			parsed = from_xml(xml);
+		}
+		F32 parse_time = timer.getElapsedTimeF32() / replays;
+		tut::ensure("replay round trips", llsd_equals(parsed, response));
+
+		std::vector<LLSD> flat;
+		std::vector<MirrorMap> mirror;
+		S32 maps = count_maps(parsed);
+		flat.reserve(maps);
+		mirror.reserve(maps);
+
+		size_t before = sHeapBytes;
+		size_t before_blocks = sHeapBlocks;
+		timer.reset();
+		rebuild_maps(parsed, flat, mirror, true);
+		F32 flat_build = timer.getElapsedTimeF32();
+		size_t flat_bytes = sHeapBytes - before;
+		size_t flat_blocks = sHeapBlocks - before_blocks;
+
+		before = sHeapBytes;
+		before_blocks = sHeapBlocks;
+		timer.reset();
+		rebuild_maps(parsed, flat, mirror, false);
+		F32 mirror_build = timer.getElapsedTimeF32();
+		// Each std::map used to sit in an ImplMap of its own, a vtable and
+		// a use count on top of the map.
+		size_t mirror_bytes = sHeapBytes - before + mirror.size() * (sizeof(MirrorMap) + 2 * sizeof(void*));
+		size_t mirror_blocks = sHeapBlocks - before_blocks + mirror.size();
+
+		timer.reset();
+		S32 flat_found = 0;
+		for (S32 i = 0; i < replays; i++)
+		{
+			flat_found += lookup_flat(flat);
+		}
+		F32 flat_lookup = timer.getElapsedTimeF32() / replays;
+
+		timer.reset();
+		S32 mirror_found = 0;
+		for (S32 i = 0; i < replays; i++)
+		{
+			mirror_found += lookup_mirror(mirror);
+		}
+		F32 mirror_lookup = timer.getElapsedTimeF32() / replays;
+		tut::ensure_equals("same lookups both ways", flat_found, mirror_found);
+
+		llinfos << name << ": " << xml.size() << " bytes of xml, " << maps << " maps, parse "
+				<< parse_time * 1000.f << "ms" << llendl;
+		llinfos << name << ": build flat " << flat_build * 1000.f << "ms, std::map "
+				<< mirror_build * 1000.f << "ms; lookup and iterate flat " << flat_lookup * 1000.f
+				<< "ms, std::map " << mirror_lookup * 1000.f << "ms" << llendl;
+		if (flat_bytes)
+		{
+			llinfos << name << ": map storage flat " << flat_bytes << " bytes in " << flat_blocks
+					<< " allocations, std::map " << mirror_bytes << " bytes in " << mirror_blocks
+					<< " allocations, " << LLSD::internedKeyCount() << " interned keys" << llendl;
+		}
+	}
+}
+
+namespace tut
+{
+	struct sdmap_data
+	{
+	};
+	typedef test_group<sdmap_data> sdmap_test;
+	typedef sdmap_test::object sdmap_object;
+	tut::sdmap_test sdmap_testcase("LLSDMap");
+
+	template<> template<>
+	void sdmap_object::test<1>()
+	{
+		set_test_name("sorted iteration, lookup, erase and insert");
+		LLSD map;
+		const char* keys[] = { "pear", "apple", "fig", "banana", "cherry" };
+		for (S32 i = 0; i < 5; i++)
+		{
+			map[keys[i]] = i;
+		}
+		ensure_equals("size", map.size(), 5);
+
+		std::string order;
+		for (LLSD::map_const_iterator it = map.beginMap(); it != map.endMap(); ++it)
+		{
+			order += it->first + " ";
+		}
+		ensure_equals("sorted", order, std::string("apple banana cherry fig pear "));
+		ensure_equals("lookup", map["fig"].asInteger(), 2);
+		ensure("has", map.has("banana"));
+		ensure("hasn't", !map.has("grape"));
+		ensure("const miss is undefined", static_cast<const LLSD&>(map)["grape"].isUndefined());
+		ensure_equals("const miss doesn't insert", map.size(), 5);
+
+		map.erase("banana");
+		map.erase("grape");
+		ensure_equals("erased", map.size(), 4);
+		ensure("gone", !map.has("banana"));
+		map.insert("banana", 7);
+		map.insert("apple", 8);
+		ensure_equals("insert reuses the slot", map["banana"].asInteger(), 7);
+		ensure_equals("insert doesn't overwrite", map["apple"].asInteger(), 1);
+
+		LLSD::map_iterator last = map.endMap();
+		--last;
+		ensure_equals("decrement from end", last->first, std::string("pear"));
+		last->second = 9;
+		ensure_equals("write through iterator", map["pear"].asInteger(), 9);
+	}
+
+	template<> template<>
+	void sdmap_object::test<2>()
+	{
+		set_test_name("references survive growth, copies are copy on write");
+		LLSD map;
+		LLSD& first = map["first"];
+		first = "value";
+		for (S32 i = 0; i < 100; i++)
+		{
+			map[llformat("key%d", i)] = i;
+		}
+		ensure_equals("same reference", &map["first"], &first);
+		ensure_equals("still there", first.asString(), std::string("value"));
+
+		LLSD copy = map;
+		const LLSD& const_copy = copy;
+		ensure_equals("shared until written", &const_copy["first"], &static_cast<const LLSD&>(map)["first"]);
+		copy["first"] = "changed";
+		ensure_equals("original untouched", map["first"].asString(), std::string("value"));
+		ensure_equals("copy changed", copy["first"].asString(), std::string("changed"));
+		ensure_equals("copy complete", copy.size(), map.size());
+		ensure("copy equal but for one", !llsd_equals(copy, map));
+		copy["first"] = "value";
+		ensure("copy equal again", llsd_equals(copy, map));
+	}
+
+	template<> template<>
+	void sdmap_object::test<3>()
+	{
+		set_test_name("existing iterator uses");
+		LLSD map;
+		map["a"] = 1;
+		map["b"] = 2;
+		map["c"] = 3;
+
+		S32 sum = 0;
+		BOOST_FOREACH(const llsd::MapEntry& entry, llsd::inMap(map))
+		{
+			sum += entry.second.asInteger();
+		}
+		ensure_equals("foreach", sum, 6);
+
+		LLSD::map_iterator it = map.beginMap();
+		LLSD::map_const_iterator cit = it;
+		ensure("converted", cit == it && it == cit);
+		ensure("const_iterator doesn't convert to iterator",
+			   !boost::is_convertible<LLSD::map_const_iterator, LLSD::map_iterator>::value);
+		ensure_equals("post increment", (*it++).first, std::string("a"));
+		ensure("moved", cit != it);
+		ensure_equals("distance", (S32)std::distance(map.beginMap(), map.endMap()), 3);
+
+		LLSD empty;
+		ensure("undefined is empty", empty.beginMap() == static_cast<const LLSD&>(empty).endMap());
+		LLSD empty_map = LLSD::emptyMap();
+		ensure("empty map is empty", empty_map.beginMap() == empty_map.endMap());
+	}
+
+	template<> template<>
+	void sdmap_object::test<4>()
+	{
+		set_test_name("ids aren't interned");
+		U32 before = LLSD::internedKeyCount();
+		LLSD map;
+		for (S32 i = 0; i < 100; i++)
+		{
+			map[make_id(7, i)] = i;
+		}
+		map["some_short_key"] = true;
+		ensure_equals("only the short key", LLSD::internedKeyCount(), before + 1);
+		map["some_short_key"] = false;
+		LLSD other;
+		other["some_short_key"] = true;
+		ensure_equals("interned once", LLSD::internedKeyCount(), before + 1);
+	}
+
+	template<> template<>
+	void sdmap_object::test<5>()
+	{
+		set_test_name("replay inventory and object cost responses");
+		benchmark("Inventory", make_inventory_response(20, 50), 5);
+		benchmark("Object cost", make_object_cost_response(2000), 5);
+	}
+}
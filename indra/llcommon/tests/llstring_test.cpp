@@ -29,7 +29,228 @@
 #include "linden_common.h"
 #include "../test/lltut.h"
 
+#include <algorithm>
+
 #include "../llstring.h"
+#include "../lltimer.h"
+
+namespace
+{
+	// The character at a time conversions from before the ASCII fast
+	// paths, to check the new ones against.
+	LLWString old_utf8str_to_wstring(const std::string& utf8str, S32 len)
+	{
+		LLWString wout;
+
+		S32 i = 0;
+		while (i < len)
+		{
+			llwchar unichar;
+			U8 cur_char = utf8str[i];
+
+			if (cur_char < 0x80)
+			{
+				unichar = cur_char;
+			}
+			else
+			{
+				S32 cont_bytes = 0;
+				if ((cur_char >> 5) == 0x6)
+				{
+					unichar = (0x1F&cur_char);
+					cont_bytes = 1;
+				}
+				else if ((cur_char >> 4) == 0xe)
+				{
+					unichar = (0x0F&cur_char);
+					cont_bytes = 2;
+				}
+				else if ((cur_char >> 3) == 0x1e)
+				{
+					unichar = (0x07&cur_char);
+					cont_bytes = 3;
+				}
+				else if ((cur_char >> 2) == 0x3e)
+				{
+					unichar = (0x03&cur_char);
+					cont_bytes = 4;
+				}
+				else if ((cur_char >> 1) == 0x7e)
+				{
+					unichar = (0x01&cur_char);
+					cont_bytes = 5;
+				}
+				else
+				{
+					wout += LL_UNKNOWN_CHAR;
+					++i;
+					continue;
+				}
+
+				S32 end = (len < (i + cont_bytes)) ? len : (i + cont_bytes);
+				do
+				{
+					++i;
+
+					cur_char = utf8str[i];
+					if ( (cur_char >> 6) == 0x2 )
+					{
+						unichar <<= 6;
+						unichar += (0x3F&cur_char);
+					}
+					else
+					{
+						unichar = LL_UNKNOWN_CHAR;
+						--i;
+						break;
+					}
+				} while(i < end);
+
+				if ( ((cont_bytes == 1) && (unichar < 0x80))
+					|| ((cont_bytes == 2) && (unichar < 0x800))
+					|| ((cont_bytes == 3) && (unichar < 0x10000))
+					|| ((cont_bytes == 4) && (unichar < 0x200000))
+					|| ((cont_bytes == 5) && (unichar < 0x4000000)) )
+				{
+					unichar = LL_UNKNOWN_CHAR;
+				}
+			}
+
+			wout += unichar;
+			++i;
+		}
+		return wout;
+	}
+
+	std::string old_wstring_to_utf8str(const LLWString& utf32str, S32 len)
+	{
+		std::string out;
+
+		S32 i = 0;
+		while (i < len)
+		{
+			char tchars[8];		/* Flawfinder: ignore */
+			S32 n = wchar_to_utf8chars(utf32str[i], tchars);
+			tchars[n] = 0;
+			out += tchars;
+			i++;
+		}
+		return out;
+	}
+
+	struct Random
+	{
+		Random() : mSeed(12345) {}
+		U32 next(U32 range)
+		{
+			mSeed = mSeed * 1103515245 + 12345;
+			return (mSeed >> 8) % range;
+		}
+		U32 mSeed;
+	};
+
+	// Appends a run of ASCII, including the odd NUL
+	void add_ascii(Random& random, std::string& str)
+	{
+		U32 count = random.next(40);
+		for (U32 i = 0; i < count; i++)
+		{
+			str += (char)(random.next(30) ? 0x20 + random.next(0x5F) : random.next(0x20));
+		}
+	}
+
+	// Appends one well formed character past ASCII
+	void add_valid(Random& random, std::string& str)
+	{
+		static const U32 ranges[] = { 0x80, 0x800, 0x10000, 0x110000 };
+		U32 range = random.next(3);
+		U32 unichar = ranges[range] + random.next(ranges[range + 1] - ranges[range]);
+		if (unichar >= 0xD800 && unichar <= 0xDFFF)
+		{
+			unichar = 0xE9;
+		}
+		char chars[8];		/* Flawfinder: ignore */
+		S32 n = wchar_to_utf8chars((llwchar)unichar, chars);
+		str.append(chars, n);
+	}
+
+	// Appends something the decoder has to recover from
+	void add_broken(Random& random, std::string& str)
+	{
+		switch (random.next(7))
+		{
+		case 0:
+			// A random byte that isn't ASCII
+			str += (char)(0x80 + random.next(0x80));
+			break;
+		case 1:
+		{
+			// A character with its last byte or bytes missing
+			std::string valid;
+			add_valid(random, valid);
+			str.append(valid, 0, 1 + random.next(valid.length() - 1));
+			break;
+		}
+		case 2:
+			// Overlong forms of '/'
+			str += random.next(2) ? "\xC0\xAF" : "\xE0\x80\xAF";
+			break;
+		case 3:
+			// An encoded surrogate
+			str += "\xED\xA0\x80";
+			break;
+		case 4:
+			// The old five and six byte forms
+			str += random.next(2) ? "\xF8\x88\x80\x80\x80" : "\xFC\x84\x80\x80\x80\x80";
+			break;
+		case 5:
+			// Past U+10FFFF
+			str += "\xF4\x90\x80\x80";
+			break;
+		default:
+			// An encoded NUL
+			str += "\xC0\x80";
+			break;
+		}
+	}
+
+	LLWString make_wide(Random& random, S32 count)
+	{
+		LLWString wstr;
+		for (S32 i = 0; i < count; i++)
+		{
+			switch (random.next(8))
+			{
+			case 0:
+				wstr += (llwchar)(0x80 + random.next(0x780));
+				break;
+			case 1:
+				wstr += (llwchar)(0x800 + random.next(0xF800));
+				break;
+			case 2:
+				wstr += (llwchar)(0x10000 + random.next(0x100000));
+				break;
+			case 3:
+				// What the old five and six byte forms hold
+				wstr += (llwchar)(0x200000 + random.next(0x7FE00000));
+				break;
+			case 4:
+				wstr += (llwchar)random.next(0x20);
+				break;
+			default:
+			{
+				U32 run = random.next(40);
+				for (U32 j = 0; j < run; j++)
+				{
+					wstr += (llwchar)(0x20 + random.next(0x5F));
+				}
+				break;
+			}
+			}
+		}
+		return wstr;
+	}
+}
 
 namespace tut
 {
@@ -742,4 +963,166 @@ namespace tut
 		ensure("empty substr.", !LLStringUtil::endsWith(empty, value));
 		ensure("empty everything.", !LLStringUtil::endsWith(empty, empty));
 	}
+
+	template<> template<>
+	void string_index_object_t::test<41>()
+	{
+		// utf8str_to_wstring matches the character at a time version
+		Random random;
+		for (S32 round = 0; round < 2000; round++)
+		{
+			std::string str;
+			S32 pieces = random.next(20);
+			for (S32 i = 0; i < pieces; i++)
+			{
+				switch (random.next(4))
+				{
+				case 0:
+					add_valid(random, str);
+					break;
+				case 1:
+					add_broken(random, str);
+					break;
+				default:
+					add_ascii(random, str);
+					break;
+				}
+			}
+			ensure("whole string", old_utf8str_to_wstring(str, str.length()) == utf8str_to_wstring(str));
+			// A length short of the string, which can cut a character
+			// off in the middle
+			S32 len = str.empty() ? 0 : random.next(str.length());
+			ensure("part of the string", old_utf8str_to_wstring(str, len) == utf8str_to_wstring(str, len));
+		}
+
+		std::string ascii(1000, 'a');
+		ascii[500] = '\0';
+		ensure("long ascii", old_utf8str_to_wstring(ascii, ascii.length()) == utf8str_to_wstring(ascii));
+		ensure("empty", utf8str_to_wstring(std::string()).empty());
+	}
+
+	template<> template<>
+	void string_index_object_t::test<42>()
+	{
+		// wstring_to_utf8str matches the character at a time version,
+		// which drops NULs
+		Random random;
+		for (S32 round = 0; round < 500; round++)
+		{
+			// Some long enough to be appended in more than one piece
+			LLWString wstr = make_wide(random, random.next(round % 10 ? 50 : 2000));
+			ensure("whole string", old_wstring_to_utf8str(wstr, wstr.length()) == wstring_to_utf8str(wstr));
+			S32 len = wstr.empty() ? 0 : random.next(wstr.length());
+			ensure("part of the string", old_wstring_to_utf8str(wstr, len) == wstring_to_utf8str(wstr, len));
+		}
+
+		LLWString ascii(3000, 'b');
+		ascii[16] = 0;
+		ascii[2047] = 0xE9;
+		ensure("long ascii", old_wstring_to_utf8str(ascii, ascii.length()) == wstring_to_utf8str(ascii));
+		ensure_equals("NUL dropped", wstring_to_utf8str(ascii).length(), (size_t)3000);
+		ensure("empty", wstring_to_utf8str(LLWString()).empty());
+	}
+
+	template<> template<>
+	void string_index_object_t::test<43>()
+	{
+		// utf8str_is_valid
+		ensure("empty", utf8str_is_valid(""));
+		ensure("ascii", utf8str_is_valid("The quick brown fox jumps over the lazy dog, twice over"));
+		ensure("two bytes", utf8str_is_valid("caf\xC3\xA9"));
+		ensure("three bytes", utf8str_is_valid("\xE2\x82\xAC 5"));
+		ensure("four bytes", utf8str_is_valid("\xF0\x9F\x98\x80"));
+		ensure("last character", utf8str_is_valid("\xF4\x8F\xBF\xBF"));
+		ensure("NUL", utf8str_is_valid(std::string("a\0b", 3)));
+
+		ensure("stray continuation", !utf8str_is_valid("abc\x80"));
+		ensure("cut off", !utf8str_is_valid("caf\xC3"));
+		ensure("cut off in the middle", !utf8str_is_valid("\xE2\x82 after"));
+		ensure("overlong", !utf8str_is_valid("\xC0\xAF"));
+		ensure("overlong three bytes", !utf8str_is_valid("\xE0\x80\xAF"));
+		ensure("surrogate", !utf8str_is_valid("\xED\xA0\x80"));
+		ensure("past U+10FFFF", !utf8str_is_valid("\xF4\x90\x80\x80"));
+		ensure("five bytes", !utf8str_is_valid("\xF8\x88\x80\x80\x80"));
+		ensure("bad byte after a long ascii run", !utf8str_is_valid(std::string(37, 'x') + "\xFF"));
+
+		Random random;
+		for (S32 round = 0; round < 1000; round++)
+		{
+			std::string str;
+			S32 pieces = random.next(20);
+			for (S32 i = 0; i < pieces; i++)
+			{
+				if (random.next(2))
+				{
+					add_valid(random, str);
+				}
+				else
+				{
+					add_ascii(random, str);
+				}
+			}
+			ensure("well formed", utf8str_is_valid(str));
+			// Valid UTF-8 without NULs round trips as it is
+			std::string no_nul(str);
+			std::replace(no_nul.begin(), no_nul.end(), '\0', ' ');
+			ensure("unchanged", rawstr_to_utf8(no_nul) == no_nul);
+			ensure("round trip", wstring_to_utf8str(utf8str_to_wstring(no_nul)) == no_nul);
+
+			std::string broken(str);
+			add_broken(random, broken);
+			add_ascii(random, broken);
+			ensure("broken", !utf8str_is_valid(broken));
+			LLWString old_wide = old_utf8str_to_wstring(broken, broken.length());
+			ensure("broken converted", rawstr_to_utf8(broken) == old_wstring_to_utf8str(old_wide, old_wide.length()));
+		}
+	}
+
+	template<> template<>
+	void string_index_object_t::test<44>()
+	{
+		// Times the conversions against the old ones; only checks results
+		Random random;
+		std::string text;
+		while (text.length() < 1024 * 1024)
+		{
+			add_ascii(random, text);
+			text += ' ';
+		}
+		std::string mixed;
+		while (mixed.length() < 1024 * 1024)
+		{
+			add_ascii(random, mixed);
+			add_valid(random, mixed);
+		}
+
+		LLTimer timer;
+		LLWString old_wide = old_utf8str_to_wstring(text, text.length());
+		F64 old_decode = timer.getElapsedTimeF64();
+		timer.reset();
+		LLWString wide = utf8str_to_wstring(text);
+		F64 new_decode = timer.getElapsedTimeF64();
+		ensure("same wide text", wide == old_wide);
+
+		timer.reset();
+		std::string old_narrow = old_wstring_to_utf8str(wide, wide.length());
+		F64 old_encode = timer.getElapsedTimeF64();
+		timer.reset();
+		std::string narrow = wstring_to_utf8str(wide);
+		F64 new_encode = timer.getElapsedTimeF64();
+		ensure("same text", narrow == old_narrow);
+
+		timer.reset();
+		LLWString old_mixed_wide = old_utf8str_to_wstring(mixed, mixed.length());
+		F64 old_mixed = timer.getElapsedTimeF64();
+		timer.reset();
+		LLWString mixed_wide = utf8str_to_wstring(mixed);
+		F64 new_mixed = timer.getElapsedTimeF64();
+		ensure("same mixed text", mixed_wide == old_mixed_wide);
+
+		llinfos << "1MB ascii to wide: old " << old_decode * 1000.0 << " ms, new " << new_decode * 1000.0
+				<< " ms; wide to ascii: old " << old_encode * 1000.0 << " ms, new " << new_encode * 1000.0
+				<< " ms; 1MB mixed to wide: old " << old_mixed * 1000.0 << " ms, new " << new_mixed * 1000.0
+				<< " ms" << llendl;
+	}
 }
@@ -0,0 +1,392 @@
+/**
+ * @file   llstringtable_test.cpp
+ * @brief  Test for llstringtable.h, and a throughput benchmark against the
+ *         chained table LLStringTable used to be.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llstringtable.h"
+// STL headers
+#include <list>
+#include <string>
+#include <vector>
+// other Linden headers
+#include "llthread.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	//------------------------------------------------------------------------
+	// What LLStringTable was before: a list per bucket, no locking.  The
+	// benchmark puts a mutex around it for the threaded runs, which is what
+	// sharing it with worker threads would have taken.
+
+	class ChainedStringTable
+	{
+	public:
+		ChainedStringTable(U32 tablesize) :
+			mMaxEntries(tablesize),
+			mStringList(new string_list_t*[tablesize]),
+			mMutex(NULL)
+		{
+			for (U32 i = 0; i < mMaxEntries; i++)
+			{
+				mStringList[i] = NULL;
+			}
+		}
+		~ChainedStringTable()
+		{
+			for (U32 i = 0; i < mMaxEntries; i++)
+			{
+				if (mStringList[i])
+				{
+					for (string_list_t::iterator iter = mStringList[i]->begin(); iter != mStringList[i]->end(); ++iter)
+					{
+						delete *iter;
+					}
+					delete mStringList[i];
+				}
+			}
+			delete [] mStringList;
+		}
+
+		LLStringTableEntry* checkStringEntry(const char* str)
+		{
+			string_list_t* strlist = mStringList[hash_my_string(str)];
+			if (strlist)
+			{
+				for (string_list_t::iterator iter = strlist->begin(); iter != strlist->end(); ++iter)
+				{
+					if (!strncmp((*iter)->mString, str, MAX_STRINGS_LENGTH))
+					{
+						return *iter;
+					}
+				}
+			}
+			return NULL;
+		}
+
+		LLStringTableEntry* addStringEntry(const char* str)
+		{
+			LLStringTableEntry* entry = checkStringEntry(str);
+			if (entry)
+			{
+				entry->incCount();
+				return entry;
+			}
+			string_list_t*& strlist = mStringList[hash_my_string(str)];
+			if (!strlist)
+			{
+				strlist = new string_list_t;
+			}
+			entry = new LLStringTableEntry(str);
+			strlist->push_front(entry);
+			return entry;
+		}
+
+		LLMutex* getMutex()	{ return &mMutex; }
+
+	private:
+		U32 hash_my_string(const char* str)
+		{
+			U32 retval = 0;
+			while (*str)
+			{
+				retval = (retval<<4) + *str;
+				U32 x = (retval & 0xf0000000);
+				if (x) retval = retval ^ (x>>24);
+				retval = retval & (~x);
+				str++;
+			}
+			return (retval & (mMaxEntries-1));
+		}
+
+		typedef std::list<LLStringTableEntry*> string_list_t;
+		U32 mMaxEntries;
+		string_list_t** mStringList;
+		LLMutex mMutex;
+	};
+
+	class LockedChainedStringTable
+	{
+	public:
+		LockedChainedStringTable(U32 tablesize) : mTable(tablesize) {}
+		LLStringTableEntry* checkStringEntry(const char* str)
+		{
+			LLMutexLock lock(mTable.getMutex());
+			return mTable.checkStringEntry(str);
+		}
+		LLStringTableEntry* addStringEntry(const char* str)
+		{
+			LLMutexLock lock(mTable.getMutex());
+			return mTable.addStringEntry(str);
+		}
+	private:
+		ChainedStringTable mTable;
+	};
+
+	//------------------------------------------------------------------------
+	// Element and attribute names, the way XUI files repeat a small
+	// vocabulary over and over.
+
+	std::vector<std::string> make_names(S32 count)
+	{
+		static const char* stems[] = { "name", "label", "layout", "follows", "height",
+									   "width", "left", "top", "visible", "tool_tip",
+									   "panel", "button", "text", "line_editor", "icon" };
+		const S32 num_stems = sizeof(stems) / sizeof(stems[0]);
+		std::vector<std::string> names;
+		for (S32 i = 0; i < count; i++)
+		{
+			names.push_back(llformat("%s_%d", stems[i % num_stems], i / num_stems));
+		}
+		return names;
+	}
+
+	const S32 NUM_NAMES = 20000;
+	const S32 NUM_THREADS = 4;
+
+	template <class TABLE>
+	class Interner : public LLThread
+	{
+	public:
+		Interner(TABLE* table, const std::vector<std::string>* names, S32 first, S32 rounds) :
+			LLThread("string table interner"),
+			mTable(table), mNames(names), mFirst(first), mRounds(rounds)
+		{
+			mEntries.resize(names->size());
+		}
+		/*virtual*/ void run()
+		{
+			S32 count = (S32)mNames->size();
+			for (S32 round = 0; round < mRounds; round++)
+			{
+				// Each thread walks the names from a different place so that
+				// they race to add the same strings.
+				for (S32 i = 0; i < count; i++)
+				{
+					S32 index = (i + mFirst) % count;
+					if (round == 0)
+					{
+						mEntries[index] = mTable->addStringEntry((*mNames)[index].c_str());
+					}
+					else
+					{
+						mTable->checkStringEntry((*mNames)[index].c_str());
+					}
+				}
+			}
+		}
+		std::vector<LLStringTableEntry*> mEntries;
+	private:
+		TABLE* mTable;
+		const std::vector<std::string>* mNames;
+		S32 mFirst;
+		S32 mRounds;
+	};
+
+	void wait_stopped(LLThread& thread)
+	{
+		while (!thread.isStopped())
+		{
+			ms_sleep(1);
+		}
+	}
+
+	// Returns the seconds taken, or a negative number if the threads didn't
+	// all get the same entry for every name.
+	template <class TABLE>
+	F64 run_threads(TABLE& table, const std::vector<std::string>& names, S32 threads, S32 rounds)
+	{
+		std::vector<Interner<TABLE>*> interners;
+		for (S32 i = 0; i < threads; i++)
+		{
+			interners.push_back(new Interner<TABLE>(&table, &names, i * (S32)names.size() / threads, rounds));
+		}
+		LLTimer timer;
+		for (S32 i = 0; i < threads; i++)
+		{
+			interners[i]->start();
+		}
+		for (S32 i = 0; i < threads; i++)
+		{
+			wait_stopped(*interners[i]);
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		for (S32 i = 1; i < threads; i++)
+		{
+			if (interners[i]->mEntries != interners[0]->mEntries)
+			{
+				elapsed = -1.0;
+			}
+		}
+		for (S32 i = 0; i < threads; i++)
+		{
+			delete interners[i];
+		}
+		return elapsed;
+	}
+
+	template <class TABLE>
+	void time_single(TABLE& table, const std::vector<std::string>& names, F64& insert, F64& lookup)
+	{
+		LLTimer timer;
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			table.addStringEntry(names[i].c_str());
+		}
+		insert = timer.getElapsedTimeF64();
+		timer.reset();
+		for (S32 round = 0; round < 20; round++)
+		{
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				table.checkStringEntry(names[i].c_str());
+			}
+		}
+		lookup = timer.getElapsedTimeF64();
+	}
+}
+
+namespace tut
+{
+	struct stringtable_data
+	{
+	};
+	typedef test_group<stringtable_data> stringtable_test;
+	typedef stringtable_test::object stringtable_object;
+	tut::stringtable_test stringtable_testcase("LLStringTable");
+
+	template<> template<>
+	void stringtable_object::test<1>()
+	{
+		set_test_name("add, check and remove");
+		LLStringTable table(256);
+		ensure("not there yet", table.checkString("avatar") == NULL);
+		char* first = table.addString("avatar");
+		ensure_equals("copied", std::string(first), std::string("avatar"));
+		ensure("same copy", table.addString(std::string("avatar")) == first);
+		ensure("checks", table.checkString("avatar") == first);
+		ensure("other string", table.addString("avatar_lad") != first);
+		ensure_equals("unique", table.getUniqueEntries(), 2);
+		ensure_equals("counted", apr_atomic_read32(&table.checkStringEntry("avatar")->mCount), (apr_uint32_t) 2);
+
+		table.removeString("avatar");
+		ensure("still there after one remove", table.checkString("avatar") == first);
+		table.removeString("avatar");
+		ensure("gone after two", table.checkString("avatar") == NULL);
+		ensure_equals("unique after remove", table.getUniqueEntries(), 1);
+		table.removeString("avatar");
+		ensure_equals("extra remove ignored", table.getUniqueEntries(), 1);
+
+		ensure("revived in place", table.addString("avatar") == first);
+		ensure_equals("unique after revive", table.getUniqueEntries(), 2);
+		ensure("NULL", table.addString((const char*) NULL) == NULL);
+	}
+
+	template<> template<>
+	void stringtable_object::test<2>()
+	{
+		set_test_name("entries stay put as the table grows");
+		LLStringTable table(16);
+		std::vector<std::string> names = make_names(5000);
+		std::vector<LLStringTableEntry*> entries;
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			entries.push_back(table.addStringEntry(names[i]));
+		}
+		ensure_equals("all unique", table.getUniqueEntries(), (S32) names.size());
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			ensure("same entry", table.checkStringEntry(names[i]) == entries[i]);
+			ensure_equals("same string", std::string(entries[i]->mString), names[i]);
+		}
+	}
+
+	template<> template<>
+	void stringtable_object::test<3>()
+	{
+		set_test_name("long strings are kept truncated");
+		LLStringTable table(256);
+		std::string longer(MAX_STRINGS_LENGTH + 20, 'x');
+		char* entry = table.addString(longer);
+		ensure_equals("truncated", strlen(entry), (size_t) (MAX_STRINGS_LENGTH - 1));
+		ensure("found again", table.addString(longer) == entry);
+		ensure("shorter is different", table.checkString(longer.substr(0, 10)) == NULL);
+	}
+
+	template<> template<>
+	void stringtable_object::test<4>()
+	{
+		set_test_name("threads racing to add the same strings");
+		LLStringTable table(64);
+		std::vector<std::string> names = make_names(NUM_NAMES);
+		F64 elapsed = run_threads(table, names, NUM_THREADS, 1);
+		ensure("every thread got the same entries", elapsed >= 0.0);
+		ensure_equals("one entry per name", table.getUniqueEntries(), NUM_NAMES);
+		for (size_t i = 0; i < names.size(); i += 97)
+		{
+			ensure_equals("counted every add", apr_atomic_read32(&table.checkStringEntry(names[i])->mCount), (apr_uint32_t) NUM_THREADS);
+		}
+	}
+
+	template<> template<>
+	void stringtable_object::test<5>()
+	{
+		set_test_name("throughput against the chained table");
+		std::vector<std::string> names = make_names(NUM_NAMES);
+
+		F64 insert, lookup;
+		{
+			ChainedStringTable table(32768);
+			time_single(table, names, insert, lookup);
+			llinfos << "chained table: insert " << insert * 1000.0 << " ms, 20x lookup "
+					<< lookup * 1000.0 << " ms" << llendl;
+		}
+		{
+			LLStringTable table(32768);
+			time_single(table, names, insert, lookup);
+			llinfos << "open addressing table: insert " << insert * 1000.0 << " ms, 20x lookup "
+					<< lookup * 1000.0 << " ms" << llendl;
+		}
+
+		F64 elapsed;
+		{
+			LockedChainedStringTable table(32768);
+			elapsed = run_threads(table, names, NUM_THREADS, 20);
+			ensure("locked chained table consistent", elapsed >= 0.0);
+			llinfos << NUM_THREADS << " threads, locked chained table: " << elapsed * 1000.0 << " ms" << llendl;
+		}
+		{
+			LLStringTable table(32768);
+			elapsed = run_threads(table, names, NUM_THREADS, 20);
+			ensure("open addressing table consistent", elapsed >= 0.0);
+			llinfos << NUM_THREADS << " threads, open addressing table: " << elapsed * 1000.0 << " ms" << llendl;
+		}
+	}
+}
@@ -30,7 +30,6 @@
 
 #include "llmath.h"
 #include "v4coloru.h"
-#include "llmemtype.h"
 
 #include "llimagebmp.h"
 #include "llimagetga.h"
@@ -87,7 +86,7 @@ LLImageBase::LLImageBase()
 	  mComponents(0),
 	  mBadBufferAllocation(false),
 	  mAllowOverSize(false),
-	  mMemType(LLMemType::MTYPE_IMAGEBASE)
+	  mMemTag(NULL)
 {
 }
 
@@ -130,6 +129,10 @@ void LLImageBase::sanityCheck()
 // virtual
 void LLImageBase::deleteData()
 {
+	if (mData && mMemTag)
+	{
+		mMemTag->remove(mDataSize);
+	}
 	delete[] mData;
 	mData = NULL;
 	mDataSize = 0;
@@ -138,8 +141,6 @@ void LLImageBase::deleteData()
 // virtual
 U8* LLImageBase::allocateData(S32 size)
 {
-	LLMemType mt1(mMemType);
-	
 	if (size < 0)
 	{
 		size = mWidth * mHeight * mComponents;
@@ -175,6 +176,10 @@ U8* LLImageBase::allocateData(S32 size)
 			mWidth = mHeight = 0 ;
 			mBadBufferAllocation = true ;
 		}
+		else if (mMemTag)
+		{
+			mMemTag->add(size);
+		}
 		mDataSize = size;
 	}
 
@@ -184,7 +189,6 @@ U8* LLImageBase::allocateData(S32 size)
 // virtual
 U8* LLImageBase::reallocateData(S32 size)
 {
-	LLMemType mt1(mMemType);
 	U8 *new_datap = new U8[size];
 	if (!new_datap)
 	{
@@ -195,13 +199,30 @@ U8* LLImageBase::reallocateData(S32 size)
 	{
 		S32 bytes = llmin(mDataSize, size);
 		memcpy(new_datap, mData, bytes);	/* Flawfinder: ignore */
-		delete[] mData;
 	}
-	mData = new_datap;
-	mDataSize = size;
+	U8* old_datap = mData;
+	setDataAndSize(new_datap, size);
+	delete[] old_datap;
 	return mData;
 }
 
+void LLImageBase::setDataAndSize(U8 *data, S32 size)
+{
+	if (mMemTag)
+	{
+		if (mData)
+		{
+			mMemTag->remove(mDataSize);
+		}
+		if (data)
+		{
+			mMemTag->add(size);
+		}
+	}
+	mData = data;
+	mDataSize = size;
+}
+
 const U8* LLImageBase::getData() const	
 { 
 	if(mBadBufferAllocation)
@@ -246,18 +267,19 @@ U8* LLImageBase::allocateDataSize(S32 width, S32 height, S32 ncomponents, S32 si
 
 S32 LLImageRaw::sGlobalRawMemory = 0;
 S32 LLImageRaw::sRawImageCount = 0;
+LLMemTag LLImageRaw::sMemTag("ImageRaw");
 
 LLImageRaw::LLImageRaw()
 	: LLImageBase()
 {
-	mMemType = LLMemType::MTYPE_IMAGERAW;
+	mMemTag = &sMemTag;
 	++sRawImageCount;
 }
 
 LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components)
 	: LLImageBase()
 {
-	mMemType = LLMemType::MTYPE_IMAGERAW;
+	mMemTag = &sMemTag;
 	//llassert( S32(width) * S32(height) * S32(components) <= MAX_IMAGE_DATA_SIZE );
 	allocateDataSize(width, height, components);
 	++sRawImageCount;
@@ -266,7 +288,7 @@ LLImageRaw::LLImageRaw(U16 width, U16 height, S8 components)
 LLImageRaw::LLImageRaw(U8 *data, U16 width, U16 height, S8 components)
 	: LLImageBase()
 {
-	mMemType = LLMemType::MTYPE_IMAGERAW;
+	mMemTag = &sMemTag;
 	if(allocateDataSize(width, height, components))
 	{
 		memcpy(getData(), data, width*height*components);
@@ -343,7 +365,6 @@ BOOL LLImageRaw::resize(U16 width, U16 height, S8 components)
 
 U8 * LLImageRaw::getSubImage(U32 x_pos, U32 y_pos, U32 width, U32 height) const
 {
-	LLMemType mt1(mMemType);
 	U8 *data = new U8[width*height*getComponents()];
 
 	// Should do some simple bounds checking
@@ -426,7 +447,6 @@ void LLImageRaw::clear(U8 r, U8 g, U8 b, U8 a)
 // Reverses the order of the rows in the image
 void LLImageRaw::verticalFlip()
 {
-	LLMemType mt1(mMemType);
 	S32 row_bytes = getWidth() * getComponents();
 	llassert(row_bytes > 0);
 	std::vector<U8> line_buffer(row_bytes);
@@ -559,7 +579,6 @@ void LLImageRaw::composite( LLImageRaw* src )
 // Src and dst can be any size.  Src has 4 components.  Dst has 3 components.
 void LLImageRaw::compositeScaled4onto3(LLImageRaw* src)
 {
-	LLMemType mt1(mMemType);
 	llinfos << "compositeScaled4onto3" << llendl;
 
 	LLImageRaw* dst = this;  // Just for clarity.
@@ -801,7 +820,6 @@ void LLImageRaw::copyUnscaled3onto4( LLImageRaw* src )
 // Src and dst can be any size.  Src and dst have same number of components.
 void LLImageRaw::copyScaled( LLImageRaw* src )
 {
-	LLMemType mt1(mMemType);
 	LLImageRaw* dst = this;  // Just for clarity.
 
 	llassert_always( (1 == src->getComponents()) || (3 == src->getComponents()) || (4 == src->getComponents()) );
@@ -833,7 +851,6 @@ void LLImageRaw::copyScaled( LLImageRaw* src )
 //scale down image by not blending a pixel with its neighbors.
 BOOL LLImageRaw::scaleDownWithoutBlending( S32 new_width, S32 new_height)
 {
-	LLMemType mt1(mMemType);
 
 	S8 c = getComponents() ;
 	llassert((1 == c) || (3 == c) || (4 == c) );
@@ -878,7 +895,6 @@ BOOL LLImageRaw::scaleDownWithoutBlending( S32 new_width, S32 new_height)
 
 BOOL LLImageRaw::scale( S32 new_width, S32 new_height, BOOL scale_image_data )
 {
-	LLMemType mt1(mMemType);
 	llassert((1 == getComponents()) || (3 == getComponents()) || (4 == getComponents()) );
 
 	S32 old_width = getWidth();
@@ -1299,6 +1315,7 @@ bool LLImageRaw::createFromFile(const std::string &filename, bool j2c_lowest_mip
 
 //static
 S32 LLImageFormatted::sGlobalFormattedMemory = 0;
+LLMemTag LLImageFormatted::sMemTag("ImageFormatted");
 
 LLImageFormatted::LLImageFormatted(S8 codec)
 	: LLImageBase(),
@@ -1307,7 +1324,7 @@ LLImageFormatted::LLImageFormatted(S8 codec)
 	  mDecoded(0),
 	  mDiscardLevel(-1)
 {
-	mMemType = LLMemType::MTYPE_IMAGEFORMATTED;
+	mMemTag = &sMemTag;
 }
 
 // virtual
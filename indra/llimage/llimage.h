@@ -31,7 +31,7 @@
 #include "llstring.h"
 //#include "llmemory.h"
 #include "llthread.h"
-#include "llmemtype.h"
+#include "llmemtag.h"
 
 const S32 MIN_IMAGE_MIP =  2; // 4x4, only used for expand/contract power of 2
 const S32 MAX_IMAGE_MIP = 11; // 2048x2048
@@ -140,7 +140,7 @@ public:
 
 protected:
 	// special accessor to allow direct setting of mData and mDataSize by LLImageFormatted
-	void setDataAndSize(U8 *data, S32 size) { mData = data; mDataSize = size; }
+	void setDataAndSize(U8 *data, S32 size);
 	
 public:
 	static void generateMip(const U8 *indata, U8* mipdata, int width, int height, S32 nchannels);
@@ -162,8 +162,8 @@ private:
 
 	bool mBadBufferAllocation ;
 	bool mAllowOverSize ;
-public:
-	LLMemType::DeclareMemType& mMemType; // debug
+protected:
+	LLMemTag* mMemTag; // charged for mData, set by the subclass
 };
 
 // Raw representation of an image (used for textures, and other uncompressed formats
@@ -250,6 +250,7 @@ protected:
 
 public:
 	static S32 sGlobalRawMemory;
+	static LLMemTag sMemTag;
 	static S32 sRawImageCount;
 };
 
@@ -323,6 +324,7 @@ protected:
 	
 public:
 	static S32 sGlobalFormattedMemory;
+	static LLMemTag sMemTag;
 };
 
 #endif
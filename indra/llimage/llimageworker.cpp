@@ -36,6 +36,11 @@ LLImageDecodeThread::LLImageDecodeThread(bool threaded)
 	: LLQueuedThread("imagedecode", threaded)
 {
 	mCreationMutex = new LLMutex(getAPRPool());
+	if (isHosted())
+	{
+		// Every request decodes its own image, so they can share out all of the workers.
+		setMaxJobs(LLJobScheduler::getInstance()->getNumWorkers());
+	}
 }
 
 //virtual 
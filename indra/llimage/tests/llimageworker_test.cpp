@@ -50,7 +50,7 @@ mHeight(0),
 mComponents(0),
 mBadBufferAllocation(false),
 mAllowOverSize(false),
-mMemType(LLMemType::MTYPE_IMAGEBASE)
+mMemTag(NULL)
 {
 }
 LLImageBase::~LLImageBase() {}
@@ -34,6 +34,7 @@
 #endif
 
 #include "llerror.h"
+#include "llmemtag.h"
 #include "llmemtype.h"
 
 #include "llvolumemgr.h"
@@ -57,6 +58,9 @@
 #define DEBUG_SILHOUETTE_NORMALS 0 // TomY: Use this to display normals using the silhouette
 #define DEBUG_SILHOUETTE_EDGE_MAP 0 // DaveP: Use this to display edge map using the silhouette
 
+// Vertex, index and extents arrays of every LLVolumeFace
+static LLMemTag sVolumeFaceMemTag("VolumeFace");
+
 const F32 CUT_MIN = 0.f;
 const F32 CUT_MAX = 1.f;
 const F32 MIN_CUT_DELTA = 0.02f;
@@ -5511,7 +5515,7 @@ LLVolumeFace::LLVolumeFace() :
 	mWeights(NULL),
 	mOctree(NULL)
 {
-	mExtents = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*3);
+	mExtents = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*3);
 	mExtents[0].splat(-0.5f);
 	mExtents[1].splat(0.5f);
 	mCenter = mExtents+2;
@@ -5534,7 +5538,7 @@ LLVolumeFace::LLVolumeFace(const LLVolumeFace& src)
 	mWeights(NULL),
 	mOctree(NULL)
 { 
-	mExtents = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*3);
+	mExtents = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*3);
 	mCenter = mExtents+2;
 	*this = src;
 }
@@ -5584,7 +5588,7 @@ LLVolumeFace& LLVolumeFace::operator=(const LLVolumeFace& src)
 		}
 		else
 		{
-			ll_aligned_free_16(mBinormals);
+			ll_tagged_free_16(sVolumeFaceMemTag, mBinormals);
 			mBinormals = NULL;
 		}
 
@@ -5595,7 +5599,7 @@ LLVolumeFace& LLVolumeFace::operator=(const LLVolumeFace& src)
 		}
 		else
 		{
-			ll_aligned_free_16(mWeights);
+			ll_tagged_free_16(sVolumeFaceMemTag, mWeights);
 			mWeights = NULL;
 		}
 	}
@@ -5613,7 +5617,7 @@ LLVolumeFace& LLVolumeFace::operator=(const LLVolumeFace& src)
 
 LLVolumeFace::~LLVolumeFace()
 {
-	ll_aligned_free_16(mExtents);
+	ll_tagged_free_16(sVolumeFaceMemTag, mExtents);
 	mExtents = NULL;
 
 	freeData();
@@ -5621,17 +5625,17 @@ LLVolumeFace::~LLVolumeFace()
 
 void LLVolumeFace::freeData()
 {
-	ll_aligned_free_16(mPositions);
+	ll_tagged_free_16(sVolumeFaceMemTag, mPositions);
 	mPositions = NULL;
-	ll_aligned_free_16( mNormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mNormals);
 	mNormals = NULL;
-	ll_aligned_free_16(mTexCoords);
+	ll_tagged_free_16(sVolumeFaceMemTag, mTexCoords);
 	mTexCoords = NULL;
-	ll_aligned_free_16(mIndices);
+	ll_tagged_free_16(sVolumeFaceMemTag, mIndices);
 	mIndices = NULL;
-	ll_aligned_free_16(mBinormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mBinormals);
 	mBinormals = NULL;
-	ll_aligned_free_16(mWeights);
+	ll_tagged_free_16(sVolumeFaceMemTag, mWeights);
 	mWeights = NULL;
 
 	delete mOctree;
@@ -6153,21 +6157,21 @@ void LLVolumeFace::cacheOptimize()
 	
 	//allocate space for new buffer
 	S32 num_verts = mNumVertices;
-	LLVector4a* pos = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
-	LLVector4a* norm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+	LLVector4a* pos = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
+	LLVector4a* norm = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 	S32 size = ((num_verts*sizeof(LLVector2)) + 0xF) & ~0xF;
-	LLVector2* tc = (LLVector2*) ll_aligned_malloc_16(size);
+	LLVector2* tc = (LLVector2*) ll_tagged_malloc_16(sVolumeFaceMemTag, size);
 
 	LLVector4a* wght = NULL;
 	if (mWeights)
 	{
-		wght = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+		wght = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 	}
 
 	LLVector4a* binorm = NULL;
 	if (mBinormals)
 	{
-		binorm = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+		binorm = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 	}
 
 	//allocate mapping of old indices to new indices
@@ -6204,11 +6208,11 @@ void LLVolumeFace::cacheOptimize()
 		mIndices[i] = new_idx[mIndices[i]];
 	}
 	
-	ll_aligned_free_16(mPositions);
-	ll_aligned_free_16(mNormals);
-	ll_aligned_free_16(mTexCoords);
-	ll_aligned_free_16(mWeights);
-	ll_aligned_free_16(mBinormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mPositions);
+	ll_tagged_free_16(sVolumeFaceMemTag, mNormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mTexCoords);
+	ll_tagged_free_16(sVolumeFaceMemTag, mWeights);
+	ll_tagged_free_16(sVolumeFaceMemTag, mBinormals);
 
 	mPositions = pos;
 	mNormals = norm;
@@ -6929,23 +6933,23 @@ void LLVolumeFace::createBinormals()
 
 void LLVolumeFace::resizeVertices(S32 num_verts)
 {
-	ll_aligned_free_16(mPositions);
-	ll_aligned_free_16(mNormals);
-	ll_aligned_free_16(mBinormals);
-	ll_aligned_free_16(mTexCoords);
+	ll_tagged_free_16(sVolumeFaceMemTag, mPositions);
+	ll_tagged_free_16(sVolumeFaceMemTag, mNormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mBinormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mTexCoords);
 
 	mBinormals = NULL;
 
 	if (num_verts)
 	{
-		mPositions = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+		mPositions = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 		assert_aligned(mPositions, 16);
-		mNormals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+		mNormals = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 		assert_aligned(mNormals, 16);
 
 		//pad texture coordinate block end to allow for QWORD reads
 		S32 size = ((num_verts*sizeof(LLVector2)) + 0xF) & ~0xF;
-		mTexCoords = (LLVector2*) ll_aligned_malloc_16(size);
+		mTexCoords = (LLVector2*) ll_tagged_malloc_16(sVolumeFaceMemTag, size);
 		assert_aligned(mTexCoords, 16);
 	}
 	else
@@ -6970,18 +6974,18 @@ void LLVolumeFace::pushVertex(const LLVector4a& pos, const LLVector4a& norm, con
 //	S32 old_size = mNumVertices*16;
 
 	//positions
-	mPositions = (LLVector4a*) realloc(mPositions, new_size);
+	mPositions = (LLVector4a*) ll_tagged_realloc_16(sVolumeFaceMemTag, mPositions, new_size);
 	
 	//normals
-	mNormals = (LLVector4a*) realloc(mNormals, new_size);
+	mNormals = (LLVector4a*) ll_tagged_realloc_16(sVolumeFaceMemTag, mNormals, new_size);
 	
 	//tex coords
 	new_size = ((new_verts*8)+0xF) & ~0xF;
-	mTexCoords = (LLVector2*) realloc(mTexCoords, new_size);
+	mTexCoords = (LLVector2*) ll_tagged_realloc_16(sVolumeFaceMemTag, mTexCoords, new_size);
 	
 
 	//just clear binormals
-	ll_aligned_free_16(mBinormals);
+	ll_tagged_free_16(sVolumeFaceMemTag, mBinormals);
 	mBinormals = NULL;
 
 	mPositions[mNumVertices] = pos;
@@ -6993,26 +6997,26 @@ void LLVolumeFace::pushVertex(const LLVector4a& pos, const LLVector4a& norm, con
 
 void LLVolumeFace::allocateBinormals(S32 num_verts)
 {
-	ll_aligned_free_16(mBinormals);
-	mBinormals = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+	ll_tagged_free_16(sVolumeFaceMemTag, mBinormals);
+	mBinormals = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 }
 
 void LLVolumeFace::allocateWeights(S32 num_verts)
 {
-	ll_aligned_free_16(mWeights);
-	mWeights = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_verts);
+	ll_tagged_free_16(sVolumeFaceMemTag, mWeights);
+	mWeights = (LLVector4a*) ll_tagged_malloc_16(sVolumeFaceMemTag, sizeof(LLVector4a)*num_verts);
 }
 
 void LLVolumeFace::resizeIndices(S32 num_indices)
 {
-	ll_aligned_free_16(mIndices);
+	ll_tagged_free_16(sVolumeFaceMemTag, mIndices);
 	
 	if (num_indices)
 	{
 		//pad index block end to allow for QWORD reads
 		S32 size = ((num_indices*sizeof(U16)) + 0xF) & ~0xF;
 		
-		mIndices = (U16*) ll_aligned_malloc_16(size);
+		mIndices = (U16*) ll_tagged_malloc_16(sVolumeFaceMemTag, size);
 	}
 	else
 	{
@@ -7030,7 +7034,7 @@ void LLVolumeFace::pushIndex(const U16& idx)
 	S32 old_size = ((mNumIndices*2)+0xF) & ~0xF;
 	if (new_size != old_size)
 	{
-		mIndices = (U16*) realloc(mIndices, new_size);
+		mIndices = (U16*) ll_tagged_realloc_16(sVolumeFaceMemTag, mIndices, new_size);
 	}
 	
 	mIndices[mNumIndices++] = idx;
@@ -7071,11 +7075,11 @@ void LLVolumeFace::appendFace(const LLVolumeFace& face, LLMatrix4& mat_in, LLMat
 	}
 
 	//allocate new buffer space
-	mPositions = (LLVector4a*) realloc(mPositions, new_count*sizeof(LLVector4a));
+	mPositions = (LLVector4a*) ll_tagged_realloc_16(sVolumeFaceMemTag, mPositions, new_count*sizeof(LLVector4a));
 	assert_aligned(mPositions, 16);
-	mNormals = (LLVector4a*) realloc(mNormals, new_count*sizeof(LLVector4a));
+	mNormals = (LLVector4a*) ll_tagged_realloc_16(sVolumeFaceMemTag, mNormals, new_count*sizeof(LLVector4a));
 	assert_aligned(mNormals, 16);
-	mTexCoords = (LLVector2*) realloc(mTexCoords, (new_count*sizeof(LLVector2)+0xF) & ~0xF);
+	mTexCoords = (LLVector2*) ll_tagged_realloc_16(sVolumeFaceMemTag, mTexCoords, (new_count*sizeof(LLVector2)+0xF) & ~0xF);
 	assert_aligned(mTexCoords, 16);
 	
 	mNumVertices = new_count;
@@ -7122,7 +7126,7 @@ void LLVolumeFace::appendFace(const LLVolumeFace& face, LLMatrix4& mat_in, LLMat
 	new_count = mNumIndices + face.mNumIndices;
 
 	//allocate new index buffer
-	mIndices = (U16*) realloc(mIndices, (new_count*sizeof(U16)+0xF) & ~0xF);
+	mIndices = (U16*) ll_tagged_realloc_16(sVolumeFaceMemTag, mIndices, (new_count*sizeof(U16)+0xF) & ~0xF);
 	
 	//get destination address into new index buffer
 	U16* dst_idx = mIndices+mNumIndices;
@@ -302,6 +302,10 @@ void LLAssetStorage::_init(LLMessageSystem *msg,
 	mVFS = vfs;
 	mStaticVFS = static_vfs;
 
+	mNumCoalescedDownloads = 0;
+	mNumPromotedDownloads = 0;
+	mCoalescedSecondsSaved = 0.0;
+
 	setUpstream(upstream_host);
 	msg->setHandlerFuncFast(_PREHASH_AssetUploadComplete, processUploadComplete, (void **)this);
 }
@@ -362,7 +366,14 @@ void LLAssetStorage::_cleanupRequests(BOOL all, S32 error)
 						<< LLAssetType::lookup(tmp->getType()) << llendl;
 
 				timed_out.push_front(tmp);
-				iter = requests->erase(curiter);
+				if (RT_DOWNLOAD == rt)
+				{
+					removePendingRequest(RT_DOWNLOAD, tmp);
+				}
+				else
+				{
+					iter = requests->erase(curiter);
+				}
 			}
 		}
 	}
@@ -499,12 +510,13 @@ void LLAssetStorage::getAssetData(const LLUUID uuid, LLAssetType::EType type, LL
 		BOOL duplicate = FALSE;
 		
 		// check to see if there's a pending download of this uuid already
-		for (request_list_t::iterator iter = mPendingDownloads.begin();
-			 iter != mPendingDownloads.end(); ++iter )
+		in_flight_map_t::iterator in_flight = mInFlightDownloads.find(LLAssetKey(uuid, type));
+		if (in_flight != mInFlightDownloads.end())
 		{
-			LLAssetRequest  *tmp = *iter;
-			if ((type == tmp->getType()) && (uuid == tmp->getUUID()))
+			LLInFlightDownload& download = in_flight->second;
+			for (U32 i = 0; i < download.mRequests.size(); ++i)
 			{
+				LLAssetRequest *tmp = *download.mRequests[i];
 				if (callback == tmp->mDownCallback && user_data == tmp->mUserData)
 				{
 					// this is a duplicate from the same subsystem - throw it away
@@ -512,14 +524,17 @@ void LLAssetStorage::getAssetData(const LLUUID uuid, LLAssetType::EType type, LL
 							<< "." << LLAssetType::lookup(type) << llendl;
 					return;
 				}
-				
-				// this is a duplicate request
-				// queue the request, but don't actually ask for it again
-				duplicate = TRUE;
 			}
-		}
-		if (duplicate)
-		{
+
+			// this is a duplicate request
+			// queue the request, but don't actually ask for it again
+			duplicate = TRUE;
+			mNumCoalescedDownloads++;
+			if (is_priority && !download.mIsPriority)
+			{
+				promotePendingDownload(download);
+			}
+
 			llinfos << "Adding additional non-duplicate request for asset " << uuid 
 					<< "." << LLAssetType::lookup(type) << llendl;
 		}
@@ -547,7 +562,7 @@ void LLAssetStorage::_queueDataRequest(const LLUUID& uuid, LLAssetType::EType at
 		req->mUserData = user_data;
 		req->mIsPriority = is_priority;
 	
-		mPendingDownloads.push_back(req);
+		addPendingRequest(RT_DOWNLOAD, req);
 	
 		if (!duplicate)
 		{
@@ -601,26 +616,15 @@ void LLAssetStorage::downloadCompleteCallback(
 		return;
 	}
 
-	// Inefficient since we're doing a find through a list that may have thousands of elements.
-	// This is due for refactoring; we will probably change mPendingDownloads into a set.
-	request_list_t::iterator download_iter = std::find(gAssetStorage->mPendingDownloads.begin(), 
-													   gAssetStorage->mPendingDownloads.end(),
-													   req);
-	// If the LLAssetRequest doesn't exist in the downloads queue, then it either has already been deleted
-	// by _cleanupRequests, or it's a transfer.
-	if (download_iter != gAssetStorage->mPendingDownloads.end())
-	{
-		req->setUUID(file_id);
-		req->setType(file_type);
-	}
-
+	// req itself may already have been deleted by _cleanupRequests, so
+	// go by the ids we were handed rather than the ones in the request.
 	if (LL_ERR_NOERR == result)
 	{
 		// we might have gotten a zero-size file
-		LLVFile vfile(gAssetStorage->mVFS, req->getUUID(), req->getType());
+		LLVFile vfile(gAssetStorage->mVFS, file_id, file_type);
 		if (vfile.getSize() <= 0)
 		{
-			llwarns << "downloadCompleteCallback has non-existent or zero-size asset " << req->getUUID() << llendl;
+			llwarns << "downloadCompleteCallback has non-existent or zero-size asset " << file_id << llendl;
 			
 			result = LL_ERR_ASSET_REQUEST_NOT_IN_DATABASE;
 			vfile.remove();
@@ -631,16 +635,22 @@ void LLAssetStorage::downloadCompleteCallback(
 	// SJB: We process the callbacks in reverse order, I do not know if this is important,
 	//      but I didn't want to mess with it.
 	request_list_t requests;
-	for (request_list_t::iterator iter = gAssetStorage->mPendingDownloads.begin();
-		 iter != gAssetStorage->mPendingDownloads.end();  )
+	in_flight_map_t::iterator in_flight = gAssetStorage->mInFlightDownloads.find(LLAssetKey(file_id, file_type));
+	if (in_flight != gAssetStorage->mInFlightDownloads.end())
 	{
-		request_list_t::iterator curiter = iter++;
-		LLAssetRequest* tmp = *curiter;
-		if ((tmp->getUUID() == file_id) && (tmp->getType()== file_type))
+		LLInFlightDownload& download = in_flight->second;
+		for (U32 i = 0; i < download.mRequests.size(); ++i)
 		{
+			LLAssetRequest* tmp = *download.mRequests[i];
+			if (i > 0 && LL_ERR_NOERR == result)
+			{
+				// Asking for it on its own would have taken this much longer.
+				gAssetStorage->mCoalescedSecondsSaved += llmax(tmp->mTime - download.mStartTime, 0.0);
+			}
 			requests.push_front(tmp);
-			iter = gAssetStorage->mPendingDownloads.erase(curiter);
+			gAssetStorage->mPendingDownloads.erase(download.mRequests[i]);
 		}
+		gAssetStorage->mInFlightDownloads.erase(in_flight);
 	}
 	for (request_list_t::iterator iter = requests.begin();
 		 iter != requests.end();  )
@@ -649,7 +659,7 @@ void LLAssetStorage::downloadCompleteCallback(
 		LLAssetRequest* tmp = *curiter;
 		if (tmp->mDownCallback)
 		{
-			tmp->mDownCallback(gAssetStorage->mVFS, req->getUUID(), req->getType(), tmp->mUserData, result, ext_status);
+			tmp->mDownCallback(gAssetStorage->mVFS, file_id, file_type, tmp->mUserData, result, ext_status);
 		}
 		delete tmp;
 	}
@@ -1076,6 +1086,95 @@ S32 LLAssetStorage::getNumPending(LLAssetStorage::ERequestType rt) const
 	return num_pending;
 }
 
+void LLAssetStorage::addPendingRequest(LLAssetStorage::ERequestType rt, LLAssetRequest* req, bool at_front)
+{
+	request_list_t* requests = getRequestList(rt);
+	if (!requests)
+	{
+		return;
+	}
+
+	request_list_t::iterator iter = requests->insert(at_front ? requests->begin() : requests->end(), req);
+	if (RT_DOWNLOAD == rt)
+	{
+		LLInFlightDownload& download = mInFlightDownloads[LLAssetKey(req->getUUID(), req->getType())];
+		if (download.mRequests.empty())
+		{
+			download.mStartTime = req->mTime;
+		}
+		download.mIsPriority = download.mIsPriority || req->mIsPriority;
+		download.mRequests.push_back(iter);
+	}
+}
+
+bool LLAssetStorage::removePendingRequest(LLAssetStorage::ERequestType rt, LLAssetRequest* req)
+{
+	request_list_t* requests = getRequestList(rt);
+	if (!requests)
+	{
+		return false;
+	}
+
+	if (RT_DOWNLOAD != rt)
+	{
+		request_list_t::iterator iter = std::find(requests->begin(), requests->end(), req);
+		if (iter == requests->end())
+		{
+			return false;
+		}
+		requests->erase(iter);
+		return true;
+	}
+
+	in_flight_map_t::iterator in_flight = mInFlightDownloads.find(LLAssetKey(req->getUUID(), req->getType()));
+	if (in_flight == mInFlightDownloads.end())
+	{
+		return false;
+	}
+	std::vector<request_list_t::iterator>& waiting = in_flight->second.mRequests;
+	for (U32 i = 0; i < waiting.size(); ++i)
+	{
+		if (*waiting[i] == req)
+		{
+			requests->erase(waiting[i]);
+			waiting.erase(waiting.begin() + i);
+			if (waiting.empty())
+			{
+				mInFlightDownloads.erase(in_flight);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+// A more urgent request joined a download that is already in flight.
+// Storages that work through mPendingDownloads in order pick it up
+// sooner from the front of the list.  Once a transfer has been requested
+// upstream its priority can't be changed any more.
+void LLAssetStorage::promotePendingDownload(LLInFlightDownload& download)
+{
+	download.mIsPriority = TRUE;
+	mNumPromotedDownloads++;
+
+	// Splicing leaves the iterators in the index valid.
+	for (S32 i = (S32)download.mRequests.size() - 1; i >= 0; --i)
+	{
+		(*download.mRequests[i])->mIsPriority = TRUE;
+		mPendingDownloads.splice(mPendingDownloads.begin(), mPendingDownloads, download.mRequests[i]);
+	}
+}
+
+LLSD LLAssetStorage::getCoalescingStats() const
+{
+	LLSD sd;
+	sd["in_flight"] = (S32)mInFlightDownloads.size();
+	sd["coalesced"] = (S32)mNumCoalescedDownloads;
+	sd["promoted"] = (S32)mNumPromotedDownloads;
+	sd["seconds_saved"] = mCoalescedSecondsSaved;
+	return sd;
+}
+
 S32 LLAssetStorage::getNumPendingDownloads() const
 {
 	return getNumPending(RT_DOWNLOAD);
@@ -1228,7 +1327,14 @@ bool LLAssetStorage::deletePendingRequestImpl(LLAssetStorage::request_list_t* re
 	if (req)
 	{
 		// Remove the request from this list.
-		requests->remove(req);
+		if (requests == &mPendingDownloads)
+		{
+			removePendingRequest(RT_DOWNLOAD, req);
+		}
+		else
+		{
+			requests->remove(req);
+		}
 		S32 error = LL_ERR_TCP_TIMEOUT;
 		// Run callbacks.
 		if (req->mUpCallback)
@@ -29,6 +29,8 @@
 #define LL_LLASSETSTORAGE_H
 
 #include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
 
 #include "lluuid.h"
 #include "lltimer.h"
@@ -236,6 +238,38 @@ protected:
 	request_list_t mPendingDownloads;
 	request_list_t mPendingUploads;
 	request_list_t mPendingLocalUploads;
+
+	// Index of mPendingDownloads by asset, so that joining a download
+	// already in flight and calling back everybody waiting on it when it
+	// completes don't have to walk the whole list.  Only change
+	// mPendingDownloads through addPendingRequest() and
+	// removePendingRequest() to keep the two in step.
+	struct LLAssetKey
+	{
+		LLAssetKey(const LLUUID& uuid, LLAssetType::EType type) : mUUID(uuid), mType(type) {}
+		bool operator==(const LLAssetKey& rhs) const { return mType == rhs.mType && mUUID == rhs.mUUID; }
+
+		LLUUID mUUID;
+		LLAssetType::EType mType;
+	};
+	struct LLAssetKeyHash
+	{
+		size_t operator()(const LLAssetKey& key) const { return hash_value(key.mUUID) ^ (size_t)key.mType; }
+	};
+	struct LLInFlightDownload
+	{
+		LLInFlightDownload() : mStartTime(0.0), mIsPriority(FALSE) {}
+
+		std::vector<request_list_t::iterator> mRequests;	// in the order they were made
+		F64 mStartTime;		// when the first request was made
+		BOOL mIsPriority;
+	};
+	typedef boost::unordered_map<LLAssetKey, LLInFlightDownload, LLAssetKeyHash> in_flight_map_t;
+	in_flight_map_t mInFlightDownloads;
+
+	U32 mNumCoalescedDownloads;		// requests that joined a download already in flight
+	U32 mNumPromotedDownloads;		// downloads a priority request joined after they started
+	F64 mCoalescedSecondsSaved;		// head start coalesced requests got, summed over successful downloads
 	
 	// Map of toxic assets - these caused problems when recently rezzed, so avoid them
 	toxic_asset_map_t	mToxicAssetMap;		// Objects in this list are known to cause problems and are not loaded
@@ -342,6 +376,9 @@ public:
 	S32 getNumPendingLocalUploads();
 	S32 getNumPending(ERequestType rt) const;
 
+	// Counters for downloads shared between requests for the same asset.
+	LLSD getCoalescingStats() const;
+
 	virtual LLSD getPendingDetails(ERequestType rt,
 	 				LLAssetType::EType asset_type,
 	 				const std::string& detail_prefix) const;
@@ -428,6 +465,10 @@ public:
 	// add extra methods to handle metadata
 
 protected:
+	void addPendingRequest(ERequestType rt, LLAssetRequest* req, bool at_front = false);
+	bool removePendingRequest(ERequestType rt, LLAssetRequest* req);
+	void promotePendingDownload(LLInFlightDownload& download);
+
 	void _cleanupRequests(BOOL all, S32 error);
 	void _callUploadCallbacks(const LLUUID &uuid, const LLAssetType::EType asset_type, BOOL success, LLExtStat ext_status);
 
@@ -35,6 +35,7 @@
 #include "llsdserialize.h"
 
 #include <boost/tokenizer.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <map>
 #include <set>
@@ -63,20 +64,48 @@ namespace LLAvatarNameCache
 
 	// agent IDs that have been requested, but with no reply
 	// maps agent ID to frame time request was made
-	typedef std::map<LLUUID, F64> pending_queue_t;
+	typedef boost::unordered_map<LLUUID, F64> pending_queue_t;
 	pending_queue_t sPendingQueue;
 
 	// Callbacks to fire when we received a name.
 	// May have multiple callbacks for a single ID, which are
 	// represented as multiple slots bound to the signal.
 	// Avoid copying signals via pointers.
-	typedef std::map<LLUUID, callback_signal_t*> signal_map_t;
+	typedef boost::unordered_map<LLUUID, callback_signal_t*> signal_map_t;
 	signal_map_t sSignalMap;
 
+	// Callers of the batch get(), waiting on a whole list of names.
+	struct BatchRequest
+	{
+		std::vector<LLUUID> mAgentIDs;
+		std::vector<LLAvatarName> mAvatarNames;
+		S32 mNumRemaining;
+		batch_callback_signal_t mSignal;
+	};
+	// maps each agent ID still missing to the batch and its slot in it
+	typedef boost::unordered_multimap<LLUUID, std::pair<BatchRequest*, U32> > batch_waiter_map_t;
+	batch_waiter_map_t sBatchWaiters;
+
+	// Names that arrived since the last idle(), delivered all at once
+	struct ResolvedName
+	{
+		LLUUID mAgentID;
+		LLAvatarName mAvatarName;
+		bool mAddToCache;
+	};
+	typedef std::vector<ResolvedName> resolved_queue_t;
+	resolved_queue_t sResolvedQueue;
+
 	// names we know about
-	typedef std::map<LLUUID, LLAvatarName> cache_t;
+	typedef boost::unordered_map<LLUUID, LLAvatarName> cache_t;
 	cache_t sCache;
 
+	// Lookups in flight against the name service.  Further asks wait in
+	// sAskQueue so that asking for thousands of names at once doesn't
+	// flood the service with requests.
+	S32 sHTTPRequestsInFlight = 0;
+	const S32 MAX_HTTP_REQUESTS_IN_FLIGHT = 4;
+
 	// Send bulk lookup requests a few times a second at most
 	// only need per-frame timing resolution
 	LLFrameTimer sRequestTimer;
@@ -93,11 +122,14 @@ namespace LLAvatarNameCache
 
 	// Handle name response off network.
 	// Optionally skip adding to cache, used when this is a fallback to the
-	// legacy name system.
+	// legacy name system.  The name is delivered on the next idle().
 	void processName(const LLUUID& agent_id,
 					 const LLAvatarName& av_name,
 					 bool add_to_cache);
 
+	// Cache and signal everything in sResolvedQueue
+	void deliverResolvedNames();
+
 	void requestNamesViaCapability();
 
 	// Legacy name system callback
@@ -116,6 +148,10 @@ namespace LLAvatarNameCache
 	void fireSignal(const LLUUID& agent_id,
 					const callback_slot_t& slot,
 					const LLAvatarName& av_name);
+
+	// Fills in av_name if we have an unexpired name for the agent,
+	// otherwise queues a request for it and returns false
+	bool getOrRequest(const LLUUID& agent_id, LLAvatarName* av_name);
 	
 	// Is a request in-flight over the network?
 	bool isRequestPending(const LLUUID& agent_id);
@@ -179,7 +215,14 @@ public:
 	LLAvatarNameResponder(const std::vector<LLUUID>& agent_ids)
 	:	mAgentIDs(agent_ids),
 		mHeaders()
-	{ }
+	{
+		LLAvatarNameCache::sHTTPRequestsInFlight++;
+	}
+
+	~LLAvatarNameResponder()
+	{
+		LLAvatarNameCache::sHTTPRequestsInFlight--;
+	}
 	
 	/*virtual*/ void completedHeader(U32 status, const std::string& reason, 
 		const LLSD& headers)
@@ -269,7 +312,7 @@ public:
 // Provide some fallback for agents that return errors
 void LLAvatarNameCache::handleAgentError(const LLUUID& agent_id)
 {
-	std::map<LLUUID,LLAvatarName>::iterator existing = sCache.find(agent_id);
+	cache_t::iterator existing = sCache.find(agent_id);
 	if (existing == sCache.end())
     {
         // there is no existing cache entry, so make a temporary name from legacy
@@ -281,13 +324,12 @@ void LLAvatarNameCache::handleAgentError(const LLUUID& agent_id)
     }
 	else
     {
-        // we have a chached (but probably expired) entry - since that would have
-        // been returned by the get method, there is no need to signal anyone
-
-        // Clear this agent from the pending list
-        LLAvatarNameCache::sPendingQueue.erase(agent_id);
-
+        // we have a cached (but probably expired) entry - get() only returns
+        // fresh names, so whoever asked for this one is still waiting on it.
+        // Hand them the old name, which also clears the pending request.
         const LLAvatarName& av_name = existing->second;
+        LLAvatarNameCache::processName(agent_id, av_name, false);
+
         LL_DEBUGS("AvNameCache") << "LLAvatarNameCache use cache for agent "
                                  << agent_id 
                                  << "user '" << av_name.mUsername << "' "
@@ -301,24 +343,72 @@ void LLAvatarNameCache::processName(const LLUUID& agent_id,
 									const LLAvatarName& av_name,
 									bool add_to_cache)
 {
-	if (add_to_cache)
+	ResolvedName resolved;
+	resolved.mAgentID = agent_id;
+	resolved.mAvatarName = av_name;
+	resolved.mAddToCache = add_to_cache;
+	sResolvedQueue.push_back(resolved);
+}
+
+void LLAvatarNameCache::deliverResolvedNames()
+{
+	if (sResolvedQueue.empty())
 	{
-		sCache[agent_id] = av_name;
+		return;
 	}
 
-	sPendingQueue.erase(agent_id);
+	// Callbacks may ask for more names, which can land in the queue
+	resolved_queue_t resolved;
+	resolved.swap(sResolvedQueue);
 
-	// signal everyone waiting on this name
-	signal_map_t::iterator sig_it =	sSignalMap.find(agent_id);
-	if (sig_it != sSignalMap.end())
+	// Cache the whole lot first so callbacks see every name that came in
+	for (resolved_queue_t::const_iterator it = resolved.begin(); it != resolved.end(); ++it)
 	{
-		callback_signal_t* signal = sig_it->second;
-		(*signal)(agent_id, av_name);
+		if (it->mAddToCache)
+		{
+			sCache[it->mAgentID] = it->mAvatarName;
+		}
+		sPendingQueue.erase(it->mAgentID);
+	}
+
+	std::vector<BatchRequest*> completed;
+	for (resolved_queue_t::const_iterator it = resolved.begin(); it != resolved.end(); ++it)
+	{
+		const LLUUID& agent_id = it->mAgentID;
+		const LLAvatarName& av_name = it->mAvatarName;
+
+		// signal everyone waiting on this name
+		signal_map_t::iterator sig_it =	sSignalMap.find(agent_id);
+		if (sig_it != sSignalMap.end())
+		{
+			callback_signal_t* signal = sig_it->second;
+			sSignalMap.erase(sig_it);
+
+			(*signal)(agent_id, av_name);
+
+			delete signal;
+			signal = NULL;
+		}
 
-		sSignalMap.erase(agent_id);
+		std::pair<batch_waiter_map_t::iterator, batch_waiter_map_t::iterator> waiters =
+			sBatchWaiters.equal_range(agent_id);
+		for (batch_waiter_map_t::iterator wait_it = waiters.first; wait_it != waiters.second; ++wait_it)
+		{
+			BatchRequest* batch = wait_it->second.first;
+			batch->mAvatarNames[wait_it->second.second] = av_name;
+			if (--batch->mNumRemaining == 0)
+			{
+				completed.push_back(batch);
+			}
+		}
+		sBatchWaiters.erase(waiters.first, waiters.second);
+	}
 
-		delete signal;
-		signal = NULL;
+	for (std::vector<BatchRequest*>::iterator it = completed.begin(); it != completed.end(); ++it)
+	{
+		BatchRequest* batch = *it;
+		batch->mSignal(batch->mAgentIDs, batch->mAvatarNames);
+		delete batch;
 	}
 }
 
@@ -339,9 +429,15 @@ void LLAvatarNameCache::requestNamesViaCapability()
 	agent_ids.reserve(128);
 	
 	U32 ids = 0;
-	ask_queue_t::const_iterator it = sAskQueue.begin();
+	ask_queue_t::iterator it = sAskQueue.begin();
 	for ( ; it != sAskQueue.end(); ++it)
 	{
+		if (url.empty() && sHTTPRequestsInFlight >= MAX_HTTP_REQUESTS_IN_FLIGHT)
+		{
+			// ...leave the rest for a later frame
+			break;
+		}
+
 		const LLUUID& agent_id = *it;
 
 		if (url.empty())
@@ -384,8 +480,8 @@ void LLAvatarNameCache::requestNamesViaCapability()
 		agent_ids.clear();
 	}
 
-	// We've moved all asks to the pending request queue
-	sAskQueue.clear();
+	// We've moved the asks we sent to the pending request queue
+	sAskQueue.erase(sAskQueue.begin(), it);
 }
 
 void LLAvatarNameCache::legacyNameCallback(const LLUUID& agent_id,
@@ -440,6 +536,21 @@ void LLAvatarNameCache::initClass(bool running)
 
 void LLAvatarNameCache::cleanupClass()
 {
+	for (signal_map_t::iterator it = sSignalMap.begin(); it != sSignalMap.end(); ++it)
+	{
+		delete it->second;
+	}
+	sSignalMap.clear();
+
+	// A batch waits on each of its missing names, only delete it once
+	std::set<BatchRequest*> batches;
+	for (batch_waiter_map_t::iterator it = sBatchWaiters.begin(); it != sBatchWaiters.end(); ++it)
+	{
+		batches.insert(it->second.first);
+	}
+	for_each(batches.begin(), batches.end(), DeletePointer());
+	sBatchWaiters.clear();
+	sResolvedQueue.clear();
 }
 
 void LLAvatarNameCache::importFile(std::istream& istr)
@@ -489,6 +600,160 @@ void LLAvatarNameCache::exportFile(std::ostream& ostr)
 	LLSDSerialize::toPrettyXML(data, ostr);
 }
 
+// Binary cache layout, all in native byte order since the file never
+// leaves the machine:
+//   U32 magic, U32 version, U32 count
+//   count records of
+//     U8[16] agent id, F64 expires, F64 next update, U8 is display name default,
+//     then username, display name, legacy first and legacy last name,
+//     each as a U16 length followed by that many bytes
+const U32 BINARY_CACHE_MAGIC = 0x434e4e41;	// "ANNC"
+const U32 BINARY_CACHE_VERSION = 1;
+
+namespace
+{
+	template <typename T>
+	void append_binary(std::string& buffer, const T& value)
+	{
+		buffer.append((const char*)&value, sizeof(T));
+	}
+
+	void append_binary_string(std::string& buffer, const std::string& str)
+	{
+		U16 length = (U16)llmin(str.size(), (size_t)U16_MAX);
+		append_binary(buffer, length);
+		buffer.append(str.data(), length);
+	}
+
+	// Reads fields out of a buffer, failing rather than running off the end
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const std::string& buffer)
+		:	mPos(buffer.data()),
+			mEnd(buffer.data() + buffer.size())
+		{ }
+
+		template <typename T>
+		bool read(T& value)
+		{
+			if ((size_t)(mEnd - mPos) < sizeof(T)) return false;
+			memcpy(&value, mPos, sizeof(T));
+			mPos += sizeof(T);
+			return true;
+		}
+
+		bool readString(std::string& str)
+		{
+			U16 length = 0;
+			if (!read(length) || (size_t)(mEnd - mPos) < length) return false;
+			str.assign(mPos, length);
+			mPos += length;
+			return true;
+		}
+
+		size_t remaining() const	{ return mEnd - mPos; }
+
+	private:
+		const char* mPos;
+		const char* mEnd;
+	};
+}
+
+bool LLAvatarNameCache::importBinaryFile(std::istream& istr)
+{
+	// Read the whole file with one call and parse it from memory
+	istr.seekg(0, std::ios::end);
+	std::streamoff size = istr.tellg();
+	istr.seekg(0, std::ios::beg);
+	if (size <= 0 || !istr.good()) return false;
+
+	std::string buffer((size_t)size, '\0');
+	istr.read(&buffer[0], size);
+	if (istr.gcount() != size) return false;
+
+	BinaryReader reader(buffer);
+	U32 magic = 0, version = 0, count = 0;
+	if (!reader.read(magic) || magic != BINARY_CACHE_MAGIC
+		|| !reader.read(version) || version != BINARY_CACHE_VERSION
+		|| !reader.read(count))
+	{
+		LL_WARNS("AvNameCache") << "not a binary name cache" << LL_ENDL;
+		return false;
+	}
+
+	// Don't size the table from a count the rest of the file can't hold
+	const size_t MIN_RECORD_SIZE = UUID_BYTES + sizeof(F64) * 2 + sizeof(U8) + sizeof(U16) * 4;
+	if (count > reader.remaining() / MIN_RECORD_SIZE)
+	{
+		LL_WARNS("AvNameCache") << "binary name cache claims " << count
+								<< " names, more than it can hold, ignoring it" << LL_ENDL;
+		return false;
+	}
+
+	std::vector<std::pair<LLUUID, LLAvatarName> > names(count);
+	for (U32 i = 0; i < count; ++i)
+	{
+		LLUUID& agent_id = names[i].first;
+		LLAvatarName& av_name = names[i].second;
+		U8 is_default = 0;
+		if (!reader.read(agent_id.mData)
+			|| !reader.read(av_name.mExpires)
+			|| !reader.read(av_name.mNextUpdate)
+			|| !reader.read(is_default)
+			|| !reader.readString(av_name.mUsername)
+			|| !reader.readString(av_name.mDisplayName)
+			|| !reader.readString(av_name.mLegacyFirstName)
+			|| !reader.readString(av_name.mLegacyLastName))
+		{
+			LL_WARNS("AvNameCache") << "truncated binary name cache, ignoring it" << LL_ENDL;
+			return false;
+		}
+		av_name.mIsDisplayNameDefault = (is_default != 0);
+	}
+
+	for (U32 i = 0; i < count; ++i)
+	{
+		sCache[names[i].first] = names[i].second;
+	}
+	LL_INFOS("AvNameCache") << "loaded " << sCache.size() << LL_ENDL;
+	return true;
+}
+
+void LLAvatarNameCache::exportBinaryFile(std::ostream& ostr)
+{
+	F64 max_unrefreshed = LLFrameTimer::getTotalSeconds() - MAX_UNREFRESHED_TIME;
+
+	std::string buffer;
+	buffer.reserve(sCache.size() * 96);
+	append_binary(buffer, BINARY_CACHE_MAGIC);
+	append_binary(buffer, BINARY_CACHE_VERSION);
+	append_binary(buffer, (U32)0);	// count, filled in below
+
+	U32 count = 0;
+	for (cache_t::const_iterator it = sCache.begin(); it != sCache.end(); ++it)
+	{
+		const LLAvatarName& av_name = it->second;
+		// Do not write temporary or expired entries to the stored cache
+		if (av_name.mIsTemporaryName || av_name.mExpires < max_unrefreshed)
+		{
+			continue;
+		}
+		buffer.append((const char*)it->first.mData, UUID_BYTES);
+		append_binary(buffer, av_name.mExpires);
+		append_binary(buffer, av_name.mNextUpdate);
+		append_binary(buffer, (U8)(av_name.mIsDisplayNameDefault ? 1 : 0));
+		append_binary_string(buffer, av_name.mUsername);
+		append_binary_string(buffer, av_name.mDisplayName);
+		append_binary_string(buffer, av_name.mLegacyFirstName);
+		append_binary_string(buffer, av_name.mLegacyLastName);
+		count++;
+	}
+	memcpy(&buffer[2 * sizeof(U32)], &count, sizeof(U32));
+
+	ostr.write(buffer.data(), buffer.size());
+}
+
 void LLAvatarNameCache::setNameLookupURL(const std::string& name_lookup_url)
 {
 	sNameLookupURL = name_lookup_url;
@@ -513,6 +778,9 @@ void LLAvatarNameCache::idle()
 	//	return;
 	//}
 
+	// Hand out everything that arrived since last frame in one go
+	deliverResolvedNames();
+
 	if (!sAskQueue.empty())
 	{
         if (useDisplayNames())
@@ -599,7 +867,7 @@ bool LLAvatarNameCache::get(const LLUUID& agent_id, LLAvatarName *av_name)
 		if (useDisplayNames())
 		{
 			// ...use display names cache
-			std::map<LLUUID,LLAvatarName>::iterator it = sCache.find(agent_id);
+			cache_t::iterator it = sCache.find(agent_id);
 			if (it != sCache.end())
 			{
 				*av_name = it->second;
@@ -651,7 +919,7 @@ void LLAvatarNameCache::fireSignal(const LLUUID& agent_id,
 	signal(agent_id, av_name);
 }
 
-void LLAvatarNameCache::get(const LLUUID& agent_id, callback_slot_t slot)
+bool LLAvatarNameCache::getOrRequest(const LLUUID& agent_id, LLAvatarName* av_name)
 {
 	if (sRunning)
 	{
@@ -659,16 +927,14 @@ void LLAvatarNameCache::get(const LLUUID& agent_id, callback_slot_t slot)
 		if (useDisplayNames())
 		{
 			// ...use new cache
-			std::map<LLUUID,LLAvatarName>::iterator it = sCache.find(agent_id);
+			cache_t::iterator it = sCache.find(agent_id);
 			if (it != sCache.end())
 			{
-				const LLAvatarName& av_name = it->second;
-				
-				if (av_name.mExpires > LLFrameTimer::getTotalSeconds())
+				if (it->second.mExpires > LLFrameTimer::getTotalSeconds())
 				{
-					// ...name already exists in cache, fire callback now
-					fireSignal(agent_id, slot, av_name);
-					return;
+					// ...name already exists in cache
+					*av_name = it->second;
+					return true;
 				}
 			}
 		}
@@ -678,10 +944,8 @@ void LLAvatarNameCache::get(const LLUUID& agent_id, callback_slot_t slot)
 			std::string full_name;
 			if (gCacheName->getFullName(agent_id, full_name))
 			{
-				LLAvatarName av_name;
-				buildLegacyName(full_name, &av_name);
-				fireSignal(agent_id, slot, av_name);
-				return;
+				buildLegacyName(full_name, av_name);
+				return true;
 			}
 		}
 	}
@@ -691,6 +955,18 @@ void LLAvatarNameCache::get(const LLUUID& agent_id, callback_slot_t slot)
 	{
 		sAskQueue.insert(agent_id);
 	}
+	return false;
+}
+
+void LLAvatarNameCache::get(const LLUUID& agent_id, callback_slot_t slot)
+{
+	LLAvatarName av_name;
+	if (getOrRequest(agent_id, &av_name))
+	{
+		// ...name already known, fire callback now
+		fireSignal(agent_id, slot, av_name);
+		return;
+	}
 
 	// always store additional callback, even if request is pending
 	signal_map_t::iterator sig_it = sSignalMap.find(agent_id);
@@ -709,6 +985,32 @@ void LLAvatarNameCache::get(const LLUUID& agent_id, callback_slot_t slot)
 	}
 }
 
+void LLAvatarNameCache::get(const std::vector<LLUUID>& agent_ids, batch_callback_slot_t slot)
+{
+	BatchRequest* batch = new BatchRequest;
+	batch->mAgentIDs = agent_ids;
+	batch->mAvatarNames.resize(agent_ids.size());
+	batch->mNumRemaining = 0;
+	batch->mSignal.connect(slot);
+
+	for (U32 i = 0; i < agent_ids.size(); ++i)
+	{
+		const LLUUID& agent_id = agent_ids[i];
+		if (!getOrRequest(agent_id, &batch->mAvatarNames[i]))
+		{
+			sBatchWaiters.insert(std::make_pair(agent_id, std::make_pair(batch, i)));
+			batch->mNumRemaining++;
+		}
+	}
+
+	if (batch->mNumRemaining == 0)
+	{
+		// ...everything was in cache
+		batch->mSignal(batch->mAgentIDs, batch->mAvatarNames);
+		delete batch;
+	}
+}
+
 
 void LLAvatarNameCache::setUseDisplayNames(bool use)
 {
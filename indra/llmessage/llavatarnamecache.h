@@ -31,6 +31,7 @@
 #include "llavatarname.h"	// for convenience
 
 #include <boost/signals2.hpp>
+#include <vector>
 
 class LLSD;
 class LLUUID;
@@ -49,6 +50,11 @@ namespace LLAvatarNameCache
 	void importFile(std::istream& istr);
 	void exportFile(std::ostream& ostr);
 
+	// Compact binary form of the above, much faster to load at startup.
+	// Returns false if the stream doesn't hold a valid cache.
+	bool importBinaryFile(std::istream& istr);
+	void exportBinaryFile(std::ostream& ostr);
+
 	// On the viewer, usually a simulator capabilitity
 	// If empty, name cache will fall back to using legacy name
 	// lookup system
@@ -59,7 +65,8 @@ namespace LLAvatarNameCache
 	bool hasNameLookupURL();
 	
 	// Periodically makes a batch request for display names not already in
-	// cache.  Call once per frame.
+	// cache, and delivers the names that arrived since the last call.
+	// Call once per frame.
 	void idle();
 
 	// If name is in cache, returns true and fills in provided LLAvatarName
@@ -76,6 +83,18 @@ namespace LLAvatarNameCache
 	// If name information is in cache, callback will be called immediately.
 	void get(const LLUUID& agent_id, callback_slot_t slot);
 
+	// Callback types for the batch get() below, names are in the same
+	// order as the agent ids that were asked for.
+	typedef boost::signals2::signal<
+		void (const std::vector<LLUUID>& agent_ids, const std::vector<LLAvatarName>& av_names)>
+			batch_callback_signal_t;
+	typedef batch_callback_signal_t::slot_type batch_callback_slot_t;
+
+	// Fetches name information for all of agent_ids and calls callback
+	// once, when the last of them has arrived.  Use this rather than one
+	// get() per agent when filling lists of people.
+	void get(const std::vector<LLUUID>& agent_ids, batch_callback_slot_t slot);
+
 	// Allow display names to be explicitly disabled for testing.
 	void setUseDisplayNames(bool use);
 	bool useDisplayNames();
@@ -55,6 +55,11 @@ const U32 PENDING_TIMEOUT_SECS = 5 * 60;
 // File version number
 const S32 CN_FILE_VERSION = 2;
 
+// Most request messages sent upstream per call to processPending().  Asks
+// beyond that wait for the next call, so that a big group roster doesn't
+// go out as one burst of reliable packets.
+const S32 MAX_REQUEST_MESSAGES_PER_PROCESS = 8;
+
 // Globals
 LLCacheName* gCacheName = NULL;
 std::map<std::string, std::string> LLCacheName::sCacheName;
@@ -101,9 +106,6 @@ public:
 	{
 		return mSignal.connect(cb);
 	}
-	
-	void done()			{ mID.setNull(); }
-	bool isDone() const	{ return mID.isNull() != FALSE; }
 };
 
 class ReplySender
@@ -186,7 +188,7 @@ void ReplySender::flush()
 
 
 typedef std::set<LLUUID>					AskQueue;
-typedef std::list<PendingReply*>			ReplyQueue;
+typedef std::multimap<LLUUID, PendingReply*> ReplyQueue;
 typedef std::map<LLUUID,U32>				PendingQueue;
 typedef std::map<LLUUID, LLCacheNameEntry*> Cache;
 typedef std::map<std::string, LLUUID> 		ReverseCache;
@@ -212,6 +214,10 @@ public:
 	ReplyQueue			mReplyQueue;
 		// requests awaiting replies from us
 
+	std::vector<LLUUID>	mRepliedIDs;
+		// UUIDs with requests waiting on them that got a reply since
+		// processPendingReplies() last ran
+
 	LLCacheNameSignal	mSignal;
 
 	LLFrameTimer		mProcessTimer;
@@ -226,7 +232,7 @@ public:
 	
 	void processPendingAsks();
 	void processPendingReplies();
-	void sendRequest(const char* msg_name, const AskQueue& queue);
+	void sendRequest(const char* msg_name, AskQueue& queue, S32& messages_left);
 	bool isRequestPending(const LLUUID& id);
 
 	// Message system callbacks.
@@ -279,21 +285,21 @@ LLCacheName::Impl::Impl(LLMessageSystem* msg)
 LLCacheName::Impl::~Impl()
 {
 	for_each(mCache.begin(), mCache.end(), DeletePairedPointer());
-	for_each(mReplyQueue.begin(), mReplyQueue.end(), DeletePointer());
+	for_each(mReplyQueue.begin(), mReplyQueue.end(), DeletePairedPointer());
 }
 
 boost::signals2::connection LLCacheName::Impl::addPending(const LLUUID& id, const LLCacheNameCallback& callback)
 {
 	PendingReply* reply = new PendingReply(id, LLHost());
 	boost::signals2::connection res = reply->setCallback(callback);
-	mReplyQueue.push_back(reply);
+	mReplyQueue.insert(std::make_pair(id, reply));
 	return res;
 }
 
 void LLCacheName::Impl::addPending(const LLUUID& id, const LLHost& host)
 {
 	PendingReply* reply = new PendingReply(id, host);
-	mReplyQueue.push_back(reply);
+	mReplyQueue.insert(std::make_pair(id, reply));
 }
 
 void LLCacheName::setUpstream(const LLHost& upstream_host)
@@ -770,17 +776,40 @@ std::string LLCacheName::getDefaultLastName()
 void LLCacheName::Impl::processPendingAsks()
 {
 	LLMemType mt_ppa(LLMemType::MTYPE_CACHE_PROCESS_PENDING_ASKS);
-	sendRequest(_PREHASH_UUIDNameRequest, mAskNameQueue);
-	sendRequest(_PREHASH_UUIDGroupNameRequest, mAskGroupQueue);
-	mAskNameQueue.clear();
-	mAskGroupQueue.clear();
+	S32 messages_left = MAX_REQUEST_MESSAGES_PER_PROCESS;
+	sendRequest(_PREHASH_UUIDNameRequest, mAskNameQueue, messages_left);
+	sendRequest(_PREHASH_UUIDGroupNameRequest, mAskGroupQueue, messages_left);
 }
 
 void LLCacheName::Impl::processPendingReplies()
 {
 	LLMemType mt_ppr(LLMemType::MTYPE_CACHE_PROCESS_PENDING_REPLIES);
+	if (mRepliedIDs.empty())
+	{
+		return;
+	}
+
+	// Only the requests waiting on names that came in need looking at,
+	// take them all out of the queue in one pass.
+	std::sort(mRepliedIDs.begin(), mRepliedIDs.end());
+	mRepliedIDs.erase(std::unique(mRepliedIDs.begin(), mRepliedIDs.end()), mRepliedIDs.end());
+
+	std::vector<PendingReply*> replies;
+	for (std::vector<LLUUID>::iterator id_it = mRepliedIDs.begin(); id_it != mRepliedIDs.end(); ++id_it)
+	{
+		if (!get_ptr_in_map(mCache, *id_it)) continue;
+
+		std::pair<ReplyQueue::iterator, ReplyQueue::iterator> range = mReplyQueue.equal_range(*id_it);
+		for (ReplyQueue::iterator it = range.first; it != range.second; ++it)
+		{
+			replies.push_back(it->second);
+		}
+		mReplyQueue.erase(range.first, range.second);
+	}
+	mRepliedIDs.clear();
+
 	// First call all the callbacks, because they might send messages.
-	for(ReplyQueue::iterator it = mReplyQueue.begin(); it != mReplyQueue.end(); ++it)
+	for(std::vector<PendingReply*>::iterator it = replies.begin(); it != replies.end(); ++it)
 	{
 		PendingReply* reply = *it;
 		LLCacheNameEntry* entry = get_ptr_in_map(mCache, reply->mID);
@@ -800,36 +829,23 @@ void LLCacheName::Impl::processPendingReplies()
 
 	// Forward on all replies, if needed.
 	ReplySender sender(mMsg);
-	for(ReplyQueue::iterator it = mReplyQueue.begin(); it != mReplyQueue.end(); ++it)
+	for(std::vector<PendingReply*>::iterator it = replies.begin(); it != replies.end(); ++it)
 	{
 		PendingReply* reply = *it;
 		LLCacheNameEntry* entry = get_ptr_in_map(mCache, reply->mID);
-		if(!entry) continue;
-
-		if (reply->mHost.isOk())
+		if (entry && reply->mHost.isOk())
 		{
 			sender.send(reply->mID, *entry, reply->mHost);
 		}
-
-		reply->done();
-	}
-	
-	for(ReplyQueue::iterator it = mReplyQueue.begin(); it != mReplyQueue.end(); )
-	{
-		ReplyQueue::iterator curit = it++;
-		PendingReply* reply = *curit;
-		if (reply->isDone())
-		{
-			delete reply;
-			mReplyQueue.erase(curit);
-		}
 	}
-}
 
+	for_each(replies.begin(), replies.end(), DeletePointer());
+}
 
 void LLCacheName::Impl::sendRequest(
 	const char* msg_name,
-	const AskQueue& queue)
+	AskQueue& queue,
+	S32& messages_left)
 {
 	if(queue.empty())
 	{
@@ -837,12 +853,17 @@ void LLCacheName::Impl::sendRequest(
 	}
 
 	bool start_new_message = true;
-	AskQueue::const_iterator it = queue.begin();
-	AskQueue::const_iterator end = queue.end();
+	AskQueue::iterator it = queue.begin();
+	AskQueue::iterator end = queue.end();
 	for(; it != end; ++it)
 	{
 		if(start_new_message)
 		{
+			if (messages_left <= 0)
+			{
+				// the rest go out next time
+				break;
+			}
 			start_new_message = false;
 			mMsg->newMessageFast(msg_name);
 		}
@@ -853,12 +874,15 @@ void LLCacheName::Impl::sendRequest(
 		{
 			start_new_message = true;
 			mMsg->sendReliable(mUpstreamHost);
+			messages_left--;
 		}
 	}
 	if(!start_new_message)
 	{
 		mMsg->sendReliable(mUpstreamHost);
+		messages_left--;
 	}
+	queue.erase(queue.begin(), it);
 }
 
 bool LLCacheName::Impl::isRequestPending(const LLUUID& id)
@@ -949,6 +973,10 @@ void LLCacheName::Impl::processUUIDReply(LLMessageSystem* msg, bool isGroup)
 		}
 
 		mPendingQueue.erase(id);
+		if (mReplyQueue.find(id) != mReplyQueue.end())
+		{
+			mRepliedIDs.push_back(id);
+		}
 
 		entry->mIsGroup = isGroup;
 		entry->mCreateTime = (U32)time(NULL);
@@ -61,8 +61,6 @@ const S32 PING_START_BLOCK = 3;		// How many pings behind we have to be to consi
 const S32 PING_RELEASE_BLOCK = 2;	// How many pings behind we have to be to consider ourself unblocked.
 
 const F32 TARGET_PERIOD_LENGTH = 5.f;	// seconds
-const F32 LL_DUPLICATE_SUPPRESSION_TIMEOUT = 60.f; //seconds - this can be long, as time-based cleanup is
-													// only done when wrapping packetids, now...
 
 LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id, 
 							 const F32 circuit_heartbeat_interval, const F32 circuit_timeout)
@@ -85,6 +83,7 @@ LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id,
 	mLastPingID(0),
 	mPingDelay(INITIAL_PING_VALUE_MSEC), 
 	mPingDelayAveraged((F32)INITIAL_PING_VALUE_MSEC), 
+	mAckCreationTime(0.0),
 	mUnackedPacketCount(0),
 	mUnackedPacketBytes(0),
 	mLastPacketInTime(0.0),
@@ -273,64 +272,75 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 	S32 resent_packets = 0;
 	LLReliablePacket *packetp;
 
-
 	//
-	// Theoretically we should search through the list for the packet with the oldest
-	// packet ID, as otherwise when we WRAP we will resend reliable packets out of order.
-	// Since resends are ALREADY out of order, and wrapping is highly rare (16+million packets),
-	// I'm not going to worry about this for now - djs
+	// Only packets whose timers have come due are looked at.  Resends go
+	// out in expiration order rather than packet id order, which is fine
+	// since resends are ALREADY out of order.
 	//
+	mExpiredResends.clear();
+	mResendWheel.advance(now, mExpiredResends);
 
 	reliable_iter iter;
 	BOOL have_resend_overflow = FALSE;
-	for (iter = mUnackedPackets.begin(); iter != mUnackedPackets.end();)
+	BOOL have_warned_overflow = FALSE;
+	// mExpiredResends may grow while we walk it, so index rather than iterate.
+	for (U32 i = 0; i < mExpiredResends.size(); ++i)
 	{
-		packetp = iter->second;
+		const TPACKETID packet_id = mExpiredResends[i].mKey;
+		const F64 due = mExpiredResends[i].mDue;
 
-		// Only check overflow if we haven't had one yet.
-		if (!have_resend_overflow)
+		iter = mUnackedPackets.find(packet_id);
+		if (iter != mUnackedPackets.end())
 		{
-			have_resend_overflow = mThrottles.checkOverflow(TC_RESEND, 0);
-		}
+			packetp = iter->second;
+			if (packetp->mExpirationTime != due)
+			{
+				// Stale timer, the packet has been rescheduled since.
+				continue;
+			}
 
-		if (have_resend_overflow)
-		{
-			// We've exceeded our bandwidth for resends.
-			// Time to stop trying to send them.
+			// Only check overflow if we haven't had one yet.
+			if (!have_resend_overflow)
+			{
+				have_resend_overflow = mThrottles.checkOverflow(TC_RESEND, 0);
+			}
 
-			// If we have too many unacked packets, we need to start dropping expired ones.
-			if (mUnackedPacketBytes > 512000)
+			if (have_resend_overflow)
 			{
-				if (now > packetp->mExpirationTime)
+				// We've exceeded our bandwidth for resends.
+				// Time to stop trying to send them.
+
+				// If we have too many unacked packets, we need to start dropping expired ones.
+				if (mUnackedPacketBytes > 512000)
 				{
 					// This circuit has overflowed.  Do not retry.  Do not pass go.
 					packetp->mRetries = 0;
-					// Remove it from this list and add it to the final list.
-					mUnackedPackets.erase(iter++);
+					// Remove it from this list and add it to the final list,
+					// where it gets failed further down this loop.
+					mUnackedPackets.erase(iter);
 					mFinalRetryPackets[packetp->mPacketID] = packetp;
+					resend_wheel_t::Entry final_entry;
+					final_entry.mKey = packet_id;
+					final_entry.mDue = due;
+					mExpiredResends.push_back(final_entry);
+					continue;
 				}
-				else
+
+				if (!have_warned_overflow && mUnackedPacketBytes > 256000 && !(getPacketsOut() % 1024))
 				{
-					++iter;
+					// Warn if we've got a lot of resends waiting.
+					llwarns << mHost << " has " << mUnackedPacketBytes 
+							<< " bytes of reliable messages waiting" << llendl;
 				}
-				// Move on to the next unacked packet.
+				have_warned_overflow = TRUE;
+
+				// Stop resending, try this one again next time around.
+				mResendWheel.schedule(packet_id, due);
 				continue;
 			}
-			
-			if (mUnackedPacketBytes > 256000 && !(getPacketsOut() % 1024))
-			{
-				// Warn if we've got a lot of resends waiting.
-				llwarns << mHost << " has " << mUnackedPacketBytes 
-						<< " bytes of reliable messages waiting" << llendl;
-			}
-			// Stop resending.  There are less than 512000 unacked packets.
-			break;
-		}
 
-		if (now > packetp->mExpirationTime)
-		{
 			packetp->mRetries--;
-			
+
 			// retry		
 			mCurrentResendCount++;
 
@@ -362,65 +372,53 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 				// custom, constant retry time
 				packetp->mExpirationTime = now + packetp->mTimeout;
 			}
+			mResendWheel.schedule(packetp->mPacketID, packetp->mExpirationTime);
 
 			if (!packetp->mRetries)
 			{
 				// Last resend, remove it from this list and add it to the final list.
-				mUnackedPackets.erase(iter++);
+				mUnackedPackets.erase(iter);
 				mFinalRetryPackets[packetp->mPacketID] = packetp;
 			}
-			else
-			{
-				// Don't remove it yet, it still gets to try to resend at least once.
-				++iter;
-			}
 			resent_packets++;
+			continue;
 		}
-		else
+
+		iter = mFinalRetryPackets.find(packet_id);
+		if ((iter == mFinalRetryPackets.end()) || (iter->second->mExpirationTime != due))
 		{
-			// Don't need to do anything with this packet, keep iterating.
-			++iter;
+			// Already acked, or a stale timer.
+			continue;
 		}
-	}
-
-
-	for (iter = mFinalRetryPackets.begin(); iter != mFinalRetryPackets.end();)
-	{
 		packetp = iter->second;
-		if (now > packetp->mExpirationTime)
-		{
-			// fail (too many retries)
-			//llinfos << "Packet " << packetp->mPacketID << " removed from the pending list: exceeded retry limit" << llendl;
-			//if (packetp->mMessageName)
-			//{
-			//	llinfos << "Packet name " << packetp->mMessageName << llendl;
-			//}
-			gMessageSystem->mFailedResendPackets++;
 
-			if(gMessageSystem->mVerboseLog)
-			{
-				std::ostringstream str;
-				str << "MSG: -> " << packetp->mHost << "\tABORTING RELIABLE:\t"
-					<< packetp->mPacketID;
-				llinfos << str.str() << llendl;
-			}
-
-			if (packetp->mCallback)
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);
-			}
-
-			// Update stats
-			mUnackedPacketCount--;
-			mUnackedPacketBytes -= packetp->mBufferLength;
+		// fail (too many retries)
+		//llinfos << "Packet " << packetp->mPacketID << " removed from the pending list: exceeded retry limit" << llendl;
+		//if (packetp->mMessageName)
+		//{
+		//	llinfos << "Packet name " << packetp->mMessageName << llendl;
+		//}
+		gMessageSystem->mFailedResendPackets++;
 
-			mFinalRetryPackets.erase(iter++);
-			delete packetp;
+		if(gMessageSystem->mVerboseLog)
+		{
+			std::ostringstream str;
+			str << "MSG: -> " << packetp->mHost << "\tABORTING RELIABLE:\t"
+				<< packetp->mPacketID;
+			llinfos << str.str() << llendl;
 		}
-		else
+
+		if (packetp->mCallback)
 		{
-			++iter;
+			packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);
 		}
+
+		// Update stats
+		mUnackedPacketCount--;
+		mUnackedPacketBytes -= packetp->mBufferLength;
+
+		mFinalRetryPackets.erase(iter);
+		delete packetp;
 	}
 
 	return mUnackedPacketCount;
@@ -579,6 +577,7 @@ void LLCircuitData::addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLR
 	{
 		mFinalRetryPackets[packet_info->mPacketID] = packet_info;
 	}
+	mResendWheel.schedule(packet_info->mPacketID, packet_info->mExpirationTime);
 }
 
 
@@ -601,7 +600,7 @@ void LLCircuit::resendUnackedPackets(S32& unacked_list_length, S32& unacked_list
 
 BOOL LLCircuitData::isDuplicateResend(TPACKETID packetnum)
 {
-	return (mRecentlyReceivedReliablePackets.find(packetnum) != mRecentlyReceivedReliablePackets.end());
+	return mRecentlyReceivedReliablePackets.contains(packetnum);
 }
 
 
@@ -1001,46 +1000,13 @@ void LLCircuitData::clearDuplicateList(TPACKETID oldest_id)
 
 	// we want to KEEP all x where oldest_id <= x <= last incoming packet, and delete everything else.
 
-	//llinfos << mHost << ": clearing before oldest " << oldest_id << llendl;
-	//llinfos << "Recent list before: " << mRecentlyReceivedReliablePackets.size() << llendl;
+	// Anything with an ID > mHighestPacketID is left alone.  That should only
+	// happen with wrapping IDs, and those slots get reused by newer IDs long
+	// before they could be mistaken for a duplicate.
 	if (oldest_id < mHighestPacketID)
 	{
-		// Clean up everything with a packet ID less than oldest_id.
-		packet_time_map::iterator pit_start;
-		packet_time_map::iterator pit_end;
-		pit_start = mRecentlyReceivedReliablePackets.begin();
-		pit_end = mRecentlyReceivedReliablePackets.lower_bound(oldest_id);
-		mRecentlyReceivedReliablePackets.erase(pit_start, pit_end);
-	}
-
-	// Do timeout checks on everything with an ID > mHighestPacketID.
-	// This should be empty except for wrapping IDs.  Thus, this should be
-	// highly rare.
-	U64 mt_usec = LLMessageSystem::getMessageTimeUsecs();
-
-	packet_time_map::iterator pit;
-	for(pit = mRecentlyReceivedReliablePackets.upper_bound(mHighestPacketID);
-		pit != mRecentlyReceivedReliablePackets.end(); )
-	{
-		// Validate that the packet ID seems far enough away
-		if ((pit->first - mHighestPacketID) < 100)
-		{
-			llwarns << "Probably incorrectly timing out non-wrapped packets!" << llendl;
-		}
-		U64 delta_t_usec = mt_usec - (*pit).second;
-		F64 delta_t_sec = delta_t_usec * SEC_PER_USEC;
-		if (delta_t_sec > LL_DUPLICATE_SUPPRESSION_TIMEOUT)
-		{
-			// enough time has elapsed we're not likely to get a duplicate on this one
-			llinfos << "Clearing " << pit->first << " from recent list" << llendl;
-			mRecentlyReceivedReliablePackets.erase(pit++);
-		}
-		else
-		{
-			++pit;
-		}
+		mRecentlyReceivedReliablePackets.forgetBefore(oldest_id);
 	}
-	//llinfos << "Recent list after: " << mRecentlyReceivedReliablePackets.size() << llendl;
 }
 
 BOOL LLCircuitData::checkCircuitTimeout()
@@ -1076,6 +1042,7 @@ BOOL LLCircuitData::collectRAck(TPACKETID packet_num)
 	{
 		// First extra ack, we need to add ourselves to the list of circuits that need to send acks
 		gMessageSystem->mCircuitInfo.mSendAckMap[mHost] = this;
+		mAckCreationTime = LLMessageSystem::getMessageTimeSeconds();
 	}
 
 	mAcks.push_back(packet_num);
@@ -1083,16 +1050,28 @@ BOOL LLCircuitData::collectRAck(TPACKETID packet_num)
 }
 
 // this method is called during the message system processAcks() to
-// send out any acks that did not get sent already.
+// send out any acks that did not get sent already.  Acks younger than
+// LL_MAX_ACK_COLLECT_SECONDS are held back so they can be piggybacked on
+// outgoing packets, unless there are enough of them to fill a PacketAck.
 void LLCircuit::sendAcks()
 {
+	F64 now = LLMessageSystem::getMessageTimeSeconds();
 	LLCircuitData* cd;
-	circuit_data_map::iterator end = mSendAckMap.end();
-	for(circuit_data_map::iterator it = mSendAckMap.begin(); it != end; ++it)
+	circuit_data_map::iterator it = mSendAckMap.begin();
+	while (it != mSendAckMap.end())
 	{
 		cd = (*it).second;
 
 		S32 count = (S32)cd->mAcks.size();
+		if (count > 0
+			&& count < LL_MAX_ACKS_PER_PACKET_ACK
+			&& (now - cd->mAckCreationTime) < LL_MAX_ACK_COLLECT_SECONDS)
+		{
+			// Keep collecting.
+			++it;
+			continue;
+		}
+
 		if(count > 0)
 		{
 			// send the packet acks
@@ -1106,7 +1085,7 @@ void LLCircuit::sendAcks()
 				gMessageSystem->nextBlockFast(_PREHASH_Packets);
 				gMessageSystem->addU32Fast(_PREHASH_ID, cd->mAcks[i]);
 				++acks_this_packet;
-				if(acks_this_packet > 250)
+				if(acks_this_packet >= LL_MAX_ACKS_PER_PACKET_ACK)
 				{
 					gMessageSystem->sendMessage(cd->mHost);
 					acks_this_packet = 0;
@@ -1129,10 +1108,11 @@ void LLCircuit::sendAcks()
 			// empty out the acks list
 			cd->mAcks.clear();
 		}
-	}
 
-	// All acks have been sent, clear the map
-	mSendAckMap.clear();
+		// All acks for this circuit have been sent, either here or
+		// piggybacked on other messages.
+		mSendAckMap.erase(it++);
+	}
 }
 
 
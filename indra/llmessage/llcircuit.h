@@ -38,6 +38,8 @@
 #include "net.h"
 #include "llhost.h"
 #include "llpacketack.h"
+#include "llpacketidhistory.h"
+#include "lltimerwheel.h"
 #include "lluuid.h"
 #include "llthrottle.h"
 #include "llstat.h"
@@ -61,6 +63,13 @@ const U8 LL_PACKET_ID_SIZE = 6;
 const S32 LL_MAX_RESENT_PACKETS_PER_FRAME = 100;
 const S32 LL_MAX_ACKED_PACKETS_PER_FRAME = 200;
 
+// Acks are held back for up to this long so that they can ride along on
+// outgoing traffic instead of going out in their own PacketAck message.
+// This has to stay well below LL_MINIMUM_RELIABLE_TIMEOUT_SECONDS.
+const F32 LL_MAX_ACK_COLLECT_SECONDS = 0.05f;
+// A full PacketAck message, sent right away even if the acks are fresh.
+const S32 LL_MAX_ACKS_PER_PACKET_ACK = 250;
+
 //
 // Prototypes and Predefines
 //
@@ -237,8 +246,9 @@ protected:
 	typedef std::map<TPACKETID, U64> packet_time_map;
 
 	packet_time_map							mPotentialLostPackets;
-	packet_time_map							mRecentlyReceivedReliablePackets;
+	LLPacketIDHistory						mRecentlyReceivedReliablePackets;
 	std::vector<TPACKETID> mAcks;
+	F64										mAckCreationTime;	// Time the oldest unsent ack was collected
 
 	typedef std::map<TPACKETID, LLReliablePacket *> reliable_map;
 	typedef reliable_map::iterator					reliable_iter;
@@ -246,6 +256,13 @@ protected:
 	reliable_map							mUnackedPackets;
 	reliable_map							mFinalRetryPackets;
 
+	// Expiration times of everything in mUnackedPackets and
+	// mFinalRetryPackets.  Acked packets are not removed from the wheel,
+	// their entries are skipped when they come due.
+	typedef LLTimerWheel<TPACKETID>			resend_wheel_t;
+	resend_wheel_t							mResendWheel;
+	resend_wheel_t::entry_list_t			mExpiredResends;	// scratch space for resendUnackedPackets()
+
 	S32										mUnackedPacketCount;
 	S32										mUnackedPacketBytes;
 
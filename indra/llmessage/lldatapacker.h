@@ -167,10 +167,14 @@ public:
 	/*virtual*/ BOOL		unpackUUID(LLUUID &value, const char *name);
 
 				S32			getCurrentSize() const	{ return (S32)(mCurBufferp - mBufferp); }
+				// Move the read position, to skip data unpacked some other way
+				void		setCurrentSize(S32 size)	{ mCurBufferp = mBufferp + size; }
 				S32			getBufferSize() const	{ return mBufferSize; }
 				const U8*   getBuffer() const   { return mBufferp; }    
 				void		reset()				{ mCurBufferp = mBufferp; mWriteEnabled = (mCurBufferp != NULL); }
-				void		freeBuffer()		{ delete [] mBufferp; mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
+				void		freeBuffer()		{ delete [] mBufferp; detachBuffer(); }
+				// Forget a buffer owned by someone else without freeing it
+				void		detachBuffer()		{ mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
 				void		assignBuffer(U8 *bufferp, S32 size)
 				{
 					if(mBufferp && mBufferp != bufferp)
@@ -663,11 +663,11 @@ bool LLHTTPAssetStorage::deletePendingRequest(LLAssetStorage::ERequestType rt,
 				{
 					// This request was found in the pending list.  Move it to the end!
 					LLAssetRequest* pending_req = *result;
-					pending->remove(pending_req);
+					removePendingRequest(rt, pending_req);
 
 					if (!pending_req->mIsUserWaiting)				//A user is waiting on this request.  Toss it.
 					{
-						pending->push_back(pending_req);
+						addPendingRequest(rt, pending_req);
 					}
 					else
 					{
@@ -718,14 +718,7 @@ void LLHTTPAssetStorage::_queueDataRequest(const LLUUID& uuid, LLAssetType::ETyp
 	// that we always want them first, even if they're out of order.
 	//
 	
-	if (req->getType() == LLAssetType::AT_TEXTURE)
-	{
-		mPendingDownloads.push_back(req);
-	}
-	else
-	{
-		mPendingDownloads.push_front(req);
-	}
+	addPendingRequest(RT_DOWNLOAD, req, req->getType() != LLAssetType::AT_TEXTURE);
 }
 
 LLAssetRequest* LLHTTPAssetStorage::findNextRequest(LLAssetStorage::request_list_t& pending, 
@@ -0,0 +1,168 @@
+/**
+ * @file   llhttprequestgroup.cpp
+ * @brief  HTTP requests a coroutine starts together and waits on together.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "llhttprequestgroup.h"
+// STL headers
+#include <deque>
+// std headers
+// external library headers
+// other Linden headers
+#include "lleventcoro.h"
+#include "llevents.h"
+
+struct LLHTTPRequestGroup::State
+{
+    State(const std::string& name):
+        // tweak name for uniqueness
+        mPump(name, true),
+        mPending(0)
+    {}
+
+    struct Reply
+    {
+        Reply(): mStatus(0) {}
+
+        U32 mStatus;
+        std::string mReason;
+        LLSD mContent;
+    };
+
+    LLEventStream mPump;
+    std::vector<Reply> mReplies;
+    std::deque<S32> mAnswered;
+    S32 mPending;
+};
+
+/**
+ * Stores its reply in the group's State, which it keeps alive, and wakes
+ * wait() when it is the last one in.
+ */
+class LLHTTPRequestGroup::GroupResponder: public LLHTTPClient::Responder
+{
+public:
+    GroupResponder(const boost::shared_ptr<State>& state, S32 index):
+        mState(state),
+        mIndex(index)
+    {}
+
+    virtual void completed(U32 status, const std::string& reason, const LLSD& content)
+    {
+        State::Reply& reply(mState->mReplies[mIndex]);
+        reply.mStatus = status;
+        reply.mReason = reason;
+        reply.mContent = content;
+        mState->mAnswered.push_back(mIndex);
+        if (--mState->mPending == 0)
+        {
+            mState->mPump.post(LLSD());
+        }
+    }
+
+private:
+    boost::shared_ptr<State> mState;
+    S32 mIndex;
+};
+
+LLHTTPRequestGroup::LLHTTPRequestGroup(const std::string& name):
+    mState(new State(name))
+{
+}
+
+S32 LLHTTPRequestGroup::addRequest()
+{
+    mState->mReplies.push_back(State::Reply());
+    mState->mPending++;
+    return (S32)mState->mReplies.size() - 1;
+}
+
+S32 LLHTTPRequestGroup::post(const std::string& url, const LLSD& body, F32 timeout)
+{
+    S32 index = addRequest();
+    LLHTTPClient::post(url, body, new GroupResponder(mState, index), LLSD(), timeout);
+    return index;
+}
+
+S32 LLHTTPRequestGroup::get(const std::string& url, F32 timeout)
+{
+    S32 index = addRequest();
+    LLHTTPClient::get(url, new GroupResponder(mState, index), LLSD(), timeout);
+    return index;
+}
+
+void LLHTTPRequestGroup::wait(LLCoros::self& self)
+{
+    while (mState->mPending > 0)
+    {
+        LL_DEBUGS("LLHTTPRequestGroup") << LLCoros::instance().getName(self) << " waiting on "
+                                        << mState->mPending << " of " << size() << " requests"
+                                        << LL_ENDL;
+        waitForEventOn(self, mState->mPump);
+    }
+}
+
+S32 LLHTTPRequestGroup::size() const
+{
+    return (S32)mState->mReplies.size();
+}
+
+S32 LLHTTPRequestGroup::getPending() const
+{
+    return mState->mPending;
+}
+
+S32 LLHTTPRequestGroup::takeAnswered()
+{
+    if (mState->mAnswered.empty())
+    {
+        return -1;
+    }
+    S32 index = mState->mAnswered.front();
+    mState->mAnswered.pop_front();
+    return index;
+}
+
+bool LLHTTPRequestGroup::succeeded(S32 index) const
+{
+    return LLHTTPClient::Responder::isGoodStatus(getStatus(index));
+}
+
+const LLSD& LLHTTPRequestGroup::getContent(S32 index) const
+{
+    return mState->mReplies[index].mContent;
+}
+
+U32 LLHTTPRequestGroup::getStatus(S32 index) const
+{
+    return mState->mReplies[index].mStatus;
+}
+
+const std::string& LLHTTPRequestGroup::getReason(S32 index) const
+{
+    return mState->mReplies[index].mReason;
+}
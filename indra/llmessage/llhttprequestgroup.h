@@ -0,0 +1,115 @@
+/**
+ * @file   llhttprequestgroup.h
+ * @brief  HTTP requests a coroutine starts together and waits on together.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#if ! defined(LL_LLHTTPREQUESTGROUP_H)
+#define LL_LLHTTPREQUESTGROUP_H
+
+#include "llcoros.h"
+#include "llerror.h"                // LOG_CLASS()
+#include "llhttpclient.h"
+#include "llsd.h"
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Lets a coroutine (see LLCoros) make capability requests without writing a
+ * Responder subclass for each one, and without waiting a frame between the
+ * steps of a flow. Start any number of requests, then wait() for all of
+ * them; the coroutine resumes when the last reply arrives, and the results
+ * are read back by the index each request returned.
+ *
+ * @code
+ * void MyClass::myCoroutine(LLCoros::self& self, std::string url)
+ * {
+ *     LLHTTPRequestGroup requests("myCoroutine");
+ *     S32 fee = requests.post(url + "/fee", fee_request);
+ *     S32 quota = requests.get(url + "/quota");
+ *     requests.wait(self);
+ *     if (requests.succeeded(fee) && requests.succeeded(quota))
+ *     {
+ *         ...
+ *     }
+ * }
+ * @endcode
+ *
+ * A coroutine that would rather handle each reply as it comes in can poll
+ * takeAnswered() instead, from a loop that waits on "mainloop", say.
+ *
+ * Replies are delivered on the main thread, like any Responder's. A reply
+ * for a group that has already been destroyed (because its coroutine was
+ * killed, say) is dropped.
+ */
+class LLHTTPRequestGroup
+{
+    LOG_CLASS(LLHTTPRequestGroup);
+
+public:
+    /// @a name is only used to name the LLEventPump wait() listens on.
+    LLHTTPRequestGroup(const std::string& name = "LLHTTPRequestGroup");
+
+    /// Start a POST of @a body to @a url. Returns the request's index.
+    S32 post(const std::string& url, const LLSD& body,
+             F32 timeout = HTTP_REQUEST_EXPIRY_SECS);
+    /// Start a GET of @a url. Returns the request's index.
+    S32 get(const std::string& url, F32 timeout = HTTP_REQUEST_EXPIRY_SECS);
+
+    /**
+     * Suspend the calling coroutine until every request started so far has
+     * been answered, one way or another. Returns at once if they all have.
+     * More requests may be started afterwards and waited on again.
+     */
+    void wait(LLCoros::self& self);
+
+    /// Number of requests started
+    S32 size() const;
+    /// Number of requests not yet answered
+    S32 getPending() const;
+    /**
+     * The index of a request answered since the last call, in the order
+     * the replies arrived, or -1 if there are none. Every reply is listed
+     * once, whether or not wait() was used as well.
+     */
+    S32 takeAnswered();
+
+    /// True if request @a index got a 2xx reply
+    bool succeeded(S32 index) const;
+    /// The reply body, whether it succeeded or not
+    const LLSD& getContent(S32 index) const;
+    /// HTTP status, or 0 while still waiting
+    U32 getStatus(S32 index) const;
+    const std::string& getReason(S32 index) const;
+
+private:
+    struct State;
+    class GroupResponder;
+
+    S32 addRequest();
+
+    boost::shared_ptr<State> mState;
+};
+
+#endif /* ! defined(LL_LLHTTPREQUESTGROUP_H) */
@@ -0,0 +1,104 @@
+/**
+ * @file llpacketidhistory.h
+ * @brief Flat ring of recently received reliable packet ids, used for
+ * duplicate suppression on a circuit.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETIDHISTORY_H
+#define LL_LLPACKETIDHISTORY_H
+
+#include <algorithm>
+#include <vector>
+
+// Real packet ids never exceed LL_MAX_OUT_PACKET_ID.
+const TPACKETID LL_EMPTY_PACKET_ID_SLOT = 0xFFFFFFFF;
+
+// Remembers which packet ids have been seen, indexed directly by the low
+// bits of the id.  An id is forgotten either explicitly through
+// forgetBefore() or implicitly when an id a whole ring later lands in the
+// same slot, so memory use is fixed no matter how far behind the remote
+// end's oldest unacked packet falls.
+class LLPacketIDHistory
+{
+public:
+	// size must be a power of two.
+	LLPacketIDHistory(U32 size = 16384)
+	:	mIDs(size, LL_EMPTY_PACKET_ID_SLOT),
+		mMask(size - 1),
+		mLowWater(0)
+	{
+		llassert((size & mMask) == 0);
+	}
+
+	void insert(TPACKETID id)
+	{
+		mIDs[id & mMask] = id;
+	}
+
+	bool contains(TPACKETID id) const
+	{
+		return mIDs[id & mMask] == id;
+	}
+
+	void erase(TPACKETID id)
+	{
+		if (contains(id))
+		{
+			mIDs[id & mMask] = LL_EMPTY_PACKET_ID_SLOT;
+		}
+	}
+
+	// Forget every id below oldest_id.  Only the ids between the previous
+	// call and this one are visited, and never more than one ring's worth.
+	void forgetBefore(TPACKETID oldest_id)
+	{
+		TPACKETID begin = mLowWater;
+		if ((begin > oldest_id) || (oldest_id - begin > mMask))
+		{
+			// Either the ids wrapped since last time or we fell more than
+			// a ring behind; in both cases one full pass is enough.
+			begin = (oldest_id > mMask) ? oldest_id - mMask - 1 : 0;
+		}
+		for (TPACKETID id = begin; id < oldest_id; ++id)
+		{
+			erase(id);
+		}
+		mLowWater = oldest_id;
+	}
+
+	void clear()
+	{
+		std::fill(mIDs.begin(), mIDs.end(), LL_EMPTY_PACKET_ID_SLOT);
+		mLowWater = 0;
+	}
+
+	U32 capacity() const	{ return (U32)mIDs.size(); }
+
+private:
+	std::vector<TPACKETID>	mIDs;
+	U32						mMask;
+	TPACKETID				mLowWater;
+};
+
+#endif // LL_LLPACKETIDHISTORY_H
@@ -37,10 +37,6 @@
 
 
 
-const S32 PS_PART_DATA_BLOCK_SIZE = 4 + 2 + 4 + 4 + 2 + 2; // 18
-const S32 PS_DATA_BLOCK_SIZE = 68 + PS_PART_DATA_BLOCK_SIZE; // 68 + 18 = 86
-
-
 const F32 MAX_PART_SCALE = 4.f;
 
 BOOL LLPartData::pack(LLDataPacker &dp)
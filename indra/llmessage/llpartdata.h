@@ -38,6 +38,10 @@ class LLDataPacker;
 
 const S32 PS_CUR_VERSION = 18;
 
+// Packed sizes of LLPartData and LLPartSysData, as in a PSBlock
+const S32 PS_PART_DATA_BLOCK_SIZE = 4 + 2 + 4 + 4 + 2 + 2; // 18
+const S32 PS_DATA_BLOCK_SIZE = 68 + PS_PART_DATA_BLOCK_SIZE; // 68 + 18 = 86
+
 //
 // These constants are used by the script code, not by the particle system itself
 //
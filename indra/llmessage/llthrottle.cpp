@@ -374,10 +374,24 @@ BOOL LLThrottleGroup::dynamicAdjust()
 	}
 	mDynamicAdjustTime = mt_sec;
 
-	S32 total = 0;
-	// Update historical information
+	// One pass over the channels updates their history, classifies them
+	// and works out what each would give up under either policy.  Whether
+	// anything actually moves depends on whether any channel is busy,
+	// which we only know at the end, so the budgets are settled in a
+	// second pass.
+	BOOL channels_busy = FALSE;
+	F32  busy_nominal_sum = 0;		// use for allocation of pooled idle bandwidth
+	F32  starved_nominal_sum = 0;	// use for allocation when seeking toward nominal
+	F32  busy_pool_bps = 0;
+	F32  recover_pool_bps = 0;
+	BOOL channel_busy[TC_EOF];
+	BOOL channel_starved[TC_EOF];
+	F32  busy_transfer_bps[TC_EOF];
+	F32  recover_transfer_bps[TC_EOF];
+
 	for (i = 0; i < TC_EOF; i++)
 	{
+		// Update historical information
 		if (mBitsSentHistory[i] == 0)
 		{
 			// first run, just copy current period
@@ -389,126 +403,96 @@ BOOL LLThrottleGroup::dynamicAdjust()
 			mBitsSentHistory[i] = (1.f - CURRENT_PERIOD_WEIGHT) * mBitsSentHistory[i] 
 				+ CURRENT_PERIOD_WEIGHT * mBitsSentThisPeriod[i];
 		}
-
 		mBitsSentThisPeriod[i] = 0;
-		total += llround(mBitsSentHistory[i]);
-	}
 
-	// Look for busy channels
-	// TODO: Fold into loop above.
-	BOOL channels_busy = FALSE;
-	F32  busy_nominal_sum = 0;
-	BOOL channel_busy[TC_EOF];
-	BOOL channel_idle[TC_EOF];
-	BOOL channel_over_nominal[TC_EOF];
-
-	for (i = 0; i < TC_EOF; i++)
-	{
 		// Is this a busy channel?
-		if (mBitsSentHistory[i] >= BUSY_PERCENT * DYNAMIC_ADJUST_TIME * mCurrentBPS[i])
+		channel_busy[i] = (mBitsSentHistory[i] >= BUSY_PERCENT * DYNAMIC_ADJUST_TIME * mCurrentBPS[i]);
+		if (channel_busy[i])
 		{
-			// this channel is busy
 			channels_busy = TRUE;
-			busy_nominal_sum += mNominalBPS[i];		// use for allocation of pooled idle bandwidth
-			channel_busy[i] = TRUE;
-		}
-		else
-		{
-			channel_busy[i] = FALSE;
+			busy_nominal_sum += mNominalBPS[i];
 		}
 
 		// Is this an idle channel?
-		if ((mBitsSentHistory[i] < IDLE_PERCENT * DYNAMIC_ADJUST_TIME * mCurrentBPS[i]) &&
-			(mBitsAvailable[i] > 0))
-		{
-			channel_idle[i] = TRUE;
-		}
-		else
-		{
-			channel_idle[i] = FALSE;
-		}
+		BOOL channel_idle = (mBitsSentHistory[i] < IDLE_PERCENT * DYNAMIC_ADJUST_TIME * mCurrentBPS[i]) &&
+							(mBitsAvailable[i] > 0);
 
 		// Is this an overpumped channel?
-		if (mCurrentBPS[i] > mNominalBPS[i])
-		{
-			channel_over_nominal[i] = TRUE;
-		}
-		else
-		{
-			channel_over_nominal[i] = FALSE;
-		}
+		BOOL channel_over_nominal = (mCurrentBPS[i] > mNominalBPS[i]);
 
-		//if (total)
-		//{
-		//	llinfos << i << ": B" << channel_busy[i] << " I" << channel_idle[i] << " N" << channel_over_nominal[i];
-		//	llcont << " Nom: " << mNominalBPS[i] << " Cur: " << mCurrentBPS[i] << " BS: " << mBitsSentHistory[i] << llendl;
-		//}
-	}
+		//llinfos << i << ": B" << channel_busy[i] << " I" << channel_idle << " N" << channel_over_nominal;
+		//llcont << " Nom: " << mNominalBPS[i] << " Cur: " << mCurrentBPS[i] << " BS: " << mBitsSentHistory[i] << llendl;
 
-	if (channels_busy)
-	{
-		// Some channels are busy.  Let's see if we can get them some bandwidth.
-		F32 used_bps;
-		F32 avail_bps;
-		F32 transfer_bps;
-
-		F32 pool_bps = 0;
-
-		for (i = 0; i < TC_EOF; i++)
+		// What this channel gives up if someone is busy.
+		busy_transfer_bps[i] = 0.f;
+		if (channel_idle || channel_over_nominal)
 		{
-			if (channel_idle[i] || channel_over_nominal[i] )
+			// Either channel i is idle, or has been overpumped.
+			// Therefore it's a candidate to give up some bandwidth.
+			// Figure out how much bandwidth it has been using, and how
+			// much is available to steal.
+			F32 used_bps = mBitsSentHistory[i] / DYNAMIC_ADJUST_TIME;
+
+			// CRO make sure to keep a minimum amount of throttle available
+			// CRO NB: channels set to < MINIMUM_BPS will never give up bps, 
+			// which is correct I think
+			if (used_bps < gThrottleMinimumBPS[i])
 			{
-				// Either channel i is idle, or has been overpumped.
-				// Therefore it's a candidate to give up some bandwidth.
-				// Figure out how much bandwidth it has been using, and how
-				// much is available to steal.
-				used_bps = mBitsSentHistory[i] / DYNAMIC_ADJUST_TIME;
-
-				// CRO make sure to keep a minimum amount of throttle available
-				// CRO NB: channels set to < MINIMUM_BPS will never give up bps, 
-				// which is correct I think
-				if (used_bps < gThrottleMinimumBPS[i])
-				{
-					used_bps = gThrottleMinimumBPS[i];
-				}
-
-				if (channel_over_nominal[i])
-				{
-					F32 unused_current = mCurrentBPS[i] - used_bps;
-					avail_bps = llmax(mCurrentBPS[i] - mNominalBPS[i], unused_current);
-				}
-				else
-				{
-					avail_bps = mCurrentBPS[i] - used_bps;
-				}
-
-				//llinfos << i << " avail " << avail_bps << llendl;
+				used_bps = gThrottleMinimumBPS[i];
+			}
 
-				// Historically, a channel could have used more than its current share,
-				// even if it's idle right now.
-				// Make sure we don't steal too much.
-				if (avail_bps < 0)
-				{
-					continue;
-				}
+			F32 avail_bps;
+			if (channel_over_nominal)
+			{
+				F32 unused_current = mCurrentBPS[i] - used_bps;
+				avail_bps = llmax(mCurrentBPS[i] - mNominalBPS[i], unused_current);
+			}
+			else
+			{
+				avail_bps = mCurrentBPS[i] - used_bps;
+			}
 
-				// Transfer some bandwidth from this channel into the global pool.
-				transfer_bps = avail_bps * TRANSFER_PERCENT;
-				mCurrentBPS[i] -= transfer_bps;
-				pool_bps += transfer_bps;
+			// Historically, a channel could have used more than its current share,
+			// even if it's idle right now.
+			// Make sure we don't steal too much.
+			if (avail_bps >= 0)
+			{
+				busy_transfer_bps[i] = avail_bps * TRANSFER_PERCENT;
+				busy_pool_bps += busy_transfer_bps[i];
 			}
 		}
 
-		//llinfos << "Pool BPS: " << pool_bps << llendl;
-		// Now redistribute the bandwidth to busy channels.
+		// What this channel gives up, or gets a share of, if no one is busy
+		// and the allocations seek toward nominal.
+		recover_transfer_bps[i] = 0.f;
+		channel_starved[i] = FALSE;
+		if (channel_over_nominal)
+		{
+			recover_transfer_bps[i] = (mCurrentBPS[i] - mNominalBPS[i]) * RECOVER_PERCENT;
+			recover_pool_bps += recover_transfer_bps[i];
+		}
+		else if (mCurrentBPS[i] < mNominalBPS[i])
+		{
+			// We're going to weight allocations by nominal BPS.
+			channel_starved[i] = TRUE;
+			starved_nominal_sum += mNominalBPS[i];
+		}
+	}
+
+	if (channels_busy)
+	{
+		// Some channels are busy.  Move the pooled bandwidth from the
+		// idle and overpumped channels to them.
 		F32 unused_bps = 0.f;
 
 		for (i = 0; i < TC_EOF; i++)
 		{
+			mCurrentBPS[i] -= busy_transfer_bps[i];
+
 			if (channel_busy[i])
 			{
-				F32 add_amount = pool_bps * (mNominalBPS[i] / busy_nominal_sum);
-				//llinfos << "Busy " << i << " gets " << pool_bps << llendl;
+				F32 add_amount = busy_pool_bps * (mNominalBPS[i] / busy_nominal_sum);
+				//llinfos << "Busy " << i << " gets " << add_amount << llendl;
 				mCurrentBPS[i] += add_amount;
 
 				// CRO: make sure this doesn't get too huge
@@ -542,42 +526,15 @@ BOOL LLThrottleGroup::dynamicAdjust()
 	else
 	{
 		// No one is busy.
-		// Make the channel allocations seek toward nominal.
-
-		// Look for overpumped channels
-		F32 starved_nominal_sum = 0;
-		F32 avail_bps = 0;
-		F32 transfer_bps = 0;
-		F32 pool_bps = 0;
-		for (i = 0; i < TC_EOF; i++)
-		{
-			if (mCurrentBPS[i] > mNominalBPS[i])
-			{
-				avail_bps = (mCurrentBPS[i] - mNominalBPS[i]);
-				transfer_bps = avail_bps * RECOVER_PERCENT;
-
-				mCurrentBPS[i] -= transfer_bps;
-				pool_bps += transfer_bps;
-			}
-		}
-
-		// Evenly distribute bandwidth to channels currently
-		// using less than nominal.
-		for (i = 0; i < TC_EOF; i++)
-		{
-			if (mCurrentBPS[i] < mNominalBPS[i])
-			{
-				// We're going to weight allocations by nominal BPS.
-				starved_nominal_sum += mNominalBPS[i];
-			}
-		}
-
+		// Make the channel allocations seek toward nominal, taking from the
+		// overpumped channels and distributing according to nominal
+		// allocation ratios to the ones using less than nominal.
 		for (i = 0; i < TC_EOF; i++)
 		{
-			if (mCurrentBPS[i] < mNominalBPS[i])
+			mCurrentBPS[i] -= recover_transfer_bps[i];
+			if (channel_starved[i])
 			{
-				// Distribute bandwidth according to nominal allocation ratios.
-				mCurrentBPS[i] += pool_bps * (mNominalBPS[i] / starved_nominal_sum);
+				mCurrentBPS[i] += recover_pool_bps * (mNominalBPS[i] / starved_nominal_sum);
 			}
 		}
 	}
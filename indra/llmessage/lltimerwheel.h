@@ -0,0 +1,146 @@
+/**
+ * @file lltimerwheel.h
+ * @brief Hashed timer wheel used to schedule reliable packet resends
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTIMERWHEEL_H
+#define LL_LLTIMERWHEEL_H
+
+#include <vector>
+
+// Hashed timer wheel.
+//
+// Each entry is hashed into a slot by the tick its deadline falls on.
+// Deadlines more than one revolution away share a slot with nearer ones
+// and are simply left in place until their own revolution comes around,
+// so scheduling is O(1) and advancing only looks at the slots for the
+// ticks that have elapsed since the last call.
+//
+// The wheel never removes entries on its own behalf.  Callers that cancel
+// a timer (e.g. because the packet got acked) leave the entry behind and
+// discard it when it expires, which is much cheaper than searching for it.
+template <typename KEY>
+class LLTimerWheel
+{
+public:
+	struct Entry
+	{
+		KEY mKey;
+		F64 mDue;
+	};
+	typedef std::vector<Entry> entry_list_t;
+
+	LLTimerWheel(F64 tick_seconds = 0.01, U32 num_slots = 256)
+	:	mTickSeconds(tick_seconds),
+		mSlots(num_slots),
+		mCurrentTick(0),
+		mCount(0)
+	{
+		llassert(tick_seconds > 0.0);
+		llassert(num_slots > 0);
+	}
+
+	// Schedule key to expire at time due.  Deadlines that are already in
+	// the past expire on the next call to advance().
+	void schedule(const KEY& key, F64 due)
+	{
+		U64 tick = llmax(toTick(due), mCurrentTick);
+		Entry entry;
+		entry.mKey = key;
+		entry.mDue = due;
+		mSlots[tick % mSlots.size()].push_back(entry);
+		++mCount;
+	}
+
+	// Move the wheel forward to now, appending every entry due at or
+	// before now to expired.
+	void advance(F64 now, entry_list_t& expired)
+	{
+		U64 now_tick = toTick(now);
+		if (now_tick < mCurrentTick)
+		{
+			// Time went backwards, just rescan the current slot.
+			now_tick = mCurrentTick;
+		}
+
+		// The current tick is rescanned because entries later in the
+		// same tick may not have been due last time around.  A jump of a
+		// full revolution or more visits every slot exactly once.
+		U64 last_tick = llmin(now_tick, mCurrentTick + mSlots.size() - 1);
+		for (U64 tick = mCurrentTick; tick <= last_tick; ++tick)
+		{
+			expireSlot(mSlots[tick % mSlots.size()], now, expired);
+		}
+		mCurrentTick = now_tick;
+	}
+
+	void clear()
+	{
+		for (U32 i = 0; i < mSlots.size(); ++i)
+		{
+			mSlots[i].clear();
+		}
+		mCount = 0;
+	}
+
+	U32 size() const		{ return mCount; }
+	bool empty() const		{ return mCount == 0; }
+
+private:
+	U64 toTick(F64 time) const
+	{
+		return (time <= 0.0) ? 0 : (U64)(time / mTickSeconds);
+	}
+
+	void expireSlot(entry_list_t& slot, F64 now, entry_list_t& expired)
+	{
+		// Compact the survivors to the front of the slot in place.
+		U32 keep = 0;
+		for (U32 i = 0; i < slot.size(); ++i)
+		{
+			if (slot[i].mDue <= now)
+			{
+				expired.push_back(slot[i]);
+				--mCount;
+			}
+			else
+			{
+				if (keep != i)
+				{
+					slot[keep] = slot[i];
+				}
+				++keep;
+			}
+		}
+		slot.resize(keep);
+	}
+
+private:
+	F64							mTickSeconds;
+	std::vector<entry_list_t>	mSlots;
+	U64							mCurrentTick;
+	U32							mCount;
+};
+
+#endif // LL_LLTIMERWHEEL_H
@@ -29,6 +29,8 @@
 
 #include "lltransfermanager.h"
 
+#include <algorithm>
+
 #include "llerror.h"
 #include "message.h"
 #include "lldatapacker.h"
@@ -354,12 +356,12 @@ void LLTransferManager::processTransferInfo(LLMessageSystem *msgp, void **)
 		U8 tmp_data[MAX_PACKET_DATA_SIZE];
 		// See if we've got any delayed packets
 		packet_id = ttp->getNextPacketID();
-		if (ttp->mDelayedPacketMap.find(packet_id) != ttp->mDelayedPacketMap.end())
+		LLTransferPacket *packetp = ttp->takeDelayedPacket(packet_id);
+		if (packetp)
 		{
 			// Perhaps this stuff should be inside a method in LLTransferPacket?
 			// I'm too lazy to do it now, though.
 // 			llinfos << "Playing back delayed packet " << packet_id << llendl;
-			LLTransferPacket *packetp = ttp->mDelayedPacketMap[packet_id];
 
 			// This is somewhat inefficient, but avoids us having to duplicate
 			// code between the off-the-wire and delayed paths.
@@ -373,7 +375,6 @@ void LLTransferManager::processTransferInfo(LLMessageSystem *msgp, void **)
 				}
 			}
 			status = packetp->mStatus;
-			ttp->mDelayedPacketMap.erase(packet_id);
 			delete packetp;
 		}
 		else
@@ -530,12 +531,12 @@ void LLTransferManager::processTransferPacket(LLMessageSystem *msgp, void **)
 
 		// See if we've got any delayed packets
 		packet_id = ttp->getNextPacketID();
-		if (ttp->mDelayedPacketMap.find(packet_id) != ttp->mDelayedPacketMap.end())
+		LLTransferPacket *packetp = ttp->takeDelayedPacket(packet_id);
+		if (packetp)
 		{
 			// Perhaps this stuff should be inside a method in LLTransferPacket?
 			// I'm too lazy to do it now, though.
 // 			llinfos << "Playing back delayed packet " << packet_id << llendl;
-			LLTransferPacket *packetp = ttp->mDelayedPacketMap[packet_id];
 
 			// This is somewhat inefficient, but avoids us having to duplicate
 			// code between the off-the-wire and delayed paths.
@@ -549,7 +550,6 @@ void LLTransferManager::processTransferPacket(LLMessageSystem *msgp, void **)
 				}
 			}
 			status = packetp->mStatus;
-			ttp->mDelayedPacketMap.erase(packet_id);
 			delete packetp;
 		}
 		else
@@ -712,7 +712,6 @@ const S32 DEFAULT_PACKET_SIZE = 1000;
 LLTransferSourceChannel::LLTransferSourceChannel(const LLTransferChannelType channel_type, const LLHost &host) :
 	mChannelType(channel_type),
 	mHost(host),
-	mTransferSources(LLTransferSource::sSetPriority, LLTransferSource::sGetPriority),
 	mThrottleID(TC_ASSET)
 {
 }
@@ -720,21 +719,23 @@ LLTransferSourceChannel::LLTransferSourceChannel(const LLTransferChannelType cha
 
 LLTransferSourceChannel::~LLTransferSourceChannel()
 {
-	LLPriQueueMap<LLTransferSource*>::pqm_iter iter =
-		mTransferSources.mMap.begin();
-	LLPriQueueMap<LLTransferSource*>::pqm_iter end =
-		mTransferSources.mMap.end();
+	source_map_t::iterator iter = mSourceIDMap.begin();
+	source_map_t::iterator end = mSourceIDMap.end();
 	for (; iter != end; ++iter)
 	{
 		// Just kill off all of the transfers
-		(*iter).second->abortTransfer();
+		iter->second->abortTransfer();
 		delete iter->second;
 	}
-	mTransferSources.mMap.clear();
+	mSourceIDMap.clear();
+	mTransferSources.clear();
 }
 
 void LLTransferSourceChannel::updatePriority(LLTransferSource *tsp, const F32 priority)
 {
+	// A source that is in the middle of sending is off the queue, it
+	// goes back on with this priority when updateTransfers() is done.
+	tsp->setPriority(priority);
 	mTransferSources.reprioritize(priority, tsp);
 }
 
@@ -771,17 +772,20 @@ void LLTransferSourceChannel::updateTransfers()
 		return;
 	}
 
-	LLPriQueueMap<LLTransferSource *>::pqm_iter iter, next;
+	// Pop sources off in priority order until we run out of throttle, then
+	// put back the ones that are still going.  That way a frame only costs
+	// O(log n) for each source that actually gets to send.
+	mServicedSources.clear();
 
 	BOOL done = FALSE;
-	for (iter = mTransferSources.mMap.begin(); (iter != mTransferSources.mMap.end()) && !done;)
+	LLTransferSource *tsp = NULL;
+	while (!done && mTransferSources.pop(&tsp))
 	{
 		//llinfos << "LLTransferSourceChannel::updateTransfers()" << llendl;
 		// Do stuff. 
-		next = iter;
-		next++;
+		mServicedSources.push_back(tsp);
+		const S32 serviced_index = (S32)mServicedSources.size() - 1;
 
-		LLTransferSource *tsp = iter->second;
 		U8 *datap = NULL;
 		S32 data_size = 0;
 		BOOL delete_data = FALSE;
@@ -798,7 +802,6 @@ void LLTransferSourceChannel::updateTransfers()
 			// We don't have any data, but we're not done, just go on.
 			// This will presumably be used for streaming or async transfers that
 			// are stalled waiting for data from another source.
-			iter=next;
 			continue;
 		}
 
@@ -833,9 +836,8 @@ void LLTransferSourceChannel::updateTransfers()
 		{
 			//Warning!  In the case of an aborted transfer, the sendReliable call above calls 
 			//AbortTransfer which in turn calls deleteTransfer which means that somewhere way 
-			//down the chain our current iter can get invalidated resulting in an infrequent
+			//down the chain our current source gets deleted resulting in an infrequent
 			//sim crash.  This check gets us to a valid transfer source in this event.
-			iter=next;
 			continue;
 		}
 
@@ -854,10 +856,9 @@ void LLTransferSourceChannel::updateTransfers()
 			// We need to clean up this transfer source.
 			//llinfos << "LLTransferSourceChannel::updateTransfers() " << tsp->getID() << " done" << llendl;
 			tsp->completionCallback(status);
+			mServicedSources[serviced_index] = NULL;
+			mSourceIDMap.erase(transaction_id);
 			delete tsp;
-			
-			mTransferSources.mMap.erase(iter);
-			iter = next;
 			break;
 		default:
 			llerrs << "Unknown transfer error code!" << llendl;
@@ -867,26 +868,35 @@ void LLTransferSourceChannel::updateTransfers()
 		// streaming transfers will adjust priority based on how much they've sent and time,
 		// but I'm not going to bother yet. - djs.
 	}
+
+	// Requeue everything that got a turn.  They go to the back of their
+	// priority class, so equal priority transfers take turns.
+	for (std::vector<LLTransferSource *>::iterator iter = mServicedSources.begin();
+		 iter != mServicedSources.end(); ++iter)
+	{
+		if (*iter)
+		{
+			mTransferSources.push((*iter)->getPriority(), *iter);
+		}
+	}
+	mServicedSources.clear();
 }
 
 
 void LLTransferSourceChannel::addTransferSource(LLTransferSource *sourcep)
 {
 	sourcep->mChannelp = this;
+	mSourceIDMap[sourcep->getID()] = sourcep;
 	mTransferSources.push(sourcep->getPriority(), sourcep);
 }
 
 
 LLTransferSource *LLTransferSourceChannel::findTransferSource(const LLUUID &transfer_id)
 {
-	LLPriQueueMap<LLTransferSource *>::pqm_iter iter;
-	for (iter = mTransferSources.mMap.begin(); iter != mTransferSources.mMap.end(); iter++)
+	source_map_t::iterator iter = mSourceIDMap.find(transfer_id);
+	if (iter != mSourceIDMap.end())
 	{
-		LLTransferSource *tsp = iter->second;
-		if (tsp->getID() == transfer_id)
-		{
-			return tsp;
-		}
+		return iter->second;
 	}
 	return NULL;
 }
@@ -894,20 +904,26 @@ LLTransferSource *LLTransferSourceChannel::findTransferSource(const LLUUID &tran
 
 BOOL LLTransferSourceChannel::deleteTransfer(LLTransferSource *tsp)
 {
+	source_map_t::iterator iter = mSourceIDMap.find(tsp->getID());
+	if ((iter == mSourceIDMap.end()) || (iter->second != tsp))
+	{
+		llerrs << "Unable to find transfer source to delete!" << llendl;
+		return FALSE;
+	}
+	mSourceIDMap.erase(iter);
 
-	LLPriQueueMap<LLTransferSource *>::pqm_iter iter;
-	for (iter = mTransferSources.mMap.begin(); iter != mTransferSources.mMap.end(); iter++)
+	if (!mTransferSources.erase(tsp))
 	{
-		if (iter->second == tsp)
+		// Not on the queue, so updateTransfers() is sending for it.
+		std::vector<LLTransferSource *>::iterator serviced =
+			std::find(mServicedSources.begin(), mServicedSources.end(), tsp);
+		if (serviced != mServicedSources.end())
 		{
-			delete tsp;
-			mTransferSources.mMap.erase(iter);
-			return TRUE;
+			*serviced = NULL;
 		}
 	}
-
-	llerrs << "Unable to find transfer source to delete!" << llendl;
-	return FALSE;
+	delete tsp;
+	return TRUE;
 }
 
 
@@ -927,8 +943,8 @@ LLTransferTargetChannel::~LLTransferTargetChannel()
 	for (iter = mTransferTargets.begin(); iter != mTransferTargets.end(); iter++)
 	{
 		// Abort all of the current transfers
-		(*iter)->abortTransfer();
-		delete *iter;
+		iter->second->abortTransfer();
+		delete iter->second;
 	}
 	mTransferTargets.clear();
 }
@@ -989,20 +1005,16 @@ void LLTransferTargetChannel::sendTransferRequest(LLTransferTarget *targetp,
 void LLTransferTargetChannel::addTransferTarget(LLTransferTarget *targetp)
 {
 	targetp->mChannelp = this;
-	mTransferTargets.push_back(targetp);
+	mTransferTargets[targetp->getID()] = targetp;
 }
 
 
 LLTransferTarget *LLTransferTargetChannel::findTransferTarget(const LLUUID &transfer_id)
 {
-	tt_iter iter;
-	for (iter = mTransferTargets.begin(); iter != mTransferTargets.end(); iter++)
+	tt_iter iter = mTransferTargets.find(transfer_id);
+	if (iter != mTransferTargets.end())
 	{
-		LLTransferTarget *ttp = *iter;
-		if (ttp->getID() == transfer_id)
-		{
-			return ttp;
-		}
+		return iter->second;
 	}
 	return NULL;
 }
@@ -1010,15 +1022,12 @@ LLTransferTarget *LLTransferTargetChannel::findTransferTarget(const LLUUID &tran
 
 BOOL LLTransferTargetChannel::deleteTransfer(LLTransferTarget *ttp)
 {
-	tt_iter iter;
-	for (iter = mTransferTargets.begin(); iter != mTransferTargets.end(); iter++)
+	tt_iter iter = mTransferTargets.find(ttp->getID());
+	if ((iter != mTransferTargets.end()) && (iter->second == ttp))
 	{
-		if (*iter == ttp)
-		{
-			delete ttp;
-			mTransferTargets.erase(iter);
-			return TRUE;
-		}
+		delete ttp;
+		mTransferTargets.erase(iter);
+		return TRUE;
 	}
 
 	llerrs << "Unable to find transfer target to delete!" << llendl;
@@ -1138,20 +1147,6 @@ LLTransferSource *LLTransferSource::createSource(const LLTransferSourceType styp
 }
 
 
-// static
-void LLTransferSource::sSetPriority(LLTransferSource *&tsp, const F32 priority)
-{
-	tsp->setPriority(priority);
-}
-
-
-// static
-F32 LLTransferSource::sGetPriority(LLTransferSource *&tsp)
-{
-	return tsp->getPriority();
-}
-
-
 //
 // LLTransferPacket implementation
 //
@@ -1193,8 +1188,10 @@ LLTransferTarget::LLTransferTarget(
 	mChannelp(NULL),
 	mGotInfo(FALSE),
 	mSize(0),
-	mLastPacketID(-1)
+	mLastPacketID(-1),
+	mNumDelayedPackets(0)
 {
+	memset(mDelayedPackets, 0, sizeof(mDelayedPackets));
 }
 
 LLTransferTarget::~LLTransferTarget()
@@ -1202,12 +1199,12 @@ LLTransferTarget::~LLTransferTarget()
 	// No actual cleanup of the transfer is done here, this is purely for
 	// memory cleanup.  The completionCallback is guaranteed to get called
 	// before this happens.
-	tpm_iter iter;
-	for (iter = mDelayedPacketMap.begin(); iter != mDelayedPacketMap.end(); iter++)
+	for (S32 i = 0; i < LL_MAX_DELAYED_PACKETS; i++)
 	{
-		delete iter->second;
+		delete mDelayedPackets[i];
+		mDelayedPackets[i] = NULL;
 	}
-	mDelayedPacketMap.clear();
+	mNumDelayedPackets = 0;
 }
 
 // This should never be called directly, the transfer manager is responsible for
@@ -1232,28 +1229,49 @@ bool LLTransferTarget::addDelayedPacket(
 	U8* datap,
 	const S32 size)
 {
-	const transfer_packet_map::size_type LL_MAX_DELAYED_PACKETS = 100;
-	if(mDelayedPacketMap.size() > LL_MAX_DELAYED_PACKETS)
+	S32 ahead = packet_id - getNextPacketID();
+	if ((ahead < 0) || (ahead >= LL_MAX_DELAYED_PACKETS))
 	{
-		// too many delayed packets
+		// too far ahead of the packet we're waiting for, or already played
 		return false;
 	}
 
-	LLTransferPacket* tpp = new LLTransferPacket(
+	LLTransferPacket*& slot = mDelayedPackets[packet_id % LL_MAX_DELAYED_PACKETS];
+	if (slot)
+	{
+#ifdef _DEBUG
+		llerrs << "Packet ALREADY in delayed packet map!" << llendl;
+#endif
+		delete slot;
+		mNumDelayedPackets--;
+	}
+
+	slot = new LLTransferPacket(
 		packet_id,
 		status,
 		datap,
 		size);
+	mNumDelayedPackets++;
+	return true;
+}
 
-#ifdef _DEBUG
-	if (mDelayedPacketMap.find(packet_id) != mDelayedPacketMap.end())
+
+LLTransferPacket *LLTransferTarget::takeDelayedPacket(const S32 packet_id)
+{
+	if (!mNumDelayedPackets || (packet_id < 0))
 	{
-		llerrs << "Packet ALREADY in delayed packet map!" << llendl;
+		return NULL;
 	}
-#endif
 
-	mDelayedPacketMap[packet_id] = tpp;
-	return true;
+	LLTransferPacket*& slot = mDelayedPackets[packet_id % LL_MAX_DELAYED_PACKETS];
+	if (!slot || (slot->mPacketID != packet_id))
+	{
+		return NULL;
+	}
+	LLTransferPacket *packetp = slot;
+	slot = NULL;
+	mNumDelayedPackets--;
+	return packetp;
 }
 
 
@@ -30,11 +30,13 @@
 
 #include <map>
 #include <list>
+#include <vector>
+#include <boost/unordered_map.hpp>
 
 #include "llhost.h"
 #include "lluuid.h"
 #include "llthrottle.h"
-#include "llpriqueuemap.h"
+#include "llindexedpriqueue.h"
 #include "llassettype.h"
 
 //
@@ -207,11 +209,16 @@ public:
 	LLHost					getHost() const				{ return mHost; }
 
 protected:
-	typedef std::list<LLTransferSource *>::iterator ts_iter;
+	typedef boost::unordered_map<LLUUID, LLTransferSource *> source_map_t;
 
 	LLTransferChannelType				mChannelType;
 	LLHost								mHost;
-	LLPriQueueMap<LLTransferSource*>	mTransferSources;
+	LLIndexedPriQueue<LLTransferSource*>	mTransferSources;	// Waiting to send, highest priority first
+	source_map_t						mSourceIDMap;		// Every source on this channel, by transfer id
+
+	// Popped off mTransferSources while updateTransfers() sends their
+	// packets, pushed back once it's done.  Deleted sources are NULLed.
+	std::vector<LLTransferSource *>		mServicedSources;
 
 	// The throttle that this source channel should use
 	S32									mThrottleID;
@@ -248,11 +255,12 @@ protected:
 	friend class LLTransferTarget;
 	friend class LLTransferManager;
 protected:
-	typedef std::list<LLTransferTarget *>::iterator tt_iter;
+	typedef boost::unordered_map<LLUUID, LLTransferTarget *> target_map_t;
+	typedef target_map_t::iterator tt_iter;
 
 	LLTransferChannelType			mChannelType;
 	LLHost							mHost;
-	std::list<LLTransferTarget *>	mTransferTargets;
+	target_map_t					mTransferTargets;
 };
 
 
@@ -323,8 +331,6 @@ protected:
 										  const F32 priority);
 	static void registerSourceType(const LLTransferSourceType stype, LLTransferSourceCreateFunc);
 
-	static void sSetPriority(LLTransferSource *&tsp, const F32 priority);
-	static F32	sGetPriority(LLTransferSource *&tsp);
 protected:
 	typedef std::map<LLTransferSourceType, LLTransferSourceCreateFunc> stype_scfunc_map;
 	static stype_scfunc_map sSourceCreateMap;
@@ -348,6 +354,10 @@ protected:
 };
 
 
+// How far past the next expected packet a target will buffer packets
+// that arrive out of order.
+const S32 LL_MAX_DELAYED_PACKETS = 256;
+
 class LLTransferPacket
 {
 	// Used for storing a packet that's being delivered later because it's out of order.
@@ -417,9 +427,11 @@ protected:
 		U8* datap,
 		const S32 size);
 
+	// Hands back the delayed packet with this id, which the caller then
+	// owns, or NULL if it hasn't arrived yet.
+	LLTransferPacket *takeDelayedPacket(const S32 packet_id);
+
 protected:
-	typedef std::map<S32, LLTransferPacket *> transfer_packet_map;
-	typedef std::map<S32, LLTransferPacket *>::iterator tpm_iter;
 
 	LLTransferTargetType	mType;
 	LLTransferSourceType mSourceType;
@@ -429,7 +441,11 @@ protected:
 	S32						mSize;
 	S32						mLastPacketID;
 
-	transfer_packet_map		mDelayedPacketMap; // Packets that are waiting because of missing/out of order issues
+	// Packets that are waiting because of missing/out of order issues,
+	// slot packet_id % LL_MAX_DELAYED_PACKETS.  Only packets less than a
+	// ring ahead of the next expected one are accepted, so slots never collide.
+	LLTransferPacket		*mDelayedPackets[LL_MAX_DELAYED_PACKETS];
+	S32						mNumDelayedPackets;
 };
 
 
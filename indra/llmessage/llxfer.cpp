@@ -35,6 +35,11 @@
 //number of bytes sent in each message
 const U32 LL_XFER_CHUNK_SIZE = 1000;
 
+static F64 xfer_time_seconds()
+{
+	return (F64)totalTime() * SEC_PER_USEC;
+}
+
 const U32 LLXfer::XFER_FILE = 1;
 const U32 LLXfer::XFER_VFILE = 2;
 const U32 LLXfer::XFER_MEM = 3;
@@ -77,6 +82,10 @@ void LLXfer::init (S32 chunk_size)
 
 	mRetries = 0;
 
+	mWindowed = FALSE;
+	mWindow.reset();
+	mOutOfOrderPackets.clear();
+
 	if (chunk_size < 1)
 	{
 		chunk_size = LL_XFER_CHUNK_SIZE;
@@ -93,6 +102,7 @@ void LLXfer::cleanup ()
 		delete[] mBuffer;
 		mBuffer = NULL;
 	}
+	mOutOfOrderPackets.clear();
 }
 
 ///////////////////////////////////////////////////////////
@@ -281,6 +291,101 @@ void LLXfer::resendLastPacket()
 
 ///////////////////////////////////////////////////////////
 
+void LLXfer::startWindow()
+{
+	mWindowed = TRUE;
+	mWindow.reset();
+	if (!mRetries)
+	{
+		// The packet just confirmed went out once, so it gives us a
+		// round trip time to start from.
+		mWindow.addRTTSample(ACKTimer.getElapsedTimeF32());
+	}
+	mWaitingForACK = FALSE;
+}
+
+///////////////////////////////////////////////////////////
+
+void LLXfer::confirmWindowPacket(S32 packet_num)
+{
+	F64 now = xfer_time_seconds();
+	mWindow.packetConfirmed(packet_num, now);
+
+	// Top the window back up.
+	while ((mStatus == e_LL_XFER_IN_PROGRESS) && mWindow.canSend(mPacketNum + 1))
+	{
+		mRetries = 0;
+		sendPacket(++mPacketNum);
+		if (mStatus == e_LL_XFER_ABORTED)
+		{
+			return;
+		}
+		mWindow.packetSent(mPacketNum, now);
+	}
+	mWaitingForACK = FALSE;
+}
+
+///////////////////////////////////////////////////////////
+
+S32 LLXfer::retransmitWindow()
+{
+	std::vector<S32> expired;
+	S32 max_retries = mWindow.collectExpired(xfer_time_seconds(), expired);
+	for (std::vector<S32>::iterator iter = expired.begin(); iter != expired.end(); ++iter)
+	{
+		// sendPacket() decides whether we are done from the packet it
+		// sends, which is wrong for anything but the newest one.
+		ELLXferStatus status = mStatus;
+		sendPacket(*iter);
+		if (mStatus == e_LL_XFER_ABORTED)
+		{
+			break;
+		}
+		mStatus = status;
+	}
+	mWaitingForACK = FALSE;
+	mRetries = max_retries;
+	return max_retries;
+}
+
+///////////////////////////////////////////////////////////
+
+BOOL LLXfer::isWindowComplete() const
+{
+	// Everything has been sent, and all of it confirmed.
+	return (mStatus == e_LL_XFER_COMPLETE) && mWindow.isEmpty();
+}
+
+///////////////////////////////////////////////////////////
+
+void LLXfer::bufferPacket(S32 packet_num, const char* datap, S32 data_size)
+{
+	S32 decoded = packet_num & ~0x80000000;
+	if (mOutOfOrderPackets.find(decoded) == mOutOfOrderPackets.end())
+	{
+		std::pair<S32, std::string>& entry = mOutOfOrderPackets[decoded];
+		entry.first = packet_num;
+		entry.second.assign(datap, data_size);
+	}
+}
+
+///////////////////////////////////////////////////////////
+
+BOOL LLXfer::popBufferedPacket(S32 packet_num, S32& encoded_packet_num, std::string& data)
+{
+	packet_buffer_t::iterator iter = mOutOfOrderPackets.find(packet_num);
+	if (iter == mOutOfOrderPackets.end())
+	{
+		return FALSE;
+	}
+	encoded_packet_num = iter->second.first;
+	data.swap(iter->second.second);
+	mOutOfOrderPackets.erase(iter);
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////
+
 S32 LLXfer::processEOF()
 {
 	S32 retval = 0;
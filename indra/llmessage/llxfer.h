@@ -29,6 +29,7 @@
 
 #include "message.h"
 #include "lltimer.h"
+#include "llxferwindow.h"
 
 const S32 LL_XFER_LARGE_PAYLOAD = 7680;
 
@@ -72,6 +73,18 @@ class LLXfer
 	LLTimer ACKTimer;
 	S32 mRetries;
 
+	// Sending side: set once the receiver has confirmed a packet with
+	// LL_XFER_WINDOWED_FLAG, after which up to a window's worth of packets
+	// are kept in flight instead of waiting for each confirm.
+	BOOL mWindowed;
+	LLXferWindow mWindow;
+
+	// Receiving side: packets that a windowed sender got to us ahead of
+	// mPacketNum, keyed by packet number.  The stored packet number still
+	// carries the EOF bit.
+	typedef std::map<S32, std::pair<S32, std::string> > packet_buffer_t;
+	packet_buffer_t mOutOfOrderPackets;
+
 	static const U32 XFER_FILE;
 	static const U32 XFER_VFILE;
 	static const U32 XFER_MEM;
@@ -89,6 +102,14 @@ class LLXfer
 	virtual void sendPacket(S32 packet_num);
 	virtual void sendNextPacket();
 	virtual void resendLastPacket();
+
+	void startWindow();
+	void confirmWindowPacket(S32 packet_num);
+	S32 retransmitWindow();		// returns the highest retry count of the packets resent
+	BOOL isWindowComplete() const;
+
+	void bufferPacket(S32 packet_num, const char* datap, S32 data_size);
+	BOOL popBufferedPacket(S32 packet_num, S32& encoded_packet_num, std::string& data);
 	virtual S32 processEOF();
 	virtual S32 startDownload();
 	virtual S32 receiveData (char *datap, S32 data_size);
@@ -77,6 +77,10 @@ void LLXferManager::init (LLVFS *vfs)
 	// Turn on or off ack throttling
 	mUseAckThrottling = FALSE;
 	setAckThrottleBPS(100000);
+
+	// Windowed xfers fall back to stop-and-wait on their own when
+	// the other end doesn't support them.
+	mUseWindowedXfers = TRUE;
 }
 	
 ///////////////////////////////////////////////////////////
@@ -144,6 +148,13 @@ void LLXferManager::setAckThrottleBPS(const F32 bps)
 }
 
 
+///////////////////////////////////////////////////////////
+
+void LLXferManager::setUseWindowedXfers(const BOOL use)
+{
+	mUseWindowedXfers = use;
+}
+
 ///////////////////////////////////////////////////////////
 
 void LLXferManager::updateHostStatus()
@@ -622,14 +633,28 @@ void LLXferManager::processReceiveData (LLMessageSystem *mesgsys, void ** /*user
 		return;
 	}
 
-	S32 xfer_size;
-
-	if (decodePacketNum(packetnum) != xferp->mPacketNum) // is the packet different from what we were expecting?
+	S32 packet = decodePacketNum(packetnum);
+	if (packet != xferp->mPacketNum) // is the packet different from what we were expecting?
 	{
-		// confirm it if it was a resend of the last one, since the confirmation might have gotten dropped
-		if (decodePacketNum(packetnum) == (xferp->mPacketNum - 1))
+		if (packet < xferp->mPacketNum)
+		{
+			// confirm it if it was a resend, since the confirmation might have gotten dropped
+			if (packet >= xferp->mPacketNum - LL_XFER_MAX_WINDOW)
+			{
+				llinfos << "Reconfirming xfer " << xferp->mRemoteHost << ":" << xferp->getFileName() << " packet " << packetnum << llendl;
+				sendConfirmPacket(mesgsys, id, packet, mesgsys->getSender());
+			}
+			else
+			{
+				llinfos << "Ignoring xfer " << xferp->mRemoteHost << ":" << xferp->getFileName() << " recv'd packet " << packetnum << "; expecting " << xferp->mPacketNum << llendl;
+			}
+		}
+		else if (mUseWindowedXfers && (packet < xferp->mPacketNum + LL_XFER_MAX_WINDOW))
 		{
-			llinfos << "Reconfirming xfer " << xferp->mRemoteHost << ":" << xferp->getFileName() << " packet " << packetnum << llendl; 			sendConfirmPacket(mesgsys, id, decodePacketNum(packetnum), mesgsys->getSender());
+			// A windowed sender got ahead of us, hold on to the packet
+			// until the gap in front of it is filled.
+			xferp->bufferPacket(packetnum, fdata_buf, llclamp(fdata_size, 0, BUF_SIZE));
+			confirmPacket(mesgsys, id, packet, mesgsys->getSender());
 		}
 		else
 		{
@@ -638,54 +663,90 @@ void LLXferManager::processReceiveData (LLMessageSystem *mesgsys, void ** /*user
 		return;		
 	}
 
+	S32 result = receivePacket(xferp, packetnum, fdata_buf, fdata_size);
+	if (result == LL_ERR_CANNOT_OPEN_FILE)
+	{
+			xferp->abort(LL_ERR_CANNOT_OPEN_FILE);
+			removeXfer(xferp,&mReceiveList);
+			startPendingDownloads();
+			return;		
+	}
+
+	confirmPacket(mesgsys, id, packet, mesgsys->getSender());
+
+	// Anything buffered that is now in sequence goes straight through,
+	// it was confirmed when it arrived.
+	std::string buffered;
+	while (!isLastPacket(packetnum)
+		   && xferp->popBufferedPacket(xferp->mPacketNum, packetnum, buffered))
+	{
+		// An empty packet has nothing to copy but still needs a buffer.
+		char* datap = buffered.empty() ? fdata_buf : &buffered[0];
+		result = receivePacket(xferp, packetnum, datap, (S32)buffered.size());
+		if (result == LL_ERR_CANNOT_OPEN_FILE)
+		{
+			xferp->abort(LL_ERR_CANNOT_OPEN_FILE);
+			removeXfer(xferp,&mReceiveList);
+			startPendingDownloads();
+			return;		
+		}
+	}
+
+	if (isLastPacket(packetnum))
+	{
+		xferp->processEOF();
+		removeXfer(xferp,&mReceiveList);
+		startPendingDownloads();
+	}
+}
+
+///////////////////////////////////////////////////////////
+
+S32 LLXferManager::receivePacket(LLXfer *xferp, S32 packetnum, char *datap, S32 data_size)
+{
 	S32 result = 0;
 
 	if (xferp->mPacketNum == 0) // first packet has size encoded as additional S32 at beginning of data
 	{
-		ntohmemcpy(&xfer_size,fdata_buf,MVT_S32,sizeof(S32));
+		S32 xfer_size;
+		ntohmemcpy(&xfer_size,datap,MVT_S32,sizeof(S32));
 		
 // do any necessary things on first packet ie. allocate memory
 		xferp->setXferSize(xfer_size);
 
 		// adjust buffer start and size
-		result = xferp->receiveData(&(fdata_buf[sizeof(S32)]),fdata_size-(sizeof(S32)));
+		result = xferp->receiveData(&(datap[sizeof(S32)]),data_size-(sizeof(S32)));
 	}
 	else
 	{
-		result = xferp->receiveData(fdata_buf,fdata_size);
+		result = xferp->receiveData(datap,data_size);
 	}
-	
-	if (result == LL_ERR_CANNOT_OPEN_FILE)
+
+	if (result != LL_ERR_CANNOT_OPEN_FILE)
 	{
-			xferp->abort(LL_ERR_CANNOT_OPEN_FILE);
-			removeXfer(xferp,&mReceiveList);
-			startPendingDownloads();
-			return;		
+		xferp->mPacketNum++;  // expect next packet
 	}
+	return result;
+}
 
-	xferp->mPacketNum++;  // expect next packet
+///////////////////////////////////////////////////////////
 
+void LLXferManager::confirmPacket (LLMessageSystem *mesgsys, U64 id, S32 packetnum, const LLHost &remote_host)
+{
 	if (!mUseAckThrottling)
 	{
 		// No throttling, confirm right away
-		sendConfirmPacket(mesgsys, id, decodePacketNum(packetnum), mesgsys->getSender());
+		sendConfirmPacket(mesgsys, id, packetnum, remote_host);
 	}
 	else
 	{
 		// Throttling, put on queue to be confirmed later.
 		LLXferAckInfo ack_info;
 		ack_info.mID = id;
-		ack_info.mPacketNum = decodePacketNum(packetnum);
-		ack_info.mRemoteHost = mesgsys->getSender();
+		ack_info.mPacketNum = packetnum;
+		ack_info.mRemoteHost = remote_host;
 		mXferAckQueue.push(ack_info);
 	}
-
-	if (isLastPacket(packetnum))
-	{
-		xferp->processEOF();
-		removeXfer(xferp,&mReceiveList);
-		startPendingDownloads();
-	}
 }
 
 ///////////////////////////////////////////////////////////
@@ -701,7 +762,15 @@ void LLXferManager::sendConfirmPacket (LLMessageSystem *mesgsys, U64 id, S32 pac
 	mesgsys->newMessageFast(_PREHASH_ConfirmXferPacket);
 	mesgsys->nextBlockFast(_PREHASH_XferID);
 	mesgsys->addU64Fast(_PREHASH_ID, id);
-	mesgsys->addU32Fast(_PREHASH_Packet, packetnum);
+	if (mUseWindowedXfers)
+	{
+		// Let the sender know it can keep more than one packet in flight.
+		mesgsys->addU32Fast(_PREHASH_Packet, (U32)packetnum | LL_XFER_WINDOWED_FLAG);
+	}
+	else
+	{
+		mesgsys->addU32Fast(_PREHASH_Packet, packetnum);
+	}
 
 	mesgsys->sendMessage(remote_host);
 }
@@ -977,10 +1046,33 @@ void LLXferManager::processConfirmation (LLMessageSystem *mesgsys, void ** /*use
 	mesgsys->getU64Fast(_PREHASH_XferID, _PREHASH_ID, id);
 	mesgsys->getS32Fast(_PREHASH_XferID, _PREHASH_Packet, packetNum);
 
+	BOOL windowed_peer = (packetNum & LL_XFER_WINDOWED_FLAG) != 0;
+	packetNum &= ~LL_XFER_WINDOWED_FLAG;
+
 	LLXfer* xferp = findXfer(id, mSendList);
 	if (xferp)
 	{
 //		cout << "confirmed packet #" << packetNum << " ping: "<< xferp->ACKTimer.getElapsedTimeF32() <<  endl;
+		if (!xferp->mWindowed
+			&& mUseWindowedXfers
+			&& windowed_peer
+			&& (xferp->mStatus == e_LL_XFER_IN_PROGRESS))
+		{
+			// The receiver takes packets out of order, stop waiting on
+			// each confirm from here on.
+			xferp->startWindow();
+		}
+
+		if (xferp->mWindowed)
+		{
+			xferp->confirmWindowPacket(packetNum);
+			if (xferp->isWindowComplete() || (xferp->mStatus == e_LL_XFER_ABORTED))
+			{
+				removeXfer(xferp, &mSendList);
+			}
+			return;
+		}
+
 		xferp->mWaitingForACK = FALSE;
 		if (xferp->mStatus == e_LL_XFER_IN_PROGRESS)
 		{
@@ -1025,7 +1117,25 @@ void LLXferManager::retransmitUnackedPackets ()
 	F32 et;
 	while (xferp)
 	{
-		if (xferp->mWaitingForACK && ( (et = xferp->ACKTimer.getElapsedTimeF32()) > LL_PACKET_TIMEOUT))
+		if (xferp->mWindowed
+			&& ((xferp->mStatus == e_LL_XFER_IN_PROGRESS) || (xferp->mStatus == e_LL_XFER_COMPLETE)))
+		{
+			// Windowed xfers time out each packet in flight on its own,
+			// based on the measured round trip time.
+			if (xferp->retransmitWindow() > LL_PACKET_RETRY_LIMIT)
+			{
+				llinfos << "dropping xfer " << xferp->mRemoteHost << ":" << xferp->getFileName() << " packet retransmit limit exceeded, xfer dropped" << llendl;
+				xferp->abort(LL_ERR_TCP_TIMEOUT);
+				delp = xferp;
+				xferp = xferp->mNext;
+				removeXfer(delp,&mSendList);
+			}
+			else
+			{
+				xferp = xferp->mNext;
+			}
+		}
+		else if (xferp->mWaitingForACK && ( (et = xferp->ACKTimer.getElapsedTimeF32()) > LL_PACKET_TIMEOUT))
 		{
 			if (xferp->mRetries > LL_PACKET_RETRY_LIMIT)
 			{
@@ -80,6 +80,7 @@ class LLXferManager
 	S32    mMaxIncomingXfers;
 
 	BOOL	mUseAckThrottling; // Use ack throttling to cap file xfer bandwidth
+	BOOL	mUseWindowedXfers; // Accept and send packets out of order when the other end can too
 	LLLinkedQueue<LLXferAckInfo> mXferAckQueue;
 	LLThrottle mAckThrottle;
  public:
@@ -115,6 +116,7 @@ class LLXferManager
 
 	void setUseAckThrottling(const BOOL use);
 	void setAckThrottleBPS(const F32 bps);
+	void setUseWindowedXfers(const BOOL use);
 
 // list management routines
 	virtual LLXfer *findXfer(U64 id, LLXfer *list_head);
@@ -195,6 +197,8 @@ class LLXferManager
 
 	virtual void processReceiveData (LLMessageSystem *mesgsys, void **user_data);
 	virtual void sendConfirmPacket (LLMessageSystem *mesgsys, U64 id, S32 packetnum, const LLHost &remote_host);
+	void confirmPacket (LLMessageSystem *mesgsys, U64 id, S32 packetnum, const LLHost &remote_host);
+	S32 receivePacket (LLXfer *xferp, S32 packetnum, char *datap, S32 data_size);
 
 // file sending routines
 	virtual void processFileRequest (LLMessageSystem *mesgsys, void **user_data);
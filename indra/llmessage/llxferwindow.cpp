@@ -0,0 +1,160 @@
+/**
+ * @file llxferwindow.cpp
+ * @brief Sliding window and congestion control for windowed xfers
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llxferwindow.h"
+
+#include "llmath.h"
+
+const F32 LL_XFER_INITIAL_SSTHRESH = 32.f;
+const F32 LL_XFER_MIN_RTO = 0.2f;		// seconds
+const F32 LL_XFER_MAX_RTO = 3.f;		// seconds, same as the stop-and-wait packet timeout
+const F32 LL_XFER_RTT_ALPHA = 0.125f;	// RFC 2988 smoothing constants
+const F32 LL_XFER_RTT_BETA = 0.25f;
+
+LLXferWindow::LLXferWindow()
+:	mMaxWindow(LL_XFER_MAX_WINDOW)
+{
+	reset();
+}
+
+void LLXferWindow::reset()
+{
+	mInFlight.clear();
+	mWindow = 1.f;
+	mSlowStartThreshold = LL_XFER_INITIAL_SSTHRESH;
+	mSmoothedRTT = -1.f;
+	mRTTVariance = 0.f;
+	mLastBackoffTime = 0.0;
+	mNumResent = 0;
+}
+
+void LLXferWindow::setMaxWindow(S32 max_window)
+{
+	mMaxWindow = llclamp(max_window, 1, LL_XFER_MAX_WINDOW);
+}
+
+S32 LLXferWindow::getWindowSize() const
+{
+	return llclamp((S32)mWindow, 1, mMaxWindow);
+}
+
+F32 LLXferWindow::getRetransmitTimeout() const
+{
+	if (mSmoothedRTT < 0.f)
+	{
+		return LL_XFER_MAX_RTO;
+	}
+	return llclamp(mSmoothedRTT + 4.f * mRTTVariance, LL_XFER_MIN_RTO, LL_XFER_MAX_RTO);
+}
+
+void LLXferWindow::packetSent(S32 packet_num, F64 now)
+{
+	PacketInfo& info = mInFlight[packet_num];
+	info.mSentTime = now;
+	info.mRetries = 0;
+}
+
+BOOL LLXferWindow::canSend(S32 packet_num) const
+{
+	if ((S32)mInFlight.size() >= getWindowSize())
+	{
+		return FALSE;
+	}
+	// Nothing below the lowest packet in flight is unconfirmed.
+	return mInFlight.empty() || packet_num < mInFlight.begin()->first + LL_XFER_MAX_WINDOW;
+}
+
+BOOL LLXferWindow::packetConfirmed(S32 packet_num, F64 now)
+{
+	packet_map_t::iterator iter = mInFlight.find(packet_num);
+	if (iter == mInFlight.end())
+	{
+		return FALSE;
+	}
+
+	// Karn's rule, a resent packet's confirm could be for either copy.
+	if (!iter->second.mRetries)
+	{
+		addRTTSample((F32)(now - iter->second.mSentTime));
+	}
+	mInFlight.erase(iter);
+
+	if (mWindow < mSlowStartThreshold)
+	{
+		mWindow += 1.f;
+	}
+	else
+	{
+		mWindow += 1.f / mWindow;
+	}
+	mWindow = llmin(mWindow, (F32)mMaxWindow);
+	return TRUE;
+}
+
+void LLXferWindow::addRTTSample(F32 rtt)
+{
+	rtt = llmax(rtt, 0.f);
+	if (mSmoothedRTT < 0.f)
+	{
+		mSmoothedRTT = rtt;
+		mRTTVariance = rtt * 0.5f;
+	}
+	else
+	{
+		mRTTVariance = (1.f - LL_XFER_RTT_BETA) * mRTTVariance + LL_XFER_RTT_BETA * fabsf(mSmoothedRTT - rtt);
+		mSmoothedRTT = (1.f - LL_XFER_RTT_ALPHA) * mSmoothedRTT + LL_XFER_RTT_ALPHA * rtt;
+	}
+}
+
+S32 LLXferWindow::collectExpired(F64 now, std::vector<S32>& expired)
+{
+	S32 max_retries = 0;
+	F32 timeout = getRetransmitTimeout();
+	for (packet_map_t::iterator iter = mInFlight.begin(); iter != mInFlight.end(); ++iter)
+	{
+		PacketInfo& info = iter->second;
+		if (now - info.mSentTime > timeout)
+		{
+			info.mSentTime = now;
+			info.mRetries++;
+			max_retries = llmax(max_retries, info.mRetries);
+			expired.push_back(iter->first);
+			mNumResent++;
+		}
+	}
+
+	// Treat a burst of losses as a single congestion event, so back off
+	// at most once per round trip.
+	if (!expired.empty() && (now - mLastBackoffTime > llmax(mSmoothedRTT, LL_XFER_MIN_RTO)))
+	{
+		mSlowStartThreshold = llmax(mWindow * 0.5f, 2.f);
+		mWindow = mSlowStartThreshold;
+		mLastBackoffTime = now;
+	}
+	return max_retries;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file llxferwindow.h
+ * @brief Sliding window and congestion control for windowed xfers
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLXFERWINDOW_H
+#define LL_LLXFERWINDOW_H
+
+#include <map>
+#include <vector>
+
+// Most packets a windowed sender keeps in flight, and so the most a
+// windowed receiver has to buffer out of order.
+const S32 LL_XFER_MAX_WINDOW = 64;
+
+// Set on the packet number of every ConfirmXferPacket sent by a receiver
+// that accepts packets out of order.  Legacy senders ignore the confirmed
+// packet number entirely, so this is how a sender learns that it may
+// switch from stop-and-wait to the sliding window.
+const U32 LL_XFER_WINDOWED_FLAG = 0x40000000;
+
+// Sender side bookkeeping for a windowed xfer: which packets are in
+// flight, a smoothed round trip time to derive the retransmit timeout
+// from, and a congestion window that grows while packets get confirmed
+// and shrinks when they have to be resent.  It knows nothing about the
+// message system so that it can be driven by a simulated link in tests.
+class LLXferWindow
+{
+public:
+	LLXferWindow();
+
+	void reset();
+
+	// Cap the window, 1 gives plain stop-and-wait.
+	void setMaxWindow(S32 max_window);
+
+	// Whether packet_num may go out now: the window has room and the
+	// receiver will buffer it.  The receiver drops anything
+	// LL_XFER_MAX_WINDOW or more past the first packet it is missing.
+	BOOL canSend(S32 packet_num) const;
+	BOOL isEmpty() const				{ return mInFlight.empty(); }
+	S32 getNumInFlight() const			{ return (S32)mInFlight.size(); }
+	S32 getWindowSize() const;
+	F32 getSmoothedRTT() const			{ return mSmoothedRTT; }
+	F32 getRetransmitTimeout() const;
+	U32 getNumResent() const			{ return mNumResent; }
+
+	void packetSent(S32 packet_num, F64 now);
+
+	// Returns FALSE if the packet was not in flight, e.g. a duplicate confirm.
+	BOOL packetConfirmed(S32 packet_num, F64 now);
+
+	// Feed in a round trip time measured outside the window, e.g. from
+	// the stop-and-wait packets sent before switching to windowed mode.
+	void addRTTSample(F32 rtt);
+
+	// Collect the packets whose retransmit timer has run out, mark them
+	// as sent again at now and back off the window.  Returns the highest
+	// retry count among them.
+	S32 collectExpired(F64 now, std::vector<S32>& expired);
+
+private:
+	struct PacketInfo
+	{
+		F64 mSentTime;
+		S32 mRetries;
+	};
+	typedef std::map<S32, PacketInfo> packet_map_t;
+	packet_map_t mInFlight;
+
+	F32 mWindow;				// congestion window, in packets
+	F32 mSlowStartThreshold;	// window grows by one per confirm below this, by 1/window above it
+	S32 mMaxWindow;
+	F32 mSmoothedRTT;			// seconds, negative until the first sample
+	F32 mRTTVariance;
+	F64 mLastBackoffTime;
+	U32 mNumResent;
+};
+
+#endif // LL_LLXFERWINDOW_H
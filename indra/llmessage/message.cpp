@@ -740,7 +740,7 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 				if (cdp && recv_reliable)
 				{
 					// Add to the recently received list for duplicate suppression
-					cdp->mRecentlyReceivedReliablePackets[mCurrentRecvPacketID] = getMessageTimeUsecs();
+					cdp->mRecentlyReceivedReliablePackets.insert(mCurrentRecvPacketID);
 
 					// Put it onto the list of packets to be acked
 					cdp->collectRAck(mCurrentRecvPacketID);
@@ -1287,9 +1287,11 @@ S32 LLMessageSystem::sendMessage(const LLHost &host)
 		S32 append_ack_count = llmin(space_left, ack_count);
 		const S32 MAX_ACKS = 250;
 		append_ack_count = llmin(append_ack_count, MAX_ACKS);
-		std::vector<TPACKETID>::iterator iter = cdp->mAcks.begin();
-		std::vector<TPACKETID>::iterator last = cdp->mAcks.begin();
-		last += append_ack_count;
+		// Take the acks off the back of the list, so removing them
+		// doesn't have to shuffle the rest down.
+		std::vector<TPACKETID>::iterator first = cdp->mAcks.end() - append_ack_count;
+		std::vector<TPACKETID>::iterator iter = first;
+		std::vector<TPACKETID>::iterator last = cdp->mAcks.end();
 		TPACKETID packet_id;
 		for( ; iter != last ; ++iter)
 		{
@@ -1324,7 +1326,7 @@ S32 LLMessageSystem::sendMessage(const LLHost &host)
 		}
 
 		// clean up the source
-		cdp->mAcks.erase(cdp->mAcks.begin(), last);
+		cdp->mAcks.erase(first, last);
 
 		// tack the count in the final byte
 		U8 count = (U8)append_ack_count;
@@ -27,6 +27,8 @@
 #ifndef LL_PATCH_DCT_H
 #define LL_PATCH_DCT_H
 
+#include <vector>
+
 class LLVector3;
 
 // Code Values
@@ -88,4 +90,46 @@ void init_patch_decompressor(S32 size);
 void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph);
 void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph);
 
+// Decompression without the globals above: it keeps its own tables for
+// one patch size, so any number of threads can decompress with the same
+// one at once.  The inverse DCT does four lines at a time with SSE, in
+// the same order as the scalar code, so the heights are the same as
+// decompress_patch()'s to the bit.
+class LLPatchDecompressor
+{
+public:
+	// A patch decode_patch() has unpacked, and where its heights go
+	struct Request
+	{
+		F32				*mPatch;
+		S32				mStride;
+		LLPatchHeader	mHeader;
+		S32				mCoefficients[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	};
+
+	LLPatchDecompressor(S32 size);
+	~LLPatchDecompressor();
+
+	S32 getSize() const { return mSize; }
+
+	void decompress(F32 *patch, S32 stride, const S32 *cpatch, const LLPatchHeader *ph) const;
+	void decompressv(LLVector3 *v, S32 stride, const S32 *cpatch, const LLPatchHeader *ph) const;
+
+	// Decompresses all of them, sharing them out to LLJobScheduler's
+	// workers when it is running and there are enough to be worth it.
+	// Returns once every one is done.
+	void decompressAll(std::vector<Request> &requests) const;
+
+private:
+	// Dequantizes cpatch into block, then transforms it in place.  Returns
+	// what the heights are scaled by and offset by.
+	void decode(F32 *block, const S32 *cpatch, const LLPatchHeader *ph, F32 &mult, F32 &addval) const;
+	void idct(F32 *block) const;
+
+	S32	mSize;
+	F32	*mDequantizeTable;
+	F32	*mICosines;			// 16 byte aligned
+	S32	*mDeCopyMatrix;
+};
+
 #endif
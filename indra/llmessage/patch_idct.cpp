@@ -29,6 +29,8 @@
 #include "llmath.h"
 //#include "vmath.h"
 #include "v3math.h"
+#include "llmemory.h"
+#include "lljobscheduler.h"
 #include "patch_dct.h"
 
 LLGroupHeader	*gGOPP;
@@ -39,14 +41,14 @@ void set_group_of_patch_header(LLGroupHeader *gopp)
 }
 
 F32 gPatchDequantizeTable[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
-void build_patch_dequantize_table(S32 size)
+void build_patch_dequantize_table(F32 *table, S32 size)
 {
 	S32 i, j;
 	for (j = 0; j < size; j++)
 	{
 		for (i = 0; i < size; i++)
 		{
-			gPatchDequantizeTable[j*size + i] = (1.f + 2.f*(i+j));
+			table[j*size + i] = (1.f + 2.f*(i+j));
 		}
 	}
 }
@@ -55,7 +57,7 @@ S32	gCurrentDeSize = 0;
 
 F32	gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 
-void setup_patch_icosines(S32 size)
+void setup_patch_icosines(F32 *icosines, S32 size)
 {
 	S32 n, u;
 	F32 oosob = F_PI*0.5f/size;
@@ -64,14 +66,14 @@ void setup_patch_icosines(S32 size)
 	{
 		for (n = 0; n < size; n++)
 		{
-			gPatchICosines[u*size+n] = cosf((2.f*n+1.f)*u*oosob);
+			icosines[u*size+n] = cosf((2.f*n+1.f)*u*oosob);
 		}
 	}
 }
 
 S32	gDeCopyMatrix[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 
-void build_decopy_matrix(S32 size)
+void build_decopy_matrix(S32 *matrix, S32 size)
 {
 	S32 i, j, count;
 	BOOL	b_diag = FALSE;
@@ -84,7 +86,7 @@ void build_decopy_matrix(S32 size)
 	while (  (i < size)
 		   &&(j < size))
 	{
-		gDeCopyMatrix[j*size + i] = count;
+		matrix[j*size + i] = count;
 
 		count++;
 
@@ -140,9 +142,9 @@ void init_patch_decompressor(S32 size)
 	if (size != gCurrentDeSize)
 	{
 		gCurrentDeSize = size;
-		build_patch_dequantize_table(size);
-		setup_patch_icosines(size);
-		build_decopy_matrix(size);
+		build_patch_dequantize_table(gPatchDequantizeTable, size);
+		setup_patch_icosines(gPatchICosines, size);
+		build_decopy_matrix(gDeCopyMatrix, size);
 	}
 }
 
@@ -682,3 +684,188 @@ void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 	}
 }
 
+
+//----------------------------------------------------------------------------
+// LLPatchDecompressor
+//----------------------------------------------------------------------------
+
+// Fewer patches than this aren't worth waking the workers for
+const S32 MIN_PATCHES_TO_SHARE = 8;
+// Patches a worker takes at a time
+const S32 PATCHES_PER_TAKE = 2;
+
+LLPatchDecompressor::LLPatchDecompressor(S32 size)
+:	mSize(size)
+{
+	llassert(size == NORMAL_PATCH_SIZE || size == LARGE_PATCH_SIZE);
+	mDequantizeTable = new F32[size*size];
+	mICosines = (F32 *)ll_aligned_malloc_16(size*size*sizeof(F32));
+	mDeCopyMatrix = new S32[size*size];
+	build_patch_dequantize_table(mDequantizeTable, size);
+	setup_patch_icosines(mICosines, size);
+	build_decopy_matrix(mDeCopyMatrix, size);
+}
+
+LLPatchDecompressor::~LLPatchDecompressor()
+{
+	delete [] mDequantizeTable;
+	ll_aligned_free_16(mICosines);
+	delete [] mDeCopyMatrix;
+}
+
+void LLPatchDecompressor::idct(F32 *block) const
+{
+	// Each output is summed in the same order as idct_column() and
+	// idct_line() do it, just four of them side by side.
+	const S32 size = mSize;
+	const S32 groups = size/4;
+	const LLVector4a oo_sqrt2(OO_SQRT2);
+	LL_ALIGN_16(F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	LLVector4a total[LARGE_PATCH_SIZE/4];
+	LLVector4a value;
+	LLVector4a term;
+	S32 n, u, g;
+
+	// Columns: temp[n][c] = OO_SQRT2*block[0][c] + sum of block[u][c]*cos[u][n]
+	for (n = 0; n < size; n++)
+	{
+		for (g = 0; g < groups; g++)
+		{
+			value.load4a(block + g*4);
+			total[g].setMul(oo_sqrt2, value);
+		}
+		for (u = 1; u < size; u++)
+		{
+			const F32 *row = block + u*size;
+			const LLVector4a cosine(mICosines[u*size + n]);
+			for (g = 0; g < groups; g++)
+			{
+				value.load4a(row + g*4);
+				term.setMul(value, cosine);
+				total[g].add(term);
+			}
+		}
+		for (g = 0; g < groups; g++)
+		{
+			total[g].store4a(temp + n*size + g*4);
+		}
+	}
+
+	// Lines: block[l][n] = (OO_SQRT2*temp[l][0] + sum of temp[l][u]*cos[u][n])*2/size
+	const F32 oosob = 2.f/size;
+	for (S32 line = 0; line < size; line++)
+	{
+		const F32 *in = temp + line*size;
+		const LLVector4a first(OO_SQRT2*in[0]);
+		for (g = 0; g < groups; g++)
+		{
+			total[g] = first;
+		}
+		for (u = 1; u < size; u++)
+		{
+			const F32 *cosines = mICosines + u*size;
+			const LLVector4a coefficient(in[u]);
+			for (g = 0; g < groups; g++)
+			{
+				value.load4a(cosines + g*4);
+				term.setMul(coefficient, value);
+				total[g].add(term);
+			}
+		}
+		for (g = 0; g < groups; g++)
+		{
+			total[g].mul(oosob);
+			total[g].store4a(block + line*size + g*4);
+		}
+	}
+}
+
+void LLPatchDecompressor::decode(F32 *block, const S32 *cpatch, const LLPatchHeader *ph,
+								 F32 &mult, F32 &addval) const
+{
+	S32		prequant = (ph->quant_wbits >> 4) + 2;
+	S32		quantize = 1<<prequant;
+	F32		ooq = 1.f/(F32)quantize;
+
+	mult = ooq*ph->range;
+	addval = mult*(F32)(1<<(prequant - 1))+ph->dc_offset;
+
+	for (S32 i = 0; i < mSize*mSize; i++)
+	{
+		block[i] = cpatch[mDeCopyMatrix[i]]*mDequantizeTable[i];
+	}
+
+	idct(block);
+}
+
+void LLPatchDecompressor::decompress(F32 *patch, S32 stride, const S32 *cpatch, const LLPatchHeader *ph) const
+{
+	LL_ALIGN_16(F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	F32 mult;
+	F32 addval;
+	decode(block, cpatch, ph, mult, addval);
+
+	for (S32 j = 0; j < mSize; j++)
+	{
+		F32 *tpatch = patch + j*stride;
+		const F32 *tblock = block + j*mSize;
+		for (S32 i = 0; i < mSize; i++)
+		{
+			tpatch[i] = tblock[i]*mult+addval;
+		}
+	}
+}
+
+void LLPatchDecompressor::decompressv(LLVector3 *v, S32 stride, const S32 *cpatch, const LLPatchHeader *ph) const
+{
+	LL_ALIGN_16(F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE]);
+	F32 mult;
+	F32 addval;
+	decode(block, cpatch, ph, mult, addval);
+
+	for (S32 j = 0; j < mSize; j++)
+	{
+		LLVector3 *tvec = v + j*stride;
+		const F32 *tblock = block + j*mSize;
+		for (S32 i = 0; i < mSize; i++)
+		{
+			tvec[i].mV[VZ] = tblock[i]*mult+addval;
+		}
+	}
+}
+
+namespace
+{
+	// The patches of one decompressAll() call
+	class LLPatchRange : public LLParallelFor
+	{
+	public:
+		LLPatchRange(const LLPatchDecompressor *decompressor,
+					 std::vector<LLPatchDecompressor::Request> &requests)
+		:	mDecompressor(decompressor),
+			mRequests(requests)
+		{
+		}
+
+		/*virtual*/ void runRange(S32 begin, S32 end)
+		{
+			for (S32 i = begin; i < end; i++)
+			{
+				LLPatchDecompressor::Request &request = mRequests[i];
+				mDecompressor->decompress(request.mPatch, request.mStride,
+										  request.mCoefficients, &request.mHeader);
+			}
+		}
+
+	private:
+		const LLPatchDecompressor *mDecompressor;
+		std::vector<LLPatchDecompressor::Request> &mRequests;
+	};
+}
+
+void LLPatchDecompressor::decompressAll(std::vector<Request> &requests) const
+{
+	S32 count = (S32)requests.size();
+	LLPatchRange patches(this, requests);
+	patches.run(count, count < MIN_PATCHES_TO_SHARE ? count : PATCHES_PER_TAKE);
+}
@@ -29,12 +29,52 @@
 
 #include "../llavatarnamecache.h"
 
+#include "lluuid.h"
+#include "llframetimer.h"
+
+#include <sstream>
+#include <boost/bind.hpp>
+
 #include "../test/lltut.h"
 
 namespace tut
 {
 	struct avatarnamecache_data
 	{
+		avatarnamecache_data()
+		:	mBatchCalls(0)
+		{
+		}
+
+		LLAvatarName makeName(const std::string& username, const std::string& display_name)
+		{
+			LLAvatarName av_name;
+			av_name.mUsername = username;
+			av_name.mDisplayName = display_name;
+			av_name.mLegacyFirstName = username;
+			av_name.mLegacyLastName = "Resident";
+			av_name.mIsDisplayNameDefault = false;
+			av_name.mExpires = LLFrameTimer::getTotalSeconds() + 3600.0;
+			av_name.mNextUpdate = av_name.mExpires;
+			return av_name;
+		}
+
+		void onName(const LLUUID& agent_id, const LLAvatarName& av_name)
+		{
+			mNames.push_back(av_name);
+		}
+
+		void onBatch(const std::vector<LLUUID>& agent_ids, const std::vector<LLAvatarName>& av_names)
+		{
+			mBatchCalls++;
+			mBatchIDs = agent_ids;
+			mBatchNames = av_names;
+		}
+
+		std::vector<LLAvatarName> mNames;
+		S32 mBatchCalls;
+		std::vector<LLUUID> mBatchIDs;
+		std::vector<LLAvatarName> mBatchNames;
 	};
 	typedef test_group<avatarnamecache_data> avatarnamecache_test;
 	typedef avatarnamecache_test::object avatarnamecache_object;
@@ -99,4 +139,110 @@ namespace tut
 		valid = max_age_from_cache_control("max-age=-123", &max_age);
 		ensure("less than zero max-age is invalid", !valid);
 	}
+
+	template<> template<>
+	void avatarnamecache_object::test<3>()
+	{
+		// Binary cache round trip, and rejection of bad input
+		LLAvatarNameCache::setNameLookupURL("http://localhost/agents/");
+		LLAvatarNameCache::initClass(true);
+
+		LLUUID first_id, second_id;
+		first_id.generate();
+		second_id.generate();
+		LLAvatarNameCache::insert(first_id, makeName("bobsmith123", "Bob Smith"));
+		LLAvatarNameCache::insert(second_id, makeName("jose.sanchez", "Jos\xC3\xA9 S\xC3\xA1nchez"));
+
+		LLAvatarName temp_name = makeName("temp", "???");
+		temp_name.mIsTemporaryName = true;
+		LLUUID temp_id;
+		temp_id.generate();
+		LLAvatarNameCache::insert(temp_id, temp_name);
+
+		std::ostringstream ostr;
+		LLAvatarNameCache::exportBinaryFile(ostr);
+		std::string data = ostr.str();
+
+		LLAvatarNameCache::erase(first_id);
+		LLAvatarNameCache::erase(second_id);
+		LLAvatarNameCache::erase(temp_id);
+
+		std::istringstream truncated(data.substr(0, data.size() - 3));
+		ensure("truncated file rejected", !LLAvatarNameCache::importBinaryFile(truncated));
+		std::istringstream garbage("<llsd><map /></llsd>");
+		ensure("xml rejected", !LLAvatarNameCache::importBinaryFile(garbage));
+		std::string inflated = data;
+		const U32 huge_count = 0x7fffffff;
+		memcpy(&inflated[2 * sizeof(U32)], &huge_count, sizeof(U32));
+		std::istringstream inflated_istr(inflated);
+		ensure("impossible count rejected", !LLAvatarNameCache::importBinaryFile(inflated_istr));
+
+		std::istringstream istr(data);
+		ensure("imported", LLAvatarNameCache::importBinaryFile(istr));
+
+		LLAvatarName av_name;
+		ensure("first found", LLAvatarNameCache::get(first_id, &av_name));
+		ensure_equals("first username", av_name.mUsername, std::string("bobsmith123"));
+		ensure_equals("first display name", av_name.mDisplayName, std::string("Bob Smith"));
+		ensure_equals("first legacy last name", av_name.mLegacyLastName, std::string("Resident"));
+		ensure("second found", LLAvatarNameCache::get(second_id, &av_name));
+		ensure_equals("utf8 display name", av_name.mDisplayName, std::string("Jos\xC3\xA9 S\xC3\xA1nchez"));
+		ensure("temporary name not saved", !LLAvatarNameCache::get(temp_id, &av_name));
+	}
+
+	template<> template<>
+	void avatarnamecache_object::test<4>()
+	{
+		// A batch of cached names is delivered with one callback, in order
+		LLAvatarNameCache::setNameLookupURL("http://localhost/agents/");
+		LLAvatarNameCache::initClass(true);
+
+		std::vector<LLUUID> agent_ids(3);
+		for (U32 i = 0; i < agent_ids.size(); ++i)
+		{
+			agent_ids[i].generate();
+		}
+		LLAvatarNameCache::insert(agent_ids[0], makeName("zero", "Zero"));
+		LLAvatarNameCache::insert(agent_ids[1], makeName("one", "One"));
+		LLAvatarNameCache::insert(agent_ids[2], makeName("two", "Two"));
+
+		LLAvatarNameCache::get(agent_ids,
+			boost::bind(&avatarnamecache_data::onBatch, this, _1, _2));
+		ensure_equals("one callback", mBatchCalls, 1);
+		ensure("ids in order", mBatchIDs == agent_ids);
+		ensure_equals("names", (S32)mBatchNames.size(), 3);
+		ensure_equals("first name", mBatchNames[0].mDisplayName, std::string("Zero"));
+		ensure_equals("last name", mBatchNames[2].mDisplayName, std::string("Two"));
+	}
+
+	template<> template<>
+	void avatarnamecache_object::test<5>()
+	{
+		// A lookup that fails for an expired name hands out the old one
+		LLAvatarNameCache::setNameLookupURL("http://localhost/agents/");
+		LLAvatarNameCache::initClass(true);
+
+		std::vector<LLUUID> agent_ids(2);
+		agent_ids[0].generate();
+		agent_ids[1].generate();
+		LLAvatarName expired = makeName("old", "Old Name");
+		expired.mExpires = LLFrameTimer::getTotalSeconds() - 60.0;
+		LLAvatarNameCache::insert(agent_ids[0], expired);
+		LLAvatarNameCache::insert(agent_ids[1], makeName("fresh", "Fresh"));
+
+		LLAvatarNameCache::get(agent_ids[0],
+			boost::bind(&avatarnamecache_data::onName, this, _1, _2));
+		LLAvatarNameCache::get(agent_ids,
+			boost::bind(&avatarnamecache_data::onBatch, this, _1, _2));
+		ensure("waiting on the refresh", mNames.empty() && !mBatchCalls);
+
+		// Without an HTTP pump the request fails straight away
+		LLAvatarNameCache::idle();
+		LLAvatarNameCache::idle();
+		ensure_equals("callback fired", (S32)mNames.size(), 1);
+		ensure_equals("with the old name", mNames[0].mDisplayName, std::string("Old Name"));
+		ensure_equals("batch fired", mBatchCalls, 1);
+		ensure_equals("old name in the batch", mBatchNames[0].mDisplayName, std::string("Old Name"));
+		ensure_equals("fresh name in the batch", mBatchNames[1].mDisplayName, std::string("Fresh"));
+	}
 }
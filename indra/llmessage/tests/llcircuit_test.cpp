@@ -0,0 +1,259 @@
+/**
+ * @file llcircuit_test.cpp
+ * @brief LLCircuitData test cases.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llcircuit.h"
+
+#if !LL_WINDOWS
+#include <netinet/in.h>
+#endif
+
+#include "llapr.h"
+#include "llpacketack.h"
+#include "message.h"
+#include "net.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Opens up what LLMessageSystem reaches into while packets come and go
+	class TestCircuit : public LLCircuitData
+	{
+	public:
+		TestCircuit(const LLHost& host)
+		:	LLCircuitData(host, 0, 5.f, 100.f)
+		{
+		}
+
+		using LLCircuitData::checkPacketInID;
+		using LLCircuitData::addReliablePacket;
+		using LLCircuitData::isDuplicateResend;
+		using LLCircuitData::collectRAck;
+
+		// What LLMessageSystem::checkMessages() does with a reliable packet
+		void receiveReliable(TPACKETID id, BOOL resent)
+		{
+			checkPacketInID(id, resent);
+			mRecentlyReceivedReliablePackets.insert(id);
+		}
+
+		bool isPotentiallyLost(TPACKETID id) const	{ return mPotentialLostPackets.count(id) != 0; }
+		S32 getPotentiallyLost() const				{ return (S32)mPotentialLostPackets.size(); }
+		TPACKETID getPacketInID() const				{ return mPacketsInID; }
+		S32 getAckCount() const						{ return (S32)mAcks.size(); }
+	};
+
+	std::vector<S32> sResults;
+
+	void packet_callback(void** data, S32 result)
+	{
+		sResults.push_back(result);
+	}
+
+	// A reliable packet as it goes out on the wire
+	void add_packet(TestCircuit& circuit, TPACKETID id, S32 retries, F32 timeout)
+	{
+		U8 buffer[LL_PACKET_ID_SIZE + 4];
+		memset(buffer, 0, sizeof(buffer));
+		buffer[0] = LL_RELIABLE_FLAG;
+		*((U32*)(&buffer[PHL_PACKET_ID])) = htonl(id);
+
+		LLReliablePacketParams params;
+		params.set(circuit.getHost(), retries, FALSE, timeout, packet_callback, NULL, NULL);
+		circuit.addReliablePacket(0, buffer, sizeof(buffer), &params);
+	}
+
+	// resendUnackedPackets() answers with what is still unacked, count
+	// what actually went out again instead
+	S32 resend(TestCircuit& circuit, F64 now)
+	{
+		const U32 before = gMessageSystem->mResentPackets;
+		circuit.resendUnackedPackets(now);
+		return (S32)(gMessageSystem->mResentPackets - before);
+	}
+}
+
+namespace tut
+{
+	struct circuit_data
+	{
+		circuit_data()
+		:	mHost("127.0.0.1", 13021)
+		{
+			if (!gAPRPoolp)
+			{
+				ll_init_apr();
+			}
+			if (!gMessageSystem)
+			{
+				// No templates and whatever port the OS hands out, the
+				// circuits only need the packet ring and the circuit list
+				gMessageSystem = new LLMessageSystem("no_message_template.msg", NET_USE_OS_ASSIGNED_PORT,
+													 1, 0, 0, false, 5.f, 100.f);
+			}
+			sResults.clear();
+		}
+
+		LLHost mHost;
+	};
+	typedef test_group<circuit_data> circuit_test;
+	typedef circuit_test::object circuit_object;
+	tut::circuit_test circuit_testcase("LLCircuitData");
+
+	template<> template<>
+	void circuit_object::test<1>()
+	{
+		// Packets arrive out of order and with a hole in them.  Those
+		// skipped over are held as possibly lost until they turn up late or
+		// are resent.
+		TestCircuit circuit(mHost);
+		circuit.receiveReliable(1, FALSE);
+		circuit.receiveReliable(2, FALSE);
+		ensure_equals("in order", circuit.getPacketInID(), (TPACKETID)3);
+
+		circuit.receiveReliable(5, FALSE);
+		ensure_equals("skipped ahead", circuit.getPacketInID(), (TPACKETID)6);
+		ensure_equals("two missing", circuit.getPotentiallyLost(), 2);
+		ensure("3 missing", circuit.isPotentiallyLost(3));
+		ensure("4 missing", circuit.isPotentiallyLost(4));
+
+		// 4 was only reordered
+		circuit.receiveReliable(4, FALSE);
+		ensure("4 arrived late", !circuit.isPotentiallyLost(4));
+		ensure_equals("late packet doesn't move the window", circuit.getPacketInID(), (TPACKETID)6);
+
+		circuit.receiveReliable(6, FALSE);
+		// 3 was lost and comes back as a resend
+		circuit.receiveReliable(3, TRUE);
+		ensure_equals("nothing missing", circuit.getPotentiallyLost(), 0);
+		ensure_equals("all counted", circuit.getPacketsIn(), (U32)6);
+
+		// A resend of something that never looked lost, its original
+		// having gone missing before 7 was due, doesn't open a gap
+		circuit.receiveReliable(9, TRUE);
+		ensure_equals("resend leaves the window", circuit.getPacketInID(), (TPACKETID)7);
+		ensure_equals("resend leaves no gap", circuit.getPotentiallyLost(), 0);
+	}
+
+	template<> template<>
+	void circuit_object::test<2>()
+	{
+		// Resent copies of reliable packets already taken are duplicates
+		// until they fall out of the history
+		TestCircuit circuit(mHost);
+		for (TPACKETID id = 1; id <= 20; ++id)
+		{
+			if (id != 10)
+			{
+				circuit.receiveReliable(id, FALSE);
+			}
+		}
+		ensure("taken", circuit.isDuplicateResend(5));
+		ensure("lost isn't a duplicate", !circuit.isDuplicateResend(10));
+
+		circuit.receiveReliable(10, TRUE);
+		ensure("resend taken", circuit.isDuplicateResend(10));
+		ensure("newer not seen", !circuit.isDuplicateResend(21));
+
+		// The sender has everything up to 15 acked
+		circuit.clearDuplicateList(15);
+		ensure("forgotten", !circuit.isDuplicateResend(5));
+		ensure("kept", circuit.isDuplicateResend(17));
+	}
+
+	template<> template<>
+	void circuit_object::test<3>()
+	{
+		// A reliable packet goes out again each time its timeout passes,
+		// until it runs out of retries and fails
+		TestCircuit circuit(mHost);
+		const F64 start = LLMessageSystem::getMessageTimeSeconds(TRUE);
+		add_packet(circuit, 100, 2, 1.f);
+		ensure_equals("unacked", circuit.getUnackedPacketCount(), 1);
+
+		ensure_equals("not yet due", resend(circuit, start + 0.5), 0);
+		ensure_equals("first resend", resend(circuit, start + 1.5), 1);
+		ensure_equals("not due again", resend(circuit, start + 2.0), 0);
+		ensure_equals("last resend", resend(circuit, start + 3.0), 1);
+		ensure("no answer yet", sResults.empty());
+
+		resend(circuit, start + 4.5);
+		ensure_equals("failed", sResults.size(), (size_t)1);
+		ensure_equals("timed out", sResults[0], LL_ERR_TCP_TIMEOUT);
+		ensure_equals("dropped", circuit.getUnackedPacketCount(), 0);
+		ensure_equals("no bytes left", circuit.getUnackedPacketBytes(), 0);
+	}
+
+	template<> template<>
+	void circuit_object::test<4>()
+	{
+		// Of a burst, the packets acked (in any order) are never resent,
+		// the rest are
+		TestCircuit circuit(mHost);
+		const F64 start = LLMessageSystem::getMessageTimeSeconds(TRUE);
+		for (TPACKETID id = 1; id <= 10; ++id)
+		{
+			add_packet(circuit, id, 3, 1.f);
+		}
+		const TPACKETID acked[] = { 7, 2, 9, 4, 1, 10 };
+		for (U32 i = 0; i < LL_ARRAY_SIZE(acked); ++i)
+		{
+			circuit.ackReliablePacket(acked[i]);
+		}
+		// Again, as a duplicate ack would
+		circuit.ackReliablePacket(7);
+		ensure_equals("acks answered once", sResults.size(), LL_ARRAY_SIZE(acked));
+		for (U32 i = 0; i < sResults.size(); ++i)
+		{
+			ensure_equals("acked", sResults[i], (S32)LL_ERR_NOERR);
+		}
+		ensure_equals("unacked", circuit.getUnackedPacketCount(), 4);
+
+		ensure_equals("lost packets resent", resend(circuit, start + 1.5), 4);
+
+		// The ack for a resent packet still lands
+		circuit.ackReliablePacket(3);
+		ensure_equals("resend acked", circuit.getUnackedPacketCount(), 3);
+		ensure_equals("others resent again", resend(circuit, start + 3.0), 3);
+	}
+
+	template<> template<>
+	void circuit_object::test<5>()
+	{
+		// Acks for reliable packets taken are collected to go out together
+		TestCircuit circuit(mHost);
+		for (TPACKETID id = 1; id <= 5; ++id)
+		{
+			circuit.collectRAck(id);
+		}
+		ensure_equals("acks held", circuit.getAckCount(), 5);
+		ensure("circuit queued to send acks",
+			   gMessageSystem->mCircuitInfo.mSendAckMap.count(mHost) != 0);
+		gMessageSystem->mCircuitInfo.mSendAckMap.erase(mHost);
+	}
+}
@@ -0,0 +1,249 @@
+/**
+ * @file llhttprequestgroup_test.cpp
+ * @brief LLHTTPRequestGroup test cases, answered by hand.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llhttprequestgroup.h"
+
+#include <boost/bind.hpp>
+
+#include "llcurl_stub.cpp"
+#include "../test/lltut.h"
+
+//----------------------------------------------------------------------------
+// Mock objects for the dependencies of the code we're testing
+
+const F32 HTTP_REQUEST_EXPIRY_SECS = 60.0f;
+
+namespace
+{
+	// A request the group started, to be answered by the test.
+	struct SentRequest
+	{
+		std::string mMethod;
+		std::string mURL;
+		LLSD mBody;
+		LLHTTPClient::ResponderPtr mResponder;
+	};
+	std::vector<SentRequest> sSent;
+
+	void send(const std::string& method, const std::string& url, const LLSD& body,
+			  LLHTTPClient::ResponderPtr responder)
+	{
+		SentRequest request;
+		request.mMethod = method;
+		request.mURL = url;
+		request.mBody = body;
+		request.mResponder = responder;
+		sSent.push_back(request);
+	}
+
+	void answer(S32 index, U32 status, const std::string& reason, const LLSD& content)
+	{
+		sSent[index].mResponder->completed(status, reason, content);
+	}
+}
+
+void LLHTTPClient::post(const std::string& url, const LLSD& body, ResponderPtr responder,
+						const LLSD& headers, const F32 timeout)
+{
+	send("POST", url, body, responder);
+}
+
+void LLHTTPClient::get(const std::string& url, ResponderPtr responder,
+					   const LLSD& headers, const F32 timeout)
+{
+	send("GET", url, LLSD(), responder);
+}
+
+//----------------------------------------------------------------------------
+
+namespace tut
+{
+	struct httprequestgroup_data
+	{
+		httprequestgroup_data()
+		:	mGroup(NULL),
+			mWaits(0)
+		{
+			sSent.clear();
+		}
+
+		~httprequestgroup_data()
+		{
+			sSent.clear();
+		}
+
+		// Waits for whatever mGroup has started, then counts the wait.
+		void waitCoro(LLCoros::self& self)
+		{
+			mGroup->wait(self);
+			mWaits++;
+		}
+
+		void startWait()
+		{
+			LLCoros::instance().launch("httprequestgroup_test",
+									   boost::bind(&httprequestgroup_data::waitCoro, this, _1));
+		}
+
+		LLHTTPRequestGroup* mGroup;
+		S32 mWaits;
+	};
+	typedef test_group<httprequestgroup_data> httprequestgroup_test;
+	typedef httprequestgroup_test::object httprequestgroup_object;
+	tut::httprequestgroup_test httprequestgroup_testcase("LLHTTPRequestGroup");
+
+	template<> template<>
+	void httprequestgroup_object::test<1>()
+	{
+		set_test_name("requests are started at once and indexed in order");
+		LLHTTPRequestGroup requests;
+		LLSD body;
+		body["object_ids"].append(LLUUID::null);
+		ensure_equals("first", requests.post("http://cap/one", body), 0);
+		ensure_equals("second", requests.get("http://cap/two"), 1);
+		ensure_equals("third", requests.post("http://cap/three", LLSD()), 2);
+
+		ensure_equals("all sent", (S32)sSent.size(), 3);
+		ensure_equals("post", sSent[0].mMethod, std::string("POST"));
+		ensure_equals("post url", sSent[0].mURL, std::string("http://cap/one"));
+		ensure("post body", sSent[0].mBody["object_ids"].size() == 1);
+		ensure_equals("get", sSent[1].mMethod, std::string("GET"));
+		ensure_equals("get url", sSent[1].mURL, std::string("http://cap/two"));
+
+		ensure_equals("size", requests.size(), 3);
+		ensure_equals("pending", requests.getPending(), 3);
+		ensure_equals("no status yet", requests.getStatus(0), 0U);
+		ensure("not succeeded yet", !requests.succeeded(0));
+	}
+
+	template<> template<>
+	void httprequestgroup_object::test<2>()
+	{
+		set_test_name("wait resumes once the last reply is in, and can be waited on again");
+		LLHTTPRequestGroup requests;
+		mGroup = &requests;
+		requests.post("http://cap/a", LLSD());
+		requests.post("http://cap/b", LLSD());
+		requests.post("http://cap/c", LLSD());
+		startWait();
+		ensure_equals("waiting", mWaits, 0);
+
+		// Out of order, each lands at its own index
+		answer(2, 200, "OK", LLSD("c"));
+		answer(0, 200, "OK", LLSD("a"));
+		ensure_equals("still waiting", mWaits, 0);
+		ensure_equals("one to go", requests.getPending(), 1);
+		answer(1, 200, "OK", LLSD("b"));
+		ensure_equals("resumed", mWaits, 1);
+		ensure_equals("none pending", requests.getPending(), 0);
+		ensure_equals("a", requests.getContent(0).asString(), std::string("a"));
+		ensure_equals("b", requests.getContent(1).asString(), std::string("b"));
+		ensure_equals("c", requests.getContent(2).asString(), std::string("c"));
+
+		// Nothing outstanding, wait() returns at once
+		startWait();
+		ensure_equals("didn't wait", mWaits, 2);
+
+		// More requests after a wait are waited on again
+		ensure_equals("next index", requests.get("http://cap/d"), 3);
+		startWait();
+		ensure_equals("waiting again", mWaits, 2);
+		answer(3, 200, "OK", LLSD("d"));
+		ensure_equals("resumed again", mWaits, 3);
+		ensure_equals("d", requests.getContent(3).asString(), std::string("d"));
+		ensure_equals("earlier replies kept", requests.getContent(0).asString(), std::string("a"));
+	}
+
+	template<> template<>
+	void httprequestgroup_object::test<3>()
+	{
+		set_test_name("success and error replies in one group");
+		LLHTTPRequestGroup requests;
+		mGroup = &requests;
+		requests.post("http://cap/ok", LLSD());
+		requests.post("http://cap/missing", LLSD());
+		requests.get("http://cap/broken");
+		startWait();
+
+		LLSD content;
+		content["cost"] = 1.5;
+		LLSD error_body;
+		error_body["error"]["message"] = "no such object";
+		answer(1, 404, "Not Found", LLSD());
+		answer(0, 200, "OK", content);
+		answer(2, 500, "Internal Server Error", error_body);
+		ensure_equals("errors count as answered", mWaits, 1);
+
+		ensure("ok succeeded", requests.succeeded(0));
+		ensure_equals("ok status", requests.getStatus(0), 200U);
+		ensure_equals("ok content", requests.getContent(0)["cost"].asReal(), 1.5);
+
+		ensure("404 failed", !requests.succeeded(1));
+		ensure_equals("404 status", requests.getStatus(1), 404U);
+		ensure_equals("404 reason", requests.getReason(1), std::string("Not Found"));
+
+		ensure("500 failed", !requests.succeeded(2));
+		ensure_equals("500 status", requests.getStatus(2), 500U);
+		ensure_equals("error body kept", requests.getContent(2)["error"]["message"].asString(),
+					  std::string("no such object"));
+	}
+
+	template<> template<>
+	void httprequestgroup_object::test<4>()
+	{
+		set_test_name("answered requests are taken once each, in the order they came in");
+		LLHTTPRequestGroup requests;
+		requests.post("http://cap/a", LLSD());
+		requests.post("http://cap/b", LLSD());
+		requests.post("http://cap/c", LLSD());
+		ensure_equals("none yet", requests.takeAnswered(), -1);
+
+		answer(1, 200, "OK", LLSD());
+		answer(0, 503, "Unavailable", LLSD());
+		ensure_equals("first in", requests.takeAnswered(), 1);
+		ensure_equals("second in", requests.takeAnswered(), 0);
+		ensure_equals("taken", requests.takeAnswered(), -1);
+		ensure_equals("one pending", requests.getPending(), 1);
+
+		answer(2, 200, "OK", LLSD());
+		ensure_equals("last in", requests.takeAnswered(), 2);
+		ensure_equals("all taken", requests.takeAnswered(), -1);
+	}
+
+	template<> template<>
+	void httprequestgroup_object::test<5>()
+	{
+		set_test_name("a reply for a group that is gone is dropped");
+		{
+			LLHTTPRequestGroup requests;
+			requests.post("http://cap/late", LLSD());
+		}
+		// The responder keeps what it writes to alive
+		answer(0, 200, "OK", LLSD("late"));
+	}
+}
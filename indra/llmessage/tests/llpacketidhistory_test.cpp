@@ -0,0 +1,132 @@
+/**
+ * @file llpacketidhistory_test.cpp
+ * @brief LLPacketIDHistory test cases.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketidhistory.h"
+
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct packetidhistory_data
+	{
+	};
+	typedef test_group<packetidhistory_data> packetidhistory_test;
+	typedef packetidhistory_test::object packetidhistory_object;
+	tut::packetidhistory_test packetidhistory_testcase("LLPacketIDHistory");
+
+	template<> template<>
+	void packetidhistory_object::test<1>()
+	{
+		LLPacketIDHistory history(64);
+		ensure("empty history", !history.contains(0));
+		history.insert(5);
+		ensure("inserted id", history.contains(5));
+		ensure("other id", !history.contains(6));
+		ensure("aliased id", !history.contains(5 + 64));
+		history.erase(5);
+		ensure("erased id", !history.contains(5));
+	}
+
+	template<> template<>
+	void packetidhistory_object::test<2>()
+	{
+		// Packets arrive reordered and with some resent duplicates;
+		// every duplicate must be caught and nothing else.
+		LLPacketIDHistory history(256);
+		const TPACKETID order[] = { 1, 3, 2, 5, 4, 3, 7, 6, 1, 8, 5 };
+		const bool dup[] =        { 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 1 };
+		for (U32 i = 0; i < LL_ARRAY_SIZE(order); ++i)
+		{
+			ensure_equals("duplicate detection", history.contains(order[i]), dup[i]);
+			history.insert(order[i]);
+		}
+	}
+
+	template<> template<>
+	void packetidhistory_object::test<3>()
+	{
+		// A lost packet leaves a hole; its later resend is not a duplicate,
+		// a second resend is.
+		LLPacketIDHistory history(256);
+		for (TPACKETID id = 100; id < 120; ++id)
+		{
+			if (id != 110)
+			{
+				history.insert(id);
+			}
+		}
+		ensure("lost packet unseen", !history.contains(110));
+		history.insert(110);
+		ensure("resent packet seen", history.contains(110));
+	}
+
+	template<> template<>
+	void packetidhistory_object::test<4>()
+	{
+		LLPacketIDHistory history(256);
+		for (TPACKETID id = 0; id < 200; ++id)
+		{
+			history.insert(id);
+		}
+		history.forgetBefore(150);
+		ensure("forgotten", !history.contains(149));
+		ensure("forgotten", !history.contains(0));
+		ensure("kept", history.contains(150));
+		ensure("kept", history.contains(199));
+
+		// Moving forward more than a ring at once.
+		for (TPACKETID id = 1000; id < 1100; ++id)
+		{
+			history.insert(id);
+		}
+		history.forgetBefore(1050);
+		ensure("forgotten", !history.contains(1049));
+		ensure("kept", history.contains(1050));
+	}
+
+	template<> template<>
+	void packetidhistory_object::test<5>()
+	{
+		// Ids near the top of the range, then a wrap back to zero.
+		LLPacketIDHistory history(256);
+		const TPACKETID max_id = 0x01000000; // LL_MAX_OUT_PACKET_ID
+		const TPACKETID top = max_id - 10;
+		for (TPACKETID id = top; id < max_id; ++id)
+		{
+			history.insert(id);
+		}
+		for (TPACKETID id = 0; id < 10; ++id)
+		{
+			history.insert(id);
+		}
+		history.forgetBefore(5);
+		ensure("pre-wrap ids kept", history.contains(top));
+		ensure("forgotten", !history.contains(4));
+		ensure("kept", history.contains(5));
+	}
+}
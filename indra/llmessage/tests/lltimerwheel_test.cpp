@@ -0,0 +1,166 @@
+/**
+ * @file lltimerwheel_test.cpp
+ * @brief LLTimerWheel test cases.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <set>
+
+#include "../lltimerwheel.h"
+
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct timerwheel_data
+	{
+		typedef LLTimerWheel<TPACKETID> wheel_t;
+		typedef wheel_t::entry_list_t entry_list_t;
+
+		bool has(const entry_list_t& expired, TPACKETID id)
+		{
+			for (U32 i = 0; i < expired.size(); ++i)
+			{
+				if (expired[i].mKey == id)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+	typedef test_group<timerwheel_data> timerwheel_test;
+	typedef timerwheel_test::object timerwheel_object;
+	tut::timerwheel_test timerwheel_testcase("LLTimerWheel");
+
+	template<> template<>
+	void timerwheel_object::test<1>()
+	{
+		// Nothing expires before its deadline, everything expires after it.
+		wheel_t wheel(0.01, 16);
+		wheel.schedule(1, 1.005);
+		wheel.schedule(2, 1.5);
+		wheel.schedule(3, 1.0);
+		ensure_equals("size", wheel.size(), 3U);
+
+		entry_list_t expired;
+		wheel.advance(0.5, expired);
+		ensure("nothing due yet", expired.empty());
+
+		wheel.advance(1.001, expired);
+		ensure_equals("one due", (S32)expired.size(), 1);
+		ensure("packet 3 due", has(expired, 3));
+
+		// Same tick as the last advance, the later entry is picked up now.
+		expired.clear();
+		wheel.advance(1.006, expired);
+		ensure_equals("second due", (S32)expired.size(), 1);
+		ensure("packet 1 due", has(expired, 1));
+
+		expired.clear();
+		wheel.advance(2.0, expired);
+		ensure("packet 2 due", has(expired, 2));
+		ensure("wheel drained", wheel.empty());
+	}
+
+	template<> template<>
+	void timerwheel_object::test<2>()
+	{
+		// Deadlines several revolutions away share a slot with nearer ones
+		// and must wait for their own revolution.
+		wheel_t wheel(0.01, 8);
+		wheel.schedule(10, 0.03);
+		wheel.schedule(11, 0.03 + 8 * 0.01 * 3);
+
+		entry_list_t expired;
+		wheel.advance(0.035, expired);
+		ensure("near deadline fired", has(expired, 10));
+		ensure("far deadline held", !has(expired, 11));
+
+		// Jumping a long way forward visits each slot once and still
+		// fires everything that is due.
+		expired.clear();
+		wheel.advance(100.0, expired);
+		ensure("far deadline fired", has(expired, 11));
+		ensure("wheel drained", wheel.empty());
+	}
+
+	template<> template<>
+	void timerwheel_object::test<3>()
+	{
+		// Simulate a lossy link: every packet is scheduled for a resend,
+		// acks for even packets arrive before the timeout and cancel them
+		// lazily, so only the odd (lost) packets come back for a resend.
+		wheel_t wheel(0.01, 256);
+		std::set<TPACKETID> unacked;
+		const TPACKETID count = 1000;
+		for (TPACKETID id = 1; id <= count; ++id)
+		{
+			F64 sent = id * 0.001;
+			unacked.insert(id);
+			wheel.schedule(id, sent + 1.0);
+		}
+		// Acks arrive out of order.
+		for (TPACKETID id = count; id >= 1; --id)
+		{
+			if (!(id & 1))
+			{
+				unacked.erase(id);
+			}
+		}
+
+		entry_list_t expired;
+		S32 resent = 0;
+		for (F64 now = 0.0; now < 3.0; now += 1.0 / 60.0)
+		{
+			expired.clear();
+			wheel.advance(now, expired);
+			for (U32 i = 0; i < expired.size(); ++i)
+			{
+				ensure("not resent early", expired[i].mDue <= now);
+				if (unacked.count(expired[i].mKey))
+				{
+					++resent;
+					unacked.erase(expired[i].mKey);
+				}
+			}
+		}
+		ensure_equals("only lost packets resent", resent, (S32)count / 2);
+		ensure("all lost packets resent", unacked.empty());
+		ensure("wheel drained", wheel.empty());
+	}
+
+	template<> template<>
+	void timerwheel_object::test<4>()
+	{
+		// Deadlines in the past fire on the next advance.
+		wheel_t wheel;
+		entry_list_t expired;
+		wheel.advance(5.0, expired);
+		wheel.schedule(7, 1.0);
+		wheel.advance(5.0, expired);
+		ensure("past deadline fired", has(expired, 7));
+	}
+}
@@ -0,0 +1,272 @@
+/**
+ * @file llxferwindow_test.cpp
+ * @brief LLXferWindow test cases, driven over a simulated link.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <set>
+
+#include "../llxferwindow.h"
+
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct xferwindow_data
+	{
+		// A confirm on its way back to the sender.
+		struct Confirm
+		{
+			S32 mPacket;
+			F64 mArrival;
+		};
+
+		xferwindow_data()
+		:	mSeed(12345)
+		{
+		}
+
+		// Deterministic pseudo random loss, so failures reproduce.
+		bool lose(F32 loss_rate)
+		{
+			mSeed = mSeed * 1103515245 + 12345;
+			return ((mSeed >> 16) & 0x7fff) < (U32)(loss_rate * 32768.f);
+		}
+
+		// Push num_packets through window over a link with the given round
+		// trip time and loss rate in each direction, stepping the clock one
+		// frame at a time.  If drop_packet is set its first copy is lost.
+		// Returns the simulated seconds taken, or a negative number if the
+		// xfer didn't finish within max_seconds.
+		F64 run(LLXferWindow& window, S32 num_packets, F64 rtt, F32 loss_rate,
+				F64 max_seconds = 600.0, S32 drop_packet = -1)
+		{
+			const F64 frame = 0.01;
+			std::set<S32> received;
+			std::vector<Confirm> confirms;
+			S32 next_packet = 0;
+			S32 first_missing = 0;
+			mMaxAhead = 0;
+
+			for (F64 now = 0.0; now < max_seconds; now += frame)
+			{
+				// Confirms that made it back by now.
+				U32 keep = 0;
+				for (U32 i = 0; i < confirms.size(); ++i)
+				{
+					if (confirms[i].mArrival <= now)
+					{
+						window.packetConfirmed(confirms[i].mPacket, now);
+					}
+					else
+					{
+						confirms[keep++] = confirms[i];
+					}
+				}
+				confirms.resize(keep);
+
+				std::vector<S32> to_send;
+				window.collectExpired(now, to_send);
+				while (next_packet < num_packets && window.canSend(next_packet))
+				{
+					window.packetSent(next_packet, now);
+					to_send.push_back(next_packet++);
+				}
+
+				for (U32 i = 0; i < to_send.size(); ++i)
+				{
+					if (lose(loss_rate))
+					{
+						continue;
+					}
+					if (to_send[i] == drop_packet)
+					{
+						drop_packet = -1;
+						continue;
+					}
+					// The receiver confirms every copy it gets, and only
+					// buffers so far past the first one it is missing.
+					mMaxAhead = llmax(mMaxAhead, to_send[i] - first_missing);
+					received.insert(to_send[i]);
+					while (received.count(first_missing))
+					{
+						++first_missing;
+					}
+					if (!lose(loss_rate))
+					{
+						Confirm confirm;
+						confirm.mPacket = to_send[i];
+						confirm.mArrival = now + rtt;
+						confirms.push_back(confirm);
+					}
+				}
+
+				if (next_packet == num_packets && window.isEmpty())
+				{
+					ensure_equals("every packet delivered", (S32)received.size(), num_packets);
+					return now;
+				}
+			}
+			return -1.0;
+		}
+
+		U32 mSeed;
+		// How far past the receiver's first missing packet run() got.
+		S32 mMaxAhead;
+	};
+	typedef test_group<xferwindow_data> xferwindow_test;
+	typedef xferwindow_test::object xferwindow_object;
+	tut::xferwindow_test xferwindow_testcase("LLXferWindow");
+
+	template<> template<>
+	void xferwindow_object::test<1>()
+	{
+		// Window grows in slow start, never exceeds its cap, and a
+		// duplicate confirm is ignored.
+		LLXferWindow window;
+		ensure_equals("starts at one", window.getWindowSize(), 1);
+		ensure("can send", window.canSend(0));
+
+		window.packetSent(0, 0.0);
+		ensure("window full", !window.canSend(1));
+		ensure("confirmed", window.packetConfirmed(0, 0.1));
+		ensure("duplicate confirm", !window.packetConfirmed(0, 0.2));
+		ensure_equals("grown", window.getWindowSize(), 2);
+		ensure("rtt measured", window.getSmoothedRTT() > 0.09f && window.getSmoothedRTT() < 0.11f);
+
+		for (S32 i = 1; i < 200; ++i)
+		{
+			window.packetSent(i, 0.0);
+			window.packetConfirmed(i, 0.1);
+		}
+		ensure("capped", window.getWindowSize() <= LL_XFER_MAX_WINDOW);
+
+		window.setMaxWindow(1);
+		ensure_equals("stop-and-wait", window.getWindowSize(), 1);
+	}
+
+	template<> template<>
+	void xferwindow_object::test<2>()
+	{
+		// A lost packet is resent after the retransmit timeout and the
+		// window backs off.
+		LLXferWindow window;
+		window.addRTTSample(0.15f);
+		for (S32 i = 0; i < 40; ++i)
+		{
+			window.packetSent(i, 0.0);
+			window.packetConfirmed(i, 0.15);
+		}
+		S32 before = window.getWindowSize();
+		ensure("grew", before > 8);
+
+		window.packetSent(100, 1.0);
+		window.packetSent(101, 1.0);
+		std::vector<S32> expired;
+		window.collectExpired(1.0 + window.getRetransmitTimeout() * 0.5, expired);
+		ensure("not yet", expired.empty());
+
+		S32 retries = window.collectExpired(1.0 + window.getRetransmitTimeout() + 0.01, expired);
+		ensure_equals("both resent", (S32)expired.size(), 2);
+		ensure_equals("first retry", retries, 1);
+		ensure_equals("resend count", window.getNumResent(), 2U);
+		ensure("backed off", window.getWindowSize() < before);
+
+		// The confirm of a resent packet doesn't feed the RTT estimate.
+		F32 srtt = window.getSmoothedRTT();
+		window.packetConfirmed(100, 10.0);
+		ensure_equals("karn", window.getSmoothedRTT(), srtt);
+	}
+
+	template<> template<>
+	void xferwindow_object::test<3>()
+	{
+		// On a 150ms round trip link the window beats stop-and-wait by a
+		// wide margin.
+		LLXferWindow stop_and_wait;
+		stop_and_wait.setMaxWindow(1);
+		F64 slow = run(stop_and_wait, 200, 0.15, 0.f);
+
+		LLXferWindow windowed;
+		F64 fast = run(windowed, 200, 0.15, 0.f);
+
+		ensure("stop-and-wait finished", slow > 0.0);
+		ensure("windowed finished", fast > 0.0);
+		ensure("windowed at least 5x faster", fast * 5.0 < slow);
+	}
+
+	template<> template<>
+	void xferwindow_object::test<4>()
+	{
+		// Everything still arrives with 5% loss each way, and the window
+		// still comes out ahead.
+		LLXferWindow stop_and_wait;
+		stop_and_wait.setMaxWindow(1);
+		F64 slow = run(stop_and_wait, 200, 0.15, 0.05f);
+
+		LLXferWindow windowed;
+		F64 fast = run(windowed, 200, 0.15, 0.05f);
+
+		ensure("stop-and-wait finished", slow > 0.0);
+		ensure("windowed finished", fast > 0.0);
+		ensure("resent", windowed.getNumResent() > 0);
+		ensure("windowed faster under loss", fast * 3.0 < slow);
+	}
+
+	template<> template<>
+	void xferwindow_object::test<5>()
+	{
+		// While one packet is missing nothing goes out that the receiver
+		// would have to drop, however large the window has grown.
+		LLXferWindow window;
+		window.addRTTSample(0.15f);
+		for (S32 i = 0; i < 3000; ++i)
+		{
+			window.packetSent(i, 0.0);
+			window.packetConfirmed(i, 0.15);
+		}
+		ensure_equals("full window", window.getWindowSize(), LL_XFER_MAX_WINDOW);
+
+		window.packetSent(3000, 1.0);
+		for (S32 i = 3001; i < 3000 + LL_XFER_MAX_WINDOW; ++i)
+		{
+			ensure("room behind the missing packet", window.canSend(i));
+			window.packetSent(i, 1.0);
+			window.packetConfirmed(i, 1.15);
+		}
+		ensure("window has room", window.getNumInFlight() < window.getWindowSize());
+		ensure("past the receiver's buffer", !window.canSend(3000 + LL_XFER_MAX_WINDOW));
+
+		window.packetConfirmed(3000, 1.2);
+		ensure("missing packet arrived", window.canSend(3000 + LL_XFER_MAX_WINDOW));
+
+		// Same over the simulated link, dropping one packet once the
+		// window is wide open.
+		LLXferWindow windowed;
+		ensure("finished", run(windowed, 400, 0.15, 0.f, 600.0, 200) > 0.0);
+		ensure_equals("resent the dropped packet", windowed.getNumResent(), 1U);
+		ensure("never past the receiver's buffer", mMaxAhead < LL_XFER_MAX_WINDOW);
+	}
+}
@@ -0,0 +1,289 @@
+/**
+ * @file patch_idct_test.cpp
+ * @brief LLPatchDecompressor test cases.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llmath.h"
+#include "v3math.h"
+#include "bitpack.h"
+#include "lljobscheduler.h"
+#include "lltimer.h"
+#include "../patch_code.h"
+#include "../patch_dct.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 PATCHES_PER_EDGE = 4;
+	const S32 PREQUANT = 10;
+	const U32 MAX_LAYER_SIZE = 64*1024;
+
+	// Rolling hills with some noise on top, a heightfield of
+	// PATCHES_PER_EDGE patches on a side
+	std::vector<F32> make_terrain(S32 patch_size, U32 seed)
+	{
+		S32 edge = patch_size*PATCHES_PER_EDGE;
+		std::vector<F32> heights(edge*edge);
+		for (S32 y = 0; y < edge; y++)
+		{
+			for (S32 x = 0; x < edge; x++)
+			{
+				seed = seed*1103515245 + 12345;
+				F32 noise = (F32)((seed >> 16) & 0xFF)/256.f;
+				heights[y*edge + x] = 22.f + 15.f*sinf(x*0.11f)*cosf(y*0.07f) + 3.f*noise;
+			}
+		}
+		return heights;
+	}
+
+	// Codes the heightfield the way a region sends it in LayerData.  The
+	// tree has no captured LayerData packets to replay, but this is the
+	// same patch_code coder a simulator packs them with.
+	U32 encode_layer(U8 *buffer, const std::vector<F32> &heights, S32 patch_size)
+	{
+		S32 edge = patch_size*PATCHES_PER_EDGE;
+		LLBitPack bitpack(buffer, MAX_LAYER_SIZE);
+		init_patch_coding(bitpack);
+		init_patch_compressor(patch_size, edge, 'L');
+
+		LLGroupHeader group_header;
+		get_patch_group_header(&group_header);
+		code_patch_group_header(bitpack, &group_header);
+
+		S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		for (S32 j = 0; j < PATCHES_PER_EDGE; j++)
+		{
+			for (S32 i = 0; i < PATCHES_PER_EDGE; i++)
+			{
+				F32 *patch = const_cast<F32 *>(&heights[j*patch_size*edge + i*patch_size]);
+				LLPatchHeader header;
+				F32 zmax;
+				F32 zmin;
+				prescan_patch(patch, &header, zmax, zmin);
+				header.patchids = (i << 5) | j;
+				compress_patch(patch, cpatch, &header, PREQUANT);
+				code_patch_header(bitpack, &header, cpatch);
+				code_patch(bitpack, cpatch, 0);
+			}
+		}
+		code_end_of_data(bitpack);
+		return bitpack.flushBitPack();
+	}
+
+	// Unpacks a layer into the patches a decompressor is given
+	void unpack_layer(U8 *buffer, U32 size, S32 &patch_size, S32 &stride,
+					  std::vector<LLPatchDecompressor::Request> &requests)
+	{
+		LLBitPack bitpack(buffer, size);
+		init_patch_decoding(bitpack);
+		LLGroupHeader group_header;
+		decode_patch_group_header(bitpack, &group_header);
+		patch_size = group_header.patch_size;
+		stride = group_header.stride;
+
+		while (true)
+		{
+			LLPatchDecompressor::Request request;
+			decode_patch_header(bitpack, &request.mHeader);
+			if (request.mHeader.quant_wbits == END_OF_PATCHES)
+			{
+				break;
+			}
+			decode_patch(bitpack, request.mCoefficients);
+			request.mStride = stride;
+			request.mPatch = NULL;
+			requests.push_back(request);
+		}
+	}
+
+	F32 *patch_origin(std::vector<F32> &heights, const LLPatchDecompressor::Request &request,
+					  S32 patch_size, S32 stride)
+	{
+		S32 i = request.mHeader.patchids >> 5;
+		S32 j = request.mHeader.patchids & 0x1F;
+		return &heights[j*patch_size*stride + i*patch_size];
+	}
+
+	// What the viewer did before LLPatchDecompressor
+	void decompress_reference(std::vector<LLPatchDecompressor::Request> &requests,
+							  S32 patch_size, S32 stride, std::vector<F32> &heights)
+	{
+		LLGroupHeader group_header;
+		group_header.patch_size = patch_size;
+		group_header.stride = stride;
+		group_header.layer_type = 'L';
+		init_patch_decompressor(patch_size);
+		set_group_of_patch_header(&group_header);
+		for (U32 k = 0; k < requests.size(); k++)
+		{
+			decompress_patch(patch_origin(heights, requests[k], patch_size, stride),
+							 requests[k].mCoefficients, &requests[k].mHeader);
+		}
+	}
+
+	void check_layer(S32 patch_size, U32 seed)
+	{
+		std::vector<F32> terrain = make_terrain(patch_size, seed);
+		std::vector<U8> buffer(MAX_LAYER_SIZE);
+		U32 size = encode_layer(&buffer[0], terrain, patch_size);
+
+		S32 decoded_size;
+		S32 stride;
+		std::vector<LLPatchDecompressor::Request> requests;
+		unpack_layer(&buffer[0], size, decoded_size, stride, requests);
+		tut::ensure_equals("patch size", decoded_size, patch_size);
+		tut::ensure_equals("patches", (S32)requests.size(), PATCHES_PER_EDGE*PATCHES_PER_EDGE);
+
+		std::vector<F32> expected(terrain.size());
+		decompress_reference(requests, patch_size, stride, expected);
+
+		std::vector<F32> actual(terrain.size());
+		for (U32 k = 0; k < requests.size(); k++)
+		{
+			requests[k].mPatch = patch_origin(actual, requests[k], patch_size, stride);
+		}
+		LLPatchDecompressor decompressor(patch_size);
+		decompressor.decompressAll(requests);
+
+		tut::ensure("same heights", !memcmp(&expected[0], &actual[0], expected.size()*sizeof(F32)));
+	}
+}
+
+namespace tut
+{
+	struct patch_idct_data
+	{
+	};
+	typedef test_group<patch_idct_data> patch_idct_test;
+	typedef patch_idct_test::object patch_idct_object;
+	tut::patch_idct_test patch_idct_testcase("LLPatchDecompressor");
+
+	template<> template<>
+	void patch_idct_object::test<1>()
+	{
+		set_test_name("16 grid patches decompress to the bit");
+		check_layer(NORMAL_PATCH_SIZE, 3);
+		check_layer(NORMAL_PATCH_SIZE, 17);
+	}
+
+	template<> template<>
+	void patch_idct_object::test<2>()
+	{
+		set_test_name("32 grid patches decompress to the bit");
+		check_layer(LARGE_PATCH_SIZE, 5);
+	}
+
+	template<> template<>
+	void patch_idct_object::test<3>()
+	{
+		set_test_name("decompressv matches decompress_patchv");
+		U32 seed = 29;
+		LLPatchDecompressor decompressor(NORMAL_PATCH_SIZE);
+		LLGroupHeader group_header;
+		group_header.patch_size = NORMAL_PATCH_SIZE;
+		group_header.stride = NORMAL_PATCH_SIZE + 1;
+		group_header.layer_type = 'L';
+
+		for (S32 round = 0; round < 20; round++)
+		{
+			// Any coefficients at all, not just those a real terrain codes to
+			S32 cpatch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+			for (S32 i = 0; i < NORMAL_PATCH_SIZE*NORMAL_PATCH_SIZE; i++)
+			{
+				seed = seed*1103515245 + 12345;
+				cpatch[i] = (S32)((seed >> 12) & 0x3FF) - 0x200;
+			}
+			LLPatchHeader header;
+			header.dc_offset = -30.f + round*4.5f;
+			header.range = 1 + round*11;
+			header.quant_wbits = ((round % 6) << 4) | 8;
+			header.patchids = 0;
+
+			std::vector<LLVector3> expected(NORMAL_PATCH_SIZE*(NORMAL_PATCH_SIZE + 1));
+			std::vector<LLVector3> actual(expected.size());
+			init_patch_decompressor(NORMAL_PATCH_SIZE);
+			set_group_of_patch_header(&group_header);
+			decompress_patchv(&expected[0], cpatch, &header);
+			decompressor.decompressv(&actual[0], group_header.stride, cpatch, &header);
+
+			for (U32 i = 0; i < expected.size(); i++)
+			{
+				ensure("same height", !memcmp(&expected[i].mV[VZ], &actual[i].mV[VZ], sizeof(F32)));
+			}
+		}
+	}
+
+	template<> template<>
+	void patch_idct_object::test<4>()
+	{
+		set_test_name("sharing patches out to the job scheduler");
+		LLJobScheduler::getInstance()->start(3);
+		check_layer(NORMAL_PATCH_SIZE, 41);
+		check_layer(LARGE_PATCH_SIZE, 43);
+		LLJobScheduler::getInstance()->stop();
+	}
+
+	template<> template<>
+	void patch_idct_object::test<5>()
+	{
+		set_test_name("throughput");
+		std::vector<F32> terrain = make_terrain(NORMAL_PATCH_SIZE, 7);
+		std::vector<U8> buffer(MAX_LAYER_SIZE);
+		U32 size = encode_layer(&buffer[0], terrain, NORMAL_PATCH_SIZE);
+		S32 patch_size;
+		S32 stride;
+		std::vector<LLPatchDecompressor::Request> requests;
+		unpack_layer(&buffer[0], size, patch_size, stride, requests);
+		std::vector<F32> heights(terrain.size());
+		for (U32 k = 0; k < requests.size(); k++)
+		{
+			requests[k].mPatch = patch_origin(heights, requests[k], patch_size, stride);
+		}
+
+		const S32 ROUNDS = 200;
+		LLTimer timer;
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			decompress_reference(requests, patch_size, stride, heights);
+		}
+		F64 reference_time = timer.getElapsedTimeF64();
+
+		LLPatchDecompressor decompressor(patch_size);
+		timer.reset();
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			decompressor.decompressAll(requests);
+		}
+		F64 simd_time = timer.getElapsedTimeF64();
+
+		llinfos << "Decompressing " << requests.size() << " patches: scalar "
+				<< reference_time*1000000.0/ROUNDS << " us, SSE "
+				<< simd_time*1000000.0/ROUNDS << " us" << llendl;
+	}
+}
@@ -286,6 +286,29 @@ public:
 	
 };
 
+// Texture entries unpacked from a TextureEntry field, before they are
+// applied to a primitive.  Always unpacked for MAX_TES faces, since the
+// primitive's face count may not be known yet.
+class LLTEContents
+{
+public:
+	static const U32 MAX_TES = 32;
+
+	LLTEContents() : mSize(0) {}
+
+	U8	mImageData[MAX_TES*16];
+	U8	mColors[MAX_TES*4];
+	F32	mScaleS[MAX_TES];
+	F32	mScaleT[MAX_TES];
+	S16	mOffsetS[MAX_TES];
+	S16	mOffsetT[MAX_TES];
+	S16	mImageRot[MAX_TES];
+	U8	mBump[MAX_TES];
+	U8	mMediaFlags[MAX_TES];
+	U8	mGlow[MAX_TES];
+	S32	mSize;		// of the packed field, 0 if it was empty
+};
+
 
 class LLPrimitive : public LLXform
 {
@@ -355,12 +378,16 @@ public:
 
 	void copyTEs(const LLPrimitive *primitive);
 	S32 packTEField(U8 *cur_ptr, U8 *data_ptr, U8 data_size, U8 last_face_index, EMsgVariableType type) const;
-	S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
+	static S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
 	BOOL packTEMessage(LLMessageSystem *mesgsys) const;
 	BOOL packTEMessage(LLDataPacker &dp) const;
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name);
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num); // Variable num of blocks
 	BOOL unpackTEMessage(LLDataPacker &dp);
+	// unpackTEMessage() in two steps.  parseTEMessage() touches no
+	// primitive, so it may run on any thread.
+	static BOOL parseTEMessage(U8 *packed_buffer, S32 size, LLTEContents& tec);
+	S32 applyParsedTEMessage(const LLTEContents& tec);
 	
 #ifdef CHECK_FOR_FINITE
 	inline void setPosition(const LLVector3& pos);
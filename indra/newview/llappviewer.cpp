@@ -123,6 +123,7 @@
 #include "llviewerkeyboard.h"
 #include "lllfsthread.h"
 #include "llworkerthread.h"
+#include "lljobscheduler.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
@@ -524,6 +525,7 @@ static void settings_modify()
 	LLVOAvatar::sUseImpostors			= gSavedSettings.getBOOL("RenderUseImpostors");
 	LLVOSurfacePatch::sLODFactor		= gSavedSettings.getF32("RenderTerrainLODFactor");
 	LLVOSurfacePatch::sLODFactor *= LLVOSurfacePatch::sLODFactor; //square lod factor to get exponential range of [1,4]
+	LLVOSurfacePatch::sGeomorphFactor	= gSavedSettings.getF32("RenderTerrainGeomorph");
 	gDebugGL = gSavedSettings.getBOOL("RenderDebugGL") || gDebugSession;
 	gDebugPipeline = gSavedSettings.getBOOL("RenderDebugPipeline");
 	gAuditTexture = gSavedSettings.getBOOL("AuditTexture");
@@ -1802,6 +1804,12 @@ bool LLAppViewer::cleanup()
 	LLVFSThread::cleanupClass();
 	LLLFSThread::cleanupClass();
 
+	if (LLJobScheduler::instanceExists())
+	{
+		llinfos << "Job scheduler stats: " << LLJobScheduler::getInstance()->getStats() << llendl;
+		LLJobScheduler::getInstance()->stop();
+	}
+
 #ifndef LL_RELEASE_FOR_DOWNLOAD
 	llinfos << "Auditing VFS" << llendl;
 	if(gVFS)
@@ -1858,6 +1866,8 @@ bool LLAppViewer::cleanup()
 
     llinfos << "Goodbye!" << llendflush;
 
+	LLError::stopAsyncLogging();
+
 	// return 0;
 	return true;
 }
@@ -1889,6 +1899,12 @@ bool LLAppViewer::initThreads()
 	static const bool enable_threads = true;
 #endif
 
+	if (enable_threads)
+	{
+		// Shared workers for the queued threads below
+		LLJobScheduler::getInstance()->start();
+	}
+
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
@@ -1952,6 +1968,9 @@ bool LLAppViewer::initLogging()
 
 	LLError::logToFile(log_file);
 
+	// Keep file I/O off the threads that log
+	LLError::startAsyncLogging();
+
 	// *FIX:Mani no error handling here!
 	return true;
 }
@@ -2302,6 +2321,13 @@ bool LLAppViewer::initConfiguration()
 		}
  	}
 
+	if (clp.hasOption("tracetimers"))
+	{
+		S32 frames = atoi(clp.getOption("tracetimers")[0].c_str());
+		LLFastTimer::captureTraceFrames(frames > 0 ? frames : 300,
+			gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timer_trace.json"));
+	}
+
 	if (clp.hasOption("graphicslevel"))
 	{
 		const LLCommandLineParser::token_vector_t& value = clp.getOption("graphicslevel");
@@ -2985,6 +3011,7 @@ void LLAppViewer::handleViewerCrash()
 	// Close the debug file
 	pApp->writeDebugInfo();
 
+	LLError::stopAsyncLogging();
 	LLError::logToFile("");
 
 	// Remove the marker file, since otherwise we'll spawn a process that'll keep it locked
@@ -3383,7 +3410,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 16;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
@@ -3755,14 +3782,21 @@ void LLAppViewer::saveFinalSnapshot()
 
 void LLAppViewer::loadNameCache()
 {
-	// display names cache
+	// display names cache, the XML version is only read when upgrading
+	// from a viewer that didn't write the binary one
 	std::string filename =
-		gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "avatar_name_cache.xml");
+		gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "avatar_name_cache.bin");
 	LL_INFOS("AvNameCache") << filename << LL_ENDL;
-	llifstream name_cache_stream(filename);
-	if(name_cache_stream.is_open())
+	llifstream name_cache_stream(filename, std::ios::in | std::ios::binary);
+	if(!name_cache_stream.is_open()
+	   || !LLAvatarNameCache::importBinaryFile(name_cache_stream))
 	{
-		LLAvatarNameCache::importFile(name_cache_stream);
+		filename = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "avatar_name_cache.xml");
+		llifstream xml_name_cache_stream(filename);
+		if(xml_name_cache_stream.is_open())
+		{
+			LLAvatarNameCache::importFile(xml_name_cache_stream);
+		}
 	}
 
 	if (!gCacheName) return;
@@ -3780,11 +3814,11 @@ void LLAppViewer::saveNameCache()
 	{
 	// display names cache
 	std::string filename =
-		gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "avatar_name_cache.xml");
-	llofstream name_cache_stream(filename);
+		gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "avatar_name_cache.bin");
+	llofstream name_cache_stream(filename, std::ios::out | std::ios::binary);
 	if(name_cache_stream.is_open())
 	{
-		LLAvatarNameCache::exportFile(name_cache_stream);
+		LLAvatarNameCache::exportBinaryFile(name_cache_stream);
 }
 
 	if (!gCacheName) return;
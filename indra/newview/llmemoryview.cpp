@@ -38,6 +38,7 @@
 #include <boost/algorithm/string/split.hpp>
 
 #include "llmemory.h"
+#include "llmemtag.h"
 
 LLMemoryView::LLMemoryView(const LLMemoryView::Params& p)
 :	LLView(p),
@@ -95,6 +96,18 @@ void LLMemoryView::refreshProfile()
 
 	mLines.clear();
 
+	// Tagged subsystems first, these are always available.
+	const LLMemTag::tag_list_t& tags = LLMemTag::getTags();
+	for (LLMemTag::tag_list_t::const_iterator iter = tags.begin(); iter != tags.end(); ++iter)
+	{
+		const LLMemTag* tag = *iter;
+		std::stringstream ss;
+		ss << tag->getName() << ": " << (tag->getLiveBytes() >> 10) << " K live, "
+		   << (tag->getPeakBytes() >> 10) << " K peak, "
+		   << tag->getLiveCount() << " allocations";
+		mLines.push_back(utf8string_to_wstring(ss.str()));
+	}
+
  	if(mAlloc->isProfiling()) 
 	{
 		const LLAllocatorHeapProfile &prof = mAlloc->getProfile();
@@ -73,10 +73,14 @@
 
 LLFastTimer::DeclareTimer FTM_MESH_UPDATE("Mesh Update");
 LLFastTimer::DeclareTimer FTM_LOAD_MESH("Load Mesh");
+static LLFastTimer::DeclareTimer FTM_MESH_FETCH("Mesh Fetch");
 
 LLMeshRepository gMeshRepo;
 
 const U32 MAX_MESH_REQUESTS_PER_SECOND = 100;
+// Prefetched meshes kept track of for hits, and for how long
+const U32 MAX_PREFETCHED_MESHES = 1024;
+const F64 MESH_PREFETCH_EXPIRY = 120.0;
 
 U32 LLMeshRepository::sBytesReceived = 0;
 U32 LLMeshRepository::sHTTPRequestCount = 0;
@@ -638,6 +642,7 @@ void LLMeshRepoThread::run()
 
 		if (!LLApp::isQuitting())
 		{
+			LLFastTimer t(FTM_MESH_FETCH);
 			static U32 count = 0;
 
 			static F32 last_hundred = gFrameTimeSeconds;
@@ -784,6 +789,18 @@ void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 	}
 }
 
+void LLMeshRepoThread::prefetchMeshHeader(const LLVolumeParams& mesh_params)
+{ //protected by mSignal, no locking needed here
+
+	if (mMeshHeader.find(mesh_params.getSculptID()) == mMeshHeader.end() &&
+		mPendingLOD.find(mesh_params) == mPendingLOD.end())
+	{ //fetch the header alone, LOD requests made while it is pending join the empty list
+		LLMutexLock lock(mMutex);
+		mHeaderReqQ.push(HeaderRequest(mesh_params));
+		mPendingLOD[mesh_params];
+	}
+}
+
 //static 
 std::string LLMeshRepoThread::constructUrl(LLUUID mesh_id)
 {
@@ -2167,6 +2184,8 @@ void LLMeshHeaderResponder::completedRaw(U32 status, const std::string& reason,
 
 LLMeshRepository::LLMeshRepository()
 : mMeshMutex(NULL),
+  mPrefetchHits(0),
+  mPrefetchHeadStart(0.0),
   mMeshThreadCount(0),
   mThread(NULL)
 {
@@ -2281,6 +2300,14 @@ S32 LLMeshRepository::loadMesh(LLVOVolume* vobj, const LLVolumeParams& mesh_para
 			//first request for this mesh
 			mLoadingMeshes[detail][mesh_params].insert(vobj->getID());
 			mPendingRequests.push_back(LLMeshRepoThread::LODRequest(mesh_params, detail));
+
+			prefetch_map::iterator prefetched = mPrefetchedMeshes.find(mesh_params.getSculptID());
+			if (prefetched != mPrefetchedMeshes.end())
+			{ //the header had a head start
+				mPrefetchHits++;
+				mPrefetchHeadStart += LLFrameTimer::getElapsedSeconds() - prefetched->second;
+				mPrefetchedMeshes.erase(prefetched);
+			}
 		}
 	}
 
@@ -2482,6 +2509,14 @@ void LLMeshRepository::notifyLoadedMeshes()
 			mPendingRequests.erase(mPendingRequests.begin());
 			push_count--;
 		}
+
+		//prefetched headers get what is left
+		while (!mPendingPrefetchRequests.empty() && push_count > 0)
+		{
+			mThread->prefetchMeshHeader(mPendingPrefetchRequests.front());
+			mPendingPrefetchRequests.pop();
+			push_count--;
+		}
 	}
 
 	//send skin info requests
@@ -2513,6 +2548,55 @@ void LLMeshRepository::notifyLoadedMeshes()
 	mThread->mSignal->signal();
 }
 
+bool LLMeshRepository::prefetchMesh(const LLVolumeParams& mesh_params)
+{
+	const LLUUID& mesh_id = mesh_params.getSculptID();
+	if (mesh_id.isNull() || getMeshHeader(mesh_id).isDefined())
+	{
+		return false;
+	}
+
+	LLMutexLock lock(mMeshMutex);
+
+	if (mPrefetchedMeshes.find(mesh_id) != mPrefetchedMeshes.end())
+	{
+		return false;
+	}
+
+	for (U32 i = 0; i < 4; ++i)
+	{
+		if (mLoadingMeshes[i].find(mesh_params) != mLoadingMeshes[i].end())
+		{ //already on its way
+			return false;
+		}
+	}
+
+	F64 now = LLFrameTimer::getElapsedSeconds();
+	if (mPrefetchedMeshes.size() >= MAX_PREFETCHED_MESHES)
+	{ //forget the ones no object went on to load
+		for (prefetch_map::iterator iter = mPrefetchedMeshes.begin(); iter != mPrefetchedMeshes.end(); )
+		{
+			if (now - iter->second > MESH_PREFETCH_EXPIRY)
+			{
+				mPrefetchedMeshes.erase(iter++);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+
+		if (mPrefetchedMeshes.size() >= MAX_PREFETCHED_MESHES)
+		{
+			return false;
+		}
+	}
+
+	mPrefetchedMeshes[mesh_id] = now;
+	mPendingPrefetchRequests.push(mesh_params);
+	return true;
+}
+
 void LLMeshRepository::notifySkinInfoReceived(LLMeshSkinInfo& info)
 {
 	mSkinMap[info.mMeshID] = info;
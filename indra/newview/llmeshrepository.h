@@ -322,6 +322,7 @@ public:
 	virtual void run();
 
 	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	void prefetchMeshHeader(const LLVolumeParams& mesh_params);
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params);
 	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 	bool headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
@@ -462,6 +463,14 @@ public:
 
 	//mesh management functions
 	S32 loadMesh(LLVOVolume* volume, const LLVolumeParams& mesh_params, S32 detail = 0, S32 last_lod = -1);
+	//fetch a mesh's header ahead of any object asking for the mesh, with the
+	//requests left over once loading meshes are served.  false if the header
+	//is here or was already asked for.
+	bool prefetchMesh(const LLVolumeParams& mesh_params);
+	//prefetched meshes an object went on to load, and the seconds between
+	//prefetch and load, summed
+	S32 getPrefetchHits() const { return mPrefetchHits; }
+	F64 getPrefetchHeadStart() const { return mPrefetchHeadStart; }
 	
 	void notifyLoadedMeshes();
 	void notifyMeshLoaded(const LLVolumeParams& mesh_params, LLVolume* volume);
@@ -505,6 +514,15 @@ public:
 	
 	std::vector<LLMeshRepoThread::LODRequest> mPendingRequests;
 	
+	//meshes prefetched and not yet loaded, and when they were prefetched
+	typedef std::map<LLUUID, F64> prefetch_map;
+	prefetch_map mPrefetchedMeshes;
+	S32 mPrefetchHits;
+	F64 mPrefetchHeadStart;
+
+	//list of mesh params that need to send prefetch header requests
+	std::queue<LLVolumeParams> mPendingPrefetchRequests;
+
 	//list of mesh ids awaiting skin info
 	typedef std::map<LLUUID, std::set<LLUUID> > skin_load_map;
 	skin_load_map mLoadingSkins;
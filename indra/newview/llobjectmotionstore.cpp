@@ -0,0 +1,325 @@
+/**
+ * @file llobjectmotionstore.cpp
+ * @brief Dead reckoning state of the active objects, stored by component.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectmotionstore.h"
+
+#include "indra_constants.h"
+#include "llmemory.h"
+#include "llvector4a.h"
+
+// Smallest squared angular velocity LLViewerObject::applyAngularVelocity()
+// turns an object for
+const F32 MIN_SPIN_SQUARED = 0.00001f;
+
+LLObjectMotionStore::LLObjectMotionStore()
+:	mCount(0),
+	mCapacity(0),
+	mLastInterpUpdateSecs(NULL),
+	mFlags(NULL),
+	mHandleRefs(NULL)
+{
+	for (S32 i = 0; i < NUM_COMPONENTS; i++)
+	{
+		mComponents[i] = NULL;
+	}
+}
+
+LLObjectMotionStore::~LLObjectMotionStore()
+{
+	for (S32 i = 0; i < NUM_COMPONENTS; i++)
+	{
+		ll_aligned_free_16(mComponents[i]);
+	}
+	delete [] mLastInterpUpdateSecs;
+	delete [] mFlags;
+	delete [] mHandleRefs;
+}
+
+void LLObjectMotionStore::reserve(S32 capacity)
+{
+	if (capacity <= mCapacity)
+	{
+		return;
+	}
+	capacity = llmax(capacity, mCapacity * 2);
+	capacity = (capacity + 3) & ~3;
+
+	for (S32 i = 0; i < NUM_COMPONENTS; i++)
+	{
+		// Zeroed past mCount, so the last group of four is always numbers
+		F32* component = (F32*)ll_aligned_malloc_16(capacity * sizeof(F32));
+		memset(component, 0, capacity * sizeof(F32));
+		if (mComponents[i])
+		{
+			memcpy(component, mComponents[i], mCount * sizeof(F32));
+			ll_aligned_free_16(mComponents[i]);
+		}
+		mComponents[i] = component;
+	}
+
+	F64* secs = new F64[capacity];
+	U8* flags = new U8[capacity];
+	S32** refs = new S32*[capacity];
+	if (mCount)
+	{
+		memcpy(secs, mLastInterpUpdateSecs, mCount * sizeof(F64));
+		memcpy(flags, mFlags, mCount * sizeof(U8));
+		memcpy(refs, mHandleRefs, mCount * sizeof(S32*));
+	}
+	delete [] mLastInterpUpdateSecs;
+	delete [] mFlags;
+	delete [] mHandleRefs;
+	mLastInterpUpdateSecs = secs;
+	mFlags = flags;
+	mHandleRefs = refs;
+
+	mCapacity = capacity;
+}
+
+S32 LLObjectMotionStore::add(S32* handle_ref)
+{
+	reserve(mCount + 1);
+	S32 handle = mCount++;
+	for (S32 i = 0; i < NUM_COMPONENTS; i++)
+	{
+		mComponents[i][handle] = 0.f;
+	}
+	mComponents[TIME_DILATION][handle] = 1.f;
+	mLastInterpUpdateSecs[handle] = 0.0;
+	mFlags[handle] = 0;
+	mHandleRefs[handle] = handle_ref;
+	*handle_ref = handle;
+	return handle;
+}
+
+void LLObjectMotionStore::remove(S32 handle)
+{
+	llassert(handle >= 0 && handle < mCount);
+	S32 last = --mCount;
+	if (handle != last)
+	{
+		for (S32 i = 0; i < NUM_COMPONENTS; i++)
+		{
+			mComponents[i][handle] = mComponents[i][last];
+		}
+		mLastInterpUpdateSecs[handle] = mLastInterpUpdateSecs[last];
+		mFlags[handle] = mFlags[last];
+		mHandleRefs[handle] = mHandleRefs[last];
+		*mHandleRefs[handle] = handle;
+	}
+	for (S32 i = 0; i < NUM_COMPONENTS; i++)
+	{
+		mComponents[i][last] = 0.f;
+	}
+}
+
+void LLObjectMotionStore::setVelocity(S32 handle, const LLVector3& velocity)
+{
+	component(VEL_X)[handle] = velocity.mV[VX];
+	component(VEL_Y)[handle] = velocity.mV[VY];
+	component(VEL_Z)[handle] = velocity.mV[VZ];
+	mFlags[handle] &= ~PREDICTED;
+}
+
+void LLObjectMotionStore::setAcceleration(S32 handle, const LLVector3& acceleration)
+{
+	component(ACCEL_X)[handle] = acceleration.mV[VX];
+	component(ACCEL_Y)[handle] = acceleration.mV[VY];
+	component(ACCEL_Z)[handle] = acceleration.mV[VZ];
+	mFlags[handle] &= ~PREDICTED;
+}
+
+void LLObjectMotionStore::setAngularVelocity(S32 handle, const LLVector3& angular_velocity)
+{
+	component(ANG_VEL_X)[handle] = angular_velocity.mV[VX];
+	component(ANG_VEL_Y)[handle] = angular_velocity.mV[VY];
+	component(ANG_VEL_Z)[handle] = angular_velocity.mV[VZ];
+	mFlags[handle] &= ~PREDICTED;
+}
+
+void LLObjectMotionStore::setTimeDilation(S32 handle, F32 time_dilation)
+{
+	component(TIME_DILATION)[handle] = time_dilation;
+	mFlags[handle] &= ~PREDICTED;
+}
+
+void LLObjectMotionStore::setLastInterpUpdateSecs(S32 handle, F64 secs)
+{
+	mLastInterpUpdateSecs[handle] = secs;
+	mFlags[handle] &= ~PREDICTED;
+}
+
+void LLObjectMotionStore::predict(F64 time)
+{
+	// The same operations in the same order as LLViewerObject's own
+	// idleUpdate(), applyAngularVelocity() and interpolateLinearMotion(), so
+	// that the results match.
+	F32* dt_out = component(DELTA_TIME);
+	const F32* dilation = component(TIME_DILATION);
+	for (S32 i = 0; i < mCount; i++)
+	{
+		F32 dt_raw = (F32)(time - mLastInterpUpdateSecs[i]);
+		dt_out[i] = dilation[i] * dt_raw;
+	}
+
+	const LLVector4a zero(0.f);
+	const LLVector4a half(0.5f);
+	const LLVector4a timestep(PHYSICS_TIMESTEP);
+	const LLVector4a min_spin(MIN_SPIN_SQUARED);
+
+	for (S32 i = 0; i < mCount; i += 4)
+	{
+		LLVector4a dt;
+		dt.load4a(dt_out + i);
+
+		// (vel + (0.5 * (dt - PHYSICS_TIMESTEP)) * accel) * dt
+		LLVector4a k;
+		k.setSub(dt, timestep);
+		k.setMul(half, k);
+
+		U32 still = LLVector4Logical::MASK_XYZW;
+		for (S32 axis = 0; axis < 3; axis++)
+		{
+			LLVector4a vel;
+			LLVector4a accel;
+			vel.load4a(component(VEL_X + axis) + i);
+			accel.load4a(component(ACCEL_X + axis) + i);
+			still &= vel.equal(zero).getGatheredBits() & accel.equal(zero).getGatheredBits();
+
+			LLVector4a disp;
+			disp.setMul(k, accel);
+			disp.setAdd(vel, disp);
+			disp.setMul(disp, dt);
+			disp.store4a(component(DISP_X + axis) + i);
+
+			LLVector4a delta_vel;
+			delta_vel.setMul(accel, dt);
+			delta_vel.store4a(component(DELTA_VEL_X + axis) + i);
+		}
+
+		// x*x + y*y + z*z, like LLVector3::magVecSquared()
+		LLVector4a ang_x;
+		LLVector4a ang_y;
+		LLVector4a ang_z;
+		ang_x.load4a(component(ANG_VEL_X) + i);
+		ang_y.load4a(component(ANG_VEL_Y) + i);
+		ang_z.load4a(component(ANG_VEL_Z) + i);
+		LLVector4a omega_squared;
+		LLVector4a term;
+		omega_squared.setMul(ang_x, ang_x);
+		term.setMul(ang_y, ang_y);
+		omega_squared.setAdd(omega_squared, term);
+		term.setMul(ang_z, ang_z);
+		omega_squared.setAdd(omega_squared, term);
+		U32 spinning = omega_squared.greaterThan(min_spin).getGatheredBits();
+
+		LLVector4a omega;
+		omega = _mm_sqrt_ps(omega_squared);
+		omega.store4a(component(ANGULAR_SPEED) + i);
+		LLVector4a angle;
+		angle.setMul(omega, dt);
+		angle.store4a(component(SPIN_ANGLE) + i);
+
+		S32 lanes = llmin(4, mCount - i);
+		for (S32 lane = 0; lane < lanes; lane++)
+		{
+			U8 flags = PREDICTED;
+			if (!(still & (1 << lane)))
+			{
+				flags |= MOVING;
+			}
+			if (spinning & (1 << lane))
+			{
+				flags |= SPINNING;
+			}
+			mFlags[i + lane] = flags;
+		}
+	}
+}
+
+bool LLObjectMotionStore::isPredicted(S32 handle, F32 dt) const
+{
+	// The results only depend on the inputs and dt
+	return (mFlags[handle] & PREDICTED) && component(DELTA_TIME)[handle] == dt;
+}
+
+bool LLObjectMotionStore::isPredicted(S32 handle, F32 dt, const LLVector3& velocity, const LLVector3& acceleration) const
+{
+	return isPredicted(handle, dt) && matches(handle, VEL_X, velocity) && matches(handle, ACCEL_X, acceleration);
+}
+
+bool LLObjectMotionStore::isPredicted(S32 handle, F32 dt, const LLVector3& angular_velocity) const
+{
+	return isPredicted(handle, dt) && matches(handle, ANG_VEL_X, angular_velocity);
+}
+
+bool LLObjectMotionStore::matches(S32 handle, S32 first, const LLVector3& value) const
+{
+	return component(first)[handle] == value.mV[VX]
+		&& component(first + 1)[handle] == value.mV[VY]
+		&& component(first + 2)[handle] == value.mV[VZ];
+}
+
+F32 LLObjectMotionStore::getDeltaTime(S32 handle) const
+{
+	return component(DELTA_TIME)[handle];
+}
+
+bool LLObjectMotionStore::isMoving(S32 handle) const
+{
+	return (mFlags[handle] & MOVING) != 0;
+}
+
+LLVector3 LLObjectMotionStore::getDisplacement(S32 handle) const
+{
+	return LLVector3(component(DISP_X)[handle],
+					 component(DISP_Y)[handle],
+					 component(DISP_Z)[handle]);
+}
+
+LLVector3 LLObjectMotionStore::getDeltaVelocity(S32 handle) const
+{
+	return LLVector3(component(DELTA_VEL_X)[handle],
+					 component(DELTA_VEL_Y)[handle],
+					 component(DELTA_VEL_Z)[handle]);
+}
+
+bool LLObjectMotionStore::isSpinning(S32 handle) const
+{
+	return (mFlags[handle] & SPINNING) != 0;
+}
+
+F32 LLObjectMotionStore::getAngularSpeed(S32 handle) const
+{
+	return component(ANGULAR_SPEED)[handle];
+}
+
+F32 LLObjectMotionStore::getSpinAngle(S32 handle) const
+{
+	return component(SPIN_ANGLE)[handle];
+}
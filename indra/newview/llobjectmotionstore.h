@@ -0,0 +1,119 @@
+/**
+ * @file llobjectmotionstore.h
+ * @brief Dead reckoning state of the active objects, stored by component.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTMOTIONSTORE_H
+#define LL_LLOBJECTMOTIONSTORE_H
+
+#include "v3math.h"
+
+//
+// A copy of the velocity, acceleration, angular velocity, time dilation and
+// last interpolation time of each object on the active list, kept in one
+// array per component so that predict() can dead reckon four objects at a
+// time with SSE.  LLViewerObject::idleUpdate() then picks up its
+// displacement and spin by handle instead of working them out itself.
+//
+// The objects stay authoritative.  LLViewerObjectList::update() copies
+// every active object's motion in just before predict(), and nothing else
+// writes the entries.  Whoever picks up a prediction passes the inputs it
+// would have used; if anything has changed them since, through whichever
+// setter, it gets no prediction and does the maths itself.  The results
+// are the same either way, to the bit.
+//
+class LLObjectMotionStore
+{
+public:
+	LLObjectMotionStore();
+	~LLObjectMotionStore();
+
+	// Adds a zeroed entry and returns its handle.  Removing other entries
+	// moves this one, so *handle_ref is updated when that happens; it has to
+	// stay valid until the entry is removed.
+	S32 add(S32* handle_ref);
+	void remove(S32 handle);
+	S32 size() const { return mCount; }
+
+	void setVelocity(S32 handle, const LLVector3& velocity);
+	void setAcceleration(S32 handle, const LLVector3& acceleration);
+	void setAngularVelocity(S32 handle, const LLVector3& angular_velocity);
+	void setTimeDilation(S32 handle, F32 time_dilation);
+	void setLastInterpUpdateSecs(S32 handle, F64 secs);
+
+	// Dead reckons every entry from its last interpolation to time
+	void predict(F64 time);
+
+	// Whether the last predict() worked the entry out over dt from this
+	// velocity and acceleration, or this angular velocity.  The linear or
+	// angular results are only meaningful if so.
+	bool isPredicted(S32 handle, F32 dt, const LLVector3& velocity, const LLVector3& acceleration) const;
+	bool isPredicted(S32 handle, F32 dt, const LLVector3& angular_velocity) const;
+	// Time dilated seconds since the last interpolation
+	F32 getDeltaTime(S32 handle) const;
+	// Velocity or acceleration isn't zero
+	bool isMoving(S32 handle) const;
+	LLVector3 getDisplacement(S32 handle) const;
+	LLVector3 getDeltaVelocity(S32 handle) const;
+	// Angular velocity is big enough to turn the object
+	bool isSpinning(S32 handle) const;
+	F32 getAngularSpeed(S32 handle) const;
+	F32 getSpinAngle(S32 handle) const;
+
+private:
+	enum
+	{
+		VEL_X, VEL_Y, VEL_Z,
+		ACCEL_X, ACCEL_Y, ACCEL_Z,
+		ANG_VEL_X, ANG_VEL_Y, ANG_VEL_Z,
+		TIME_DILATION,
+		DELTA_TIME,
+		DISP_X, DISP_Y, DISP_Z,
+		DELTA_VEL_X, DELTA_VEL_Y, DELTA_VEL_Z,
+		ANGULAR_SPEED,
+		SPIN_ANGLE,
+		NUM_COMPONENTS
+	};
+
+	enum
+	{
+		PREDICTED	= 0x1,
+		MOVING		= 0x2,
+		SPINNING	= 0x4
+	};
+
+	void reserve(S32 capacity);
+	bool isPredicted(S32 handle, F32 dt) const;
+	bool matches(S32 handle, S32 first, const LLVector3& value) const;
+	F32* component(S32 which) const { return mComponents[which]; }
+
+	S32			mCount;
+	S32			mCapacity;		// a multiple of four
+	F32*		mComponents[NUM_COMPONENTS];	// 16 byte aligned
+	F64*		mLastInterpUpdateSecs;
+	U8*			mFlags;
+	S32**		mHandleRefs;
+};
+
+#endif // LL_LLOBJECTMOTIONSTORE_H
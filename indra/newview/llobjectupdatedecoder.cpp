@@ -0,0 +1,325 @@
+/**
+ * @file llobjectupdatedecoder.cpp
+ * @brief Decodes full object update blocks on worker threads.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llobjectupdatedecoder.h"
+
+#include "lldatapacker.h"
+#include "lljobscheduler.h"
+#include "llpartdata.h"
+#include "llvolumemessage.h"
+#include "llprimitive.h"
+
+// Fewer blocks than this aren't worth waking the workers for
+const S32 MIN_BLOCKS_TO_SHARE = 8;
+// Blocks a worker takes at a time
+const S32 BLOCKS_PER_TAKE = 4;
+// Largest block readCapture() believes
+const S32 MAX_CAPTURED_BLOCK_SIZE = 64 * 1024;
+
+LLDecodedObjectUpdate::LLDecodedObjectUpdate()
+:	mData(NULL),
+	mDataSize(0),
+	mValid(false),
+	mLocalID(0),
+	mPCode(0),
+	mState(0),
+	mCRC(0),
+	mSpecialCode(0),
+	mParentID(0),
+	mSculptType(0),
+	mHasVolume(false),
+	mVolumeOffset(0),
+	mTEOffset(0),
+	mTEEnd(0)
+{
+}
+
+namespace
+{
+	// The blocks of one decode() call
+	class LLDecodeRange : public LLParallelFor
+	{
+	public:
+		LLDecodeRange(std::vector<LLDecodedObjectUpdate>& updates) : mUpdates(updates) {}
+
+		/*virtual*/ void runRange(S32 begin, S32 end)
+		{
+			for (S32 i = begin; i < end; i++)
+			{
+				LLObjectUpdateDecoder::decodeBlock(mUpdates[i]);
+			}
+		}
+
+	private:
+		std::vector<LLDecodedObjectUpdate>& mUpdates;
+	};
+
+	// Moves past fields decodeBlock() doesn't keep without copying them out
+
+	bool skip_bytes(LLDataPackerBinaryBuffer& dp, S32 bytes)
+	{
+		S32 pos = dp.getCurrentSize() + bytes;
+		if (bytes < 0 || pos > dp.getBufferSize())
+		{
+			return false;
+		}
+		dp.setCurrentSize(pos);
+		return true;
+	}
+
+	bool skip_string(LLDataPackerBinaryBuffer& dp)
+	{
+		const U8* begin = dp.getBuffer() + dp.getCurrentSize();
+		const U8* nul = (const U8*)memchr(begin, 0, dp.getBufferSize() - dp.getCurrentSize());
+		return nul && skip_bytes(dp, (S32)(nul - begin) + 1);
+	}
+
+	// Size prefixed binary data, left where it is
+	bool skip_binary_data(LLDataPackerBinaryBuffer& dp, U8*& data, S32& size)
+	{
+		if (!dp.unpackS32(size, "size"))
+		{
+			return false;
+		}
+		data = const_cast<U8*>(dp.getBuffer()) + dp.getCurrentSize();
+		return skip_bytes(dp, size);
+	}
+}
+
+//----------------------------------------------------------------------------
+// LLObjectUpdateDecoder
+//----------------------------------------------------------------------------
+
+void LLObjectUpdateDecoder::decode(std::vector<LLDecodedObjectUpdate>& updates)
+{
+	if (mCapture.is_open())
+	{
+		for (U32 i = 0; i < updates.size(); i++)
+		{
+			S32 size = updates[i].mData ? updates[i].mDataSize : 0;
+			mCapture.write((const char*)&size, sizeof(S32));
+			mCapture.write((const char*)updates[i].mData, size);
+		}
+	}
+
+	S32 count = (S32)updates.size();
+	LLDecodeRange blocks(updates);
+	blocks.run(count, count < MIN_BLOCKS_TO_SHARE ? count : BLOCKS_PER_TAKE);
+}
+
+// static
+void LLObjectUpdateDecoder::decodeBlock(LLDecodedObjectUpdate& update)
+{
+	update.mValid = false;
+	update.mHasVolume = false;
+	update.mSculptID.setNull();
+	update.mSculptType = 0;
+	if (!update.mData || update.mDataSize <= 0)
+	{
+		return;
+	}
+
+	// Only ever read from
+	LLDataPackerBinaryBuffer dp(const_cast<U8*>(update.mData), update.mDataSize);
+
+	// In the order LLViewerObject::processUpdateMessage() unpacks them
+	BOOL success = dp.unpackUUID(update.mFullID, "ID")
+		&& dp.unpackU32(update.mLocalID, "LocalID")
+		&& dp.unpackU8(update.mPCode, "PCode")
+		&& dp.unpackU8(update.mState, "State")
+		&& dp.unpackU32(update.mCRC, "CRC")
+		&& skip_bytes(dp, 2)			// Material, ClickAction
+		&& dp.unpackVector3(update.mScale, "Scale")
+		&& dp.unpackVector3(update.mPosition, "Pos")
+		&& skip_bytes(dp, 12)			// Rot
+		&& dp.unpackU32(update.mSpecialCode, "SpecialCode")
+		&& dp.unpackUUID(update.mOwnerID, "Owner");
+	if (!success)
+	{
+		return;
+	}
+
+	const U32 value = update.mSpecialCode;
+	dp.setPassFlags(value);
+
+	if (value & 0x80)
+	{
+		success = skip_bytes(dp, 12);	// Omega
+	}
+
+	update.mParentID = 0;
+	if (success && (value & 0x20))
+	{
+		success = dp.unpackU32(update.mParentID, "ParentID");
+	}
+
+	U8* data;
+	S32 size;
+	if (success && (value & 0x2))
+	{
+		success = skip_bytes(dp, 1);	// TreeData
+	}
+	else if (success && (value & 0x1))
+	{
+		success = skip_bytes(dp, 4)		// ScratchPadSize
+			&& skip_binary_data(dp, data, size);
+	}
+
+	if (success && (value & 0x4))
+	{
+		success = skip_string(dp)		// Text
+			&& skip_bytes(dp, 4);		// Color
+	}
+
+	if (success && (value & 0x200))
+	{
+		success = skip_string(dp);		// MediaURL
+	}
+
+	if (success && (value & 0x8))
+	{
+		success = skip_bytes(dp, PS_DATA_BLOCK_SIZE);
+	}
+
+	U8 num_parameters = 0;
+	success = success && dp.unpackU8(num_parameters, "num_params");
+	for (U8 param = 0; success && param < num_parameters; ++param)
+	{
+		U16 param_type;
+		success = dp.unpackU16(param_type, "param_type")
+			&& skip_binary_data(dp, data, size);
+		if (success && param_type == LLNetworkData::PARAMS_SCULPT)
+		{
+			LLDataPackerBinaryBuffer param_dp(data, size);
+			LLSculptParams sculpt;
+			if (sculpt.unpack(param_dp))
+			{
+				update.mSculptID = sculpt.getSculptTexture();
+				update.mSculptType = sculpt.getSculptType();
+			}
+		}
+	}
+
+	if (success && (value & 0x10))
+	{
+		// SoundUUID, SoundGain, SoundFlags, SoundRadius
+		success = skip_bytes(dp, 16 + 4 + 1 + 4);
+	}
+
+	if (success && (value & 0x100))
+	{
+		success = skip_string(dp);		// NV
+	}
+
+	if (!success)
+	{
+		return;
+	}
+
+	// Then LLVOVolume::processUpdateMessage()
+	if (update.mPCode == LL_PCODE_VOLUME)
+	{
+		update.mVolumeOffset = dp.getCurrentSize();
+		if (!LLVolumeMessage::unpackVolumeParams(&update.mVolumeParams, dp))
+		{
+			return;
+		}
+		update.mTEOffset = dp.getCurrentSize();
+		if (!skip_binary_data(dp, data, size))
+		{
+			return;
+		}
+		LLPrimitive::parseTEMessage(data, size, update.mTEContents);
+		update.mTEEnd = dp.getCurrentSize();
+		update.mHasVolume = true;
+	}
+
+	update.mValid = true;
+}
+
+void LLObjectUpdateDecoder::setCaptureFile(const std::string& filename)
+{
+	if (filename == mCaptureFilename)
+	{
+		return;
+	}
+	if (mCapture.is_open())
+	{
+		mCapture.close();
+	}
+	mCaptureFilename = filename;
+	if (!filename.empty())
+	{
+		mCapture.open(filename, std::ios::out | std::ios::binary | std::ios::app);
+		if (!mCapture.is_open())
+		{
+			llwarns << "Can't capture object updates to " << filename << llendl;
+		}
+	}
+}
+
+// static
+bool LLObjectUpdateDecoder::readCapture(const std::string& filename, std::vector<U8>& buffer,
+										std::vector<LLDecodedObjectUpdate>& updates)
+{
+	llifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	const U32 first = updates.size();
+	std::vector<S32> offsets;
+	S32 size;
+	while (file.read((char*)&size, sizeof(S32)))
+	{
+		if (size < 0 || size > MAX_CAPTURED_BLOCK_SIZE)
+		{
+			llwarns << "Bad block size " << size << " in " << filename << llendl;
+			return false;
+		}
+		S32 offset = (S32)buffer.size();
+		buffer.resize(offset + size);
+		if (size && !file.read((char*)&buffer[offset], size))
+		{
+			llwarns << "Truncated object update capture " << filename << llendl;
+			return false;
+		}
+		offsets.push_back(offset);
+		updates.push_back(LLDecodedObjectUpdate());
+		updates.back().mDataSize = size;
+	}
+
+	// Now that the buffer won't move
+	for (U32 i = 0; i < offsets.size(); i++)
+	{
+		LLDecodedObjectUpdate& update = updates[first + i];
+		update.mData = update.mDataSize ? &buffer[offsets[i]] : NULL;
+	}
+	return true;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file llobjectupdatedecoder.h
+ * @brief Decodes full object update blocks on the job scheduler's workers.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTUPDATEDECODER_H
+#define LL_LLOBJECTUPDATEDECODER_H
+
+#include <vector>
+
+#include "llprimitive.h"
+#include "lluuid.h"
+#include "llvolume.h"
+#include "llfile.h"
+
+// The data of an ObjectUpdateCompressed block, or of a cached object, as
+// plain values.  Only the fields below are unpacked, the rest are skipped
+// over to find the volume parameters and texture entries.  Those are the
+// expensive parts, kept with where they were in the data so that the
+// object can skip over them in turn.
+class LLDecodedObjectUpdate
+{
+public:
+	LLDecodedObjectUpdate();
+
+	// Set by whoever queues the block.  The data isn't copied.
+	const U8*		mData;
+	S32				mDataSize;
+
+	// Set by decoding
+	bool			mValid;		// the whole block unpacked
+	LLUUID			mFullID;
+	U32				mLocalID;
+	U8				mPCode;
+	U8				mState;
+	U32				mCRC;
+	U32				mSpecialCode;
+	LLUUID			mOwnerID;
+	U32				mParentID;
+	LLVector3		mScale;
+	LLVector3		mPosition;	// region local, or off the parent
+	LLUUID			mSculptID;	// of the sculpt parameter, if there is one
+	U8				mSculptType;
+
+	// Volumes only
+	bool			mHasVolume;
+	S32				mVolumeOffset;	// of the volume params in mData
+	S32				mTEOffset;		// of the texture entries, which follow
+	S32				mTEEnd;
+	LLVolumeParams	mVolumeParams;
+	LLTEContents	mTEContents;
+};
+
+//
+// Decodes a message's worth of blocks at once, split across the caller
+// and LLJobScheduler's workers, and returns when they are all done.  A
+// burst of updates after a teleport then costs the main thread only
+// creating and linking the objects.
+//
+class LLObjectUpdateDecoder
+{
+public:
+	void decode(std::vector<LLDecodedObjectUpdate>& updates);
+
+	// Decodes one block on the calling thread
+	static void decodeBlock(LLDecodedObjectUpdate& update);
+
+	// Append each block decoded from now on to filename, to replay later.
+	// Each is its size as an S32 and then its data.  Empty stops.
+	void setCaptureFile(const std::string& filename);
+	// Read a file written that way, for decoding again.  The blocks' data
+	// is kept in buffer.
+	static bool readCapture(const std::string& filename, std::vector<U8>& buffer,
+							std::vector<LLDecodedObjectUpdate>& updates);
+
+private:
+	std::string							mCaptureFilename;
+	llofstream							mCapture;
+};
+
+#endif // LL_LLOBJECTUPDATEDECODER_H
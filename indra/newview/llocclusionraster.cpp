@@ -0,0 +1,667 @@
+/**
+ * @file llocclusionraster.cpp
+ * @brief A low resolution depth buffer of large occluders, rasterized on the CPU.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llocclusionraster.h"
+
+#include <algorithm>
+
+#include "lljobscheduler.h"
+#include "llmemory.h"
+
+namespace
+{
+	// Outcodes of a clip space vertex
+	enum
+	{
+		OUT_LEFT = 1,
+		OUT_RIGHT = 1 << 1,
+		OUT_BOTTOM = 1 << 2,
+		OUT_TOP = 1 << 3,
+		OUT_NEAR = 1 << 4
+	};
+
+	U32 outcode(const LLVector4a& v, F32 near_clip)
+	{
+		const F32 x = v[0];
+		const F32 y = v[1];
+		const F32 w = v[3];
+		U32 code = 0;
+		if (x < -w) code |= OUT_LEFT;
+		if (x > w) code |= OUT_RIGHT;
+		if (y < -w) code |= OUT_BOTTOM;
+		if (y > w) code |= OUT_TOP;
+		if (w < near_clip) code |= OUT_NEAR;
+		return code;
+	}
+
+	// The corners of a box by bit, x then y then z, and its faces counter
+	// clockwise from outside
+	const U16 BOX_INDICES[36] =
+	{
+		0, 4, 6,	0, 6, 2,	// -x
+		1, 3, 7,	1, 7, 5,	// +x
+		0, 1, 5,	0, 5, 4,	// -y
+		2, 6, 7,	2, 7, 3,	// +y
+		0, 2, 3,	0, 3, 1,	// -z
+		4, 5, 7,	4, 7, 6		// +z
+	};
+}
+
+// One build's bands
+class LLOcclusionRaster::BandRange : public LLParallelFor
+{
+public:
+	BandRange(LLOcclusionRaster *raster) : mRaster(raster) {}
+
+	/*virtual*/ void runRange(S32 begin, S32 end)
+	{
+		for (S32 band = begin; band < end; band++)
+		{
+			mRaster->rasterizeBand(band);
+		}
+	}
+
+private:
+	LLOcclusionRaster *mRaster;
+};
+
+LLOcclusionRaster::LLOcclusionRaster() :
+	mNearClip(0.f),
+	mClip(NULL),
+	mClipCapacity(0),
+	mBuilt(false)
+{
+	mViewProj = (LLMatrix4a *)ll_aligned_malloc_16(sizeof(LLMatrix4a));
+	mViewProj->clear();
+	mDepth = (F32 *)ll_aligned_malloc_16(WIDTH*HEIGHT*sizeof(F32));
+	mTileMin = (F32 *)ll_aligned_malloc_16(TILES_X*TILES_Y*sizeof(F32));
+	mTileMax = (F32 *)ll_aligned_malloc_16(TILES_X*TILES_Y*sizeof(F32));
+	memset(mDepth, 0, WIDTH*HEIGHT*sizeof(F32));
+	memset(mTileMin, 0, TILES_X*TILES_Y*sizeof(F32));
+	memset(mTileMax, 0, TILES_X*TILES_Y*sizeof(F32));
+}
+
+LLOcclusionRaster::~LLOcclusionRaster()
+{
+	ll_aligned_free_16(mViewProj);
+	ll_aligned_free_16(mClip);
+	ll_aligned_free_16(mDepth);
+	ll_aligned_free_16(mTileMin);
+	ll_aligned_free_16(mTileMax);
+}
+
+void LLOcclusionRaster::begin(const LLMatrix4a& view_proj, F32 near_clip)
+{
+	*mViewProj = view_proj;
+	mNearClip = near_clip;
+	mTriangles.clear();
+	mBuilt = false;
+}
+
+void LLOcclusionRaster::transform(const LLVector4a& v, LLVector4a& res) const
+{
+	LLVector4a x, y, z;
+	x.splat<0>(v);
+	y.splat<1>(v);
+	z.splat<2>(v);
+	x.mul(mViewProj->mMatrix[0]);
+	y.mul(mViewProj->mMatrix[1]);
+	z.mul(mViewProj->mMatrix[2]);
+	x.add(y);
+	z.add(mViewProj->mMatrix[3]);
+	res.setAdd(x, z);
+}
+
+void LLOcclusionRaster::addTriangles(const LLVector4a* verts, S32 num_verts, const U16* indices, S32 num_indices)
+{
+	if (num_verts > mClipCapacity)
+	{
+		ll_aligned_free_16(mClip);
+		mClipCapacity = llmax(num_verts, 64);
+		mClip = (LLVector4a *)ll_aligned_malloc_16(mClipCapacity*sizeof(LLVector4a));
+	}
+	mScreen.resize(num_verts*2);
+	for (S32 i = 0; i < num_verts; i++)
+	{
+		transform(verts[i], mClip[i]);
+		const F32 inv_w = 1.f / mClip[i][3];
+		mScreen[i*2] = (mClip[i][0]*inv_w*0.5f + 0.5f)*WIDTH;
+		mScreen[i*2 + 1] = (mClip[i][1]*inv_w*0.5f + 0.5f)*HEIGHT;
+	}
+
+	// Which triangles face the camera.  The determinant of their clip
+	// space x, y and w has the sign of their winding on screen, and still
+	// tells which way they face with vertices behind the eye.
+	const S32 num_tris = num_indices / 3;
+	mSeams.assign(num_tris, 0);
+	mFarDepth.assign(num_tris, -1.f);
+	mNumGuards.assign(num_tris, 0);
+	mGuards.resize(num_tris*MAX_GUARDS*3);
+	mEdgeKeys.clear();
+	for (S32 t = 0; t < num_tris; t++)
+	{
+		const U16 *tri = indices + t*3;
+		const LLVector4a& a = mClip[tri[0]];
+		const LLVector4a& b = mClip[tri[1]];
+		const LLVector4a& c = mClip[tri[2]];
+		const F32 det = a[0]*(b[1]*c[3] - b[3]*c[1])
+						- a[1]*(b[0]*c[3] - b[3]*c[0])
+						+ a[3]*(b[0]*c[1] - b[1]*c[0]);
+		if (det <= 0.f)
+		{
+			continue;
+		}
+
+		// The farthest any of it in front of the near clip is
+		F32 far_depth = 1.f / mNearClip;
+		for (S32 i = 0; i < 3; i++)
+		{
+			const F32 w = mClip[tri[i]][3];
+			if (w >= mNearClip)
+			{
+				far_depth = llmin(far_depth, 1.f / w);
+			}
+		}
+		mFarDepth[t] = far_depth;
+
+		for (S32 i = 0; i < 3; i++)
+		{
+			const U32 v0 = tri[i];
+			const U32 v1 = tri[(i + 1) % 3];
+			const U64 edge = v0 < v1 ? (v0 << 16) | v1 : (v1 << 16) | v0;
+			mEdgeKeys.push_back((edge << 32) | ((U32)(t*3 + i) << 1) | (v0 < v1 ? 0 : 1));
+		}
+	}
+
+	// An edge two front faces share the other way round is a seam, inside
+	// the mesh as seen.  Pulling seams in like the outline would leave a
+	// crack along each, so a pixel over one is taken instead when its
+	// center is on this side and all of it is inside the outer edges of
+	// the faces either side.  Those of the face across are its guards.
+	std::sort(mEdgeKeys.begin(), mEdgeKeys.end());
+	mSeamDepth = mFarDepth;
+	const S32 num_edges = (S32)mEdgeKeys.size();
+	for (S32 i = 0; i + 1 < num_edges; i++)
+	{
+		const U64 key = mEdgeKeys[i];
+		const U64 next = mEdgeKeys[i + 1];
+		if ((key >> 32) != (next >> 32)
+			|| (i + 2 < num_edges && (mEdgeKeys[i + 2] >> 32) == (key >> 32))
+			|| (key & 1) == (next & 1))
+		{
+			// Not shared, shared by more than two, or wound inconsistently
+			continue;
+		}
+		i++;
+
+		const U32 e0 = (U32)(key & 0xffffffff) >> 1;
+		const U32 e1 = (U32)(next & 0xffffffff) >> 1;
+		const U32 t0 = e0 / 3;
+		const U32 t1 = e1 / 3;
+		if (!inFront(indices + t0*3) || !inFront(indices + t1*3))
+		{
+			// Where the screen lines of the face across aren't to be had
+			continue;
+		}
+		mSeams[t0] |= 1 << (e0 % 3);
+		mSeams[t1] |= 1 << (e1 % 3);
+		mSeamDepth[t0] = llmin(mSeamDepth[t0], mFarDepth[t1]);
+		mSeamDepth[t1] = llmin(mSeamDepth[t1], mFarDepth[t0]);
+		addGuards(t0, indices + t1*3, e1 % 3);
+		addGuards(t1, indices + t0*3, e0 % 3);
+	}
+
+	for (S32 t = 0; t < num_tris; t++)
+	{
+		if (mFarDepth[t] >= 0.f)
+		{
+			const U16 *tri = indices + t*3;
+			addClipTriangle(mClip[tri[0]], mClip[tri[1]], mClip[tri[2]], mSeams[t], mSeamDepth[t],
+							&mGuards[t*MAX_GUARDS*3], mNumGuards[t]);
+		}
+	}
+}
+
+bool LLOcclusionRaster::inFront(const U16* tri) const
+{
+	return mClip[tri[0]][3] >= mNearClip && mClip[tri[1]][3] >= mNearClip && mClip[tri[2]][3] >= mNearClip;
+}
+
+void LLOcclusionRaster::addGuards(S32 t, const U16* across, S32 seam)
+{
+	for (S32 i = 1; i < 3; i++)
+	{
+		const S32 edge = (seam + i) % 3;
+		const F32 x0 = mScreen[across[edge]*2];
+		const F32 y0 = mScreen[across[edge]*2 + 1];
+		const F32 x1 = mScreen[across[(edge + 1) % 3]*2];
+		const F32 y1 = mScreen[across[(edge + 1) % 3]*2 + 1];
+		const F32 a = y0 - y1;
+		const F32 b = x1 - x0;
+		F32 *guard = &mGuards[(t*MAX_GUARDS + mNumGuards[t])*3];
+		guard[0] = a;
+		guard[1] = b;
+		guard[2] = -(a*x0 + b*y0) - 0.5f*(fabsf(a) + fabsf(b));
+		mNumGuards[t]++;
+	}
+}
+
+void LLOcclusionRaster::addBox(const LLVector4a& center, const LLVector4a* axes)
+{
+	LLVector4a corners[8];
+	for (S32 i = 0; i < 8; i++)
+	{
+		corners[i] = center;
+		for (S32 axis = 0; axis < 3; axis++)
+		{
+			if (i & (1 << axis))
+			{
+				corners[i].add(axes[axis]);
+			}
+			else
+			{
+				corners[i].sub(axes[axis]);
+			}
+		}
+	}
+	addTriangles(corners, 8, BOX_INDICES, 36);
+}
+
+void LLOcclusionRaster::addClipTriangle(const LLVector4a& v0, const LLVector4a& v1, const LLVector4a& v2,
+										U32 seams, F32 seam_depth, const F32* guards, S32 num_guards)
+{
+	const U32 code0 = outcode(v0, mNearClip);
+	const U32 code1 = outcode(v1, mNearClip);
+	const U32 code2 = outcode(v2, mNearClip);
+	if (code0 & code1 & code2)
+	{
+		// All outside the same plane
+		return;
+	}
+
+	LLVector4a in[3];
+	in[0] = v0;
+	in[1] = v1;
+	in[2] = v2;
+	if (!((code0 | code1 | code2) & OUT_NEAR))
+	{
+		setupTriangle(in, seams, seam_depth, guards, num_guards);
+		return;
+	}
+
+	// Clip to the near plane, which leaves at most a quad.  Each vertex
+	// out keeps whether the edge from it is a seam; the edge along the
+	// near plane isn't.
+	LLVector4a out[4];
+	U32 out_seams[4];
+	S32 count = 0;
+	for (S32 i = 0; i < 3; i++)
+	{
+		const LLVector4a& a = in[i];
+		const LLVector4a& b = in[(i + 1) % 3];
+		const U32 seam = (seams >> i) & 1;
+		const F32 da = a[3] - mNearClip;
+		const F32 db = b[3] - mNearClip;
+		if (da >= 0.f)
+		{
+			out_seams[count] = db >= 0.f ? seam : 0;
+			out[count++] = a;
+		}
+		if ((da >= 0.f) != (db >= 0.f))
+		{
+			LLVector4a t(da / (da - db));
+			out[count].setSub(b, a);
+			out[count].mul(t);
+			out[count].add(a);
+			out_seams[count++] = da >= 0.f ? 0 : seam;
+		}
+	}
+
+	// As a fan.  The fan's own inner edge is pulled in too, as it has no
+	// guards; it's rare enough for the crack not to matter.
+	for (S32 i = 1; i + 1 < count; i++)
+	{
+		LLVector4a tri[3];
+		tri[0] = out[0];
+		tri[1] = out[i];
+		tri[2] = out[i + 1];
+		const U32 fan_seams = (i == 1 ? out_seams[0] : 0)
+							  | (out_seams[i] << 1)
+							  | ((i + 2 == count ? out_seams[count - 1] : 0) << 2);
+		setupTriangle(tri, fan_seams, seam_depth, guards, num_guards);
+	}
+}
+
+void LLOcclusionRaster::setupTriangle(const LLVector4a* clip, U32 seams, F32 seam_depth,
+									  const F32* guards, S32 num_guards)
+{
+	F32 x[3];
+	F32 y[3];
+	F32 z[3];
+	for (S32 i = 0; i < 3; i++)
+	{
+		// A vertex clipped to the near plane may land a hair short of it
+		const F32 inv_w = 1.f / llmax(clip[i][3], mNearClip);
+		x[i] = (clip[i][0]*inv_w*0.5f + 0.5f)*WIDTH;
+		y[i] = (clip[i][1]*inv_w*0.5f + 0.5f)*HEIGHT;
+		z[i] = inv_w;
+	}
+
+	const F32 dx1 = x[1] - x[0];
+	const F32 dy1 = y[1] - y[0];
+	const F32 dz1 = z[1] - z[0];
+	const F32 dx2 = x[2] - x[0];
+	const F32 dy2 = y[2] - y[0];
+	const F32 dz2 = z[2] - z[0];
+	const F32 det = dx1*dy2 - dx2*dy1;
+	if (det <= 0.f)
+	{
+		// Edge on
+		return;
+	}
+
+	// Pixels with their centers in it
+	Triangle tri;
+	tri.mMinX = (S32)ceilf(llmax(llmin(x[0], x[1], x[2]) - 0.5f, 0.f));
+	tri.mMaxX = (S32)floorf(llmin(llmax(x[0], x[1], x[2]) - 0.5f, (F32)(WIDTH - 1)));
+	tri.mMinY = (S32)ceilf(llmax(llmin(y[0], y[1], y[2]) - 0.5f, 0.f));
+	tri.mMaxY = (S32)floorf(llmin(llmax(y[0], y[1], y[2]) - 0.5f, (F32)(HEIGHT - 1)));
+	if (tri.mMinX > tri.mMaxX || tri.mMinY > tri.mMaxY)
+	{
+		return;
+	}
+
+	// Edges are tested at pixel centers.  The outline is pulled in by half
+	// a pixel's worth, so a pixel is only inside it when all of it is.
+	for (S32 i = 0; i < 3; i++)
+	{
+		const S32 j = (i + 1) % 3;
+		const F32 a = y[i] - y[j];
+		const F32 b = x[j] - x[i];
+		const F32 pull = 0.5f*(fabsf(a) + fabsf(b));
+		tri.mEdge[i][0] = a;
+		tri.mEdge[i][1] = b;
+		tri.mEdge[i][2] = -(a*x[i] + b*y[i]) - ((seams >> i) & 1 ? 0.f : pull);
+		tri.mEdge[i][3] = (seams >> i) & 1 ? pull : 0.f;
+	}
+	tri.mSeams = seams;
+	tri.mNumGuards = seams ? num_guards : 0;
+	memcpy(tri.mGuard, guards, tri.mNumGuards*3*sizeof(F32));
+
+	// 1/w is linear across the screen.  Taken at the far corner of each
+	// pixel, and never farther than the farthest vertex.
+	const F32 a = (dz1*dy2 - dz2*dy1) / det;
+	const F32 b = (dx1*dz2 - dx2*dz1) / det;
+	tri.mDepth[0] = a;
+	tri.mDepth[1] = b;
+	tri.mDepth[2] = z[0] - a*x[0] - b*y[0] - 0.5f*(fabsf(a) + fabsf(b));
+	tri.mMinDepth = llmin(z[0], z[1], z[2]);
+	tri.mSeamDepth = seam_depth;
+
+	mTriangles.push_back(tri);
+}
+
+void LLOcclusionRaster::build(bool on_worker)
+{
+	// A band at a time, or all of them here when there's nothing to share
+	BandRange bands(this);
+	bands.run(NUM_BANDS, on_worker && !mTriangles.empty() ? 1 : NUM_BANDS);
+	mBuilt = true;
+}
+
+void LLOcclusionRaster::rasterizeBand(S32 band)
+{
+	const S32 band_min = band*BAND_HEIGHT;
+	const S32 band_max = band_min + BAND_HEIGHT - 1;
+	memset(mDepth + band_min*WIDTH, 0, BAND_HEIGHT*WIDTH*sizeof(F32));
+
+	const LLVector4a zero(0.f);
+	const LLVector4a four(4.f);
+	LLVector4a offsets;
+	offsets.set(0.5f, 1.5f, 2.5f, 3.5f);
+
+	const S32 count = (S32)mTriangles.size();
+	for (S32 t = 0; t < count; t++)
+	{
+		const Triangle& tri = mTriangles[t];
+		if (tri.mMaxY < band_min || tri.mMinY > band_max)
+		{
+			continue;
+		}
+
+		const LLVector4a a0(tri.mEdge[0][0]);
+		const LLVector4a a1(tri.mEdge[1][0]);
+		const LLVector4a a2(tri.mEdge[2][0]);
+		const LLVector4a pull0(tri.mEdge[0][3]);
+		const LLVector4a pull1(tri.mEdge[1][3]);
+		const LLVector4a pull2(tri.mEdge[2][3]);
+		const LLVector4a depth_a(tri.mDepth[0]);
+		const LLVector4a min_depth(tri.mMinDepth);
+		const LLVector4a seam_depth(tri.mSeamDepth);
+		// Groups of four from a 16 byte boundary
+		const S32 min_x = tri.mMinX & ~3;
+		const F32 min_px = (F32)min_x;
+
+		const S32 min_y = llmax(tri.mMinY, band_min);
+		const S32 max_y = llmin(tri.mMaxY, band_max);
+		for (S32 y = min_y; y <= max_y; y++)
+		{
+			const F32 py = y + 0.5f;
+			const LLVector4a row0(tri.mEdge[0][1]*py + tri.mEdge[0][2]);
+			const LLVector4a row1(tri.mEdge[1][1]*py + tri.mEdge[1][2]);
+			const LLVector4a row2(tri.mEdge[2][1]*py + tri.mEdge[2][2]);
+			const LLVector4a depth_row(tri.mDepth[1]*py + tri.mDepth[2]);
+
+			LLVector4a px(min_px);
+			px.add(offsets);
+			F32 *row = mDepth + y*WIDTH;
+			for (S32 x = min_x; x <= tri.mMaxX; x += 4, px.add(four))
+			{
+				LLVector4a e0, e1, e2;
+				e0.setMul(a0, px);
+				e0.add(row0);
+				e1.setMul(a1, px);
+				e1.add(row1);
+				e2.setMul(a2, px);
+				e2.add(row2);
+				LLVector4Logical inside(_mm_and_ps(_mm_and_ps(e0.greaterEqual(zero), e1.greaterEqual(zero)),
+												   e2.greaterEqual(zero)));
+				if (!inside.areAnySet())
+				{
+					continue;
+				}
+
+				LLVector4a depth;
+				depth.setMul(depth_a, px);
+				depth.add(depth_row);
+				depth.setMax(depth, min_depth);
+				if (tri.mSeams)
+				{
+					// Over a seam only if inside the guards, and then the
+					// plane doesn't hold, only how far the faces either
+					// side go
+					const LLVector4Logical whole(_mm_and_ps(_mm_and_ps(e0.greaterEqual(pull0), e1.greaterEqual(pull1)),
+															e2.greaterEqual(pull2)));
+					LLQuad guarded = inside;
+					for (S32 g = 0; g < tri.mNumGuards; g++)
+					{
+						LLVector4a e;
+						e.setMul(LLVector4a(tri.mGuard[g][0]), px);
+						e.add(LLVector4a(tri.mGuard[g][1]*py + tri.mGuard[g][2]));
+						guarded = _mm_and_ps(guarded, e.greaterEqual(zero));
+					}
+					inside = LLVector4Logical(_mm_or_ps(whole, guarded));
+					depth.setSelectWithMask(whole, depth, seam_depth);
+				}
+
+				LLVector4a old;
+				old.load4a(row + x);
+				depth.setMax(depth, old);
+				old.setSelectWithMask(inside, depth, old);
+				old.store4a(row + x);
+			}
+		}
+	}
+
+	// The band's tiles
+	for (S32 ty = band_min / TILE_SIZE; ty <= band_max / TILE_SIZE; ty++)
+	{
+		for (S32 tx = 0; tx < TILES_X; tx++)
+		{
+			LLVector4a tile_min;
+			LLVector4a tile_max;
+			tile_min.load4a(mDepth + ty*TILE_SIZE*WIDTH + tx*TILE_SIZE);
+			tile_max = tile_min;
+			for (S32 y = 0; y < TILE_SIZE; y++)
+			{
+				const F32 *row = mDepth + (ty*TILE_SIZE + y)*WIDTH + tx*TILE_SIZE;
+				for (S32 x = 0; x < TILE_SIZE; x += 4)
+				{
+					LLVector4a v;
+					v.load4a(row + x);
+					tile_min.setMin(tile_min, v);
+					tile_max.setMax(tile_max, v);
+				}
+			}
+			mTileMin[ty*TILES_X + tx] = llmin(tile_min[0], tile_min[1], tile_min[2], tile_min[3]);
+			mTileMax[ty*TILES_X + tx] = llmax(tile_max[0], tile_max[1], tile_max[2], tile_max[3]);
+		}
+	}
+}
+
+bool LLOcclusionRaster::isOccluded(const LLVector4a& center, const LLVector4a& extents) const
+{
+	if (!mBuilt)
+	{
+		return false;
+	}
+
+	// The corners in clip space, from the center and the axes' parts
+	LLVector4a clip_center;
+	transform(center, clip_center);
+	LLVector4a axes[3];
+	for (S32 i = 0; i < 3; i++)
+	{
+		LLVector4a e(extents[i]);
+		axes[i].setMul(mViewProj->mMatrix[i], e);
+	}
+
+	F32 min_x = F32_MAX;
+	F32 max_x = -F32_MAX;
+	F32 min_y = F32_MAX;
+	F32 max_y = -F32_MAX;
+	F32 nearest = 0.f;
+	for (S32 i = 0; i < 8; i++)
+	{
+		LLVector4a corner = clip_center;
+		for (S32 axis = 0; axis < 3; axis++)
+		{
+			if (i & (1 << axis))
+			{
+				corner.add(axes[axis]);
+			}
+			else
+			{
+				corner.sub(axes[axis]);
+			}
+		}
+
+		const F32 w = corner[3];
+		if (w < mNearClip)
+		{
+			return false;
+		}
+		const F32 inv_w = 1.f / w;
+		const F32 x = corner[0]*inv_w;
+		const F32 y = corner[1]*inv_w;
+		min_x = llmin(min_x, x);
+		max_x = llmax(max_x, x);
+		min_y = llmin(min_y, y);
+		max_y = llmax(max_y, y);
+		nearest = llmax(nearest, inv_w);
+	}
+
+	if (max_x < -1.f || min_x > 1.f || max_y < -1.f || min_y > 1.f)
+	{
+		return false;
+	}
+
+	// Every pixel the box touches
+	const S32 min_px = llmax((S32)floorf((llmax(min_x, -1.f)*0.5f + 0.5f)*WIDTH), 0);
+	const S32 max_px = llmin((S32)floorf((llmin(max_x, 1.f)*0.5f + 0.5f)*WIDTH), WIDTH - 1);
+	const S32 min_py = llmax((S32)floorf((llmax(min_y, -1.f)*0.5f + 0.5f)*HEIGHT), 0);
+	const S32 max_py = llmin((S32)floorf((llmin(max_y, 1.f)*0.5f + 0.5f)*HEIGHT), HEIGHT - 1);
+
+	const LLVector4a box_depth(nearest);
+	for (S32 ty = min_py / TILE_SIZE; ty <= max_py / TILE_SIZE; ty++)
+	{
+		for (S32 tx = min_px / TILE_SIZE; tx <= max_px / TILE_SIZE; tx++)
+		{
+			const S32 tile = ty*TILES_X + tx;
+			if (mTileMin[tile] > nearest)
+			{
+				// All of the tile is in front of the box
+				continue;
+			}
+			if (mTileMax[tile] <= nearest)
+			{
+				// None of it is
+				return false;
+			}
+
+			// Groups of four, which may take in a few pixels to either
+			// side of the box; that only ever makes it look less hidden
+			const S32 px0 = llmax(min_px, tx*TILE_SIZE) & ~3;
+			const S32 px1 = llmin(max_px, tx*TILE_SIZE + TILE_SIZE - 1);
+			const S32 py0 = llmax(min_py, ty*TILE_SIZE);
+			const S32 py1 = llmin(max_py, ty*TILE_SIZE + TILE_SIZE - 1);
+			for (S32 y = py0; y <= py1; y++)
+			{
+				const F32 *row = mDepth + y*WIDTH;
+				for (S32 x = px0; x <= px1; x += 4)
+				{
+					LLVector4a v;
+					v.load4a(row + x);
+					if (v.lessEqual(box_depth).areAnySet())
+					{
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void LLOcclusionRaster::testBoxes(const LLVector4a* bounds, S32 count, bool* occluded) const
+{
+	for (S32 i = 0; i < count; i++)
+	{
+		occluded[i] = isOccluded(bounds[i*2], bounds[i*2 + 1]);
+	}
+}
@@ -0,0 +1,171 @@
+/**
+ * @file llocclusionraster.h
+ * @brief A low resolution depth buffer of large occluders, rasterized on the CPU.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOCCLUSIONRASTER_H
+#define LL_LLOCCLUSIONRASTER_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "llmatrix4a.h"
+#include "llvector4a.h"
+
+//
+// GL occlusion queries only answer a frame or more later, so a group that
+// comes out from behind something is drawn late, and every query is a
+// round trip to the GPU.  This is the other way of doing it: the few
+// large occluders in view (terrain, big opaque boxes) are rasterized into a
+// small depth buffer on the CPU, and bounding boxes are tested against
+// that in the same frame.
+//
+// The buffer keeps 1/w of the nearest occluder at each pixel, 0 where
+// there is none, and is only ever set where an occluder covers the whole
+// pixel and only as near as the occluder is anywhere in it.  A box is only
+// called occluded when it is behind the buffer everywhere it could show,
+// so the buffer may miss occlusion but never invents it.
+//
+// Occluders are set up on the main thread between begin() and build().
+// build() rasterizes them in bands of rows, shared with LLJobScheduler's
+// workers when it is running.  Once built, any number of threads may test
+// boxes against it.  Nothing here touches GL.
+//
+class LLOcclusionRaster
+{
+public:
+	enum
+	{
+		WIDTH = 256,
+		HEIGHT = 128,
+		// Each tile keeps the nearest and farthest depth in it, so most
+		// boxes are settled without going through pixels
+		TILE_SIZE = 8,
+		TILES_X = WIDTH / TILE_SIZE,
+		TILES_Y = HEIGHT / TILE_SIZE,
+		// Rows are rasterized in bands, each band a job
+		BAND_HEIGHT = 16,
+		NUM_BANDS = HEIGHT / BAND_HEIGHT
+	};
+
+	LLOcclusionRaster();
+	~LLOcclusionRaster();
+
+	// MAIN THREAD
+	// Starts over for a view.  view_proj takes agent space to clip space,
+	// GL style, and near_clip is the distance nothing nearer is drawn at.
+	void begin(const LLMatrix4a& view_proj, F32 near_clip);
+	// Triangles by index, agent space, front faces counter clockwise.
+	// Back faces are culled.  Edges the triangles share are taken to be
+	// inside the mesh, so a mesh wants adding in one go.
+	void addTriangles(const LLVector4a* verts, S32 num_verts, const U16* indices, S32 num_indices);
+	// A box at center with half axes axes[0..2], which must be right handed
+	void addBox(const LLVector4a& center, const LLVector4a* axes);
+	// Rasterizes what was added, with the help of the workers when
+	// on_worker is set and LLJobScheduler is running.  Returns once the
+	// buffer is done.
+	void build(bool on_worker);
+
+	// Any thread, once built
+	// Whether the axis aligned box at center, half size extents, is behind
+	// the occluders everywhere it could show.  A box reaching nearer than
+	// the near clip, or off screen, never is.
+	bool isOccluded(const LLVector4a& center, const LLVector4a& extents) const;
+	// isOccluded() for count boxes, bounds holding center and extents of
+	// each in turn
+	void testBoxes(const LLVector4a* bounds, S32 count, bool* occluded) const;
+
+	S32 getNumTriangles() const				{ return (S32)mTriangles.size(); }
+	// 1/w of the nearest occluder at a pixel, from the bottom left
+	F32 getDepth(S32 x, S32 y) const		{ return mDepth[y*WIDTH + x]; }
+
+private:
+	// Owns its buffers
+	LLOcclusionRaster(const LLOcclusionRaster&);
+	LLOcclusionRaster& operator=(const LLOcclusionRaster&);
+
+	class BandRange;
+
+	// Two for each seam
+	enum { MAX_GUARDS = 6 };
+
+	// A triangle set up for rasterizing, in pixels
+	struct Triangle
+	{
+		// A, B, C of each edge, A x + B y + C >= 0 at the center of a pixel
+		// that is inside it.  Then how far short of the whole pixel being
+		// inside that leaves a seam.
+		F32		mEdge[3][4];
+		// a, b, c of 1/w across the triangle, as far as it is in a pixel
+		F32		mDepth[3];
+		F32		mMinDepth;
+		// Which edges are seams, and the farthest of the faces either side
+		U32		mSeams;
+		F32		mSeamDepth;
+		// A, B, C of the outer edges of the faces across the seams
+		F32		mGuard[MAX_GUARDS][3];
+		S32		mNumGuards;
+		S32		mMinX;
+		S32		mMaxX;
+		S32		mMinY;
+		S32		mMaxY;
+	};
+
+	// Clip space vertices
+	void addClipTriangle(const LLVector4a& v0, const LLVector4a& v1, const LLVector4a& v2,
+						 U32 seams, F32 seam_depth, const F32* guards, S32 num_guards);
+	void setupTriangle(const LLVector4a* clip, U32 seams, F32 seam_depth,
+					   const F32* guards, S32 num_guards);
+	// Whether all of a triangle by index is in front of the near clip
+	bool inFront(const U16* tri) const;
+	// Guards of triangle t from the triangle across its seam
+	void addGuards(S32 t, const U16* across, S32 seam);
+	void transform(const LLVector4a& v, LLVector4a& res) const;
+
+	// Any thread
+	void rasterizeBand(S32 band);
+
+	// Kept aligned apart from the rest, so this may go anywhere
+	LLMatrix4a				*mViewProj;
+	F32						mNearClip;
+	std::vector<Triangle>	mTriangles;
+	// Scratch for addTriangles()
+	LLVector4a				*mClip;
+	S32						mClipCapacity;
+	std::vector<U64>		mEdgeKeys;
+	std::vector<U32>		mSeams;
+	std::vector<F32>		mFarDepth;
+	std::vector<F32>		mSeamDepth;
+	std::vector<F32>		mScreen;
+	std::vector<F32>		mGuards;
+	std::vector<S32>		mNumGuards;
+	// WIDTH x HEIGHT
+	F32						*mDepth;
+	// TILES_X x TILES_Y, farthest and nearest depth in each tile
+	F32						*mTileMin;
+	F32						*mTileMax;
+	bool					mBuilt;
+};
+
+#endif // LL_LLOCCLUSIONRASTER_H
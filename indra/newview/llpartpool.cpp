@@ -0,0 +1,520 @@
+/**
+ * @file llpartpool.cpp
+ * @brief Particle state for one particle group, in blocks of four.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llpartpool.h"
+
+#include "llmath.h"
+#include "llmemory.h"
+
+namespace
+{
+	const F32 ORIGIN[3] = { 0.f, 0.f, 0.f };
+
+	// The lanes whose flags have any of mask set
+	inline LLVector4Logical lanes_with(const __m128i &flags, U32 mask)
+	{
+		const __m128i bits = _mm_and_si128(flags, _mm_set1_epi32((S32)mask));
+		const __m128i none = _mm_cmpeq_epi32(bits, _mm_setzero_si128());
+		return LLVector4Logical(_mm_castsi128_ps(_mm_xor_si128(none, _mm_set1_epi32(-1))));
+	}
+
+	// value into the masked lanes of dst, or every lane when they all are
+	inline void set_lanes(LLVector4a &dst, const LLVector4Logical &mask, const LLVector4a &value, bool all)
+	{
+		if (all)
+		{
+			dst = value;
+		}
+		else
+		{
+			dst.setSelectWithMask(mask, value, dst);
+		}
+	}
+}
+
+LLPartState::LLPartState() :
+	mLastUpdateTime(0.f),
+	mSkipOffset(0.f)
+{
+}
+
+LLPartPool::LLPartPool() :
+	mCount(0),
+	mCapacity(0),
+	mBlocks(NULL)
+{
+}
+
+LLPartPool::~LLPartPool()
+{
+	if (mBlocks)
+	{
+		ll_aligned_free_16(mBlocks);
+		mBlocks = NULL;
+	}
+}
+
+void LLPartPool::reserve(S32 capacity)
+{
+	capacity = (capacity + 3) & ~3;
+	if (capacity <= mCapacity)
+	{
+		return;
+	}
+
+	// Blocks don't depend on the capacity, they just copy over
+	const size_t bytes = capacity*NUM_STREAMS*sizeof(F32);
+	F32 *blocks = (F32 *)ll_aligned_malloc_16(bytes);
+	memset(blocks, 0, bytes);
+	if (mBlocks)
+	{
+		memcpy(blocks, mBlocks, mCapacity*NUM_STREAMS*sizeof(F32));
+		ll_aligned_free_16(mBlocks);
+	}
+	mBlocks = blocks;
+	mCapacity = capacity;
+}
+
+void LLPartPool::add(const LLPartState &part, const LLVector3 *source_pos, const LLVector3 *target_pos, bool placed)
+{
+	if (mCount == mCapacity)
+	{
+		reserve(llmax(16, mCapacity*2));
+	}
+	const S32 i = mCount++;
+	mSourcePos.push_back(source_pos ? source_pos->mV : ORIGIN);
+	mTargetPos.push_back(target_pos ? target_pos->mV : ORIGIN);
+	*flags(i) = placed ? PLACED : 0;
+	for (S32 k = WIND_X; k <= WIND_Z; k++)
+	{
+		*at(k, i) = 0.f;
+	}
+	set(i, part);
+}
+
+void LLPartPool::get(S32 i, LLPartState &part) const
+{
+	for (S32 k = 0; k < 3; k++)
+	{
+		part.mPosAgent.mV[k] = *at(POS_X + k, i);
+		part.mVelocity.mV[k] = *at(VEL_X + k, i);
+		part.mAccel.mV[k] = *at(ACCEL_X + k, i);
+		part.mPosOffset.mV[k] = *at(OFFSET_X + k, i);
+	}
+	for (S32 k = 0; k < 4; k++)
+	{
+		part.mColor.mV[k] = *at(COLOR_R + k, i);
+		part.mStartColor.mV[k] = *at(START_R + k, i);
+		part.mEndColor.mV[k] = *at(END_R + k, i);
+	}
+	for (S32 k = 0; k < 2; k++)
+	{
+		part.mScale.mV[k] = *at(SCALE_X + k, i);
+		part.mStartScale.mV[k] = *at(START_SCALE_X + k, i);
+		part.mEndScale.mV[k] = *at(END_SCALE_X + k, i);
+	}
+	part.mLastUpdateTime = *at(AGE, i);
+	part.mMaxAge = *at(MAX_AGE, i);
+	part.mSkipOffset = *at(SKIP_OFFSET, i);
+	part.mFlags = getFlags(i);
+}
+
+void LLPartPool::set(S32 i, const LLPartState &part)
+{
+	for (S32 k = 0; k < 3; k++)
+	{
+		*at(POS_X + k, i) = part.mPosAgent.mV[k];
+		*at(VEL_X + k, i) = part.mVelocity.mV[k];
+		*at(ACCEL_X + k, i) = part.mAccel.mV[k];
+		*at(OFFSET_X + k, i) = part.mPosOffset.mV[k];
+	}
+	for (S32 k = 0; k < 4; k++)
+	{
+		*at(COLOR_R + k, i) = part.mColor.mV[k];
+		*at(START_R + k, i) = part.mStartColor.mV[k];
+		*at(END_R + k, i) = part.mEndColor.mV[k];
+	}
+	for (S32 k = 0; k < 2; k++)
+	{
+		*at(SCALE_X + k, i) = part.mScale.mV[k];
+		*at(START_SCALE_X + k, i) = part.mStartScale.mV[k];
+		*at(END_SCALE_X + k, i) = part.mEndScale.mV[k];
+	}
+	*at(AGE, i) = part.mLastUpdateTime;
+	*at(MAX_AGE, i) = part.mMaxAge;
+	*at(SKIP_OFFSET, i) = part.mSkipOffset;
+	setFlags(i, part.mFlags);
+}
+
+void LLPartPool::remove(S32 i)
+{
+	llassert(i >= 0 && i < mCount);
+	const S32 last = --mCount;
+	if (i != last)
+	{
+		for (S32 k = 0; k < FLAGS; k++)
+		{
+			*at(k, i) = *at(k, last);
+		}
+		*flags(i) = *flags(last);
+		mSourcePos[i] = mSourcePos[last];
+		mTargetPos[i] = mTargetPos[last];
+	}
+	mSourcePos.pop_back();
+	mTargetPos.pop_back();
+}
+
+void LLPartPool::clear()
+{
+	mCount = 0;
+	mSourcePos.clear();
+	mTargetPos.clear();
+}
+
+void LLPartPool::shift(const LLVector3 &offset)
+{
+	LLVector4a delta[3];
+	for (S32 k = 0; k < 3; k++)
+	{
+		delta[k].splat(offset.mV[k]);
+	}
+	for (S32 i = 0; i < mCount; i += 4)
+	{
+		for (S32 k = 0; k < 3; k++)
+		{
+			LLVector4a pos;
+			pos.load4a(at(POS_X + k, i));
+			pos.add(delta[k]);
+			pos.store4a(at(POS_X + k, i));
+		}
+	}
+}
+
+LLVector3 LLPartPool::getPosAgent(S32 i) const
+{
+	return LLVector3(*at(POS_X, i), *at(POS_Y, i), *at(POS_Z, i));
+}
+
+LLVector3 LLPartPool::getVelocity(S32 i) const
+{
+	return LLVector3(*at(VEL_X, i), *at(VEL_Y, i), *at(VEL_Z, i));
+}
+
+LLColor4 LLPartPool::getColor(S32 i) const
+{
+	return LLColor4(*at(COLOR_R, i), *at(COLOR_G, i), *at(COLOR_B, i), *at(COLOR_A, i));
+}
+
+LLVector2 LLPartPool::getScale(S32 i) const
+{
+	return LLVector2(*at(SCALE_X, i), *at(SCALE_Y, i));
+}
+
+bool LLPartPool::isDead(S32 i) const
+{
+	return *at(AGE, i) > *at(MAX_AGE, i)
+		|| LLPartData::LL_PART_DEAD_MASK == getFlags(i);
+}
+
+void LLPartPool::setWind(S32 i, const LLVector3 &wind)
+{
+	*at(WIND_X, i) = wind.mV[VX];
+	*at(WIND_Y, i) = wind.mV[VY];
+	*at(WIND_Z, i) = wind.mV[VZ];
+}
+
+void LLPartPool::followSources()
+{
+	for (S32 i = 0; i < mCount; i++)
+	{
+		// "Drift" the particle based on the source object
+		if ((*flags(i) & (LLPartData::LL_PART_FOLLOW_SRC_MASK | PLACED)) == LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		{
+			const F32 *source = mSourcePos[i];
+			for (S32 k = 0; k < 3; k++)
+			{
+				*at(POS_X + k, i) = source[k] + *at(OFFSET_X + k, i);
+			}
+		}
+	}
+}
+
+void LLPartPool::integrate(F32 dt)
+{
+	const U32 SOURCE_MASKS = LLPartData::LL_PART_FOLLOW_SRC_MASK | LLPartData::LL_PART_BOUNCE_MASK
+							| LLPartData::LL_PART_TARGET_POS_MASK | LLPartData::LL_PART_TARGET_LINEAR_MASK;
+
+	const LLVector4a group_dt(dt);
+	const LLVector4a zero(0.f);
+	const LLVector4a one(1.f);
+	const LLVector4a tenth(0.1f);
+	const LLVector4a half(0.5f);
+	const LLVector4a five(5.f);
+	const LLVector4a minus_two(-2.f);
+	const LLVector4a restitution(-0.75f);
+
+	for (S32 i = 0; i < mCount; i += 4)
+	{
+		// Lanes past the end are worked out too, and left alone after
+		F32 *b = mBlocks + (i >> 2)*NUM_STREAMS*4;
+		const U32 *block_flags = (const U32 *)(b + FLAGS*4);
+		const S32 lanes = llmin(4, mCount - i);
+		U32 any = 0;
+		U32 all = ~0U;
+		for (S32 lane = 0; lane < lanes; lane++)
+		{
+			any |= block_flags[lane];
+			all &= block_flags[lane];
+		}
+		const __m128i flags = _mm_load_si128((const __m128i *)block_flags);
+
+		LLVector4a source[3];
+		LLVector4a target[3];
+		S32 k;
+		if (any & SOURCE_MASKS)
+		{
+			const F32 *src[4];
+			const F32 *tgt[4];
+			for (S32 lane = 0; lane < 4; lane++)
+			{
+				src[lane] = lane < lanes ? mSourcePos[i + lane] : src[0];
+				tgt[lane] = lane < lanes ? mTargetPos[i + lane] : tgt[0];
+			}
+			if (src[0] == src[1] && src[0] == src[2] && src[0] == src[3]
+				&& tgt[0] == tgt[1] && tgt[0] == tgt[2] && tgt[0] == tgt[3])
+			{
+				// Usually all from the one source
+				for (k = 0; k < 3; k++)
+				{
+					source[k].splat(src[0][k]);
+					target[k].splat(tgt[0][k]);
+				}
+			}
+			else
+			{
+				for (k = 0; k < 3; k++)
+				{
+					source[k].set(src[0][k], src[1][k], src[2][k], src[3][k]);
+					target[k].set(tgt[0][k], tgt[1][k], tgt[2][k], tgt[3][k]);
+				}
+			}
+		}
+
+		LLVector4a skip;
+		skip.load4a(b + SKIP_OFFSET*4);
+		LLVector4a step_dt;
+		step_dt.setSub(group_dt, skip);
+		zero.store4a(b + SKIP_OFFSET*4);
+
+		LLVector4a age;
+		LLVector4a max_age;
+		age.load4a(b + AGE*4);
+		max_age.load4a(b + MAX_AGE*4);
+		LLVector4a cur_time;
+		cur_time.setAdd(age, step_dt);
+		LLVector4a frac;
+		frac.setDiv(cur_time, max_age);
+
+		LLVector4a pos[3];
+		LLVector4a vel[3];
+		for (k = 0; k < 3; k++)
+		{
+			pos[k].load4a(b + (POS_X + k)*4);
+			vel[k].load4a(b + (VEL_X + k)*4);
+		}
+
+		if (any & LLPartData::LL_PART_WIND_MASK)
+		{
+			const LLVector4Logical mask = lanes_with(flags, LLPartData::LL_PART_WIND_MASK);
+			const bool every = (all & LLPartData::LL_PART_WIND_MASK) != 0;
+			LLVector4a drag;
+			drag.setMul(tenth, step_dt);
+			LLVector4a keep;
+			keep.setSub(one, drag);
+			for (k = 0; k < 3; k++)
+			{
+				LLVector4a wind;
+				wind.load4a(b + (WIND_X + k)*4);
+				wind.mul(drag);
+				LLVector4a v;
+				v.setMul(vel[k], keep);
+				v.add(wind);
+				set_lanes(vel[k], mask, v, every);
+			}
+		}
+
+		// Interpolate toward the target
+		if (any & LLPartData::LL_PART_TARGET_POS_MASK)
+		{
+			const LLVector4Logical mask = lanes_with(flags, LLPartData::LL_PART_TARGET_POS_MASK);
+			const bool every = (all & LLPartData::LL_PART_TARGET_POS_MASK) != 0;
+			LLVector4a remaining;
+			remaining.setSub(max_age, age);
+			LLVector4a step;
+			step.setDiv(step_dt, remaining);
+			// llclamp(step, 0.f, 0.1f), NaNs and all
+			step.setSelectWithMask(step.lessThan(zero), zero, step);
+			step.setSelectWithMask(step.greaterThan(tenth), tenth, step);
+			step.mul(five);
+			LLVector4a keep;
+			keep.setSub(one, step);
+			LLVector4a inv_remaining;
+			inv_remaining.setDiv(one, remaining);
+			for (k = 0; k < 3; k++)
+			{
+				LLVector4a delta;
+				delta.setSub(target[k], pos[k]);
+				delta.mul(inv_remaining);
+				delta.mul(step);
+				LLVector4a v;
+				v.setMul(vel[k], keep);
+				v.add(delta);
+				set_lanes(vel[k], mask, v, every);
+			}
+		}
+
+		// Velocity interpolation, unless every lane goes straight for the target
+		if (!(all & LLPartData::LL_PART_TARGET_LINEAR_MASK))
+		{
+			LLVector4a half_dt_sq;
+			half_dt_sq.setMul(half, step_dt);
+			half_dt_sq.mul(step_dt);
+			for (k = 0; k < 3; k++)
+			{
+				LLVector4a accel;
+				accel.load4a(b + (ACCEL_X + k)*4);
+				LLVector4a moved;
+				moved.setMul(vel[k], step_dt);
+				pos[k].add(moved);
+				moved.setMul(accel, half_dt_sq);
+				pos[k].add(moved);
+				accel.mul(step_dt);
+				vel[k].add(accel);
+			}
+		}
+
+		if (any & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+		{
+			const LLVector4Logical mask = lanes_with(flags, LLPartData::LL_PART_TARGET_LINEAR_MASK);
+			const bool every = (all & LLPartData::LL_PART_TARGET_LINEAR_MASK) != 0;
+			for (k = 0; k < 3; k++)
+			{
+				LLVector4a delta;
+				delta.setSub(target[k], source[k]);
+				LLVector4a p;
+				p.setMul(delta, frac);
+				p.setAdd(source[k], p);
+				set_lanes(pos[k], mask, p, every);
+				set_lanes(vel[k], mask, delta, every);
+			}
+		}
+
+		// Bounce off the source's height
+		if (any & LLPartData::LL_PART_BOUNCE_MASK)
+		{
+			LLVector4a dz;
+			dz.setSub(pos[VZ], source[VZ]);
+			const LLVector4Logical mask(_mm_and_ps(lanes_with(flags, LLPartData::LL_PART_BOUNCE_MASK),
+												   dz.lessThan(zero)));
+			LLVector4a z;
+			z.setMul(minus_two, dz);
+			z.setAdd(pos[VZ], z);
+			pos[VZ].setSelectWithMask(mask, z, pos[VZ]);
+			LLVector4a v;
+			v.setMul(vel[VZ], restitution);
+			vel[VZ].setSelectWithMask(mask, v, vel[VZ]);
+		}
+
+		// Reset the offset from the source position
+		if (any & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		{
+			const LLVector4Logical mask = lanes_with(flags, LLPartData::LL_PART_FOLLOW_SRC_MASK);
+			const bool every = (all & LLPartData::LL_PART_FOLLOW_SRC_MASK) != 0;
+			for (k = 0; k < 3; k++)
+			{
+				LLVector4a offset;
+				offset.load4a(b + (OFFSET_X + k)*4);
+				LLVector4a o;
+				o.setSub(pos[k], source[k]);
+				set_lanes(offset, mask, o, every);
+				offset.store4a(b + (OFFSET_X + k)*4);
+			}
+		}
+
+		for (k = 0; k < 3; k++)
+		{
+			pos[k].store4a(b + (POS_X + k)*4);
+			vel[k].store4a(b + (VEL_X + k)*4);
+		}
+
+		LLVector4a keep;
+		keep.setSub(one, frac);
+
+		if (any & LLPartData::LL_PART_INTERP_COLOR_MASK)
+		{
+			const LLVector4Logical mask = lanes_with(flags, LLPartData::LL_PART_INTERP_COLOR_MASK);
+			const bool every = (all & LLPartData::LL_PART_INTERP_COLOR_MASK) != 0;
+			for (k = 0; k < 4; k++)
+			{
+				LLVector4a color;
+				color.load4a(b + (COLOR_R + k)*4);
+				LLVector4a from;
+				from.load4a(b + (START_R + k)*4);
+				from.mul(keep);
+				LLVector4a to;
+				to.load4a(b + (END_R + k)*4);
+				to.mul(frac);
+				from.add(to);
+				set_lanes(color, mask, from, every);
+				color.store4a(b + (COLOR_R + k)*4);
+			}
+		}
+
+		if (any & LLPartData::LL_PART_INTERP_SCALE_MASK)
+		{
+			const LLVector4Logical mask = lanes_with(flags, LLPartData::LL_PART_INTERP_SCALE_MASK);
+			const bool every = (all & LLPartData::LL_PART_INTERP_SCALE_MASK) != 0;
+			for (k = 0; k < 2; k++)
+			{
+				LLVector4a scale;
+				scale.load4a(b + (SCALE_X + k)*4);
+				LLVector4a from;
+				from.load4a(b + (START_SCALE_X + k)*4);
+				from.mul(keep);
+				LLVector4a to;
+				to.load4a(b + (END_SCALE_X + k)*4);
+				to.mul(frac);
+				from.add(to);
+				set_lanes(scale, mask, from, every);
+				scale.store4a(b + (SCALE_X + k)*4);
+			}
+		}
+
+		cur_time.store4a(b + AGE*4);
+	}
+}
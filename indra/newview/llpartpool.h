@@ -0,0 +1,156 @@
+/**
+ * @file llpartpool.h
+ * @brief Particle state for one particle group, in blocks of four.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPARTPOOL_H
+#define LL_LLPARTPOOL_H
+
+#include <vector>
+
+#include "llpartdata.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4color.h"
+
+//
+// The part of a particle that changes as it is simulated
+//
+class LLPartState : public LLPartData
+{
+public:
+	LLPartState();
+
+	LLVector3		mPosAgent;
+	LLVector3		mVelocity;
+	LLVector3		mAccel;
+	LLColor4		mColor;
+	LLVector2		mScale;
+	F32				mLastUpdateTime;			// Age as of the last update
+	F32				mSkipOffset;				// Offset against current group mSkippedTime
+};
+
+//
+// The particles of one LLViewerPartGroup, kept in blocks of four with each
+// component of the four together (x x x x, y y y y, ...), so that updating
+// them is one pass through memory, four particles to an SSE register,
+// rather than a walk over heap allocated LLViewerParts.  Each block only
+// runs the steps its particles' flags ask for, and runs them without
+// masking lanes when all four ask; particles from the same source share
+// their flags, so that is the usual case.
+//
+// A pool has no locking.  Updating one touches nothing outside it but the
+// source and target positions it was given, so different pools can be
+// updated on different threads at once.
+//
+class LLPartPool
+{
+public:
+	LLPartPool();
+	~LLPartPool();
+
+	S32 getCount() const					{ return mCount; }
+
+	// Adds a particle at the end.  source_pos and target_pos are read on
+	// every update, so must stay put for as long as the particle is in the
+	// pool; NULL is taken as the origin.  A placed particle has its
+	// position set from outside (by a callback) before every update, and
+	// doesn't follow its source.
+	void add(const LLPartState &part, const LLVector3 *source_pos, const LLVector3 *target_pos, bool placed);
+	// Copies particle i's state out of the pool, and back in.
+	void get(S32 i, LLPartState &part) const;
+	void set(S32 i, const LLPartState &part);
+	// Moves the last particle into i's place.
+	void remove(S32 i);
+	void clear();
+
+	void shift(const LLVector3 &offset);
+
+	U32 getFlags(S32 i) const				{ return *flags(i) & ~PLACED; }
+	void setFlags(S32 i, U32 flags_in)		{ *flags(i) = (flags_in & ~PLACED) | (*flags(i) & PLACED); }
+	LLVector3 getPosAgent(S32 i) const;
+	LLVector3 getVelocity(S32 i) const;
+	LLColor4 getColor(S32 i) const;
+	LLVector2 getScale(S32 i) const;
+	// Dead or past its age after an update
+	bool isDead(S32 i) const;
+
+	// Particle i's share of a group time step of dt
+	F32 getTimeStep(S32 i, F32 dt) const	{ return dt - *at(SKIP_OFFSET, i); }
+
+	// An update is followSources(), then setWind() for the particles with
+	// LL_PART_WIND_MASK set, looked up at their followed positions, then
+	// integrate().  Together they work out what LLViewerPartGroup's
+	// per-particle loop always did, to the bit.
+	void followSources();
+	void setWind(S32 i, const LLVector3 &wind);
+	void integrate(F32 dt);
+
+private:
+	// Owns its blocks
+	LLPartPool(const LLPartPool &);
+	LLPartPool &operator=(const LLPartPool &);
+
+	enum
+	{
+		// Viewer side, next to LLPartData::LL_PART_HUD
+		PLACED = 0x20000000
+	};
+
+	enum EStream
+	{
+		POS_X, POS_Y, POS_Z,
+		VEL_X, VEL_Y, VEL_Z,
+		ACCEL_X, ACCEL_Y, ACCEL_Z,
+		OFFSET_X, OFFSET_Y, OFFSET_Z,
+		WIND_X, WIND_Y, WIND_Z,
+		COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+		START_R, START_G, START_B, START_A,
+		END_R, END_G, END_B, END_A,
+		SCALE_X, SCALE_Y,
+		START_SCALE_X, START_SCALE_Y,
+		END_SCALE_X, END_SCALE_Y,
+		AGE,
+		MAX_AGE,
+		SKIP_OFFSET,
+		FLAGS,				// U32
+		NUM_STREAMS
+	};
+
+	// Component k of particle i
+	F32 *at(S32 k, S32 i)					{ return mBlocks + ((i >> 2)*NUM_STREAMS + k)*4 + (i & 3); }
+	const F32 *at(S32 k, S32 i) const		{ return mBlocks + ((i >> 2)*NUM_STREAMS + k)*4 + (i & 3); }
+	U32 *flags(S32 i)						{ return (U32 *)at(FLAGS, i); }
+	const U32 *flags(S32 i) const			{ return (const U32 *)at(FLAGS, i); }
+
+	void reserve(S32 capacity);
+
+	S32			mCount;
+	S32			mCapacity;		// a multiple of four
+	F32			*mBlocks;		// 16 byte aligned
+	std::vector<const F32 *> mSourcePos;
+	std::vector<const F32 *> mTargetPos;
+};
+
+#endif // LL_LLPARTPOOL_H
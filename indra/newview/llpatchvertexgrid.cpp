@@ -0,0 +1,174 @@
+/**
+ * @file llpatchvertexgrid.cpp
+ * @brief Cached vertex data for every grid point of a terrain patch.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llpatchvertexgrid.h"
+
+#include "llmemory.h"
+
+LLPatchVertexGrid::LLPatchVertexGrid() :
+	mPatchWidth(0),
+	mGridWidth(0),
+	mValid(FALSE),
+	mPositions(NULL),
+	mNormals(NULL)
+{
+}
+
+LLPatchVertexGrid::~LLPatchVertexGrid()
+{
+	destroy();
+}
+
+void LLPatchVertexGrid::create(U32 patch_width)
+{
+	destroy();
+
+	mPatchWidth = patch_width;
+	mGridWidth = patch_width + 1;
+	const U32 points = mGridWidth*mGridWidth;
+	mPositions = (LLVector4a *)ll_aligned_malloc_16(points*sizeof(LLVector4a));
+	mNormals = (LLVector4a *)ll_aligned_malloc_16(points*sizeof(LLVector4a));
+	mTexCoords0.resize(points);
+	mTexCoords1.resize(points);
+}
+
+void LLPatchVertexGrid::destroy()
+{
+	if (mPositions)
+	{
+		ll_aligned_free_16(mPositions);
+		mPositions = NULL;
+	}
+	if (mNormals)
+	{
+		ll_aligned_free_16(mNormals);
+		mNormals = NULL;
+	}
+	mTexCoords0.clear();
+	mTexCoords1.clear();
+	mPatchWidth = 0;
+	mGridWidth = 0;
+	mValid = FALSE;
+}
+
+void LLPatchVertexGrid::update(const F32 *heights, const LLVector3 *normals, U32 surface_width,
+							   F32 meters_per_grid, const LLVector2 &origin_region, F32 tex_scale)
+{
+	llassert(mPositions);
+
+	LLVector4a scale;
+	scale.set(meters_per_grid, meters_per_grid, 1.f);
+	LLVector4a origin;
+	origin.set(origin_region.mV[VX], origin_region.mV[VY], 0.f);
+	LLVector4a tex_scale4;
+	tex_scale4.splat(tex_scale);
+
+	U32 k = 0;
+	for (U32 y = 0; y < mGridWidth; y++)
+	{
+		const F32 *row_heights = heights + y*surface_width;
+		const LLVector3 *row_normals = normals + y*surface_width;
+		for (U32 x = 0; x < mGridWidth; x++, k++)
+		{
+			// Grid offset and height, the same products eval() worked out
+			LLVector4a &pos = mPositions[k];
+			pos.set((F32)x, (F32)y, row_heights[x]);
+			pos.mul(scale);
+
+			LLVector4a tex;
+			tex.setAdd(pos, origin);
+			tex.mul(tex_scale4);
+			mTexCoords0[k].set(tex.getF32ptr());
+
+			mNormals[k].load3(row_normals[x].mV);
+		}
+	}
+	mValid = TRUE;
+}
+
+F32 LLPatchVertexGrid::getMorphedHeight(U32 x, U32 y, U32 stride, F32 morph) const
+{
+	const F32 height = getHeight(x, y);
+	const U32 coarse = stride*2;
+
+	// Points on the patch's edges stay put, that's where neighbors drawn at
+	// other strides stitch on
+	if (morph <= 0.f || coarse > mPatchWidth
+		|| !x || !y || x >= mPatchWidth || y >= mPatchWidth)
+	{
+		return height;
+	}
+
+	const BOOL between_x = (x % coarse) != 0;
+	const BOOL between_y = (y % coarse) != 0;
+	F32 coarse_height;
+	if (between_x && between_y)
+	{
+		// LLVOSurfacePatch splits every cell from its southwest to its
+		// northeast corner
+		coarse_height = 0.5f*(getHeight(x - stride, y - stride) + getHeight(x + stride, y + stride));
+	}
+	else if (between_x)
+	{
+		coarse_height = 0.5f*(getHeight(x - stride, y) + getHeight(x + stride, y));
+	}
+	else if (between_y)
+	{
+		coarse_height = 0.5f*(getHeight(x, y - stride) + getHeight(x, y + stride));
+	}
+	else
+	{
+		// Still there at the coarser stride
+		return height;
+	}
+
+	return height + morph*(coarse_height - height);
+}
+
+void LLPatchVertexGrid::getVertex(U32 x, U32 y, U32 stride, F32 morph, const LLVector4a &origin_agent,
+								  LLVector3 *vertex, LLVector3 *normal, LLVector2 *tex0, LLVector2 *tex1) const
+{
+	if (!mValid)
+	{
+		return; // failsafe, left as eval() used to
+	}
+
+	const U32 k = x + y*mGridWidth;
+
+	LLVector4a pos = mPositions[k];
+	if (morph > 0.f)
+	{
+		pos.getF32ptr()[VZ] = getMorphedHeight(x, y, stride, morph);
+	}
+	pos.add(origin_agent);
+
+	vertex->set(pos.getF32ptr());
+	normal->set(mNormals[k].getF32ptr());
+	*tex0 = mTexCoords0[k];
+	*tex1 = mTexCoords1[k];
+}
@@ -0,0 +1,100 @@
+/**
+ * @file llpatchvertexgrid.h
+ * @brief Cached vertex data for every grid point of a terrain patch.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPATCHVERTEXGRID_H
+#define LL_LLPATCHVERTEXGRID_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "v2math.h"
+#include "v3math.h"
+
+//
+// Everything LLSurfacePatch::eval() used to work out for a vertex, for all
+// (patch_width + 1)^2 grid points of a patch at once, including the north
+// and east rows the stitching strips reach into.  The grid only changes with
+// the heights, normals and composition, so a patch switching render stride,
+// or rebuilding because a neighbor did, just copies vertices out of it.
+//
+// Positions are kept relative to the patch origin and moved into agent
+// space as they are copied out, so the grid survives the agent changing
+// regions.  Copying out can also geomorph: a vertex that goes away at the
+// next coarser stride is moved toward where that stride's triangles would
+// put it, so that changing stride doesn't pop.
+//
+class LLPatchVertexGrid
+{
+public:
+	LLPatchVertexGrid();
+	~LLPatchVertexGrid();
+
+	void create(U32 patch_width);
+	void destroy();
+	U32 getPatchWidth() const				{ return mPatchWidth; }
+
+	BOOL isValid() const					{ return mValid; }
+	void invalidate()						{ mValid = FALSE; }
+
+	// heights and normals start at the patch's first grid point, rows
+	// surface_width apart.  Texture coordinate 0 is the point's region
+	// position (origin_region plus the grid offset) times tex_scale.
+	// Texture coordinate 1 is left alone, see getTexCoords1().
+	void update(const F32 *heights, const LLVector3 *normals, U32 surface_width,
+				F32 meters_per_grid, const LLVector2 &origin_region, F32 tex_scale);
+
+	// Composition and noise of each grid point, row by row; the caller
+	// fills these in, only the composition changing after the first time.
+	LLVector2 *getTexCoords1()				{ return &mTexCoords1[0]; }
+
+	// The vertex at grid point (x, y) of a patch drawn every stride points,
+	// morph of the way toward the next coarser stride.  origin_agent is the
+	// patch origin in agent space with z zeroed, heights being absolute.
+	void getVertex(U32 x, U32 y, U32 stride, F32 morph, const LLVector4a &origin_agent,
+				   LLVector3 *vertex, LLVector3 *normal, LLVector2 *tex0, LLVector2 *tex1) const;
+
+	// Height of grid point (x, y), morphed the same way.
+	F32 getMorphedHeight(U32 x, U32 y, U32 stride, F32 morph) const;
+
+private:
+	// Owns its arrays
+	LLPatchVertexGrid(const LLPatchVertexGrid &);
+	LLPatchVertexGrid &operator=(const LLPatchVertexGrid &);
+
+	F32 getHeight(U32 x, U32 y) const		{ return mPositions[x + y*mGridWidth][VZ]; }
+
+	U32			mPatchWidth;
+	U32			mGridWidth;		// mPatchWidth + 1
+	BOOL		mValid;
+
+	// Relative to the patch origin
+	LLVector4a	*mPositions;
+	LLVector4a	*mNormals;
+	std::vector<LLVector2> mTexCoords0;
+	std::vector<LLVector2> mTexCoords1;
+};
+
+#endif // LL_LLPATCHVERTEXGRID_H
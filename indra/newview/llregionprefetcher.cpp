@@ -0,0 +1,439 @@
+/**
+ * @file llregionprefetcher.cpp
+ * @brief Warms textures and meshes of a neighboring region before crossing into it.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llregionprefetcher.h"
+
+#include <algorithm>
+
+#include "llagent.h"
+#include "llappviewer.h"
+#include "lldatapacker.h"
+#include "llfasttimer.h"
+#include "llmeshrepository.h"
+#include "llobjectupdatedecoder.h"
+#include "llsd.h"
+#include "llsdutil.h"
+#include "llviewercamera.h"
+#include "llviewercontrol.h"
+#include "llviewerregion.h"
+#include "llviewertexture.h"
+#include "llviewertexturelist.h"
+#include "llvocache.h"
+#include "llworld.h"
+
+// Cache data decoded a frame
+const S32 SCAN_BYTES_PER_FRAME = 64*1024;
+// Textures being warmed at once
+const S32 MAX_WARMING = 256;
+// Seconds a warmed texture has to be used in to count
+const F64 WARM_EXPIRY = 60.0;
+// Farthest from where the agent is headed that objects are warmed
+const F32 MAX_PREFETCH_DISTANCE = 128.f;
+// Slower than this on the ground, the agent is heading where it looks
+const F32 MIN_HEADING_SPEED = 1.f;
+
+static LLFastTimer::DeclareTimer FTM_REGION_PREFETCH("Region Prefetch");
+
+LLRegionPrefetcher::LLRegionPrefetcher() :
+	mTargetHandle(0),
+	mNextLocalID(0),
+	mScanned(false),
+	mNextCandidate(0),
+	mRequestBudget(0.f),
+	mRegionsTargeted(0),
+	mTexturesRequested(0),
+	mTextureHits(0),
+	mTextureMisses(0),
+	mTextureSavedSeconds(0.0),
+	mMeshesRequested(0)
+{
+}
+
+LLRegionPrefetcher::~LLRegionPrefetcher()
+{
+}
+
+void LLRegionPrefetcher::clear()
+{
+	if (mTexturesRequested || mMeshesRequested)
+	{
+		LLSD info;
+		getInfo(info);
+		llinfos << "Region crossing prefetch: " << ll_pretty_print_sd(info) << llendl;
+	}
+
+	setTarget(NULL);
+	mWarming.clear();
+	mWarmed.clear();
+}
+
+// static
+LLVector3d LLRegionPrefetcher::predictPosition(const LLVector3d& pos_global, const LLVector3& velocity,
+											   const LLVector3& look_at, F32 lookahead, F32 look_distance)
+{
+	LLVector3d predicted = pos_global + LLVector3d(velocity*lookahead);
+
+	LLVector3 heading(look_at.mV[VX], look_at.mV[VY], 0.f);
+	if (heading.normalize() < F_APPROXIMATELY_ZERO)
+	{
+		// Looking straight up or down
+		return predicted;
+	}
+
+	LLVector3 ground_velocity(velocity.mV[VX], velocity.mV[VY], 0.f);
+	F32 weight = 1.f;
+	if (ground_velocity.normalize() >= MIN_HEADING_SPEED)
+	{
+		weight = llmax(heading*ground_velocity, 0.f);
+	}
+	predicted += LLVector3d(heading*(look_distance*weight));
+	return predicted;
+}
+
+void LLRegionPrefetcher::update()
+{
+	LLFastTimer t(FTM_REGION_PREFETCH);
+
+	updateWarming();
+
+	static LLCachedControl<bool> enabled(gSavedSettings, "RegionCrossingPrefetch");
+	static LLCachedControl<F32> lookahead(gSavedSettings, "RegionCrossingPrefetchLookahead");
+	static LLCachedControl<U32> rate(gSavedSettings, "RegionCrossingPrefetchRate");
+
+	LLViewerRegion* agent_region = gAgent.getRegion();
+	if (!enabled || !agent_region)
+	{
+		setTarget(NULL);
+		return;
+	}
+
+	LLViewerCamera* camera = LLViewerCamera::getInstance();
+	const F32 max_distance = llmin(camera->getFar(), MAX_PREFETCH_DISTANCE);
+	const LLVector3d predicted = predictPosition(gAgent.getPositionGlobal(), gAgent.getVelocity(),
+												 camera->getAtAxis(), lookahead, max_distance*0.5f);
+
+	// Only a neighbor whose cache is in hand
+	LLViewerRegion* region = LLWorld::getInstance()->getRegionFromPosGlobal(predicted);
+	if (region == agent_region
+		|| (region && (!region->isAlive() || !region->isCacheLoaded())))
+	{
+		region = NULL;
+	}
+	setTarget(region);
+	if (!region)
+	{
+		return;
+	}
+
+	const LLVector3 predicted_local(predicted - region->getOriginGlobal());
+	if (!mScanned)
+	{
+		mScanned = scan(region, SCAN_BYTES_PER_FRAME);
+		if (!mScanned)
+		{
+			return;
+		}
+		rank(predicted_local, max_distance);
+	}
+
+	mRequestBudget = llmin(mRequestBudget + (F32)rate*gFrameIntervalSeconds, (F32)rate);
+	const S32 max_requests = llmin((S32)mRequestBudget, MAX_WARMING - (S32)mWarming.size());
+	if (max_requests > 0)
+	{
+		mRequestBudget -= (F32)warm(max_requests, predicted_local);
+	}
+}
+
+void LLRegionPrefetcher::setTarget(LLViewerRegion* region)
+{
+	const U64 handle = region ? region->getHandle() : 0;
+	if (handle == mTargetHandle)
+	{
+		return;
+	}
+
+	if (mTargetHandle && mScanned)
+	{
+		llinfos << "Prefetched " << mNextCandidate << " of " << mCandidates.size()
+				<< " objects near the border, " << mTexturesRequested << " textures and "
+				<< mMeshesRequested << " meshes asked for in all" << llendl;
+	}
+
+	mTargetHandle = handle;
+	mNextLocalID = 0;
+	mScanned = false;
+	mCandidates.clear();
+	mTextureIDs.clear();
+	mMeshParams.clear();
+	mNextCandidate = 0;
+
+	// Only what is still warming needs skipping from here
+	mWarmed.clear();
+	for (std::list<Warming>::iterator iter = mWarming.begin(); iter != mWarming.end(); ++iter)
+	{
+		mWarmed.insert(iter->mImage->getID());
+	}
+
+	if (region)
+	{
+		mRegionsTargeted++;
+	}
+}
+
+bool LLRegionPrefetcher::scan(LLViewerRegion* region, S32 max_bytes)
+{
+	const bool mesh_enabled = gMeshRepo.meshRezEnabled();
+	const std::map<U32, LLVOCacheEntry*>& cache = region->getCacheMap();
+
+	// Entries may have come and gone since the last frame, so pick up by id
+	std::map<U32, LLVOCacheEntry*>::const_iterator iter = cache.lower_bound(mNextLocalID);
+	S32 bytes = 0;
+	for ( ; iter != cache.end() && bytes < max_bytes; ++iter)
+	{
+		LLDataPackerBinaryBuffer* dp = iter->second->peekDP();
+		if (!dp)
+		{
+			continue;
+		}
+
+		LLDecodedObjectUpdate update;
+		update.mData = dp->getBuffer();
+		update.mDataSize = dp->getBufferSize();
+		bytes += update.mDataSize;
+		LLObjectUpdateDecoder::decodeBlock(update);
+		if (!update.mValid || !update.mHasVolume)
+		{
+			continue;
+		}
+
+		Candidate candidate;
+		candidate.mLocalID = update.mLocalID;
+		candidate.mParentID = update.mParentID;
+		candidate.mPosition = update.mPosition;
+		candidate.mRadius = update.mScale.length()*0.5f;
+		candidate.mScore = 0.f;
+		candidate.mFirstTexture = (S32)mTextureIDs.size();
+		candidate.mMesh = -1;
+
+		if (update.mTEContents.mSize > 0)
+		{
+			for (U32 i = 0; i < LLTEContents::MAX_TES; ++i)
+			{
+				LLUUID id;
+				memcpy(id.mData, &update.mTEContents.mImageData[i*UUID_BYTES], UUID_BYTES);
+				if (id.notNull()
+					&& std::find(mTextureIDs.begin() + candidate.mFirstTexture, mTextureIDs.end(), id) == mTextureIDs.end())
+				{
+					mTextureIDs.push_back(id);
+				}
+			}
+		}
+
+		if (update.mSculptID.notNull())
+		{
+			LLVolumeParams params = update.mVolumeParams;
+			params.setSculptID(update.mSculptID, update.mSculptType);
+			if (!params.isMeshSculpt())
+			{
+				mTextureIDs.push_back(update.mSculptID);
+			}
+			else if (mesh_enabled)
+			{
+				candidate.mMesh = (S32)mMeshParams.size();
+				mMeshParams.push_back(params);
+			}
+		}
+
+		candidate.mNumTextures = (S32)mTextureIDs.size() - candidate.mFirstTexture;
+		if (candidate.mNumTextures > 0 || candidate.mMesh >= 0)
+		{
+			mCandidates.push_back(candidate);
+		}
+	}
+
+	if (iter == cache.end())
+	{
+		return true;
+	}
+	mNextLocalID = iter->first;
+	return false;
+}
+
+// static
+bool LLRegionPrefetcher::compareScore(const Candidate& lhs, const Candidate& rhs)
+{
+	return lhs.mScore > rhs.mScore;
+}
+
+void LLRegionPrefetcher::rank(const LLVector3& predicted_local, F32 max_distance)
+{
+	// Child prims are placed off their parents
+	std::map<U32, LLVector3> roots;
+	for (std::vector<Candidate>::iterator iter = mCandidates.begin(); iter != mCandidates.end(); ++iter)
+	{
+		if (iter->mParentID == 0)
+		{
+			roots[iter->mLocalID] = iter->mPosition;
+		}
+	}
+
+	std::vector<Candidate> ranked;
+	ranked.reserve(mCandidates.size());
+	for (std::vector<Candidate>::iterator iter = mCandidates.begin(); iter != mCandidates.end(); ++iter)
+	{
+		Candidate candidate = *iter;
+		if (candidate.mParentID)
+		{
+			std::map<U32, LLVector3>::iterator root = roots.find(candidate.mParentID);
+			if (root == roots.end())
+			{
+				// Parent isn't cached, or isn't a prim
+				continue;
+			}
+			candidate.mPosition = root->second;
+		}
+
+		const F32 distance = llmax(dist_vec(candidate.mPosition, predicted_local) - candidate.mRadius, 1.f);
+		if (distance > max_distance)
+		{
+			continue;
+		}
+		// As the mesh repository orders its requests
+		candidate.mScore = candidate.mRadius/distance;
+		ranked.push_back(candidate);
+	}
+
+	std::sort(ranked.begin(), ranked.end(), compareScore);
+	mCandidates.swap(ranked);
+	mNextCandidate = 0;
+}
+
+S32 LLRegionPrefetcher::warm(S32 max_requests, const LLVector3& predicted_local)
+{
+	const F32 pixel_meter_ratio = LLViewerCamera::getInstance()->getPixelMeterRatio();
+	const F64 now = LLFrameTimer::getElapsedSeconds();
+
+	S32 requests = 0;
+	while (requests < max_requests && mNextCandidate < (S32)mCandidates.size())
+	{
+		const Candidate& candidate = mCandidates[mNextCandidate++];
+
+		// Roughly the pixels the object will cover from where the agent is headed
+		const F32 distance = llmax(dist_vec(candidate.mPosition, predicted_local), 1.f);
+		const F32 size = 2.f*candidate.mRadius*pixel_meter_ratio/distance;
+		const F32 pixel_area = size*size;
+
+		for (S32 i = 0; i < candidate.mNumTextures; ++i)
+		{
+			const LLUUID& id = mTextureIDs[candidate.mFirstTexture + i];
+			if (!mWarmed.insert(id).second)
+			{
+				continue;
+			}
+
+			LLViewerFetchedTexture* image = LLViewerTextureManager::getFetchedTexture(id, MIPMAP_TRUE,
+													LLViewerTexture::BOOST_NONE, LLViewerTexture::FETCHED_TEXTURE);
+			if (!image || image->isMissingAsset()
+				|| image->getNumFaces() > 0 || image->getDiscardLevel() >= 0)
+			{
+				// Nothing to get ahead of
+				continue;
+			}
+
+			image->addTextureStats(pixel_area);
+			Warming warming;
+			warming.mImage = image;
+			warming.mPixelArea = pixel_area;
+			warming.mRequested = now;
+			warming.mArrived = 0.0;
+			mWarming.push_back(warming);
+			mTexturesRequested++;
+			requests++;
+		}
+
+		if (candidate.mMesh >= 0 && gMeshRepo.prefetchMesh(mMeshParams[candidate.mMesh]))
+		{
+			mMeshesRequested++;
+			requests++;
+		}
+	}
+	return requests;
+}
+
+void LLRegionPrefetcher::updateWarming()
+{
+	const F64 now = LLFrameTimer::getElapsedSeconds();
+
+	for (std::list<Warming>::iterator iter = mWarming.begin(); iter != mWarming.end(); )
+	{
+		LLViewerFetchedTexture* image = iter->mImage;
+		if (image->getNumFaces() > 0)
+		{
+			// In use, and whatever it had was that much sooner than asking
+			// for it now would have had it
+			mTextureHits++;
+			mTextureSavedSeconds += (iter->mArrived > 0.0 ? iter->mArrived : now) - iter->mRequested;
+			iter = mWarming.erase(iter);
+			continue;
+		}
+
+		if (image->isMissingAsset() || now - iter->mRequested > WARM_EXPIRY)
+		{
+			mTextureMisses++;
+			iter = mWarming.erase(iter);
+			continue;
+		}
+
+		if (iter->mArrived == 0.0 && image->getDiscardLevel() >= 0)
+		{
+			iter->mArrived = now;
+		}
+
+		// Texture stats only last the frame
+		image->addTextureStats(iter->mPixelArea);
+		++iter;
+	}
+}
+
+void LLRegionPrefetcher::getInfo(LLSD& info) const
+{
+	info["RegionsTargeted"] = mRegionsTargeted;
+
+	const S32 settled = mTextureHits + mTextureMisses;
+	info["TexturesRequested"] = mTexturesRequested;
+	info["TextureHits"] = mTextureHits;
+	info["TextureMisses"] = mTextureMisses;
+	info["TextureHitRate"] = settled > 0 ? (LLSD::Real)mTextureHits/settled : 0.0;
+	info["TextureSavedSeconds"] = mTextureSavedSeconds;
+
+	const S32 mesh_hits = gMeshRepo.getPrefetchHits();
+	info["MeshesRequested"] = mMeshesRequested;
+	info["MeshHits"] = mesh_hits;
+	info["MeshHitRate"] = mMeshesRequested > 0 ? (LLSD::Real)mesh_hits/mMeshesRequested : 0.0;
+	info["MeshHeadStartSeconds"] = gMeshRepo.getPrefetchHeadStart();
+}
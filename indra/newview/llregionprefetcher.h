@@ -0,0 +1,134 @@
+/**
+ * @file llregionprefetcher.h
+ * @brief Warms textures and meshes of a neighboring region before crossing into it.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLREGIONPREFETCHER_H
+#define LL_LLREGIONPREFETCHER_H
+
+#include <list>
+#include <set>
+#include <vector>
+
+#include "llpointer.h"
+#include "lluuid.h"
+#include "llvolume.h"
+#include "v3dmath.h"
+#include "v3math.h"
+
+class LLSD;
+class LLViewerFetchedTexture;
+class LLViewerRegion;
+
+//
+// A neighboring region's objects are only created, and their textures and
+// meshes only fetched, as they come into view, which when flying or sailing
+// across a region border is all at once.  The prefetcher looks a few
+// seconds ahead along the agent's velocity and the camera's heading, and
+// when that lands in another region it goes through the objects that
+// region's cache holds.  The textures and mesh headers of those nearest
+// the border get asked for ahead of time, under a request rate and a cap
+// on how many are outstanding.
+//
+// How often what was warmed went on to be used, and how much sooner than
+// it would otherwise have been there, is kept for getInfo().
+//
+class LLRegionPrefetcher
+{
+public:
+	LLRegionPrefetcher();
+	~LLRegionPrefetcher();
+
+	// MAIN THREAD
+	// Once a frame
+	void update();
+	// Drops everything held
+	void clear();
+	void getInfo(LLSD& info) const;
+
+	// Where the agent at pos_global is headed lookahead seconds on.  That
+	// is where its velocity takes it, carried on along the camera's
+	// horizontal heading by look_distance as far as it moves that way.  An
+	// agent that isn't moving is taken to be heading where it looks.
+	static LLVector3d predictPosition(const LLVector3d& pos_global, const LLVector3& velocity,
+									  const LLVector3& look_at, F32 lookahead, F32 look_distance);
+
+private:
+	// A cached object worth warming
+	struct Candidate
+	{
+		U32			mLocalID;
+		U32			mParentID;
+		LLVector3	mPosition;		// region local; a child's is its parent's once scanned
+		F32			mRadius;
+		F32			mScore;			// larger is sooner
+		S32			mFirstTexture;	// in mTextureIDs
+		S32			mNumTextures;
+		S32			mMesh;			// in mMeshParams, or -1
+	};
+
+	// A texture asked for ahead of time, held until it's used or given up on
+	struct Warming
+	{
+		LLPointer<LLViewerFetchedTexture>	mImage;
+		F32			mPixelArea;
+		F64			mRequested;
+		F64			mArrived;		// 0 until it has any data
+	};
+
+	// Starts on region's cache, or stops if it's NULL
+	void setTarget(LLViewerRegion* region);
+	// Decodes region's cache entries from where the last call left off, up
+	// to max_bytes of them.  Returns true once it has been through them all.
+	bool scan(LLViewerRegion* region, S32 max_bytes);
+	static bool compareScore(const Candidate& lhs, const Candidate& rhs);
+	// Orders what scan() found by their score from predicted_local
+	void rank(const LLVector3& predicted_local, F32 max_distance);
+	// Requests for the next best candidates, up to max_requests
+	S32 warm(S32 max_requests, const LLVector3& predicted_local);
+	// Checks on the textures being warmed
+	void updateWarming();
+
+	U64							mTargetHandle;		// 0 for no target
+	U32							mNextLocalID;
+	bool						mScanned;
+	std::vector<Candidate>		mCandidates;
+	std::vector<LLUUID>			mTextureIDs;
+	std::vector<LLVolumeParams>	mMeshParams;
+	S32							mNextCandidate;
+
+	std::list<Warming>			mWarming;
+	std::set<LLUUID>			mWarmed;			// texture ids seen for the target, to ask once
+	F32							mRequestBudget;		// requests that may be made now
+
+	// Stats
+	S32							mRegionsTargeted;
+	S32							mTexturesRequested;
+	S32							mTextureHits;
+	S32							mTextureMisses;
+	F64							mTextureSavedSeconds;
+	S32							mMeshesRequested;
+};
+
+#endif // LL_LLREGIONPREFETCHER_H
@@ -0,0 +1,312 @@
+/**
+ * @file llskylut.cpp
+ * @brief Tables of the WindLight haze model for filling in sky textures.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llskylut.h"
+
+#include "lljobscheduler.h"
+#include "llmemory.h"
+#include "llskymath.h"
+
+class LLSkyLUT::BuildJob : public LLWaitableJob
+{
+public:
+	BuildJob(LLSkyLUT *lut)
+	:	mLUT(lut)
+	{
+	}
+
+	// A build no worker has started isn't wanted any more
+	~BuildJob()
+	{
+		wait(false);
+	}
+
+protected:
+	/*virtual*/ void doWork()
+	{
+		mLUT->buildTables();
+	}
+
+private:
+	LLSkyLUT	*mLUT;
+};
+
+LLSkyLUT::Params::Params() :
+	mDomeRadius(15000.f),
+	mDomeOffsetRatio(0.96f),
+	mHazeDensity(0.f),
+	mDensityMultiplier(0.f),
+	mMaxY(0.f),
+	mCloudShadow(0.f)
+{
+}
+
+LLSkyLUT::LLSkyLUT() :
+	mValid(false)
+{
+	mBase = (LLVector4a *)ll_aligned_malloc_16(TABLE_SIZE*sizeof(LLVector4a));
+	mScale = (LLVector4a *)ll_aligned_malloc_16(TABLE_SIZE*sizeof(LLVector4a));
+	mJob = new BuildJob(this);
+}
+
+LLSkyLUT::~LLSkyLUT()
+{
+	delete mJob;
+	mJob = NULL;
+	ll_aligned_free_16(mBase);
+	ll_aligned_free_16(mScale);
+}
+
+// static
+F32 LLSkyLUT::projectToDome(const Params &params, LLVector3 &Pn, LLVector2 *horizontal_projection)
+{
+	const F32 dome_radius = params.mDomeRadius;
+	const F32 dome_offset_ratio = params.mDomeOffsetRatio;
+	const F32 max_y = params.mMaxY;
+
+	// project the direction ray onto the sky dome.
+	F32 phi = acos(Pn[1]);
+	F32 sinA = sin(F_PI - phi);
+	F32 Plen = dome_radius * sin(F_PI + phi + asin(dome_offset_ratio * sinA)) / sinA;
+
+	Pn *= Plen;
+
+	if (horizontal_projection)
+	{
+		*horizontal_projection = LLVector2(Pn[0], Pn[2]);
+		*horizontal_projection /= - 2.f * Plen;
+	}
+
+	// Set altitude
+	if (Pn[1] > 0.f)
+	{
+		Pn *= (max_y / Pn[1]);
+	}
+	else
+	{
+		Pn *= (-32000.f / Pn[1]);
+	}
+
+	Plen = Pn.length();
+	Pn /= Plen;
+	return Plen;
+}
+
+// static
+F32 LLSkyLUT::calcGlow(const Params &params, const LLVector3 &Pn)
+{
+	const LLColor3 &glow = params.mGlow;
+
+	// Compute haze glow
+	F32 haze_glow = Pn * LLVector3(params.mLightNorm);
+
+	haze_glow = 1.f - haze_glow;
+		// haze_glow is 0 at the sun and increases away from sun
+	haze_glow = llmax(haze_glow, .001f);
+		// Set a minimum "angle" (smaller glow.y allows tighter, brighter hotspot)
+	haze_glow *= glow.mV[0];
+		// Higher glow.x gives dimmer glow (because next step is 1 / "angle")
+	haze_glow = pow(haze_glow, glow.mV[2]);
+		// glow.z should be negative, so we're doing a sort of (1 / "angle") function
+
+	// Add "minimum anti-solar illumination"
+	return haze_glow + .25f;
+}
+
+// static
+LLColor3 LLSkyLUT::calcHazeColor(const Params &params, F32 height, F32 distance, F32 glow)
+{
+	const LLColor3 &sunlight_color = params.mSunlightColor;
+	const LLColor3 &ambient = params.mAmbient;
+	const LLColor3 &blue_density = params.mBlueDensity;
+	const LLColor3 &blue_horizon = params.mBlueHorizon;
+	const F32 haze_density = params.mHazeDensity;
+	const LLColor3 &haze_horizon = params.mHazeHorizon;
+	const F32 density_multiplier = params.mDensityMultiplier;
+	const F32 max_y = params.mMaxY;
+	const F32 cloud_shadow = params.mCloudShadow;
+	const LLVector4 &lightnorm = params.mLightNorm;
+
+	// Initialize temp variables
+	LLColor3 sunlight = sunlight_color;
+
+	// Sunlight attenuation effect (hue and brightness) due to atmosphere
+	// this is used later for sunlight modulation at various altitudes
+	LLColor3 light_atten =
+		(blue_density * 1.0 + smear(haze_density * 0.25f)) * (density_multiplier * max_y);
+
+	// Calculate relative weights
+	LLColor3 temp2(0.f, 0.f, 0.f);
+	LLColor3 temp1 = blue_density + smear(haze_density);
+	LLColor3 blue_weight = componentDiv(blue_density, temp1);
+	LLColor3 haze_weight = componentDiv(smear(haze_density), temp1);
+
+	// Compute sunlight from P & lightnorm (for long rays like sky)
+	temp2.mV[1] = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, height) * 1.0f + lightnorm[1] );
+
+	temp2.mV[1] = 1.f / temp2.mV[1];
+	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+
+	// Distance
+	temp2.mV[2] = distance * density_multiplier;
+
+	// Transparency (-> temp1)
+	temp1 = componentExp((temp1 * -1.f) * temp2.mV[2]);
+
+	temp2.mV[0] = glow;
+
+	// Haze color above cloud
+	LLColor3 haze_color = (blue_horizon * blue_weight * (sunlight + ambient)
+				+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + ambient)
+			 );
+
+	// Increase ambient when there are more clouds
+	LLColor3 tmpAmbient = ambient + (LLColor3::white - ambient) * cloud_shadow * 0.5f;
+
+	// Dim sunlight by cloud shadow percentage
+	sunlight *= (1.f - cloud_shadow);
+
+	// Haze color below cloud
+	LLColor3 additiveColorBelowCloud = (blue_horizon * blue_weight * (sunlight + tmpAmbient)
+				+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + tmpAmbient)
+			 );
+
+	// Final atmosphere additive
+	componentMultBy(haze_color, LLColor3::white - temp1);
+
+	sunlight = sunlight_color;
+	temp2.mV[1] = llmax(0.f, lightnorm[1] * 2.f);
+	temp2.mV[1] = 1.f / temp2.mV[1];
+	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+
+	// Attenuate cloud color by atmosphere
+	temp1 = componentSqrt(temp1);	//less atmos opacity (more transparency) below clouds
+
+	// At horizon, blend high altitude sky color towards the darker color below the clouds
+	haze_color +=
+		componentMult(additiveColorBelowCloud - haze_color, LLColor3::white - componentSqrt(temp1));
+
+	if (height < 0.f)
+	{
+		// Eric's original:
+		// LLColor3 dark_brown(0.143f, 0.129f, 0.114f);
+		LLColor3 dark_brown(0.082f, 0.076f, 0.066f);
+		LLColor3 brown(0.430f, 0.386f, 0.322f);
+		LLColor3 sky_lighting = sunlight + ambient;
+		F32 haze_brightness = haze_color.brightness();
+
+		if (height < -0.05f)
+		{
+			haze_color = colorMix(dark_brown, brown, -height * 0.9f) * sky_lighting * haze_brightness;
+		}
+
+		if (height > -0.1f)
+		{
+			haze_color = colorMix(LLColor3::white * haze_brightness, haze_color, fabs((height + 0.05f) * -20.f));
+		}
+	}
+	return haze_color;
+}
+
+void LLSkyLUT::build(const Params &params, bool on_worker)
+{
+	// Not while a worker is still at the old tables; an older build yet
+	// to start is simply dropped
+	mJob->wait(false);
+
+	mParams = params;
+	mValid = true;
+	if (!on_worker)
+	{
+		buildTables();
+		return;
+	}
+	mJob->submit(LLJobScheduler::LANE_NORMAL);
+}
+
+bool LLSkyLUT::isDone()
+{
+	return mJob->isDone();
+}
+
+void LLSkyLUT::wait()
+{
+	mJob->wait();
+}
+
+bool LLSkyLUT::isValid()
+{
+	return mValid && isDone();
+}
+
+void LLSkyLUT::buildTables()
+{
+	// Heights at the middle of each step, which keeps clear of the
+	// horizon, where the model divides by zero
+	const F32 step = 2.f/TABLE_SIZE;
+	for (S32 i = 0; i < TABLE_SIZE; i++)
+	{
+		const F32 height = -1.f + (i + 0.5f)*step;
+		const LLVector3 dir(sqrtf(1.f - height*height), height, 0.f);
+		LLVector3 Pn = dir;
+		const F32 distance = projectToDome(mParams, Pn, NULL);
+
+		// The haze is linear in the glow, which is all that depends on
+		// more than the height
+		const LLColor3 base = calcHazeColor(mParams, Pn[1], distance, 0.f);
+		const LLColor3 full = calcHazeColor(mParams, Pn[1], distance, 1.f);
+		const F32 sign = Pn * dir < 0.f ? -1.f : 1.f;
+		mBase[i].set(base.mV[0], base.mV[1], base.mV[2], sign);
+		mScale[i].set(full.mV[0] - base.mV[0], full.mV[1] - base.mV[1], full.mV[2] - base.mV[2], 0.f);
+	}
+}
+
+void LLSkyLUT::getHazeColor(const LLVector3 &Pn, LLColor3 &haze) const
+{
+	const F32 pos = llclamp((Pn.mV[VY] + 1.f)*(TABLE_SIZE/2) - 0.5f, 0.f, (F32)(TABLE_SIZE - 1));
+	const S32 i = llmin((S32)pos, TABLE_SIZE - 2);
+	const F32 frac = pos - i;
+
+	// Where projectToDome() would have left Pn, for the glow
+	const F32 sign = mBase[frac < 0.5f ? i : i + 1][3];
+	const F32 glow = calcGlow(mParams, Pn*sign);
+
+	LLVector4a t(frac);
+	LLVector4a base;
+	base.setSub(mBase[i + 1], mBase[i]);
+	base.mul(t);
+	base.add(mBase[i]);
+	LLVector4a scale;
+	scale.setSub(mScale[i + 1], mScale[i]);
+	scale.mul(t);
+	scale.add(mScale[i]);
+	scale.mul(LLVector4a(glow));
+	base.add(scale);
+
+	haze.set(base[0], base[1], base[2]);
+}
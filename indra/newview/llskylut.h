@@ -0,0 +1,122 @@
+/**
+ * @file llskylut.h
+ * @brief Tables of the WindLight haze model for filling in sky textures.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSKYLUT_H
+#define LL_LLSKYLUT_H
+
+#include "llmath.h"
+#include "v2math.h"
+#include "v3color.h"
+#include "v3math.h"
+#include "v4math.h"
+
+//
+// The haze color LLVOSky::calcSkyColorWLVert() works out for a direction
+// only depends on how high the direction points, bar the sun's glow, and
+// the glow only ever scales a second color that also only depends on the
+// height:  haze = base(height) + glow(direction . lightnorm)*scale(height).
+// The tables hold base and scale at evenly spaced heights, so filling in a
+// sky texture texel takes a lerp and one pow rather than the whole model.
+//
+// Tables are built from a copy of the parameters, on one of
+// LLJobScheduler's workers when it is running.  A built table is only
+// read, so any number of threads may look colors up in it at once.
+//
+class LLSkyLUT
+{
+public:
+	// The WindLight parameters the haze depends on, as LLVOSky keeps them
+	struct Params
+	{
+		Params();
+
+		F32			mDomeRadius;
+		F32			mDomeOffsetRatio;
+		LLColor3	mSunlightColor;
+		LLColor3	mAmbient;
+		LLColor3	mBlueDensity;
+		LLColor3	mBlueHorizon;
+		F32			mHazeDensity;
+		LLColor3	mHazeHorizon;
+		F32			mDensityMultiplier;
+		F32			mMaxY;
+		LLColor3	mGlow;
+		F32			mCloudShadow;
+		LLVector4	mLightNorm;			// OGL axes, clamped like the shaders'
+	};
+
+	// Heights from -1 to 1
+	enum { TABLE_SIZE = 512 };
+
+	LLSkyLUT();
+	// Waits for a build a worker has started
+	~LLSkyLUT();
+
+	// The model itself, in three steps.  Pn is a unit direction in OGL
+	// axes.  projectToDome() leaves it pointing where it meets the sky,
+	// normalized, and returns how far that is; horizontal_projection may
+	// be NULL.  calcHazeColor() takes the height that leaves, the distance
+	// and calcGlow() of the direction.
+	static F32 projectToDome(const Params &params, LLVector3 &Pn, LLVector2 *horizontal_projection);
+	static F32 calcGlow(const Params &params, const LLVector3 &Pn);
+	static LLColor3 calcHazeColor(const Params &params, F32 height, F32 distance, F32 glow);
+
+	// MAIN THREAD
+	// Builds the tables on a worker when on_worker is set and
+	// LLJobScheduler is running, and otherwise right away.
+	void build(const Params &params, bool on_worker);
+	bool isDone();
+	// Returns once built, building here if no worker has started on it
+	void wait();
+	// Built, and not invalidated since
+	bool isValid();
+	void invalidate()						{ mValid = false; }
+	const Params &getParams() const			{ return mParams; }
+
+	// Any thread, once isValid().  The haze color in unit direction Pn,
+	// to within what the tables' spacing loses.
+	void getHazeColor(const LLVector3 &Pn, LLColor3 &haze) const;
+
+private:
+	// Owns its tables
+	LLSkyLUT(const LLSkyLUT &);
+	LLSkyLUT &operator=(const LLSkyLUT &);
+
+	class BuildJob;
+
+	// Any thread
+	void buildTables();
+
+	Params			mParams;
+	// By height, rgb then the sign projectToDome() gives directions
+	LLVector4a		*mBase;
+	// What each unit of glow adds, rgb
+	LLVector4a		*mScale;
+	BuildJob		*mJob;
+	bool			mValid;
+};
+
+#endif // LL_LLSKYLUT_H
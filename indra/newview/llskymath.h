@@ -0,0 +1,82 @@
+/**
+ * @file llskymath.h
+ * @brief Per component color arithmetic for the WindLight sky model.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSKYMATH_H
+#define LL_LLSKYMATH_H
+
+#include <cmath>
+
+#include "v3color.h"
+
+// Shared by LLVOSky and LLSkyLUT so that both run the model with exactly
+// the same arithmetic.  Internal to newview.
+
+inline LLColor3 componentDiv(LLColor3 const &left, LLColor3 const & right)
+{
+	return LLColor3(left.mV[0]/right.mV[0],
+					 left.mV[1]/right.mV[1],
+					 left.mV[2]/right.mV[2]);
+}
+
+inline LLColor3 componentMult(LLColor3 const &left, LLColor3 const & right)
+{
+	return LLColor3(left.mV[0]*right.mV[0],
+					 left.mV[1]*right.mV[1],
+					 left.mV[2]*right.mV[2]);
+}
+
+inline LLColor3 componentExp(LLColor3 const &v)
+{
+	return LLColor3(exp(v.mV[0]),
+					 exp(v.mV[1]),
+					 exp(v.mV[2]));
+}
+
+inline LLColor3 componentSqrt(LLColor3 const &v)
+{
+	return LLColor3(sqrt(v.mV[0]),
+					 sqrt(v.mV[1]),
+					 sqrt(v.mV[2]));
+}
+
+inline void componentMultBy(LLColor3 & left, LLColor3 const & right)
+{
+	left.mV[0] *= right.mV[0];
+	left.mV[1] *= right.mV[1];
+	left.mV[2] *= right.mV[2];
+}
+
+inline LLColor3 colorMix(LLColor3 const & left, LLColor3 const & right, F32 amount)
+{
+	return (left + ((right - left) * amount));
+}
+
+inline LLColor3 smear(F32 val)
+{
+	return LLColor3(val, val, val);
+}
+
+#endif // LL_LLSKYMATH_H
@@ -1535,6 +1535,15 @@ BOOL LLSpatialGroup::rebound()
 	return TRUE;
 }
 
+BOOL LLSpatialGroup::usesSoftwareOcclusion()
+{
+	//bridges are bounded in their own space, so they stay with queries
+	return LLPipeline::sSoftwareOcclusion &&
+		LLPipeline::sUseOcclusion > 1 &&
+		LLViewerCamera::sCurCameraID == LLViewerCamera::CAMERA_WORLD &&
+		!mSpatialPartition->asBridge();
+}
+
 static LLFastTimer::DeclareTimer FTM_OCCLUSION_READBACK("Readback Occlusion");
 void LLSpatialGroup::checkOcclusion()
 {
@@ -1546,6 +1555,23 @@ void LLSpatialGroup::checkOcclusion()
 		{	//if the parent has been marked as occluded, the child is implicitly occluded
 			clearOcclusionState(QUERY_PENDING | DISCARD_QUERY);
 		}
+		else if (usesSoftwareOcclusion())
+		{	//no query to wait on, test against this frame's occluders (never the root node)
+			clearOcclusionState(QUERY_PENDING | DISCARD_QUERY);
+
+			if (parent && mSpatialPartition->isOcclusionEnabled() && gPipeline.isSoftwareOccluded(mBounds))
+			{
+				assert_states_valid(this);
+				setOcclusionState(LLSpatialGroup::OCCLUDED, LLSpatialGroup::STATE_MODE_DIFF);
+				assert_states_valid(this);
+			}
+			else if (isOcclusionState(LLSpatialGroup::OCCLUDED))
+			{
+				assert_states_valid(this);
+				clearOcclusionState(LLSpatialGroup::OCCLUDED, LLSpatialGroup::STATE_MODE_DIFF);
+				assert_states_valid(this);
+			}
+		}
 		else if (isOcclusionState(QUERY_PENDING))
 		{	//otherwise, if a query is pending, read it back
 
@@ -1611,7 +1637,7 @@ static LLFastTimer::DeclareTimer FTM_OCCLUSION_EARLY_FAIL("Occlusion Early Fail"
 
 void LLSpatialGroup::doOcclusion(LLCamera* camera)
 {
-	if (mSpatialPartition->isOcclusionEnabled() && LLPipeline::sUseOcclusion > 1)
+	if (mSpatialPartition->isOcclusionEnabled() && LLPipeline::sUseOcclusion > 1 && !usesSoftwareOcclusion())
 	{
 		// Don't cull hole/edge water, unless we have the GL_ARB_depth_clamp extension
 		if (earlyFail(camera, this))
@@ -4321,6 +4347,9 @@ LLDrawable* LLSpatialPartition::lineSegmentIntersect(const LLVector3& start, con
 	return drawable;
 }
 
+static LLMemTag sDrawInfoMemTag("DrawInfo");
+LLMemTagPool LLDrawInfo::sMemPool(sDrawInfoMemTag, sizeof(LLDrawInfo));
+
 LLDrawInfo::LLDrawInfo(U16 start, U16 end, U32 count, U32 offset, 
 					   LLViewerTexture* texture, LLVertexBuffer* buffer,
 					   BOOL fullbright, U8 bump, BOOL particle, F32 part_size)
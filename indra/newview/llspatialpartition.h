@@ -30,6 +30,7 @@
 #define SG_MIN_DIST_RATIO 0.00001f
 
 #include "lldrawable.h"
+#include "llmemtag.h"
 #include "lloctree.h"
 #include "llpointer.h"
 #include "llrefcount.h"
@@ -87,6 +88,11 @@ public:
 
 	void validate();
 
+	// Draw infos come and go by the thousand on every rebuild, so they are
+	// pooled and counted under the "DrawInfo" memory tag.
+	void* operator new(size_t size)					{ return sMemPool.allocate(size); }
+	void operator delete(void* ptr, size_t size)	{ sMemPool.deallocate(ptr, size); }
+
 	LLVector4a mExtents[2];
 	
 	LLPointer<LLVertexBuffer> mVertexBuffer;
@@ -111,6 +117,11 @@ public:
 	F32 mDistance;
 	U32 mDrawMode;
 
+private:
+	static LLMemTagPool sMemPool;
+
+public:
+
 	struct CompareTexture
 	{
 		bool operator()(const LLDrawInfo& lhs, const LLDrawInfo& rhs)
@@ -315,6 +326,7 @@ public:
 	BOOL rebound();
 	void buildOcclusion(); //rebuild mOcclusionVerts
 	void checkOcclusion(); //read back last occlusion query (if any)
+	BOOL usesSoftwareOcclusion(); //occlusion is tested against gPipeline's software depth buffer instead of queried
 	void doOcclusion(LLCamera* camera); //issue occlusion query
 	void destroyGL();
 	
@@ -52,6 +52,7 @@
 #include "noise.h"
 #include "llviewercamera.h"
 #include "llglheaders.h"
+#include "llocclusionraster.h"
 #include "lldrawpoolterrain.h"
 #include "lldrawable.h"
 
@@ -87,6 +88,7 @@ LLSurface::LLSurface(U32 type, LLViewerRegion *regionp) :
 
 	// Patch data
 	mPatchList = NULL;
+	mPatchDecompressor = NULL;
 
 	// One of each for each camera
 	mVisiblePatchCount = 0;
@@ -120,6 +122,8 @@ LLSurface::~LLSurface()
 	mPatchesPerEdge = 0;
 	mNumberOfPatches = 0;
 	destroyPatchData();
+	delete mPatchDecompressor;
+	mPatchDecompressor = NULL;
 
 	LLDrawPoolTerrain *poolp = (LLDrawPoolTerrain*) gPipeline.findPool(LLDrawPool::POOL_TERRAIN, mSTexturep);
 	if (!poolp)
@@ -657,18 +661,26 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 	return did_update;
 }
 
+static LLFastTimer::DeclareTimer FTM_DECOMPRESS_PATCHES("Decompress Patches");
+
 void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
 {
 
 	LLPatchHeader  ph;
 	S32 j, i;
-	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 	LLSurfacePatch *patchp;
 
-	init_patch_decompressor(gopp->patch_size);
+	if (!mPatchDecompressor || mPatchDecompressor->getSize() != gopp->patch_size)
+	{
+		delete mPatchDecompressor;
+		mPatchDecompressor = new LLPatchDecompressor(gopp->patch_size);
+	}
 	gopp->stride = mGridsPerEdge;
-	set_group_of_patch_header(gopp);
 
+	// Unpacking is serial, but the patches can then be transformed in
+	// parallel.  Neighbors' edges are only updated once they all have been.
+	std::vector<LLPatchDecompressor::Request> requests;
+	std::vector<LLSurfacePatch *> patches;
 	while (1)
 	{
 		decode_patch_header(bitpack, &ph);
@@ -697,9 +709,23 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 
 		patchp = &mPatchList[j*mPatchesPerEdge + i];
 
+		requests.resize(requests.size() + 1);
+		LLPatchDecompressor::Request &request = requests.back();
+		request.mPatch = patchp->getDataZ();
+		request.mStride = gopp->stride;
+		request.mHeader = ph;
+		decode_patch(bitpack, request.mCoefficients);
+		patches.push_back(patchp);
+	}
+
+	{
+		LLFastTimer t(FTM_DECOMPRESS_PATCHES);
+		mPatchDecompressor->decompressAll(requests);
+	}
 
-		decode_patch(bitpack, patch);
-		decompress_patch(patchp->getDataZ(), patch, &ph);
+	for (U32 k = 0; k < patches.size(); k++)
+	{
+		patchp = patches[k];
 
 		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
 		patchp->updateNorthEdge();
@@ -1152,6 +1178,73 @@ void LLSurface::dirtySurfacePatch(LLSurfacePatch *patchp)
 }
 
 
+void LLSurface::addOccluders(LLOcclusionRaster& raster) const
+{
+	if (!mPatchList || !mHasZData)
+	{
+		return;
+	}
+
+	// One vertex at each patch corner, as low as the lowest patch around
+	// it, so however the patches are tessellated the mesh stays under them.
+	// Patches without data, or with changes still to go through, are left
+	// out, which only means less is culled.
+	const S32 corners_per_edge = mPatchesPerEdge + 1;
+	const S32 num_corners = corners_per_edge*corners_per_edge;
+	std::vector<F32> corner_z(num_corners, F32_MAX);
+	std::vector<U16> indices;
+	indices.reserve(mNumberOfPatches*6);
+
+	for (S32 j = 0; j < mPatchesPerEdge; j++)
+	{
+		for (S32 i = 0; i < mPatchesPerEdge; i++)
+		{
+			LLSurfacePatch* patchp = getPatch(i, j);
+			if (!patchp->getHasReceivedData() || mDirtyPatchList.count(patchp))
+			{
+				continue;
+			}
+
+			const F32 z = patchp->getMinZ();
+			const S32 corner = i + j*corners_per_edge;
+			corner_z[corner] = llmin(corner_z[corner], z);
+			corner_z[corner + 1] = llmin(corner_z[corner + 1], z);
+			corner_z[corner + corners_per_edge] = llmin(corner_z[corner + corners_per_edge], z);
+			corner_z[corner + corners_per_edge + 1] = llmin(corner_z[corner + corners_per_edge + 1], z);
+
+			// Counter clockwise seen from above
+			indices.push_back(corner);
+			indices.push_back(corner + 1);
+			indices.push_back(corner + corners_per_edge + 1);
+			indices.push_back(corner);
+			indices.push_back(corner + corners_per_edge + 1);
+			indices.push_back(corner + corners_per_edge);
+		}
+	}
+
+	if (indices.empty())
+	{
+		return;
+	}
+
+	const LLVector3 origin = getOriginAgent();
+	const F32 patch_width = mGridsPerPatchEdge*mMetersPerGrid;
+	LLVector4a* verts = (LLVector4a*) ll_aligned_malloc_16(sizeof(LLVector4a)*num_corners);
+	for (S32 j = 0; j < corners_per_edge; j++)
+	{
+		for (S32 i = 0; i < corners_per_edge; i++)
+		{
+			const S32 corner = i + j*corners_per_edge;
+			// Corners of patches left out aren't used
+			const F32 z = corner_z[corner] < F32_MAX ? corner_z[corner] : 0.f;
+			verts[corner].set(origin.mV[VX] + i*patch_width, origin.mV[VY] + j*patch_width, z, 1.f);
+		}
+	}
+
+	raster.addTriangles(verts, num_corners, &indices[0], (S32) indices.size());
+	ll_aligned_free_16(verts);
+}
+
 void LLSurface::setWaterHeight(F32 height)
 {
 	if (!mWaterObjp.isNull())
@@ -63,6 +63,8 @@ class LLViewerRegion;
 class LLSurfacePatch;
 class LLBitPack;
 class LLGroupHeader;
+class LLPatchDecompressor;
+class LLOcclusionRaster;
 
 class LLSurface 
 {
@@ -134,6 +136,11 @@ public:
 	void dirtyAllPatches();	// Use this to dirty all patches when changing terrain parameters
 
 	void dirtySurfacePatch(LLSurfacePatch *patchp);
+
+	// Adds a mesh lying under the terrain everywhere to raster, for
+	// culling what is behind hills when the camera is above the land
+	void addOccluders(LLOcclusionRaster& raster) const;
+
 	LLVOWater *getWaterObj()						{ return mWaterObjp; }
 
 	static void setTextureSize(const S32 texture_size);
@@ -188,6 +195,7 @@ protected:
 protected:
 	LLVector3d	mOriginGlobal;		// In absolute frame
 	LLSurfacePatch *mPatchList;		// Array of all patches
+	LLPatchDecompressor *mPatchDecompressor;	// For the patch size last received
 
 	// Array of grid data, mGridsPerEdge * mGridsPerEdge
 	F32 *mSurfaceZ;
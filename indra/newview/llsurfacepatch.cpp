@@ -46,6 +46,9 @@
 extern U64 gFrameTime;
 extern LLPipeline gPipeline;
 
+// Geomorph positions a patch passes through on its way to the next stride
+const S32 GEOMORPH_STEPS = 8;
+
 LLSurfacePatch::LLSurfacePatch() :
 	mHasReceivedData(FALSE),
 	mSTexUpdate(FALSE),
@@ -104,6 +107,7 @@ void LLSurfacePatch::dirty()
 
 	mDirtyZStats = TRUE;
 	mHeightsGenerated = FALSE;
+	mVertexGrid.invalidate();
 	
 	if (!mDirty)
 	{
@@ -200,44 +204,62 @@ LLVector2 LLSurfacePatch::getTexCoords(const U32 x, const U32 y) const
 }
 
 
-void LLSurfacePatch::eval(const U32 x, const U32 y, const U32 stride, LLVector3 *vertex, LLVector3 *normal,
-						  LLVector2 *tex0, LLVector2 *tex1)
+static LLFastTimer::DeclareTimer FTM_UPDATE_VERTEX_GRID("Terrain Vertex Grid");
+
+BOOL LLSurfacePatch::updateVertexGrid()
 {
+	if (mVertexGrid.isValid())
+	{
+		return FALSE;
+	}
 	if (!mSurfacep || !mSurfacep->getRegion() || !mSurfacep->getGridsPerEdge())
 	{
-		return; // failsafe
+		return FALSE; // failsafe
 	}
-	llassert_always(vertex && normal && tex0 && tex1);
-	
-	U32 surface_stride = mSurfacep->getGridsPerEdge();
-	U32 point_offset = x + y*surface_stride;
 
-	*normal = getNormal(x, y);
+	LLFastTimer ftm(FTM_UPDATE_VERTEX_GRID);
+
+	U32 grids_per_patch_edge = mSurfacep->getGridsPerPatchEdge();
+	U32 surface_stride = mSurfacep->getGridsPerEdge();
 
-	LLVector3 pos_agent = getOriginAgent();
-	pos_agent.mV[VX] += x * mSurfacep->getMetersPerGrid();
-	pos_agent.mV[VY] += y * mSurfacep->getMetersPerGrid();
-	pos_agent.mV[VZ]  = *(mDataZ + point_offset);
-	*vertex     = pos_agent;
+	// The noise only depends on where the patch is, so it's worked out
+	// when the grid is created and kept
+	BOOL generate_noise = FALSE;
+	if (mVertexGrid.getPatchWidth() != grids_per_patch_edge)
+	{
+		mVertexGrid.create(grids_per_patch_edge);
+		generate_noise = TRUE;
+	}
 
-	LLVector3 rel_pos = pos_agent - mSurfacep->getOriginAgent();
-	LLVector3 tex_pos = rel_pos * (1.f/surface_stride);
-	tex0->mV[0]  = tex_pos.mV[0];
-	tex0->mV[1]  = tex_pos.mV[1];
-	tex1->mV[0] = mSurfacep->getRegion()->getCompositionXY(llfloor(mOriginRegion.mV[0])+x, llfloor(mOriginRegion.mV[1])+y);
+	mVertexGrid.update(mDataZ, mDataNorm, surface_stride, mSurfacep->getMetersPerGrid(),
+					   LLVector2(mOriginRegion.mV[VX], mOriginRegion.mV[VY]), 1.f/surface_stride);
 
 	const F32 xyScale = 4.9215f*7.f; //0.93284f;
 	const F32 xyScaleInv = (1.f / xyScale)*(0.2222222222f);
 
-	F32 vec[3] = {
-					fmod((F32)(mOriginGlobal.mdV[0] + x)*xyScaleInv, 256.f),
-					fmod((F32)(mOriginGlobal.mdV[1] + y)*xyScaleInv, 256.f),
-					0.f
-				};
-	F32 rand_val = llclamp(noise2(vec)* 0.75f + 0.5f, 0.f, 1.f);
-	tex1->mV[1] = rand_val;
-
+	LLViewerRegion *regionp = mSurfacep->getRegion();
+	S32 origin_x = llfloor(mOriginRegion.mV[0]);
+	S32 origin_y = llfloor(mOriginRegion.mV[1]);
+	LLVector2 *tex1 = mVertexGrid.getTexCoords1();
+	for (U32 y = 0; y <= grids_per_patch_edge; y++)
+	{
+		for (U32 x = 0; x <= grids_per_patch_edge; x++)
+		{
+			tex1->mV[0] = regionp->getCompositionXY(origin_x + x, origin_y + y);
+			if (generate_noise)
+			{
+				F32 vec[3] = {
+								fmod((F32)(mOriginGlobal.mdV[0] + x)*xyScaleInv, 256.f),
+								fmod((F32)(mOriginGlobal.mdV[1] + y)*xyScaleInv, 256.f),
+								0.f
+							};
+				tex1->mV[1] = llclamp(noise2(vec)* 0.75f + 0.5f, 0.f, 1.f);
+			}
+			tex1++;
+		}
+	}
 
+	return TRUE;
 }
 
 
@@ -601,6 +623,7 @@ void LLSurfacePatch::updateNormals()
 
 	if (dirty_patch)
 	{
+		mVertexGrid.invalidate();
 		mSurfacep->dirtySurfacePatch(this);
 	}
 
@@ -707,6 +730,7 @@ BOOL LLSurfacePatch::updateTexture()
 			
 			if (comp->generateComposition())
 			{
+				mVertexGrid.invalidate();
 				if (mVObjp)
 				{
 					mVObjp->dirtyGeom();
@@ -735,17 +759,27 @@ void LLSurfacePatch::updateGL()
 	
 	updateCompositionStats();
 	F32 tex_patch_size = meters_per_grid*grids_per_patch_edge;
-	if (comp->generateTexture((F32)origin_region[VX], (F32)origin_region[VY],
+	// Calls textureGenerated() once it's done, which may be a few frames on.
+	// Cleared now, so heights changed meanwhile start another.
+	if (comp->generateTexture(this, (F32)origin_region[VX], (F32)origin_region[VY],
 							  tex_patch_size, tex_patch_size))
 	{
 		mSTexUpdate = FALSE;
-
-		// Also generate the water texture
-		mSurfacep->generateWaterTexture((F32)origin_region.mdV[VX], (F32)origin_region.mdV[VY],
-										tex_patch_size, tex_patch_size);
 	}
 }
 
+void LLSurfacePatch::textureGenerated()
+{
+	F32 meters_per_grid = getSurface()->getMetersPerGrid();
+	F32 grids_per_patch_edge = (F32)getSurface()->getGridsPerPatchEdge();
+	LLVector3d origin_region = getOriginGlobal() - getSurface()->getOriginGlobal();
+	F32 tex_patch_size = meters_per_grid*grids_per_patch_edge;
+
+	// Also generate the water texture
+	mSurfacep->generateWaterTexture((F32)origin_region.mdV[VX], (F32)origin_region.mdV[VY],
+									tex_patch_size, tex_patch_size);
+}
+
 void LLSurfacePatch::dirtyZ()
 {
 	mSTexUpdate = TRUE;
@@ -807,7 +841,10 @@ void LLSurfacePatch::setOriginGlobal(const LLVector3d &origin_global)
 	mVisInfo.mDistance = 512.0f;
 	mVisInfo.mRenderLevel = 0;
 	mVisInfo.mRenderStride = mSurfacep->getGridsPerPatchEdge();
-	
+	mVisInfo.mMorph = 0.f;
+
+	// The grid's noise goes with the old origin
+	mVertexGrid.destroy();
 }
 
 void LLSurfacePatch::connectNeighbor(LLSurfacePatch *neighbor_patchp, const U32 direction)
@@ -887,6 +924,19 @@ void LLSurfacePatch::updateVisibility()
 		new_render_level = mVisInfo.mRenderLevel = mSurfacep->getRenderLevel(max_render_stride);
 		mVisInfo.mRenderStride = mSurfacep->getRenderStride(new_render_level);
 
+		// Each stride is used until the relation above allows twice it, so
+		// how far along that is says how far to morph toward the coarser one.
+		// In steps, so that a moving camera doesn't rebuild every frame.
+		F32 old_morph = mVisInfo.mMorph;
+		mVisInfo.mMorph = 0.f;
+		if (LLVOSurfacePatch::sGeomorphFactor > 0.f)
+		{
+			F32 stride = (F32)mVisInfo.mRenderStride;
+			F32 morph = llclamp((mVisInfo.mDistance * stride_per_distance - stride)/stride, 0.f, 1.f);
+			morph *= llmin(LLVOSurfacePatch::sGeomorphFactor, 1.f);
+			mVisInfo.mMorph = llround(morph*GEOMORPH_STEPS)/(F32)GEOMORPH_STEPS;
+		}
+
 		if ((mVisInfo.mRenderStride != old_render_stride)) 
 			// The reason we check !mbIsVisible is because non-visible patches normals 
 			// are not updated when their data is changed.  When this changes we can get 
@@ -905,6 +955,14 @@ void LLSurfacePatch::updateVisibility()
 				}
 			}
 		}
+		else if (mVisInfo.mMorph != old_morph)
+		{
+			// Patch edges don't morph, so the neighbors are fine as they are
+			if (mVObjp)
+			{
+				mVObjp->dirtyGeom();
+			}
+		}
 		mVisInfo.mbIsVisible = TRUE;
 	}
 	else
@@ -939,6 +997,11 @@ S32 LLSurfacePatch::getRenderLevel() const
 	return mVisInfo.mRenderLevel;
 }
 
+F32 LLSurfacePatch::getMorph() const
+{
+	return mVisInfo.mMorph;
+}
+
 void LLSurfacePatch::setHasReceivedData()
 {
 	mHasReceivedData = TRUE;
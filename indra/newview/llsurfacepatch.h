@@ -30,6 +30,7 @@
 #include "v3math.h"
 #include "v3dmath.h"
 #include "llpointer.h"
+#include "llpatchvertexgrid.h"
 
 class LLSurface;
 class LLVOSurfacePatch;
@@ -47,13 +48,15 @@ public:
 		mbIsVisible(FALSE),
 		mDistance(0.f),
 		mRenderLevel(0),
-		mRenderStride(0) { };
+		mRenderStride(0),
+		mMorph(0.f) { };
 	~LLPatchVisibilityInfo() { };
 
 	BOOL mbIsVisible;
 	F32 mDistance;			// Distance from camera
 	S32 mRenderLevel;
 	U32 mRenderStride;
+	F32 mMorph;				// Geomorph toward the next coarser stride, 0 to 1
 };
 
 
@@ -85,6 +88,8 @@ public:
 	void updateCameraDistanceRegion( const LLVector3 &pos_region);
 	void updateVisibility();
 	void updateGL();
+	// The surface texture has been updated for this patch
+	void textureGenerated();
 
 	void dirtyZ(); // Dirty the z values of this patch
 	void setHasReceivedData();
@@ -105,10 +110,11 @@ public:
 	void calcNormal(const U32 x, const U32 y, const U32 stride);
 	const LLVector3 &getNormal(const U32 x, const U32 y) const;
 
-	void eval(const U32 x, const U32 y, const U32 stride,
-				LLVector3 *vertex, LLVector3 *normal, LLVector2 *tex0, LLVector2 *tex1);
-	
-	
+	// Brings the vertex grid up to date with the heights, normals and
+	// composition.  Returns TRUE if it had to.
+	BOOL updateVertexGrid();
+	const LLPatchVertexGrid &getVertexGrid() const	{ return mVertexGrid; }
+
 
 	LLVector3 getOriginAgent() const;
 	const LLVector3d &getOriginGlobal() const;
@@ -127,6 +133,7 @@ public:
 	BOOL getVisible() const;
 	U32 getRenderStride() const;
 	S32 getRenderLevel() const;
+	F32 getMorph() const;
 
 	void setSurface(LLSurface *surfacep);
 	void setDataZ(F32 *data_z)					{ mDataZ = data_z; }
@@ -154,6 +161,9 @@ protected:
 	F32 *mDataZ;
 	LLVector3 *mDataNorm;
 
+	// Vertex data of every grid point, for LLVOSurfacePatch to draw from
+	LLPatchVertexGrid mVertexGrid;
+
 	// Pointer to the LLVOSurfacePatch object which is used in the new renderer.
 	LLPointer<LLVOSurfacePatch> mVObjp;
 
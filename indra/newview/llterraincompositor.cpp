@@ -0,0 +1,324 @@
+/**
+ * @file llterraincompositor.cpp
+ * @brief Blends terrain detail textures into a region's surface texture.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llterraincompositor.h"
+
+#include "llmath.h"
+#include "lljobscheduler.h"
+
+// Rows a worker composites at a time, a patch's worth at the usual
+// surface texture size
+const S32 TILE_ROWS = 16;
+const S32 COMPONENTS = 3;
+
+class LLTerrainCompositor::TileJob : public LLWaitableJob
+{
+public:
+	TileJob(LLTerrainCompositor *compositor, S32 y_begin, S32 y_end)
+	:	mCompositor(compositor),
+		mYBegin(y_begin),
+		mYEnd(y_end)
+	{
+	}
+
+	// Rows no worker has started are composited here instead
+	~TileJob()
+	{
+		wait();
+	}
+
+protected:
+	/*virtual*/ void doWork()
+	{
+		mCompositor->compositeRows(mYBegin, mYEnd);
+	}
+
+private:
+	LLTerrainCompositor	*mCompositor;
+	S32					mYBegin;
+	S32					mYEnd;
+};
+
+LLTerrainCompositor::LLTerrainCompositor(const Params &params)
+:	mParams(params),
+	mValuesWidth(0)
+{
+	const S32 width = llmax(0, mParams.mXEnd - mParams.mXBegin);
+	const S32 height = llmax(0, mParams.mYEnd - mParams.mYBegin);
+	const S32 last = mParams.mCompositionWidth - 1;
+	const F32 scale_inv = mParams.mCompositionScaleInv;
+	if (!width || !height)
+	{
+		return;
+	}
+
+	// What LLViewerLayer::getValueScaled() looks up, one axis at a time
+	mX1.resize(width);
+	mX2.resize(width);
+	mXFrac.resize(width);
+	for (S32 i = 0; i < width; i++)
+	{
+		const F32 x = (i + mParams.mXBegin)*mParams.mTexXRatio;
+		F32 x_frac = x*scale_inv;
+		S32 x1 = llfloor(x_frac);
+		S32 x2 = x1 + 1;
+		x_frac -= x1;
+		mX1[i] = llclamp(x1, 0, last);
+		mX2[i] = llclamp(x2, 0, last);
+		mXFrac[i] = x_frac;
+	}
+	mY1.resize(height);
+	mY2.resize(height);
+	mYFrac.resize(height);
+	for (S32 j = 0; j < height; j++)
+	{
+		const F32 y = (j + mParams.mYBegin)*mParams.mTexYRatio;
+		F32 y_frac = y*scale_inv;
+		S32 y1 = llfloor(y_frac);
+		S32 y2 = y1 + 1;
+		y_frac -= y1;
+		mY1[j] = llclamp(y1, 0, last);
+		mY2[j] = llclamp(y2, 0, last);
+		mYFrac[j] = y_frac;
+	}
+
+	// Copy just the values those reach, and make the lookups relative
+	const S32 x_lo = llmin(mX1.front(), mX1.back());
+	const S32 x_hi = llmax(mX2.front(), mX2.back());
+	const S32 y_lo = llmin(mY1.front(), mY1.back());
+	const S32 y_hi = llmax(mY2.front(), mY2.back());
+	mValuesWidth = x_hi - x_lo + 1;
+	mValues.resize(mValuesWidth*(y_hi - y_lo + 1));
+	for (S32 y = y_lo; y <= y_hi; y++)
+	{
+		memcpy(&mValues[(y - y_lo)*mValuesWidth],
+			   mParams.mComposition + y*mParams.mCompositionWidth + x_lo,
+			   mValuesWidth*sizeof(F32));
+	}
+	for (S32 i = 0; i < width; i++)
+	{
+		mX1[i] -= x_lo;
+		mX2[i] -= x_lo;
+	}
+	for (S32 j = 0; j < height; j++)
+	{
+		mY1[j] -= y_lo;
+		mY2[j] -= y_lo;
+	}
+
+	// Step through the detail textures the way generateTexture() always
+	// has, so that every texel picks the same detail texel as before
+	const U32 st_width = mParams.mDetailWidth;
+	const U32 st_height = mParams.mDetailHeight;
+	const F32 st_x_stride = mParams.mDetailXStride;
+	const F32 st_y_stride = mParams.mDetailYStride;
+	const S32 tex_x_begin = mParams.mXBegin;
+	const S32 tex_y_begin = mParams.mYBegin;
+
+	mDetailColumn.resize(width);
+	F32 sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
+	for (S32 i = 0; i < width; i++)
+	{
+		mDetailColumn[i] = lltrunc(sti);
+		sti += st_x_stride;
+		if (sti >= st_width)
+		{
+			sti -= st_width;
+		}
+	}
+
+	mDetailRow.resize(height);
+	F32 stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+	for (S32 j = 0; j < height; j++)
+	{
+		mDetailRow[j] = lltrunc(stj)*st_width;
+		stj += st_y_stride;
+		if (stj >= st_height)
+		{
+			stj -= st_height;
+		}
+	}
+}
+
+LLTerrainCompositor::~LLTerrainCompositor()
+{
+	for (U32 i = 0; i < mJobs.size(); i++)
+	{
+		delete mJobs[i];
+	}
+	mJobs.clear();
+}
+
+void LLTerrainCompositor::start()
+{
+	const S32 y_begin = mParams.mYBegin;
+	const S32 y_end = mParams.mYEnd;
+	if (mX1.empty())
+	{
+		return;
+	}
+
+	if (!LLJobScheduler::instanceExists() || !LLJobScheduler::getInstance()->isRunning())
+	{
+		compositeRows(y_begin, y_end);
+		return;
+	}
+
+	for (S32 y = y_begin; y < y_end; y += TILE_ROWS)
+	{
+		mJobs.push_back(new TileJob(this, y, llmin(y + TILE_ROWS, y_end)));
+	}
+	for (U32 i = 0; i < mJobs.size(); i++)
+	{
+		mJobs[i]->submit(LLJobScheduler::LANE_HIGH);
+	}
+}
+
+bool LLTerrainCompositor::isDone()
+{
+	for (U32 i = 0; i < mJobs.size(); i++)
+	{
+		if (!mJobs[i]->isDone())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void LLTerrainCompositor::compositeRows(S32 y_begin, S32 y_end)
+{
+	const S32 width = mParams.mXEnd - mParams.mXBegin;
+	const F32 *values = &mValues[0];
+	const U8 *const *detail = mParams.mDetail;
+	const S32 *detail_size = mParams.mDetailSize;
+
+	LL_ALIGN_16(F32 row1_left[4]);
+	LL_ALIGN_16(F32 row1_right[4]);
+	LL_ALIGN_16(F32 row2_left[4]);
+	LL_ALIGN_16(F32 row2_right[4]);
+	LL_ALIGN_16(F32 x_frac[4]);
+	LL_ALIGN_16(F32 composition[4]);
+	LL_ALIGN_16(F32 from[COMPONENTS][4]);
+	LL_ALIGN_16(F32 to[COMPONENTS][4]);
+	LL_ALIGN_16(S32 blended[4]);
+	bool valid[4];
+
+	for (S32 j = y_begin; j < y_end; j++)
+	{
+		const S32 row = j - mParams.mYBegin;
+		const F32 *row1 = values + mY1[row]*mValuesWidth;
+		const F32 *row2 = values + mY2[row]*mValuesWidth;
+		const LLVector4a y_frac(mYFrac[row]);
+		const S32 detail_row = mDetailRow[row];
+		U8 *out = mParams.mOutput + j*mParams.mOutputStride + mParams.mXBegin*COMPONENTS;
+
+		for (S32 i = 0; i < width; i += 4)
+		{
+			const S32 lanes = llmin(4, width - i);
+			S32 lane;
+
+			// Composition values, getValueScaled()'s arithmetic four at a time
+			for (lane = 0; lane < 4; lane++)
+			{
+				// Past the end of the row, repeat the last texel
+				const S32 col = i + llmin(lane, lanes - 1);
+				row1_left[lane] = row1[mX1[col]];
+				row1_right[lane] = row1[mX2[col]];
+				row2_left[lane] = row2[mX1[col]];
+				row2_right[lane] = row2[mX2[col]];
+				x_frac[lane] = mXFrac[col];
+			}
+			LLVector4a frac;
+			frac.load4a(x_frac);
+			LLVector4a left;
+			LLVector4a right;
+			LLVector4a row1_interp;
+			LLVector4a row2_interp;
+			left.load4a(row1_left);
+			right.load4a(row1_right);
+			right.setSub(left, right);
+			right.mul(frac);
+			row1_interp.setSub(left, right);
+			left.load4a(row2_left);
+			right.load4a(row2_right);
+			right.setSub(left, right);
+			right.mul(frac);
+			row2_interp.setSub(left, right);
+			row2_interp.setSub(row1_interp, row2_interp);
+			row2_interp.mul(y_frac);
+			row1_interp.sub(row2_interp);
+			row1_interp.store4a(composition);
+
+			// The two detail textures each falls between
+			for (lane = 0; lane < 4; lane++)
+			{
+				F32 value = composition[lane];
+				S32 tex0 = llclamp(llfloor(value), 0, 3);
+				value -= tex0;
+				S32 tex1 = llclamp(tex0 + 1, 0, 3);
+				composition[lane] = value;
+
+				const S32 col = i + llmin(lane, lanes - 1);
+				S32 st_offset = (mDetailColumn[col] + detail_row)*COMPONENTS;
+				valid[lane] = st_offset < detail_size[tex0] && st_offset < detail_size[tex1];
+				if (!valid[lane])
+				{
+					// Shouldn't happen, but has been seen to; leaves the texel be
+					st_offset = 0;
+				}
+				for (S32 k = 0; k < COMPONENTS; k++)
+				{
+					from[k][lane] = detail[tex0][st_offset + k];
+					to[k][lane] = detail[tex1][st_offset + k];
+				}
+			}
+
+			// Linearly interpolate based on composition
+			frac.load4a(composition);
+			for (S32 k = 0; k < COMPONENTS; k++)
+			{
+				LLVector4a a;
+				LLVector4a b;
+				a.load4a(from[k]);
+				b.load4a(to[k]);
+				b.sub(a);
+				b.mul(frac);
+				b.setAdd(a, b);
+				_mm_store_si128((__m128i*)blended, _mm_cvttps_epi32(b));
+				for (lane = 0; lane < lanes; lane++)
+				{
+					if (valid[lane])
+					{
+						out[(i + lane)*COMPONENTS + k] = (U8)blended[lane];
+					}
+				}
+			}
+		}
+	}
+}
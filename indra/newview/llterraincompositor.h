@@ -0,0 +1,117 @@
+/**
+ * @file llterraincompositor.h
+ * @brief Blends terrain detail textures into a region's surface texture.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTERRAINCOMPOSITOR_H
+#define LL_LLTERRAINCOMPOSITOR_H
+
+#include <vector>
+
+//
+// The texel loop of LLVLComposition::generateTexture(): each texel of a
+// rectangle of the surface texture blends the two detail textures its
+// composition value falls between.  The compositor copies the part of the
+// composition layer it reads, so the main thread can carry on generating
+// heights, and splits the rectangle into tiles of rows that LLJobScheduler's
+// workers composite four texels at a time with SSE.  Nothing here touches
+// GL; the caller uploads the output once isDone().
+//
+class LLTerrainCompositor
+{
+public:
+	enum { NUM_DETAIL_TEXTURES = 4 };
+
+	struct Params
+	{
+		// Three components each, mDetailWidth by mDetailHeight
+		const U8	*mDetail[NUM_DETAIL_TEXTURES];
+		S32			mDetailSize[NUM_DETAIL_TEXTURES];	// bytes
+		U32			mDetailWidth;
+		U32			mDetailHeight;
+
+		// The composition layer, square
+		const F32	*mComposition;
+		S32			mCompositionWidth;
+		F32			mCompositionScaleInv;
+
+		// Composition layer meters per surface texel
+		F32			mTexXRatio;
+		F32			mTexYRatio;
+		// Detail texels per surface texel
+		F32			mDetailXStride;
+		F32			mDetailYStride;
+
+		// Surface texels to composite
+		S32			mXBegin;
+		S32			mYBegin;
+		S32			mXEnd;
+		S32			mYEnd;
+
+		// Three components; has to stay valid until isDone()
+		U8			*mOutput;
+		U32			mOutputStride;	// bytes per row
+	};
+
+	LLTerrainCompositor(const Params &params);
+	// Waits for tiles the workers have started, and composites the rest
+	~LLTerrainCompositor();
+
+	// MAIN THREAD
+	// Hands the tiles to LLJobScheduler's workers if it is running, and
+	// otherwise composites them right away.
+	void start();
+	bool isDone();
+
+	// Any thread
+	void compositeRows(S32 y_begin, S32 y_end);
+
+	const Params &getParams() const { return mParams; }
+
+private:
+	class TileJob;
+
+	Params				mParams;
+
+	// The part of the composition layer read
+	std::vector<F32>	mValues;
+	S32					mValuesWidth;
+
+	// getValueScaled()'s lookups split by axis, relative to mValues
+	std::vector<S32>	mX1;
+	std::vector<S32>	mX2;
+	std::vector<F32>	mXFrac;
+	std::vector<S32>	mY1;
+	std::vector<S32>	mY2;
+	std::vector<F32>	mYFrac;
+
+	// Detail texel column of each surface column, and detail row of each
+	// surface row, stepped as generateTexture() always has
+	std::vector<S32>	mDetailColumn;
+	std::vector<S32>	mDetailRow;
+
+	std::vector<TileJob*> mJobs;
+};
+
+#endif // LL_LLTERRAINCOMPOSITOR_H
@@ -30,6 +30,7 @@
 
 #include "llapr.h"
 #include "lldir.h"
+#include "llfasthash.h"
 #include "llimage.h"
 #include "lllfsthread.h"
 #include "llviewercontrol.h"
@@ -319,6 +320,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 {
 	bool done = false;
 	S32 idx = -1;
+	U32 header_crc = 0;
 
 	S32 local_size = 0;
 	std::string local_filename;
@@ -413,6 +415,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		else
 		{
 			mImageSize = entry.mImageSize ;
+			header_crc = entry.mHeaderCRC ;
 			// If the read offset is bigger than the header cache, we read directly from the body
 			// Note that currently, we *never* read with offset from the cache, so the result is *always* HEADER
 			mState = mOffset < TEXTURE_CACHE_ENTRY_SIZE ? HEADER : BODY;
@@ -424,26 +427,42 @@ bool LLTextureCacheRemoteWorker::doRead()
 	{
 		llassert_always(idx >= 0);	// we need an entry here or reading the header makes no sense
 		llassert_always(mOffset < TEXTURE_CACHE_ENTRY_SIZE);
-		S32 offset = idx * TEXTURE_CACHE_ENTRY_SIZE + mOffset;
 		// Compute the size we need to read (in bytes)
 		S32 size = TEXTURE_CACHE_ENTRY_SIZE - mOffset;
 		size = llmin(size, mDataSize);
-		// Allocate the read buffer
-		mReadData = new U8[size];
+		// Read the whole record so that it can be checked, then keep the part asked for
+		U8* record = new U8[TEXTURE_CACHE_ENTRY_SIZE];
 		S32 bytes_read = LLAPRFile::readEx(mCache->mHeaderDataFileName, 
-											 mReadData, offset, size, mCache->getLocalAPRFilePool());
-		if (bytes_read != size)
+											 record, idx * TEXTURE_CACHE_ENTRY_SIZE, TEXTURE_CACHE_ENTRY_SIZE,
+											 mCache->getLocalAPRFilePool());
+		if (bytes_read != TEXTURE_CACHE_ENTRY_SIZE)
 		{
 			llwarns << "LLTextureCacheWorker: "  << mID
 					<< " incorrect number of bytes read from header: " << bytes_read
-					<< " / " << size << llendl;
-			delete[] mReadData;
-			mReadData = NULL;
+					<< " / " << TEXTURE_CACHE_ENTRY_SIZE << llendl;
+			delete[] record;
 			mDataSize = -1; // failed
 			done = true;
 		}
+		else if (ll_crc32c(record, TEXTURE_CACHE_ENTRY_SIZE) != header_crc)
+		{
+			// Damaged, or being rewritten right now.  Treat it as not cached
+			// so that it is fetched again, which rewrites the record.
+			llwarns << "LLTextureCacheWorker: "  << mID
+					<< " header record failed its checksum" << llendl;
+			delete[] record;
+			mDataSize = 0; // no data
+			done = true;
+		}
+		else
+		{
+			mReadData = new U8[size];
+			memcpy(mReadData, record + mOffset, size);
+			delete[] record;
+			bytes_read = size;
+		}
 		// If we already read all we expected, we're actually done
-		if (mDataSize <= bytes_read)
+		if (done || mDataSize <= bytes_read)
 		{
 			done = true;
 		}
@@ -535,6 +554,7 @@ bool LLTextureCacheRemoteWorker::doWrite()
 {
 	bool done = false;
 	S32 idx = -1;	
+	LLTextureCache::Entry entry;
 
 	// First state / stage : check that what we're trying to cache is in an OK shape
 	if (mState == INIT)
@@ -551,7 +571,6 @@ bool LLTextureCacheRemoteWorker::doWrite()
 	if (!done && (mState == CACHE))
 	{
 		bool alreadyCached = false;
-		LLTextureCache::Entry entry ;
 
 		// Checks if this image is already in the entry list
 		idx = mCache->getHeaderCacheEntry(mID, entry);
@@ -593,6 +612,7 @@ bool LLTextureCacheRemoteWorker::doWrite()
 		S32 offset = idx * TEXTURE_CACHE_ENTRY_SIZE;	// skip to the correct spot in the header file
 		S32 size = TEXTURE_CACHE_ENTRY_SIZE;			// record size is fixed for the header
 		S32 bytes_written;
+		U32 record_crc;
 
 		if (mDataSize < TEXTURE_CACHE_ENTRY_SIZE)
 		{
@@ -602,12 +622,14 @@ bool LLTextureCacheRemoteWorker::doWrite()
 			memset(padBuffer, 0, TEXTURE_CACHE_ENTRY_SIZE);		// Init with zeros
 			memcpy(padBuffer, mWriteData, mDataSize);			// Copy the write buffer
 			bytes_written = LLAPRFile::writeEx(mCache->mHeaderDataFileName, padBuffer, offset, size, mCache->getLocalAPRFilePool());
+			record_crc = ll_crc32c(padBuffer, TEXTURE_CACHE_ENTRY_SIZE);
 			delete [] padBuffer;
 		}
 		else
 		{
 			// Write the header record (== first TEXTURE_CACHE_ENTRY_SIZE bytes of the raw file) in the header file
 			bytes_written = LLAPRFile::writeEx(mCache->mHeaderDataFileName, mWriteData, offset, size, mCache->getLocalAPRFilePool());
+			record_crc = ll_crc32c(mWriteData, TEXTURE_CACHE_ENTRY_SIZE);
 		}
 
 		if (bytes_written <= 0)
@@ -617,6 +639,11 @@ bool LLTextureCacheRemoteWorker::doWrite()
 			mDataSize = -1; // failed
 			done = true;
 		}
+		else
+		{
+			// So that reads can tell a record that was torn or overwritten
+			mCache->setHeaderRecordCRC(idx, entry, record_crc);
+		}
 
 		// If we wrote everything (may be more with padding) in the header cache, 
 		// we're done so we don't have a body to store
@@ -879,7 +906,7 @@ BOOL LLTextureCache::isInLocal(const LLUUID& id)
 
 //static
 const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
-F32 LLTextureCache::sHeaderCacheVersion = 1.4f;
+F32 LLTextureCache::sHeaderCacheVersion = 1.5f;
 U32 LLTextureCache::sCacheMaxEntries = MAX_REASONABLE_FILE_SIZE / TEXTURE_CACHE_ENTRY_SIZE;
 S64 LLTextureCache::sCacheMaxTexturesSize = 0; // no limit
 const char* entries_filename = "texture.entries";
@@ -1193,6 +1220,19 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 	}
 }
 
+// Record the checksum of an entry's record in the header cache, once the
+// record has been written.
+void LLTextureCache::setHeaderRecordCRC(S32 idx, Entry& entry, U32 crc)
+{
+	lockHeaders();
+	entry.mHeaderCRC = crc;
+	if (idx >= 0 && !mReadOnly)
+	{
+		writeEntryToHeaderImmediately(idx, entry);
+	}
+	unlockHeaders();
+}
+
 //update an existing entry, write to header file immediately.
 bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
 {
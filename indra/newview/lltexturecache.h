@@ -56,17 +56,19 @@ private:
         	Entry() :
 		        mBodySize(0),
 			mImageSize(0),
-			mTime(0)
+			mTime(0),
+			mHeaderCRC(0)
 		{
 		}
 		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time) :
-			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time) {}
-		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; }
-		Entry& operator=(const Entry& entry) {mID = entry.mID, mImageSize = entry.mImageSize; mBodySize = entry.mBodySize; mTime = entry.mTime; return *this;}
+			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time), mHeaderCRC(0) {}
+		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; mHeaderCRC = 0; }
+		Entry& operator=(const Entry& entry) {mID = entry.mID, mImageSize = entry.mImageSize; mBodySize = entry.mBodySize; mTime = entry.mTime; mHeaderCRC = entry.mHeaderCRC; return *this;}
 		LLUUID mID; // 16 bytes
 		S32 mImageSize; // total size of image if known
 		S32 mBodySize; // size of body file in body cache
 		U32 mTime; // seconds since 1/1/1970
+		U32 mHeaderCRC; // ll_crc32c() of this texture's record in the header cache
 	};
 
 	
@@ -158,6 +160,7 @@ private:
 	S32 openAndReadEntry(const LLUUID& id, Entry& entry, bool create);
 	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_body_size);
 	void updateEntryTimeStamp(S32 idx, Entry& entry) ;
+	void setHeaderRecordCRC(S32 idx, Entry& entry, U32 crc);
 	U32 openAndReadEntries(std::vector<Entry>& entries);
 	void writeEntriesAndClose(const std::vector<Entry>& entries);
 	void readEntryFromHeaderImmediately(S32& idx, Entry& entry) ;
@@ -1756,7 +1756,7 @@ bool LLTextureFetchWorker::writeToCacheComplete()
 // public
 
 LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded, bool qa_mode)
-	: LLWorkerThread("TextureFetch", threaded),
+	: LLWorkerThread("TextureFetch", threaded, false), // needs its own thread for threadedUpdate()
 	  mDebugCount(0),
 	  mDebugPause(FALSE),
 	  mPacketCount(0),
@@ -2664,8 +2664,10 @@ S32 LLTextureFetch::getFetchState(const LLUUID& id, F32& data_progress_p, F32& r
 void LLTextureFetch::dump()
 {
 	llinfos << "LLTextureFetch REQUESTS:" << llendl;
-	for (request_queue_t::iterator iter = mRequestQueue.begin();
-		 iter != mRequestQueue.end(); ++iter)
+	std::vector<LLQueuedThread::QueuedRequest*> requests;
+	mRequestQueue.getEntries(requests);
+	for (std::vector<LLQueuedThread::QueuedRequest*>::iterator iter = requests.begin();
+		 iter != requests.end(); ++iter)
 	{
 		LLQueuedThread::QueuedRequest* qreq = *iter;
 		LLWorkerThread::WorkRequest* wreq = (LLWorkerThread::WorkRequest*)qreq;
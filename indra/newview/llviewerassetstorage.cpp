@@ -355,7 +355,7 @@ void LLViewerAssetStorage::_queueDataRequest(
 			req->mMetricsStartTime = LLViewerAssetStatsFF::get_timestamp();
 		}
 		
-		mPendingDownloads.push_back(req);
+		addPendingRequest(RT_DOWNLOAD, req);
 	
 		if (!duplicate)
 		{
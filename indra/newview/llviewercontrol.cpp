@@ -240,6 +240,12 @@ static bool handleTerrainLODChanged(const LLSD& newvalue)
 		return true;
 }
 
+static bool handleTerrainGeomorphChanged(const LLSD& newvalue)
+{
+	LLVOSurfacePatch::sGeomorphFactor = (F32)newvalue.asReal();
+	return true;
+}
+
 static bool handleTreeLODChanged(const LLSD& newvalue)
 {
 	LLVOTree::sTreeFactor = (F32) newvalue.asReal();
@@ -601,6 +607,7 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("RenderAvatarLODFactor")->getSignal()->connect(boost::bind(&handleAvatarLODChanged, _2));
 	gSavedSettings.getControl("RenderAvatarPhysicsLODFactor")->getSignal()->connect(boost::bind(&handleAvatarPhysicsLODChanged, _2));
 	gSavedSettings.getControl("RenderTerrainLODFactor")->getSignal()->connect(boost::bind(&handleTerrainLODChanged, _2));
+	gSavedSettings.getControl("RenderTerrainGeomorph")->getSignal()->connect(boost::bind(&handleTerrainGeomorphChanged, _2));
 	gSavedSettings.getControl("RenderTreeLODFactor")->getSignal()->connect(boost::bind(&handleTreeLODChanged, _2));
 	gSavedSettings.getControl("RenderFlexTimeFactor")->getSignal()->connect(boost::bind(&handleFlexLODChanged, _2));
 	gSavedSettings.getControl("RenderGamma")->getSignal()->connect(boost::bind(&handleGammaChanged, _2));
@@ -32,6 +32,7 @@
 #include "llfloaterreg.h"
 #include "llcombobox.h"
 #include "llinventorypanel.h"
+#include "llmemtag.h"
 #include "llnotifications.h"
 #include "llnotificationsutil.h"
 
@@ -7133,6 +7134,22 @@ void handle_dump_timers()
 	LLFastTimer::dumpCurTimes();
 }
 
+void handle_start_timer_trace()
+{
+	LLFastTimer::startTrace();
+}
+
+void handle_dump_timer_trace()
+{
+	LLFastTimer::writeTrace(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "timer_trace.json"));
+	LLFastTimer::stopTrace();
+}
+
+void handle_dump_memory_tags()
+{
+	LLMemTag::dumpToFile(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "memory_tags.csv"));
+}
+
 void handle_debug_avatar_textures(void*)
 {
 	LLViewerObject* objectp = LLSelectMgr::getInstance()->getSelection()->getPrimaryObject();
@@ -8166,6 +8183,9 @@ void initialize_menus()
 	view_listener_t::addMenu(new LLAdvancedDumpSelectMgr(), "Advanced.DumpSelectMgr");
 	view_listener_t::addMenu(new LLAdvancedDumpInventory(), "Advanced.DumpInventory");
 	commit.add("Advanced.DumpTimers", boost::bind(&handle_dump_timers) );
+	commit.add("Advanced.StartTimerTrace", boost::bind(&handle_start_timer_trace) );
+	commit.add("Advanced.DumpTimerTrace", boost::bind(&handle_dump_timer_trace) );
+	commit.add("Advanced.DumpMemoryTags", boost::bind(&handle_dump_memory_tags) );
 	commit.add("Advanced.DumpFocusHolder", boost::bind(&handle_dump_focus) );
 	view_listener_t::addMenu(new LLAdvancedPrintSelectedObjectInfo(), "Advanced.PrintSelectedObjectInfo");
 	view_listener_t::addMenu(new LLAdvancedPrintAgentInfo(), "Advanced.PrintAgentInfo");
@@ -110,6 +110,7 @@ BOOL		LLViewerObject::sPingInterpolate = TRUE;
 
 U32			LLViewerObject::sNumZombieObjects = 0;
 S32			LLViewerObject::sNumObjects = 0;
+LLMemTag	LLViewerObject::sMemTag("ViewerObject");
 BOOL		LLViewerObject::sMapDebug = TRUE;
 LLColor4	LLViewerObject::sEditSelectColor(	1.0f, 1.f, 0.f, 0.3f);	// Edit OK
 LLColor4	LLViewerObject::sNoEditSelectColor(	1.0f, 0.f, 0.f, 0.3f);	// Can't edit
@@ -229,6 +230,7 @@ LLViewerObject::LLViewerObject(const LLUUID &id, const LLPCode pcode, LLViewerRe
 	mOrphaned(FALSE),
 	mUserSelected(FALSE),
 	mOnActiveList(FALSE),
+	mMotionHandle(-1),
 	mOnMap(FALSE),
 	mStatic(FALSE),
 	mNumFaces(0),
@@ -270,6 +272,12 @@ LLViewerObject::LLViewerObject(const LLUUID &id, const LLPCode pcode, LLViewerRe
 
 LLViewerObject::~LLViewerObject()
 {
+	if (mMotionHandle >= 0)
+	{
+		gObjectList.getMotionStore().remove(mMotionHandle);
+		mMotionHandle = -1;
+	}
+
 	deleteTEImages();
 
 	if(mInventory)
@@ -2189,27 +2197,44 @@ void LLViewerObject::interpolateLinearMotion(const F64 & time, const F32 & dt)
 
 	LLVector3 accel = getAcceleration();
 	LLVector3 vel 	= getVelocity();
+
+	// Predicted displacement and change in velocity, from the motion store
+	// if it has already worked them out this frame
+	BOOL moving;
+	LLVector3 displacement;
+	LLVector3 delta_v;
+	const LLObjectMotionStore& motion = gObjectList.getMotionStore();
+	if (mMotionHandle >= 0 && motion.isPredicted(mMotionHandle, dt, vel, accel))
+	{
+		moving = motion.isMoving(mMotionHandle);
+		displacement = motion.getDisplacement(mMotionHandle);
+		delta_v = motion.getDeltaVelocity(mMotionHandle);
+	}
+	else
+	{
+		moving = !(accel.isExactlyZero() && vel.isExactlyZero());
+		displacement = (vel + (0.5f * (dt-PHYSICS_TIMESTEP)) * accel) * dt;
+		delta_v = accel * dt;
+	}
 	
 	if (sMaxUpdateInterpolationTime <= 0.0)
 	{	// Old code path ... unbounded, simple interpolation
-		if (!(accel.isExactlyZero() && vel.isExactlyZero()))
+		if (moving)
 		{
-			LLVector3 pos   = (vel + (0.5f * (dt-PHYSICS_TIMESTEP)) * accel) * dt;  
-		
 			// region local  
-			setPositionRegion(pos + getPositionRegion());
-			setVelocity(vel + accel*dt);	
+			setPositionRegion(displacement + getPositionRegion());
+			setVelocity(vel + delta_v);	
 			
 			// for objects that are spinning but not translating, make sure to flag them as having moved
 			setChanged(MOVED | SILHOUETTE);
 		}
 	}
-	else if (!accel.isExactlyZero() || !vel.isExactlyZero())		// object is moving
+	else if (moving)		// object is moving
 	{	// Object is moving, and hasn't been too long since we got an update from the server
 		
 		// Calculate predicted position and velocity
-		LLVector3 new_pos = (vel + (0.5f * (dt-PHYSICS_TIMESTEP)) * accel) * dt;	
-		LLVector3 new_v = accel * dt;
+		LLVector3 new_pos = displacement;
+		LLVector3 new_v = delta_v;
 
 		if (time_since_last_update > sPhaseOutUpdateInterpolationTime &&
 			sPhaseOutUpdateInterpolationTime > 0.0)
@@ -5370,14 +5395,29 @@ void LLViewerObject::applyAngularVelocity(F32 dt)
 	//do target omega here
 	mRotTime += dt;
 	LLVector3 ang_vel = getAngularVelocity();
-	F32 omega = ang_vel.magVecSquared();
+	F32 omega;
 	F32 angle = 0.0f;
+	BOOL spinning;
+	const LLObjectMotionStore& motion = gObjectList.getMotionStore();
+	if (mMotionHandle >= 0 && motion.isPredicted(mMotionHandle, dt, ang_vel))
+	{
+		spinning = motion.isSpinning(mMotionHandle);
+		omega = motion.getAngularSpeed(mMotionHandle);
+		angle = motion.getSpinAngle(mMotionHandle);
+	}
+	else
+	{
+		omega = ang_vel.magVecSquared();
+		spinning = omega > 0.00001f;
+		if (spinning)
+		{
+			omega = sqrt(omega);
+			angle = omega * dt;
+		}
+	}
 	LLQuaternion dQ;
-	if (omega > 0.00001f)
+	if (spinning)
 	{
-		omega = sqrt(omega);
-		angle = omega * dt;
-
 		ang_vel *= 1.f/omega;
 		
 		dQ.setQuat(angle, ang_vel);
@@ -5387,6 +5427,34 @@ void LLViewerObject::applyAngularVelocity(F32 dt)
 	}
 }
 
+void LLViewerObject::setOnActiveList(BOOL on_active)
+{
+	mOnActiveList = on_active;
+
+	LLObjectMotionStore& motion = gObjectList.getMotionStore();
+	if (on_active && mMotionHandle < 0)
+	{
+		motion.add(&mMotionHandle);
+	}
+	else if (!on_active && mMotionHandle >= 0)
+	{
+		motion.remove(mMotionHandle);
+		mMotionHandle = -1;
+	}
+}
+
+void LLViewerObject::storeMotion(LLObjectMotionStore& motion) const
+{
+	if (mMotionHandle >= 0)
+	{
+		motion.setVelocity(mMotionHandle, getVelocity());
+		motion.setAcceleration(mMotionHandle, getAcceleration());
+		motion.setAngularVelocity(mMotionHandle, getAngularVelocity());
+		motion.setTimeDilation(mMotionHandle, mTimeDilation);
+		motion.setLastInterpUpdateSecs(mMotionHandle, mLastInterpUpdateSecs);
+	}
+}
+
 void LLViewerObject::resetRot()
 {
 	mRotTime = 0.0f;
@@ -34,6 +34,7 @@
 #include "llhudicon.h"
 #include "llinventory.h"
 #include "llrefcount.h"
+#include "llmemtag.h"
 #include "llmemtype.h"
 #include "llprimitive.h"
 #include "lluuid.h"
@@ -59,6 +60,7 @@ class LLWorld;
 class LLNameValue;
 class LLNetMap;
 class LLMessageSystem;
+class LLObjectMotionStore;
 class LLPartSysData;
 class LLPrimitive;
 class LLPipeline;
@@ -133,6 +135,11 @@ public:
 
 	typedef const child_list_t const_child_list_t;
 
+	// Objects of every derived type are counted under the "ViewerObject"
+	// memory tag.  Sized delete, so the destructor must stay virtual.
+	static void* operator new(size_t size)				{ return LLMemTag::allocate(sMemTag, size); }
+	static void operator delete(void* ptr, size_t size)	{ LLMemTag::deallocate(sMemTag, ptr, size); }
+
 	LLViewerObject(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp, BOOL is_global = FALSE);
 	MEM_TYPE_NEW(LLMemType::MTYPE_OBJECT);
 
@@ -174,7 +181,9 @@ public:
 
 	virtual BOOL    isActive() const; // Whether this object needs to do an idleUpdate.
 	BOOL			onActiveList() const				{return mOnActiveList;}
-	void			setOnActiveList(BOOL on_active)		{ mOnActiveList = on_active; }
+	void			setOnActiveList(BOOL on_active);
+	// Copies the motion dead reckoned by the object list into its store entry
+	void			storeMotion(LLObjectMotionStore& motion) const;
 
 	virtual BOOL	isAttachment() const { return FALSE; }
 	virtual LLVOAvatar* getAvatar() const;  //get the avatar this object is attached to, or NULL if object is not an attachment
@@ -693,6 +702,7 @@ protected:
 	BOOL			mOrphaned;					// This is an orphaned child
 	BOOL			mUserSelected;				// Cached user select information
 	BOOL			mOnActiveList;
+	S32				mMotionHandle;				// Entry in the motion store while on the active list, or -1
 	BOOL			mOnMap;						// On the map.
 	BOOL			mStatic;					// Object doesn't move.
 	S32				mNumFaces;
@@ -737,6 +747,7 @@ protected:
 
 private:	
 	static S32 sNumObjects;
+	static LLMemTag sMemTag;
 
 	static F64 sPhaseOutUpdateInterpolationTime;	// For motion interpolation
 	static F64 sMaxUpdateInterpolationTime;			// For motion interpolation
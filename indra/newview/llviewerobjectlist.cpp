@@ -64,6 +64,8 @@
 #include "u64.h"
 #include "llviewertexturelist.h"
 #include "lldatapacker.h"
+#include "lleventcoro.h"
+#include "llhttprequestgroup.h"
 #ifdef LL_STANDALONE
 #include <zlib.h>
 #else
@@ -82,6 +84,9 @@ void dialog_refresh_all();
 //#define ORPHAN_SPAM
 //#define IGNORE_DEAD
 
+// Largest ObjectUpdateCompressed block data, once inflated
+const S32 MAX_OBJECT_UPDATE_SIZE = 2048;
+
 // Global lists of objects - should go away soon.
 LLViewerObjectList gObjectList;
 
@@ -105,6 +110,10 @@ LLViewerObjectList::LLViewerObjectList()
 	mNumDeadObjectUpdates = 0;
 	mNumUnknownKills = 0;
 	mNumUnknownUpdates = 0;
+	mObjectPropertiesFetching = false;
+	mUpdateDecoder = NULL;
+	mCurrentDecoded = NULL;
+	mCurrentDecodedDP = NULL;
 }
 
 LLViewerObjectList::~LLViewerObjectList()
@@ -117,10 +126,13 @@ void LLViewerObjectList::destroy()
 	killAllObjects();
 
 	resetObjectBeacons();
-	mActiveObjects.clear();
+	clearActiveObjects();
 	mDeadObjects.clear();
 	mMapObjects.clear();
 	mUUIDObjectMap.clear();
+
+	delete mUpdateDecoder;
+	mUpdateDecoder = NULL;
 }
 
 
@@ -339,18 +351,63 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		return;
 	}
 
-	U8 compressed_dpbuffer[2048];
-	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
 	LLDataPacker *cached_dpp = NULL;
 
-
-	for (i = 0; i < num_objects; i++)
+	// Get every block's data, then decode full updates all at once on the
+	// job scheduler's workers.  What's left for the loop below is finding and
+	// creating the objects, and applying the updates to them.
+	const bool decode = cached || (compressed && update_type != OUT_TERSE_IMPROVED);
+	if (decode)
 	{
-		// timer is unused?
-		LLTimer update_timer;
-		BOOL justCreated = FALSE;
+		if (!mUpdateDecoder)
+		{
+			mUpdateDecoder = new LLObjectUpdateDecoder();
+		}
+		static LLCachedControl<std::string> capture_file(gSavedSettings, "ObjectUpdateCaptureFile");
+		mUpdateDecoder->setCaptureFile(capture_file);
+	}
+	if (compressed || cached)
+	{
+		mDecodedUpdates.assign(num_objects, LLDecodedObjectUpdate());
+	}
+	if (compressed)
+	{
+		mUpdateData.resize(num_objects * MAX_OBJECT_UPDATE_SIZE);
+		for (i = 0; i < num_objects; i++)
+		{
+			U8* data = &mUpdateData[i * MAX_OBJECT_UPDATE_SIZE];
+			S32 uncompressed_length = MAX_OBJECT_UPDATE_SIZE;
 
-		if (cached)
+			U32 flags = 0;
+			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
+			{
+				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
+			}
+			
+			// I don't think we ever use this flag from the server.  DK 2010/12/09
+			if (flags & FLAGS_ZLIB_COMPRESSED)
+			{
+				//llinfos << "TEST: flags & FLAGS_ZLIB_COMPRESSED" << llendl;
+				U8 compbuffer[MAX_OBJECT_UPDATE_SIZE];
+				S32 compressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
+				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compbuffer, 0, i);
+				uncompress(data, (unsigned long *)&uncompressed_length,
+						   compbuffer, compressed_length);
+			}
+			else
+			{
+				uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
+				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, data, 0, i);
+			}
+
+			mDecodedUpdates[i].mData = data;
+			mDecodedUpdates[i].mDataSize = uncompressed_length;
+		}
+	}
+	else if (cached)
+	{
+		mCachedDPs.assign(num_objects, (LLDataPackerBinaryBuffer*)NULL);
+		for (i = 0; i < num_objects; i++)
 		{
 			U32 id;
 			U32 crc;
@@ -359,7 +416,31 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		
 			// Lookup data packer and add this id to cache miss lists if necessary.
 			U8 cache_miss_type = LLViewerRegion::CACHE_MISS_TYPE_NONE;
-			cached_dpp = regionp->getDP(id, crc, cache_miss_type);
+			mCachedDPs[i] = regionp->getDP(id, crc, cache_miss_type);
+			if (mCachedDPs[i])
+			{
+				mDecodedUpdates[i].mData = mCachedDPs[i]->getBuffer();
+				mDecodedUpdates[i].mDataSize = mCachedDPs[i]->getBufferSize();
+			}
+		}
+	}
+	if (decode)
+	{
+		mUpdateDecoder->decode(mDecodedUpdates);
+	}
+
+
+	for (i = 0; i < num_objects; i++)
+	{
+		// timer is unused?
+		LLTimer update_timer;
+		BOOL justCreated = FALSE;
+
+		LLDataPackerBinaryBuffer compressed_dp;
+
+		if (cached)
+		{
+			cached_dpp = mCachedDPs[i];
 			if (cached_dpp)
 			{
 				// Cache Hit.
@@ -377,34 +458,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		}
 		else if (compressed)
 		{
-			U8							compbuffer[2048];
-			S32							uncompressed_length = 2048;
-			S32							compressed_length;
-			compressed_dp.reset();
-
-			U32 flags = 0;
-			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
-			{
-				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
-			}
-			
-			// I don't think we ever use this flag from the server.  DK 2010/12/09
-			if (flags & FLAGS_ZLIB_COMPRESSED)
-			{
-				//llinfos << "TEST: flags & FLAGS_ZLIB_COMPRESSED" << llendl;
-				compressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compbuffer, 0, i);
-				uncompressed_length = 2048;
-				uncompress(compressed_dpbuffer, (unsigned long *)&uncompressed_length,
-						   compbuffer, compressed_length);
-				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
-			}
-			else
-			{
-				uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compressed_dpbuffer, 0, i);
-				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
-			}
+			compressed_dp.assignBuffer(&mUpdateData[i * MAX_OBJECT_UPDATE_SIZE], mDecodedUpdates[i].mDataSize);
 
 
 			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
@@ -535,8 +589,12 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
 			{
 				objectp->mLocalID = local_id;
+				mCurrentDecoded = &mDecodedUpdates[i];
+				mCurrentDecodedDP = &compressed_dp;
 			}
 			processUpdateCore(objectp, user_data, i, update_type, &compressed_dp, justCreated);
+			mCurrentDecoded = NULL;
+			mCurrentDecodedDP = NULL;
 			if (update_type != OUT_TERSE_IMPROVED) // OUT_FULL_COMPRESSED only?
 			{
 				bCached = true;
@@ -546,7 +604,11 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		else if (cached) // Cache hit only?
 		{
 			objectp->mLocalID = local_id;
+			mCurrentDecoded = &mDecodedUpdates[i];
+			mCurrentDecodedDP = mCachedDPs[i];
 			processUpdateCore(objectp, user_data, i, update_type, cached_dpp, justCreated);
+			mCurrentDecoded = NULL;
+			mCurrentDecodedDP = NULL;
 		}
 		else
 		{
@@ -564,6 +626,30 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 	LLVOAvatar::cullAvatarsByPixelArea();
 }
 
+const LLVolumeParams* LLViewerObjectList::takeDecodedVolumeParams(LLDataPacker* dp)
+{
+	if (!mCurrentDecoded || dp != mCurrentDecodedDP ||
+		!mCurrentDecoded->mValid || !mCurrentDecoded->mHasVolume ||
+		mCurrentDecodedDP->getCurrentSize() != mCurrentDecoded->mVolumeOffset)
+	{
+		return NULL;
+	}
+	mCurrentDecodedDP->setCurrentSize(mCurrentDecoded->mTEOffset);
+	return &mCurrentDecoded->mVolumeParams;
+}
+
+const LLTEContents* LLViewerObjectList::takeDecodedTEs(LLDataPacker* dp)
+{
+	if (!mCurrentDecoded || dp != mCurrentDecodedDP ||
+		!mCurrentDecoded->mValid || !mCurrentDecoded->mHasVolume ||
+		mCurrentDecodedDP->getCurrentSize() != mCurrentDecoded->mTEOffset)
+	{
+		return NULL;
+	}
+	mCurrentDecodedDP->setCurrentSize(mCurrentDecoded->mTEEnd);
+	return &mCurrentDecoded->mTEContents;
+}
+
 void LLViewerObjectList::processCompressedObjectUpdate(LLMessageSystem *mesgsys,
 											 void **user_data,
 											 const EObjectUpdateType update_type)
@@ -662,189 +748,199 @@ void LLViewerObjectList::updateApparentAngles(LLAgent &agent)
 	LLVOAvatar::cullAvatarsByPixelArea();
 }
 
-class LLObjectCostResponder : public LLCurl::Responder
-{
-public:
-	LLObjectCostResponder(const LLSD& object_ids)
-		: mObjectIDs(object_ids)
-	{
-	}
+// Object costs and physics flags are requested in batches of up to this many
+const S32 MAX_OBJECT_PROPERTIES_BATCH = 128;
+// Frames to gather stale objects for before requesting their properties
+const S32 OBJECT_PROPERTIES_GATHER_FRAMES = 4;
 
-	// Clear's the global object list's pending
-	// request list for all objects requested
-	void clear_object_list_pending_requests()
+// Reports failure for all of object_ids to the global object list
+static void clear_object_cost_pending_requests(const LLSD& object_ids)
+{
+	for (
+		LLSD::array_const_iterator iter = object_ids.beginArray();
+		iter != object_ids.endArray();
+		++iter)
 	{
-		// TODO*: No more hard coding
-		for (
-			LLSD::array_iterator iter = mObjectIDs.beginArray();
-			iter != mObjectIDs.endArray();
-			++iter)
-		{
-			gObjectList.onObjectCostFetchFailure(iter->asUUID());
-		}
+		gObjectList.onObjectCostFetchFailure(iter->asUUID());
 	}
+}
 
-	void error(U32 statusNum, const std::string& reason)
+static void handle_object_cost_reply(const LLSD& object_ids, const LLHTTPRequestGroup& requests, S32 index)
+{
+	if (!requests.succeeded(index))
 	{
 		llwarns
 			<< "Transport error requesting object cost "
-			<< "HTTP status: " << statusNum << ", reason: "
-			<< reason << "." << llendl;
+			<< "HTTP status: " << requests.getStatus(index) << ", reason: "
+			<< requests.getReason(index) << "." << llendl;
 
 		// TODO*: Error message to user
 		// For now just clear the request from the pending list
-		clear_object_list_pending_requests();
+		clear_object_cost_pending_requests(object_ids);
+		return;
 	}
 
-	void result(const LLSD& content)
+	const LLSD& content = requests.getContent(index);
+	if ( !content.isMap() || content.has("error") )
 	{
-		if ( !content.isMap() || content.has("error") )
-		{
-			// Improper response or the request had an error,
-			// show an error to the user?
-			llwarns
-				<< "Application level error when fetching object "
-				<< "cost.  Message: " << content["error"]["message"].asString()
-				<< ", identifier: " << content["error"]["identifier"].asString()
-				<< llendl;
+		// Improper response or the request had an error,
+		// show an error to the user?
+		llwarns
+			<< "Application level error when fetching object "
+			<< "cost.  Message: " << content["error"]["message"].asString()
+			<< ", identifier: " << content["error"]["identifier"].asString()
+			<< llendl;
 
-			// TODO*: Adaptively adjust request size if the
-			// service says we've requested too many and retry
+		// TODO*: Adaptively adjust request size if the
+		// service says we've requested too many and retry
 
-			// TODO*: Error message if not retrying
-			clear_object_list_pending_requests();
-			return;
-		}
+		// TODO*: Error message if not retrying
+		clear_object_cost_pending_requests(object_ids);
+		return;
+	}
+
+	// Success, grab the resource cost and linked set costs
+	// for an object if one was returned
+	for (
+		LLSD::array_const_iterator iter = object_ids.beginArray();
+		iter != object_ids.endArray();
+		++iter)
+	{
+		LLUUID object_id = iter->asUUID();
 
-		// Success, grab the resource cost and linked set costs
-		// for an object if one was returned
-		for (
-			LLSD::array_iterator iter = mObjectIDs.beginArray();
-			iter != mObjectIDs.endArray();
-			++iter)
+		// Check to see if the request contains data for the object
+		if ( content.has(iter->asString()) )
 		{
-			LLUUID object_id = iter->asUUID();
+			const LLSD& data = content[iter->asString()];
 
-			// Check to see if the request contains data for the object
-			if ( content.has(iter->asString()) )
-			{
-				F32 link_cost =
-					content[iter->asString()]["linked_set_resource_cost"].asReal();
-				F32 object_cost =
-					content[iter->asString()]["resource_cost"].asReal();
+			F32 link_cost = data["linked_set_resource_cost"].asReal();
+			F32 object_cost = data["resource_cost"].asReal();
 
-				F32 physics_cost = content[iter->asString()]["physics_cost"].asReal();
-				F32 link_physics_cost = content[iter->asString()]["linked_set_physics_cost"].asReal();
+			F32 physics_cost = data["physics_cost"].asReal();
+			F32 link_physics_cost = data["linked_set_physics_cost"].asReal();
 
-				gObjectList.updateObjectCost(object_id, object_cost, link_cost, physics_cost, link_physics_cost);
-			}
-			else
-			{
-				// TODO*: Give user feedback about the missing data?
-				gObjectList.onObjectCostFetchFailure(object_id);
-			}
+			gObjectList.updateObjectCost(object_id, object_cost, link_cost, physics_cost, link_physics_cost);
+		}
+		else
+		{
+			// TODO*: Give user feedback about the missing data?
+			gObjectList.onObjectCostFetchFailure(object_id);
 		}
 	}
+}
 
-private:
-	LLSD mObjectIDs;
-};
-
-
-class LLPhysicsFlagsResponder : public LLCurl::Responder
+// Reports failure for all of object_ids to the global object list
+static void clear_physics_flags_pending_requests(const LLSD& object_ids)
 {
-public:
-	LLPhysicsFlagsResponder(const LLSD& object_ids)
-		: mObjectIDs(object_ids)
+	for (
+		LLSD::array_const_iterator iter = object_ids.beginArray();
+		iter != object_ids.endArray();
+		++iter)
 	{
+		gObjectList.onPhysicsFlagsFetchFailure(iter->asUUID());
 	}
+}
 
-	// Clear's the global object list's pending
-	// request list for all objects requested
-	void clear_object_list_pending_requests()
-	{
-		// TODO*: No more hard coding
-		for (
-			LLSD::array_iterator iter = mObjectIDs.beginArray();
-			iter != mObjectIDs.endArray();
-			++iter)
-		{
-			gObjectList.onPhysicsFlagsFetchFailure(iter->asUUID());
-		}
-	}
-
-	void error(U32 statusNum, const std::string& reason)
+static void handle_physics_flags_reply(const LLSD& object_ids, const LLHTTPRequestGroup& requests, S32 index)
+{
+	if (!requests.succeeded(index))
 	{
 		llwarns
 			<< "Transport error requesting object physics flags "
-			<< "HTTP status: " << statusNum << ", reason: "
-			<< reason << "." << llendl;
+			<< "HTTP status: " << requests.getStatus(index) << ", reason: "
+			<< requests.getReason(index) << "." << llendl;
 
 		// TODO*: Error message to user
 		// For now just clear the request from the pending list
-		clear_object_list_pending_requests();
+		clear_physics_flags_pending_requests(object_ids);
+		return;
 	}
 
-	void result(const LLSD& content)
+	const LLSD& content = requests.getContent(index);
+	if ( !content.isMap() || content.has("error") )
 	{
-		if ( !content.isMap() || content.has("error") )
-		{
-			// Improper response or the request had an error,
-			// show an error to the user?
-			llwarns
-				<< "Application level error when fetching object "
-				<< "physics flags.  Message: " << content["error"]["message"].asString()
-				<< ", identifier: " << content["error"]["identifier"].asString()
-				<< llendl;
+		// Improper response or the request had an error,
+		// show an error to the user?
+		llwarns
+			<< "Application level error when fetching object "
+			<< "physics flags.  Message: " << content["error"]["message"].asString()
+			<< ", identifier: " << content["error"]["identifier"].asString()
+			<< llendl;
 
-			// TODO*: Adaptively adjust request size if the
-			// service says we've requested too many and retry
+		// TODO*: Adaptively adjust request size if the
+		// service says we've requested too many and retry
 
-			// TODO*: Error message if not retrying
-			clear_object_list_pending_requests();
-			return;
-		}
+		// TODO*: Error message if not retrying
+		clear_physics_flags_pending_requests(object_ids);
+		return;
+	}
 
-		// Success, grab the resource cost and linked set costs
-		// for an object if one was returned
-		for (
-			LLSD::array_iterator iter = mObjectIDs.beginArray();
-			iter != mObjectIDs.endArray();
-			++iter)
-		{
-			LLUUID object_id = iter->asUUID();
+	// Success, grab the physics shape type and properties
+	// for an object if one was returned
+	for (
+		LLSD::array_const_iterator iter = object_ids.beginArray();
+		iter != object_ids.endArray();
+		++iter)
+	{
+		LLUUID object_id = iter->asUUID();
 
-			// Check to see if the request contains data for the object
-			if ( content.has(iter->asString()) )
-			{
-				const LLSD& data = content[iter->asString()];
+		// Check to see if the request contains data for the object
+		if ( content.has(iter->asString()) )
+		{
+			const LLSD& data = content[iter->asString()];
 
-				S32 shape_type = data["PhysicsShapeType"].asInteger();
+			S32 shape_type = data["PhysicsShapeType"].asInteger();
 
-				gObjectList.updatePhysicsShapeType(object_id, shape_type);
+			gObjectList.updatePhysicsShapeType(object_id, shape_type);
 
-				if (data.has("Density"))
-				{
-					F32 density = data["Density"].asReal();
-					F32 friction = data["Friction"].asReal();
-					F32 restitution = data["Restitution"].asReal();
-					F32 gravity_multiplier = data["GravityMultiplier"].asReal();
-					
-					gObjectList.updatePhysicsProperties(object_id, 
-						density, friction, restitution, gravity_multiplier);
-				}
-			}
-			else
+			if (data.has("Density"))
 			{
-				// TODO*: Give user feedback about the missing data?
-				gObjectList.onPhysicsFlagsFetchFailure(object_id);
+				F32 density = data["Density"].asReal();
+				F32 friction = data["Friction"].asReal();
+				F32 restitution = data["Restitution"].asReal();
+				F32 gravity_multiplier = data["GravityMultiplier"].asReal();
+				
+				gObjectList.updatePhysicsProperties(object_id, 
+					density, friction, restitution, gravity_multiplier);
 			}
 		}
+		else
+		{
+			// TODO*: Give user feedback about the missing data?
+			gObjectList.onPhysicsFlagsFetchFailure(object_id);
+		}
 	}
+}
 
-private:
-	LLSD mObjectIDs;
-};
+// Moves the stale ids that don't already have a request out to pending,
+// and appends them to batches as LLSD arrays of at most
+// MAX_OBJECT_PROPERTIES_BATCH ids.
+static void take_stale_object_ids(std::set<LLUUID>& stale, std::set<LLUUID>& pending, std::vector<LLSD>& batches)
+{
+	LLSD id_list;
+	for (
+		std::set<LLUUID>::iterator iter = stale.begin();
+		iter != stale.end();
+		++iter)
+	{
+		// Check to see if a request for this object
+		// has already been made.
+		if (pending.insert(*iter).second)
+		{
+			id_list.append(*iter);
+			if (id_list.size() == MAX_OBJECT_PROPERTIES_BATCH)
+			{
+				batches.push_back(id_list);
+				id_list = LLSD();
+			}
+		}
+	}
+	if (id_list.size() > 0)
+	{
+		batches.push_back(id_list);
+	}
+	stale.clear();
+}
 
 void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 {
@@ -935,6 +1031,18 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	}
 	else
 	{
+		// Dead reckon all of them at once for their idleUpdate()s to pick up
+		static LLFastTimer::DeclareTimer ftm_predict("Predict Motion");
+		{
+			LLFastTimer t(ftm_predict);
+			for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
+				idle_iter != idle_list.end(); idle_iter++)
+			{
+				(*idle_iter)->storeMotion(mMotionStore);
+			}
+			mMotionStore.predict(frame_time);
+		}
+
 		for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
 			idle_iter != idle_list.end(); idle_iter++)
 		{
@@ -1030,54 +1138,7 @@ void LLViewerObjectList::fetchObjectCosts()
 	// issue http request for stale object physics costs
 	if (!mStaleObjectCost.empty())
 	{
-		LLViewerRegion* regionp = gAgent.getRegion();
-
-		if (regionp)
-		{
-			std::string url = regionp->getCapability("GetObjectCost");
-
-			if (!url.empty())
-			{
-				LLSD id_list;
-				U32 object_index = 0;
-
-				for (
-					std::set<LLUUID>::iterator iter = mStaleObjectCost.begin();
-					iter != mStaleObjectCost.end();
-					++iter)
-				{
-					// Check to see if a request for this object
-					// has already been made.
-					if ( mPendingObjectCost.find(*iter) ==
-						 mPendingObjectCost.end() )
-					{
-						mPendingObjectCost.insert(*iter);
-						id_list[object_index++] = *iter;
-					}
-				}
-
-				// id_list should now contain all
-				// requests in mStaleObjectCost before, so clear
-				// it now
-				mStaleObjectCost.clear();
-
-				if ( id_list.size() > 0 )
-				{
-					LLSD post_data = LLSD::emptyMap();
-
-					post_data["object_ids"] = id_list;
-					LLHTTPClient::post(
-						url,
-						post_data,
-						new LLObjectCostResponder(id_list));
-				}
-			}
-			else
-			{
-				mStaleObjectCost.clear();
-				mPendingObjectCost.clear();
-			}
-		}
+		startObjectPropertiesFetch();
 	}
 }
 
@@ -1086,55 +1147,108 @@ void LLViewerObjectList::fetchPhysicsFlags()
 	// issue http request for stale object physics flags
 	if (!mStalePhysicsFlags.empty())
 	{
-		LLViewerRegion* regionp = gAgent.getRegion();
-
-		if (regionp)
-		{
-			std::string url = regionp->getCapability("GetObjectPhysicsData");
-
-			if (!url.empty())
-			{
-				LLSD id_list;
-				U32 object_index = 0;
-
-				for (
-					std::set<LLUUID>::iterator iter = mStalePhysicsFlags.begin();
-					iter != mStalePhysicsFlags.end();
-					++iter)
-				{
-					// Check to see if a request for this object
-					// has already been made.
-					if ( mPendingPhysicsFlags.find(*iter) ==
-						 mPendingPhysicsFlags.end() )
-					{
-						mPendingPhysicsFlags.insert(*iter);
-						id_list[object_index++] = *iter;
-					}
-				}
+		startObjectPropertiesFetch();
+	}
+}
 
-				// id_list should now contain all
-				// requests in mStalePhysicsFlags before, so clear
-				// it now
-				mStalePhysicsFlags.clear();
+void LLViewerObjectList::startObjectPropertiesFetch()
+{
+	// A running fetch picks up objects that go stale while it waits
+	if (!mObjectPropertiesFetching)
+	{
+		mObjectPropertiesFetching = true;
+		LLCoros::instance().launch("LLViewerObjectList::objectPropertiesCoro",
+								   boost::bind(&LLViewerObjectList::objectPropertiesCoro, this, _1));
+	}
+}
 
-				if ( id_list.size() > 0 )
-				{
-					LLSD post_data = LLSD::emptyMap();
+void LLViewerObjectList::objectPropertiesCoro(LLCoros::self& self)
+{
+	// Each reply is handled as it comes in, and objects that go stale in
+	// the meantime get requests of their own rather than wait for it.
+	LLHTTPRequestGroup requests("objectProperties");
+	std::vector<LLSD> batches;		// by request index
+	std::vector<bool> cost_requests;	// else physics flags
+	S32 gather_frames = 0;
+	while (requests.getPending() > 0 || !mStaleObjectCost.empty() || !mStalePhysicsFlags.empty())
+	{
+		waitForEventOn(self, "mainloop");
 
-					post_data["object_ids"] = id_list;
-					LLHTTPClient::post(
-						url,
-						post_data,
-						new LLPhysicsFlagsResponder(id_list));
-				}
+		for (S32 index = requests.takeAnswered(); index >= 0; index = requests.takeAnswered())
+		{
+			if (cost_requests[index])
+			{
+				handle_object_cost_reply(batches[index], requests, index);
 			}
 			else
 			{
-				mStalePhysicsFlags.clear();
-				mPendingPhysicsFlags.clear();
+				handle_physics_flags_reply(batches[index], requests, index);
 			}
+			batches[index].clear();
+		}
+
+		// Let objects that go stale over the next few frames, as a
+		// selection or a rezzed linkset tends to, share the requests.
+		if (mStaleObjectCost.empty() && mStalePhysicsFlags.empty())
+		{
+			gather_frames = 0;
+			continue;
+		}
+		if (++gather_frames < OBJECT_PROPERTIES_GATHER_FRAMES)
+		{
+			continue;
+		}
+		gather_frames = 0;
+
+		LLViewerRegion* regionp = gAgent.getRegion();
+		if (!regionp)
+		{
+			continue;
+		}
+
+		std::vector<LLSD> cost_batches;
+		std::string cost_url = regionp->getCapability("GetObjectCost");
+		if (!cost_url.empty())
+		{
+			take_stale_object_ids(mStaleObjectCost, mPendingObjectCost, cost_batches);
+		}
+		else
+		{
+			mStaleObjectCost.clear();
+			mPendingObjectCost.clear();
+		}
+
+		std::vector<LLSD> physics_batches;
+		std::string physics_url = regionp->getCapability("GetObjectPhysicsData");
+		if (!physics_url.empty())
+		{
+			take_stale_object_ids(mStalePhysicsFlags, mPendingPhysicsFlags, physics_batches);
+		}
+		else
+		{
+			mStalePhysicsFlags.clear();
+			mPendingPhysicsFlags.clear();
+		}
+
+		// Every batch of both kinds goes out at once
+		for (U32 i = 0; i < cost_batches.size(); i++)
+		{
+			LLSD post_data = LLSD::emptyMap();
+			post_data["object_ids"] = cost_batches[i];
+			requests.post(cost_url, post_data);
+			batches.push_back(cost_batches[i]);
+			cost_requests.push_back(true);
+		}
+		for (U32 i = 0; i < physics_batches.size(); i++)
+		{
+			LLSD post_data = LLSD::emptyMap();
+			post_data["object_ids"] = physics_batches[i];
+			requests.post(physics_url, post_data);
+			batches.push_back(physics_batches[i]);
+			cost_requests.push_back(false);
 		}
 	}
+	mObjectPropertiesFetching = false;
 }
 
 
@@ -1289,7 +1403,7 @@ void LLViewerObjectList::killAllObjects()
 	if (!mActiveObjects.empty())
 	{
 		llwarns << "Some objects still on active object list!" << llendl;
-		mActiveObjects.clear();
+		clearActiveObjects();
 	}
 
 	if (!mMapObjects.empty())
@@ -1362,6 +1476,18 @@ void LLViewerObjectList::updateActive(LLViewerObject *objectp)
 	}
 }
 
+void LLViewerObjectList::clearActiveObjects()
+{
+	// Hand back their motion store entries while the objects are still
+	// around to have their handles cleared
+	for (std::set<LLPointer<LLViewerObject> >::iterator iter = mActiveObjects.begin();
+		iter != mActiveObjects.end(); ++iter)
+	{
+		(*iter)->setOnActiveList(FALSE);
+	}
+	mActiveObjects.clear();
+}
+
 void LLViewerObjectList::updateObjectCost(LLViewerObject* object)
 {
 	mStaleObjectCost.insert(object->getID());
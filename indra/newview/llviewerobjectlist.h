@@ -31,14 +31,18 @@
 #include <set>
 
 // common includes
+#include "llcoros.h"
 #include "llstat.h"
 #include "llstring.h"
 
 // project includes
 #include "llviewerobject.h"
 #include "llaccountingquota.h"
+#include "llobjectmotionstore.h"
+#include "llobjectupdatedecoder.h"
 
 class LLCamera;
+class LLDataPackerBinaryBuffer;
 class LLNetMap;
 class LLDebugBeacon;
 
@@ -83,6 +87,11 @@ public:
 	void processObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type, bool cached=false, bool compressed=false);
 	void processCompressedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
 	void processCachedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
+	// While an object processes a full update: the update's volume params
+	// and texture entries if they were decoded ahead of time, and dp is at
+	// them.  dp is moved past them.  NULL if they have to be unpacked.
+	const LLVolumeParams* takeDecodedVolumeParams(LLDataPacker* dp);
+	const LLTEContents* takeDecodedTEs(LLDataPacker* dp);
 	void updateApparentAngles(LLAgent &agent);
 	void update(LLAgent &agent, LLWorld &world);
 
@@ -123,6 +132,7 @@ public:
 
 	void updateActive(LLViewerObject *objectp);
 	void updateAvatarVisibility();
+	LLObjectMotionStore& getMotionStore() { return mMotionStore; }
 
 	// Selection related stuff
 	void generatePickList(LLCamera &camera);
@@ -191,6 +201,11 @@ public:
 	S32 mNumUnknownKills;
 	S32 mNumDeadObjects;
 protected:
+	void startObjectPropertiesFetch();
+	void objectPropertiesCoro(LLCoros::self& self);
+	// Takes everything off the active list, releasing motion store entries
+	void clearActiveObjects();
+
 	std::vector<U64>	mOrphanParents;	// LocalID/ip,port of orphaned objects
 	std::vector<OrphanInfo> mOrphanChildren;	// UUID's of orphaned objects
 	S32 mNumOrphans;
@@ -198,6 +213,9 @@ protected:
 	typedef std::vector<LLPointer<LLViewerObject> > vobj_list_t;
 
 	vobj_list_t mObjects;
+	// Dead reckoning state of mActiveObjects, declared first so that it
+	// outlives them
+	LLObjectMotionStore mMotionStore;
 	std::set<LLPointer<LLViewerObject> > mActiveObjects;
 
 	vobj_list_t mMapObjects;
@@ -214,6 +232,18 @@ protected:
 	std::set<LLUUID> mStalePhysicsFlags;
 	std::set<LLUUID> mPendingPhysicsFlags;
 
+	// objectPropertiesCoro() is fetching the above
+	bool mObjectPropertiesFetching;
+
+	// Decoding of full updates, created with the first of them
+	LLObjectUpdateDecoder* mUpdateDecoder;
+	std::vector<LLDecodedObjectUpdate> mDecodedUpdates;
+	std::vector<U8> mUpdateData;	// a block's worth for each
+	std::vector<LLDataPackerBinaryBuffer*> mCachedDPs;
+	// The one being processed
+	const LLDecodedObjectUpdate* mCurrentDecoded;
+	LLDataPackerBinaryBuffer* mCurrentDecodedDP;
+
 	std::vector<LLDebugBeacon> mDebugBeacons;
 
 	S32 mCurLazyUpdateIndex;
@@ -30,6 +30,7 @@
 
 #include "llviewercontrol.h"
 
+#include "lljobscheduler.h"
 #include "llagent.h"
 #include "llviewercamera.h"
 #include "llviewerobjectlist.h"
@@ -65,17 +66,15 @@ const F32 LLViewerPartSim::PART_ADAPT_RATE_MULT_RECIP = 1.0f/PART_ADAPT_RATE_MUL
 
 U32 LLViewerPart::sNextPartID = 1;
 
-F32 calc_desired_size(LLViewerCamera* camera, LLVector3 pos, LLVector2 scale)
+F32 calc_desired_size(const LLVector3 &camera_origin, LLVector3 pos, LLVector2 scale)
 {
-	F32 desired_size = (pos - camera->getOrigin()).magVec();
+	F32 desired_size = (pos - camera_origin).magVec();
 	desired_size /= 4;
 	return llclamp(desired_size, scale.magVec()*0.5f, PART_SIM_BOX_SIDE*2);
 }
 
 LLViewerPart::LLViewerPart() :
 	mPartID(0),
-	mLastUpdateTime(0.f),
-	mSkipOffset(0.f),
 	mVPCallback(NULL),
 	mImagep(NULL)
 {
@@ -118,7 +117,9 @@ void LLViewerPart::init(LLPointer<LLViewerPartSource> sourcep, LLViewerTexture *
 
 
 LLViewerPartGroup::LLViewerPartGroup(const LLVector3 &center_agent, const F32 box_side, bool hud)
- : mHud(hud)
+ : mHud(hud),
+   mUpdateDT(0.f),
+   mNumPlaced(0)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	mVOPartGroupp = NULL;
@@ -143,15 +144,20 @@ LLViewerPartGroup::LLViewerPartGroup(const LLVector3 &center_agent, const F32 bo
 	{
 	mVOPartGroupp = (LLVOPartGroup *)gObjectList.createObjectViewer(LLViewerObject::LL_VO_PART_GROUP, getRegion());
 	}
-	mVOPartGroupp->setViewerPartGroup(this);
-	mVOPartGroupp->setPositionAgent(getCenterAgent());
-	F32 scale = box_side * 0.5f;
-	mVOPartGroupp->setScale(LLVector3(scale,scale,scale));
-	
-	//gPipeline.addObject(mVOPartGroupp);
-	gPipeline.createObject(mVOPartGroupp);
+	// Without one the particles are simulated, just not drawn
+	LLSpatialGroup* group = NULL;
+	if (mVOPartGroupp)
+	{
+		mVOPartGroupp->setViewerPartGroup(this);
+		mVOPartGroupp->setPositionAgent(getCenterAgent());
+		F32 scale = box_side * 0.5f;
+		mVOPartGroupp->setScale(LLVector3(scale,scale,scale));
 
-	LLSpatialGroup* group = mVOPartGroupp->mDrawable->getSpatialGroup();
+		//gPipeline.addObject(mVOPartGroupp);
+		gPipeline.createObject(mVOPartGroupp);
+
+		group = mVOPartGroupp->mDrawable->getSpatialGroup();
+	}
 
 	if (group != NULL)
 	{
@@ -250,158 +256,128 @@ BOOL LLViewerPartGroup::addPart(LLViewerPart* part, F32 desired_size)
 		return FALSE;
 	}
 
-	gPipeline.markRebuild(mVOPartGroupp->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
+	if (mVOPartGroupp.notNull())
+	{
+		gPipeline.markRebuild(mVOPartGroupp->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
+	}
 	
 	mParticles.push_back(part);
 	part->mSkipOffset=mSkippedTime;
+
+	// A particle with a callback is placed by it
+	LLViewerPartSource *sourcep = part->mPartSourcep;
+	bool placed = part->mVPCallback != NULL;
+	mPool.add(*part,
+			  sourcep ? &sourcep->mPosAgent : NULL,
+			  sourcep ? &sourcep->mTargetPosAgent : NULL,
+			  placed);
+	if (placed)
+	{
+		mNumPlaced++;
+	}
+
 	LLViewerPartSim::incPartCount(1);
 	return TRUE;
 }
 
 
-void LLViewerPartGroup::updateParticles(const F32 lastdt)
+void LLViewerPartGroup::startUpdate(const F32 dt)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
-	F32 dt;
-	
-	LLVector3 gravity(0.f, 0.f, GRAVITY);
+	mUpdateDT = dt;
 
 	LLViewerPartSim::checkParticleCount(mParticles.size());
 
-	LLViewerCamera* camera = LLViewerCamera::getInstance();
-	LLViewerRegion *regionp = getRegion();
-	S32 end = (S32) mParticles.size();
-	for (S32 i = 0 ; i < (S32)mParticles.size();)
+	// Do the custom callbacks, they reach into the source objects
+	if (mNumPlaced)
 	{
-		LLVector3 a(0.f, 0.f, 0.f);
-		LLViewerPart* part = mParticles[i] ;
-
-		dt = lastdt + mSkippedTime - part->mSkipOffset;
-		part->mSkipOffset = 0.f;
-
-		// Update current time
-		const F32 cur_time = part->mLastUpdateTime + dt;
-		const F32 frac = cur_time / part->mMaxAge;
-
-		// "Drift" the object based on the source object
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		for (S32 i = 0; i < (S32)mParticles.size(); i++)
 		{
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += part->mPosOffset;
-		}
-
-		// Do a custom callback if we have one...
-		if (part->mVPCallback)
-		{
-			(*part->mVPCallback)(*part, dt);
+			LLViewerPart* part = mParticles[i];
+			if (part->mVPCallback)
+			{
+				mPool.get(i, *part);
+				(*part->mVPCallback)(*part, mPool.getTimeStep(i, dt));
+				mPool.set(i, *part);
+			}
 		}
+	}
+}
 
-		if (part->mFlags & LLPartData::LL_PART_WIND_MASK)
-		{
-			LLVector3 tempVel(part->mVelocity);
-			part->mVelocity *= 1.f - 0.1f*dt;
-			part->mVelocity += 0.1f*dt*regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(part->mPosAgent));
-		}
+void LLViewerPartGroup::simulate(const LLVector3 &camera_origin)
+{
+	mPool.followSources();
 
-		// Now do interpolation towards a target
-		if (part->mFlags & LLPartData::LL_PART_TARGET_POS_MASK)
+	// Wind is only written on the main thread, which waits for this
+	LLViewerRegion *regionp = getRegion();
+	const S32 count = mPool.getCount();
+	for (S32 i = 0; i < count; i++)
+	{
+		if (mPool.getFlags(i) & LLPartData::LL_PART_WIND_MASK)
 		{
-			F32 remaining = part->mMaxAge - part->mLastUpdateTime;
-			F32 step = dt / remaining;
-
-			step = llclamp(step, 0.f, 0.1f);
-			step *= 5.f;
-			// we want a velocity that will result in reaching the target in the 
-			// Interpolate towards the target.
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPosAgent;
-
-			delta_pos /= remaining;
-
-			part->mVelocity *= (1.f - step);
-			part->mVelocity += step*delta_pos;
+			LLVector3 pos_region = regionp->getPosRegionFromAgent(mPool.getPosAgent(i));
+			mPool.setWind(i, regionp->mWind.getVelocity(pos_region));
 		}
+	}
 
+	mPool.integrate(mUpdateDT);
 
-		if (part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
-		{
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPartSourcep->mPosAgent;			
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += frac*delta_pos;
-			part->mVelocity = delta_pos;
-		}
-		else
+	mFates.resize(count);
+	for (S32 i = 0; i < count; i++)
+	{
+		// Kill dead particles (either flagged dead, or too old)
+		if (mPool.isDead(i))
 		{
-			// Do velocity interpolation
-			part->mPosAgent += dt*part->mVelocity;
-			part->mPosAgent += 0.5f*dt*dt*part->mAccel;
-			part->mVelocity += part->mAccel*dt;
+			mFates[i] = FATE_DEAD;
+			continue;
 		}
 
-		// Do a bounce test
-		if (part->mFlags & LLPartData::LL_PART_BOUNCE_MASK)
-		{
-			// Need to do point vs. plane check...
-			// For now, just check relative to object height...
-			F32 dz = part->mPosAgent.mV[VZ] - part->mPartSourcep->mPosAgent.mV[VZ];
-			if (dz < 0)
-			{
-				part->mPosAgent.mV[VZ] += -2.f*dz;
-				part->mVelocity.mV[VZ] *= -0.75f;
-			}
-		}
+		LLVector3 pos_agent = mPool.getPosAgent(i);
+		F32 desired_size = calc_desired_size(camera_origin, pos_agent, mPool.getScale(i));
+		mFates[i] = posInGroup(pos_agent, desired_size) ? FATE_KEEP : FATE_MOVE;
+	}
+}
+
+void LLViewerPartGroup::finishUpdate()
+{
+	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 
+	// Particles moved in from groups that finished first stay
+	mFates.resize(mParticles.size(), FATE_KEEP);
 
-		// Reset the offset from the source position
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+	S32 end = (S32) mParticles.size();
+	for (S32 i = 0 ; i < (S32)mParticles.size();)
+	{
+		const U8 fate = mFates[i];
+		if (fate == FATE_KEEP)
 		{
-			part->mPosOffset = part->mPosAgent;
-			part->mPosOffset -= part->mPartSourcep->mPosAgent;
+			i++ ;
+			continue;
 		}
 
-		// Do color interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_COLOR_MASK)
+		LLViewerPart* part = mParticles[i] ;
+		if (fate == FATE_MOVE)
 		{
-			part->mColor.setVec(part->mStartColor);
-			// note: LLColor4's v%k means multiply-alpha-only,
-			//       LLColor4's v*k means multiply-rgb-only
-			part->mColor *= 1.f - frac; // rgb*k
-			part->mColor %= 1.f - frac; // alpha*k
-			part->mColor += frac%(frac*part->mEndColor); // rgb,alpha
+			mPool.get(i, *part);
 		}
-
-		// Do scale interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_SCALE_MASK)
+		if (part->mVPCallback)
 		{
-			part->mScale.setVec(part->mStartScale);
-			part->mScale *= 1.f - frac;
-			part->mScale += frac*part->mEndScale;
+			mNumPlaced--;
 		}
+		mPool.remove(i);
+		mParticles[i] = mParticles.back() ;
+		mParticles.pop_back() ;
+		mFates[i] = mFates.back();
+		mFates.pop_back();
 
-		// Set the last update time to now.
-		part->mLastUpdateTime = cur_time;
-
-
-		// Kill dead particles (either flagged dead, or too old)
-		if ((part->mLastUpdateTime > part->mMaxAge) || (LLViewerPart::LL_PART_DEAD_MASK == part->mFlags))
+		if (fate == FATE_DEAD)
 		{
-			mParticles[i] = mParticles.back() ;
-			mParticles.pop_back() ;
 			delete part ;
 		}
-		else 
+		else
 		{
-			F32 desired_size = calc_desired_size(camera, part->mPosAgent, part->mScale);
-			if (!posInGroup(part->mPosAgent, desired_size))
-			{
-				// Transfer particles between groups
-				LLViewerPartSim::getInstance()->put(part) ;
-				mParticles[i] = mParticles.back() ;
-				mParticles.pop_back() ;
-			}
-			else
-			{
-				i++ ;
-			}
+			// Transfer particles between groups
+			LLViewerPartSim::getInstance()->put(part) ;
 		}
 	}
 
@@ -417,7 +393,7 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 	}
 	
 	// Kill the viewer object if this particle group is empty
-	if (mParticles.empty())
+	if (mParticles.empty() && mVOPartGroupp.notNull())
 	{
 		gObjectList.killObject(mVOPartGroupp);
 		mVOPartGroupp = NULL;
@@ -434,10 +410,7 @@ void LLViewerPartGroup::shift(const LLVector3 &offset)
 	mMinObjPos += offset;
 	mMaxObjPos += offset;
 
-	for (S32 i = 0 ; i < (S32)mParticles.size(); i++)
-	{
-		mParticles[i]->mPosAgent += offset;
-	}
+	mPool.shift(offset);
 }
 
 void LLViewerPartGroup::removeParticlesByID(const U32 source_id)
@@ -448,7 +421,7 @@ void LLViewerPartGroup::removeParticlesByID(const U32 source_id)
 	{
 		if(mParticles[i]->mPartSourcep->getID() == source_id)
 		{
-			mParticles[i]->mFlags = LLViewerPart::LL_PART_DEAD_MASK;
+			mPool.setFlags(i, LLViewerPart::LL_PART_DEAD_MASK);
 		}		
 	}
 }
@@ -554,7 +527,7 @@ LLViewerPartGroup *LLViewerPartSim::put(LLViewerPart* part)
 	else
 	{	
 		LLViewerCamera* camera = LLViewerCamera::getInstance();
-		F32 desired_size = calc_desired_size(camera, part->mPosAgent, part->mScale);
+		F32 desired_size = calc_desired_size(camera->getOrigin(), part->mPosAgent, part->mScale);
 
 		S32 count = (S32) mViewerPartGroups.size();
 		for (S32 i = 0; i < count; i++)
@@ -628,6 +601,49 @@ void LLViewerPartSim::shift(const LLVector3 &offset)
 	}
 }
 
+namespace
+{
+	// Fewer than this aren't worth waking the workers for
+	const S32 MIN_PARTICLES_TO_SHARE = 1024;
+
+	class LLPartGroupRange : public LLParallelFor
+	{
+	public:
+		LLPartGroupRange(LLViewerPartSim::group_list_t &groups, const LLVector3 &camera_origin)
+		:	mGroups(groups),
+			mCameraOrigin(camera_origin)
+		{
+		}
+
+		/*virtual*/ void runRange(S32 begin, S32 end)
+		{
+			for (S32 i = begin; i < end; i++)
+			{
+				mGroups[i]->simulate(mCameraOrigin);
+			}
+		}
+
+	private:
+		LLViewerPartSim::group_list_t &mGroups;
+		const LLVector3 mCameraOrigin;
+	};
+}
+
+void LLViewerPartSim::simulateGroups(group_list_t &groups)
+{
+	const LLVector3 camera_origin = LLViewerCamera::getInstance()->getOrigin();
+	S32 count = (S32) groups.size();
+	S32 particles = 0;
+	for (S32 i = 0; i < count; i++)
+	{
+		particles += groups[i]->getCount();
+	}
+
+	// A group at a time, they vary too much in size for bigger takes
+	LLPartGroupRange range(groups, camera_origin);
+	range.run(count, particles < MIN_PARTICLES_TO_SHARE ? count : 1);
+}
+
 static LLFastTimer::DeclareTimer FTM_SIMULATE_PARTICLES("Simulate Particles");
 
 void LLViewerPartSim::updateSimulation()
@@ -708,10 +724,13 @@ void LLViewerPartSim::updateSimulation()
 		num_updates++;
 	}
 
+	// Work out which groups update this frame
+	group_list_t updating;
 	count = (S32) mViewerPartGroups.size();
 	for (i = 0; i < count; i++)
 	{
-		LLViewerObject* vobj = mViewerPartGroups[i]->mVOPartGroupp;
+		LLViewerPartGroup* groupp = mViewerPartGroups[i];
+		LLViewerObject* vobj = groupp->mVOPartGroupp;
 
 		S32 visirate = 1;
 		if (vobj)
@@ -723,28 +742,45 @@ void LLViewerPartSim::updateSimulation()
 			}
 		}
 
-		if ((LLDrawable::getCurrentFrame()+mViewerPartGroups[i]->mID)%visirate == 0)
+		if ((LLDrawable::getCurrentFrame()+groupp->mID)%visirate == 0)
 		{
 			if (vobj)
 			{
 				gPipeline.markRebuild(vobj->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 			}
-			mViewerPartGroups[i]->updateParticles(dt * visirate);
-			mViewerPartGroups[i]->mSkippedTime=0.0f;
-			if (!mViewerPartGroups[i]->getCount())
-			{
-				delete mViewerPartGroups[i];
-				mViewerPartGroups.erase(mViewerPartGroups.begin() + i);
-				i--;
-				count--;
-			}
+			groupp->startUpdate(dt * visirate + groupp->mSkippedTime);
+			groupp->mSkippedTime=0.0f;
+			updating.push_back(groupp);
 		}
 		else
 		{	
-			mViewerPartGroups[i]->mSkippedTime+=dt;
+			groupp->mSkippedTime+=dt;
 		}
+	}
 
+	simulateGroups(updating);
+
+	// Particles leaving a group only go into others now, every group
+	// having had its update
+	count = (S32) updating.size();
+	for (i = 0; i < count; i++)
+	{
+		updating[i]->finishUpdate();
+	}
+
+	for (i = 0; i < (S32) mViewerPartGroups.size();)
+	{
+		if (!mViewerPartGroups[i]->getCount())
+		{
+			delete mViewerPartGroups[i];
+			mViewerPartGroups.erase(mViewerPartGroups.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
 	}
+
 	if (LLDrawable::getCurrentFrame()%16==0)
 	{
 		if (sParticleCount > sMaxParticleCount * 0.875f
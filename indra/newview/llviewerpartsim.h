@@ -31,6 +31,7 @@
 #include "llframetimer.h"
 #include "llpointer.h"
 #include "llpartdata.h"
+#include "llpartpool.h"
 #include "llviewerpartsource.h"
 
 class LLViewerTexture;
@@ -43,11 +44,13 @@ typedef void (*LLVPCallback)(LLViewerPart &part, const F32 dt);
 
 ///////////////////
 //
-// An individual particle
+// An individual particle.  Once it is in a group, the group's pool has its
+// LLPartState, and the state here is only brought up to date for callbacks
+// and moving between groups.
 //
 
 
-class LLViewerPart : public LLPartData
+class LLViewerPart : public LLPartState
 {
 public:
 	~LLViewerPart();
@@ -58,20 +61,12 @@ public:
 
 
 	U32					mPartID;					// Particle ID used primarily for moving between groups
-	F32					mLastUpdateTime;			// Last time the particle was updated
-	F32					mSkipOffset;				// Offset against current group mSkippedTime
 
 	LLVPCallback		mVPCallback;				// Callback function for more complicated behaviors
 	LLPointer<LLViewerPartSource> mPartSourcep;		// Particle source used for this object
 	
 
-	// Current particle state (possibly used for rendering)
 	LLPointer<LLViewerTexture>	mImagep;
-	LLVector3		mPosAgent;
-	LLVector3		mVelocity;
-	LLVector3		mAccel;
-	LLColor4		mColor;
-	LLVector2		mScale;
 
 	static U32		sNextPartID;
 };
@@ -90,15 +85,23 @@ public:
 
 	BOOL addPart(LLViewerPart* part, const F32 desired_size = -1.f);
 	
-	void updateParticles(const F32 lastdt);
+	// An update, split so that simulate() can run on a worker thread while
+	// other groups do the same.  dt is the time since the group last
+	// updated.
+	void startUpdate(const F32 dt);							// MAIN THREAD: particle callbacks
+	void simulate(const LLVector3 &camera_origin);			// ANY THREAD
+	void finishUpdate();									// MAIN THREAD: kill and move particles
 
 	BOOL posInGroup(const LLVector3 &pos, const F32 desired_size = -1.f);
 
 	void shift(const LLVector3 &offset);
 
+	// Parallel to mPool
 	typedef std::vector<LLViewerPart*>  part_list_t;
 	part_list_t mParticles;
 
+	const LLPartPool &getPool() const		{ return mPool; }
+
 	const LLVector3 &getCenterAgent() const		{ return mCenterAgent; }
 	S32 getCount() const					{ return (S32) mParticles.size(); }
 	LLViewerRegion *getRegion() const		{ return mRegionp; }
@@ -120,6 +123,19 @@ protected:
 	LLVector3 mMaxObjPos;
 
 	LLViewerRegion *mRegionp;
+
+	LLPartPool mPool;
+	F32 mUpdateDT;
+	S32 mNumPlaced;						// particles with a callback
+
+	// What simulate() decided for each particle
+	enum EFate
+	{
+		FATE_KEEP,
+		FATE_DEAD,
+		FATE_MOVE
+	};
+	std::vector<U8> mFates;
 };
 
 class LLViewerPartSim : public LLSingleton<LLViewerPartSim>
@@ -135,6 +151,9 @@ public:
 	void shift(const LLVector3 &offset);
 
 	void updateSimulation();
+	// Simulates the groups, sharing them out to the job scheduler's workers
+	// when there are enough particles
+	void simulateGroups(group_list_t &groups);
 
 	void addPartSource(LLPointer<LLViewerPartSource> sourcep);
 
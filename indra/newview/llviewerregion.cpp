@@ -321,6 +321,12 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mImpl->mObjectPartition.push_back(new LLBridgePartition());	//PARTITION_BRIDGE
 	mImpl->mObjectPartition.push_back(new LLHUDParticlePartition());//PARTITION_HUD_PARTICLE
 	mImpl->mObjectPartition.push_back(NULL);						//PARTITION_NONE
+
+	// Have the cache file read by the time the region handshake asks for it
+	if(LLVOCache::hasInstance())
+	{
+		LLVOCache::getInstance()->prefetch(mHandle) ;
+	}
 }
 
 
@@ -416,6 +422,10 @@ void LLViewerRegion::saveObjectCache()
 {
 	if (!mCacheLoaded)
 	{
+		if(LLVOCache::hasInstance())
+		{
+			LLVOCache::getInstance()->discardPrefetch(mHandle) ;
+		}
 		return;
 	}
 
@@ -682,6 +692,9 @@ void LLViewerRegion::dirtyHeights()
 BOOL LLViewerRegion::idleUpdate(F32 max_update_time)
 {
 	LLMemType mt_ivr(LLMemType::MTYPE_IDLE_UPDATE_VIEWER_REGION);
+	// Upload terrain textures composited since the last frame
+	mImpl->mCompositionp->uploadTextures();
+
 	// did_update returns TRUE if we did at least one significant update
 	BOOL did_update = mImpl->mLandp->idleUpdate(max_update_time);
 	
@@ -698,6 +711,7 @@ BOOL LLViewerRegion::idleUpdate(F32 max_update_time)
 // As above, but forcibly do the update.
 void LLViewerRegion::forceUpdate()
 {
+	mImpl->mCompositionp->uploadTextures();
 	mImpl->mLandp->idleUpdate(0.f);
 
 	if (mParcelOverlay)
@@ -1198,7 +1212,12 @@ LLViewerRegion::eCacheUpdateResult LLViewerRegion::cacheFullUpdate(LLViewerObjec
 
 // Get data packer for this object, if we have cached data
 // AND the CRC matches. JC
-LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
+const std::map<U32, LLVOCacheEntry*>& LLViewerRegion::getCacheMap() const
+{
+	return mImpl->mCacheMap;
+}
+
+LLDataPackerBinaryBuffer *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
 {
 	//llassert(mCacheLoaded);  This assert failes often, changing to early-out -- davep, 2010/10/18
 
@@ -1211,8 +1230,15 @@ LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
 		{
 			// Record a hit
 			entry->recordHit();
+			LLDataPackerBinaryBuffer* dp = entry->getDP(crc);
+			if (dp)
+			{
 		cache_miss_type = CACHE_MISS_TYPE_NONE;
-			return entry->getDP(crc);
+				return dp;
+			}
+			// Data from the cache file that failed its check, ask again
+		cache_miss_type = CACHE_MISS_TYPE_CRC;
+			mCacheMissCRC.put(local_id);
 		}
 		else
 		{
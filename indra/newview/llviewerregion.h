@@ -299,7 +299,11 @@ public:
 
 	// handle a full update message
 	eCacheUpdateResult cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinaryBuffer &dp);
-	LLDataPacker *getDP(U32 local_id, U32 crc, U8 &cache_miss_type);
+	LLDataPackerBinaryBuffer *getDP(U32 local_id, U32 crc, U8 &cache_miss_type);
+	// The cache entries by local id, to look ahead at what the region holds.
+	// Updates replace entries, so they're only good until the next message.
+	const std::map<U32, LLVOCacheEntry*>& getCacheMap() const;
+	BOOL isCacheLoaded() const { return mCacheLoaded; }
 	void requestCacheMisses();
 	void addCacheMissFull(const U32 local_id);
 
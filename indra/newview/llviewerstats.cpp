@@ -60,6 +60,7 @@
 #include "llfeaturemanager.h"
 #include "llviewernetwork.h"
 #include "llmeshrepository.h" //for LLMeshRepository::sBytesReceived
+#include "llassetstorage.h" //for gAssetStorage->getCoalescingStats()
 
 
 class StatAttributes
@@ -265,6 +266,8 @@ LLViewerStats::LLViewerStats() :
 	mNumNewObjectsStat("numnewobjectsstat"),
 	mNumSizeCulledStat("numsizeculledstat"),
 	mNumVisCulledStat("numvisculledstat"),
+	mTerrainPatchRebuildsStat("terrainpatchrebuildsstat"),
+	mTerrainGridUpdatesStat("terraingridupdatesstat"),
 	mLastTimeDiff(0.0)
 {
 	for (S32 i = 0; i < ST_COUNT; i++)
@@ -796,6 +799,10 @@ void send_stats()
 	download["object_kbytes"] = gTotalObjectBytes / 1024.0;
 	download["texture_kbytes"] = gTotalTextureBytes / 1024.0;
 	download["mesh_kbytes"] = LLMeshRepository::sBytesReceived/1024.0;
+	if (gAssetStorage)
+	{
+		download["asset_coalescing"] = gAssetStorage->getCoalescingStats();
+	}
 
 	LLSD &in = body["stats"]["net"]["in"];
 
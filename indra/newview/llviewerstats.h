@@ -110,6 +110,9 @@ public:
 	LLStat mNumSizeCulledStat;
 	LLStat mNumVisCulledStat;
 
+	LLStat mTerrainPatchRebuildsStat;
+	LLStat mTerrainGridUpdatesStat;
+
 	void resetStats();
 public:
 	// If you change this, please also add a corresponding text label
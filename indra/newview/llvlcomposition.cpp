@@ -32,6 +32,8 @@
 #include "llerror.h"
 #include "v3math.h"
 #include "llsurface.h"
+#include "llsurfacepatch.h"
+#include "llterraincompositor.h"
 #include "lltextureview.h"
 #include "llviewertexture.h"
 #include "llviewertexturelist.h"
@@ -85,6 +87,11 @@ LLVLComposition::LLVLComposition(LLSurface *surfacep, const U32 width, const F32
 
 LLVLComposition::~LLVLComposition()
 {
+	for (U32 i = 0; i < mPendingTextures.size(); i++)
+	{
+		delete mPendingTextures[i];
+	}
+	mPendingTextures.clear();
 }
 
 
@@ -249,25 +256,20 @@ BOOL LLVLComposition::generateComposition()
 	return TRUE;
 }
 
-BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
-									  const F32 width, const F32 height)
+LLVLComposition::PendingTexture::PendingTexture()
+:	mPatchp(NULL),
+	mCompositor(NULL)
 {
-	llassert(mSurfacep);
-	llassert(x >= 0.f);
-	llassert(y >= 0.f);
-
-	LLTimer gen_timer;
-
-	///////////////////////////
-	//
-	// Generate raw data arrays for surface textures
-	//
-	//
+}
 
-	// These have already been validated by generateComposition.
-	U8* st_data[4];
-	S32 st_data_size[4]; // for debugging
+LLVLComposition::PendingTexture::~PendingTexture()
+{
+	// Waits for any tiles still on the workers
+	delete mCompositor;
+}
 
+BOOL LLVLComposition::loadDetailImages()
+{
 	for (S32 i = 0; i < 4; i++)
 	{
 		if (mRawImages[i].isNull())
@@ -306,8 +308,29 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 				mRawImages[i] = newraw; // deletes old
 			}
 		}
-		st_data[i] = mRawImages[i]->getData();
-		st_data_size[i] = mRawImages[i]->getDataSize();
+	}
+	return TRUE;
+}
+
+BOOL LLVLComposition::generateTexture(LLSurfacePatch *patchp, const F32 x, const F32 y,
+									  const F32 width, const F32 height)
+{
+	llassert(mSurfacep);
+	llassert(x >= 0.f);
+	llassert(y >= 0.f);
+
+	LLTimer gen_timer;
+
+	///////////////////////////
+	//
+	// Generate raw data arrays for surface textures
+	//
+	//
+
+	// These have already been validated by generateComposition.
+	if (!loadDetailImages())
+	{
+		return FALSE;
 	}
 
 	///////////////////////////////////////
@@ -373,92 +396,84 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
 	tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
 
-	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
-	U8 *rawp = raw->getData();
-
-	F32 tex_width_inv = 1.f/tex_width;
-	F32 tex_height_inv = 1.f/tex_height;
-
 	F32 st_x_stride, st_y_stride;
 	st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
 	st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
 
 	llassert(st_x_stride > 0.f);
 	llassert(st_y_stride > 0.f);
+
 	////////////////////////////////
 	//
-	// Iterate through the target texture, striding through the
-	// subtextures and interpolating appropriately.
+	// Hand the texels to the compositor, which strides through the
+	// subtextures and interpolates appropriately.
 	//
 	//
 
-	F32 sti, stj;
-	S32 st_offset;
-	sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
-	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+	PendingTexture *pending = new PendingTexture();
+	pending->mPatchp = patchp;
+	pending->mRaw = new LLImageRaw(tex_width, tex_height, tex_comps);
 
-	st_offset = (llfloor(stj * st_width) + llfloor(sti)) * st_comps;
-	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+	LLTerrainCompositor::Params params;
+	for (S32 i = 0; i < 4; i++)
 	{
-		U32 offset = j * tex_stride + tex_x_begin * tex_comps;
-		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
-		for (S32 i = tex_x_begin; i < tex_x_end; i++)
-		{
-			S32 tex0, tex1;
-			F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
-
-			tex0 = llfloor( composition );
-			tex0 = llclamp(tex0, 0, 3);
-			composition -= tex0;
-			tex1 = tex0 + 1;
-			tex1 = llclamp(tex1, 0, 3);
-
-			F32 xy_int_i, xy_int_j;
+		pending->mDetailImages[i] = mRawImages[i];
+		params.mDetail[i] = mRawImages[i]->getData();
+		params.mDetailSize[i] = mRawImages[i]->getDataSize();
+	}
+	params.mDetailWidth = st_width;
+	params.mDetailHeight = st_height;
+	params.mComposition = mDatap;
+	params.mCompositionWidth = mWidth;
+	params.mCompositionScaleInv = mScaleInv;
+	params.mTexXRatio = tex_x_ratiof;
+	params.mTexYRatio = tex_y_ratiof;
+	params.mDetailXStride = st_x_stride;
+	params.mDetailYStride = st_y_stride;
+	params.mXBegin = tex_x_begin;
+	params.mYBegin = tex_y_begin;
+	params.mXEnd = tex_x_end;
+	params.mYEnd = tex_y_end;
+	params.mOutput = pending->mRaw->getData();
+	params.mOutputStride = tex_stride;
+
+	pending->mCompositor = new LLTerrainCompositor(params);
+	pending->mCompositor->start();
+	mPendingTextures.push_back(pending);
+	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
 
-			xy_int_i = i * tex_width_inv;
-			xy_int_j = j * tex_height_inv;
+	// Without workers it's already done
+	uploadTextures();
+	return TRUE;
+}
 
-			st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
-			for (U32 k = 0; k < tex_comps; k++)
-			{
-				// Linearly interpolate based on composition.
-				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
-				{
-					// SJB: This shouldn't be happening, but does... Rounding error?
-					//llwarns << "offset 0 [" << tex0 << "] =" << st_offset << " >= size=" << st_data_size[tex0] << llendl;
-					//llwarns << "offset 1 [" << tex1 << "] =" << st_offset << " >= size=" << st_data_size[tex1] << llendl;
-				}
-				else
-				{
-					F32 a = *(st_data[tex0] + st_offset);
-					F32 b = *(st_data[tex1] + st_offset);
-					rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
-				}
-				offset++;
-				st_offset++;
-			}
+void LLVLComposition::uploadTextures()
+{
+	while (!mPendingTextures.empty() && mPendingTextures.front()->mCompositor->isDone())
+	{
+		PendingTexture *pending = mPendingTextures.front();
+		mPendingTextures.pop_front();
+		uploadTexture(pending);
+		delete pending;
+	}
+}
 
-			sti += st_x_stride;
-			if (sti >= st_width)
-			{
-				sti -= st_width;
-			}
-		}
+void LLVLComposition::uploadTexture(PendingTexture *pending)
+{
+	LLTimer upload_timer;
 
-		stj += st_y_stride;
-		if (stj >= st_height)
-		{
-			stj -= st_height;
-		}
-	}
+	const LLTerrainCompositor::Params &params = pending->mCompositor->getParams();
+	S32 width = params.mXEnd - params.mXBegin;
+	S32 height = params.mYEnd - params.mYBegin;
 
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
 	if (!texturep->hasGLTexture())
 	{
-		texturep->createGLTexture(0, raw);
+		texturep->createGLTexture(0, pending->mRaw);
 	}
-	texturep->setSubImage(raw, tex_x_begin, tex_y_begin, tex_x_end - tex_x_begin, tex_y_end - tex_y_begin);
-	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
-	LLSurface::sTexelsUpdated += (tex_x_end - tex_x_begin) * (tex_y_end - tex_y_begin);
+	texturep->setSubImage(pending->mRaw, params.mXBegin, params.mYBegin, width, height);
+	LLSurface::sTextureUpdateTime += upload_timer.getElapsedTimeF32();
+	LLSurface::sTexelsUpdated += width * height;
 
 	for (S32 i = 0; i < 4; i++)
 	{
@@ -466,8 +481,11 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 		mDetailTextures[i]->setBoostLevel(LLViewerTexture::BOOST_NONE);
 		mDetailTextures[i]->setMinDiscardLevel(MAX_DISCARD_LEVEL + 1);
 	}
-	
-	return TRUE;
+
+	if (pending->mPatchp)
+	{
+		pending->mPatchp->textureGenerated();
+	}
 }
 
 LLUUID LLVLComposition::getDetailTextureID(S32 corner)
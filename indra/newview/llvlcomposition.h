@@ -27,10 +27,14 @@
 #ifndef LL_LLVLCOMPOSITION_H
 #define LL_LLVLCOMPOSITION_H
 
+#include <deque>
+
 #include "llviewerlayer.h"
 #include "llviewertexture.h"
 
 class LLSurface;
+class LLSurfacePatch;
+class LLTerrainCompositor;
 
 class LLVLComposition : public LLViewerLayer
 {
@@ -43,8 +47,15 @@ public:
 	// Viewer side hack to generate composition values
 	BOOL generateHeights(const F32 x, const F32 y, const F32 width, const F32 height);
 	BOOL generateComposition();
-	// Generate texture from composition values.
-	BOOL generateTexture(const F32 x, const F32 y, const F32 width, const F32 height);		
+	// Generate texture from composition values.  With LLJobScheduler
+	// running this only starts the compositing on its workers, and a later
+	// uploadTextures() uploads it; patchp->textureGenerated() is called
+	// either way once the texture has been updated.  Returns FALSE if the
+	// detail textures aren't ready.
+	BOOL generateTexture(LLSurfacePatch *patchp, const F32 x, const F32 y, const F32 width, const F32 height);
+	// Uploads the textures the workers have finished, in the order they
+	// were generated.
+	void uploadTextures();
 
 	// Use these as indeces ito the get/setters below that use 'corner'
 	enum ECorner
@@ -81,6 +92,24 @@ protected:
 
 	F32 mTexScaleX;
 	F32 mTexScaleY;
+
+private:
+	struct PendingTexture
+	{
+		PendingTexture();
+		~PendingTexture();
+
+		LLSurfacePatch *mPatchp;
+		LLTerrainCompositor *mCompositor;
+		// What the compositor reads and writes, kept alive until it's done
+		LLPointer<LLImageRaw> mDetailImages[CORNER_COUNT];
+		LLPointer<LLImageRaw> mRaw;
+	};
+
+	BOOL loadDetailImages();
+	void uploadTexture(PendingTexture *pending);
+
+	std::deque<PendingTexture *> mPendingTextures;
 };
 
 #endif //LL_LLVLCOMPOSITION_H
@@ -24,10 +24,14 @@
  * $/LicenseInfo$
  */
 
+
 #include "llviewerprecompiledheaders.h"
 #include "llvocache.h"
 #include "llerror.h"
+#include "llfasthash.h"
+#include "llfasttimer.h"
 #include "llregionhandle.h"
+#include "llthread.h"
 #include "llviewercontrol.h"
 
 BOOL check_read(LLAPRFile* apr_file, void* src, S32 n_bytes) 
@@ -40,6 +44,27 @@ BOOL check_write(LLAPRFile* apr_file, void* src, S32 n_bytes)
 	return apr_file->write(src, n_bytes) == n_bytes ;
 }
 
+//---------------------------------------------------------------------------
+// LLVOCacheBlock
+//---------------------------------------------------------------------------
+
+// A region's cache file, read in one piece.  The entries loaded from it
+// point into it rather than each having a copy.
+class LLVOCacheBlock : public LLThreadSafeRefCount
+{
+public:
+	LLVOCacheBlock(S32 size) : mData(new U8[size]), mSize(size) {}
+
+	U8* getData()			{ return mData; }
+	S32 getSize() const		{ return mSize; }
+
+protected:
+	~LLVOCacheBlock()		{ delete[] mData; }
+
+private:
+	U8* mData;
+	S32 mSize;
+};
 
 //---------------------------------------------------------------------------
 // LLVOCacheEntry
@@ -51,11 +76,11 @@ LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &
 	mCRC(crc),
 	mHitCount(0),
 	mDupeCount(0),
-	mCRCChangeCount(0)
+	mCRCChangeCount(0),
+	mChecksum(0),
+	mUnverified(FALSE)
 {
-	mBuffer = new U8[dp.getBufferSize()];
-	mDP.assignBuffer(mBuffer, dp.getBufferSize());
-	mDP = dp;
+	copyBuffer(dp);
 }
 
 LLVOCacheEntry::LLVOCacheEntry()
@@ -65,86 +90,54 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mHitCount(0),
 	mDupeCount(0),
 	mCRCChangeCount(0),
-	mBuffer(NULL)
+	mChecksum(0),
+	mUnverified(FALSE)
 {
-	mDP.assignBuffer(mBuffer, 0);
+	mDP.assignBuffer(NULL, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
-	: mBuffer(NULL)
+LLVOCacheEntry::LLVOCacheEntry(const IndexRecord& record, LLVOCacheBlock* block)
+	:
+	mLocalID(record.mLocalID),
+	mCRC(record.mCRC),
+	mHitCount(record.mHitCount),
+	mDupeCount(record.mDupeCount),
+	mCRCChangeCount(record.mCRCChangeCount),
+	mBlock(block),
+	mChecksum(record.mChecksum),
+	mUnverified(TRUE)
 {
-	S32 size = -1;
-	BOOL success;
-
-	mDP.assignBuffer(mBuffer, 0);
-	success = check_read(apr_file, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(apr_file, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &size, sizeof(S32));
-
-		// Corruption in the cache entries
-		if ((size > 10000) || (size < 1))
-		{
-			// We've got a bogus size, skip reading it.
-			// We won't bother seeking, because the rest of this file
-			// is likely bogus, and will be tossed anyway.
-			llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
-	{
-		mBuffer = new U8[size];
-		success = check_read(apr_file, mBuffer, size);
+	mDP.assignBuffer(block->getData() + record.mOffset, record.mSize);
+}
 
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
-	}
+LLVOCacheEntry::~LLVOCacheEntry()
+{
+	releaseBuffer();
+}
 
-	if(!success)
-	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
-	}
+void LLVOCacheEntry::copyBuffer(LLDataPackerBinaryBuffer &dp)
+{
+	releaseBuffer();
+	S32 size = dp.getBufferSize();
+	mDP.assignBuffer(new U8[size], size);
+	mDP = dp;
 }
 
-LLVOCacheEntry::~LLVOCacheEntry()
+void LLVOCacheEntry::releaseBuffer()
 {
-	if(mBuffer != mDP.getBuffer())
+	if (mBlock.notNull())
+	{
+		// Part of the block, which frees it
+		mDP.detachBuffer();
+		mBlock = NULL;
+		mUnverified = FALSE;
+	}
+	else
 	{
-		delete[] mBuffer ; //just in case
+		mDP.freeBuffer();
 	}
-	mDP.freeBuffer();
 }
 
-
 // New CRC means the object has changed.
 void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 {
@@ -155,22 +148,43 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mHitCount = 0;
 		mCRCChangeCount++;
 
-		mDP.freeBuffer();
-		mBuffer = new U8[dp.getBufferSize()];
-		mDP.assignBuffer(mBuffer, dp.getBufferSize());
-		mDP = dp;
+		copyBuffer(dp);
 	}
 }
 
 LLDataPackerBinaryBuffer *LLVOCacheEntry::getDP(U32 crc)
 {
-	if (  (mCRC != crc)
-		||(mDP.getBufferSize() == 0))
+	if (mCRC != crc)
 	{
 		//llinfos << "Not getting cache entry, invalid!" << llendl;
 		return NULL;
 	}
-	mHitCount++;
+	LLDataPackerBinaryBuffer *dp = peekDP();
+	if (dp)
+	{
+		mHitCount++;
+	}
+	return dp;
+}
+
+LLDataPackerBinaryBuffer *LLVOCacheEntry::peekDP()
+{
+	if (mDP.getBufferSize() == 0)
+	{
+		return NULL;
+	}
+	if (mUnverified)
+	{
+		if (ll_crc32c(mDP.getBuffer(), mDP.getBufferSize()) != mChecksum)
+		{
+			llwarns << "Cache entry " << mLocalID << " failed its checksum, discarding it." << llendl;
+			releaseBuffer();
+			// Let the next full update for the object replace it
+			mCRC = 0;
+			return NULL;
+		}
+		mUnverified = FALSE;
+	}
 	return &mDP;
 }
 
@@ -191,38 +205,320 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
+const U8* LLVOCacheEntry::getIndexRecord(IndexRecord& record, S32 offset) const
 {
-	BOOL success;
-	success = check_write(apr_file, (void*)&mLocalID, sizeof(U32));
-	if(success)
+	record.mLocalID = mLocalID;
+	record.mCRC = mCRC;
+	record.mHitCount = mHitCount;
+	record.mDupeCount = mDupeCount;
+	record.mCRCChangeCount = mCRCChangeCount;
+	record.mOffset = offset;
+	record.mSize = mDP.getBufferSize();
+	// Data never looked at is still what was read, so keep its checksum;
+	// if it was bad it will fail again next time.
+	record.mChecksum = mUnverified ? mChecksum : ll_crc32c(mDP.getBuffer(), record.mSize);
+	return mDP.getBuffer();
+}
+
+//-------------------------------------------------------------------
+//LLVOCache::IOThread
+//-------------------------------------------------------------------
+// Does all the reading and writing of region cache files, and updates of
+// single header entries, in the order it is asked to.  Whole header reads
+// and writes stay on the main thread, after flush().
+class LLVOCache::IOThread : public LLThread
+{
+public:
+	IOThread();
+
+	// Called from the main thread
+	void prefetch(U64 handle, const std::string& filename);
+	// Waits for the file if it hasn't been read yet.  NULL if it couldn't be.
+	LLPointer<LLVOCacheBlock> read(U64 handle, const std::string& filename);
+	void discard(U64 handle);
+	// Takes data, leaving it empty
+	void write(U64 handle, const std::string& filename, std::vector<U8>& data);
+	void remove(const std::string& filename);
+	void updateHeaderEntry(const std::string& header_filename, const HeaderEntryInfo& entry);
+	// Waits until everything asked for so far is done
+	void flush();
+	void takeFailedWrites(std::vector<U64>& handles);
+
+private:
+	struct Job
 	{
-		success = check_write(apr_file, (void*)&mCRC, sizeof(U32));
+		enum EType
+		{
+			READ,
+			WRITE,
+			REMOVE,
+			UPDATE_HEADER
+		};
+
+		Job(EType type, U64 handle, const std::string& filename)
+			: mType(type), mHandle(handle), mFilename(filename), mSerial(0)
+		{}
+
+		EType mType;
+		U64 mHandle;
+		std::string mFilename;
+		U32 mSerial;
+		std::vector<U8> mData;
+		HeaderEntryInfo mEntry;
+	};
+
+	struct Read
+	{
+		Read() : mSerial(0), mFinished(false) {}
+
+		// Of the job that answers this request.  A read that was discarded
+		// may still be queued, ahead of a write for the same region.
+		U32 mSerial;
+		bool mFinished;
+		LLPointer<LLVOCacheBlock> mBlock;
+	};
+
+	void addJob(Job* job);
+	void doJob(Job& job);
+	LLPointer<LLVOCacheBlock> readFile(const std::string& filename);
+	bool writeFile(const std::string& filename, std::vector<U8>& data);
+
+	/*virtual*/ bool runCondition();
+	/*virtual*/ void run();
+
+	// Guarded by mRunCondition
+	std::deque<Job*> mJobs;
+
+	// The rest are guarded by mDone, which is signalled as each job finishes
+	LLCondition mDone;
+	S32 mUnfinished;
+	std::map<U64, Read> mReads;
+	U32 mLastSerial;
+	std::vector<U64> mFailedWrites;
+};
+
+// A file bigger than MAX_OBJECT_CACHE_ENTRIES objects would come to is junk
+const S32 MAX_CACHE_FILE_SIZE = 64 * 1024 * 1024;
+
+LLVOCache::IOThread::IOThread()
+	: LLThread("Object cache"),
+	  mDone(NULL),
+	  mUnfinished(0),
+	  mLastSerial(0)
+{
+}
+
+void LLVOCache::IOThread::addJob(Job* job)
+{
+	mDone.lock();
+	mUnfinished++;
+	mDone.unlock();
+
+	lockData();
+	mJobs.push_back(job);
+	unlockData();
+
+	wake();
+}
+
+void LLVOCache::IOThread::prefetch(U64 handle, const std::string& filename)
+{
+	Job* job = NULL;
+	mDone.lock();
+	if (mReads.find(handle) == mReads.end())
+	{
+		job = new Job(Job::READ, handle, filename);
+		job->mSerial = ++mLastSerial;
+		mReads[handle].mSerial = job->mSerial;
 	}
-	if(success)
+	mDone.unlock();
+
+	if (job)
 	{
-		success = check_write(apr_file, (void*)&mHitCount, sizeof(S32));
+		addJob(job);
 	}
-	if(success)
+}
+
+LLPointer<LLVOCacheBlock> LLVOCache::IOThread::read(U64 handle, const std::string& filename)
+{
+	prefetch(handle, filename);
+
+	LLPointer<LLVOCacheBlock> block;
+	mDone.lock();
+	std::map<U64, Read>::iterator iter = mReads.find(handle);
+	while (!iter->second.mFinished)
 	{
-		success = check_write(apr_file, (void*)&mDupeCount, sizeof(S32));
+		mDone.wait();
+		iter = mReads.find(handle);
 	}
-	if(success)
+	block = iter->second.mBlock;
+	mReads.erase(iter);
+	mDone.unlock();
+	return block;
+}
+
+void LLVOCache::IOThread::discard(U64 handle)
+{
+	// A read still queued carries on but its result is dropped
+	mDone.lock();
+	mReads.erase(handle);
+	mDone.unlock();
+}
+
+void LLVOCache::IOThread::write(U64 handle, const std::string& filename, std::vector<U8>& data)
+{
+	Job* job = new Job(Job::WRITE, handle, filename);
+	job->mData.swap(data);
+	addJob(job);
+}
+
+void LLVOCache::IOThread::remove(const std::string& filename)
+{
+	addJob(new Job(Job::REMOVE, 0, filename));
+}
+
+void LLVOCache::IOThread::updateHeaderEntry(const std::string& header_filename, const HeaderEntryInfo& entry)
+{
+	Job* job = new Job(Job::UPDATE_HEADER, entry.mHandle, header_filename);
+	job->mEntry = entry;
+	addJob(job);
+}
+
+void LLVOCache::IOThread::flush()
+{
+	mDone.lock();
+	while (mUnfinished > 0)
 	{
-		success = check_write(apr_file, (void*)&mCRCChangeCount, sizeof(S32));
+		mDone.wait();
 	}
-	if(success)
+	mDone.unlock();
+}
+
+void LLVOCache::IOThread::takeFailedWrites(std::vector<U64>& handles)
+{
+	mDone.lock();
+	handles.swap(mFailedWrites);
+	mFailedWrites.clear();
+	mDone.unlock();
+}
+
+bool LLVOCache::IOThread::runCondition()
+{
+	// mRunCondition is locked
+	return !mJobs.empty();
+}
+
+void LLVOCache::IOThread::run()
+{
+	while (!isQuitting())
 	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(apr_file, (void*)&size, sizeof(S32));
-	
-		if(success)
+		checkPause();
+
+		Job* job = NULL;
+		lockData();
+		if (!mJobs.empty())
+		{
+			job = mJobs.front();
+			mJobs.pop_front();
+		}
+		unlockData();
+
+		if (job)
 		{
-			success = check_write(apr_file, (void*)mBuffer, size);
+			doJob(*job);
+			delete job;
+
+			mDone.lock();
+			mUnfinished--;
+			mDone.broadcast();
+			mDone.unlock();
 		}
 	}
+}
 
-	return success ;
+void LLVOCache::IOThread::doJob(Job& job)
+{
+	switch (job.mType)
+	{
+	case Job::READ:
+	{
+		LLPointer<LLVOCacheBlock> block = readFile(job.mFilename);
+		mDone.lock();
+		std::map<U64, Read>::iterator iter = mReads.find(job.mHandle);
+		if (iter != mReads.end() && iter->second.mSerial == job.mSerial)
+		{
+			iter->second.mBlock = block;
+			iter->second.mFinished = true;
+		}
+		mDone.unlock();
+		break;
+	}
+	case Job::WRITE:
+		if (!writeFile(job.mFilename, job.mData))
+		{
+			llwarns << "Failed to write object cache file " << job.mFilename << llendl;
+			LLAPRFile::remove(job.mFilename, getLocalAPRFilePool());
+			mDone.lock();
+			mFailedWrites.push_back(job.mHandle);
+			mDone.unlock();
+		}
+		break;
+	case Job::REMOVE:
+		LLAPRFile::remove(job.mFilename, getLocalAPRFilePool());
+		break;
+	case Job::UPDATE_HEADER:
+	{
+		LLAPRFile apr_file(job.mFilename, APR_WRITE|APR_BINARY, getLocalAPRFilePool());
+		apr_file.seek(APR_SET, job.mEntry.mIndex * sizeof(HeaderEntryInfo) + sizeof(HeaderMetaInfo)) ;
+		if (!check_write(&apr_file, (void*)&job.mEntry, sizeof(HeaderEntryInfo)))
+		{
+			llwarns << "Failed to update cache header index " << job.mEntry.mIndex << ". handle = " << job.mHandle << llendl;
+		}
+		break;
+	}
+	}
+}
+
+LLPointer<LLVOCacheBlock> LLVOCache::IOThread::readFile(const std::string& filename)
+{
+	S32 size = LLAPRFile::size(filename, getLocalAPRFilePool());
+	if (size <= 0)
+	{
+		return NULL;
+	}
+	if (size > MAX_CACHE_FILE_SIZE)
+	{
+		llwarns << "Object cache file " << filename << " is " << size << " bytes, ignoring it." << llendl;
+		return NULL;
+	}
+
+	LLPointer<LLVOCacheBlock> block = new LLVOCacheBlock(size);
+	if (LLAPRFile::readEx(filename, block->getData(), 0, size, getLocalAPRFilePool()) != size)
+	{
+		return NULL;
+	}
+	return block;
+}
+
+bool LLVOCache::IOThread::writeFile(const std::string& filename, std::vector<U8>& data)
+{
+	// Write beside the old file and then replace it, so that a crash part
+	// way through leaves one or the other.
+	std::string temp_filename = filename + ".tmp";
+	bool success = true;
+	{
+		LLAPRFile apr_file(temp_filename, APR_CREATE|APR_WRITE|APR_BINARY|APR_TRUNCATE, getLocalAPRFilePool());
+		success = check_write(&apr_file, &data[0], (S32)data.size());
+	}
+	if (success)
+	{
+		success = LLAPRFile::rename(temp_filename, filename, getLocalAPRFilePool());
+	}
+	if (!success)
+	{
+		LLAPRFile::remove(temp_filename, getLocalAPRFilePool());
+	}
+	return success;
 }
 
 //-------------------------------------------------------------------
@@ -237,6 +533,15 @@ const U32 INVALID_TIME = 0 ;
 const char* object_cache_dirname = "objectcache";
 const char* header_filename = "object.cache";
 
+// A region file starts with the region's cache id and the number of
+// entries, then an LLVOCacheEntry::IndexRecord for each, then their data.
+const S32 REGION_FILE_HEADER_SIZE = UUID_BYTES + sizeof(S32);
+// Largest entry data we'll believe
+const S32 MAX_ENTRY_SIZE = 10000;
+
+static LLFastTimer::DeclareTimer FTM_READ_OBJECT_CACHE("Read Object Cache");
+static LLFastTimer::DeclareTimer FTM_WRITE_OBJECT_CACHE("Write Object Cache");
+
 LLVOCache* LLVOCache::sInstance = NULL;
 
 //static 
@@ -269,7 +574,8 @@ LLVOCache::LLVOCache():
 	mInitialized(FALSE),
 	mReadOnly(TRUE),
 	mNumEntries(0),
-	mCacheSize(1)
+	mCacheSize(1),
+	mIOThread(NULL)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 	mLocalAPRFilePoolp = new LLVolatileAPRPool() ;
@@ -277,6 +583,13 @@ LLVOCache::LLVOCache():
 
 LLVOCache::~LLVOCache()
 {
+	if(mIOThread)
+	{
+		mIOThread->flush();
+		mIOThread->shutdown();
+		delete mIOThread;
+		mIOThread = NULL;
+	}
 	if(mEnabled)
 	{
 		writeCacheHeader();
@@ -308,6 +621,12 @@ void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
 	}
 	mInitialized = TRUE ;
 
+	if(!mIOThread)
+	{
+		mIOThread = new IOThread();
+		mIOThread->start();
+	}
+
 	setDirNames(location);
 	if (!mReadOnly)
 	{
@@ -341,6 +660,11 @@ void LLVOCache::removeCache(ELLPath location)
 
 	llinfos << "about to remove the object cache due to settings." << llendl ;
 
+	if(mIOThread)
+	{
+		mIOThread->flush();
+	}
+
 	//std::string delem = gDirUtilp->getDirDelimiter();
 	std::string mask = "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
@@ -363,6 +687,8 @@ void LLVOCache::removeCache()
 
 	llinfos << "about to remove the object cache due to some error." << llendl ;
 
+	mIOThread->flush();
+
 	//std::string delem = gDirUtilp->getDirDelimiter();
 	std::string mask = "*";
 	llinfos << "Removing cache at " << mObjectCacheDirName << llendl;
@@ -403,10 +729,21 @@ void LLVOCache::removeEntry(U64 handle)
 	{
 		return ;
 	}
+	mIOThread->discard(handle) ;
 	HeaderEntryInfo* entry = iter->second ;
 	removeEntry(entry) ;
 }
 
+void LLVOCache::removeFailedEntries()
+{
+	std::vector<U64> handles;
+	mIOThread->takeFailedWrites(handles);
+	for(U32 i = 0 ; i < handles.size() ; i++)
+	{
+		removeEntry(handles[i]) ;
+	}
+}
+
 void LLVOCache::clearCacheInMemory()
 {
 	if(!mHeaderEntryQueue.empty()) 
@@ -443,7 +780,7 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 
 	std::string filename;
 	getObjectCacheFilename(entry->mHandle, filename);
-	LLAPRFile::remove(filename, mLocalAPRFilePoolp);
+	mIOThread->remove(filename);
 	entry->mTime = INVALID_TIME ;
 	updateEntry(entry) ; //update the head file.
 }
@@ -583,12 +920,33 @@ void LLVOCache::writeCacheHeader()
 	return ;
 }
 
-BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
+void LLVOCache::updateEntry(const HeaderEntryInfo* entry)
+{
+	mIOThread->updateHeaderEntry(mHeaderFileName, *entry) ;
+}
+
+void LLVOCache::prefetch(U64 handle)
 {
-	LLAPRFile apr_file(mHeaderFileName, APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
-	apr_file.seek(APR_SET, entry->mIndex * sizeof(HeaderEntryInfo) + sizeof(HeaderMetaInfo)) ;
+	if(!mEnabled || !mInitialized)
+	{
+		return ;
+	}
+	if(mHandleEntryMap.find(handle) == mHandleEntryMap.end()) //no cache
+	{
+		return ;
+	}
+
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	mIOThread->prefetch(handle, filename) ;
+}
 
-	return check_write(&apr_file, (void*)entry, sizeof(HeaderEntryInfo)) ;
+void LLVOCache::discardPrefetch(U64 handle)
+{
+	if(mIOThread)
+	{
+		mIOThread->discard(handle) ;
+	}
 }
 
 void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
@@ -599,49 +957,72 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 	llassert_always(mInitialized);
+	LLFastTimer t(FTM_READ_OBJECT_CACHE);
+
+	removeFailedEntries() ;
 
 	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
 	if(iter == mHandleEntryMap.end()) //no cache
 	{
 		llwarns << "No handle map entry for " << handle << llendl;
+		mIOThread->discard(handle) ;
 		return ;
 	}
 
-	bool success = true ;
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	// Usually already read, if the region was prefetch()ed
+	LLPointer<LLVOCacheBlock> block = mIOThread->read(handle, filename) ;
+
+	bool success = block.notNull() ;
+	S32 num_entries = 0 ;
+	if(success)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
-	
-		LLUUID cache_id ;
-		success = check_read(&apr_file, cache_id.mData, UUID_BYTES) ;
-	
-		if(success)
-		{		
+		if(block->getSize() < REGION_FILE_HEADER_SIZE)
+		{
+			llwarns << "Cache file " << filename << " is truncated, discarding" << llendl;
+			success = false ;
+		}
+		else
+		{
+			LLUUID cache_id ;
+			memcpy(cache_id.mData, block->getData(), UUID_BYTES) ;
 			if(cache_id != id)
 			{
 				llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
 				success = false ;
 			}
+		}
+	}
+	if(success)
+	{
+		memcpy(&num_entries, block->getData() + UUID_BYTES, sizeof(S32)) ;
+		if(num_entries < 0 ||
+		   num_entries > (block->getSize() - REGION_FILE_HEADER_SIZE) / (S32)sizeof(LLVOCacheEntry::IndexRecord))
+		{
+			llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
+			success = false ;
+		}
+	}
 
-			if(success)
-			{
-				S32 num_entries;
-				success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-	
-				for (S32 i = 0; success && i < num_entries; i++)
-				{
-					LLVOCacheEntry* entry = new LLVOCacheEntry(&apr_file);
-					if (!entry->getLocalID())
-					{
-						llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-						delete entry ;
-						success = false ;
-					}
-					cache_entry_map[entry->getLocalID()] = entry;
-				}
-			}
-		}		
+	// Only the index is looked at here.  Each entry points into the block,
+	// and its data is checked the first time it is used.
+	const S32 data_start = REGION_FILE_HEADER_SIZE + num_entries * sizeof(LLVOCacheEntry::IndexRecord) ;
+	for (S32 i = 0; success && i < num_entries; i++)
+	{
+		LLVOCacheEntry::IndexRecord record ;
+		memcpy(&record, block->getData() + REGION_FILE_HEADER_SIZE + i * sizeof(record), sizeof(record)) ;
+		if(!record.mLocalID || record.mSize < 1 || record.mSize > MAX_ENTRY_SIZE ||
+		   record.mOffset < data_start || record.mOffset > block->getSize() - record.mSize)
+		{
+			llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
+			success = false ;
+			break ;
+		}
+
+		LLVOCacheEntry*& entry = cache_entry_map[record.mLocalID] ;
+		delete entry ;
+		entry = new LLVOCacheEntry(record, block) ;
 	}
 	
 	if(!success)
@@ -663,6 +1044,7 @@ void LLVOCache::purgeEntries(U32 size)
 		HeaderEntryInfo* entry = *iter ;			
 		mHandleEntryMap.erase(entry->mHandle);
 		mHeaderEntryQueue.erase(iter) ;
+		mIOThread->discard(entry->mHandle) ;
 		removeFromCache(entry) ;
 		delete entry;
 	}
@@ -683,6 +1065,11 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		llwarns << "Not writing cache for handle " << handle << "): Cache is currently in read-only mode." << llendl;
 		return ;
 	}	
+	LLFastTimer t(FTM_WRITE_OBJECT_CACHE);
+
+	removeFailedEntries() ;
+	// Anything read ahead is about to be out of date
+	mIOThread->discard(handle) ;
 
 	HeaderEntryInfo* entry;
 	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
@@ -713,11 +1100,7 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 	}
 
 	//update cache header
-	if(!updateEntry(entry))
-	{
-		llwarns << "Failed to update cache header index " << entry->mIndex << ". handle = " << handle << llendl;
-		return ; //update failed.
-	}
+	updateEntry(entry) ;
 
 	if(!dirty_cache)
 	{
@@ -725,34 +1108,29 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
-	//write to cache file
-	bool success = true ;
-	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
-	
-		success = check_write(&apr_file, (void*)id.mData, UUID_BYTES) ;
+	// Lay the file out here, which is only copying, and leave the writing
+	// to the IO thread.  Empty entries, which can't be read back, are
+	// left out.
+	const S32 index_size = cache_entry_map.size() * sizeof(LLVOCacheEntry::IndexRecord) ;
+	std::vector<U8> data(REGION_FILE_HEADER_SIZE + index_size) ;
+	memcpy(&data[0], id.mData, UUID_BYTES) ;
 
-	
-		if(success)
+	S32 num_entries = 0 ;
+	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+	{
+		LLVOCacheEntry::IndexRecord record ;
+		const U8* buffer = iter->second->getIndexRecord(record, (S32)data.size()) ;
+		if(record.mSize <= 0)
 		{
-			S32 num_entries = cache_entry_map.size() ;
-			success = check_write(&apr_file, &num_entries, sizeof(S32));
-	
-			for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-			{
-				success = iter->second->writeToFile(&apr_file) ;
-			}
+			continue ;
 		}
+		memcpy(&data[REGION_FILE_HEADER_SIZE + num_entries * sizeof(record)], &record, sizeof(record)) ;
+		data.insert(data.end(), buffer, buffer + record.mSize) ;
+		num_entries++ ;
 	}
+	memcpy(&data[UUID_BYTES], &num_entries, sizeof(S32)) ;
 
-	if(!success)
-	{
-		removeEntry(entry) ;
-
-	}
-
-	return ;
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	mIOThread->write(handle, filename, data) ;
 }
-
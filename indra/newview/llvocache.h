@@ -24,6 +24,7 @@
  * $/LicenseInfo$
  */
 
+
 #ifndef LL_LLVOCACHE_H
 #define LL_LLVOCACHE_H
 
@@ -31,17 +32,35 @@
 #include "lldatapacker.h"
 #include "lldlinked.h"
 #include "lldir.h"
+#include "llpointer.h"
 
 
 //---------------------------------------------------------------------------
 // Cache entries
 class LLVOCacheEntry;
+class LLVOCacheBlock;
 
 class LLVOCacheEntry
 {
 public:
+	// One of these per entry at the front of a region's cache file, ahead
+	// of the entries' data.
+	struct IndexRecord
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		S32 mOffset;		// of the data from the start of the file
+		S32 mSize;
+		U32 mChecksum;		// CRC32C of the data
+	};
+
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLAPRFile* apr_file);
+	// Points into block rather than copying; the data is checked against
+	// the record's checksum the first time it is asked for.
+	LLVOCacheEntry(const IndexRecord& record, LLVOCacheBlock* block);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -51,9 +70,13 @@ public:
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
 
 	void dump() const;
-	BOOL writeToFile(LLAPRFile* apr_file) const;
+	// Fills in record for data written at offset, and returns the data.
+	const U8* getIndexRecord(IndexRecord& record, S32 offset) const;
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
+	// The data, checked the same way, without it counting as a hit.  For
+	// looking ahead at objects that haven't been asked for yet.
+	LLDataPackerBinaryBuffer *peekDP();
 	void recordHit();
 	void recordDupe() { mDupeCount++; }
 
@@ -61,17 +84,25 @@ public:
 	typedef std::map<U32, LLVOCacheEntry*>	vocache_entry_map_t;
 
 protected:
+	void copyBuffer(LLDataPackerBinaryBuffer &dp);
+	void releaseBuffer();
+
 	U32							mLocalID;
 	U32							mCRC;
 	S32							mHitCount;
 	S32							mDupeCount;
 	S32							mCRCChangeCount;
 	LLDataPackerBinaryBuffer	mDP;
-	U8							*mBuffer;
+	// Set while mDP points into a block read from the cache file, until
+	// the data has been checked against mChecksum.
+	LLPointer<LLVOCacheBlock>	mBlock;
+	U32							mChecksum;
+	BOOL						mUnverified;
 };
 
 //
-//Note: LLVOCache is not thread-safe
+// LLVOCache is called on the main thread only.  Cache file reads and writes
+// happen on a thread of its own, in the order they were asked for.
 //
 class LLVOCache
 {
@@ -105,6 +136,9 @@ private:
 	};
 	typedef std::set<HeaderEntryInfo*, header_entry_less> header_entry_queue_t;
 	typedef std::map<U64, HeaderEntryInfo*> handle_entry_map_t;
+
+	class IOThread;
+	friend class IOThread;
 private:
 	LLVOCache() ;
 
@@ -114,6 +148,11 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
+	// Start reading a region's cache file in the background, ahead of
+	// readFromCache().  discardPrefetch() if it won't be read after all.
+	void prefetch(U64 handle) ;
+	void discardPrefetch(U64 handle) ;
+
 	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
 	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
 	void removeEntry(U64 handle) ;
@@ -131,7 +170,9 @@ private:
 	void removeCache() ;
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
-	BOOL updateEntry(const HeaderEntryInfo* entry);
+	void updateEntry(const HeaderEntryInfo* entry);
+	// Drop the entries for region files the IO thread failed to write
+	void removeFailedEntries();
 	
 private:
 	BOOL                 mEnabled;
@@ -145,6 +186,7 @@ private:
 	LLVolatileAPRPool*   mLocalAPRFilePoolp ; 	
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
+	IOThread*            mIOThread;
 
 	static LLVOCache* sInstance ;
 public:
@@ -124,7 +124,7 @@ F32 LLVOPartGroup::getPartSize(S32 idx)
 {
 	if (idx < (S32) mViewerPartGroupp->mParticles.size())
 	{
-		return mViewerPartGroupp->mParticles[idx]->mScale.mV[0];
+		return mViewerPartGroupp->getPool().getScale(idx).mV[0];
 	}
 
 	return 0.f;
@@ -189,11 +189,13 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 	mDepth = 0.f;
 	S32 i = 0 ;
 	LLVector3 camera_agent = getCameraPosition();
+	const LLPartPool &pool = mViewerPartGroupp->getPool();
 	for (i = 0 ; i < (S32)mViewerPartGroupp->mParticles.size(); i++)
 	{
 		const LLViewerPart *part = mViewerPartGroupp->mParticles[i];
 
-		LLVector3 part_pos_agent(part->mPosAgent);
+		LLVector3 part_pos_agent(pool.getPosAgent(i));
+		LLVector2 part_scale(pool.getScale(i));
 		LLVector3 at(part_pos_agent - camera_agent);
 
 		F32 camera_dist_squared = at.lengthSquared();
@@ -202,7 +204,7 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 			inv_camera_dist_squared = 1.f / camera_dist_squared;
 		else
 			inv_camera_dist_squared = 1.f;
-		F32 area = part->mScale.mV[0] * part->mScale.mV[1] * inv_camera_dist_squared;
+		F32 area = part_scale.mV[0] * part_scale.mV[1] * inv_camera_dist_squared;
 		tot_area = llmax(tot_area, area);
  		
 		if (tot_area > max_area)
@@ -233,7 +235,7 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 		
 		facep->setViewerObject(this);
 
-		if (part->mFlags & LLPartData::LL_PART_EMISSIVE_MASK)
+		if (pool.getFlags(i) & LLPartData::LL_PART_EMISSIVE_MASK)
 		{
 			facep->setState(LLFace::FULLBRIGHT);
 		}
@@ -242,8 +244,8 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 			facep->clearState(LLFace::FULLBRIGHT);
 		}
 
-		facep->mCenterLocal = part->mPosAgent;
-		facep->setFaceColor(part->mColor);
+		facep->mCenterLocal = part_pos_agent;
+		facep->setFaceColor(pool.getColor(i));
 		facep->setTexture(part->mImagep);
 			
 		//check if this particle texture is replaced by a parcel media texture.
@@ -285,12 +287,13 @@ void LLVOPartGroup::getGeometry(S32 idx,
 		return;
 	}
 
-	const LLViewerPart &part = *((LLViewerPart*) (mViewerPartGroupp->mParticles[idx]));
+	const LLPartPool &pool = mViewerPartGroupp->getPool();
 
 	U32 vert_offset = mDrawable->getFace(idx)->getGeomIndex();
 
 	
-	LLVector3 part_pos_agent(part.mPosAgent);
+	LLVector3 part_pos_agent(pool.getPosAgent(idx));
+	LLVector2 part_scale(pool.getScale(idx));
 	LLVector3 camera_agent = getCameraPosition(); 
 	LLVector3 at = part_pos_agent - camera_agent;
 	LLVector3 up;
@@ -301,9 +304,9 @@ void LLVOPartGroup::getGeometry(S32 idx,
 	up = right % at;
 	up.normalize();
 
-	if (part.mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK)
+	if (pool.getFlags(idx) & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK)
 	{
-		LLVector3 normvel = part.mVelocity;
+		LLVector3 normvel = pool.getVelocity(idx);
 		normvel.normalize();
 		LLVector2 up_fracs;
 		up_fracs.mV[0] = normvel*right;
@@ -319,8 +322,8 @@ void LLVOPartGroup::getGeometry(S32 idx,
 		right.normalize();
 	}
 
-	right *= 0.5f*part.mScale.mV[0];
-	up *= 0.5f*part.mScale.mV[1];
+	right *= 0.5f*part_scale.mV[0];
+	up *= 0.5f*part_scale.mV[1];
 
 
 	LLVector3 normal = -LLViewerCamera::getInstance()->getXAxis();
@@ -338,10 +341,11 @@ void LLVOPartGroup::getGeometry(S32 idx,
 	verticesp->mV[3] = 0.f;
 	*verticesp++ = part_pos_agent - up + right;
 
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
+	LLColor4 part_color(pool.getColor(idx));
+	*colorsp++ = part_color;
+	*colorsp++ = part_color;
+	*colorsp++ = part_color;
+	*colorsp++ = part_color;
 
 	*texcoordsp++ = LLVector2(0.f, 1.f);
 	*texcoordsp++ = LLVector2(0.f, 0.f);
@@ -43,6 +43,8 @@
 #include "lldrawpoolwater.h"
 #include "llglheaders.h"
 #include "llsky.h"
+#include "llskylut.h"
+#include "llskymath.h"
 #include "llviewercamera.h"
 #include "llviewertexturelist.h"
 #include "llviewerobjectlist.h"
@@ -328,7 +330,9 @@ LLVOSky::LLVOSky(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 	mWind(0.f),
 	mForceUpdate(FALSE),
 	mWorldScale(1.f),
-	mBumpSunDir(0.f, 0.f, 1.f)
+	mBumpSunDir(0.f, 0.f, 1.f),
+	mSkyLUT(new LLSkyLUT),
+	mNextSkyLUT(new LLSkyLUT)
 {
 	bool error = false;
 	
@@ -406,6 +410,11 @@ LLVOSky::~LLVOSky()
 	// This needs to be done for each texture
 
 	mCubeMap = NULL;
+
+	delete mSkyLUT;
+	mSkyLUT = NULL;
+	delete mNextSkyLUT;
+	mNextSkyLUT = NULL;
 }
 
 void LLVOSky::init()
@@ -415,6 +424,7 @@ void LLVOSky::init()
 		(color_intens(LLHaze::calcAirSca(0)) + haze_int);
 
 	calcAtmospherics();
+	startSkyLUT(false);
 
 	// Initialize the cached normalized direction vectors
 	for (S32 side = 0; side < 6; ++side)
@@ -553,38 +563,64 @@ void LLVOSky::createSkyTexture(const S32 side, const S32 tile)
 	S32 tile_x_pos = tile_x * sTileResX;
 	S32 tile_y_pos = tile_y * sTileResY;
 
+	const bool use_lut = mSkyLUT->isValid();
+
 	S32 x, y;
 	for (y = tile_y_pos; y < (tile_y_pos + sTileResY); ++y)
 	{
 		for (x = tile_x_pos; x < (tile_x_pos + sTileResX); ++x)
 		{
-			mSkyTex[side].setPixel(calcSkyColorInDir(mSkyTex[side].getDir(x, y)), x, y);
-			mShinyTex[side].setPixel(calcSkyColorInDir(mSkyTex[side].getDir(x, y), true), x, y);
+			const LLVector3 &dir = mSkyTex[side].getDir(x, y);
+			if (!use_lut || dir.mV[VZ] < -0.02f)
+			{
+				mSkyTex[side].setPixel(calcSkyColorInDir(dir), x, y);
+				mShinyTex[side].setPixel(calcSkyColorInDir(dir, true), x, y);
+				continue;
+			}
+
+			// The haze from the tables, once for both textures
+			LLVector3 Pn = LLVector3(-dir[1] , -dir[2], -dir[0]);
+			LLColor3 haze_color;
+			mSkyLUT->getHazeColor(Pn, haze_color);
+			mSkyTex[side].setPixel(calcSkyColorFromHaze(Pn, haze_color, false), x, y);
+			mShinyTex[side].setPixel(calcSkyColorFromHaze(Pn, haze_color, true), x, y);
 		}
 	}
 }
 
-static inline LLColor3 componentDiv(LLColor3 const &left, LLColor3 const & right)
+static void get_sky_params(const LLVOSky &sky, LLSkyLUT::Params &params)
 {
-	return LLColor3(left.mV[0]/right.mV[0],
-					 left.mV[1]/right.mV[1],
-					 left.mV[2]/right.mV[2]);
+	params.mDomeRadius = sky.dome_radius;
+	params.mDomeOffsetRatio = sky.dome_offset_ratio;
+	params.mSunlightColor = sky.sunlight_color;
+	params.mAmbient = sky.ambient;
+	params.mBlueDensity = sky.blue_density;
+	params.mBlueHorizon = sky.blue_horizon;
+	params.mHazeDensity = sky.haze_density;
+	params.mHazeHorizon = sky.haze_horizon;
+	params.mDensityMultiplier = sky.density_multiplier;
+	params.mMaxY = sky.max_y;
+	params.mGlow = sky.glow;
+	params.mCloudShadow = sky.cloud_shadow;
+	params.mLightNorm = sky.lightnorm;
 }
 
-
-static inline LLColor3 componentMult(LLColor3 const &left, LLColor3 const & right)
-{
-	return LLColor3(left.mV[0]*right.mV[0],
-					 left.mV[1]*right.mV[1],
-					 left.mV[2]*right.mV[2]);
-}
-
-
-static inline LLColor3 componentExp(LLColor3 const &v)
+void LLVOSky::startSkyLUT(bool on_worker)
 {
-	return LLColor3(exp(v.mV[0]),
-					 exp(v.mV[1]),
-					 exp(v.mV[2]));
+	LLSkyLUT::Params params;
+	get_sky_params(*this, params);
+	if (on_worker)
+	{
+		// Picked up at the start of the next pass through the tiles
+		mNextSkyLUT->build(params, true);
+	}
+	else
+	{
+		// Needed now, and whatever was on its way is older
+		mSkyLUT->build(params, false);
+		mNextSkyLUT->build(params, false);
+		mNextSkyLUT->invalidate();
+	}
 }
 
 static inline LLColor3 componentPow(LLColor3 const &v, F32 exponent)
@@ -602,25 +638,6 @@ static inline LLColor3 componentSaturate(LLColor3 const &v)
 }
 
 
-static inline LLColor3 componentSqrt(LLColor3 const &v)
-{
-	return LLColor3(sqrt(v.mV[0]),
-					 sqrt(v.mV[1]),
-					 sqrt(v.mV[2]));
-}
-
-static inline void componentMultBy(LLColor3 & left, LLColor3 const & right)
-{
-	left.mV[0] *= right.mV[0];
-	left.mV[1] *= right.mV[1];
-	left.mV[2] *= right.mV[2];
-}
-
-static inline LLColor3 colorMix(LLColor3 const & left, LLColor3 const & right, F32 amount)
-{
-	return (left + ((right - left) * amount));
-}
-
 static inline F32 texture2D(LLPointer<LLImageRaw> const & tex, LLVector2 const & uv)
 {
 	U16 w = tex->getWidth();
@@ -636,11 +653,6 @@ static inline F32 texture2D(LLPointer<LLImageRaw> const & tex, LLVector2 const &
 	return sample / 255.f;
 }
 
-static inline LLColor3 smear(F32 val)
-{
-	return LLColor3(val, val, val);
-}
-
 void LLVOSky::initAtmospherics(void)
 {	
 	bool error;
@@ -728,8 +740,19 @@ LLColor4 LLVOSky::calcSkyColorInDir(const LLVector3 &dir, bool isShiny)
 
 	calcSkyColorWLVert(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient,
 						vary_CloudDensity, vary_HorizontalProjection);
-	
-	LLColor3 sky_color =  calcSkyColorWLFrag(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient, 
+
+	return calcSkyColorFromHaze(Pn, vary_HazeColor, isShiny);
+}
+
+LLColor4 LLVOSky::calcSkyColorFromHaze(LLVector3 &Pn, LLColor3 &haze_color, bool isShiny)
+{
+	F32 saturation = 0.3f;
+	LLColor3 vary_CloudColorSun(0,0,0);
+	LLColor3 vary_CloudColorAmbient(0,0,0);
+	F32 vary_CloudDensity(0);
+	LLVector2 vary_HorizontalProjection[2];
+
+	LLColor3 sky_color =  calcSkyColorWLFrag(Pn, haze_color, vary_CloudColorSun, vary_CloudColorAmbient, 
 								vary_CloudDensity, vary_HorizontalProjection);
 	if (isShiny)
 	{
@@ -752,122 +775,12 @@ void LLVOSky::calcSkyColorWLVert(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLCo
 							LLColor3 & vary_CloudColorAmbient, F32 & vary_CloudDensity, 
 							LLVector2 vary_HorizontalProjection[2])
 {
-	// project the direction ray onto the sky dome.
-	F32 phi = acos(Pn[1]);
-	F32 sinA = sin(F_PI - phi);
-	F32 Plen = dome_radius * sin(F_PI + phi + asin(dome_offset_ratio * sinA)) / sinA;
-
-	Pn *= Plen;
+	LLSkyLUT::Params params;
+	get_sky_params(*this, params);
 
-	vary_HorizontalProjection[0] = LLVector2(Pn[0], Pn[2]);
-	vary_HorizontalProjection[0] /= - 2.f * Plen;
-
-	// Set altitude
-	if (Pn[1] > 0.f)
-	{
-		Pn *= (max_y / Pn[1]);
-	}
-	else
-	{
-		Pn *= (-32000.f / Pn[1]);
-	}
-
-	Plen = Pn.length();
-	Pn /= Plen;
-
-	// Initialize temp variables
-	LLColor3 sunlight = sunlight_color;
-
-	// Sunlight attenuation effect (hue and brightness) due to atmosphere
-	// this is used later for sunlight modulation at various altitudes
-	LLColor3 light_atten =
-		(blue_density * 1.0 + smear(haze_density * 0.25f)) * (density_multiplier * max_y);
-
-	// Calculate relative weights
-	LLColor3 temp2(0.f, 0.f, 0.f);
-	LLColor3 temp1 = blue_density + smear(haze_density);
-	LLColor3 blue_weight = componentDiv(blue_density, temp1);
-	LLColor3 haze_weight = componentDiv(smear(haze_density), temp1);
-
-	// Compute sunlight from P & lightnorm (for long rays like sky)
-	temp2.mV[1] = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, Pn[1]) * 1.0f + lightnorm[1] );
-
-	temp2.mV[1] = 1.f / temp2.mV[1];
-	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
-
-	// Distance
-	temp2.mV[2] = Plen * density_multiplier;
-
-	// Transparency (-> temp1)
-	temp1 = componentExp((temp1 * -1.f) * temp2.mV[2]);
-
-
-	// Compute haze glow
-	temp2.mV[0] = Pn * LLVector3(lightnorm);
-
-	temp2.mV[0] = 1.f - temp2.mV[0];
-		// temp2.x is 0 at the sun and increases away from sun
-	temp2.mV[0] = llmax(temp2.mV[0], .001f);	
-		// Set a minimum "angle" (smaller glow.y allows tighter, brighter hotspot)
-	temp2.mV[0] *= glow.mV[0];
-		// Higher glow.x gives dimmer glow (because next step is 1 / "angle")
-	temp2.mV[0] = pow(temp2.mV[0], glow.mV[2]);
-		// glow.z should be negative, so we're doing a sort of (1 / "angle") function
-
-	// Add "minimum anti-solar illumination"
-	temp2.mV[0] += .25f;
-
-
-	// Haze color above cloud
-	vary_HazeColor = (blue_horizon * blue_weight * (sunlight + ambient)
-				+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + ambient)
-			 );	
-
-	// Increase ambient when there are more clouds
-	LLColor3 tmpAmbient = ambient + (LLColor3::white - ambient) * cloud_shadow * 0.5f;
-
-	// Dim sunlight by cloud shadow percentage
-	sunlight *= (1.f - cloud_shadow);
-
-	// Haze color below cloud
-	LLColor3 additiveColorBelowCloud = (blue_horizon * blue_weight * (sunlight + tmpAmbient)
-				+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + tmpAmbient)
-			 );	
-
-	// Final atmosphere additive
-	componentMultBy(vary_HazeColor, LLColor3::white - temp1);
-
-	sunlight = sunlight_color;
-	temp2.mV[1] = llmax(0.f, lightnorm[1] * 2.f);
-	temp2.mV[1] = 1.f / temp2.mV[1];
-	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
-
-	// Attenuate cloud color by atmosphere
-	temp1 = componentSqrt(temp1);	//less atmos opacity (more transparency) below clouds
-
-	// At horizon, blend high altitude sky color towards the darker color below the clouds
-	vary_HazeColor +=
-		componentMult(additiveColorBelowCloud - vary_HazeColor, LLColor3::white - componentSqrt(temp1));
-		
-	if (Pn[1] < 0.f)
-	{
-		// Eric's original: 
-		// LLColor3 dark_brown(0.143f, 0.129f, 0.114f);
-		LLColor3 dark_brown(0.082f, 0.076f, 0.066f);
-		LLColor3 brown(0.430f, 0.386f, 0.322f);
-		LLColor3 sky_lighting = sunlight + ambient;
-		F32 haze_brightness = vary_HazeColor.brightness();
-
-		if (Pn[1] < -0.05f)
-		{
-			vary_HazeColor = colorMix(dark_brown, brown, -Pn[1] * 0.9f) * sky_lighting * haze_brightness;
-		}
-		
-		if (Pn[1] > -0.1f)
-		{
-			vary_HazeColor = colorMix(LLColor3::white * haze_brightness, vary_HazeColor, fabs((Pn[1] + 0.05f) * -20.f));
-		}
-	}
+	// The model lives with the tables made of it
+	F32 Plen = LLSkyLUT::projectToDome(params, Pn, &vary_HorizontalProjection[0]);
+	vary_HazeColor = LLSkyLUT::calcHazeColor(params, Pn[1], Plen, LLSkyLUT::calcGlow(params, Pn));
 }
 
 #if LL_MSVC && __MSVC_VER__ < 8
@@ -1118,6 +1031,7 @@ BOOL LLVOSky::updateSky()
                     if (mForceUpdate)
 					{
 						updateFog(LLViewerCamera::getInstance()->getFar());
+						startSkyLUT(false);
 						for (int side = 0; side < 6; side++) 
 						{
 							for (int tile = 0; tile < NUM_TILES; tile++) 
@@ -1173,11 +1087,21 @@ BOOL LLVOSky::updateSky()
 			//gPipeline.markRebuild(gSky.mVOWLSkyp->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 
 			mForceUpdate = FALSE;
+
+			// Tables for the next pass through the tiles, off the main thread
+			startSkyLUT(true);
 		}
 		else
 		{
 			const S32 side = frame / NUM_TILES;
 			const S32 tile = frame % NUM_TILES;
+			if (!frame && mNextSkyLUT->isValid())
+			{
+				// The whole pass works from the same tables, or the tiles
+				// wouldn't meet
+				std::swap(mSkyLUT, mNextSkyLUT);
+				mNextSkyLUT->invalidate();
+			}
 			createSkyTexture(side, tile);
 		}
 	}
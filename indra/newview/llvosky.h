@@ -387,6 +387,7 @@ protected:
 
 
 class LLCubeMap;
+class LLSkyLUT;
 
 // turn on floating point precision
 // in vs2003 for this class.  Otherwise
@@ -474,6 +475,8 @@ public:
 	void createSkyTexture(const S32 side, const S32 tile);
 
 	LLColor4 calcSkyColorInDir(const LLVector3& dir, bool isShiny = false);
+	// What calcSkyColorInDir() makes of a direction's haze color
+	LLColor4 calcSkyColorFromHaze(LLVector3& Pn, LLColor3& haze_color, bool isShiny);
 	
 	LLColor3 calcRadianceAtPoint(const LLVector3& pos) const
 	{
@@ -607,6 +610,12 @@ protected:
 
 	LLFrameTimer		mUpdateTimer;
 
+	// The haze tables createSkyTexture() works from, and the ones being
+	// built for the next pass through the tiles
+	LLSkyLUT			*mSkyLUT;
+	LLSkyLUT			*mNextSkyLUT;
+	void startSkyLUT(bool on_worker);
+
 public:
 	//by bao
 	//fake vertex buffer updating
@@ -44,6 +44,9 @@
 #include "llspatialpartition.h"
 
 F32 LLVOSurfacePatch::sLODFactor = 1.f;
+F32 LLVOSurfacePatch::sGeomorphFactor = 0.f;
+U32 LLVOSurfacePatch::sNumPatchRebuilds = 0;
+U32 LLVOSurfacePatch::sNumGridUpdates = 0;
 
 //============================================================================
 
@@ -140,7 +143,8 @@ LLVOSurfacePatch::LLVOSurfacePatch(const LLUUID &id, const LLPCode pcode, LLView
 		mLastNorthStride(0),
 		mLastEastStride(0),
 		mLastStride(0),
-		mLastLength(0)
+		mLastLength(0),
+		mLastMorph(0.f)
 {
 	// Terrain must draw during selection passes so it can block objects behind it.
 	mbCanSelect = TRUE;
@@ -291,6 +295,7 @@ BOOL LLVOSurfacePatch::updateGeometry(LLDrawable *drawable)
 	mLastStride = render_stride;
 	mLastNorthStride = north_stride;
 	mLastEastStride = east_stride;
+	mLastMorph = mPatchp->getMorph();
 
 	return TRUE;
 }
@@ -334,6 +339,14 @@ void LLVOSurfacePatch::getGeometry(LLStrider<LLVector3> &verticesp,
 
 	U32 index_offset = facep->getGeomIndex();
 
+	// Only changed heights, normals or composition need the grid redone; a
+	// new stride here or next door just copies out a different set of points
+	if (mPatchp->updateVertexGrid())
+	{
+		sNumGridUpdates++;
+	}
+	sNumPatchRebuilds++;
+
 	updateMainGeometry(facep, 
 					verticesp,
 					normalsp,
@@ -381,6 +394,11 @@ void LLVOSurfacePatch::updateMainGeometry(LLFace *facep,
 	patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
 	S32 vert_size = patch_size / render_stride;
 
+	const LLPatchVertexGrid &grid = mPatchp->getVertexGrid();
+	LLVector3 origin = mPatchp->getOriginAgent();
+	LLVector4a origin_agent;
+	origin_agent.set(origin.mV[VX], origin.mV[VY], 0.f);
+
 	///////////////////////////
 	//
 	// Render the main patch
@@ -403,7 +421,7 @@ void LLVOSurfacePatch::updateMainGeometry(LLFace *facep,
 			{
 				x = i * render_stride;
 				y = j * render_stride;
-				mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+				grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 				*colorsp++ = LLColor4U::white;
 				verticesp++;
 				normalsp++;
@@ -485,6 +503,11 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 	S32 length = patch_size / render_stride;
 	S32 half_length = length / 2;
 	U32 north_stride = mLastNorthStride;
+
+	const LLPatchVertexGrid &grid = mPatchp->getVertexGrid();
+	LLVector3 origin = mPatchp->getOriginAgent();
+	LLVector4a origin_agent;
+	origin_agent.set(origin.mV[VX], origin.mV[VY], 0.f);
 	
 	///////////////////////////
 	//
@@ -506,7 +529,7 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 			x = i * render_stride;
 			y = 16 - render_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			*colorsp++ = LLColor4U::white;
 			verticesp++;
 			normalsp++;
@@ -520,7 +543,7 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 		{
 			x = i * render_stride;
 			y = 16;
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -559,7 +582,7 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 			x = i * render_stride;
 			y = 16 - render_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -574,7 +597,7 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 			x = i * render_stride;
 			y = 16;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -620,7 +643,7 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 			x = i * north_stride;
 			y = 16 - render_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			*colorsp++ = LLColor4U::white;
 			verticesp++;
 			normalsp++;
@@ -635,7 +658,7 @@ void LLVOSurfacePatch::updateNorthGeometry(LLFace *facep,
 			x = i * north_stride;
 			y = 16;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -693,6 +716,11 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 
 	U32 east_stride = mLastEastStride;
 
+	const LLPatchVertexGrid &grid = mPatchp->getVertexGrid();
+	LLVector3 origin = mPatchp->getOriginAgent();
+	LLVector4a origin_agent;
+	origin_agent.set(origin.mV[VX], origin.mV[VY], 0.f);
+
 	// Stride lengths are the same
 	if (east_stride == render_stride)
 	{
@@ -707,7 +735,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 			x = 16 - render_stride;
 			y = i * render_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -720,7 +748,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 		{
 			x = 16;
 			y = i * render_stride;
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -758,7 +786,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 			x = 16 - render_stride;
 			y = i * render_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -771,7 +799,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 			x = 16;
 			y = i * render_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -815,7 +843,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 			x = 16 - render_stride;
 			y = i * east_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -828,7 +856,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 			x = 16;
 			y = i * east_stride;
 
-			mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
+			grid.getVertex(x, y, render_stride, mLastMorph, origin_agent, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
 			verticesp++;
 			normalsp++;
 			*colorsp++ = LLColor4U::white;
@@ -38,6 +38,11 @@ class LLVOSurfacePatch : public LLStaticViewerObject
 {
 public:
 	static F32 sLODFactor;
+	static F32 sGeomorphFactor;	// How far patches morph between strides, 0 to 1
+
+	// Since LLPipeline last reset its frame stats
+	static U32 sNumPatchRebuilds;
+	static U32 sNumGridUpdates;
 
 	enum
 	{
@@ -106,6 +111,7 @@ protected:
 	S32				mLastEastStride;
 	S32				mLastStride;
 	S32				mLastLength;
+	F32				mLastMorph;
 
 	void getGeomSizesMain(const S32 stride, S32 &num_vertices, S32 &num_indices);
 	void getGeomSizesNorth(const S32 stride, const S32 north_stride,
@@ -383,7 +383,16 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 		if (update_type != OUT_TERSE_IMPROVED)
 		{
 			LLVolumeParams volume_params;
-			BOOL res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
+			BOOL res = TRUE;
+			const LLVolumeParams* decoded_params = gObjectList.takeDecodedVolumeParams(dp);
+			if (decoded_params)
+			{
+				volume_params = *decoded_params;
+			}
+			else
+			{
+				res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
+			}
 			if (!res)
 			{
 				llwarns << "Bogus volume parameters in object " << getID() << llendl;
@@ -396,7 +405,8 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			{
 				markForUpdate(TRUE);
 			}
-			S32 res2 = unpackTEMessage(*dp);
+			const LLTEContents* decoded_tes = gObjectList.takeDecodedTEs(dp);
+			S32 res2 = decoded_tes ? applyParsedTEMessage(*decoded_tes) : unpackTEMessage(*dp);
 			if (TEM_INVALID == res2)
 			{
 				// There's something bogus in the data that we're unpacking.
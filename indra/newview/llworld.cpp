@@ -116,6 +116,7 @@ LLWorld::LLWorld() :
 void LLWorld::destroyClass()
 {
 	mHoleWaterObjects.clear();
+	mRegionPrefetcher.clear();
 	gObjectList.destroy();
 	for(region_list_t::iterator region_it = mRegionList.begin(); region_it != mRegionList.end(); )
 	{
@@ -654,6 +655,9 @@ void LLWorld::updateRegions(F32 max_update_time)
 		max_time = llmin(max_time, max_update_time*.1f);
 		did_one |= regionp->idleUpdate(max_update_time);
 	}
+
+	// Get ahead of the region the agent is heading into
+	mRegionPrefetcher.update();
 }
 
 void LLWorld::updateParticles()
@@ -1056,6 +1060,7 @@ void LLWorld::getInfo(LLSD& info)
 		regionp->getInfo(region_info);
 		info["World"].append(region_info);
 	}
+	mRegionPrefetcher.getInfo(info["RegionPrefetch"]);
 }
 
 void LLWorld::disconnectRegions()
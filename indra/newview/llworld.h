@@ -36,6 +36,7 @@
 
 #include "llmath.h"
 #include "v3math.h"
+#include "llregionprefetcher.h"
 #include "llsingleton.h"
 #include "llstring.h"
 #include "llviewerpartsim.h"
@@ -181,6 +182,8 @@ private:
 
 	BOOL mClassicCloudsEnabled;
 
+	LLRegionPrefetcher mRegionPrefetcher;
+
 	////////////////////////////
 	//
 	// Data for "Fake" objects
@@ -68,6 +68,7 @@
 #include "llhudtext.h"
 #include "lllightconstants.h"
 #include "llmeshrepository.h"
+#include "llocclusionraster.h"
 #include "llresmgr.h"
 #include "llselectmgr.h"
 #include "llsky.h"
@@ -88,6 +89,7 @@
 #include "llvotree.h"
 #include "llvovolume.h"
 #include "llvosurfacepatch.h"
+#include "llsurface.h"
 #include "llvowater.h"
 #include "llvotree.h"
 #include "llvopartgroup.h"
@@ -297,6 +299,7 @@ BOOL	LLPipeline::sRenderBeacons = FALSE;
 BOOL	LLPipeline::sRenderHighlight = TRUE;
 BOOL	LLPipeline::sForceOldBakedUpload = FALSE;
 S32		LLPipeline::sUseOcclusion = 0;
+BOOL	LLPipeline::sSoftwareOcclusion = FALSE;
 BOOL	LLPipeline::sDelayVBUpdate = TRUE;
 BOOL	LLPipeline::sAutoMaskAlphaDeferred = TRUE;
 BOOL	LLPipeline::sAutoMaskAlphaNonDeferred = FALSE;
@@ -363,6 +366,8 @@ LLPipeline::LLPipeline() :
 	mRenderDebugFeatureMask(0),
 	mRenderDebugMask(0),
 	mOldRenderDebugMask(0),
+	mOcclusionRaster(NULL),
+	mOcclusionRasterReady(false),
 	mGroupQ1Locked(false),
 	mGroupQ2Locked(false),
 	mLastRebuildPool(NULL),
@@ -534,6 +539,11 @@ void LLPipeline::cleanup()
 
 	mMovedBridge.clear();
 
+	mOccluders.clear();
+	delete mOcclusionRaster;
+	mOcclusionRaster = NULL;
+	mOcclusionRasterReady = false;
+
 	mInitialized = FALSE;
 }
 
@@ -1460,6 +1470,10 @@ void LLPipeline::resetFrameStats()
 	assertInitialized();
 
 	LLViewerStats::getInstance()->mTrianglesDrawnStat.addValue(mTrianglesDrawn/1000.f);
+	LLViewerStats::getInstance()->mTerrainPatchRebuildsStat.addValue(LLVOSurfacePatch::sNumPatchRebuilds);
+	LLViewerStats::getInstance()->mTerrainGridUpdatesStat.addValue(LLVOSurfacePatch::sNumGridUpdates);
+	LLVOSurfacePatch::sNumPatchRebuilds = 0;
+	LLVOSurfacePatch::sNumGridUpdates = 0;
 
 	if (mBatchCount > 0)
 	{
@@ -1991,6 +2005,15 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 
 	LLGLDepthTest depth(GL_TRUE, GL_FALSE);
 
+	if (LLViewerCamera::sCurCameraID == LLViewerCamera::CAMERA_WORLD)
+	{
+		mOcclusionRasterReady = false;
+		if (sUseOcclusion > 1 && sSoftwareOcclusion)
+		{
+			buildOcclusionRaster(camera);
+		}
+	}
+
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
@@ -2020,6 +2043,11 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 
 	camera.disableUserClipPlane();
 
+	if (LLViewerCamera::sCurCameraID == LLViewerCamera::CAMERA_WORLD && mOcclusionRasterReady)
+	{
+		gatherOccluders(camera);
+	}
+
 	if (hasRenderType(LLPipeline::RENDER_TYPE_SKY) && 
 		gSky.mVOSkyp.notNull() && 
 		gSky.mVOSkyp->mDrawable.notNull())
@@ -2057,6 +2085,188 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 	}
 }
 
+static LLFastTimer::DeclareTimer FTM_OCCLUSION_RASTER("Occlusion Raster");
+
+// Boxes no bigger than this across their two largest sides aren't worth
+// rasterizing
+static const F32 MIN_OCCLUDER_AREA = 16.f;
+// Nor are more than this many, the biggest and nearest kept
+static const U32 MAX_OCCLUDERS = 256;
+
+// Whether drawablep is a plain box that stays put and hides everything
+// behind it
+static bool is_box_occluder(LLDrawable* drawablep)
+{
+	if (drawablep->isDead() || drawablep->isActive() ||
+		drawablep->isState(LLDrawable::FORCE_INVISIBLE) ||
+		drawablep->getNumFaces() == 0)
+	{
+		return false;
+	}
+
+	LLViewerObject* vobj = drawablep->getVObj();
+	if (!vobj || vobj->isDead() ||
+		vobj->getPCode() != LL_PCODE_VOLUME ||
+		vobj->isAttachment() ||
+		vobj->getMaxScale()*vobj->getMidScale() < MIN_OCCLUDER_AREA)
+	{
+		return false;
+	}
+
+	// Default parameters make a box, and anything cut, hollowed, twisted
+	// or sculpted differs from them
+	static const LLVolumeParams box_params;
+	const LLVolume* volume = vobj->getVolume();
+	if (!volume || volume->getParams() != box_params)
+	{
+		return false;
+	}
+
+	for (U8 te = 0; te < vobj->getNumTEs(); te++)
+	{
+		const LLTextureEntry* tep = vobj->getTE(te);
+		const LLViewerTexture* imagep = vobj->getTEImage(te);
+		if (!tep || tep->getColor().mV[VALPHA] < 1.f || !imagep)
+		{
+			return false;
+		}
+		// Unknown yet, or with alpha
+		const S8 components = imagep->getComponents();
+		if (components != 1 && components != 3)
+		{
+			return false;
+		}
+	}
+
+	for (S32 i = 0; i < drawablep->getNumFaces(); i++)
+	{
+		const U32 pool_type = drawablep->getFace(i)->getPoolType();
+		if (pool_type == LLDrawPool::POOL_ALPHA || pool_type == LLDrawPool::POOL_INVISIBLE)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void LLPipeline::buildOcclusionRaster(LLCamera& camera)
+{
+	LLFastTimer t(FTM_OCCLUSION_RASTER);
+
+	if (!mOcclusionRaster)
+	{
+		mOcclusionRaster = new LLOcclusionRaster();
+	}
+
+	// This frame's world camera, agent space to clip space.  The last
+	// frame's would put the occluders where they were a frame ago.
+	LLMatrix4a view_proj;
+	for (S32 col = 0; col < 4; col++)
+	{
+		F32 v[4];
+		for (S32 row = 0; row < 4; row++)
+		{
+			F64 sum = 0.0;
+			for (S32 k = 0; k < 4; k++)
+			{
+				sum += gGLProjection[k*4 + row]*gGLModelView[col*4 + k];
+			}
+			v[row] = (F32) sum;
+		}
+		view_proj.mMatrix[col].set(v[0], v[1], v[2], v[3]);
+	}
+	mOcclusionRaster->begin(view_proj, camera.getNear());
+
+	if (hasRenderType(RENDER_TYPE_TERRAIN))
+	{
+		// The terrain occluders lie under the land, so they only hide
+		// anything from above it
+		const LLVector3 origin = camera.getOrigin();
+		if (origin.mV[VZ] > LLWorld::getInstance()->resolveLandHeightAgent(origin))
+		{
+			for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
+					iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
+			{
+				(*iter)->getLand().addOccluders(*mOcclusionRaster);
+			}
+		}
+	}
+
+	if (hasRenderType(RENDER_TYPE_VOLUME))
+	{
+		LLVector4a center;
+		LLVector4a axes[3];
+		for (LLDrawable::drawable_vector_t::iterator iter = mOccluders.begin(); iter != mOccluders.end(); ++iter)
+		{
+			// Picked last frame, so may have changed since
+			LLDrawable* drawablep = *iter;
+			if (!is_box_occluder(drawablep))
+			{
+				continue;
+			}
+
+			LLViewerObject* vobj = drawablep->getVObj();
+			const LLQuaternion rot = vobj->getRenderRotation();
+			const LLVector3 half_scale = vobj->getScale()*0.5f;
+			center.load3(vobj->getRenderPosition().mV);
+			axes[0].load3((LLVector3::x_axis*rot*half_scale.mV[VX]).mV);
+			axes[1].load3((LLVector3::y_axis*rot*half_scale.mV[VY]).mV);
+			axes[2].load3((LLVector3::z_axis*rot*half_scale.mV[VZ]).mV);
+			mOcclusionRaster->addBox(center, axes);
+		}
+	}
+
+	mOcclusionRaster->build(true);
+	mOcclusionRasterReady = true;
+}
+
+void LLPipeline::gatherOccluders(LLCamera& camera)
+{
+	LLFastTimer t(FTM_OCCLUSION_RASTER);
+
+	// Biggest on screen first
+	std::vector<std::pair<F32, LLDrawable*> > candidates;
+	const LLVector3 origin = camera.getOrigin();
+	for (S32 pass = 0; pass < 2; pass++)
+	{
+		LLCullResult::sg_list_t::iterator begin = pass ? sCull->beginDrawableGroups() : sCull->beginVisibleGroups();
+		LLCullResult::sg_list_t::iterator end = pass ? sCull->endDrawableGroups() : sCull->endVisibleGroups();
+		for (LLCullResult::sg_list_t::iterator iter = begin; iter != end; ++iter)
+		{
+			LLSpatialGroup* group = *iter;
+			for (LLSpatialGroup::element_iter i = group->getData().begin(); i != group->getData().end(); ++i)
+			{
+				LLDrawable* drawablep = *i;
+				if (is_box_occluder(drawablep))
+				{
+					LLViewerObject* vobj = drawablep->getVObj();
+					const F32 area = vobj->getMaxScale()*vobj->getMidScale();
+					const F32 dist_squared = llmax(dist_vec_squared(vobj->getRenderPosition(), origin), 1.f);
+					candidates.push_back(std::make_pair(-area/dist_squared, drawablep));
+				}
+			}
+		}
+	}
+
+	if (candidates.size() > MAX_OCCLUDERS)
+	{
+		std::nth_element(candidates.begin(), candidates.begin() + MAX_OCCLUDERS, candidates.end());
+		candidates.resize(MAX_OCCLUDERS);
+	}
+
+	mOccluders.clear();
+	for (U32 i = 0; i < candidates.size(); i++)
+	{
+		mOccluders.push_back(candidates[i].second);
+	}
+}
+
+bool LLPipeline::isSoftwareOccluded(const LLVector4a* bounds) const
+{
+	return mOcclusionRasterReady && mOcclusionRaster->isOccluded(bounds[0], bounds[1]);
+}
+
 void LLPipeline::markNotCulled(LLSpatialGroup* group, LLCamera& camera)
 {
 	if (group->getData().empty())
@@ -2100,7 +2310,8 @@ void LLPipeline::markNotCulled(LLSpatialGroup* group, LLCamera& camera)
 
 void LLPipeline::markOccluder(LLSpatialGroup* group)
 {
-	if (sUseOcclusion > 1 && group && !group->isOcclusionState(LLSpatialGroup::ACTIVE_OCCLUSION))
+	if (sUseOcclusion > 1 && group && !group->isOcclusionState(LLSpatialGroup::ACTIVE_OCCLUSION) &&
+		!group->usesSoftwareOcclusion())
 	{
 		LLSpatialGroup* parent = group->getParent();
 
@@ -56,6 +56,7 @@ class LLTextureEntry;
 class LLRenderFunc;
 class LLCubeMap;
 class LLCullResult;
+class LLOcclusionRaster;
 class LLVOAvatar;
 class LLGLSLShader;
 class LLCurlRequest;
@@ -150,6 +151,9 @@ public:
 	void        markVisible(LLDrawable *drawablep, LLCamera& camera);
 	void		markOccluder(LLSpatialGroup* group);
 	void		doOcclusion(LLCamera& camera);
+	// Whether the box at bounds[0], half size bounds[1], is hidden behind
+	// this frame's occluders for the world camera
+	bool		isSoftwareOccluded(const LLVector4a* bounds) const;
 	void		markNotCulled(LLSpatialGroup* group, LLCamera &camera);
 	void        markMoved(LLDrawable *drawablep, BOOL damped_motion = FALSE);
 	void        markShift(LLDrawable *drawablep);
@@ -493,6 +497,7 @@ public:
 	static BOOL				sShowHUDAttachments;
 	static BOOL				sForceOldBakedUpload; // If true will not use capabilities to upload baked textures.
 	static S32				sUseOcclusion;  // 0 = no occlusion, 1 = read only, 2 = read/write
+	static BOOL				sSoftwareOcclusion; // world camera culls against mOcclusionRaster instead of GL queries
 	static BOOL				sDelayVBUpdate;
 	static BOOL				sAutoMaskAlphaDeferred;
 	static BOOL				sAutoMaskAlphaNonDeferred;
@@ -593,6 +598,18 @@ protected:
 
 	U32						mOldRenderDebugMask;
 	
+	/////////////////////////////////////////////
+	//
+	// Software occlusion for the world camera
+	//
+	void buildOcclusionRaster(LLCamera& camera);
+	// Picks the boxes in view this frame to occlude with next frame
+	void gatherOccluders(LLCamera& camera);
+
+	LLOcclusionRaster*				mOcclusionRaster;
+	bool							mOcclusionRasterReady;
+	LLDrawable::drawable_vector_t	mOccluders;
+
 	/////////////////////////////////////////////
 	//
 	//
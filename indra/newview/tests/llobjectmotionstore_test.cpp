@@ -0,0 +1,277 @@
+/**
+ * @file   llobjectmotionstore_test.cpp
+ * @brief  Test for llobjectmotionstore.cpp
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llobjectmotionstore.h"
+
+#include <vector>
+
+#include "indra_constants.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	// What LLViewerObject works out for itself without the store
+	struct Motion
+	{
+		LLVector3 mVelocity;
+		LLVector3 mAcceleration;
+		LLVector3 mAngularVelocity;
+		F32 mTimeDilation;
+		F64 mLastInterpUpdateSecs;
+
+		void predict(F64 time, F32& dt, bool& moving, LLVector3& displacement,
+					 LLVector3& delta_v, bool& spinning, F32& angle) const
+		{
+			F32 dt_raw = (F32)(time - mLastInterpUpdateSecs);
+			dt = mTimeDilation * dt_raw;
+			moving = !(mAcceleration.isExactlyZero() && mVelocity.isExactlyZero());
+			displacement = (mVelocity + (0.5f * (dt-PHYSICS_TIMESTEP)) * mAcceleration) * dt;
+			delta_v = mAcceleration * dt;
+			F32 omega = mAngularVelocity.magVecSquared();
+			spinning = omega > 0.00001f;
+			angle = 0.f;
+			if (spinning)
+			{
+				omega = sqrt(omega);
+				angle = omega * dt;
+			}
+		}
+	};
+
+	F32 random_component(U32& seed, F32 range)
+	{
+		seed = seed * 1103515245 + 12345;
+		S32 value = (S32)((seed >> 8) & 0xFFFF) - 0x8000;
+		// A quarter of them exactly zero, like most objects' acceleration
+		return (seed >> 30) == 0 ? 0.f : range * (F32)value / 32768.f;
+	}
+
+	Motion make_motion(U32& seed)
+	{
+		Motion motion;
+		motion.mVelocity.setVec(random_component(seed, 20.f), random_component(seed, 20.f),
+								random_component(seed, 20.f));
+		motion.mAcceleration.setVec(0.f, 0.f, random_component(seed, 9.8f));
+		motion.mAngularVelocity.setVec(random_component(seed, 0.01f), 0.f,
+									   random_component(seed, 3.f));
+		motion.mTimeDilation = 1.f - 0.25f * fabsf(random_component(seed, 1.f));
+		motion.mLastInterpUpdateSecs = 1000.0 - 0.05 * fabsf(random_component(seed, 1.f));
+		return motion;
+	}
+
+	void set_motion(LLObjectMotionStore& store, S32 handle, const Motion& motion)
+	{
+		store.setVelocity(handle, motion.mVelocity);
+		store.setAcceleration(handle, motion.mAcceleration);
+		store.setAngularVelocity(handle, motion.mAngularVelocity);
+		store.setTimeDilation(handle, motion.mTimeDilation);
+		store.setLastInterpUpdateSecs(handle, motion.mLastInterpUpdateSecs);
+	}
+
+	bool same_bits(F32 a, F32 b)
+	{
+		return !memcmp(&a, &b, sizeof(F32));
+	}
+}
+
+namespace tut
+{
+	struct objectmotionstore_data
+	{
+	};
+	typedef test_group<objectmotionstore_data> objectmotionstore_test;
+	typedef objectmotionstore_test::object objectmotionstore_object;
+	tut::objectmotionstore_test objectmotionstore_testcase("LLObjectMotionStore");
+
+	template<> template<>
+	void objectmotionstore_object::test<1>()
+	{
+		set_test_name("predictions match the scalar code to the bit");
+		const F64 TIME = 1000.0;
+		U32 seed = 7;
+		LLObjectMotionStore store;
+		// Not a multiple of four, for the partial last group
+		const S32 COUNT = 1001;
+		std::vector<S32> handles(COUNT);
+		std::vector<Motion> motions(COUNT);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			store.add(&handles[i]);
+			motions[i] = make_motion(seed);
+			set_motion(store, handles[i], motions[i]);
+		}
+		store.predict(TIME);
+
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			F32 dt;
+			bool moving;
+			LLVector3 displacement;
+			LLVector3 delta_v;
+			bool spinning;
+			F32 angle;
+			motions[i].predict(TIME, dt, moving, displacement, delta_v, spinning, angle);
+
+			S32 handle = handles[i];
+			ensure("predicted", store.isPredicted(handle, dt, motions[i].mVelocity, motions[i].mAcceleration));
+			ensure("spin predicted", store.isPredicted(handle, dt, motions[i].mAngularVelocity));
+			ensure_equals("moving", store.isMoving(handle), moving);
+			ensure_equals("spinning", store.isSpinning(handle), spinning);
+			LLVector3 store_displacement = store.getDisplacement(handle);
+			LLVector3 store_delta_v = store.getDeltaVelocity(handle);
+			for (S32 axis = 0; axis < 3; axis++)
+			{
+				ensure("displacement", same_bits(store_displacement.mV[axis], displacement.mV[axis]));
+				ensure("delta velocity", same_bits(store_delta_v.mV[axis], delta_v.mV[axis]));
+			}
+			if (spinning)
+			{
+				ensure("angle", same_bits(store.getSpinAngle(handle), angle));
+			}
+		}
+	}
+
+	template<> template<>
+	void objectmotionstore_object::test<2>()
+	{
+		set_test_name("changes and other times aren't predicted");
+		LLObjectMotionStore store;
+		S32 handle;
+		store.add(&handle);
+		const LLVector3 vel(1.f, 0.f, 0.f);
+		const LLVector3 accel;
+		const LLVector3 ang_vel(0.f, 0.f, 1.f);
+		store.setVelocity(handle, vel);
+		store.setAngularVelocity(handle, ang_vel);
+		store.setLastInterpUpdateSecs(handle, 10.0);
+		ensure("not yet", !store.isPredicted(handle, 0.5f, vel, accel));
+
+		store.predict(10.5);
+		ensure("predicted", store.isPredicted(handle, 0.5f, vel, accel));
+		ensure("spin predicted", store.isPredicted(handle, 0.5f, ang_vel));
+		ensure("not for another dt", !store.isPredicted(handle, 0.25f, vel, accel));
+		ensure("moving", store.isMoving(handle));
+		ensure("spinning", store.isSpinning(handle));
+
+		// The object was changed after its motion was copied in, say
+		// through an LLPrimitive pointer
+		const LLVector3 gravity(0.f, 0.f, -9.8f);
+		ensure("accelerated", !store.isPredicted(handle, 0.5f, vel, gravity));
+		ensure("stopped", !store.isPredicted(handle, 0.5f, LLVector3(), accel));
+		ensure("spin stopped", !store.isPredicted(handle, 0.5f, LLVector3()));
+		ensure("linear unaffected", store.isPredicted(handle, 0.5f, vel, accel));
+
+		// Copied in again
+		store.setAcceleration(handle, gravity);
+		ensure("changed", !store.isPredicted(handle, 0.5f, vel, gravity));
+		store.predict(10.5);
+		ensure("predicted again", store.isPredicted(handle, 0.5f, vel, gravity));
+		store.setTimeDilation(handle, 0.5f);
+		ensure("dilation changed", !store.isPredicted(handle, 0.5f, vel, gravity));
+	}
+
+	template<> template<>
+	void objectmotionstore_object::test<3>()
+	{
+		set_test_name("handles follow removals");
+		LLObjectMotionStore store;
+		const S32 COUNT = 9;
+		std::vector<S32> handles(COUNT);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			store.add(&handles[i]);
+			store.setVelocity(handles[i], LLVector3((F32)i, 0.f, 0.f));
+		}
+		store.remove(handles[2]);
+		store.remove(handles[0]);
+		store.remove(handles[8]);
+		ensure_equals("size", store.size(), COUNT - 3);
+
+		store.predict(1.0);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			if (i == 0 || i == 2 || i == 8)
+			{
+				continue;
+			}
+			ensure("in range", handles[i] >= 0 && handles[i] < store.size());
+			// Last interpolated at 0 with no acceleration: moved i * 1 second
+			ensure_equals("own entry", store.getDisplacement(handles[i]).mV[VX], (F32)i);
+		}
+	}
+
+	template<> template<>
+	void objectmotionstore_object::test<4>()
+	{
+		set_test_name("throughput");
+		const F64 TIME = 1000.0;
+		const S32 COUNT = 20000;
+		U32 seed = 11;
+		LLObjectMotionStore store;
+		std::vector<S32> handles(COUNT);
+		std::vector<Motion> motions(COUNT);
+		for (S32 i = 0; i < COUNT; i++)
+		{
+			store.add(&handles[i]);
+			motions[i] = make_motion(seed);
+			set_motion(store, handles[i], motions[i]);
+		}
+
+		const S32 FRAMES = 100;
+		LLTimer timer;
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			store.predict(TIME + frame * 0.02);
+		}
+		F64 store_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		S32 moving = 0;
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			for (S32 i = 0; i < COUNT; i++)
+			{
+				F32 dt;
+				bool is_moving;
+				LLVector3 displacement;
+				LLVector3 delta_v;
+				bool spinning;
+				F32 angle;
+				motions[i].predict(TIME + frame * 0.02, dt, is_moving, displacement, delta_v, spinning, angle);
+				moving += is_moving;
+			}
+		}
+		F64 scalar_time = timer.getElapsedTimeF64();
+		ensure("some moving", moving > 0);
+
+		llinfos << "Dead reckoning " << COUNT << " objects: store "
+				<< store_time * 1000.0 / FRAMES << " ms, scalar "
+				<< scalar_time * 1000.0 / FRAMES << " ms per frame" << llendl;
+	}
+}
@@ -0,0 +1,366 @@
+/**
+ * @file   llobjectupdatedecoder_test.cpp
+ * @brief  Test for llobjectupdatedecoder.cpp, with a replay benchmark.
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llobjectupdatedecoder.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "lldatapacker.h"
+#include "llfile.h"
+#include "lljobscheduler.h"
+#include "llpartdata.h"
+#include "material_codes.h"
+#include "llprimitive.h"
+#include "lltimer.h"
+#include "llvolumemessage.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	// A block laid out the way the simulator sends ObjectUpdateCompressed.
+	// Every third has a parent, every fifth hover text, every seventh a
+	// sound, every fourth a particle system and every sixth a media URL and
+	// name values; all are volumes with six faces.
+	std::vector<U8> make_block(S32 n)
+	{
+		std::vector<U8> data(2048);
+		LLDataPackerBinaryBuffer dp(&data[0], (S32)data.size());
+
+		LLUUID id;
+		id.mData[0] = 0x42;
+		memcpy(&id.mData[12], &n, sizeof(n));
+		U32 flags = 0;
+		if (n % 3 == 0) flags |= 0x20;
+		if (n % 5 == 0) flags |= 0x4;
+		if (n % 7 == 0) flags |= 0x10;
+		if (n % 4 == 1) flags |= 0x8 | 0x80;
+		if (n % 6 == 2) flags |= 0x200 | 0x100;
+
+		dp.packUUID(id, "ID");
+		dp.packU32(1000 + n, "LocalID");
+		dp.packU8(LL_PCODE_VOLUME, "PCode");
+		dp.packU8(0, "State");
+		dp.packU32(n * 31, "CRC");
+		dp.packU8(LL_MCODE_WOOD, "Material");
+		dp.packU8(0, "ClickAction");
+		dp.packVector3(LLVector3(1.f, 2.f, 0.5f), "Scale");
+		dp.packVector3(LLVector3(128.f, 128.f, 20.f + n), "Pos");
+		dp.packVector3(LLVector3::zero, "Rot");
+		dp.packU32(flags, "SpecialCode");
+		dp.packUUID(id, "Owner");
+		if (flags & 0x80)
+		{
+			dp.packVector3(LLVector3(0.f, 0.f, 1.f), "Omega");
+		}
+		if (flags & 0x20)
+		{
+			dp.packU32(1000 + n / 2, "ParentID");
+		}
+		if (flags & 0x4)
+		{
+			U8 color[4] = { 255, 255, 255, 255 };
+			dp.packString("For sale", "Text");
+			dp.packBinaryDataFixed(color, 4, "Color");
+		}
+		if (flags & 0x200)
+		{
+			dp.packString("http://example.com/", "MediaURL");
+		}
+		if (flags & 0x8)
+		{
+			LLPartSysData part_sys_data;
+			part_sys_data.pack(dp);
+		}
+		dp.packU8(0, "num_params");
+		if (flags & 0x10)
+		{
+			dp.packUUID(id, "SoundUUID");
+			dp.packF32(1.f, "SoundGain");
+			dp.packU8(0, "SoundFlags");
+			dp.packF32(10.f, "SoundRadius");
+		}
+		if (flags & 0x100)
+		{
+			dp.packString("Rez STRING RW DS 1", "NV");
+		}
+
+		LLVolumeParams volume_params;
+		volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+		volume_params.setBeginAndEndS(0.f, 1.f);
+		volume_params.setBeginAndEndT(0.f, 1.f);
+		volume_params.setRatio(1.f, 1.f);
+		volume_params.setTwist(0.05f * (n % 10));
+		LLVolumeMessage::packVolumeParams(&volume_params, dp);
+
+		LLPrimitive prim;
+		prim.setNumTEs(6);
+		for (U8 face = 0; face < 6; face++)
+		{
+			LLUUID texture;
+			texture.mData[0] = face;
+			texture.mData[1] = (U8)n;
+			prim.setTETexture(face, texture);
+			prim.setTEColor(face, LLColor4(1.f, 0.5f, face / 6.f, 1.f));
+		}
+		prim.packTEMessage(dp);
+
+		data.resize(dp.getCurrentSize());
+		return data;
+	}
+
+	void set_data(std::vector<LLDecodedObjectUpdate>& updates,
+				  const std::vector<std::vector<U8> >& blocks)
+	{
+		updates.resize(blocks.size());
+		for (U32 i = 0; i < blocks.size(); i++)
+		{
+			updates[i] = LLDecodedObjectUpdate();
+			updates[i].mData = &blocks[i][0];
+			updates[i].mDataSize = (S32)blocks[i].size();
+		}
+	}
+
+	bool same_decode(const LLDecodedObjectUpdate& a, const LLDecodedObjectUpdate& b)
+	{
+		if (a.mValid != b.mValid)
+		{
+			return false;
+		}
+		if (!a.mValid)
+		{
+			return true;
+		}
+		return a.mFullID == b.mFullID
+			&& a.mLocalID == b.mLocalID
+			&& a.mPCode == b.mPCode
+			&& a.mCRC == b.mCRC
+			&& a.mSpecialCode == b.mSpecialCode
+			&& a.mParentID == b.mParentID
+			&& a.mHasVolume == b.mHasVolume
+			&& a.mVolumeOffset == b.mVolumeOffset
+			&& a.mTEOffset == b.mTEOffset
+			&& a.mTEEnd == b.mTEEnd
+			&& (!a.mHasVolume || a.mVolumeParams == b.mVolumeParams)
+			&& (!a.mHasVolume || !memcmp(a.mTEContents.mImageData, b.mTEContents.mImageData,
+										 sizeof(a.mTEContents.mImageData)));
+	}
+
+	// On the calling thread and this many of the scheduler's workers
+	F64 time_decode(S32 workers, std::vector<LLDecodedObjectUpdate>& updates, S32 batch_size)
+	{
+		if (workers > 0)
+		{
+			LLJobScheduler::getInstance()->start(workers);
+		}
+		LLObjectUpdateDecoder decoder;
+		LLTimer timer;
+		for (U32 begin = 0; begin < updates.size(); begin += batch_size)
+		{
+			// One message's worth at a time, as processObjectUpdate() does
+			U32 end = llmin((U32)(begin + batch_size), (U32)updates.size());
+			std::vector<LLDecodedObjectUpdate> batch(updates.begin() + begin, updates.begin() + end);
+			decoder.decode(batch);
+			std::copy(batch.begin(), batch.end(), updates.begin() + begin);
+		}
+		F64 time = timer.getElapsedTimeF64();
+		LLJobScheduler::getInstance()->stop();
+		return time;
+	}
+}
+
+namespace tut
+{
+	struct objectupdatedecoder_data
+	{
+	};
+	typedef test_group<objectupdatedecoder_data> objectupdatedecoder_test;
+	typedef objectupdatedecoder_test::object objectupdatedecoder_object;
+	tut::objectupdatedecoder_test objectupdatedecoder_testcase("LLObjectUpdateDecoder");
+
+	template<> template<>
+	void objectupdatedecoder_object::test<1>()
+	{
+		set_test_name("decode one block");
+		for (S32 n = 0; n < 8; n++)
+		{
+			std::vector<U8> block = make_block(n);
+			LLDecodedObjectUpdate update;
+			update.mData = &block[0];
+			update.mDataSize = (S32)block.size();
+			LLObjectUpdateDecoder::decodeBlock(update);
+
+			ensure("valid", update.mValid);
+			ensure_equals("local id", update.mLocalID, (U32)(1000 + n));
+			ensure_equals("pcode", update.mPCode, (U8)LL_PCODE_VOLUME);
+			ensure_equals("crc", update.mCRC, (U32)(n * 31));
+			ensure_equals("parent", update.mParentID, (U32)(n % 3 == 0 ? 1000 + n / 2 : 0));
+			ensure("volume", update.mHasVolume);
+			ensure_equals("texture entries end the block", update.mTEEnd, (S32)block.size());
+
+			// The parsed parts are what unpacking them would give
+			LLDataPackerBinaryBuffer dp(&block[0], (S32)block.size());
+			dp.setCurrentSize(update.mVolumeOffset);
+			LLVolumeParams volume_params;
+			ensure("unpack volume", LLVolumeMessage::unpackVolumeParams(&volume_params, dp));
+			ensure("volume params", volume_params == update.mVolumeParams);
+			ensure_equals("texture entries follow", dp.getCurrentSize(), update.mTEOffset);
+			LLPrimitive unpacked;
+			unpacked.setNumTEs(6);
+			unpacked.unpackTEMessage(dp);
+			LLPrimitive applied;
+			applied.setNumTEs(6);
+			applied.applyParsedTEMessage(update.mTEContents);
+			for (U8 face = 0; face < 6; face++)
+			{
+				ensure_equals("texture", applied.getTE(face)->getID(), unpacked.getTE(face)->getID());
+				ensure("color", applied.getTE(face)->getColor() == unpacked.getTE(face)->getColor());
+			}
+		}
+	}
+
+	template<> template<>
+	void objectupdatedecoder_object::test<2>()
+	{
+		set_test_name("truncated blocks are not valid");
+		std::vector<U8> block = make_block(15);
+		for (S32 size = 0; size < (S32)block.size(); size += 7)
+		{
+			LLDecodedObjectUpdate update;
+			update.mData = &block[0];
+			update.mDataSize = size;
+			LLObjectUpdateDecoder::decodeBlock(update);
+			ensure("not valid", !update.mValid);
+		}
+	}
+
+	template<> template<>
+	void objectupdatedecoder_object::test<3>()
+	{
+		set_test_name("workers decode the same as the main thread");
+		std::vector<std::vector<U8> > blocks;
+		for (S32 n = 0; n < 1000; n++)
+		{
+			blocks.push_back(make_block(n));
+		}
+		// and a short one in the middle
+		blocks[500].resize(40);
+
+		std::vector<LLDecodedObjectUpdate> inline_updates;
+		set_data(inline_updates, blocks);
+		time_decode(0, inline_updates, 1000);
+
+		for (S32 workers = 1; workers <= 4; workers++)
+		{
+			std::vector<LLDecodedObjectUpdate> updates;
+			set_data(updates, blocks);
+			time_decode(workers, updates, 37);
+			for (U32 i = 0; i < updates.size(); i++)
+			{
+				ensure("same decode", same_decode(updates[i], inline_updates[i]));
+			}
+		}
+		ensure("short block", !inline_updates[500].mValid);
+		ensure("long block", inline_updates[501].mValid);
+	}
+
+	template<> template<>
+	void objectupdatedecoder_object::test<4>()
+	{
+		set_test_name("capture and replay");
+		std::string filename(tempnam(NULL, "obju"));
+		std::vector<std::vector<U8> > blocks;
+		for (S32 n = 0; n < 20; n++)
+		{
+			blocks.push_back(make_block(n));
+		}
+		std::vector<LLDecodedObjectUpdate> updates;
+		set_data(updates, blocks);
+		{
+			LLObjectUpdateDecoder decoder;
+			decoder.setCaptureFile(filename);
+			decoder.decode(updates);
+			decoder.setCaptureFile("");
+		}
+
+		std::vector<U8> buffer;
+		std::vector<LLDecodedObjectUpdate> replayed;
+		ensure("read", LLObjectUpdateDecoder::readCapture(filename, buffer, replayed));
+		LLFile::remove(filename);
+		ensure_equals("count", replayed.size(), blocks.size());
+		for (U32 i = 0; i < replayed.size(); i++)
+		{
+			ensure_equals("size", replayed[i].mDataSize, (S32)blocks[i].size());
+			ensure("data", !memcmp(replayed[i].mData, &blocks[i][0], blocks[i].size()));
+			LLObjectUpdateDecoder::decodeBlock(replayed[i]);
+			ensure("same decode", same_decode(replayed[i], updates[i]));
+		}
+	}
+
+	template<> template<>
+	void objectupdatedecoder_object::test<5>()
+	{
+		set_test_name("replay benchmark");
+		// A stream captured with ObjectUpdateCaptureFile, or a made up one
+		std::vector<U8> buffer;
+		std::vector<LLDecodedObjectUpdate> stream;
+		const char* capture = getenv("LL_OBJECT_UPDATE_CAPTURE");
+		std::vector<std::vector<U8> > blocks;
+		if (capture && LLObjectUpdateDecoder::readCapture(capture, buffer, stream))
+		{
+			llinfos << "Replaying " << stream.size() << " blocks from " << capture << llendl;
+		}
+		else
+		{
+			for (S32 n = 0; n < 20000; n++)
+			{
+				blocks.push_back(make_block(n));
+			}
+			set_data(stream, blocks);
+		}
+
+		// Messages carry a couple of dozen blocks after a teleport
+		const S32 BATCH_SIZE = 24;
+		std::vector<LLDecodedObjectUpdate> inline_updates(stream);
+		F64 inline_time = time_decode(0, inline_updates, BATCH_SIZE);
+		std::ostringstream times;
+		times << "0 workers " << inline_time * 1000.0 << " ms";
+		for (S32 workers = 1; workers <= 4; workers *= 2)
+		{
+			std::vector<LLDecodedObjectUpdate> updates(stream);
+			F64 time = time_decode(workers, updates, BATCH_SIZE);
+			times << ", " << workers << " workers " << time * 1000.0 << " ms";
+			for (U32 i = 0; i < updates.size(); i++)
+			{
+				ensure("same decode", same_decode(updates[i], inline_updates[i]));
+			}
+		}
+		llinfos << "Decoding " << stream.size() << " object update blocks: " << times.str() << llendl;
+	}
+}
@@ -0,0 +1,565 @@
+/**
+ * @file   llocclusionraster_test.cpp
+ * @brief  Test for llocclusionraster.cpp
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llocclusionraster.h"
+
+#include <vector>
+
+#include "llapr.h"
+#include "lljobscheduler.h"
+#include "llmemory.h"
+#include "lltimer.h"
+#include "v3math.h"
+#include "v4math.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	const F32 NEAR_CLIP = 0.1f;
+	const F32 FAR_CLIP = 512.f;
+	const F32 FOV = 1.f;
+	const F32 ASPECT = 2.f;
+
+	// A camera at eye looking at target, z up, with a GL projection
+	struct Camera
+	{
+		Camera(const LLVector3& eye, const LLVector3& target)
+		:	mEye(eye)
+		{
+			mAt = target - eye;
+			mAt.normVec();
+			mLeft = LLVector3::z_axis % mAt;
+			mLeft.normVec();
+			mUp = mAt % mLeft;
+		}
+
+		// Agent space to clip space
+		LLVector4 clip(const LLVector3& p) const
+		{
+			const LLVector3 rel = p - mEye;
+			const F32 x = -(rel * mLeft);
+			const F32 y = rel * mUp;
+			const F32 z = -(rel * mAt);
+			const F32 f = 1.f / tanf(FOV*0.5f);
+			return LLVector4(f/ASPECT*x, f*y,
+							 (FAR_CLIP + NEAR_CLIP)/(NEAR_CLIP - FAR_CLIP)*z + 2.f*FAR_CLIP*NEAR_CLIP/(NEAR_CLIP - FAR_CLIP),
+							 -z);
+		}
+
+		// The same as a matrix, column by column
+		void getViewProj(LLMatrix4a& mat) const
+		{
+			const LLVector4 origin = clip(LLVector3::zero);
+			mat.mMatrix[3].loadua(origin.mV);
+			const LLVector3 axes[3] = { LLVector3::x_axis, LLVector3::y_axis, LLVector3::z_axis };
+			for (S32 i = 0; i < 3; i++)
+			{
+				// LLVector4's minus leaves w be
+				const LLVector4 end = clip(axes[i]);
+				mat.mMatrix[i].set(end.mV[0] - origin.mV[0], end.mV[1] - origin.mV[1],
+								   end.mV[2] - origin.mV[2], end.mV[3] - origin.mV[3]);
+			}
+		}
+
+		LLVector3 mEye;
+		LLVector3 mAt;
+		LLVector3 mLeft;
+		LLVector3 mUp;
+	};
+
+	struct Box
+	{
+		LLVector3 mCenter;
+		LLVector3 mAxes[3];
+	};
+
+	struct Triangle
+	{
+		LLVector3 mV[3];
+	};
+
+	// Repeatable from one run to the next
+	struct Random
+	{
+		Random(U32 seed) : mState(seed) {}
+
+		F32 operator()(F32 lo, F32 hi)
+		{
+			mState = mState*1664525u + 1013904223u;
+			return lo + (hi - lo)*((mState >> 8) / 16777216.f);
+		}
+
+		U32 mState;
+	};
+
+	Box make_box(const LLVector3& center, const LLVector3& half, F32 angle)
+	{
+		Box box;
+		box.mCenter = center;
+		box.mAxes[0].set(cosf(angle)*half.mV[0], sinf(angle)*half.mV[0], 0.f);
+		box.mAxes[1].set(-sinf(angle)*half.mV[1], cosf(angle)*half.mV[1], 0.f);
+		box.mAxes[2].set(0.f, 0.f, half.mV[2]);
+		return box;
+	}
+
+	void add_box(LLOcclusionRaster& raster, const Box& box)
+	{
+		LLVector4a center;
+		center.load3(box.mCenter.mV);
+		LLVector4a axes[3];
+		for (S32 i = 0; i < 3; i++)
+		{
+			axes[i].load3(box.mAxes[i].mV);
+		}
+		raster.addBox(center, axes);
+	}
+
+	void box_triangles(const Box& box, std::vector<Triangle>& tris)
+	{
+		LLVector3 corners[8];
+		for (S32 i = 0; i < 8; i++)
+		{
+			corners[i] = box.mCenter;
+			for (S32 axis = 0; axis < 3; axis++)
+			{
+				corners[i] += (i & (1 << axis)) ? box.mAxes[axis] : -box.mAxes[axis];
+			}
+		}
+		const S32 faces[6][4] = { { 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 },
+								  { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 5, 7, 6 } };
+		for (S32 f = 0; f < 6; f++)
+		{
+			Triangle a = { { corners[faces[f][0]], corners[faces[f][1]], corners[faces[f][2]] } };
+			Triangle b = { { corners[faces[f][0]], corners[faces[f][2]], corners[faces[f][3]] } };
+			tris.push_back(a);
+			tris.push_back(b);
+		}
+	}
+
+	// Whether the segment from orig to orig + dir, ends left out, goes
+	// through tri, from either side
+	bool segment_hits(const LLVector3& orig, const LLVector3& dir, const Triangle& tri)
+	{
+		const LLVector3 e1 = tri.mV[1] - tri.mV[0];
+		const LLVector3 e2 = tri.mV[2] - tri.mV[0];
+		const LLVector3 p = dir % e2;
+		const F32 det = e1 * p;
+		if (fabsf(det) < 1e-8f)
+		{
+			return false;
+		}
+		const F32 inv_det = 1.f / det;
+		const LLVector3 s = orig - tri.mV[0];
+		const F32 u = (s * p)*inv_det;
+		if (u < 0.f || u > 1.f)
+		{
+			return false;
+		}
+		const LLVector3 q = s % e1;
+		const F32 v = (dir * q)*inv_det;
+		if (v < 0.f || u + v > 1.f)
+		{
+			return false;
+		}
+		const F32 t = (e2 * q)*inv_det;
+		return t > 1e-4f && t < 1.f - 1e-4f;
+	}
+
+	// The reference: whether any of a grid of points over the axis aligned
+	// box's faces is on screen with nothing between it and the eye
+	bool ray_visible(const Camera& camera, const std::vector<Triangle>& occluders,
+					 const LLVector3& center, const LLVector3& extents)
+	{
+		const S32 STEPS = 6;
+		for (S32 axis = 0; axis < 3; axis++)
+		{
+			for (S32 side = -1; side <= 1; side += 2)
+			{
+				for (S32 i = 0; i <= STEPS; i++)
+				{
+					for (S32 j = 0; j <= STEPS; j++)
+					{
+						LLVector3 offset;
+						offset.mV[axis] = side;
+						offset.mV[(axis + 1) % 3] = -1.f + 2.f*i/STEPS;
+						offset.mV[(axis + 2) % 3] = -1.f + 2.f*j/STEPS;
+						LLVector3 p = center;
+						p.mV[0] += offset.mV[0]*extents.mV[0];
+						p.mV[1] += offset.mV[1]*extents.mV[1];
+						p.mV[2] += offset.mV[2]*extents.mV[2];
+
+						const LLVector4 clip = camera.clip(p);
+						if (clip.mV[3] < NEAR_CLIP
+							|| fabsf(clip.mV[0]) > clip.mV[3] || fabsf(clip.mV[1]) > clip.mV[3])
+						{
+							continue;
+						}
+
+						bool hidden = false;
+						for (U32 t = 0; t < occluders.size() && !hidden; t++)
+						{
+							hidden = segment_hits(camera.mEye, p - camera.mEye, occluders[t]);
+						}
+						if (!hidden)
+						{
+							return true;
+						}
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	bool is_occluded(const LLOcclusionRaster& raster, const LLVector3& center, const LLVector3& extents)
+	{
+		LLVector4a c;
+		c.load3(center.mV);
+		LLVector4a e;
+		e.load3(extents.mV);
+		return raster.isOccluded(c, e);
+	}
+
+	// Rolling ground all round the camera, a row of buildings across the
+	// view, and boxes scattered behind, among and in front of them
+	struct Scene
+	{
+		enum { NUM_BOXES = 400, GROUND_SIZE = 17 };
+
+		Scene(U32 seed)
+		{
+			Random random(seed);
+			const F32 phase = random(0.f, F_TWO_PI);
+			mGround = (LLVector4a *)ll_aligned_malloc_16(GROUND_SIZE*GROUND_SIZE*sizeof(LLVector4a));
+			for (S32 j = 0; j < GROUND_SIZE; j++)
+			{
+				for (S32 i = 0; i < GROUND_SIZE; i++)
+				{
+					const F32 x = -64.f + i*16.f;
+					const F32 y = -128.f + j*16.f;
+					mGround[j*GROUND_SIZE + i].set(x, y, 2.f*sinf(x*0.05f + phase) + 2.f*sinf(y*0.07f) - 1.f);
+				}
+			}
+			for (S32 j = 0; j + 1 < GROUND_SIZE; j++)
+			{
+				for (S32 i = 0; i + 1 < GROUND_SIZE; i++)
+				{
+					const U16 v = j*GROUND_SIZE + i;
+					const U16 quad[6] = { v, v + 1, v + GROUND_SIZE + 1, v, v + GROUND_SIZE + 1, v + GROUND_SIZE };
+					mGroundIndices.insert(mGroundIndices.end(), quad, quad + 6);
+				}
+			}
+
+			for (S32 i = 0; i < 40; i++)
+			{
+				const LLVector3 center(random(20.f, 60.f), random(-40.f, 40.f), random(2.f, 15.f));
+				const LLVector3 half(random(1.f, 8.f), random(1.f, 8.f), random(2.f, 12.f));
+				mOccluders.push_back(make_box(center, half, random(0.f, F_PI)));
+			}
+			mBounds = (LLVector4a *)ll_aligned_malloc_16(NUM_BOXES*2*sizeof(LLVector4a));
+			for (S32 i = 0; i < NUM_BOXES; i++)
+			{
+				mBounds[i*2].set(random(10.f, 150.f), random(-80.f, 80.f), random(-6.f, 25.f));
+				mBounds[i*2 + 1].set(random(0.25f, 3.f), random(0.25f, 3.f), random(0.25f, 3.f));
+			}
+			mOccluded = new bool[NUM_BOXES];
+		}
+
+		~Scene()
+		{
+			ll_aligned_free_16(mGround);
+			ll_aligned_free_16(mBounds);
+			delete [] mOccluded;
+		}
+
+		void addOccluders(LLOcclusionRaster& raster) const
+		{
+			raster.addTriangles(mGround, GROUND_SIZE*GROUND_SIZE, &mGroundIndices[0], (S32)mGroundIndices.size());
+			for (U32 i = 0; i < mOccluders.size(); i++)
+			{
+				add_box(raster, mOccluders[i]);
+			}
+		}
+
+		void getTriangles(std::vector<Triangle>& tris) const
+		{
+			for (U32 i = 0; i < mGroundIndices.size(); i += 3)
+			{
+				Triangle tri;
+				for (S32 k = 0; k < 3; k++)
+				{
+					tri.mV[k].set(mGround[mGroundIndices[i + k]].getF32ptr());
+				}
+				tris.push_back(tri);
+			}
+			for (U32 i = 0; i < mOccluders.size(); i++)
+			{
+				box_triangles(mOccluders[i], tris);
+			}
+		}
+
+		LLVector4a			*mGround;
+		std::vector<U16>	mGroundIndices;
+		std::vector<Box>	mOccluders;
+		// Center and extents of each
+		LLVector4a			*mBounds;
+		bool				*mOccluded;
+	};
+}
+
+namespace tut
+{
+	struct occlusionraster_data
+	{
+		occlusionraster_data()
+		:	mCamera(LLVector3(0.f, 0.f, 8.f), LLVector3(100.f, 0.f, 6.f))
+		{
+			mCamera.getViewProj(mViewProj);
+		}
+
+		Camera		mCamera;
+		LLMatrix4a	mViewProj;
+	};
+	typedef test_group<occlusionraster_data> occlusionraster_test;
+	typedef occlusionraster_test::object occlusionraster_object;
+	tut::occlusionraster_test occlusionraster_testcase("LLOcclusionRaster");
+
+	template<> template<>
+	void occlusionraster_object::test<1>()
+	{
+		set_test_name("a wall and what is behind it");
+		LLOcclusionRaster raster;
+		ensure("nothing before it's built", !is_occluded(raster, LLVector3(40.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+
+		raster.begin(mViewProj, NEAR_CLIP);
+		raster.build(false);
+		ensure("nothing with no occluders", !is_occluded(raster, LLVector3(40.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+
+		raster.begin(mViewProj, NEAR_CLIP);
+		add_box(raster, make_box(LLVector3(20.f, 0.f, 8.f), LLVector3(0.5f, 10.f, 4.f), 0.f));
+		raster.build(false);
+		// Only the face toward the camera, the rest are back faces
+		ensure_equals("front faces", raster.getNumTriangles(), 2);
+
+		ensure("behind", is_occluded(raster, LLVector3(40.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("far behind", is_occluded(raster, LLVector3(200.f, 0.f, 8.f), LLVector3(5.f, 5.f, 5.f)));
+		ensure("beside", !is_occluded(raster, LLVector3(40.f, 30.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("in front", !is_occluded(raster, LLVector3(15.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("reaching through", !is_occluded(raster, LLVector3(20.f, 0.f, 8.f), LLVector3(2.f, 1.f, 1.f)));
+		ensure("looking over it", !is_occluded(raster, LLVector3(60.f, 0.f, 25.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("off screen", !is_occluded(raster, LLVector3(-40.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+
+		// Batched the same
+		LLVector4a bounds[8];
+		bounds[0].set(40.f, 0.f, 8.f);
+		bounds[1].set(1.f, 1.f, 1.f);
+		bounds[2].set(40.f, 30.f, 8.f);
+		bounds[3].set(1.f, 1.f, 1.f);
+		bounds[4].set(200.f, 0.f, 8.f);
+		bounds[5].set(5.f, 5.f, 5.f);
+		bounds[6].set(15.f, 0.f, 8.f);
+		bounds[7].set(1.f, 1.f, 1.f);
+		bool occluded[4];
+		raster.testBoxes(bounds, 4, occluded);
+		ensure("batched", occluded[0] && !occluded[1] && occluded[2] && !occluded[3]);
+	}
+
+	template<> template<>
+	void occlusionraster_object::test<2>()
+	{
+		set_test_name("the near plane");
+		LLOcclusionRaster raster;
+		raster.begin(mViewProj, NEAR_CLIP);
+		// Ground all around the camera, which gets clipped
+		LLVector4a verts[4];
+		verts[0].set(-200.f, -200.f, 0.f);
+		verts[1].set(200.f, -200.f, 0.f);
+		verts[2].set(200.f, 200.f, 0.f);
+		verts[3].set(-200.f, 200.f, 0.f);
+		const U16 indices[6] = { 0, 1, 2, 0, 2, 3 };
+		raster.addTriangles(verts, 4, indices, 6);
+		raster.build(false);
+		ensure("ground", raster.getNumTriangles() > 0);
+
+		ensure("under the ground", is_occluded(raster, LLVector3(50.f, 0.f, -5.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("on the ground", !is_occluded(raster, LLVector3(50.f, 0.f, 5.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("round the camera", !is_occluded(raster, LLVector3(0.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("reaching the camera", !is_occluded(raster, LLVector3(-5.f, 0.f, -5.f), LLVector3(6.f, 1.f, 4.f)));
+
+		// The ground from underneath is a back face
+		raster.begin(mViewProj, NEAR_CLIP);
+		for (S32 i = 0; i < 4; i++)
+		{
+			verts[i].getF32ptr()[2] = 20.f;
+		}
+		raster.addTriangles(verts, 4, indices, 6);
+		raster.build(false);
+		ensure_equals("culled", raster.getNumTriangles(), 0);
+
+		// A box the camera is in hides nothing
+		raster.begin(mViewProj, NEAR_CLIP);
+		add_box(raster, make_box(LLVector3(0.f, 0.f, 8.f), LLVector3(20.f, 20.f, 20.f), 0.3f));
+		raster.build(false);
+		ensure("inside", !is_occluded(raster, LLVector3(10.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+		ensure("outside", !is_occluded(raster, LLVector3(60.f, 0.f, 8.f), LLVector3(1.f, 1.f, 1.f)));
+	}
+
+	template<> template<>
+	void occlusionraster_object::test<3>()
+	{
+		set_test_name("culled sets against ray casting");
+		S32 culled = 0;
+		S32 reference_culled = 0;
+		for (U32 seed = 1; seed <= 4; seed++)
+		{
+			const Scene scene(seed);
+			LLOcclusionRaster raster;
+			raster.begin(mViewProj, NEAR_CLIP);
+			scene.addOccluders(raster);
+			raster.build(false);
+			std::vector<Triangle> tris;
+			scene.getTriangles(tris);
+
+			raster.testBoxes(scene.mBounds, Scene::NUM_BOXES, scene.mOccluded);
+			for (S32 i = 0; i < Scene::NUM_BOXES; i++)
+			{
+				const LLVector3 center(scene.mBounds[i*2].getF32ptr());
+				const LLVector3 extents(scene.mBounds[i*2 + 1].getF32ptr());
+				const bool visible = ray_visible(mCamera, tris, center, extents);
+				if (scene.mOccluded[i])
+				{
+					// Nothing it culls can be seen
+					ensure("culled only what is hidden", !visible);
+					culled++;
+				}
+				if (!visible)
+				{
+					reference_culled++;
+				}
+			}
+		}
+		llinfos << "Culled " << culled << " of " << reference_culled << " hidden" << llendl;
+		// And it finds most of what can't be
+		ensure("hidden found", reference_culled > 100 && culled*3 >= reference_culled*2);
+	}
+
+	template<> template<>
+	void occlusionraster_object::test<4>()
+	{
+		set_test_name("building on workers");
+		const Scene scene(7);
+		LLOcclusionRaster here;
+		LLOcclusionRaster there;
+		here.begin(mViewProj, NEAR_CLIP);
+		there.begin(mViewProj, NEAR_CLIP);
+		scene.addOccluders(here);
+		scene.addOccluders(there);
+		here.build(false);
+
+		LLJobScheduler::getInstance()->start(2);
+		there.build(true);
+		LLJobScheduler::getInstance()->stop();
+
+		for (S32 y = 0; y < LLOcclusionRaster::HEIGHT; y++)
+		{
+			for (S32 x = 0; x < LLOcclusionRaster::WIDTH; x++)
+			{
+				ensure("same depth", here.getDepth(x, y) == there.getDepth(x, y));
+			}
+		}
+		for (S32 i = 0; i < Scene::NUM_BOXES; i++)
+		{
+			const LLVector4a *bounds = scene.mBounds + i*2;
+			ensure("same answer", here.isOccluded(bounds[0], bounds[1]) == there.isOccluded(bounds[0], bounds[1]));
+		}
+	}
+
+	template<> template<>
+	void occlusionraster_object::test<5>()
+	{
+		set_test_name("timing");
+		const Scene scene(11);
+		LLOcclusionRaster raster;
+		const S32 FRAMES = 200;
+		LLTimer timer;
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			raster.begin(mViewProj, NEAR_CLIP);
+			scene.addOccluders(raster);
+			raster.build(false);
+		}
+		const F64 build_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		S32 culled = 0;
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			raster.testBoxes(scene.mBounds, Scene::NUM_BOXES, scene.mOccluded);
+			culled += scene.mOccluded[frame % Scene::NUM_BOXES] ? 1 : 0;
+		}
+		const F64 test_time = timer.getElapsedTimeF64();
+
+		llinfos << "Built ground and " << scene.mOccluders.size() << " boxes in " << build_time*1000000.0/FRAMES
+				<< "us, tested " << Scene::NUM_BOXES << " in " << test_time*1000000.0/FRAMES << "us" << llendl;
+		ensure("ran", culled >= 0);
+	}
+
+	template<> template<>
+	void occlusionraster_object::test<6>()
+	{
+		set_test_name("a camera that moved since the build");
+		// Built for last frame's camera, behind the wall from it
+		const Box wall = make_box(LLVector3(20.f, 0.f, 8.f), LLVector3(0.5f, 10.f, 4.f), 0.f);
+		const LLVector3 center(40.f, 0.f, 8.f);
+		const LLVector3 extents(1.f, 1.f, 1.f);
+		LLOcclusionRaster last;
+		last.begin(mViewProj, NEAR_CLIP);
+		add_box(last, wall);
+		last.build(false);
+		ensure("hidden last frame", is_occluded(last, center, extents));
+
+		// Stepped to the side, the box is in plain view past the wall's end,
+		// and only a buffer built for this frame's camera shows it
+		const Camera moved(LLVector3(0.f, 40.f, 8.f), center);
+		std::vector<Triangle> tris;
+		box_triangles(wall, tris);
+		ensure("in view", ray_visible(moved, tris, center, extents));
+
+		LLMatrix4a view_proj;
+		moved.getViewProj(view_proj);
+		LLOcclusionRaster current;
+		current.begin(view_proj, NEAR_CLIP);
+		add_box(current, wall);
+		current.build(false);
+		ensure("shown this frame", !is_occluded(current, center, extents));
+
+		// What is still behind the wall from there stays culled
+		const LLVector3 behind(40.f, -40.f, 8.f);
+		ensure("still hidden", !ray_visible(moved, tris, behind, extents) && is_occluded(current, behind, extents));
+	}
+}
@@ -0,0 +1,454 @@
+/**
+ * @file   llpartpool_test.cpp
+ * @brief  Test for llpartpool.cpp
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpartpool.h"
+
+#include <vector>
+
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	struct Source
+	{
+		LLVector3 mPosAgent;
+		LLVector3 mTargetPosAgent;
+	};
+
+	// A made up wind field, smooth enough to vary across a group
+	LLVector3 wind_at(const LLVector3 &pos_agent)
+	{
+		return LLVector3(3.f*sinf(pos_agent.mV[VX]*0.05f), 2.f*cosf(pos_agent.mV[VY]*0.07f), 0.f);
+	}
+
+	// LLViewerPartGroup::updateParticles() as it was, less the callbacks
+	// and the moving between groups.  dt is the group's time step.
+	bool old_update(LLPartState *part, const Source *source, const F32 group_dt)
+	{
+		F32 dt = group_dt - part->mSkipOffset;
+		part->mSkipOffset = 0.f;
+
+		// Update current time
+		const F32 cur_time = part->mLastUpdateTime + dt;
+		const F32 frac = cur_time / part->mMaxAge;
+
+		// "Drift" the object based on the source object
+		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		{
+			part->mPosAgent = source->mPosAgent;
+			part->mPosAgent += part->mPosOffset;
+		}
+
+		if (part->mFlags & LLPartData::LL_PART_WIND_MASK)
+		{
+			part->mVelocity *= 1.f - 0.1f*dt;
+			part->mVelocity += 0.1f*dt*wind_at(part->mPosAgent);
+		}
+
+		// Now do interpolation towards a target
+		if (part->mFlags & LLPartData::LL_PART_TARGET_POS_MASK)
+		{
+			F32 remaining = part->mMaxAge - part->mLastUpdateTime;
+			F32 step = dt / remaining;
+
+			step = llclamp(step, 0.f, 0.1f);
+			step *= 5.f;
+			LLVector3 delta_pos = source->mTargetPosAgent - part->mPosAgent;
+
+			delta_pos /= remaining;
+
+			part->mVelocity *= (1.f - step);
+			part->mVelocity += step*delta_pos;
+		}
+
+		if (part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+		{
+			LLVector3 delta_pos = source->mTargetPosAgent - source->mPosAgent;
+			part->mPosAgent = source->mPosAgent;
+			part->mPosAgent += frac*delta_pos;
+			part->mVelocity = delta_pos;
+		}
+		else
+		{
+			// Do velocity interpolation
+			part->mPosAgent += dt*part->mVelocity;
+			part->mPosAgent += 0.5f*dt*dt*part->mAccel;
+			part->mVelocity += part->mAccel*dt;
+		}
+
+		// Do a bounce test
+		if (part->mFlags & LLPartData::LL_PART_BOUNCE_MASK)
+		{
+			F32 dz = part->mPosAgent.mV[VZ] - source->mPosAgent.mV[VZ];
+			if (dz < 0)
+			{
+				part->mPosAgent.mV[VZ] += -2.f*dz;
+				part->mVelocity.mV[VZ] *= -0.75f;
+			}
+		}
+
+		// Reset the offset from the source position
+		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		{
+			part->mPosOffset = part->mPosAgent;
+			part->mPosOffset -= source->mPosAgent;
+		}
+
+		// Do color interpolation
+		if (part->mFlags & LLPartData::LL_PART_INTERP_COLOR_MASK)
+		{
+			part->mColor.setVec(part->mStartColor);
+			part->mColor *= 1.f - frac; // rgb*k
+			part->mColor %= 1.f - frac; // alpha*k
+			part->mColor += frac%(frac*part->mEndColor); // rgb,alpha
+		}
+
+		// Do scale interpolation
+		if (part->mFlags & LLPartData::LL_PART_INTERP_SCALE_MASK)
+		{
+			part->mScale.setVec(part->mStartScale);
+			part->mScale *= 1.f - frac;
+			part->mScale += frac*part->mEndScale;
+		}
+
+		part->mLastUpdateTime = cur_time;
+
+		return (part->mLastUpdateTime > part->mMaxAge) || (LLPartData::LL_PART_DEAD_MASK == part->mFlags);
+	}
+
+	// What LLViewerPartGroup::simulate() does with a pool
+	void update(LLPartPool &pool, const F32 group_dt)
+	{
+		pool.followSources();
+		for (S32 i = 0; i < pool.getCount(); i++)
+		{
+			if (pool.getFlags(i) & LLPartData::LL_PART_WIND_MASK)
+			{
+				pool.setWind(i, wind_at(pool.getPosAgent(i)));
+			}
+		}
+		pool.integrate(group_dt);
+	}
+
+	struct Random
+	{
+		U32 mSeed;
+		Random(U32 seed) : mSeed(seed) {}
+		F32 operator()(F32 lo, F32 hi)
+		{
+			mSeed = mSeed*1103515245 + 12345;
+			return lo + (hi - lo)*(F32)((mSeed >> 8) & 0xFFFF)/65536.f;
+		}
+		U32 bits()
+		{
+			mSeed = mSeed*1103515245 + 12345;
+			return mSeed >> 8;
+		}
+	};
+
+	const U32 SIM_FLAGS[] = {
+		LLPartData::LL_PART_INTERP_COLOR_MASK,
+		LLPartData::LL_PART_INTERP_SCALE_MASK,
+		LLPartData::LL_PART_BOUNCE_MASK,
+		LLPartData::LL_PART_WIND_MASK,
+		LLPartData::LL_PART_FOLLOW_SRC_MASK,
+		LLPartData::LL_PART_FOLLOW_VELOCITY_MASK,
+		LLPartData::LL_PART_TARGET_POS_MASK,
+		LLPartData::LL_PART_TARGET_LINEAR_MASK,
+		LLPartData::LL_PART_EMISSIVE_MASK
+	};
+
+	LLPartState make_part(Random &random, U32 flags, const Source &source)
+	{
+		LLPartState part;
+		part.mFlags = flags;
+		part.mMaxAge = random(0.5f, 6.f);
+		part.mLastUpdateTime = random(0.f, 0.3f);
+		part.mSkipOffset = random.bits() & 1 ? random(0.f, 0.05f) : 0.f;
+		part.mPosOffset.set(random(-2.f, 2.f), random(-2.f, 2.f), random(-1.f, 3.f));
+		part.mPosAgent = source.mPosAgent + part.mPosOffset;
+		part.mVelocity.set(random(-3.f, 3.f), random(-3.f, 3.f), random(-1.f, 4.f));
+		part.mAccel.set(random(-0.5f, 0.5f), random(-0.5f, 0.5f), random(-9.8f, 0.f));
+		part.mStartColor.set(random(0.f, 1.f), random(0.f, 1.f), random(0.f, 1.f), random(0.5f, 1.f));
+		part.mEndColor.set(random(0.f, 1.f), random(0.f, 1.f), random(0.f, 1.f), random(0.f, 0.5f));
+		part.mColor = part.mStartColor;
+		part.mStartScale.set(random(0.1f, 1.f), random(0.1f, 1.f));
+		part.mEndScale.set(random(0.1f, 4.f), random(0.1f, 4.f));
+		part.mScale = part.mStartScale;
+		return part;
+	}
+
+	template <class T>
+	bool same_bits(const T &a, const T &b)
+	{
+		return !memcmp(&a, &b, sizeof(T));
+	}
+
+	void ensure_same(const std::string &what, const LLPartState &expected, const LLPartState &actual)
+	{
+		tut::ensure(what + " position", same_bits(expected.mPosAgent, actual.mPosAgent));
+		tut::ensure(what + " velocity", same_bits(expected.mVelocity, actual.mVelocity));
+		tut::ensure(what + " offset", same_bits(expected.mPosOffset, actual.mPosOffset));
+		tut::ensure(what + " color", same_bits(expected.mColor, actual.mColor));
+		tut::ensure(what + " scale", same_bits(expected.mScale, actual.mScale));
+		tut::ensure(what + " age", same_bits(expected.mLastUpdateTime, actual.mLastUpdateTime));
+		tut::ensure(what + " skip offset", same_bits(expected.mSkipOffset, actual.mSkipOffset));
+		tut::ensure_equals(what + " flags", actual.mFlags, expected.mFlags);
+	}
+}
+
+namespace tut
+{
+	struct partpool_data
+	{
+	};
+	typedef test_group<partpool_data> partpool_test;
+	typedef partpool_test::object partpool_object;
+	tut::partpool_test partpool_testcase("LLPartPool");
+
+	template<> template<>
+	void partpool_object::test<1>()
+	{
+		set_test_name("updates match the old per-particle loop");
+		Random random(5);
+		const S32 NUM_SOURCES = 7;
+		Source sources[NUM_SOURCES];
+		for (S32 s = 0; s < NUM_SOURCES; s++)
+		{
+			sources[s].mPosAgent.set(random(0.f, 256.f), random(0.f, 256.f), random(20.f, 40.f));
+			sources[s].mTargetPosAgent.set(random(0.f, 256.f), random(0.f, 256.f), random(20.f, 40.f));
+		}
+
+		std::vector<LLPartState> expected;
+		std::vector<const Source *> expected_sources;
+		LLPartPool pool;
+		const S32 NUM_FLAGS = sizeof(SIM_FLAGS)/sizeof(SIM_FLAGS[0]);
+		for (S32 i = 0; i < 403; i++)
+		{
+			const Source &source = sources[i % NUM_SOURCES];
+			U32 flags = 0;
+			if (i < 200)
+			{
+				// Every block of four mixed
+				for (S32 f = 0; f < NUM_FLAGS; f++)
+				{
+					flags |= (random.bits() & 3) ? 0 : SIM_FLAGS[f];
+				}
+			}
+			else
+			{
+				// Runs of eight alike, the way a source emits them
+				Random run(i/8);
+				for (S32 f = 0; f < NUM_FLAGS; f++)
+				{
+					flags |= (run.bits() & 1) ? SIM_FLAGS[f] : 0;
+				}
+			}
+			LLPartState part = make_part(random, flags, source);
+			expected.push_back(part);
+			expected_sources.push_back(&source);
+			pool.add(part, &source.mPosAgent, &source.mTargetPosAgent, false);
+		}
+
+		S32 killed = 0;
+		for (S32 frame = 0; frame < 120 && pool.getCount(); frame++)
+		{
+			// The sources move about
+			for (S32 s = 0; s < NUM_SOURCES; s++)
+			{
+				sources[s].mPosAgent += LLVector3(0.1f*sinf(frame*0.1f + s), 0.05f*s, 0.02f*cosf(frame*0.3f));
+			}
+			// Killed from outside now and then
+			if (frame % 10 == 5)
+			{
+				S32 i = (S32)(random.bits() % pool.getCount());
+				expected[i].mFlags = LLPartData::LL_PART_DEAD_MASK;
+				pool.setFlags(i, LLPartData::LL_PART_DEAD_MASK);
+				killed++;
+			}
+
+			const F32 dt = (frame % 3) ? 1.f/30.f : 1.f/15.f + 0.001f*frame;
+			update(pool, dt);
+			ensure_equals("count", pool.getCount(), (S32)expected.size());
+
+			for (S32 i = 0; i < pool.getCount();)
+			{
+				bool dead = old_update(&expected[i], expected_sources[i], dt);
+				LLPartState actual;
+				pool.get(i, actual);
+				ensure_same("frame", expected[i], actual);
+				ensure_equals("dead", pool.isDead(i), dead);
+				if (dead)
+				{
+					expected[i] = expected.back();
+					expected.pop_back();
+					expected_sources[i] = expected_sources.back();
+					expected_sources.pop_back();
+					pool.remove(i);
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+		ensure("some were killed", killed > 0);
+		ensure_equals("all died of age", pool.getCount(), 0);
+	}
+
+	template<> template<>
+	void partpool_object::test<2>()
+	{
+		set_test_name("adding, removing, placing and shifting");
+		Random random(9);
+		Source source;
+		source.mPosAgent.set(10.f, 20.f, 30.f);
+		source.mTargetPosAgent.set(40.f, 20.f, 30.f);
+
+		LLPartPool pool;
+		std::vector<LLPartState> parts;
+		for (S32 i = 0; i < 21; i++)
+		{
+			parts.push_back(make_part(random, LLPartData::LL_PART_FOLLOW_SRC_MASK | LLPartData::LL_PART_EMISSIVE_MASK, source));
+			pool.add(parts.back(), &source.mPosAgent, NULL, i == 0);
+		}
+		ensure_equals("count", pool.getCount(), 21);
+
+		LLPartState part;
+		pool.get(20, part);
+		ensure_same("round trip", parts[20], part);
+		ensure("scale", same_bits(pool.getScale(20), parts[20].mScale));
+		ensure("color", same_bits(pool.getColor(20), parts[20].mColor));
+
+		pool.remove(3);
+		ensure_equals("one less", pool.getCount(), 20);
+		pool.get(3, part);
+		ensure_same("last moved in", parts[20], part);
+
+		ensure("time step", same_bits(pool.getTimeStep(1, 0.1f), 0.1f - parts[1].mSkipOffset));
+
+		// Only particle 0 is placed, moving it doesn't follow the source
+		LLVector3 placed_pos(1.f, 2.f, 3.f);
+		pool.get(0, part);
+		part.mPosAgent = placed_pos;
+		pool.set(0, part);
+		source.mPosAgent += LLVector3(5.f, 0.f, 0.f);
+		pool.followSources();
+		ensure("placed stays", same_bits(pool.getPosAgent(0), placed_pos));
+		pool.get(1, part);
+		ensure("others follow", same_bits(part.mPosAgent, source.mPosAgent + parts[1].mPosOffset));
+		ensure_equals("flags without placed", pool.getFlags(0), parts[0].mFlags);
+
+		pool.setFlags(0, LLPartData::LL_PART_DEAD_MASK);
+		ensure("flagged dead", pool.isDead(0));
+		ensure("rest alive", !pool.isDead(1));
+
+		LLVector3 before = pool.getPosAgent(5);
+		pool.shift(LLVector3(-256.f, 0.f, 0.f));
+		ensure_equals("shifted", pool.getPosAgent(5).mV[VX], before.mV[VX] - 256.f);
+
+		pool.clear();
+		ensure_equals("cleared", pool.getCount(), 0);
+	}
+
+	template<> template<>
+	void partpool_object::test<3>()
+	{
+		set_test_name("simulating 50,000 particles");
+		Random random(13);
+		const S32 NUM_POOLS = 100;
+		const S32 PER_POOL = 500;
+		const S32 NUM_PARTS = NUM_POOLS*PER_POOL;
+		const S32 PER_SOURCE = 50;
+		const U32 SOURCE_FLAGS[] = {
+			LLPartData::LL_PART_INTERP_COLOR_MASK | LLPartData::LL_PART_INTERP_SCALE_MASK,
+			LLPartData::LL_PART_INTERP_COLOR_MASK | LLPartData::LL_PART_INTERP_SCALE_MASK | LLPartData::LL_PART_WIND_MASK,
+			LLPartData::LL_PART_INTERP_COLOR_MASK | LLPartData::LL_PART_FOLLOW_SRC_MASK,
+			LLPartData::LL_PART_INTERP_COLOR_MASK | LLPartData::LL_PART_BOUNCE_MASK | LLPartData::LL_PART_TARGET_POS_MASK
+		};
+
+		std::vector<Source> sources(NUM_PARTS/PER_SOURCE);
+		for (U32 s = 0; s < sources.size(); s++)
+		{
+			sources[s].mPosAgent.set(random(0.f, 256.f), random(0.f, 256.f), random(20.f, 40.f));
+			sources[s].mTargetPosAgent.set(random(0.f, 256.f), random(0.f, 256.f), random(20.f, 40.f));
+		}
+
+		// The old way, a heap allocation each
+		std::vector<LLPartState *> parts(NUM_PARTS);
+		LLPartPool *pools = new LLPartPool[NUM_POOLS];
+		for (S32 i = 0; i < NUM_PARTS; i++)
+		{
+			const S32 s = i/PER_SOURCE;
+			LLPartState part = make_part(random, SOURCE_FLAGS[s % 4], sources[s]);
+			part.mMaxAge = 1000.f;
+			parts[i] = new LLPartState(part);
+			pools[i/PER_POOL].add(part, &sources[s].mPosAgent, &sources[s].mTargetPosAgent, false);
+		}
+
+		const S32 FRAMES = 40;
+		const F32 dt = 1.f/60.f;
+		LLTimer timer;
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			for (S32 i = 0; i < NUM_PARTS; i++)
+			{
+				old_update(parts[i], &sources[i/PER_SOURCE], dt);
+			}
+		}
+		F64 old_time = timer.getElapsedTimeF64()/FRAMES;
+
+		timer.reset();
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			for (S32 p = 0; p < NUM_POOLS; p++)
+			{
+				update(pools[p], dt);
+			}
+		}
+		F64 pool_time = timer.getElapsedTimeF64()/FRAMES;
+
+		// Every update was the same
+		for (S32 i = 0; i < NUM_PARTS; i += 97)
+		{
+			LLPartState part;
+			pools[i/PER_POOL].get(i % PER_POOL, part);
+			ensure("went the same way", same_bits(part.mColor, parts[i]->mColor));
+		}
+
+		for (S32 i = 0; i < NUM_PARTS; i++)
+		{
+			delete parts[i];
+		}
+		delete [] pools;
+
+		llinfos << "Simulating " << NUM_PARTS << " particles: old loop " << old_time*1000.0
+				<< " ms, pools " << pool_time*1000.0 << " ms" << llendl;
+	}
+}
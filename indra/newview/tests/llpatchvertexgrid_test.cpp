@@ -0,0 +1,253 @@
+/**
+ * @file   llpatchvertexgrid_test.cpp
+ * @brief  Test for llpatchvertexgrid.cpp
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpatchvertexgrid.h"
+
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// A surface the way LLSurface lays one out: 256 grids and the north
+	// and east buffer, in patches of 16
+	const U32 PATCH_WIDTH = 16;
+	const U32 SURFACE_WIDTH = 257;
+	const F32 METERS_PER_GRID = 1.f;
+
+	struct Surface
+	{
+		std::vector<F32> mHeights;
+		std::vector<LLVector3> mNormals;
+
+		Surface(U32 seed) :
+			mHeights(SURFACE_WIDTH*SURFACE_WIDTH),
+			mNormals(SURFACE_WIDTH*SURFACE_WIDTH)
+		{
+			for (U32 y = 0; y < SURFACE_WIDTH; y++)
+			{
+				for (U32 x = 0; x < SURFACE_WIDTH; x++)
+				{
+					seed = seed*1103515245 + 12345;
+					F32 noise = (F32)((seed >> 16) & 0xFF)/256.f;
+					mHeights[x + y*SURFACE_WIDTH] = 22.f + 15.f*sinf(x*0.11f)*cosf(y*0.07f) + 3.f*noise;
+					LLVector3 normal(sinf(x*0.3f), cosf(y*0.2f), 2.f);
+					normal.normVec();
+					mNormals[x + y*SURFACE_WIDTH] = normal;
+				}
+			}
+		}
+
+		void update(LLPatchVertexGrid &grid, U32 patch_x, U32 patch_y)
+		{
+			U32 offset = patch_x*PATCH_WIDTH + patch_y*PATCH_WIDTH*SURFACE_WIDTH;
+			grid.update(&mHeights[offset], &mNormals[offset], SURFACE_WIDTH, METERS_PER_GRID,
+						LLVector2((F32)(patch_x*PATCH_WIDTH), (F32)(patch_y*PATCH_WIDTH)),
+						1.f/SURFACE_WIDTH);
+		}
+
+		// The position LLSurfacePatch::eval() worked out
+		LLVector3 eval(const LLVector3 &origin_agent, U32 patch_x, U32 patch_y, U32 x, U32 y) const
+		{
+			U32 offset = patch_x*PATCH_WIDTH + patch_y*PATCH_WIDTH*SURFACE_WIDTH;
+			LLVector3 pos_agent = origin_agent;
+			pos_agent.mV[VX] += x * METERS_PER_GRID;
+			pos_agent.mV[VY] += y * METERS_PER_GRID;
+			pos_agent.mV[VZ]  = mHeights[offset + x + y*SURFACE_WIDTH];
+			return pos_agent;
+		}
+	};
+
+	bool same_bits(const LLVector3 &a, const LLVector3 &b)
+	{
+		return !memcmp(a.mV, b.mV, sizeof(a.mV));
+	}
+
+	// Where the triangles LLVOSurfacePatch draws at stride put a point
+	// (x, y) between grid points
+	F32 mesh_height(const LLPatchVertexGrid &grid, F32 x, F32 y, U32 stride)
+	{
+		U32 x0 = (U32)(x/stride)*stride;
+		U32 y0 = (U32)(y/stride)*stride;
+		F32 fx = (x - x0)/stride;
+		F32 fy = (y - y0)/stride;
+		F32 h00 = grid.getMorphedHeight(x0, y0, stride, 0.f);
+		F32 h11 = grid.getMorphedHeight(x0 + stride, y0 + stride, stride, 0.f);
+		if (fx >= fy)
+		{
+			// Southeast of the diagonal
+			F32 h10 = grid.getMorphedHeight(x0 + stride, y0, stride, 0.f);
+			return h00 + fx*(h10 - h00) + fy*(h11 - h10);
+		}
+		F32 h01 = grid.getMorphedHeight(x0, y0 + stride, stride, 0.f);
+		return h00 + fy*(h01 - h00) + fx*(h11 - h01);
+	}
+}
+
+namespace tut
+{
+	struct patchvertexgrid_data
+	{
+	};
+	typedef test_group<patchvertexgrid_data> patchvertexgrid_test;
+	typedef patchvertexgrid_test::object patchvertexgrid_object;
+	tut::patchvertexgrid_test patchvertexgrid_testcase("LLPatchVertexGrid");
+
+	template<> template<>
+	void patchvertexgrid_object::test<1>()
+	{
+		set_test_name("vertices match what eval() worked out");
+		Surface surface(3);
+		LLPatchVertexGrid grid;
+		grid.create(PATCH_WIDTH);
+		ensure("not valid yet", !grid.isValid());
+
+		const U32 patch_x = 5;
+		const U32 patch_y = 11;
+		surface.update(grid, patch_x, patch_y);
+		ensure("valid", grid.isValid());
+
+		// Somewhere off in another region, as the agent sees it
+		const LLVector3 origin(-176.f + patch_x*PATCH_WIDTH, 80.f + patch_y*PATCH_WIDTH, 40.f);
+		LLVector4a origin_agent;
+		origin_agent.set(origin.mV[VX], origin.mV[VY], 0.f);
+
+		for (U32 y = 0; y <= PATCH_WIDTH; y++)
+		{
+			for (U32 x = 0; x <= PATCH_WIDTH; x++)
+			{
+				LLVector3 vertex;
+				LLVector3 normal;
+				LLVector2 tex0;
+				LLVector2 tex1;
+				grid.getVertex(x, y, 1, 0.f, origin_agent, &vertex, &normal, &tex0, &tex1);
+
+				ensure("position", same_bits(vertex, surface.eval(origin, patch_x, patch_y, x, y)));
+				U32 offset = patch_x*PATCH_WIDTH + x + (patch_y*PATCH_WIDTH + y)*SURFACE_WIDTH;
+				ensure("normal", same_bits(normal, surface.mNormals[offset]));
+				ensure_approximately_equals("tex u", tex0.mV[VX],
+											(F32)(patch_x*PATCH_WIDTH + x)/SURFACE_WIDTH, 20);
+				ensure_approximately_equals("tex v", tex0.mV[VY],
+											(F32)(patch_y*PATCH_WIDTH + y)/SURFACE_WIDTH, 20);
+			}
+		}
+
+		grid.invalidate();
+		ensure("invalidated", !grid.isValid());
+	}
+
+	template<> template<>
+	void patchvertexgrid_object::test<2>()
+	{
+		set_test_name("fully morphed, a stride lies on the next coarser one");
+		Surface surface(7);
+		LLPatchVertexGrid grid;
+		grid.create(PATCH_WIDTH);
+		surface.update(grid, 2, 3);
+
+		for (U32 stride = 1; stride <= PATCH_WIDTH/2; stride *= 2)
+		{
+			for (U32 y = 0; y <= PATCH_WIDTH; y += stride)
+			{
+				for (U32 x = 0; x <= PATCH_WIDTH; x += stride)
+				{
+					F32 height = grid.getMorphedHeight(x, y, stride, 0.f);
+					F32 morphed = grid.getMorphedHeight(x, y, stride, 1.f);
+					if (!x || !y || x == PATCH_WIDTH || y == PATCH_WIDTH)
+					{
+						ensure_equals("edges stay put", morphed, height);
+						continue;
+					}
+					ensure_approximately_equals("on the coarse mesh", morphed,
+												mesh_height(grid, (F32)x, (F32)y, stride*2), 16);
+
+					F32 half = grid.getMorphedHeight(x, y, stride, 0.5f);
+					ensure_approximately_equals("half way", half, 0.5f*(height + morphed), 16);
+				}
+			}
+		}
+
+		// Nothing coarser to morph toward
+		ensure_equals("whole patch", grid.getMorphedHeight(8, 8, PATCH_WIDTH, 1.f),
+					  grid.getMorphedHeight(8, 8, PATCH_WIDTH, 0.f));
+	}
+
+	template<> template<>
+	void patchvertexgrid_object::test<3>()
+	{
+		set_test_name("every patch of a region, as the agent sees it");
+		Surface surface(11);
+		const U32 PATCHES = (SURFACE_WIDTH - 1)/PATCH_WIDTH;
+		const LLVector3 region_origin(-256.f, 512.f, 0.f);
+		LLPatchVertexGrid grid;
+		grid.create(PATCH_WIDTH);
+
+		for (U32 j = 0; j < PATCHES; j++)
+		{
+			for (U32 i = 0; i < PATCHES; i++)
+			{
+				// Rebuilt in place, as LLSurfacePatch does when heights change
+				grid.invalidate();
+				surface.update(grid, i, j);
+
+				// LLSurfacePatch fills in the noise texture coordinates
+				LLVector2 *noise = grid.getTexCoords1();
+				for (U32 k = 0; k < (PATCH_WIDTH + 1)*(PATCH_WIDTH + 1); k++)
+				{
+					noise[k].set(0.f, (F32)(i + j + k)/1024.f);
+				}
+
+				const LLVector3 origin = region_origin + LLVector3((F32)(i*PATCH_WIDTH), (F32)(j*PATCH_WIDTH), 0.f);
+				LLVector4a origin_agent;
+				origin_agent.set(origin.mV[VX], origin.mV[VY], 0.f);
+
+				U32 k = 0;
+				for (U32 y = 0; y <= PATCH_WIDTH; y++)
+				{
+					for (U32 x = 0; x <= PATCH_WIDTH; x++, k++)
+					{
+						LLVector3 vertex;
+						LLVector3 normal;
+						LLVector2 tex0;
+						LLVector2 tex1;
+						grid.getVertex(x, y, 1, 0.f, origin_agent, &vertex, &normal, &tex0, &tex1);
+
+						ensure("position", same_bits(vertex, surface.eval(origin, i, j, x, y)));
+						U32 offset = i*PATCH_WIDTH + x + (j*PATCH_WIDTH + y)*SURFACE_WIDTH;
+						ensure("normal", same_bits(normal, surface.mNormals[offset]));
+						ensure_approximately_equals("tex u", tex0.mV[VX],
+													(F32)(i*PATCH_WIDTH + x)/SURFACE_WIDTH, 20);
+						ensure_approximately_equals("tex v", tex0.mV[VY],
+													(F32)(j*PATCH_WIDTH + y)/SURFACE_WIDTH, 20);
+						ensure("noise", tex1 == noise[k]);
+					}
+				}
+			}
+		}
+	}
+}
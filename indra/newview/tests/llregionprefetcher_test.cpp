@@ -0,0 +1,577 @@
+/**
+ * @file llregionprefetcher_test.cpp
+ * @brief Tests for warming a neighboring region ahead of a crossing
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llviewerprecompiledheaders.h"
+
+#include "../llregionprefetcher.h"
+
+#include "lldatapacker.h"
+#include "llframetimer.h"
+#include "llprimitive.h"
+#include "llregionhandle.h"
+#include "llsd.h"
+#include "llvolumemessage.h"
+#include "material_codes.h"
+#include "../llagent.h"
+#include "../llappviewer.h"
+#include "../llmeshrepository.h"
+#define LLVIEWERCAMERA_CPP
+#include "../llviewercamera.h"
+#include "../llviewercontrol.h"
+#include "../llviewerregion.h"
+#include "../llviewertexture.h"
+#include "../llvocache.h"
+#include "../llvoclouds.h"
+#include "../llworld.h"
+
+#include "../test/lltut.h"
+
+//----------------------------------------------------------------------------
+// Mock objects for the dependencies of the code we're testing.  The world is
+// whatever regions the tests make, each with the cache entries they give it,
+// and textures have data and faces only when a test says so.
+
+namespace
+{
+	struct TestRegion
+	{
+		LLViewerRegion* mRegion;
+		LLVector3d mOrigin;
+		std::map<U32, LLVOCacheEntry*> mCache;
+	};
+	std::map<U64, TestRegion> sRegions;
+
+	LLViewerRegion* sAgentRegion = NULL;
+	LLVector3d sAgentPosition;
+	LLVector3 sAgentVelocity;
+
+	// Every texture asked for, in the order they were
+	std::map<LLUUID, LLPointer<LLViewerFetchedTexture> > sImages;
+	std::vector<LLUUID> sFetched;
+	// Those that have data, at the discard level they have it
+	std::map<LLUUID, S32> sDiscardLevels;
+}
+
+LLControlGroup::LLControlGroup(const std::string& name)
+: LLInstanceTracker<LLControlGroup, std::string>(name) {}
+LLControlGroup::~LLControlGroup() {}
+BOOL LLControlGroup::getBOOL(const std::string& name) { return TRUE; }
+BOOL LLControlGroup::declareControl(const std::string& name, eControlType type, const LLSD initial_val,
+									const std::string& comment, BOOL persist, BOOL hidefromsettingseditor)
+{
+	mNameTable[name] = new LLControlVariable(name, type, initial_val, comment, persist);
+	return TRUE;
+}
+BOOL LLControlGroup::controlExists(const std::string& name) { return mNameTable.find(name) != mNameTable.end(); }
+LLPointer<LLControlVariable> LLControlGroup::getControl(const std::string& name)
+{
+	ctrl_name_table_t::iterator iter = mNameTable.find(name);
+	return iter == mNameTable.end() ? LLPointer<LLControlVariable>() : iter->second;
+}
+LLControlVariable::LLControlVariable(const std::string& name, eControlType type, LLSD initial,
+									 const std::string& comment, bool persist, bool hidefromsettingseditor)
+: mName(name), mType(type) { mValues.push_back(initial); }
+LLControlVariable::~LLControlVariable() {}
+void LLControlVariable::setValue(const LLSD& value, bool saved_value) { mValues.back() = value; firePropertyChanged(); }
+template <> eControlType get_control_type<U32>() { return TYPE_U32; }
+template <> eControlType get_control_type<F32>() { return TYPE_F32; }
+template <> eControlType get_control_type<bool>() { return TYPE_BOOLEAN; }
+template <> LLSD convert_to_llsd<U32>(const U32& in) { return (LLSD::Integer)in; }
+template<> U32 convert_from_llsd<U32>(const LLSD& sd, eControlType type, const std::string& control_name) { return (U32)sd.asInteger(); }
+template<> F32 convert_from_llsd<F32>(const LLSD& sd, eControlType type, const std::string& control_name) { return (F32)sd.asReal(); }
+template<> bool convert_from_llsd<bool>(const LLSD& sd, eControlType type, const std::string& control_name) { return sd.asBoolean(); }
+LLControlGroup gSavedSettings("test");
+
+F32 gFrameIntervalSeconds = 0.f;
+
+template class LLViewerCamera* LLSingleton<class LLViewerCamera>::getInstance();
+LLViewerCamera::LLViewerCamera() : LLCamera() { mPixelMeterRatio = 100.f; }
+void LLViewerCamera::setView(F32 vertical_fov_rads) {}
+
+LLAgent::LLAgent() : mAgentAccess(NULL) {}
+LLAgent::~LLAgent() {}
+LLViewerRegion *LLAgent::getRegion() const { return sAgentRegion; }
+const LLVector3d &LLAgent::getPositionGlobal() const { return sAgentPosition; }
+LLVector3 LLAgent::getVelocity() const { return sAgentVelocity; }
+LLAgent gAgent;
+
+LLWorld::LLWorld() {}
+LLPatchVertexArray::LLPatchVertexArray() {}
+LLPatchVertexArray::~LLPatchVertexArray() {}
+LLViewerRegion *LLWorld::getRegionFromPosGlobal(const LLVector3d &pos)
+{
+	std::map<U64, TestRegion>::iterator iter = sRegions.find(to_region_handle(pos));
+	return iter != sRegions.end() ? iter->second.mRegion : NULL;
+}
+
+LLViewerRegion::LLViewerRegion(const U64 &handle, const LLHost &host, const U32 surface_grid_width,
+							   const U32 patch_grid_width, const F32 region_width_meters)
+: mImpl(NULL), mHandle(handle), mCacheLoaded(TRUE), mAlive(true) {}
+LLViewerRegion::~LLViewerRegion() {}
+std::string LLViewerRegion::getCapability(const std::string& name) const { return std::string(); }
+const LLHost& LLViewerRegion::getHost() const { return LLHost::invalid; }
+std::string LLViewerRegion::getDescription() const { return std::string(); }
+bool LLViewerRegion::isAlive() { return mAlive; }
+const LLVector3d &LLViewerRegion::getOriginGlobal() const { return sRegions[mHandle].mOrigin; }
+const std::map<U32, LLVOCacheEntry*>& LLViewerRegion::getCacheMap() const { return sRegions[mHandle].mCache; }
+LLWind::LLWind() {}
+LLWind::~LLWind() {}
+LLCloudGroup::LLCloudGroup() {}
+LLCloudLayer::LLCloudLayer() {}
+LLCloudLayer::~LLCloudLayer() {}
+
+LLMeshRepository::LLMeshRepository() : mPrefetchHits(0), mPrefetchHeadStart(0.0) {}
+bool LLMeshRepository::meshRezEnabled() { return false; }
+bool LLMeshRepository::prefetchMesh(const LLVolumeParams& mesh_params) { return false; }
+LLMeshRepository gMeshRepo;
+
+LLTexture::~LLTexture() {}
+LLViewerTexture::LLViewerTexture(const LLUUID& id, BOOL usemipmaps) : mID(id), mNumFaces(0) {}
+LLViewerTexture::~LLViewerTexture() {}
+S8 LLViewerTexture::getType() const { return FETCHED_TEXTURE; }
+BOOL LLViewerTexture::isMissingAsset() const { return FALSE; }
+void LLViewerTexture::dump() {}
+bool LLViewerTexture::bindDefaultImage(const S32 stage) { return false; }
+void LLViewerTexture::forceImmediateUpdate() {}
+F32 LLViewerTexture::getMaxVirtualSize() { return 0.f; }
+void LLViewerTexture::setKnownDrawSize(S32 width, S32 height) {}
+void LLViewerTexture::addFace(LLFace* facep) { mNumFaces++; }
+void LLViewerTexture::removeFace(LLFace* facep) { mNumFaces--; }
+void LLViewerTexture::addVolume(LLVOVolume* volumep) {}
+void LLViewerTexture::removeVolume(LLVOVolume* volumep) {}
+S32 LLViewerTexture::getWidth(S32 discard_level) const { return 0; }
+S32 LLViewerTexture::getHeight(S32 discard_level) const { return 0; }
+void LLViewerTexture::setCachedRawImage(S32 discard_level, LLImageRaw* imageraw) {}
+void LLViewerTexture::setActive() {}
+void LLViewerTexture::updateBindStatsForTester() {}
+LLImageGL* LLViewerTexture::getGLTexture() const { return NULL; }
+void LLViewerTexture::switchToCachedImage() {}
+void LLViewerTexture::addTextureStats(F32 virtual_size, BOOL needs_gltexture) const {}
+S32 LLViewerTexture::getNumFaces() const { return mNumFaces; }
+S32 LLViewerTexture::getDiscardLevel() const
+{
+	std::map<LLUUID, S32>::const_iterator iter = sDiscardLevels.find(mID);
+	return iter != sDiscardLevels.end() ? iter->second : -1;
+}
+LLViewerFetchedTexture::LLViewerFetchedTexture(const LLUUID& id, const LLHost& host, BOOL usemipmaps)
+: LLViewerTexture(id, usemipmaps), mIsMissingAsset(FALSE) {}
+LLViewerFetchedTexture::~LLViewerFetchedTexture() {}
+S8 LLViewerFetchedTexture::getType() const { return FETCHED_TEXTURE; }
+void LLViewerFetchedTexture::forceImmediateUpdate() {}
+void LLViewerFetchedTexture::dump() {}
+void LLViewerFetchedTexture::processTextureStats() {}
+void LLViewerFetchedTexture::setKnownDrawSize(S32 width, S32 height) {}
+void LLViewerFetchedTexture::setCachedRawImage(S32 discard_level, LLImageRaw* imageraw) {}
+void LLViewerFetchedTexture::switchToCachedImage() {}
+void LLViewerFetchedTexture::setIsMissingAsset() { mIsMissingAsset = TRUE; }
+LLViewerFetchedTexture* LLViewerTextureManager::getFetchedTexture(const LLUUID& id, BOOL, LLViewerTexture::EBoostLevel, S8,
+																  LLGLint, LLGLenum, LLHost)
+{
+	LLPointer<LLViewerFetchedTexture>& image = sImages[id];
+	if (image.isNull())
+	{
+		image = new LLViewerFetchedTexture(id);
+	}
+	sFetched.push_back(id);
+	return image;
+}
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+	const F32 REGION_WIDTH = 256.f;
+	const LLVector3d AGENT_ORIGIN(256000.0, 256000.0, 0.0);
+	// The region east of the agent's
+	const LLVector3d EAST_ORIGIN(256256.0, 256000.0, 0.0);
+
+	// The frame clock, moved on by hand
+	class TestFrameTimer : public LLFrameTimer
+	{
+	public:
+		static void advance(F64 seconds) { sFrameTime += seconds; }
+	};
+
+	LLUUID texture_id(U32 local_id)
+	{
+		LLUUID id;
+		id.mData[0] = 0x7e;
+		memcpy(&id.mData[12], &local_id, sizeof(local_id));
+		return id;
+	}
+
+	// A volume as the simulator sends it and the cache keeps it, textured
+	// with texture_id(local_id) and carrying padding bytes of hover text
+	std::vector<U8> make_block(U32 local_id, U32 parent_id, const LLVector3& pos, F32 size, S32 padding = 0)
+	{
+		std::vector<U8> data(1024 + padding);
+		LLDataPackerBinaryBuffer dp(&data[0], (S32)data.size());
+
+		LLUUID id;
+		id.mData[0] = 0x42;
+		memcpy(&id.mData[12], &local_id, sizeof(local_id));
+		U32 flags = 0;
+		if (parent_id) flags |= 0x20;
+		if (padding) flags |= 0x4;
+
+		dp.packUUID(id, "ID");
+		dp.packU32(local_id, "LocalID");
+		dp.packU8(LL_PCODE_VOLUME, "PCode");
+		dp.packU8(0, "State");
+		dp.packU32(local_id, "CRC");
+		dp.packU8(LL_MCODE_WOOD, "Material");
+		dp.packU8(0, "ClickAction");
+		dp.packVector3(LLVector3(size, size, size), "Scale");
+		dp.packVector3(pos, "Pos");
+		dp.packVector3(LLVector3::zero, "Rot");
+		dp.packU32(flags, "SpecialCode");
+		dp.packUUID(id, "Owner");
+		if (flags & 0x20)
+		{
+			dp.packU32(parent_id, "ParentID");
+		}
+		if (flags & 0x4)
+		{
+			U8 color[4] = { 255, 255, 255, 255 };
+			dp.packString(std::string(padding, 'x'), "Text");
+			dp.packBinaryDataFixed(color, 4, "Color");
+		}
+		dp.packU8(0, "num_params");
+
+		LLVolumeParams volume_params;
+		volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+		volume_params.setBeginAndEndS(0.f, 1.f);
+		volume_params.setBeginAndEndT(0.f, 1.f);
+		volume_params.setRatio(1.f, 1.f);
+		LLVolumeMessage::packVolumeParams(&volume_params, dp);
+
+		LLPrimitive prim;
+		prim.setNumTEs(6);
+		for (U8 face = 0; face < 6; face++)
+		{
+			prim.setTETexture(face, texture_id(local_id));
+		}
+		prim.packTEMessage(dp);
+
+		data.resize(dp.getCurrentSize());
+		return data;
+	}
+
+	void add_object(const LLVector3d& origin, U32 local_id, U32 parent_id, const LLVector3& pos, F32 size, S32 padding = 0)
+	{
+		std::vector<U8> data = make_block(local_id, parent_id, pos, size, padding);
+		LLDataPackerBinaryBuffer dp(&data[0], (S32)data.size());
+		std::map<U32, LLVOCacheEntry*>& cache = sRegions[to_region_handle(origin)].mCache;
+		delete cache[local_id];
+		cache[local_id] = new LLVOCacheEntry(local_id, local_id, dp);
+	}
+
+	void remove_object(const LLVector3d& origin, U32 local_id)
+	{
+		std::map<U32, LLVOCacheEntry*>& cache = sRegions[to_region_handle(origin)].mCache;
+		delete cache[local_id];
+		cache.erase(local_id);
+	}
+
+	void set_setting(const std::string& name, const LLSD& value)
+	{
+		gSavedSettings.getControl(name)->setValue(value);
+	}
+
+	// A frame dt seconds after the last
+	void frame(LLRegionPrefetcher& prefetcher, F32 dt)
+	{
+		gFrameIntervalSeconds = dt;
+		TestFrameTimer::advance(dt);
+		prefetcher.update();
+	}
+
+	bool same_position(const LLVector3d& a, const LLVector3d& b)
+	{
+		return dist_vec(a, b) < 0.001;
+	}
+}
+
+namespace tut
+{
+	struct regionprefetcher_data
+	{
+		regionprefetcher_data()
+		{
+			if (!gSavedSettings.controlExists("RegionCrossingPrefetch"))
+			{
+				gSavedSettings.declareControl("RegionCrossingPrefetch", TYPE_BOOLEAN, true, "test", FALSE);
+				gSavedSettings.declareControl("RegionCrossingPrefetchLookahead", TYPE_F32, 3.0, "test", FALSE);
+				gSavedSettings.declareControl("RegionCrossingPrefetchRate", TYPE_U32, 1000, "test", FALSE);
+			}
+			set_setting("RegionCrossingPrefetchRate", 1000);
+
+			// Standing near the east edge of its region looking east,
+			// which is taken to be heading half the draw distance that way
+			LLViewerCamera::getInstance()->setFar(128.f);
+			sAgentRegion = makeRegion(AGENT_ORIGIN);
+			sAgentPosition = AGENT_ORIGIN + LLVector3d(250.0, 128.0, 20.0);
+			sAgentVelocity.clearVec();
+			mEast = makeRegion(EAST_ORIGIN);
+			mPredicted.setVec(58.f, 128.f, 20.f);
+		}
+
+		~regionprefetcher_data()
+		{
+			for (std::map<U64, TestRegion>::iterator iter = sRegions.begin(); iter != sRegions.end(); ++iter)
+			{
+				std::map<U32, LLVOCacheEntry*>& cache = iter->second.mCache;
+				for (std::map<U32, LLVOCacheEntry*>::iterator entry = cache.begin(); entry != cache.end(); ++entry)
+				{
+					delete entry->second;
+				}
+			}
+			sRegions.clear();
+			for (std::vector<LLViewerRegion*>::iterator iter = mRegions.begin(); iter != mRegions.end(); ++iter)
+			{
+				delete *iter;
+			}
+			sAgentRegion = NULL;
+			sImages.clear();
+			sFetched.clear();
+			sDiscardLevels.clear();
+		}
+
+		LLViewerRegion* makeRegion(const LLVector3d& origin)
+		{
+			const U64 handle = to_region_handle(origin);
+			LLViewerRegion* region = new LLViewerRegion(handle, LLHost::invalid, 0, 0, REGION_WIDTH);
+			sRegions[handle].mRegion = region;
+			sRegions[handle].mOrigin = origin;
+			mRegions.push_back(region);
+			return region;
+		}
+
+		std::vector<LLViewerRegion*> mRegions;
+		LLViewerRegion* mEast;
+		// Where the agent is headed, local to mEast
+		LLVector3 mPredicted;
+	};
+	typedef test_group<regionprefetcher_data> regionprefetcher_test;
+	typedef regionprefetcher_test::object regionprefetcher_object;
+	tut::regionprefetcher_test regionprefetcher_testcase("LLRegionPrefetcher");
+
+	template<> template<>
+	void regionprefetcher_object::test<1>()
+	{
+		set_test_name("predictPosition");
+
+		const LLVector3d pos(1000.0, 2000.0, 30.0);
+		const LLVector3 east(1.f, 0.f, 0.f);
+
+		// Flying the way it looks goes on along the look
+		LLVector3d predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3(10.f, 0.f, 0.f), east, 2.f, 50.f);
+		ensure("along the look", same_position(predicted, LLVector3d(1070.0, 2000.0, 30.0)));
+
+		// Backing away from it, or flying across it, only the velocity counts
+		predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3(-10.f, 0.f, 0.f), east, 2.f, 50.f);
+		ensure("backing away", same_position(predicted, LLVector3d(980.0, 2000.0, 30.0)));
+		predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3(0.f, 10.f, 0.f), east, 2.f, 50.f);
+		ensure("across", same_position(predicted, LLVector3d(1000.0, 2020.0, 30.0)));
+
+		// Partly its way, as far along it as the agent moves that way
+		predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3(6.f, 8.f, 0.f), east, 1.f, 50.f);
+		ensure("partly", same_position(predicted, LLVector3d(1036.0, 2008.0, 30.0)));
+
+		// Standing, or drifting, it heads where it looks, the look taken
+		// level whatever its pitch
+		predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3::zero, LLVector3(0.f, 2.f, 1.f), 2.f, 50.f);
+		ensure("standing", same_position(predicted, LLVector3d(1000.0, 2050.0, 30.0)));
+		predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3(-0.5f, 0.f, 0.f), east, 2.f, 50.f);
+		ensure("drifting", same_position(predicted, LLVector3d(1049.0, 2000.0, 30.0)));
+
+		// Looking straight down, only the velocity counts
+		predicted = LLRegionPrefetcher::predictPosition(pos, LLVector3(0.f, 0.f, -5.f), LLVector3(0.f, 0.f, -1.f), 2.f, 50.f);
+		ensure("looking down", same_position(predicted, LLVector3d(1000.0, 2000.0, 20.0)));
+	}
+
+	template<> template<>
+	void regionprefetcher_object::test<2>()
+	{
+		set_test_name("scan resumes across frames");
+
+		// More cache than a frame's worth
+		for (U32 i = 0; i < 200; i++)
+		{
+			add_object(EAST_ORIGIN, 100 + i, 0, mPredicted + LLVector3((F32)(i % 20), (F32)(i / 20), 0.f), 1.f, 1024);
+		}
+
+		LLRegionPrefetcher prefetcher;
+		frame(prefetcher, 1.f);
+		ensure("nothing asked for before the scan is through", sFetched.empty());
+
+		// Entries come and go between frames.  One behind where the scan
+		// left off is missed, one ahead of it is picked up, and one gone
+		// before the scan got to it isn't looked for.
+		add_object(EAST_ORIGIN, 1, 0, mPredicted, 1.f);
+		add_object(EAST_ORIGIN, 5000, 0, mPredicted, 1.f);
+		remove_object(EAST_ORIGIN, 299);
+
+		S32 frames = 1;
+		while (sFetched.empty() && frames < 20)
+		{
+			frame(prefetcher, 1.f);
+			frames++;
+		}
+		ensure("took more frames", frames > 2);
+		ensure("scan finished", !sFetched.empty());
+
+		std::set<LLUUID> unique(sFetched.begin(), sFetched.end());
+		ensure_equals("each asked for once", unique.size(), sFetched.size());
+		ensure_equals("all found", sFetched.size(), (size_t)200);
+		for (U32 i = 0; i < 199; i++)
+		{
+			ensure("scanned", unique.count(texture_id(100 + i)) != 0);
+		}
+		ensure("added ahead", unique.count(texture_id(5000)) != 0);
+		ensure("added behind", unique.count(texture_id(1)) == 0);
+		ensure("removed", unique.count(texture_id(299)) == 0);
+	}
+
+	template<> template<>
+	void regionprefetcher_object::test<3>()
+	{
+		set_test_name("ranking");
+
+		// Big and near first, then by size over distance.  A child goes
+		// where its parent is, and one whose parent isn't cached, or
+		// anything too far from where the agent is headed, not at all.
+		add_object(EAST_ORIGIN, 10, 0, mPredicted + LLVector3(10.f, 0.f, 0.f), 8.f);
+		add_object(EAST_ORIGIN, 11, 10, LLVector3(-9.f, 0.f, 0.f), 1.f);
+		add_object(EAST_ORIGIN, 12, 0, mPredicted + LLVector3(2.f, 0.f, 0.f), 1.f);
+		add_object(EAST_ORIGIN, 13, 0, mPredicted + LLVector3(0.f, 40.f, 0.f), 2.f);
+		add_object(EAST_ORIGIN, 14, 0, mPredicted + LLVector3(0.f, 0.f, 180.f), 1.f);
+		add_object(EAST_ORIGIN, 15, 99, LLVector3::zero, 1.f);
+
+		LLRegionPrefetcher prefetcher;
+		frame(prefetcher, 1.f);
+
+		ensure_equals("in range", sFetched.size(), (size_t)4);
+		ensure("biggest", sFetched[0] == texture_id(10));
+		ensure("nearest", sFetched[1] == texture_id(12));
+		ensure("child at its parent", sFetched[2] == texture_id(11));
+		ensure("farther", sFetched[3] == texture_id(13));
+
+		// Nothing is asked for twice
+		frame(prefetcher, 1.f);
+		ensure_equals("no more", sFetched.size(), (size_t)4);
+	}
+
+	template<> template<>
+	void regionprefetcher_object::test<4>()
+	{
+		set_test_name("rate limiting");
+
+		for (U32 i = 0; i < 300; i++)
+		{
+			add_object(EAST_ORIGIN, 100 + i, 0, mPredicted + LLVector3((F32)(i % 20), (F32)(i / 20), 0.f), 1.f);
+		}
+
+		// A request each tenth of a second
+		set_setting("RegionCrossingPrefetchRate", 10);
+		LLRegionPrefetcher prefetcher;
+		for (S32 i = 0; i < 10; i++)
+		{
+			frame(prefetcher, 0.1f);
+			ensure_equals("one a frame", sFetched.size(), (size_t)(i + 1));
+		}
+
+		// A long frame doesn't make up for more than a second
+		frame(prefetcher, 5.f);
+		ensure_equals("a second's worth", sFetched.size(), (size_t)20);
+
+		// As many as may be warming at once, and more only as those settle
+		set_setting("RegionCrossingPrefetchRate", 1000);
+		frame(prefetcher, 1.f);
+		ensure_equals("warming at once", sFetched.size(), (size_t)256);
+		frame(prefetcher, 1.f);
+		ensure_equals("none settled", sFetched.size(), (size_t)256);
+		for (S32 i = 0; i < 6; i++)
+		{
+			sImages[sFetched[i]]->addFace(NULL);
+		}
+		frame(prefetcher, 1.f);
+		ensure_equals("as many as settled", sFetched.size(), (size_t)262);
+	}
+
+	template<> template<>
+	void regionprefetcher_object::test<5>()
+	{
+		set_test_name("hit and miss accounting");
+
+		for (U32 i = 0; i < 5; i++)
+		{
+			add_object(EAST_ORIGIN, 10 + i, 0, mPredicted + LLVector3((F32)i, 0.f, 0.f), 1.f);
+		}
+		const LLUUID arrives = texture_id(10);
+		const LLUUID used = texture_id(11);
+		const LLUUID missing = texture_id(12);
+		const LLUUID unused = texture_id(13);
+		// Already here, there's nothing to get ahead of
+		const LLUUID loaded = texture_id(14);
+		sDiscardLevels[loaded] = 0;
+
+		LLRegionPrefetcher prefetcher;
+		frame(prefetcher, 1.f);
+		ensure_equals("all looked at", sFetched.size(), (size_t)5);
+
+		// The agent walks away, the textures being warmed are still
+		// followed
+		sAgentPosition = AGENT_ORIGIN + LLVector3d(10.0, 128.0, 20.0);
+
+		// Two seconds on the first has data and the third turns out not
+		// to exist, three seconds after that the first two are used
+		sDiscardLevels[arrives] = 2;
+		sImages[missing]->setIsMissingAsset();
+		frame(prefetcher, 2.f);
+		sImages[arrives]->addFace(NULL);
+		sImages[used]->addFace(NULL);
+		frame(prefetcher, 3.f);
+
+		LLSD info;
+		prefetcher.getInfo(info);
+		ensure_equals("requested", info["TexturesRequested"].asInteger(), 4);
+		ensure_equals("hits", info["TextureHits"].asInteger(), 2);
+		ensure_equals("missing", info["TextureMisses"].asInteger(), 1);
+		ensure_approximately_equals("data two seconds early, the other five", (F32)info["TextureSavedSeconds"].asReal(), 7.f, 16);
+
+		// Never used and given up on after a minute
+		frame(prefetcher, 30.f);
+		prefetcher.getInfo(info);
+		ensure_equals("still warming", info["TextureMisses"].asInteger(), 1);
+		frame(prefetcher, 30.f);
+		prefetcher.getInfo(info);
+		ensure_equals("expired", info["TextureMisses"].asInteger(), 2);
+		ensure_approximately_equals("hit rate", (F32)info["TextureHitRate"].asReal(), 0.5f, 16);
+		ensure_equals("one region", info["RegionsTargeted"].asInteger(), 1);
+		ensure("unused given up", sImages[unused]->getNumRefs() == 1);
+	}
+}
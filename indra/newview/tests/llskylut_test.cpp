@@ -0,0 +1,370 @@
+/**
+ * @file   llskylut_test.cpp
+ * @brief  Test for llskylut.cpp
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llskylut.h"
+#include "../llskymath.h"
+
+#include <vector>
+
+#include "lljobscheduler.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	// The Default sky preset, and the 6AM one
+	LLSkyLUT::Params make_params(bool morning)
+	{
+		LLSkyLUT::Params params;
+		if (morning)
+		{
+			params.mSunlightColor.set(2.37f, 2.37f, 2.37f);
+			params.mAmbient.set(0.81f, 0.4629f, 0.63f);
+			params.mBlueDensity.set(0.15793f, 0.435f, 0.87f);
+			params.mBlueHorizon.set(0.20673f, 0.40988f, 0.48f);
+			params.mHazeDensity = 0.54f;
+			params.mHazeHorizon.set(0.16f, 0.19916f, 0.19916f);
+			params.mDensityMultiplier = 0.00062f;
+			params.mMaxY = 563.f;
+			params.mGlow.set(5.001f, 0.001f, -0.48f);
+			params.mCloudShadow = 0.27f;
+			params.mLightNorm.set(0.f, 0.09411f, 0.99556f, 0.f);
+		}
+		else
+		{
+			params.mSunlightColor.set(0.73421f, 0.78158f, 0.9f);
+			params.mAmbient.set(1.05f, 1.05f, 1.05f);
+			params.mBlueDensity.set(0.24476f, 0.44872f, 0.76f);
+			params.mBlueHorizon.set(0.49548f, 0.49548f, 0.64f);
+			params.mHazeDensity = 0.7f;
+			params.mHazeHorizon.set(0.19f, 0.19916f, 0.19916f);
+			params.mDensityMultiplier = 0.00018f;
+			params.mMaxY = 1605.f;
+			params.mGlow.set(5.f, 0.001f, -0.48f);
+			params.mCloudShadow = 0.27f;
+			params.mLightNorm.set(0.f, 0.91269f, -0.40865f, 0.f);
+		}
+		return params;
+	}
+
+	// LLVOSky::calcSkyColorWLVert() as it was, haze color only
+	LLColor3 old_haze(const LLSkyLUT::Params &params, LLVector3 Pn)
+	{
+		const F32 dome_radius = params.mDomeRadius;
+		const F32 dome_offset_ratio = params.mDomeOffsetRatio;
+		const LLColor3 &sunlight_color = params.mSunlightColor;
+		const LLColor3 &ambient = params.mAmbient;
+		const LLColor3 &blue_density = params.mBlueDensity;
+		const LLColor3 &blue_horizon = params.mBlueHorizon;
+		const F32 haze_density = params.mHazeDensity;
+		const LLColor3 &haze_horizon = params.mHazeHorizon;
+		const F32 density_multiplier = params.mDensityMultiplier;
+		const F32 max_y = params.mMaxY;
+		const LLColor3 &glow = params.mGlow;
+		const F32 cloud_shadow = params.mCloudShadow;
+		const LLVector4 &lightnorm = params.mLightNorm;
+		LLColor3 vary_HazeColor;
+
+		F32 phi = acos(Pn[1]);
+		F32 sinA = sin(F_PI - phi);
+		F32 Plen = dome_radius * sin(F_PI + phi + asin(dome_offset_ratio * sinA)) / sinA;
+
+		Pn *= Plen;
+
+		if (Pn[1] > 0.f)
+		{
+			Pn *= (max_y / Pn[1]);
+		}
+		else
+		{
+			Pn *= (-32000.f / Pn[1]);
+		}
+
+		Plen = Pn.length();
+		Pn /= Plen;
+
+		LLColor3 sunlight = sunlight_color;
+		LLColor3 light_atten =
+			(blue_density * 1.0 + smear(haze_density * 0.25f)) * (density_multiplier * max_y);
+
+		LLColor3 temp2(0.f, 0.f, 0.f);
+		LLColor3 temp1 = blue_density + smear(haze_density);
+		LLColor3 blue_weight = componentDiv(blue_density, temp1);
+		LLColor3 haze_weight = componentDiv(smear(haze_density), temp1);
+
+		temp2.mV[1] = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, Pn[1]) * 1.0f + lightnorm[1] );
+
+		temp2.mV[1] = 1.f / temp2.mV[1];
+		componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+
+		temp2.mV[2] = Plen * density_multiplier;
+
+		temp1 = componentExp((temp1 * -1.f) * temp2.mV[2]);
+
+		temp2.mV[0] = Pn * LLVector3(lightnorm);
+
+		temp2.mV[0] = 1.f - temp2.mV[0];
+		temp2.mV[0] = llmax(temp2.mV[0], .001f);
+		temp2.mV[0] *= glow.mV[0];
+		temp2.mV[0] = pow(temp2.mV[0], glow.mV[2]);
+
+		temp2.mV[0] += .25f;
+
+		vary_HazeColor = (blue_horizon * blue_weight * (sunlight + ambient)
+					+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + ambient)
+				 );
+
+		LLColor3 tmpAmbient = ambient + (LLColor3::white - ambient) * cloud_shadow * 0.5f;
+
+		sunlight *= (1.f - cloud_shadow);
+
+		LLColor3 additiveColorBelowCloud = (blue_horizon * blue_weight * (sunlight + tmpAmbient)
+					+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + tmpAmbient)
+				 );
+
+		componentMultBy(vary_HazeColor, LLColor3::white - temp1);
+
+		sunlight = sunlight_color;
+		temp2.mV[1] = llmax(0.f, lightnorm[1] * 2.f);
+		temp2.mV[1] = 1.f / temp2.mV[1];
+		componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+
+		temp1 = componentSqrt(temp1);
+
+		vary_HazeColor +=
+			componentMult(additiveColorBelowCloud - vary_HazeColor, LLColor3::white - componentSqrt(temp1));
+
+		if (Pn[1] < 0.f)
+		{
+			LLColor3 dark_brown(0.082f, 0.076f, 0.066f);
+			LLColor3 brown(0.430f, 0.386f, 0.322f);
+			LLColor3 sky_lighting = sunlight + ambient;
+			F32 haze_brightness = vary_HazeColor.brightness();
+
+			if (Pn[1] < -0.05f)
+			{
+				vary_HazeColor = colorMix(dark_brown, brown, -Pn[1] * 0.9f) * sky_lighting * haze_brightness;
+			}
+
+			if (Pn[1] > -0.1f)
+			{
+				vary_HazeColor = colorMix(LLColor3::white * haze_brightness, vary_HazeColor, fabs((Pn[1] + 0.05f) * -20.f));
+			}
+		}
+		return vary_HazeColor;
+	}
+
+	LLColor3 haze(const LLSkyLUT::Params &params, LLVector3 Pn)
+	{
+		F32 Plen = LLSkyLUT::projectToDome(params, Pn, NULL);
+		return LLSkyLUT::calcHazeColor(params, Pn[1], Plen, LLSkyLUT::calcGlow(params, Pn));
+	}
+
+	// The directions of a 64 by 64 face of LLVOSky's cube, the way
+	// initSkyTextureDirs() works them out, in OGL axes
+	void cube_dirs(S32 side, std::vector<LLVector3> &dirs)
+	{
+		const S32 resolution = 64;
+		F32 coeff[3] = {0, 0, 0};
+		const S32 curr_coef = side >> 1;
+		const S32 side_dir = (((side & 1) << 1) - 1);
+		const S32 x_coef = (curr_coef + 1) % 3;
+		const S32 y_coef = (x_coef + 1) % 3;
+		coeff[curr_coef] = (F32)side_dir;
+		const F32 inv_res = 1.f/resolution;
+		for (S32 y = 0; y < resolution; ++y)
+		{
+			for (S32 x = 0; x < resolution; ++x)
+			{
+				coeff[x_coef] = F32((x<<1) + 1) * inv_res - 1.f;
+				coeff[y_coef] = F32((y<<1) + 1) * inv_res - 1.f;
+				LLVector3 dir(coeff[0], coeff[1], coeff[2]);
+				dir.normalize();
+				// Below the horizon is fog, not haze
+				if (dir.mV[VZ] >= -0.02f)
+				{
+					dirs.push_back(LLVector3(-dir[1], -dir[2], -dir[0]));
+				}
+			}
+		}
+	}
+
+	// What the sky texture gets, in 8 bits
+	S32 texel(F32 haze)
+	{
+		return llround(llclamp(haze*2.f, 0.f, 1.f)*255.f);
+	}
+}
+
+namespace tut
+{
+	struct skylut_data
+	{
+	};
+	typedef test_group<skylut_data> skylut_test;
+	typedef skylut_test::object skylut_object;
+	tut::skylut_test skylut_testcase("LLSkyLUT");
+
+	template<> template<>
+	void skylut_object::test<1>()
+	{
+		set_test_name("the model in steps is the model");
+		for (S32 morning = 0; morning < 2; morning++)
+		{
+			const LLSkyLUT::Params params = make_params(morning != 0);
+			for (S32 side = 0; side < 6; side++)
+			{
+				std::vector<LLVector3> dirs;
+				cube_dirs(side, dirs);
+				for (U32 i = 0; i < dirs.size(); i++)
+				{
+					const LLColor3 expected = old_haze(params, dirs[i]);
+					const LLColor3 actual = haze(params, dirs[i]);
+					ensure("same bits", !memcmp(expected.mV, actual.mV, sizeof(expected.mV)));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void skylut_object::test<2>()
+	{
+		set_test_name("tables against the model");
+		for (S32 morning = 0; morning < 2; morning++)
+		{
+			LLSkyLUT::Params params = make_params(morning != 0);
+			// The sun at its clamped lowest, and overhead
+			for (S32 sun = 0; sun < 3; sun++)
+			{
+				if (sun == 1)
+				{
+					params.mLightNorm.set(0.995f, -0.1f, 0.f, 0.f);
+				}
+				else if (sun == 2)
+				{
+					params.mLightNorm.set(0.f, 1.f, 0.f, 0.f);
+				}
+				LLSkyLUT lut;
+				ensure("not valid yet", !lut.isValid());
+				lut.build(params, false);
+				ensure("valid", lut.isValid());
+
+				S32 worst = 0;
+				for (S32 side = 0; side < 6; side++)
+				{
+					std::vector<LLVector3> dirs;
+					cube_dirs(side, dirs);
+					for (U32 i = 0; i < dirs.size(); i++)
+					{
+						const LLColor3 expected = haze(params, dirs[i]);
+						LLColor3 actual;
+						lut.getHazeColor(dirs[i], actual);
+						for (S32 k = 0; k < 3; k++)
+						{
+							worst = llmax(worst, abs(texel(expected.mV[k]) - texel(actual.mV[k])));
+						}
+					}
+				}
+				// Off by at most one level, where the haze is steepest
+				ensure("close enough", worst <= 1);
+			}
+		}
+	}
+
+	template<> template<>
+	void skylut_object::test<3>()
+	{
+		set_test_name("building on a worker, and filling in a cube");
+		const LLSkyLUT::Params params = make_params(false);
+		LLSkyLUT here;
+		here.build(params, false);
+
+		LLJobScheduler::getInstance()->start(1);
+		LLSkyLUT there;
+		there.build(params, true);
+		// Whether or not the worker got to it first
+		LLJobScheduler::getInstance()->stop();
+		there.wait();
+		ensure("valid", there.isValid());
+		there.invalidate();
+		ensure("invalidated", !there.isValid());
+
+		std::vector<LLVector3> dirs;
+		for (S32 side = 0; side < 6; side++)
+		{
+			cube_dirs(side, dirs);
+		}
+		for (U32 i = 0; i < dirs.size(); i++)
+		{
+			LLColor3 a;
+			LLColor3 b;
+			here.getHazeColor(dirs[i], a);
+			there.getHazeColor(dirs[i], b);
+			ensure("same tables", !memcmp(a.mV, b.mV, sizeof(a.mV)));
+		}
+
+		// What a cube's worth of texels cost each way, both textures
+		// sharing one haze color per texel with the tables
+		const S32 ROUNDS = 10;
+		LLColor3 sum;
+		LLTimer timer;
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			for (U32 i = 0; i < dirs.size(); i++)
+			{
+				sum += haze(params, dirs[i]);
+				sum += haze(params, dirs[i]);
+			}
+		}
+		F64 model_time = timer.getElapsedTimeF64()/ROUNDS;
+
+		timer.reset();
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			for (U32 i = 0; i < dirs.size(); i++)
+			{
+				LLColor3 color;
+				here.getHazeColor(dirs[i], color);
+				sum += color;
+			}
+		}
+		F64 table_time = timer.getElapsedTimeF64()/ROUNDS;
+
+		timer.reset();
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			here.build(params, false);
+		}
+		F64 build_time = timer.getElapsedTimeF64()/ROUNDS;
+		ensure("finite", llfinite(sum.mV[0]));
+
+		llinfos << "Sky cube of " << dirs.size() << " texels: model " << model_time*1000.0
+				<< " ms, tables " << table_time*1000.0 << " ms, building the tables "
+				<< build_time*1000.0 << " ms" << llendl;
+	}
+}
@@ -0,0 +1,373 @@
+/**
+ * @file   llterraincompositor_test.cpp
+ * @brief  Test for llterraincompositor.cpp
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llterraincompositor.h"
+
+#include <vector>
+
+#include "llmath.h"
+#include "lljobscheduler.h"
+#include "lltimer.h"
+#include "../test/lltut.h"
+
+namespace
+{
+	// A region the way LLViewerRegion sets one up
+	const S32 LAYER_WIDTH = 256;
+	const F32 LAYER_SCALE = 1.f;
+	const U32 TEXTURE_SIZE = 256;
+	const U32 DETAIL_SIZE = 128;
+	const F32 DETAIL_SCALE = 16.f;
+
+	struct Region
+	{
+		std::vector<U8> mDetail[LLTerrainCompositor::NUM_DETAIL_TEXTURES];
+		std::vector<F32> mComposition;
+
+		Region(U32 seed)
+		{
+			for (S32 t = 0; t < LLTerrainCompositor::NUM_DETAIL_TEXTURES; t++)
+			{
+				mDetail[t].resize(DETAIL_SIZE*DETAIL_SIZE*3);
+				for (U32 i = 0; i < mDetail[t].size(); i++)
+				{
+					seed = seed*1103515245 + 12345;
+					mDetail[t][i] = (U8)(seed >> 24);
+				}
+			}
+			mComposition.resize(LAYER_WIDTH*LAYER_WIDTH);
+			for (S32 y = 0; y < LAYER_WIDTH; y++)
+			{
+				for (S32 x = 0; x < LAYER_WIDTH; x++)
+				{
+					seed = seed*1103515245 + 12345;
+					F32 noise = (F32)((seed >> 16) & 0xFF)/512.f;
+					F32 value = 1.5f + 1.6f*sinf(x*0.05f)*cosf(y*0.03f) + noise;
+					mComposition[y*LAYER_WIDTH + x] = llclamp(value, 0.f, 3.f);
+				}
+			}
+		}
+
+		// What LLVLComposition::generateTexture() works out for a patch
+		LLTerrainCompositor::Params params(S32 x_begin, S32 y_begin, S32 x_end, S32 y_end, U8 *output)
+		{
+			LLTerrainCompositor::Params params;
+			for (S32 t = 0; t < LLTerrainCompositor::NUM_DETAIL_TEXTURES; t++)
+			{
+				params.mDetail[t] = &mDetail[t][0];
+				params.mDetailSize[t] = (S32)mDetail[t].size();
+			}
+			params.mDetailWidth = DETAIL_SIZE;
+			params.mDetailHeight = DETAIL_SIZE;
+			params.mComposition = &mComposition[0];
+			params.mCompositionWidth = LAYER_WIDTH;
+			params.mCompositionScaleInv = 1.f/LAYER_SCALE;
+			params.mTexXRatio = (F32)LAYER_WIDTH*LAYER_SCALE / (F32)TEXTURE_SIZE;
+			params.mTexYRatio = params.mTexXRatio;
+			params.mDetailXStride = ((F32)DETAIL_SIZE / DETAIL_SCALE)*((F32)LAYER_WIDTH / (F32)TEXTURE_SIZE);
+			params.mDetailYStride = params.mDetailXStride;
+			params.mXBegin = x_begin;
+			params.mYBegin = y_begin;
+			params.mXEnd = x_end;
+			params.mYEnd = y_end;
+			params.mOutput = output;
+			params.mOutputStride = TEXTURE_SIZE*3;
+			return params;
+		}
+
+		F32 getValueScaled(const F32 x, const F32 y) const
+		{
+			S32 x1, x2, y1, y2;
+			F32 x_frac, y_frac;
+
+			x_frac = x*(1.f/LAYER_SCALE);
+			x1 = llfloor(x_frac);
+			x2 = x1 + 1;
+			x_frac -= x1;
+
+			y_frac = y*(1.f/LAYER_SCALE);
+			y1 = llfloor(y_frac);
+			y2 = y1 + 1;
+			y_frac -= y1;
+
+			x1 = llclamp(x1, 0, LAYER_WIDTH - 1);
+			x2 = llclamp(x2, 0, LAYER_WIDTH - 1);
+			y1 = llclamp(y1, 0, LAYER_WIDTH - 1);
+			y2 = llclamp(y2, 0, LAYER_WIDTH - 1);
+
+			F32 row1_left  = mComposition[y1*LAYER_WIDTH + x1];
+			F32 row1_right = mComposition[y1*LAYER_WIDTH + x2];
+			F32 row2_left  = mComposition[y2*LAYER_WIDTH + x1];
+			F32 row2_right = mComposition[y2*LAYER_WIDTH + x2];
+
+			F32 row1_interp = row1_left - x_frac * (row1_left - row1_right);
+			F32 row2_interp = row2_left - x_frac * (row2_left - row2_right);
+
+			return row1_interp - y_frac * (row1_interp - row2_interp);
+		}
+
+		// The texel loop generateTexture() used to run on the main thread
+		void reference(const LLTerrainCompositor::Params &p)
+		{
+			const U32 st_width = p.mDetailWidth;
+			const U32 st_height = p.mDetailHeight;
+			const U32 st_comps = 3;
+			const F32 st_x_stride = p.mDetailXStride;
+			const F32 st_y_stride = p.mDetailYStride;
+			const S32 tex_x_begin = p.mXBegin;
+			const S32 tex_y_begin = p.mYBegin;
+
+			F32 sti, stj;
+			S32 st_offset;
+			stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+			for (S32 j = tex_y_begin; j < p.mYEnd; j++)
+			{
+				U32 offset = j * p.mOutputStride + tex_x_begin * 3;
+				sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
+				for (S32 i = tex_x_begin; i < p.mXEnd; i++)
+				{
+					S32 tex0, tex1;
+					F32 composition = getValueScaled(i*p.mTexXRatio, j*p.mTexYRatio);
+
+					tex0 = llfloor( composition );
+					tex0 = llclamp(tex0, 0, 3);
+					composition -= tex0;
+					tex1 = tex0 + 1;
+					tex1 = llclamp(tex1, 0, 3);
+
+					st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
+					for (U32 k = 0; k < 3; k++)
+					{
+						if (st_offset < p.mDetailSize[tex0] && st_offset < p.mDetailSize[tex1])
+						{
+							F32 a = *(p.mDetail[tex0] + st_offset);
+							F32 b = *(p.mDetail[tex1] + st_offset);
+							p.mOutput[ offset ] = (U8)lltrunc( a + composition * (b - a) );
+						}
+						offset++;
+						st_offset++;
+					}
+
+					sti += st_x_stride;
+					if (sti >= st_width)
+					{
+						sti -= st_width;
+					}
+				}
+
+				stj += st_y_stride;
+				if (stj >= st_height)
+				{
+					stj -= st_height;
+				}
+			}
+		}
+	};
+
+	typedef std::vector<U8> texture_t;
+
+	texture_t make_texture()
+	{
+		return texture_t(TEXTURE_SIZE*TEXTURE_SIZE*3, 0);
+	}
+
+	// Composites the whole texture a patch at a time, as the viewer does
+	void composite_patches(Region &region, U8 *output, S32 patch_texels)
+	{
+		std::vector<LLTerrainCompositor*> compositors;
+		for (S32 y = 0; y < (S32)TEXTURE_SIZE; y += patch_texels)
+		{
+			for (S32 x = 0; x < (S32)TEXTURE_SIZE; x += patch_texels)
+			{
+				LLTerrainCompositor *compositor = new LLTerrainCompositor(
+					region.params(x, y, llmin(x + patch_texels, (S32)TEXTURE_SIZE),
+								  llmin(y + patch_texels, (S32)TEXTURE_SIZE), output));
+				compositor->start();
+				compositors.push_back(compositor);
+			}
+		}
+		for (U32 i = 0; i < compositors.size(); i++)
+		{
+			delete compositors[i];
+		}
+	}
+}
+
+namespace tut
+{
+	struct terraincompositor_data
+	{
+	};
+	typedef test_group<terraincompositor_data> terraincompositor_test;
+	typedef terraincompositor_test::object terraincompositor_object;
+	tut::terraincompositor_test terraincompositor_testcase("LLTerrainCompositor");
+
+	template<> template<>
+	void terraincompositor_object::test<1>()
+	{
+		set_test_name("whole region matches the old texel loop");
+		Region region(3);
+		texture_t expected = make_texture();
+		texture_t actual = make_texture();
+		region.reference(region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &expected[0]));
+
+		LLTerrainCompositor compositor(region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &actual[0]));
+		compositor.start();
+		ensure("done", compositor.isDone());
+		ensure("same texels", expected == actual);
+	}
+
+	template<> template<>
+	void terraincompositor_object::test<2>()
+	{
+		set_test_name("patches, including ones that aren't a multiple of four wide");
+		Region region(7);
+		texture_t expected = make_texture();
+		region.reference(region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &expected[0]));
+
+		// The detail stepping starts afresh at each patch, as it always has
+		const S32 sizes[] = { 16, 13 };
+		for (S32 s = 0; s < 2; s++)
+		{
+			texture_t reference = make_texture();
+			texture_t actual = make_texture();
+			for (S32 y = 0; y < (S32)TEXTURE_SIZE; y += sizes[s])
+			{
+				for (S32 x = 0; x < (S32)TEXTURE_SIZE; x += sizes[s])
+				{
+					region.reference(region.params(x, y, llmin(x + sizes[s], (S32)TEXTURE_SIZE),
+												   llmin(y + sizes[s], (S32)TEXTURE_SIZE), &reference[0]));
+				}
+			}
+			composite_patches(region, &actual[0], sizes[s]);
+			ensure("same texels", reference == actual);
+		}
+	}
+
+	template<> template<>
+	void terraincompositor_object::test<3>()
+	{
+		set_test_name("tiles on the job scheduler");
+		LLJobScheduler::getInstance()->start(3);
+		Region region(11);
+		texture_t expected = make_texture();
+		texture_t actual = make_texture();
+		region.reference(region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &expected[0]));
+		{
+			LLTerrainCompositor compositor(region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &actual[0]));
+			compositor.start();
+			// Goes out of scope waiting for the workers
+		}
+		ensure("same texels", expected == actual);
+
+		texture_t patches = make_texture();
+		composite_patches(region, &patches[0], 16);
+		LLJobScheduler::getInstance()->stop();
+
+		texture_t reference = make_texture();
+		for (S32 y = 0; y < (S32)TEXTURE_SIZE; y += 16)
+		{
+			for (S32 x = 0; x < (S32)TEXTURE_SIZE; x += 16)
+			{
+				region.reference(region.params(x, y, x + 16, y + 16, &reference[0]));
+			}
+		}
+		ensure("same patches", reference == patches);
+	}
+
+	template<> template<>
+	void terraincompositor_object::test<4>()
+	{
+		set_test_name("full region recomposition benchmark");
+		Region region(13);
+		texture_t output = make_texture();
+		const S32 ROUNDS = 20;
+
+		LLTimer timer;
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			for (S32 y = 0; y < (S32)TEXTURE_SIZE; y += 16)
+			{
+				for (S32 x = 0; x < (S32)TEXTURE_SIZE; x += 16)
+				{
+					region.reference(region.params(x, y, x + 16, y + 16, &output[0]));
+				}
+			}
+		}
+		F64 reference_time = timer.getElapsedTimeF64()/ROUNDS;
+
+		timer.reset();
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			composite_patches(region, &output[0], 16);
+		}
+		F64 simd_time = timer.getElapsedTimeF64()/ROUNDS;
+
+		LLJobScheduler::getInstance()->start();
+		timer.reset();
+		for (S32 round = 0; round < ROUNDS; round++)
+		{
+			composite_patches(region, &output[0], 16);
+		}
+		F64 threaded_time = timer.getElapsedTimeF64()/ROUNDS;
+		S32 workers = LLJobScheduler::getInstance()->getNumWorkers();
+		LLJobScheduler::getInstance()->stop();
+
+		llinfos << "Compositing a " << TEXTURE_SIZE << "x" << TEXTURE_SIZE << " region: scalar "
+				<< reference_time*1000.0 << " ms, SSE " << simd_time*1000.0 << " ms, SSE on "
+				<< workers << " workers " << threaded_time*1000.0 << " ms" << llendl;
+	}
+
+	template<> template<>
+	void terraincompositor_object::test<5>()
+	{
+		set_test_name("scheduler stopped with tiles queued");
+		Region region(17);
+		texture_t output = make_texture();
+		std::vector<LLTerrainCompositor*> compositors;
+		LLJobScheduler::getInstance()->start(1);
+		for (S32 i = 0; i < 8; i++)
+		{
+			compositors.push_back(new LLTerrainCompositor(
+				region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &output[0])));
+			compositors.back()->start();
+		}
+		// One worker won't have got through all of that, what's left stays
+		// queued with nobody to run it
+		LLJobScheduler::getInstance()->stop();
+
+		// Composited on the way out rather than waited for forever
+		for (U32 i = 0; i < compositors.size(); i++)
+		{
+			delete compositors[i];
+		}
+		texture_t expected = make_texture();
+		region.reference(region.params(0, 0, TEXTURE_SIZE, TEXTURE_SIZE, &expected[0]));
+		ensure("same texels", expected == output);
+	}
+}
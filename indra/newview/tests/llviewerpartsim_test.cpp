@@ -0,0 +1,289 @@
+/**
+ * @file llviewerpartsim_test.cpp
+ * @brief Tests for simulating particle groups and what becomes of their particles
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llviewerprecompiledheaders.h"
+
+#include "../llviewerpartsim.h"
+
+#include "../llviewercontrol.h"
+
+#include "lljobscheduler.h"
+#include "../llagent.h"
+#define LLVIEWERCAMERA_CPP
+#include "../llviewercamera.h"
+#include "../llviewerobjectlist.h"
+#include "../llviewerregion.h"
+#include "../llwind.h"
+#include "../llworld.h"
+#include "../pipeline.h"
+#include "../llspatialpartition.h"
+
+#include "../test/lltut.h"
+
+//----------------------------------------------------------------------------
+// Mock objects for the dependencies of the code we're testing.  There is no
+// world: groups get no region and no object to draw them with.
+
+LLControlGroup::LLControlGroup(const std::string& name)
+: LLInstanceTracker<LLControlGroup, std::string>(name) {}
+LLControlGroup::~LLControlGroup() {}
+S32 LLControlGroup::getS32(const std::string& name) { return 8192; }
+LLControlGroup gSavedSettings("test");
+
+template class LLViewerCamera* LLSingleton<class LLViewerCamera>::getInstance();
+LLViewerCamera::LLViewerCamera() : LLCamera() {}
+void LLViewerCamera::setView(F32 vertical_fov_rads) {}
+
+LLAgent::LLAgent() : mAgentAccess(NULL) {}
+LLAgent::~LLAgent() {}
+LLViewerRegion *LLAgent::getRegion() const { return NULL; }
+LLAgent gAgent;
+
+LLWorld::LLWorld() {}
+LLViewerRegion *LLWorld::getRegionFromPosAgent(const LLVector3 &pos) { return NULL; }
+LLPatchVertexArray::LLPatchVertexArray() {}
+LLPatchVertexArray::~LLPatchVertexArray() {}
+LLRegionPrefetcher::LLRegionPrefetcher() {}
+LLRegionPrefetcher::~LLRegionPrefetcher() {}
+
+LLObjectMotionStore::LLObjectMotionStore() {}
+LLObjectMotionStore::~LLObjectMotionStore() {}
+LLViewerObjectList::LLViewerObjectList() {}
+LLViewerObjectList::~LLViewerObjectList() {}
+LLViewerObject *LLViewerObjectList::createObjectViewer(const LLPCode pcode, LLViewerRegion *regionp) { return NULL; }
+BOOL LLViewerObjectList::killObject(LLViewerObject *objectp) { return TRUE; }
+LLViewerObjectList gObjectList;
+
+LLRenderTarget::LLRenderTarget() {}
+LLRenderTarget::~LLRenderTarget() {}
+void LLRenderTarget::addColorAttachment(U32 color_fmt) {}
+void LLRenderTarget::allocateDepth() {}
+void LLRenderTarget::shareDepthBuffer(LLRenderTarget& target) {}
+void LLRenderTarget::release() {}
+void LLRenderTarget::bindTarget() {}
+LLPipeline::LLPipeline() {}
+LLPipeline::~LLPipeline() {}
+void LLPipeline::createObject(LLViewerObject* vobj) {}
+void LLPipeline::markRebuild(LLDrawable *drawablep, LLDrawable::EDrawableFlags flag, BOOL priority) {}
+BOOL LLPipeline::hasRenderType(const U32 type) const { return TRUE; }
+BOOL LLPipeline::sRenderAttachedParticles = TRUE;
+LLPipeline gPipeline;
+
+U32 LLDrawable::sCurVisible = 0;
+BOOL LLSpatialGroup::isVisible() const { return TRUE; }
+void LLViewerObject::setPositionAgent(const LLVector3 &pos_agent, BOOL damped) {}
+void LLViewerPartSource::setStart() {}
+LLVector3 LLWind::getVelocity(const LLVector3 &pos_region) { return LLVector3::zero; }
+LLVector3 LLViewerRegion::getPosRegionFromAgent(const LLVector3 &pos_agent) const { return pos_agent; }
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+	// Far enough from the camera, at the origin, that a particle wants a
+	// group of the size LLViewerPartSim makes there
+	const LLVector3 GROUP_CENTER(100.f, 100.f, 20.f);
+	const F32 GROUP_SIZE = 32.f;
+
+	LLViewerPart *make_part(const LLVector3 &pos, const LLVector3 &velocity, U32 flags)
+	{
+		LLViewerPart *part = new LLViewerPart();
+		part->init(NULL, NULL, NULL);
+		part->mFlags = flags;
+		part->mPosAgent = pos;
+		part->mVelocity = velocity;
+		part->mAccel.setVec(0.f, 0.f, -0.5f);
+		part->mStartColor.setVec(1.f, 0.5f, 0.f, 1.f);
+		part->mEndColor.setVec(0.f, 0.5f, 1.f, 0.f);
+		part->mColor = part->mStartColor;
+		part->mStartScale.setVec(0.5f, 0.5f);
+		part->mEndScale.setVec(1.f, 1.f);
+		part->mScale = part->mStartScale;
+		return part;
+	}
+
+	bool same_bits(const LLPartState &a, const LLPartState &b)
+	{
+		return !memcmp(a.mPosAgent.mV, b.mPosAgent.mV, sizeof(a.mPosAgent.mV))
+			&& !memcmp(a.mVelocity.mV, b.mVelocity.mV, sizeof(a.mVelocity.mV))
+			&& !memcmp(a.mColor.mV, b.mColor.mV, sizeof(a.mColor.mV))
+			&& !memcmp(a.mScale.mV, b.mScale.mV, sizeof(a.mScale.mV))
+			&& a.mLastUpdateTime == b.mLastUpdateTime;
+	}
+
+	// A frame's update of the groups, as LLViewerPartSim::updateSimulation() does it
+	void update(LLViewerPartSim::group_list_t &groups, F32 dt)
+	{
+		for (U32 i = 0; i < groups.size(); i++)
+		{
+			groups[i]->startUpdate(dt);
+		}
+		LLViewerPartSim::getInstance()->simulateGroups(groups);
+		for (U32 i = 0; i < groups.size(); i++)
+		{
+			groups[i]->finishUpdate();
+		}
+	}
+
+	// Groups along a line with particles staying, dying, and leaving
+	void make_groups(LLViewerPartSim::group_list_t &groups, S32 num_groups, S32 per_group)
+	{
+		U32 seed = 5;
+		for (S32 g = 0; g < num_groups; g++)
+		{
+			const LLVector3 center = GROUP_CENTER + LLVector3(0.f, g*GROUP_SIZE, 0.f);
+			LLViewerPartGroup *group = new LLViewerPartGroup(center, GROUP_SIZE, false);
+			for (S32 i = 0; i < per_group; i++)
+			{
+				seed = seed*1103515245 + 12345;
+				const F32 offset = (F32)((seed >> 16) & 0xff)/32.f - 4.f;
+				const LLVector3 pos = center + LLVector3(offset, -offset, offset*0.5f);
+				U32 flags = LLPartData::LL_PART_INTERP_COLOR_MASK | LLPartData::LL_PART_INTERP_SCALE_MASK;
+				LLVector3 velocity(offset, 1.f, 0.f);
+				switch (i % 10)
+				{
+				case 0:
+					flags = LLPartData::LL_PART_DEAD_MASK;
+					break;
+				case 1:
+					// Out of the box in a frame
+					velocity.setVec(1500.f, 0.f, 0.f);
+					break;
+				}
+				group->addPart(make_part(pos, velocity, flags));
+			}
+			groups.push_back(group);
+		}
+	}
+
+	void delete_groups(LLViewerPartSim::group_list_t &groups)
+	{
+		for (U32 i = 0; i < groups.size(); i++)
+		{
+			delete groups[i];
+		}
+		groups.clear();
+	}
+}
+
+namespace tut
+{
+	struct viewerpartsim_data
+	{
+		~viewerpartsim_data()
+		{
+			// The groups particles moved into
+			LLViewerPartSim::getInstance()->destroyClass();
+		}
+	};
+	typedef test_group<viewerpartsim_data> viewerpartsim_test;
+	typedef viewerpartsim_test::object viewerpartsim_object;
+	tut::viewerpartsim_test viewerpartsim_testcase("LLViewerPartSim");
+
+	template<> template<>
+	void viewerpartsim_object::test<1>()
+	{
+		set_test_name("particles stay, die or move to another group");
+		const S32 before = LLViewerPartSim::sParticleCount2;
+
+		LLViewerPartGroup *group = new LLViewerPartGroup(GROUP_CENTER, GROUP_SIZE, false);
+		LLViewerPart *stays = make_part(GROUP_CENTER, LLVector3(1.f, 0.f, 0.f),
+										LLPartData::LL_PART_INTERP_COLOR_MASK);
+		LLViewerPart *killed = make_part(GROUP_CENTER, LLVector3::zero, LLPartData::LL_PART_DEAD_MASK);
+		LLViewerPart *old = make_part(GROUP_CENTER, LLVector3::zero, LLPartData::LL_PART_INTERP_COLOR_MASK);
+		old->mMaxAge = 0.5f;
+		old->mLastUpdateTime = 0.4f;
+		LLViewerPart *leaves = make_part(GROUP_CENTER, LLVector3(500.f, 0.f, 0.f),
+										 LLPartData::LL_PART_INTERP_COLOR_MASK);
+		ensure("stays added", group->addPart(stays));
+		ensure("killed added", group->addPart(killed));
+		ensure("old added", group->addPart(old));
+		ensure("leaves added", group->addPart(leaves));
+		ensure_equals("all in", group->getCount(), 4);
+
+		LLViewerPartSim::group_list_t groups;
+		groups.push_back(group);
+		update(groups, 0.2f);
+
+		ensure_equals("one left", group->getCount(), 1);
+		ensure("the one that stays", group->mParticles[0] == stays);
+		LLPartState state;
+		group->getPool().get(0, state);
+		ensure_approximately_equals("simulated", state.mPosAgent.mV[VX], GROUP_CENTER.mV[VX] + 0.2f, 16);
+
+		// The dead are gone, the one that left lives on elsewhere with the
+		// state it was simulated to
+		ensure_equals("two deleted", LLViewerPartSim::sParticleCount2, before + 2);
+		ensure_approximately_equals("left with its state", leaves->mPosAgent.mV[VX],
+									GROUP_CENTER.mV[VX] + 100.f, 16);
+		ensure_approximately_equals("aged", leaves->mLastUpdateTime, 0.2f, 16);
+
+		delete group;
+	}
+
+	template<> template<>
+	void viewerpartsim_object::test<2>()
+	{
+		set_test_name("groups shared out to the workers go the same as on one thread");
+		const S32 NUM_GROUPS = 40;
+		const S32 PER_GROUP = 100;
+		const S32 FRAMES = 3;
+
+		LLViewerPartSim::group_list_t serial;
+		make_groups(serial, NUM_GROUPS, PER_GROUP);
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			update(serial, 1.f/30.f);
+		}
+
+		LLViewerPartSim::group_list_t shared;
+		make_groups(shared, NUM_GROUPS, PER_GROUP);
+		LLJobScheduler::getInstance()->start(3);
+		for (S32 frame = 0; frame < FRAMES; frame++)
+		{
+			update(shared, 1.f/30.f);
+		}
+		LLJobScheduler::getInstance()->stop();
+
+		for (S32 g = 0; g < NUM_GROUPS; g++)
+		{
+			// A tenth dead and a tenth gone in the first frame
+			ensure_equals("kept", shared[g]->getCount(), PER_GROUP*8/10);
+			ensure_equals("same count", shared[g]->getCount(), serial[g]->getCount());
+			for (S32 i = 0; i < shared[g]->getCount(); i++)
+			{
+				LLPartState expected;
+				LLPartState actual;
+				serial[g]->getPool().get(i, expected);
+				shared[g]->getPool().get(i, actual);
+				ensure("same state", same_bits(expected, actual));
+			}
+		}
+
+		delete_groups(serial);
+		delete_groups(shared);
+	}
+}
@@ -0,0 +1,264 @@
+/**
+ * @file llvocache_test.cpp
+ * @brief Tests for the object cache file format and IO thread
+ *
+ * $LicenseInfo:firstyear=2011&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2011, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llviewerprecompiledheaders.h"
+
+#include "../llvocache.h"
+
+#include "lldir.h"
+#include "llfile.h"
+#include "llregionhandle.h"
+#include "../../llxml/llcontrol.h"
+
+#include "../test/lltut.h"
+
+//----------------------------------------------------------------------------
+// Mock objects for the dependencies of the code we're testing
+
+LLControlGroup::LLControlGroup(const std::string& name)
+: LLInstanceTracker<LLControlGroup, std::string>(name) {}
+LLControlGroup::~LLControlGroup() {}
+BOOL LLControlGroup::getBOOL(const std::string& name) { return TRUE; }
+
+LLControlGroup gSavedSettings("test");
+
+namespace
+{
+	const U32 CACHE_VERSION = 1;
+
+	// An entry holding size bytes counting up from first
+	LLVOCacheEntry* make_entry(U32 local_id, U32 crc, S32 size, U8 first)
+	{
+		std::vector<U8> data(size);
+		for (S32 i = 0; i < size; i++)
+		{
+			data[i] = (U8)(first + i);
+		}
+		LLDataPackerBinaryBuffer dp(&data[0], size);
+		return new LLVOCacheEntry(local_id, crc, dp);
+	}
+
+	bool check_data(LLDataPackerBinaryBuffer* dp, S32 size, U8 first)
+	{
+		if (!dp || dp->getBufferSize() != size)
+		{
+			return false;
+		}
+		for (S32 i = 0; i < size; i++)
+		{
+			if (dp->getBuffer()[i] != (U8)(first + i))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void delete_entries(LLVOCacheEntry::vocache_entry_map_t& entries)
+	{
+		for (LLVOCacheEntry::vocache_entry_map_t::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			delete iter->second;
+		}
+		entries.clear();
+	}
+}
+
+namespace tut
+{
+	struct vocache_data
+	{
+		vocache_data()
+		{
+			mCacheDir = gDirUtilp->getTempDir() + gDirUtilp->getDirDelimiter() + "vocache_test";
+			gDirUtilp->setCacheDir(mCacheDir);
+
+			mHandle = to_region_handle_global(256000.f, 256256.f);
+			mRegionID.generate();
+
+			LLVOCache* cache = LLVOCache::getInstance();
+			cache->setReadOnly(FALSE);
+			cache->initCache(LL_PATH_CACHE, 128, CACHE_VERSION);
+		}
+
+		~vocache_data()
+		{
+			LLVOCache::getInstance()->removeCache(LL_PATH_CACHE);
+			LLVOCache::destroyClass();
+			gDirUtilp->setCacheDir("");
+		}
+
+		// Writes three entries for the region, the middle one bigger
+		void writeRegion()
+		{
+			LLVOCacheEntry::vocache_entry_map_t entries;
+			entries[10] = make_entry(10, 100, 64, 1);
+			entries[11] = make_entry(11, 110, 1000, 2);
+			entries[12] = make_entry(12, 120, 32, 3);
+			LLVOCache::getInstance()->writeToCache(mHandle, mRegionID, entries, TRUE);
+			delete_entries(entries);
+		}
+
+		std::string regionFilename()
+		{
+			U32 region_x, region_y;
+			grid_from_region_handle(mHandle, &region_x, &region_y);
+			return gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "objectcache",
+												  llformat("objects_%d_%d.slc", region_x, region_y));
+		}
+
+		std::string mCacheDir;
+		U64 mHandle;
+		LLUUID mRegionID;
+	};
+	typedef test_group<vocache_data> vocache_test;
+	typedef vocache_test::object vocache_object;
+	tut::vocache_test vocache_testcase("LLVOCache");
+
+	template<> template<>
+	void vocache_object::test<1>()
+	{
+		// Entries loaded from a region's file share one block, and give
+		// it back, unfreed, as they are destroyed
+		writeRegion();
+
+		LLVOCacheEntry::vocache_entry_map_t entries;
+		LLVOCache::getInstance()->readFromCache(mHandle, mRegionID, entries);
+		ensure_equals("all read", entries.size(), (size_t)3);
+		ensure("wrong crc misses", entries[10]->getDP(101) == NULL);
+		ensure("first", check_data(entries[10]->getDP(100), 64, 1));
+		ensure("second", check_data(entries[11]->getDP(110), 1000, 2));
+		ensure_equals("hit counted", entries[11]->getHitCount(), 1);
+
+		// The last is never looked at before it goes
+		delete entries[12];
+		entries.erase(12);
+		delete_entries(entries);
+	}
+
+	template<> template<>
+	void vocache_object::test<2>()
+	{
+		// An entry loaded from a block that gets new data lets go of the
+		// block and owns a copy
+		writeRegion();
+
+		LLVOCacheEntry::vocache_entry_map_t entries;
+		LLVOCache::getInstance()->readFromCache(mHandle, mRegionID, entries);
+		ensure_equals("all read", entries.size(), (size_t)3);
+
+		std::vector<U8> data(48, 7);
+		LLDataPackerBinaryBuffer dp(&data[0], (S32)data.size());
+		entries[11]->assignCRC(111, dp);
+		ensure_equals("crc changed", entries[11]->getCRC(), (U32)111);
+		LLDataPackerBinaryBuffer* new_dp = entries[11]->getDP(111);
+		ensure("new data", new_dp && new_dp->getBufferSize() == 48 && new_dp->getBuffer()[47] == 7);
+
+		// Written back out and read again, old and new entries together
+		LLVOCache::getInstance()->writeToCache(mHandle, mRegionID, entries, TRUE);
+		delete_entries(entries);
+		LLVOCache::getInstance()->readFromCache(mHandle, mRegionID, entries);
+		ensure_equals("read again", entries.size(), (size_t)3);
+		ensure("kept", check_data(entries[10]->getDP(100), 64, 1));
+		new_dp = entries[11]->getDP(111);
+		ensure("replaced", new_dp && new_dp->getBufferSize() == 48 && new_dp->getBuffer()[0] == 7);
+		delete_entries(entries);
+	}
+
+	template<> template<>
+	void vocache_object::test<3>()
+	{
+		// Data that has gone bad on disk fails its checksum when it is
+		// first used, and is dropped without touching the rest
+		writeRegion();
+		// Waits for the write and saves the header
+		LLVOCache::destroyClass();
+
+		// Flip the last byte of the file, in the last entry's data
+		std::string filename = regionFilename();
+		llstat stat_data;
+		ensure("written", LLFile::stat(filename, &stat_data) == 0 && stat_data.st_size > 0);
+		LLFILE* file = LLFile::fopen(filename, "r+b");
+		ensure("opened", file != NULL);
+		fseek(file, -1, SEEK_END);
+		U8 last = (U8)fgetc(file);
+		fseek(file, -1, SEEK_END);
+		fputc(last ^ 0xff, file);
+		fclose(file);
+
+		LLVOCache* cache = LLVOCache::getInstance();
+		cache->setReadOnly(FALSE);
+		cache->initCache(LL_PATH_CACHE, 128, CACHE_VERSION);
+		LLVOCacheEntry::vocache_entry_map_t entries;
+		cache->readFromCache(mHandle, mRegionID, entries);
+		ensure_equals("index still good", entries.size(), (size_t)3);
+
+		LLVOCacheEntry* bad = NULL;
+		S32 good = 0;
+		for (LLVOCacheEntry::vocache_entry_map_t::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			if (iter->second->peekDP())
+			{
+				good++;
+			}
+			else
+			{
+				bad = iter->second;
+			}
+		}
+		ensure_equals("others fine", good, 2);
+		ensure("bad one found", bad != NULL);
+		ensure("bad one forgotten", bad->getDP(bad->getCRC()) == NULL);
+		delete_entries(entries);
+	}
+
+	template<> template<>
+	void vocache_object::test<4>()
+	{
+		// A prefetched region is read by the IO thread, and a region
+		// written since isn't answered with the stale read
+		writeRegion();
+
+		LLVOCache* cache = LLVOCache::getInstance();
+		cache->prefetch(mHandle);
+
+		LLVOCacheEntry::vocache_entry_map_t entries;
+		entries[20] = make_entry(20, 200, 16, 9);
+		cache->writeToCache(mHandle, mRegionID, entries, TRUE);
+		delete_entries(entries);
+
+		cache->readFromCache(mHandle, mRegionID, entries);
+		ensure_equals("only what was written last", entries.size(), (size_t)1);
+		ensure("its data", check_data(entries[20]->getDP(200), 16, 9));
+		delete_entries(entries);
+
+		// Somebody else's region by the same handle
+		LLUUID other_id;
+		other_id.generate();
+		cache->readFromCache(mHandle, other_id, entries);
+		ensure("other region's id misses", entries.empty());
+	}
+}